@@ -122,3 +122,5 @@ check_symbol_exists(epoll_create sys/epoll.h REALM_HAVE_EPOLL)
 if(REALM_HAVE_EPOLL)
     add_definitions(-DREALM_HAVE_EPOLL)
 endif()
+
+check_symbol_exists(SYS_futex sys/syscall.h REALM_HAVE_FUTEX)
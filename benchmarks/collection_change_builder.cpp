@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <benchmark/benchmark.h>
+
+#include "impl/collection_change_builder.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace realm;
+using namespace realm::_impl;
+
+// calculate() is benchmarked on row lists of the given size where the given
+// percentage of rows have been inserted, deleted or (for sorted results) moved
+// between the old and new versions, mirroring what a Results notifier sees
+// after a write transaction.
+
+namespace {
+struct RowDiff {
+    std::vector<size_t> old_rows;
+    std::vector<size_t> new_rows;
+    IndexSet move_candidates;
+};
+
+RowDiff make_unsorted_diff(size_t size, int churn)
+{
+    // Simulate what the notifier sees for a query matching every row of a
+    // table: deleting a row moves the last row into its slot, the old rows
+    // are mapped to their new positions, and new rows are appended
+    std::mt19937 rng(size * 100 + churn);
+    size_t changes = size * churn / 200;
+    RowDiff diff;
+    diff.old_rows.resize(size);
+    std::iota(diff.old_rows.begin(), diff.old_rows.end(), 0);
+    std::vector<size_t> old_row_at = diff.old_rows;
+
+    size_t table_size = size;
+    for (size_t i = 0; i < changes; ++i) {
+        size_t row = std::uniform_int_distribution<size_t>(0, table_size - 1)(rng);
+        size_t last = --table_size;
+        diff.old_rows[old_row_at[row]] = IndexSet::npos;
+        if (row != last) {
+            old_row_at[row] = old_row_at[last];
+            diff.old_rows[old_row_at[row]] = row;
+            diff.move_candidates.add(row);
+        }
+    }
+
+    diff.new_rows.resize(table_size + changes);
+    std::iota(diff.new_rows.begin(), diff.new_rows.end(), 0);
+    return diff;
+}
+
+RowDiff make_sorted_diff(size_t size, int churn)
+{
+    std::mt19937 rng(size * 100 + churn);
+    std::bernoulli_distribution changed(churn / 100.0);
+    RowDiff diff;
+    diff.old_rows.resize(size);
+    std::iota(diff.old_rows.begin(), diff.old_rows.end(), 0);
+    std::shuffle(diff.old_rows.begin(), diff.old_rows.end(), rng);
+
+    // Moving a row in a sorted collection is removing it from its old
+    // position and inserting it elsewhere
+    diff.new_rows = diff.old_rows;
+    std::vector<size_t> moved;
+    diff.new_rows.erase(std::remove_if(diff.new_rows.begin(), diff.new_rows.end(), [&](size_t row) {
+        if (!changed(rng))
+            return false;
+        moved.push_back(row);
+        return true;
+    }), diff.new_rows.end());
+    for (auto row : moved) {
+        std::uniform_int_distribution<size_t> position(0, diff.new_rows.size());
+        diff.new_rows.insert(diff.new_rows.begin() + position(rng), row);
+    }
+    return diff;
+}
+
+// Builds a change set as the transaction log observer would for a series of
+// random inserts, deletions and modifications on a table of the given size
+CollectionChangeBuilder make_changes(size_t size, size_t operations, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    CollectionChangeBuilder c;
+    for (size_t i = 0; i < operations; ++i) {
+        size_t ndx = std::uniform_int_distribution<size_t>(0, size - 1)(rng);
+        switch (rng() % 3) {
+            case 0:
+                c.insert(ndx);
+                ++size;
+                break;
+            case 1:
+                c.move_over(ndx, size - 1);
+                --size;
+                break;
+            case 2:
+                c.modify(ndx);
+                break;
+        }
+    }
+    c.parse_complete();
+    return c;
+}
+
+void churn_args(benchmark::internal::Benchmark* b)
+{
+    for (int size : {100, 10000, 100000}) {
+        for (int churn : {1, 10, 50})
+            b->Args({size, churn});
+    }
+}
+
+bool none_modified(size_t)
+{
+    return false;
+}
+} // anonymous namespace
+
+static void BM_calculate_unsorted(benchmark::State& state)
+{
+    auto diff = make_unsorted_diff(state.range(0), state.range(1));
+    for (auto _ : state) {
+        auto c = CollectionChangeBuilder::calculate(diff.old_rows, diff.new_rows, none_modified,
+                                                    diff.move_candidates);
+        benchmark::DoNotOptimize(c);
+    }
+    state.SetItemsProcessed(state.iterations() * diff.new_rows.size());
+}
+BENCHMARK(BM_calculate_unsorted)->Apply(churn_args);
+
+static void BM_calculate_sorted(benchmark::State& state)
+{
+    auto diff = make_sorted_diff(state.range(0), state.range(1));
+    for (auto _ : state) {
+        auto c = CollectionChangeBuilder::calculate(diff.old_rows, diff.new_rows, none_modified);
+        benchmark::DoNotOptimize(c);
+    }
+    state.SetItemsProcessed(state.iterations() * diff.new_rows.size());
+}
+BENCHMARK(BM_calculate_sorted)->Apply(churn_args);
+
+static void BM_merge(benchmark::State& state)
+{
+    size_t size = state.range(0);
+    size_t operations = size * state.range(1) / 100;
+    auto first = make_changes(size, operations, 1);
+    auto second = make_changes(size, operations, 2);
+    for (auto _ : state) {
+        auto c = first;
+        c.merge(CollectionChangeBuilder(second));
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_merge)->Apply(churn_args);
+
+static void BM_merge_many(benchmark::State& state)
+{
+    // Many small transactions being merged into one notification, as happens
+    // when the notifier falls behind the writer
+    size_t size = state.range(0);
+    std::vector<CollectionChangeBuilder> changes;
+    for (unsigned i = 0; i < 100; ++i)
+        changes.push_back(make_changes(size, state.range(1), i));
+    for (auto _ : state) {
+        CollectionChangeBuilder c;
+        for (auto const& change : changes)
+            c.merge(CollectionChangeBuilder(change));
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_merge_many)->Apply(churn_args);
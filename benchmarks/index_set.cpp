@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <benchmark/benchmark.h>
+
+#include "index_set.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace realm;
+
+// Benchmarks are parameterized over the size of the set and its density, which
+// is the percentage of indices in the covered range which are present. Sparse
+// sets have one range per index while dense sets have a few long ranges, and
+// most change sets fall somewhere in between.
+
+namespace {
+// Generates the indices of a set containing `size` indices spread out such
+// that roughly `density` percent of the covered range is present
+std::vector<size_t> make_indices(size_t size, int density)
+{
+    std::mt19937 rng(size * 100 + density);
+    std::bernoulli_distribution present(density / 100.0);
+    std::vector<size_t> indices;
+    indices.reserve(size);
+    for (size_t i = 0; indices.size() < size; ++i) {
+        if (present(rng))
+            indices.push_back(i);
+    }
+    return indices;
+}
+
+IndexSet make_set(size_t size, int density)
+{
+    IndexSet set;
+    for (auto index : make_indices(size, density))
+        set.add(index);
+    return set;
+}
+
+// Indices which are shuffled so that they aren't added in order
+std::vector<size_t> make_shuffled_indices(size_t size, int density)
+{
+    auto indices = make_indices(size, density);
+    std::shuffle(indices.begin(), indices.end(), std::mt19937(size));
+    return indices;
+}
+
+void density_args(benchmark::internal::Benchmark* b)
+{
+    for (int size : {64, 1024, 16384}) {
+        for (int density : {5, 50, 95})
+            b->Args({size, density});
+    }
+}
+} // anonymous namespace
+
+static void BM_index_set_add_in_order(benchmark::State& state)
+{
+    auto indices = make_indices(state.range(0), state.range(1));
+    for (auto _ : state) {
+        IndexSet set;
+        for (auto index : indices)
+            set.add(index);
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_add_in_order)->Apply(density_args);
+
+static void BM_index_set_add_shuffled(benchmark::State& state)
+{
+    auto indices = make_shuffled_indices(state.range(0), state.range(1));
+    for (auto _ : state) {
+        IndexSet set;
+        for (auto index : indices)
+            set.add(index);
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_add_shuffled)->Apply(density_args);
+
+static void BM_index_set_add_set(benchmark::State& state)
+{
+    auto base = make_set(state.range(0), state.range(1));
+    auto other = make_set(state.range(0), state.range(1));
+    other.shift_for_insert_at(0, 1);
+    for (auto _ : state) {
+        auto set = base;
+        set.add(other);
+        benchmark::DoNotOptimize(set);
+    }
+}
+BENCHMARK(BM_index_set_add_set)->Apply(density_args);
+
+static void BM_index_set_insert_at(benchmark::State& state)
+{
+    auto base = make_set(state.range(0), state.range(1));
+    auto indices = make_shuffled_indices(state.range(0) / 8, 50);
+    for (auto _ : state) {
+        auto set = base;
+        for (auto index : indices)
+            set.insert_at(index);
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_insert_at)->Apply(density_args);
+
+static void BM_index_set_erase_at(benchmark::State& state)
+{
+    auto base = make_set(state.range(0), state.range(1));
+    auto indices = make_shuffled_indices(state.range(0) / 8, 50);
+    for (auto _ : state) {
+        auto set = base;
+        for (auto index : indices)
+            set.erase_at(index);
+        benchmark::DoNotOptimize(set);
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_erase_at)->Apply(density_args);
+
+static void BM_index_set_shift(benchmark::State& state)
+{
+    auto set = make_set(state.range(0), state.range(1));
+    auto indices = make_shuffled_indices(1024, 50);
+    for (auto _ : state) {
+        for (auto index : indices)
+            benchmark::DoNotOptimize(set.shift(index));
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_shift)->Apply(density_args);
+
+static void BM_index_set_unshift(benchmark::State& state)
+{
+    auto set = make_set(state.range(0), state.range(1));
+    // unshift() is only defined for indices which aren't in the set
+    std::vector<size_t> indices;
+    for (auto index : make_shuffled_indices(2048, 50)) {
+        if (!set.contains(index))
+            indices.push_back(index);
+    }
+    for (auto _ : state) {
+        for (auto index : indices)
+            benchmark::DoNotOptimize(set.unshift(index));
+    }
+    state.SetItemsProcessed(state.iterations() * indices.size());
+}
+BENCHMARK(BM_index_set_unshift)->Apply(density_args);
@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Measures the latency from committing a write transaction to every
+// notification callback for it having been called, and the CPU time used per
+// commit by the whole process. The commits are made on a second Realm
+// instance on the same thread as the observed one, so that the latency
+// includes waking up the notifier thread, running the notifiers, and
+// signalling the observing thread's event loop.
+//
+// Usage: bench-notifications [--commits N] [filter]
+// Only configurations whose name contains `filter` are run.
+
+#include "util/event_loop.hpp"
+#include "util/test_file.hpp"
+
+#include "object_schema.hpp"
+#include "property.hpp"
+#include "results.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/group.hpp>
+#include <realm/table.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace realm;
+
+namespace {
+struct Configuration {
+    size_t notifiers;
+    size_t rows;
+    bool sorted;
+    // Commits modify the objects linked to by the observed objects rather
+    // than the observed objects themselves
+    bool deep;
+    size_t threads;
+
+    std::string name() const
+    {
+        return "notifiers=" + std::to_string(notifiers) + " rows=" + std::to_string(rows)
+             + (sorted ? " sorted" : " unsorted") + (deep ? " deep" : " shallow")
+             + " threads=" + std::to_string(threads);
+    }
+};
+
+struct Result {
+    std::vector<double> latencies_us;
+    double cpu_us_per_commit;
+};
+
+const auto timeout = std::chrono::seconds(30);
+
+// Run the event loop until `done` returns true, or just run the notifiers
+// synchronously on platforms without an event loop implementation
+template<typename Fn>
+void wait_for(Realm& realm, Fn&& done)
+{
+    if (!util::EventLoop::has_implementation()) {
+        advance_and_notify(realm);
+        if (!done())
+            throw std::runtime_error("notification callbacks were not called");
+        return;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    util::EventLoop::main().run_until([&] {
+        if (std::chrono::steady_clock::now() > deadline)
+            throw std::runtime_error("timed out waiting for notification callbacks");
+        return done();
+    });
+}
+
+Result run(Configuration const& c, size_t commits)
+{
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = util::EventLoop::has_implementation();
+    config.notifier_thread_count = c.threads;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+        }},
+        {"target", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    auto observer = Realm::get_shared_realm(config);
+    auto writer = Realm::get_shared_realm(config);
+    auto objects = writer->read_group().get_table("class_object");
+    auto targets = writer->read_group().get_table("class_target");
+
+    std::mt19937 rng(c.rows);
+    auto random_value = [&] { return std::uniform_int_distribution<int64_t>(0, 1000000)(rng); };
+    writer->begin_transaction();
+    objects->add_empty_row(c.rows);
+    targets->add_empty_row(c.rows);
+    for (size_t i = 0; i < c.rows; ++i) {
+        objects->set_int(0, i, random_value());
+        objects->set_link(1, i, i);
+        targets->set_int(0, i, random_value());
+    }
+    writer->commit_transaction();
+    observer->refresh();
+
+    // Every notifier matches every object, but with a distinct query so that
+    // they aren't shared with each other
+    auto& table = *observer->read_group().get_table("class_object");
+    std::vector<Results> results;
+    std::vector<NotificationToken> tokens;
+    size_t calls = 0;
+    for (size_t i = 0; i < c.notifiers; ++i) {
+        Results r(observer, table.where().greater_equal(0, -1 - int64_t(i)));
+        if (c.sorted)
+            r = r.sort({{"value", true}});
+        tokens.push_back(r.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+            if (err)
+                std::rethrow_exception(err);
+            ++calls;
+        }));
+        results.push_back(std::move(r));
+    }
+    wait_for(*observer, [&] { return calls == c.notifiers; });
+
+    Result result;
+    result.latencies_us.reserve(commits);
+    std::clock_t cpu_start = std::clock();
+    for (size_t i = 0; i < commits; ++i) {
+        calls = 0;
+        size_t row = std::uniform_int_distribution<size_t>(0, c.rows - 1)(rng);
+        writer->begin_transaction();
+        (c.deep ? targets : objects)->set_int(0, row, random_value());
+        auto start = std::chrono::steady_clock::now();
+        writer->commit_transaction();
+        wait_for(*observer, [&] { return calls == c.notifiers; });
+        auto latency = std::chrono::steady_clock::now() - start;
+        result.latencies_us.push_back(std::chrono::duration<double, std::micro>(latency).count());
+    }
+    result.cpu_us_per_commit = double(std::clock() - cpu_start) * 1e6 / CLOCKS_PER_SEC / commits;
+    return result;
+}
+
+// `values` must be sorted
+double percentile(std::vector<double> const& values, double p)
+{
+    size_t index = std::min(values.size() - 1, size_t(values.size() * p));
+    return values[index];
+}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    size_t commits = 200;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--commits" && i + 1 < argc)
+            commits = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        else
+            filter = argv[i];
+    }
+
+    if (!util::EventLoop::has_implementation())
+        std::printf("No event loop on this platform: notifiers are run synchronously\n");
+    std::printf("%-56s %12s %12s %12s %14s\n", "configuration", "p50 (us)", "p99 (us)", "max (us)", "cpu/commit (us)");
+
+    for (size_t notifiers : {1, 10, 100}) {
+        for (size_t rows : {100, 10000}) {
+            for (bool sorted : {false, true}) {
+                for (bool deep : {false, true}) {
+                    for (size_t threads : {1, 4}) {
+                        Configuration c{notifiers, rows, sorted, deep, threads};
+                        auto name = c.name();
+                        if (name.find(filter) == std::string::npos)
+                            continue;
+                        // More threads than notifiers don't do anything
+                        if (threads > notifiers)
+                            continue;
+
+                        auto result = run(c, commits);
+                        auto& latencies = result.latencies_us;
+                        std::sort(latencies.begin(), latencies.end());
+                        std::printf("%-56s %12.1f %12.1f %12.1f %14.1f\n", name.c_str(),
+                                    percentile(latencies, 0.5), percentile(latencies, 0.99),
+                                    latencies.back(), result.cpu_us_per_commit);
+                        std::fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+}
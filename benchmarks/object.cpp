@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <benchmark/benchmark.h>
+
+#include "util/test_file.hpp"
+
+#include "object_accessor.hpp"
+#include "property.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include "impl/object_accessor_impl.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace realm;
+
+// Each iteration creates or updates a batch of objects through CppContext in a
+// single write transaction, which is then rolled back outside of the timing so
+// that every iteration starts from the same state. Benchmarks are
+// parameterized over the shape of the objects and how they're created:
+//
+// Shapes:
+//   Plain: an int and a string property
+//   Wide: sixteen int properties, to show the per-property overhead
+//   PrimaryKey: Plain plus an int primary key
+//   Linked: PrimaryKey plus a link and a list of two newly created objects
+//
+// Modes:
+//   Insert: create() for objects which don't exist yet
+//   Upsert: create() with try_update for existing objects where one property
+//           has changed
+//   UpsertDiff: as Upsert, but with update_only_diff
+
+namespace {
+enum class Shape { Plain, Wide, PrimaryKey, Linked };
+enum class Mode { Insert, Upsert, UpsertDiff };
+enum class Api { Create, CreateBulk, CreateWithPrimaryKeyCache };
+
+constexpr size_t batch_size = 1000;
+constexpr size_t wide_property_count = 16;
+
+Schema schema_for(Shape shape)
+{
+    switch (shape) {
+        case Shape::Plain:
+            return {{"object", {
+                {"value", PropertyType::Int},
+                {"name", PropertyType::String},
+            }}};
+        case Shape::Wide:
+            return {{"object", {
+                {"value0", PropertyType::Int},
+                {"value1", PropertyType::Int},
+                {"value2", PropertyType::Int},
+                {"value3", PropertyType::Int},
+                {"value4", PropertyType::Int},
+                {"value5", PropertyType::Int},
+                {"value6", PropertyType::Int},
+                {"value7", PropertyType::Int},
+                {"value8", PropertyType::Int},
+                {"value9", PropertyType::Int},
+                {"value10", PropertyType::Int},
+                {"value11", PropertyType::Int},
+                {"value12", PropertyType::Int},
+                {"value13", PropertyType::Int},
+                {"value14", PropertyType::Int},
+                {"value15", PropertyType::Int},
+            }}};
+        case Shape::PrimaryKey:
+            return {{"object", {
+                {"id", PropertyType::Int, Property::IsPrimary{true}},
+                {"value", PropertyType::Int},
+                {"name", PropertyType::String},
+            }}};
+        case Shape::Linked:
+            return {
+                {"object", {
+                    {"id", PropertyType::Int, Property::IsPrimary{true}},
+                    {"value", PropertyType::Int},
+                    {"name", PropertyType::String},
+                    {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+                    {"list", PropertyType::Array|PropertyType::Object, "target"},
+                }},
+                {"target", {
+                    {"value", PropertyType::Int},
+                }},
+            };
+    }
+    REALM_UNREACHABLE();
+}
+
+util::Any make_value(Shape shape, size_t i, int64_t value)
+{
+    if (shape == Shape::Wide) {
+        AnyDict dict;
+        for (size_t j = 0; j < wide_property_count; ++j)
+            dict["value" + std::to_string(j)] = j == 0 ? value : int64_t(i + j);
+        return dict;
+    }
+
+    AnyDict dict{
+        {"value", value},
+        {"name", "object " + std::to_string(i)},
+    };
+    if (shape == Shape::PrimaryKey || shape == Shape::Linked)
+        dict["id"] = int64_t(i);
+    if (shape == Shape::Linked) {
+        dict["link"] = util::Any(AnyDict{{"value", int64_t(i)}});
+        dict["list"] = util::Any(AnyVector{AnyDict{{"value", int64_t(i)}}, AnyDict{{"value", int64_t(i + 1)}}});
+    }
+    return dict;
+}
+
+size_t property_count(Shape shape)
+{
+    switch (shape) {
+        case Shape::Plain:      return 2;
+        case Shape::Wide:       return wide_property_count;
+        case Shape::PrimaryKey: return 3;
+        case Shape::Linked:     return 5;
+    }
+    REALM_UNREACHABLE();
+}
+
+void configurations(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({"shape", "mode", "api"})->Unit(benchmark::kMicrosecond);
+    for (auto shape : {Shape::Plain, Shape::Wide, Shape::PrimaryKey, Shape::Linked}) {
+        bool has_primary_key = shape == Shape::PrimaryKey || shape == Shape::Linked;
+        for (auto mode : {Mode::Insert, Mode::Upsert, Mode::UpsertDiff}) {
+            // Without a primary key every create() inserts a new object
+            if (mode != Mode::Insert && !has_primary_key)
+                continue;
+            for (auto api : {Api::Create, Api::CreateBulk, Api::CreateWithPrimaryKeyCache}) {
+                if (api == Api::CreateWithPrimaryKeyCache && !has_primary_key)
+                    continue;
+                b->Args({int(shape), int(mode), int(api)});
+            }
+        }
+    }
+}
+} // anonymous namespace
+
+static void BM_object_create(benchmark::State& state)
+{
+    auto shape = Shape(state.range(0));
+    auto mode = Mode(state.range(1));
+    auto api = Api(state.range(2));
+
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    config.cache_primary_key_lookups = api == Api::CreateWithPrimaryKeyCache;
+    config.schema = schema_for(shape);
+    auto realm = Realm::get_shared_realm(config);
+    auto& object_schema = *realm->schema().find("object");
+    CppContext ctx(realm);
+
+    // Upserts are of existing objects where `value` has changed
+    std::vector<util::Any> values;
+    for (size_t i = 0; i < batch_size; ++i)
+        values.push_back(make_value(shape, i, mode == Mode::Insert ? 0 : 1));
+    if (mode != Mode::Insert) {
+        realm->begin_transaction();
+        for (size_t i = 0; i < batch_size; ++i)
+            Object::create(ctx, realm, object_schema, make_value(shape, i, 0));
+        realm->commit_transaction();
+    }
+
+    bool try_update = mode != Mode::Insert;
+    bool update_only_diff = mode == Mode::UpsertDiff;
+    for (auto _ : state) {
+        realm->begin_transaction();
+        if (api == Api::CreateBulk) {
+            benchmark::DoNotOptimize(Object::create_bulk(ctx, realm, object_schema, values,
+                                                         try_update, update_only_diff));
+        }
+        else {
+            for (auto& value : values)
+                benchmark::DoNotOptimize(Object::create(ctx, realm, object_schema, value,
+                                                        try_update, update_only_diff));
+        }
+        state.PauseTiming();
+        realm->cancel_transaction();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    state.counters["properties"] = benchmark::Counter(state.iterations() * batch_size * property_count(shape),
+                                                      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_object_create)->Apply(configurations);
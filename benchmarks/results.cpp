@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <benchmark/benchmark.h>
+
+#include "util/test_file.hpp"
+
+#include "property.hpp"
+#include "results.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/group.hpp>
+#include <realm/link_view.hpp>
+#include <realm/table.hpp>
+
+#include <map>
+#include <memory>
+#include <random>
+
+using namespace realm;
+
+// Benchmarks are parameterized over the number of objects, from 10k to 10M.
+// Each size's Realm is built the first time it's needed and is then shared by
+// all of the benchmarks for that size, as building the larger ones takes far
+// longer than running the benchmarks.
+
+namespace {
+// Column indices in the object table
+constexpr size_t value_col = 0;
+constexpr size_t group_col = 1;
+constexpr size_t link_col = 2;
+
+constexpr size_t target_count = 1000;
+constexpr int64_t group_count = 100;
+
+struct Fixture {
+    InMemoryTestFile config;
+    SharedRealm realm;
+    TableRef objects;
+    LinkViewRef list;
+};
+
+Fixture& fixture(size_t size)
+{
+    static std::map<size_t, std::unique_ptr<Fixture>> fixtures;
+    auto& fixture = fixtures[size];
+    if (fixture)
+        return *fixture;
+
+    fixture = std::make_unique<Fixture>();
+    auto& config = fixture->config;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"group", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+        }},
+        {"target", {
+            {"value", PropertyType::Int},
+        }},
+        {"holder", {
+            {"list", PropertyType::Array|PropertyType::Object, "object"},
+        }},
+    };
+    auto& realm = fixture->realm = Realm::get_shared_realm(config);
+    auto& objects = fixture->objects = realm->read_group().get_table("class_object");
+    auto targets = realm->read_group().get_table("class_target");
+    auto holder = realm->read_group().get_table("class_holder");
+
+    std::mt19937 rng(size);
+    std::uniform_int_distribution<int64_t> value(0, 1000000);
+    realm->begin_transaction();
+    targets->add_empty_row(target_count);
+    for (size_t i = 0; i < target_count; ++i)
+        targets->set_int(0, i, value(rng));
+    objects->add_empty_row(size);
+    for (size_t i = 0; i < size; ++i) {
+        objects->set_int(value_col, i, value(rng));
+        objects->set_int(group_col, i, value(rng) % group_count);
+        objects->set_link(link_col, i, i % target_count);
+    }
+    holder->add_empty_row();
+    fixture->list = holder->get_linklist(0, 0);
+    for (size_t i = 0; i < size; ++i)
+        fixture->list->add(i);
+    realm->commit_transaction();
+    return *fixture;
+}
+
+void sizes(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMicrosecond);
+}
+
+// A query which matches about half of the objects
+Query half(Fixture& f)
+{
+    return f.objects->where().greater(value_col, 500000);
+}
+} // anonymous namespace
+
+static void BM_results_size_table(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    for (auto _ : state) {
+        Results results(f.realm, *f.objects);
+        benchmark::DoNotOptimize(results.size());
+    }
+}
+BENCHMARK(BM_results_size_table)->Apply(sizes);
+
+static void BM_results_size_query(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    for (auto _ : state) {
+        Results results(f.realm, half(f));
+        benchmark::DoNotOptimize(results.size());
+    }
+}
+BENCHMARK(BM_results_size_query)->Apply(sizes);
+
+static void BM_results_size_link_view(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    for (auto _ : state) {
+        Results results(f.realm, f.list);
+        benchmark::DoNotOptimize(results.size());
+    }
+}
+BENCHMARK(BM_results_size_link_view)->Apply(sizes);
+
+// size() of Results which have already been evaluated, which only has to
+// check that the TableView is up to date
+static void BM_results_size_table_view(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, half(f));
+    results.evaluate_query_if_needed();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.size());
+}
+BENCHMARK(BM_results_size_table_view)->Apply(sizes);
+
+static void BM_results_get(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, half(f));
+    size_t size = results.size();
+    for (auto _ : state) {
+        for (size_t i = 0; i < size; ++i)
+            benchmark::DoNotOptimize(results.get(i).get_index());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_results_get)->Apply(sizes);
+
+static void BM_results_sort(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, *f.objects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.sort({{"value", true}}).size());
+}
+BENCHMARK(BM_results_sort)->Apply(sizes);
+
+static void BM_results_sort_link(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, *f.objects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.sort({{"link.value", true}}).size());
+}
+BENCHMARK(BM_results_sort_link)->Apply(sizes);
+
+static void BM_results_distinct(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, *f.objects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.distinct({"group"}).size());
+}
+BENCHMARK(BM_results_distinct)->Apply(sizes);
+
+static void BM_results_distinct_link(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, *f.objects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.distinct({"link.value"}).size());
+}
+BENCHMARK(BM_results_distinct_link)->Apply(sizes);
+
+static void BM_results_sum_table(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, *f.objects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.sum(value_col));
+}
+BENCHMARK(BM_results_sum_table)->Apply(sizes);
+
+static void BM_results_sum_query(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    for (auto _ : state) {
+        Results results(f.realm, half(f));
+        benchmark::DoNotOptimize(results.sum(value_col));
+    }
+}
+BENCHMARK(BM_results_sum_query)->Apply(sizes);
+
+static void BM_results_min_max_average(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, half(f));
+    results.evaluate_query_if_needed();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(results.min(value_col));
+        benchmark::DoNotOptimize(results.max(value_col));
+        benchmark::DoNotOptimize(results.average(value_col));
+    }
+}
+BENCHMARK(BM_results_min_max_average)->Apply(sizes);
+
+static void BM_results_snapshot(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, half(f));
+    results.evaluate_query_if_needed();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.snapshot().size());
+}
+BENCHMARK(BM_results_snapshot)->Apply(sizes);
+
+// The worst case of index_of(), looking up the last row
+static void BM_results_index_of(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    Results results(f.realm, half(f));
+    auto last = results.get(results.size() - 1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.index_of(last));
+}
+BENCHMARK(BM_results_index_of)->Apply(sizes);
+
+static void BM_results_index_of_sorted(benchmark::State& state)
+{
+    auto& f = fixture(state.range(0));
+    auto results = Results(f.realm, half(f)).sort({{"value", true}});
+    auto last = results.get(results.size() - 1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(results.index_of(last));
+}
+BENCHMARK(BM_results_index_of_sorted)->Apply(sizes);
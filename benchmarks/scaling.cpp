@@ -0,0 +1,289 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+// Measures how the coordinator scales with the number of threads using a
+// single file: N reader threads each have their own Realm with a notifier on
+// it, while M writer threads commit to the same file as fast as they can.
+// Reports the total commit throughput, the latency of opening a new Realm
+// instance on a reader thread while all of this is going on, and the latency
+// from a commit to a reader's notification callback for it. Contention on the
+// coordinator's locks or the commit helper shows up as throughput flattening
+// out and latency growing as N and M increase.
+//
+// Usage: bench-scaling [--seconds S] [--max-readers N] [--max-writers M] [filter]
+// Only configurations whose name contains `filter` are run.
+
+#include "util/test_file.hpp"
+
+#include "collection_notifications.hpp"
+#include "property.hpp"
+#include "results.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+#include "util/executor.hpp"
+
+#include <realm/group.hpp>
+#include <realm/table.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace realm;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Delivers a reader's notifications on the reader's own thread, which runs
+// the posted tasks in between its other work
+class ThreadExecutor : public util::Executor {
+public:
+    ThreadExecutor() : m_thread(std::this_thread::get_id()) { }
+
+    void post(std::function<void()> task) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_cv.notify_one();
+    }
+
+    bool is_current() const override { return std::this_thread::get_id() == m_thread; }
+
+    // Run the tasks posted so far, waiting up to `timeout` for there to be some
+    void run_for(std::chrono::microseconds timeout)
+    {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, timeout, [&] { return !m_tasks.empty(); });
+            tasks.swap(m_tasks);
+        }
+        for (auto& task : tasks)
+            task();
+    }
+
+private:
+    const std::thread::id m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_tasks;
+};
+
+struct Configuration {
+    size_t readers;
+    size_t writers;
+
+    std::string name() const
+    {
+        return "readers=" + std::to_string(readers) + " writers=" + std::to_string(writers);
+    }
+};
+
+struct Result {
+    double commits_per_second;
+    std::vector<double> open_latencies_us;
+    std::vector<double> notification_latencies_us;
+};
+
+// Each thread's measurements, merged once it has finished
+struct ThreadResult {
+    size_t commits = 0;
+    std::vector<double> open_latencies_us;
+    std::vector<double> notification_latencies_us;
+};
+
+Result run(Configuration const& c, std::chrono::milliseconds duration)
+{
+    TestFile config;
+    config.cache = false;
+    config.schema = Schema{
+        {"object", {
+            // The time each writer last committed at, one row per writer
+            {"committed_at", PropertyType::Int},
+        }},
+    };
+
+    {
+        auto realm = Realm::get_shared_realm(config);
+        realm->begin_transaction();
+        realm->read_group().get_table("class_object")->add_empty_row(c.writers);
+        realm->commit_transaction();
+    }
+
+    std::atomic<size_t> readers_ready{0};
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::vector<ThreadResult> results(c.readers + c.writers);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < c.readers; ++i) {
+        threads.emplace_back([&, i] {
+            auto& result = results[i];
+            auto executor = std::make_shared<ThreadExecutor>();
+            Realm::Config reader_config = config;
+            reader_config.notification_executor = executor;
+
+            auto realm = Realm::get_shared_realm(reader_config);
+            auto table = realm->read_group().get_table("class_object");
+            Results all(realm, *table);
+            bool initial = true;
+            auto token = all.add_notification_callback([&](CollectionChangeSet changes, std::exception_ptr err) {
+                if (err)
+                    std::rethrow_exception(err);
+                if (initial) {
+                    initial = false;
+                    ++readers_ready;
+                    return;
+                }
+                if (!start)
+                    return;
+                auto now = now_ns();
+                for (auto row : changes.modifications.as_indexes())
+                    result.notification_latencies_us.push_back((now - table->get_int(0, row)) / 1000.0);
+            });
+
+            auto next_open = Clock::now();
+            while (!stop) {
+                executor->run_for(std::chrono::microseconds(500));
+                if (!start || Clock::now() < next_open)
+                    continue;
+                // Opening a new instance goes through the same coordinator
+                // locks as the notifier and writer threads are using
+                auto open_start = Clock::now();
+                Realm::get_shared_realm(reader_config);
+                result.open_latencies_us.push_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() - open_start).count());
+                next_open = Clock::now() + std::chrono::milliseconds(5);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < c.writers; ++i) {
+        threads.emplace_back([&, i] {
+            auto& result = results[c.readers + i];
+            auto realm = Realm::get_shared_realm(config);
+            auto table = realm->read_group().get_table("class_object");
+            // Stopped without starting if the readers time out
+            while (!start && !stop)
+                std::this_thread::yield();
+            while (!stop) {
+                realm->begin_transaction();
+                table->set_int(0, i, now_ns());
+                realm->commit_transaction();
+                ++result.commits;
+            }
+        });
+    }
+
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (readers_ready < c.readers) {
+        if (Clock::now() > deadline) {
+            stop = true;
+            for (auto& thread : threads)
+                thread.join();
+            throw std::runtime_error("timed out waiting for the readers' initial notifications");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto run_start = Clock::now();
+    start = true;
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    auto elapsed = Clock::now() - run_start;
+    for (auto& thread : threads)
+        thread.join();
+
+    Result result{};
+    size_t commits = 0;
+    for (auto& thread_result : results) {
+        commits += thread_result.commits;
+        result.open_latencies_us.insert(result.open_latencies_us.end(), thread_result.open_latencies_us.begin(),
+                                        thread_result.open_latencies_us.end());
+        result.notification_latencies_us.insert(result.notification_latencies_us.end(),
+                                                thread_result.notification_latencies_us.begin(),
+                                                thread_result.notification_latencies_us.end());
+    }
+    result.commits_per_second = commits / std::chrono::duration<double>(elapsed).count();
+    return result;
+}
+
+// Sorts `values`, and returns 0 if there aren't any
+double percentile(std::vector<double>& values, double p)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, size_t(values.size() * p));
+    return values[index];
+}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    std::chrono::milliseconds duration(1000);
+    size_t max_readers = 64, max_writers = 64;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc)
+            duration = std::chrono::milliseconds(size_t(std::max(0.01, std::atof(argv[++i])) * 1000));
+        else if (arg == "--max-readers" && i + 1 < argc)
+            max_readers = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-writers" && i + 1 < argc)
+            max_writers = std::strtoul(argv[++i], nullptr, 10);
+        else
+            filter = arg;
+    }
+
+    std::printf("%-24s %12s %14s %14s %14s %14s\n", "configuration", "commits/s",
+                "open p50 (us)", "open p99 (us)", "notify p50 (us)", "notify p99 (us)");
+
+    for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+        for (size_t writers = 1; writers <= max_writers; writers *= 2) {
+            Configuration c{readers, writers};
+            auto name = c.name();
+            if (name.find(filter) == std::string::npos)
+                continue;
+
+            auto result = run(c, duration);
+            std::printf("%-24s %12.0f %14.1f %14.1f %14.1f %14.1f\n", name.c_str(), result.commits_per_second,
+                        percentile(result.open_latencies_us, 0.5), percentile(result.open_latencies_us, 0.99),
+                        percentile(result.notification_latencies_us, 0.5),
+                        percentile(result.notification_latencies_us, 0.99));
+            std::fflush(stdout);
+        }
+    }
+}
@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "audit.hpp"
+
+#include <realm/row.hpp>
+#include <realm/table.hpp>
+
+#include <algorithm>
+
+using namespace realm;
+
+// A single-producer single-consumer ring of read records. The producer is the
+// thread which owns the buffer and the consumer is whichever thread is
+// holding the BufferedAuditInterface's mutex.
+class BufferedAuditInterface::Buffer {
+public:
+    Buffer(size_t capacity)
+    : m_mask(capacity - 1)
+    , m_records(new AuditReadRecord[capacity])
+    {
+        REALM_ASSERT((capacity & m_mask) == 0);
+    }
+
+    // Returns the number of records in the buffer after adding this one, or
+    // zero if the buffer is full
+    size_t push(AuditReadRecord const& record) noexcept
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t size = tail - m_head.load(std::memory_order_acquire);
+        if (size > m_mask)
+            return 0;
+        m_records[tail & m_mask] = record;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return size + 1;
+    }
+
+    void drain_into(std::vector<AuditReadRecord>& out)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        for (; head != tail; ++head)
+            out.push_back(m_records[head & m_mask]);
+        m_head.store(head, std::memory_order_release);
+    }
+
+    bool empty() const noexcept
+    {
+        return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+    }
+
+    // Set once the BufferedAuditInterface has been destroyed, so that the
+    // owning thread can discard the buffer
+    std::atomic<bool> orphaned{false};
+
+private:
+    const size_t m_mask;
+    const std::unique_ptr<AuditReadRecord[]> m_records;
+    // Written by the consumer and producer respectively, and kept on separate
+    // cache lines so that they don't contend
+    std::atomic<size_t> m_head{0};
+    char m_padding[64];
+    std::atomic<size_t> m_tail{0};
+};
+
+namespace {
+std::atomic<uint64_t> s_next_audit_id{1};
+
+struct ThreadBuffer {
+    uint64_t audit_id;
+    std::shared_ptr<BufferedAuditInterface::Buffer> buffer;
+};
+// The buffers for the current thread for each BufferedAuditInterface
+thread_local std::vector<ThreadBuffer> t_buffers;
+
+size_t round_up_to_power_of_two(size_t value)
+{
+    size_t ret = 2;
+    while (ret < value)
+        ret *= 2;
+    return ret;
+}
+} // anonymous namespace
+
+BufferedAuditInterface::BufferedAuditInterface(std::shared_ptr<AuditInterface> target,
+                                               std::chrono::milliseconds flush_interval,
+                                               size_t buffer_size)
+: m_target(std::move(target))
+, m_flush_interval(flush_interval)
+, m_buffer_size(round_up_to_power_of_two(buffer_size))
+, m_id(s_next_audit_id++)
+{
+    REALM_ASSERT(m_target);
+    m_thread = std::thread([this] {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop) {
+            m_cv.wait_for(lock, m_flush_interval, [&] { return m_stop || m_drain_requested.load(); });
+            drain();
+        }
+    });
+}
+
+BufferedAuditInterface::~BufferedAuditInterface()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    drain();
+    for (auto& buffer : m_buffers)
+        buffer->orphaned = true;
+}
+
+BufferedAuditInterface::Buffer& BufferedAuditInterface::buffer_for_current_thread()
+{
+    for (auto& buffer : t_buffers) {
+        if (buffer.audit_id == m_id)
+            return *buffer.buffer;
+    }
+
+    t_buffers.erase(std::remove_if(t_buffers.begin(), t_buffers.end(),
+                                   [](auto& buffer) { return buffer.buffer->orphaned.load(); }),
+                    t_buffers.end());
+    auto buffer = std::make_shared<Buffer>(m_buffer_size);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(buffer);
+    }
+    t_buffers.push_back({m_id, buffer});
+    return *buffer;
+}
+
+void BufferedAuditInterface::request_drain()
+{
+    // A drain which has already been requested hasn't started yet, as the
+    // flag is cleared by drain(), so there's no need to wake the thread again
+    if (m_drain_requested.load())
+        return;
+    // Setting the flag outside of the mutex could race with the background
+    // thread checking it just before it starts waiting, losing the wakeup
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_drain_requested.exchange(true))
+        m_cv.notify_one();
+}
+
+void BufferedAuditInterface::drain()
+{
+    m_drain_requested = false;
+    m_batch.clear();
+    for (auto& buffer : m_buffers)
+        buffer->drain_into(m_batch);
+
+    // Buffers which are no longer referenced by their thread are for threads
+    // which have exited
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                   [](auto& buffer) { return buffer.use_count() == 1 && buffer->empty(); }),
+                    m_buffers.end());
+
+    if (!m_batch.empty())
+        m_target->record_reads(m_batch.data(), m_batch.size());
+}
+
+void BufferedAuditInterface::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    drain();
+}
+
+void BufferedAuditInterface::record_read(VersionID version, RowExpr row)
+{
+    AuditReadRecord record{version, row.get_table()->get_index_in_group(), row.get_index()};
+    auto& buffer = buffer_for_current_thread();
+    while (true) {
+        size_t size = buffer.push(record);
+        if (size) {
+            if (size > (m_buffer_size / 2))
+                request_drain();
+            return;
+        }
+        // Wait for the background thread to make room rather than losing the read
+        request_drain();
+        std::this_thread::yield();
+    }
+}
+
+void BufferedAuditInterface::record_reads(AuditReadRecord const* records, size_t count)
+{
+    m_target->record_reads(records, count);
+}
+
+void BufferedAuditInterface::record_query(VersionID version, TableView const& tv)
+{
+    m_target->record_query(version, tv);
+}
+
+void BufferedAuditInterface::record_write(VersionID old_version, VersionID new_version)
+{
+    m_target->record_write(old_version, new_version);
+}
@@ -16,12 +16,59 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#ifndef REALM_OS_AUDIT_HPP
+#define REALM_OS_AUDIT_HPP
+
+#include <realm/version_id.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace realm {
 class Table;
 class TableView;
 template<typename> class BasicRowExpr;
 using RowExpr = BasicRowExpr<Table>;
-struct VersionID;
+
+// A row read, recorded by BufferedAuditInterface
+struct AuditReadRecord {
+    VersionID version;
+    // The index of the row's table in the group
+    size_t table;
+    size_t row;
+};
+
+// The kinds of events passed to an AuditInterface
+enum class AuditEvent : uint8_t {
+    Read,
+    Query,
+    Write,
+};
+
+// Limits which events are passed to the AuditInterface, so that auditing can
+// be left enabled where recording every event would be too expensive. The
+// policy is checked by Realm::audit_context(AuditEvent, Table const*) before
+// the caller creates the RowExpr or TableView to be recorded.
+struct AuditPolicy {
+    // Record one in every N events of each kind, starting with the first.
+    // Zero disables recording that kind of event entirely.
+    uint32_t read_sample_interval = 1;
+    uint32_t query_sample_interval = 1;
+    uint32_t write_sample_interval = 1;
+
+    // If non-empty, only reads and queries of objects of these types are
+    // recorded. Writes are not associated with a single type, so are only
+    // affected by write_sample_interval.
+    std::vector<std::string> object_types;
+};
 
 class AuditInterface {
 public:
@@ -30,5 +77,65 @@ public:
     virtual void record_query(realm::VersionID, realm::TableView const&) = 0;
     virtual void record_read(realm::VersionID, realm::RowExpr) = 0;
     virtual void record_write(realm::VersionID, realm::VersionID) = 0;
+
+    // Called by BufferedAuditInterface on its background thread with batches
+    // of the reads which were passed to its record_read(). The records can't
+    // be turned back into RowExprs once their version is no longer pinned, so
+    // there's no way to forward them to record_read() instead.
+    virtual void record_reads(AuditReadRecord const* records, size_t count) = 0;
+};
+
+// An AuditInterface which makes record_read() cheap enough to be called on
+// every row access, by appending a compact record of each read to a
+// lock-free buffer for the calling thread rather than calling the wrapped
+// AuditInterface. A background thread drains the buffers every
+// `flush_interval`, or sooner once one is half full, and passes the reads to
+// the wrapped interface's record_reads() in batches. Reads are never
+// dropped: a thread which fills its buffer waits for it to be drained.
+//
+// Queries and writes are passed on to the wrapped interface immediately, and
+// so may be recorded before earlier reads. Use the versions of the records
+// to order them, or call flush() first if the order matters.
+class BufferedAuditInterface : public AuditInterface {
+public:
+    BufferedAuditInterface(std::shared_ptr<AuditInterface> target,
+                           std::chrono::milliseconds flush_interval = std::chrono::milliseconds(10),
+                           size_t buffer_size = 4096);
+    ~BufferedAuditInterface();
+
+    void record_query(VersionID, TableView const&) override;
+    void record_read(VersionID, RowExpr) override;
+    void record_write(VersionID, VersionID) override;
+    void record_reads(AuditReadRecord const* records, size_t count) override;
+
+    // Pass every read recorded so far to the wrapped interface before returning
+    void flush();
+
+    class Buffer;
+
+private:
+    const std::shared_ptr<AuditInterface> m_target;
+    const std::chrono::milliseconds m_flush_interval;
+    const size_t m_buffer_size;
+    // Distinguishes this instance from any earlier one at the same address
+    // in the threads' lists of buffers
+    const uint64_t m_id;
+
+    // Guards m_buffers, m_stop and setting m_drain_requested, and is held
+    // while draining
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::shared_ptr<Buffer>> m_buffers;
+    std::vector<AuditReadRecord> m_batch;
+    std::atomic<bool> m_drain_requested{false};
+    bool m_stop = false;
+    std::thread m_thread;
+
+    Buffer& buffer_for_current_thread();
+    void request_drain();
+    // precondition: m_mutex is locked
+    void drain();
 };
 }
+
+#endif // REALM_OS_AUDIT_HPP
@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef REALM_OS_AWAITABLE_HPP
+#define REALM_OS_AWAITABLE_HPP
+
+// Awaitable wrappers for the callback-based asynchronous APIs, for bindings
+// and services written with C++20 coroutines. The object store itself is
+// built as C++14, so this header only defines anything when it's included
+// from code compiled with coroutine support.
+//
+// Each awaiter lives in the awaiting coroutine's frame, and the callbacks it
+// passes to the underlying API only capture a pointer to it, as does the task
+// it posts to resume the coroutine. Both fit in std::function's small buffer,
+// so awaiting doesn't allocate beyond what the wrapped API and the executor
+// do themselves. The coroutine is always resumed by posting to the executor
+// passed in, which must be the one the Realms involved are used on.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "shared_realm.hpp"
+#include "util/executor.hpp"
+
+#if REALM_ENABLE_SYNC
+#include "results.hpp"
+#include "sync/partial_sync.hpp"
+#include "sync/subscription_state.hpp"
+#include "sync/sync_session.hpp"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <system_error>
+
+namespace realm {
+namespace awaitable {
+namespace _impl {
+class AwaiterBase {
+public:
+    explicit AwaiterBase(util::Executor& executor) noexcept : m_executor(executor) { }
+
+    bool await_ready() const noexcept { return false; }
+
+protected:
+    util::Executor& m_executor;
+    std::coroutine_handle<> m_handle;
+
+    void resume() { m_executor.post([handle = m_handle] { handle.resume(); }); }
+};
+} // namespace _impl
+
+// Open a Realm with Realm::get_shared_realm(config, callback), which waits for
+// the initial download for synchronized Realms, and produce a Realm bound to
+// the executor's thread. Rethrows any error from opening the Realm.
+class OpenAwaiter : public _impl::AwaiterBase {
+public:
+    OpenAwaiter(Realm::Config config, util::Executor& executor)
+    : AwaiterBase(executor), m_config(std::move(config)) { }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        Realm::get_shared_realm(m_config, [this](SharedRealm realm, std::exception_ptr error) {
+            // Keeps the file open until the Realm for the executor is opened
+            m_realm = std::move(realm);
+            m_error = error;
+            resume();
+        });
+    }
+
+    SharedRealm await_resume()
+    {
+        if (m_error)
+            std::rethrow_exception(m_error);
+        auto realm = Realm::get_shared_realm(std::move(m_config));
+        m_realm = nullptr;
+        return realm;
+    }
+
+private:
+    Realm::Config m_config;
+    SharedRealm m_realm;
+    std::exception_ptr m_error;
+};
+
+inline OpenAwaiter open(Realm::Config config, util::Executor& executor)
+{
+    return OpenAwaiter(std::move(config), executor);
+}
+
+// Perform a write with Realm::async_write(). Rethrows the exception thrown by
+// the write or the commit, if any. As with async_write(), the coroutine is
+// never resumed if the Realm is closed before the write completes.
+class WriteAwaiter : public _impl::AwaiterBase {
+public:
+    WriteAwaiter(Realm& realm, std::function<void(Realm&)> write, bool allow_grouping, util::Executor& executor)
+    : AwaiterBase(executor), m_realm(realm), m_write(std::move(write)), m_allow_grouping(allow_grouping) { }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_realm.async_write(std::move(m_write), [this](std::exception_ptr error) {
+            m_error = error;
+            resume();
+        }, m_allow_grouping);
+    }
+
+    void await_resume()
+    {
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    Realm& m_realm;
+    std::function<void(Realm&)> m_write;
+    bool m_allow_grouping;
+    std::exception_ptr m_error;
+};
+
+inline WriteAwaiter write(Realm& realm, std::function<void(Realm&)> write, util::Executor& executor,
+                          bool allow_grouping = false)
+{
+    return WriteAwaiter(realm, std::move(write), allow_grouping, executor);
+}
+
+#if REALM_ENABLE_SYNC
+// Wait for SyncSession::wait_for_download_completion() or
+// wait_for_upload_completion(), producing the error code the session reports.
+// If the session can't register the wait, the coroutine continues
+// immediately with std::errc::operation_canceled.
+class SyncCompletionAwaiter : public _impl::AwaiterBase {
+public:
+    enum class Direction { Download, Upload };
+
+    SyncCompletionAwaiter(SyncSession& session, Direction direction, util::Executor& executor)
+    : AwaiterBase(executor), m_session(session), m_direction(direction) { }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        auto callback = [this](std::error_code error) {
+            m_error = error;
+            resume();
+        };
+        bool registered = m_direction == Direction::Download ? m_session.wait_for_download_completion(callback)
+                                                             : m_session.wait_for_upload_completion(callback);
+        if (!registered)
+            m_error = std::make_error_code(std::errc::operation_canceled);
+        return registered;
+    }
+
+    std::error_code await_resume() const noexcept { return m_error; }
+
+private:
+    SyncSession& m_session;
+    Direction m_direction;
+    std::error_code m_error;
+};
+
+inline SyncCompletionAwaiter wait_for_download(SyncSession& session, util::Executor& executor)
+{
+    return SyncCompletionAwaiter(session, SyncCompletionAwaiter::Direction::Download, executor);
+}
+
+inline SyncCompletionAwaiter wait_for_upload(SyncSession& session, util::Executor& executor)
+{
+    return SyncCompletionAwaiter(session, SyncCompletionAwaiter::Direction::Upload, executor);
+}
+
+// Create a partial sync subscription and wait until it is complete, has
+// failed, or has been removed, producing the Subscription. Rethrows the
+// subscription's error if it failed. The subscription's Realm must be bound to
+// the executor.
+class SubscribeAwaiter : public _impl::AwaiterBase {
+public:
+    SubscribeAwaiter(Results const& results, partial_sync::SubscriptionOptions options, util::Executor& executor)
+    : AwaiterBase(executor), m_subscription(partial_sync::subscribe(results, std::move(options))) { }
+
+    bool await_ready() const { return is_finished(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_token = m_subscription.add_notification_callback([this] {
+            // The callback may be called again before the coroutine resumes
+            if (m_resuming || !is_finished())
+                return;
+            m_resuming = true;
+            resume();
+        });
+    }
+
+    partial_sync::Subscription await_resume()
+    {
+        m_token = {};
+        if (m_subscription.state() == partial_sync::SubscriptionState::Error)
+            std::rethrow_exception(m_subscription.error());
+        return std::move(m_subscription);
+    }
+
+private:
+    partial_sync::Subscription m_subscription;
+    partial_sync::SubscriptionNotificationToken m_token;
+    bool m_resuming = false;
+
+    bool is_finished() const
+    {
+        auto state = m_subscription.state();
+        return state == partial_sync::SubscriptionState::Complete
+            || state == partial_sync::SubscriptionState::Error
+            || state == partial_sync::SubscriptionState::Invalidated;
+    }
+};
+
+inline SubscribeAwaiter subscribe(Results const& results, partial_sync::SubscriptionOptions options,
+                                  util::Executor& executor)
+{
+    return SubscribeAwaiter(results, std::move(options), executor);
+}
+#endif // REALM_ENABLE_SYNC
+
+} // namespace awaitable
+} // namespace realm
+
+#endif // __cpp_impl_coroutine
+
+#endif // REALM_OS_AWAITABLE_HPP
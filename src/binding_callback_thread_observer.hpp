@@ -19,6 +19,8 @@
 #ifndef REALM_OS_BINDING_CALLBACK_THREAD_OBSERVER_HPP
 #define REALM_OS_BINDING_CALLBACK_THREAD_OBSERVER_HPP
 
+#include <chrono>
+#include <cstddef>
 #include <exception>
 
 namespace realm {
@@ -34,6 +36,23 @@ public:
 
     // This method is called with any exception throws by client.run().
     virtual void handle_error(std::exception const& e) = 0;
+
+    // The work done by one iteration of a background thread's loop
+    struct LoopIterationStats {
+        // Time spent doing work, excluding time spent waiting for work or
+        // sleeping to apply Realm::Config::notifier_interval
+        std::chrono::nanoseconds busy_time;
+        // The number of work items handled by the iteration
+        size_t queue_depth;
+        // The time taken by the slowest of those work items
+        std::chrono::nanoseconds longest_handler;
+    };
+
+    // This method is called on the notifier thread after each pass over the
+    // change notifiers for a Realm file, where each notifier is a work item.
+    // The sync client's event loop runs inside sync::Client::run() and does
+    // not expose its iterations, so none are reported for the sync thread.
+    virtual void did_run_loop_iteration(LoopIterationStats const&) { }
 };
 
 extern BindingCallbackThreadObserver* g_binding_callback_thread_observer;
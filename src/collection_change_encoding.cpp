@@ -0,0 +1,245 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "collection_change_encoding.hpp"
+
+#include <stdexcept>
+
+using namespace realm;
+
+namespace {
+void write_varint(std::string& out, size_t value)
+{
+    while (value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+void write_index_set(std::string& out, IndexSet const& set)
+{
+    size_t count = 0;
+    for (auto it = set.begin(), end = set.end(); it != end; ++it)
+        ++count;
+    write_varint(out, count);
+
+    size_t prev_end = 0;
+    for (auto range : set) {
+        write_varint(out, range.first - prev_end);
+        write_varint(out, range.second - range.first);
+        prev_end = range.second;
+    }
+}
+
+// Decodes a varint from data which has already been validated
+size_t read_varint(const char*& pos) noexcept
+{
+    size_t value = 0;
+    unsigned shift = 0;
+    unsigned char byte;
+    do {
+        byte = static_cast<unsigned char>(*pos++);
+        value |= size_t(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+// Decodes varints from untrusted data, throwing if the data is malformed
+class Validator {
+public:
+    Validator(const char* begin, const char* end) : m_pos(begin), m_end(end) { }
+
+    const char* position() const noexcept { return m_pos; }
+    bool at_end() const noexcept { return m_pos == m_end; }
+
+    unsigned char read_byte()
+    {
+        if (m_pos == m_end)
+            throw std::invalid_argument("Encoded change set is truncated");
+        return static_cast<unsigned char>(*m_pos++);
+    }
+
+    size_t read_varint()
+    {
+        size_t value = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            if (shift >= sizeof(size_t) * 8)
+                throw std::invalid_argument("Encoded change set contains an out-of-range value");
+            unsigned char byte = read_byte();
+            size_t bits = byte & 0x7f;
+            if (shift > 0 && bits >> (sizeof(size_t) * 8 - shift))
+                throw std::invalid_argument("Encoded change set contains an out-of-range value");
+            value |= bits << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+
+    // Skip over an encoded index set, checking that the ranges are in order
+    // and don't overflow, and return the number of ranges in it
+    size_t read_index_set()
+    {
+        size_t count = read_varint();
+        size_t prev_end = 0;
+        for (size_t i = 0; i < count; ++i) {
+            size_t gap = read_varint();
+            size_t length = read_varint();
+            if (i > 0 && gap == 0)
+                throw std::invalid_argument("Encoded change set contains adjacent ranges");
+            if (length == 0)
+                throw std::invalid_argument("Encoded change set contains an empty range");
+            if (gap > IndexSet::npos - prev_end || length > IndexSet::npos - prev_end - gap)
+                throw std::invalid_argument("Encoded change set contains an out-of-range value");
+            prev_end += gap + length;
+        }
+        return count;
+    }
+
+private:
+    const char* m_pos;
+    const char* m_end;
+};
+} // anonymous namespace
+
+std::string realm::encode_change_set(CollectionChangeSet const& changes)
+{
+    std::string out;
+    out += char(CollectionChangeSetReader::current_version);
+    write_index_set(out, changes.deletions);
+    write_index_set(out, changes.insertions);
+    write_index_set(out, changes.modifications);
+    write_index_set(out, changes.modifications_new);
+
+    write_varint(out, changes.moves.size());
+    for (auto move : changes.moves) {
+        write_varint(out, move.from);
+        write_varint(out, move.to);
+    }
+
+    write_varint(out, changes.columns.size());
+    for (auto const& column : changes.columns)
+        write_index_set(out, column);
+    return out;
+}
+
+CollectionChangeSetReader::CollectionChangeSetReader(const char* data, size_t size)
+{
+    Validator validator(data, data + size);
+    if (validator.read_byte() != current_version)
+        throw std::invalid_argument("Unsupported change set encoding version");
+
+    auto read_ranges = [&](Ranges& ranges) {
+        ranges.m_begin = validator.position();
+        ranges.m_count = validator.read_index_set();
+        // Point the iterator past the count so that it starts at the first range
+        read_varint(ranges.m_begin);
+    };
+    read_ranges(m_deletions);
+    read_ranges(m_insertions);
+    read_ranges(m_modifications);
+    read_ranges(m_modifications_new);
+
+    m_moves.m_count = validator.read_varint();
+    m_moves.m_begin = validator.position();
+    for (size_t i = 0; i < m_moves.m_count; ++i) {
+        validator.read_varint();
+        validator.read_varint();
+    }
+
+    size_t column_count = validator.read_varint();
+    // Each column takes at least one byte, so bound the reservation by the
+    // remaining data rather than trusting the count
+    if (column_count > size)
+        throw std::invalid_argument("Encoded change set is truncated");
+    m_columns.resize(column_count);
+    for (auto& column : m_columns)
+        read_ranges(column);
+
+    if (!validator.at_end())
+        throw std::invalid_argument("Encoded change set has trailing data");
+}
+
+CollectionChangeSetReader::Ranges::iterator::iterator(const char* pos, size_t count) noexcept
+: m_pos(pos)
+, m_remaining(count)
+{
+    if (m_remaining)
+        read_next();
+}
+
+void CollectionChangeSetReader::Ranges::iterator::read_next() noexcept
+{
+    size_t begin = m_value.second + read_varint(m_pos);
+    m_value = {begin, begin + read_varint(m_pos)};
+}
+
+auto CollectionChangeSetReader::Ranges::iterator::operator++() noexcept -> iterator&
+{
+    if (--m_remaining)
+        read_next();
+    return *this;
+}
+
+IndexSet CollectionChangeSetReader::Ranges::to_index_set() const
+{
+    IndexSet set;
+    for (auto range : *this)
+        set.add_range(range.first, range.second);
+    return set;
+}
+
+CollectionChangeSetReader::Moves::iterator::iterator(const char* pos, size_t count) noexcept
+: m_pos(pos)
+, m_remaining(count)
+{
+    if (m_remaining)
+        read_next();
+}
+
+void CollectionChangeSetReader::Moves::iterator::read_next() noexcept
+{
+    m_value.from = read_varint(m_pos);
+    m_value.to = read_varint(m_pos);
+}
+
+auto CollectionChangeSetReader::Moves::iterator::operator++() noexcept -> iterator&
+{
+    if (--m_remaining)
+        read_next();
+    return *this;
+}
+
+CollectionChangeSet CollectionChangeSetReader::read() const
+{
+    CollectionChangeSet changes;
+    changes.deletions = m_deletions.to_index_set();
+    changes.insertions = m_insertions.to_index_set();
+    changes.modifications = m_modifications.to_index_set();
+    changes.modifications_new = m_modifications_new.to_index_set();
+
+    changes.moves.reserve(m_moves.size());
+    for (auto move : m_moves)
+        changes.moves.push_back(move);
+
+    changes.columns.reserve(m_columns.size());
+    for (auto const& column : m_columns)
+        changes.columns.push_back(column.to_index_set());
+    return changes;
+}
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_COLLECTION_CHANGE_ENCODING_HPP
+#define REALM_COLLECTION_CHANGE_ENCODING_HPP
+
+#include "collection_notifications.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace realm {
+// A compact, versioned binary encoding of CollectionChangeSet, for handing
+// change sets across language or process boundaries without building an
+// intermediate object for every index.
+//
+// The encoding is a version byte followed by the deletions, insertions,
+// modifications and modifications_new index sets, the moves, and then the
+// per-column modifications. All integers are unsigned LEB128 varints. An index
+// set is its number of ranges followed by each range as the gap from the end
+// of the previous range and the range's length, so dense sets encode to a few
+// bytes. Moves are a count followed by from/to pairs, and the columns are a
+// count followed by that many index sets.
+std::string encode_change_set(CollectionChangeSet const& changes);
+
+// Reads an encoded change set in place without copying or decoding it up
+// front. The buffer must outlive the reader and anything obtained from it.
+class CollectionChangeSetReader {
+public:
+    static const unsigned char current_version = 1;
+
+    // Throws std::invalid_argument if the data is not a complete change set in
+    // a supported version of the encoding
+    CollectionChangeSetReader(const char* data, size_t size);
+    explicit CollectionChangeSetReader(std::string const& data)
+    : CollectionChangeSetReader(data.data(), data.size()) { }
+
+    // An encoded IndexSet, which can be iterated over as begin/end pairs
+    class Ranges {
+    public:
+        class iterator : public std::iterator<std::forward_iterator_tag, std::pair<size_t, size_t>> {
+        public:
+            const std::pair<size_t, size_t>& operator*() const noexcept { return m_value; }
+            const std::pair<size_t, size_t>* operator->() const noexcept { return &m_value; }
+            bool operator==(iterator const& it) const noexcept { return m_remaining == it.m_remaining; }
+            bool operator!=(iterator const& it) const noexcept { return m_remaining != it.m_remaining; }
+            iterator& operator++() noexcept;
+            iterator operator++(int) noexcept { auto value = *this; ++*this; return value; }
+
+        private:
+            const char* m_pos = nullptr;
+            size_t m_remaining = 0;
+            std::pair<size_t, size_t> m_value;
+
+            iterator(const char* pos, size_t count) noexcept;
+            void read_next() noexcept;
+            friend class Ranges;
+        };
+
+        iterator begin() const noexcept { return {m_begin, m_count}; }
+        iterator end() const noexcept { return {nullptr, 0}; }
+
+        // The number of ranges (not indices) in the set
+        size_t size() const noexcept { return m_count; }
+        bool empty() const noexcept { return m_count == 0; }
+
+        IndexSet to_index_set() const;
+
+    private:
+        const char* m_begin = nullptr;
+        size_t m_count = 0;
+        friend class CollectionChangeSetReader;
+    };
+
+    // The encoded moves, which can be iterated over as CollectionChangeSet::Move
+    class Moves {
+    public:
+        class iterator : public std::iterator<std::forward_iterator_tag, CollectionChangeSet::Move> {
+        public:
+            const CollectionChangeSet::Move& operator*() const noexcept { return m_value; }
+            const CollectionChangeSet::Move* operator->() const noexcept { return &m_value; }
+            bool operator==(iterator const& it) const noexcept { return m_remaining == it.m_remaining; }
+            bool operator!=(iterator const& it) const noexcept { return m_remaining != it.m_remaining; }
+            iterator& operator++() noexcept;
+            iterator operator++(int) noexcept { auto value = *this; ++*this; return value; }
+
+        private:
+            const char* m_pos = nullptr;
+            size_t m_remaining = 0;
+            CollectionChangeSet::Move m_value;
+
+            iterator(const char* pos, size_t count) noexcept;
+            void read_next() noexcept;
+            friend class Moves;
+        };
+
+        iterator begin() const noexcept { return {m_begin, m_count}; }
+        iterator end() const noexcept { return {nullptr, 0}; }
+        size_t size() const noexcept { return m_count; }
+        bool empty() const noexcept { return m_count == 0; }
+
+    private:
+        const char* m_begin = nullptr;
+        size_t m_count = 0;
+        friend class CollectionChangeSetReader;
+    };
+
+    Ranges const& deletions() const noexcept { return m_deletions; }
+    Ranges const& insertions() const noexcept { return m_insertions; }
+    Ranges const& modifications() const noexcept { return m_modifications; }
+    Ranges const& modifications_new() const noexcept { return m_modifications_new; }
+    Moves const& moves() const noexcept { return m_moves; }
+    std::vector<Ranges> const& columns() const noexcept { return m_columns; }
+
+    // Decode the entire change set
+    CollectionChangeSet read() const;
+
+private:
+    Ranges m_deletions;
+    Ranges m_insertions;
+    Ranges m_modifications;
+    Ranges m_modifications_new;
+    Moves m_moves;
+    std::vector<Ranges> m_columns;
+};
+} // namespace realm
+
+#endif // REALM_COLLECTION_CHANGE_ENCODING_HPP
@@ -59,3 +59,15 @@ void NotificationToken::suppress_next()
 {
     m_notifier.load()->suppress_next_notification(m_token);
 }
+
+void NotificationToken::pause()
+{
+    if (auto notifier = m_notifier.load())
+        notifier->pause_callback(m_token);
+}
+
+void NotificationToken::resume()
+{
+    if (auto notifier = m_notifier.load())
+        notifier->resume_callback(m_token);
+}
@@ -46,11 +46,28 @@ struct NotificationToken {
 
     void suppress_next();
 
+    // Stop calling the callback until resume() is called, without discarding
+    // the notifier. While paused the notifier doesn't calculate changes for
+    // this callback, and if there are no other callbacks it stops rerunning
+    // its query entirely. After resuming, the callback is next called with an
+    // empty change set once the notifier has caught up, in the same way as
+    // for the initial notification, and should reread the whole collection.
+    void pause();
+    void resume();
+
 private:
     util::AtomicSharedPtr<_impl::CollectionNotifier> m_notifier;
     uint64_t m_token;
 };
 
+// How urgently the notifications for a collection are needed. Notifiers whose
+// callbacks are all Background are run after all of the others, and the
+// interactive notifications are delivered without waiting for them.
+enum class NotificationPriority {
+    Interactive,
+    Background,
+};
+
 struct CollectionChangeSet {
     struct Move {
         size_t from;
@@ -93,6 +110,17 @@ struct CollectionChangeSet {
         return deletions.empty() && insertions.empty() && modifications.empty()
             && modifications_new.empty() && moves.empty();
     }
+
+    // The number of bytes allocated on the heap by this change set
+    size_t heap_size() const noexcept
+    {
+        size_t size = deletions.heap_size() + insertions.heap_size() + modifications.heap_size()
+                    + modifications_new.heap_size() + moves.capacity() * sizeof(Move)
+                    + columns.capacity() * sizeof(IndexSet);
+        for (auto& column : columns)
+            size += column.heap_size();
+        return size;
+    }
 };
 
 // A type-erasing wrapper for the callback for collection notifications. Can be
@@ -27,6 +27,7 @@
 #endif
 
 #include <cstring>
+#include <functional>
 #include <thread>
 
 #include <realm/util/assert.hpp>
@@ -120,4 +121,15 @@ struct AnyExecutionContextID::TypeForStorageType<AbstractExecutionContextID> {
 
 } // namespace realm
 
+namespace std {
+template<> struct hash<realm::AnyExecutionContextID> {
+    size_t operator()(realm::AnyExecutionContextID const& id) const
+    {
+        if (id.contains<std::thread::id>())
+            return hash<std::thread::id>()(id.get<std::thread::id>());
+        return hash<realm::AbstractExecutionContextID>()(id.get<realm::AbstractExecutionContextID>());
+    }
+};
+}
+
 #endif // REALM_OS_EXECUTION_CONTEXT_ID_HPP
@@ -24,6 +24,9 @@
 
 #include <Security/Security.h>
 
+#include <chrono>
+#include <future>
+#include <mutex>
 #include <string>
 
 using realm::util::CFPtr;
@@ -106,9 +109,7 @@ void set_key(const std::vector<char>& key, CFStringRef account, CFStringRef serv
         throw KeychainAccessException(status);
 }
 
-}   // anonymous namespace
-
-std::vector<char> metadata_realm_encryption_key(bool check_legacy_service)
+std::vector<char> read_metadata_realm_encryption_key(bool check_legacy_service)
 {
     CFStringRef account = CFSTR("metadata");
     CFStringRef legacy_service = CFSTR("io.realm.sync.keychain");
@@ -139,5 +140,93 @@ std::vector<char> metadata_realm_encryption_key(bool check_legacy_service)
     return key;
 }
 
+// The metadata Realm's key, which is read from the keychain at most once per
+// process unless the cache is cleared. The keychain is accessed via IPC, so
+// this avoids a round-trip each time the metadata Realm is opened.
+struct KeyCache {
+    std::mutex mutex;
+    std::shared_future<std::vector<char>> key;
+    // Incremented whenever `key` is replaced
+    uint64_t generation = 0;
+};
+
+KeyCache& key_cache()
+{
+    // Never destroyed, as a prefetch may still be running at exit
+    static KeyCache& cache = *new KeyCache;
+    return cache;
+}
+
+// precondition: cache.mutex is locked
+void start_reading_key(KeyCache& cache, bool check_legacy_service, std::launch policy)
+{
+    if (!cache.key.valid()) {
+        cache.key = std::async(policy, read_metadata_realm_encryption_key, check_legacy_service).share();
+        ++cache.generation;
+    }
+}
+
+}   // anonymous namespace
+
+std::vector<char> metadata_realm_encryption_key(bool check_legacy_service)
+{
+    auto& cache = key_cache();
+    std::shared_future<std::vector<char>> key;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        start_reading_key(cache, check_legacy_service, std::launch::deferred);
+        key = cache.key;
+        generation = cache.generation;
+    }
+
+    try {
+        return key.get();
+    }
+    catch (...) {
+        // Don't cache failures, so that the next call tries again
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if (cache.generation == generation) {
+            cache.key = {};
+            ++cache.generation;
+        }
+        throw;
+    }
+}
+
+void prefetch_metadata_realm_encryption_key(bool check_legacy_service)
+{
+    auto& cache = key_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    start_reading_key(cache, check_legacy_service, std::launch::async);
+}
+
+void clear_cached_metadata_realm_encryption_key()
+{
+    auto& cache = key_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (!cache.key.valid())
+        return;
+    // A deferred read which never ran has no key to overwrite, and waiting on
+    // it would run it
+    if (cache.key.wait_for(std::chrono::seconds(0)) == std::future_status::deferred) {
+        cache.key = {};
+        ++cache.generation;
+        return;
+    }
+    try {
+        // The shared state owns a non-const vector; get() only exposes it as const
+        auto& key = const_cast<std::vector<char>&>(cache.key.get());
+        volatile char* data = key.data();
+        for (size_t i = 0; i < key.size(); ++i)
+            data[i] = 0;
+    }
+    catch (...) {
+        // Reading the key failed, so there's nothing to overwrite
+    }
+    cache.key = {};
+    ++cache.generation;
+}
+
 }   // keychain
 }   // realm
@@ -26,8 +26,20 @@
 namespace realm {
 namespace keychain {
 
+// Get the encryption key for the sync metadata Realm, creating and storing
+// one in the keychain if there isn't one yet. The key is read from the
+// keychain only once and then cached in memory until
+// clear_cached_metadata_realm_encryption_key() is called.
 std::vector<char> metadata_realm_encryption_key(bool check_legacy_service);
 
+// Start reading the metadata Realm's encryption key on a background thread, so
+// that a later call to metadata_realm_encryption_key() doesn't have to wait
+// for the keychain. Does nothing if the key is already cached or being read.
+void prefetch_metadata_realm_encryption_key(bool check_legacy_service);
+
+// Discard the cached key, overwriting the in-memory copy of it.
+void clear_cached_metadata_realm_encryption_key();
+
 class KeychainAccessException : public std::runtime_error {
 public:
     KeychainAccessException(int32_t error_code);
@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "impl/change_journal.hpp"
+
+#include <atomic>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace realm;
+using namespace realm::_impl;
+
+namespace {
+// Bumped whenever the layout of SharedState changes, so that processes using
+// different layouts don't misread each other's entries
+constexpr uint32_t journal_format = 2;
+// Set while the first process to open the file is stamping it
+constexpr uint32_t initializing_format = uint32_t(-1);
+
+// Bits in Slot::flags
+constexpr uint32_t other_tables_flag = 1;
+constexpr uint32_t schema_changed_flag = 2;
+} // anonymous namespace
+
+// Each commit's summary is stored in the slot for version % slot_count. The
+// slot is marked as not holding any version while it's being written, and
+// readers check that the version is the same before and after reading the
+// rest of the slot, so that they never use a partially written summary.
+struct ChangeJournal::SharedState {
+    struct Slot {
+        // Non-zero while a process is writing to the slot. Writers which find
+        // the slot busy just don't publish their commit rather than waiting,
+        // so a process which exits while writing only loses that slot.
+        std::atomic<uint32_t> writing;
+        std::atomic<uint32_t> flags;
+        // The version whose summary is in the slot, or zero if none is
+        std::atomic<uint64_t> version;
+        std::atomic<uint64_t> tables[table_words];
+    };
+
+    // Zero in a newly created file, and set by the first process to open it
+    std::atomic<uint32_t> format;
+    // The identity of the Realm file whose commits are in the journal. Each
+    // new file at the path starts again at the same versions, so a journal
+    // left over from an earlier file would describe the wrong commits.
+    std::atomic<uint64_t> file_device;
+    std::atomic<uint64_t> file_inode;
+    Slot slots[slot_count];
+};
+
+#ifndef _WIN32
+namespace {
+void stamp(ChangeJournal::SharedState& shared, struct stat const& realm_stat) noexcept
+{
+    for (auto& slot : shared.slots)
+        slot.version.store(0, std::memory_order_relaxed);
+    shared.file_device.store(realm_stat.st_dev, std::memory_order_relaxed);
+    shared.file_inode.store(realm_stat.st_ino, std::memory_order_release);
+}
+
+bool is_for(ChangeJournal::SharedState const& shared, struct stat const& realm_stat) noexcept
+{
+    return shared.file_inode.load(std::memory_order_acquire) == static_cast<uint64_t>(realm_stat.st_ino)
+        && shared.file_device.load(std::memory_order_relaxed) == static_cast<uint64_t>(realm_stat.st_dev);
+}
+} // anonymous namespace
+#endif
+
+void ChangeJournal::Summary::add_table(size_t table_ndx) noexcept
+{
+    if (table_ndx < table_words * 64)
+        tables[table_ndx / 64] |= uint64_t(1) << (table_ndx % 64);
+    else
+        other_tables = true;
+}
+
+std::unique_ptr<ChangeJournal> ChangeJournal::open(std::string const& realm_path)
+{
+#ifdef _WIN32
+    static_cast<void>(realm_path);
+    return nullptr;
+#else
+    struct stat realm_stat;
+    if (stat(realm_path.c_str(), &realm_stat) != 0)
+        return nullptr;
+
+    std::string path = journal_path(realm_path);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat stat_buf;
+    // Newly-created files are zero-filled by ftruncate(), which is the
+    // correct initial state
+    if (fstat(fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)
+        || (static_cast<size_t>(stat_buf.st_size) < sizeof(SharedState) && ftruncate(fd, sizeof(SharedState)) != 0)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* addr = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced, so the descriptor isn't needed
+    close(fd);
+    if (addr == MAP_FAILED)
+        return nullptr;
+
+    auto shared = static_cast<SharedState*>(addr);
+    uint32_t format = 0;
+    if (shared->format.compare_exchange_strong(format, initializing_format)) {
+        stamp(*shared, realm_stat);
+        shared->format.store(journal_format, std::memory_order_release);
+        format = journal_format;
+    }
+    // A journal which is still being stamped by another process is skipped
+    // rather than waited for, as that process could have exited midway
+    if (format != journal_format) {
+        munmap(addr, sizeof(SharedState));
+        return nullptr;
+    }
+    if (!is_for(*shared, realm_stat))
+        stamp(*shared, realm_stat);
+    return std::unique_ptr<ChangeJournal>(new ChangeJournal(shared));
+#endif
+}
+
+void ChangeJournal::reset(std::string const& realm_path) noexcept
+{
+#ifndef _WIN32
+    struct stat realm_stat;
+    if (stat(realm_path.c_str(), &realm_stat) == 0)
+        stamp(*m_shared, realm_stat);
+#else
+    static_cast<void>(realm_path);
+#endif
+}
+
+std::string ChangeJournal::journal_path(std::string const& realm_path)
+{
+    return realm_path + ".journal";
+}
+
+ChangeJournal::~ChangeJournal()
+{
+#ifndef _WIN32
+    munmap(m_shared, sizeof(SharedState));
+#endif
+}
+
+void ChangeJournal::publish(uint_fast64_t version, Summary const& changes) noexcept
+{
+    auto& slot = m_shared->slots[version % slot_count];
+    uint32_t idle = 0;
+    if (!slot.writing.compare_exchange_strong(idle, 1, std::memory_order_acquire))
+        return;
+
+    slot.version.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.flags.store((changes.other_tables ? other_tables_flag : 0) | (changes.schema_changed ? schema_changed_flag : 0),
+                     std::memory_order_relaxed);
+    for (size_t i = 0; i < table_words; ++i)
+        slot.tables[i].store(changes.tables[i], std::memory_order_relaxed);
+    slot.version.store(version, std::memory_order_release);
+
+    slot.writing.store(0, std::memory_order_release);
+}
+
+bool ChangeJournal::unchanged(uint_fast64_t from_version, uint_fast64_t to_version,
+                              Summary const& tables) const noexcept
+{
+    if (tables.other_tables || to_version <= from_version || to_version - from_version > slot_count)
+        return false;
+
+    for (auto version = from_version + 1; version <= to_version; ++version) {
+        auto& slot = m_shared->slots[version % slot_count];
+        if (slot.version.load(std::memory_order_acquire) != version)
+            return false;
+        uint32_t flags = slot.flags.load(std::memory_order_relaxed);
+        bool overlaps = false;
+        for (size_t i = 0; i < table_words; ++i)
+            overlaps |= (slot.tables[i].load(std::memory_order_relaxed) & tables.tables[i]) != 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Overwritten by a newer commit while we were reading it
+        if (slot.version.load(std::memory_order_relaxed) != version)
+            return false;
+        if (flags != 0 || overlaps)
+            return false;
+    }
+    return true;
+}
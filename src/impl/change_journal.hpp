@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_CHANGE_JOURNAL_HPP
+#define REALM_CHANGE_JOURNAL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace realm {
+namespace _impl {
+// A record of which tables were modified by each recent commit to a Realm
+// file, shared by every process which has the file open via a memory-mapped
+// file next to it. The process making a commit publishes a summary of it, so
+// that the notifiers in other processes can skip observing the transaction
+// logs for commits which didn't touch any of the tables they care about.
+//
+// The journal only ever says that a commit is irrelevant: a commit which
+// hasn't been published (because it was made by a process without the
+// journal enabled, or because it's too old to still be in the journal) is
+// treated as touching everything, so every process which writes to the file
+// must have the journal enabled for it to be of any use.
+class ChangeJournal {
+public:
+    // The number of recent commits which are retained
+    static constexpr size_t slot_count = 256;
+    // Commits which modify tables beyond the first table_words * 64 are
+    // treated as modifying every table
+    static constexpr size_t table_words = 2;
+
+    // The tables modified by a commit, or needed by an observer
+    struct Summary {
+        std::array<uint64_t, table_words> tables{};
+        // Set if a table which doesn't fit in `tables` is included
+        bool other_tables = false;
+        bool schema_changed = false;
+
+        void add_table(size_t table_ndx) noexcept;
+    };
+
+    // Open the journal for the Realm file at `realm_path`, creating it if
+    // needed. A journal which was written for a different file at the same
+    // path is cleared first. Returns null if it could not be opened or was
+    // created by an incompatible version, in which case changes should just
+    // be calculated without it.
+    static std::unique_ptr<ChangeJournal> open(std::string const& realm_path);
+
+    // The path of the journal for the Realm file at `realm_path`, which
+    // should be deleted along with the Realm file
+    static std::string journal_path(std::string const& realm_path);
+
+    // Clear the journal and stamp it with the identity of the file now at
+    // `realm_path`, after the Realm file has been deleted and recreated
+    void reset(std::string const& realm_path) noexcept;
+    ~ChangeJournal();
+
+    ChangeJournal(ChangeJournal const&) = delete;
+    ChangeJournal& operator=(ChangeJournal const&) = delete;
+
+    // Record the tables modified by the commit which produced `version`
+    void publish(uint_fast64_t version, Summary const& changes) noexcept;
+
+    // Check if every commit after `from_version` up to and including
+    // `to_version` has been published, and none of them changed the schema
+    // or modified any of the tables in `tables`
+    bool unchanged(uint_fast64_t from_version, uint_fast64_t to_version, Summary const& tables) const noexcept;
+
+    struct SharedState;
+
+private:
+    ChangeJournal(SharedState* shared) : m_shared(shared) { }
+
+    SharedState* m_shared;
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_CHANGE_JOURNAL_HPP
@@ -504,6 +504,18 @@ void CollectionChangeBuilder::move_column(size_t from, size_t to)
         std::rotate(begin(columns) + to, begin(columns) + from, begin(columns) + from + 1);
 }
 
+void CollectionChangeBuilder::shrink_to_fit()
+{
+    deletions.shrink_to_fit();
+    insertions.shrink_to_fit();
+    modifications.shrink_to_fit();
+    modifications_new.shrink_to_fit();
+    moves.shrink_to_fit();
+    for (auto& column : columns)
+        column.shrink_to_fit();
+    columns.shrink_to_fit();
+}
+
 namespace {
 struct RowInfo {
     size_t row_index;
@@ -702,6 +714,55 @@ private:
     }
 };
 
+// Above this many rows which may have moved, calculate_moves_sorted() switches
+// from the LCS-based block matching, which produces nicer diffs but is O(N^2) in
+// the worst case, to calculate_moves_lis(), which is O(N log N)
+const size_t max_rows_for_block_matching = 1000;
+
+// Calculates the insertions/deletions required to turn the old order of
+// `rows` into the new order by finding the longest increasing subsequence of
+// the new positions when the rows are arranged in their old order. The rows in
+// that subsequence stay in place and every other row is reported as moved.
+// `rows` must be sorted by new TV index.
+void calculate_moves_lis(std::vector<RowInfo> const& rows, CollectionChangeSet& changeset)
+{
+    // The position in `rows` of each row, ordered by the row's previous TV index
+    std::vector<size_t> positions(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+        positions[i] = i;
+    std::sort(begin(positions), end(positions), [&](size_t lft, size_t rgt) {
+        return rows[lft].prev_tv_index < rows[rgt].prev_tv_index;
+    });
+
+    // Patience sorting: tails[k] is the index into `positions` of the smallest
+    // value which ends an increasing subsequence of length k + 1, and
+    // predecessors[i] is the index of the element before `i` in the longest
+    // subsequence ending at `i`
+    std::vector<size_t> tails;
+    std::vector<size_t> predecessors(positions.size(), IndexSet::npos);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        auto it = std::lower_bound(begin(tails), end(tails), positions[i],
+                                   [&](size_t tail, size_t value) { return positions[tail] < value; });
+        if (it != begin(tails))
+            predecessors[i] = *(it - 1);
+        if (it == end(tails))
+            tails.push_back(i);
+        else
+            *it = i;
+    }
+
+    std::vector<bool> stays(rows.size(), false);
+    for (size_t i = tails.empty() ? IndexSet::npos : tails.back(); i != IndexSet::npos; i = predecessors[i])
+        stays[positions[i]] = true;
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!stays[i]) {
+            changeset.deletions.add(rows[i].prev_tv_index);
+            changeset.insertions.add(rows[i].tv_index);
+        }
+    }
+}
+
 void calculate_moves_sorted(std::vector<RowInfo>& rows, CollectionChangeSet& changeset)
 {
     // The RowInfo array contains information about the old and new TV indices of
@@ -729,6 +790,11 @@ void calculate_moves_sorted(std::vector<RowInfo>& rows, CollectionChangeSet& cha
     if (first_difference == IndexSet::npos)
         return;
 
+    if (rows.size() - first_difference > max_rows_for_block_matching) {
+        calculate_moves_lis(rows, changeset);
+        return;
+    }
+
     // Note that `b` is sorted by row_index, while `a` is sorted by tv_index
     b.reserve(rows.size());
     for (size_t i = 0; i < rows.size(); ++i)
@@ -77,6 +77,9 @@ public:
     void insert_column(size_t ndx);
     void move_column(size_t from, size_t to);
 
+    // Release unused capacity held by the accumulated changes
+    void shrink_to_fit();
+
 private:
     std::unordered_map<size_t, size_t> m_move_mapping;
     bool m_track_columns = true;
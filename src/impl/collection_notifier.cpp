@@ -18,15 +18,217 @@
 
 #include "impl/collection_notifier.hpp"
 
+#include "impl/notification_trace_span.hpp"
 #include "impl/realm_coordinator.hpp"
+#include "object_schema.hpp"
+#include "object_store.hpp"
+#include "property.hpp"
+#include "schema.hpp"
 #include "shared_realm.hpp"
 
 #include <realm/group_shared.hpp>
 #include <realm/link_view.hpp>
+#include <realm/util/format.hpp>
+
+#include <algorithm>
 
 using namespace realm;
 using namespace realm::_impl;
 
+TableBitset::TableBitset(std::vector<bool> const& bits)
+{
+    resize(bits.size());
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i])
+            set(i);
+    }
+}
+
+void TableBitset::assign(size_t ndx, bool value)
+{
+    uint64_t mask = uint64_t(1) << (ndx % bits_per_word);
+    if (value)
+        m_words[ndx / bits_per_word] |= mask;
+    else
+        m_words[ndx / bits_per_word] &= ~mask;
+}
+
+void TableBitset::resize(size_t size, bool value)
+{
+    size_t old_size = m_size;
+    m_words.resize((size + bits_per_word - 1) / bits_per_word, 0);
+    m_size = size;
+    if (size < old_size) {
+        // Keep the bits past the end cleared so that any() can check whole words
+        if (size % bits_per_word)
+            m_words.back() &= (uint64_t(1) << (size % bits_per_word)) - 1;
+        return;
+    }
+    if (value) {
+        for (size_t i = old_size; i < size; ++i)
+            assign(i, true);
+    }
+}
+
+void TableBitset::set(size_t ndx)
+{
+    if (ndx >= m_size)
+        resize(ndx + 1);
+    assign(ndx, true);
+}
+
+bool TableBitset::any() const noexcept
+{
+    return std::any_of(m_words.begin(), m_words.end(), [](uint64_t word) { return word != 0; });
+}
+
+void TableBitset::insert(size_t ndx)
+{
+    if (ndx >= m_size)
+        return;
+    resize(m_size + 1);
+    for (size_t i = m_size - 1; i > ndx; --i)
+        assign(i, (*this)[i - 1]);
+    assign(ndx, false);
+}
+
+void TableBitset::move(size_t from, size_t to)
+{
+    REALM_ASSERT(from != to);
+    if (from >= m_size && to >= m_size)
+        return;
+    if (from >= m_size || to >= m_size)
+        resize(std::max(from, to) + 1);
+    bool value = (*this)[from];
+    if (from < to) {
+        for (size_t i = from; i < to; ++i)
+            assign(i, (*this)[i + 1]);
+    }
+    else {
+        for (size_t i = from; i > to; --i)
+            assign(i, (*this)[i - 1]);
+    }
+    assign(to, value);
+}
+
+TableChanges::TableChanges(TableChanges const& other)
+{
+    *this = other;
+}
+
+TableChanges& TableChanges::operator=(TableChanges const& other)
+{
+    if (this != &other) {
+        m_tables.clear();
+        m_blocks.clear();
+        m_blocks_used = m_block_used = 0;
+        m_tables.reserve(other.m_tables.size());
+        for (auto& entry : other.m_tables) {
+            auto& changes = allocate();
+            changes = *entry.changes;
+            m_tables.push_back({entry.table_ndx, &changes});
+        }
+    }
+    return *this;
+}
+
+CollectionChangeBuilder& TableChanges::allocate()
+{
+    if (m_blocks_used == 0 || m_block_used == block_size(m_blocks_used - 1)) {
+        if (m_blocks_used == m_blocks.size())
+            m_blocks.push_back(std::make_unique<CollectionChangeBuilder[]>(block_size(m_blocks_used)));
+        ++m_blocks_used;
+        m_block_used = 0;
+    }
+    return m_blocks[m_blocks_used - 1][m_block_used++];
+}
+
+void TableChanges::clear()
+{
+    // Every builder handed out is in m_tables, so this resets all of them
+    for (auto& entry : m_tables)
+        *entry.changes = CollectionChangeBuilder{};
+    m_tables.clear();
+    m_blocks_used = m_block_used = 0;
+}
+
+std::vector<TableChanges::Entry>::const_iterator TableChanges::lower_bound(size_t table_ndx) const noexcept
+{
+    return std::lower_bound(m_tables.begin(), m_tables.end(), table_ndx,
+                            [](auto const& entry, size_t ndx) { return entry.table_ndx < ndx; });
+}
+
+CollectionChangeBuilder const* TableChanges::find(size_t table_ndx) const noexcept
+{
+    auto it = lower_bound(table_ndx);
+    return it != m_tables.end() && it->table_ndx == table_ndx ? it->changes : nullptr;
+}
+
+CollectionChangeBuilder* TableChanges::find(size_t table_ndx) noexcept
+{
+    return const_cast<CollectionChangeBuilder*>(static_cast<TableChanges const&>(*this).find(table_ndx));
+}
+
+CollectionChangeBuilder const& TableChanges::operator[](size_t table_ndx) const noexcept
+{
+    static const CollectionChangeBuilder no_changes;
+    auto changes = find(table_ndx);
+    return changes ? *changes : no_changes;
+}
+
+CollectionChangeBuilder& TableChanges::get(size_t table_ndx)
+{
+    auto it = m_tables.begin() + (lower_bound(table_ndx) - m_tables.cbegin());
+    if (it == m_tables.end() || it->table_ndx != table_ndx)
+        it = m_tables.insert(it, {table_ndx, &allocate()});
+    return *it->changes;
+}
+
+void TableChanges::insert_table(size_t ndx)
+{
+    for (auto& entry : m_tables) {
+        if (entry.table_ndx >= ndx)
+            ++entry.table_ndx;
+    }
+}
+
+void TableChanges::move_table(size_t from, size_t to)
+{
+    for (auto& entry : m_tables) {
+        if (entry.table_ndx == from)
+            entry.table_ndx = to;
+        else if (entry.table_ndx > from && entry.table_ndx <= to)
+            --entry.table_ndx;
+        else if (entry.table_ndx < from && entry.table_ndx >= to)
+            ++entry.table_ndx;
+    }
+    std::sort(m_tables.begin(), m_tables.end(),
+              [](auto const& a, auto const& b) { return a.table_ndx < b.table_ndx; });
+}
+
+void TableChanges::merge(TableChanges const& other)
+{
+    for (auto& entry : other.m_tables) {
+        if (!entry.changes->empty())
+            get(entry.table_ndx).merge(CollectionChangeBuilder{*entry.changes});
+    }
+}
+
+void TransactionChangeInfo::clear()
+{
+    table_modifications_needed.resize(0);
+    table_moves_needed.resize(0);
+    lists.clear();
+    tables.clear();
+    column_indices.clear();
+    table_indices.clear();
+    track_all = false;
+    schema_changed = false;
+    changes_unknown = false;
+    deep_modified.clear();
+    deep_not_modified.clear();
+}
+
 std::function<bool (size_t)>
 CollectionNotifier::get_modification_checker(TransactionChangeInfo const& info,
                                              Table const& root_table)
@@ -34,25 +236,55 @@ CollectionNotifier::get_modification_checker(TransactionChangeInfo const& info,
     if (info.schema_changed)
         set_table(root_table);
 
+    if (info.changes_unknown)
+        return [](size_t) { return true; };
+
+    m_active_key_path_filter = key_path_filter(info);
+    auto related_tables_ptr = m_active_key_path_filter ? m_active_key_path_filter.get() : m_related_tables.get();
+
     // First check if any of the tables accessible from the root table were
     // actually modified. This can be false if there were only insertions, or
     // deletions which were not linked to by any row in the linking table
     auto table_modified = [&](auto& tbl) {
-        return tbl.table_ndx < info.tables.size()
-            && !info.tables[tbl.table_ndx].modifications.empty();
+        return !info.tables[tbl.table_ndx].modifications.empty();
     };
-    if (!any_of(begin(m_related_tables), end(m_related_tables), table_modified)) {
+    if (!related_tables_ptr || !any_of(begin(*related_tables_ptr), end(*related_tables_ptr), table_modified)) {
         return [](size_t) { return false; };
     }
-    if (m_related_tables.size() == 1) {
-        auto& modifications = info.tables[m_related_tables[0].table_ndx].modifications;
+    auto& related_tables = *related_tables_ptr;
+    if (related_tables.size() == 1 && !m_active_key_path_filter) {
+        auto& modifications = info.tables[related_tables[0].table_ndx].modifications;
         return [&](size_t row) { return modifications.contains(row); };
     }
 
-    return DeepChangeChecker(info, root_table, m_related_tables);
+    return DeepChangeChecker(info, root_table, related_tables);
+}
+
+IndexSet const* CollectionNotifier::get_shallow_modifications(TransactionChangeInfo const& info,
+                                                             Table const& root_table)
+{
+    if (info.schema_changed)
+        set_table(root_table);
+
+    if (info.changes_unknown || key_path_filter(info) || !m_related_tables || m_related_tables->size() != 1)
+        return nullptr;
+    return &info.tables[(*m_related_tables)[0].table_ndx].modifications;
 }
 
-void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Table const& table)
+std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>>
+CollectionNotifier::key_path_filter(TransactionChangeInfo const& info)
+{
+    // The filters were resolved to table and column indices using the schema
+    // at the time, so just check everything once it changes
+    if (info.schema_changed)
+        m_key_paths_invalidated = true;
+    if (m_key_paths_invalidated)
+        return nullptr;
+    return m_key_path_filter.load();
+}
+
+void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Table const& table,
+                                            std::vector<std::string> const& untracked_types)
 {
     auto table_ndx = table.get_index_in_group();
     if (table_ndx == npos)
@@ -70,30 +302,125 @@ void DeepChangeChecker::find_related_tables(std::vector<RelatedTable>& out, Tabl
     for (size_t i = 0, count = table.get_column_count(); i != count; ++i) {
         auto type = table.get_column_type(i);
         if (type == type_Link || type == type_LinkList) {
+            auto target = table.get_link_target(i);
+            if (!untracked_types.empty()) {
+                std::string object_type = ObjectStore::object_type_for_table_name(target->get_name());
+                if (std::find(untracked_types.begin(), untracked_types.end(), object_type) != untracked_types.end())
+                    continue;
+            }
             out[out_index].links.push_back({i, type == type_LinkList});
-            find_related_tables(out, *table.get_link_target(i));
+            find_related_tables(out, *target, untracked_types);
         }
     }
 }
 
+template<typename T>
+static void add_unique(std::vector<T>& out, T const& value)
+{
+    if (find(begin(out), end(out), value) == end(out))
+        out.push_back(value);
+}
+
+static bool operator==(DeepChangeChecker::OutgoingLink const& a, DeepChangeChecker::OutgoingLink const& b)
+{
+    return a.col_ndx == b.col_ndx && a.is_list == b.is_list;
+}
+
+static DeepChangeChecker::RelatedTable& related_table_for(std::vector<DeepChangeChecker::RelatedTable>& tables,
+                                                          size_t table_ndx)
+{
+    auto it = find_if(begin(tables), end(tables), [=](auto& tbl) { return tbl.table_ndx == table_ndx; });
+    if (it != end(tables))
+        return *it;
+    tables.push_back({table_ndx, {}, {}});
+    return tables.back();
+}
+
+std::vector<DeepChangeChecker::RelatedTable>
+DeepChangeChecker::find_related_tables(Realm& realm, ObjectSchema const& object_schema,
+                                       std::vector<std::string> const& key_paths)
+{
+    std::vector<RelatedTable> out;
+    auto& group = realm.read_group();
+    for (auto& key_path : key_paths) {
+        ObjectSchema const* current = &object_schema;
+        size_t start = 0;
+        while (true) {
+            size_t end = key_path.find('.', start);
+            auto name = key_path.substr(start, end == std::string::npos ? end : end - start);
+            auto prop = current->property_for_public_name(name);
+            if (!prop)
+                throw InvalidPropertyException(current->name, name);
+            if (prop->type == PropertyType::LinkingObjects)
+                throw std::logic_error(util::format("Key path '%1' includes linking objects property '%2.%3', which cannot be observed.",
+                                                    key_path, current->name, prop->name));
+
+            auto table = ObjectStore::table_for_object_type(group, current->name);
+            REALM_ASSERT(table);
+            size_t table_ndx = table->get_index_in_group();
+            add_unique(related_table_for(out, table_ndx).columns, prop->table_column);
+            if (end == std::string::npos)
+                break;
+
+            if ((prop->type & ~PropertyType::Flags) != PropertyType::Object)
+                throw std::logic_error(util::format("Key path '%1' continues past property '%2.%3', which is not a link.",
+                                                    key_path, current->name, prop->name));
+            add_unique(related_table_for(out, table_ndx).links, OutgoingLink{prop->table_column, is_array(prop->type)});
+            current = &*realm.schema().find(prop->object_type);
+            start = end + 1;
+        }
+    }
+    return out;
+}
+
+void DeepChangeChecker::merge_related_tables(std::vector<RelatedTable>& out, std::vector<RelatedTable> const& tables)
+{
+    for (auto& table : tables) {
+        auto& merged = related_table_for(out, table.table_ndx);
+        for (auto& link : table.links)
+            add_unique(merged.links, link);
+        for (auto col : table.columns)
+            add_unique(merged.columns, col);
+    }
+}
+
 DeepChangeChecker::DeepChangeChecker(TransactionChangeInfo const& info,
                                      Table const& root_table,
                                      std::vector<RelatedTable> const& related_tables)
 : m_info(info)
 , m_root_table(root_table)
 , m_root_table_ndx(root_table.get_index_in_group())
-, m_root_modifications(m_root_table_ndx < info.tables.size() ? &info.tables[m_root_table_ndx].modifications : nullptr)
+, m_root_modifications(info.tables.find(m_root_table_ndx) ? &info.tables[m_root_table_ndx].modifications : nullptr)
 , m_related_tables(related_tables)
+, m_filtered(any_of(begin(related_tables), end(related_tables), [](auto& tbl) { return !tbl.columns.empty(); }))
+{
+}
+
+DeepChangeChecker::RelatedTable const* DeepChangeChecker::related_table(size_t table_ndx) const
+{
+    auto it = find_if(begin(m_related_tables), end(m_related_tables),
+                      [&](auto&& tbl) { return tbl.table_ndx == table_ndx; });
+    return it == m_related_tables.end() ? nullptr : &*it;
+}
+
+bool DeepChangeChecker::row_modified(RelatedTable const* related_table, size_t table_ndx, size_t row_ndx) const
 {
+    auto& changes = m_info.tables[table_ndx];
+    if (!changes.modifications.contains(row_ndx))
+        return false;
+    if (!related_table || related_table->columns.empty())
+        return true;
+    return any_of(begin(related_table->columns), end(related_table->columns), [&](size_t col) {
+        return col < changes.columns.size() && changes.columns[col].contains(row_ndx);
+    });
 }
 
 bool DeepChangeChecker::check_outgoing_links(size_t table_ndx,
                                              Table const& table,
                                              size_t row_ndx, size_t depth)
 {
-    auto it = find_if(begin(m_related_tables), end(m_related_tables),
-                      [&](auto&& tbl) { return tbl.table_ndx == table_ndx; });
-    if (it == m_related_tables.end())
+    auto it = related_table(table_ndx);
+    if (!it)
         return false;
 
     // Check if we're already checking if the destination of the link is
@@ -146,29 +473,46 @@ bool DeepChangeChecker::check_row(Table const& table, size_t idx, size_t depth)
     }
 
     size_t table_ndx = table.get_index_in_group();
-    if (depth > 0 && table_ndx < m_info.tables.size() && m_info.tables[table_ndx].modifications.contains(idx))
+    if (depth > 0 && row_modified(m_filtered ? related_table(table_ndx) : nullptr, table_ndx, idx))
         return true;
 
-    if (m_not_modified.size() <= table_ndx)
-        m_not_modified.resize(table_ndx + 1);
-    if (m_not_modified[table_ndx].contains(idx))
+    auto& not_modified = m_filtered ? m_not_modified : m_info.deep_not_modified;
+    auto& modified = m_filtered ? m_modified : m_info.deep_modified;
+    if (not_modified.size() <= table_ndx) {
+        not_modified.resize(table_ndx + 1);
+        modified.resize(table_ndx + 1);
+    }
+    if (not_modified[table_ndx].contains(idx))
         return false;
+    if (modified[table_ndx].contains(idx))
+        return true;
 
+    // A modification found along any path is valid regardless of how deep we
+    // are, but not finding one is only conclusive if the search wasn't cut
+    // short by the depth limit
     bool ret = check_outgoing_links(table_ndx, table, idx, depth);
-    if (!ret && (depth == 0 || !m_current_path[depth - 1].depth_exceeded))
-        m_not_modified[table_ndx].add(idx);
+    if (ret)
+        modified[table_ndx].add(idx);
+    else if (depth == 0 || !m_current_path[depth - 1].depth_exceeded)
+        not_modified[table_ndx].add(idx);
     return ret;
 }
 
 bool DeepChangeChecker::operator()(size_t ndx)
 {
-    if (m_root_modifications && m_root_modifications->contains(ndx))
+    if (m_filtered) {
+        if (m_root_modifications && row_modified(related_table(m_root_table_ndx), m_root_table_ndx, ndx))
+            return true;
+    }
+    else if (m_root_modifications && m_root_modifications->contains(ndx)) {
         return true;
+    }
     return check_row(m_root_table, ndx, 0);
 }
 
 CollectionNotifier::CollectionNotifier(std::shared_ptr<Realm> realm)
 : m_realm(std::move(realm))
+, m_coordinator(&Realm::Internal::get_coordinator(*m_realm))
 , m_sg_version(Realm::Internal::get_shared_group(*m_realm)->get_version_of_current_transaction())
 {
 }
@@ -180,13 +524,33 @@ CollectionNotifier::~CollectionNotifier()
     unregister();
 }
 
-uint64_t CollectionNotifier::add_callback(CollectionChangeCallback callback)
+uint64_t CollectionNotifier::add_callback(CollectionChangeCallback callback, NotificationPriority priority,
+                                          std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> key_path_filter)
 {
     m_realm->verify_thread();
 
     std::lock_guard<std::mutex> lock(m_callback_mutex);
-    auto token = m_next_token++;
-    m_callbacks.push_back({std::move(callback), {}, {}, token, false, false});
+    uint32_t slot, generation = 0;
+    if (m_free_callback_slots.empty()) {
+        slot = static_cast<uint32_t>(m_callbacks.size());
+        m_callbacks.emplace_back();
+    }
+    else {
+        slot = m_free_callback_slots.back();
+        m_free_callback_slots.pop_back();
+        generation = m_callbacks[slot].generation + 1;
+    }
+    auto token = uint64_t(generation) << 32 | slot;
+    bool interactive = priority == NotificationPriority::Interactive;
+    // A new callback only receives changes from after it was added, so it can
+    // only use the shared changes if there currently aren't any
+    bool shares_changes = m_shared_changes.empty();
+    m_callbacks[slot] = {std::move(callback), {}, {}, token, false, false, interactive, false, false,
+                         shares_changes, std::move(key_path_filter), m_next_sequence++, generation, true};
+    update_key_path_filter();
+    if (interactive)
+        ++m_interactive_callback_count;
+    ++m_registered_callback_count;
     if (m_callback_index == npos) { // Don't need to wake up if we're already sending notifications
         Realm::Internal::get_coordinator(*m_realm).wake_up_notifier_worker();
         m_have_callbacks = true;
@@ -194,6 +558,12 @@ uint64_t CollectionNotifier::add_callback(CollectionChangeCallback callback)
     return token;
 }
 
+void CollectionNotifier::request_run()
+{
+    m_realm->verify_thread();
+    Realm::Internal::get_coordinator(*m_realm).wake_up_notifier_worker();
+}
+
 void CollectionNotifier::remove_callback(uint64_t token)
 {
     // the callback needs to be destroyed after releasing the lock as destroying
@@ -201,23 +571,98 @@ void CollectionNotifier::remove_callback(uint64_t token)
     Callback old;
     {
         std::lock_guard<std::mutex> lock(m_callback_mutex);
-        auto it = find_callback(token);
-        if (it == end(m_callbacks)) {
+        auto callback = find_callback(token);
+        if (!callback) {
             return;
         }
 
-        size_t idx = distance(begin(m_callbacks), it);
-        if (m_callback_index != npos) {
-            if (m_callback_index >= idx)
-                --m_callback_index;
-        }
-        --m_callback_count;
+        old = std::move(*callback);
+        *callback = {};
+        callback->generation = old.generation;
+        m_free_callback_slots.push_back(static_cast<uint32_t>(token));
+        if (old.interactive && !old.paused)
+            --m_interactive_callback_count;
+        --m_registered_callback_count;
 
-        old = std::move(*it);
-        m_callbacks.erase(it);
+        update_have_callbacks();
+        update_key_path_filter();
+    }
+}
 
-        m_have_callbacks = !m_callbacks.empty();
+void CollectionNotifier::update_have_callbacks()
+{
+    m_have_callbacks = std::any_of(m_callbacks.begin(), m_callbacks.end(),
+                                   [](auto const& callback) { return callback.in_use && !callback.paused; });
+}
+
+void CollectionNotifier::pause_callback(uint64_t token)
+{
+    {
+        // The notifier may have been unregistered since the token was handed out
+        std::lock_guard<std::mutex> lock(m_realm_mutex);
+        if (!m_realm)
+            return;
+        m_realm->verify_thread();
     }
+
+    std::lock_guard<std::mutex> lock(m_callback_mutex);
+    auto it = find_callback(token);
+    if (!it || it->paused)
+        return;
+
+    it->paused = true;
+    it->resuming = false;
+    it->accumulated_changes = {};
+    it->changes_to_deliver = nullptr;
+    it->shares_changes = false;
+    if (it->interactive)
+        --m_interactive_callback_count;
+    update_have_callbacks();
+}
+
+void CollectionNotifier::resume_callback(uint64_t token)
+{
+    std::shared_ptr<RealmCoordinator> coordinator;
+    {
+        std::lock_guard<std::mutex> lock(m_realm_mutex);
+        if (!m_realm)
+            return;
+        m_realm->verify_thread();
+        coordinator = Realm::Internal::get_coordinator(*m_realm).shared_from_this();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_callback_mutex);
+        auto it = find_callback(token);
+        if (!it || !it->paused)
+            return;
+
+        it->paused = false;
+        it->resuming = true;
+        if (it->interactive)
+            ++m_interactive_callback_count;
+        m_have_callbacks = true;
+    }
+    // Catch up on the versions skipped while paused, which may have been all
+    // of them if this was the only callback
+    coordinator->wake_up_notifier_worker();
+}
+
+void CollectionNotifier::update_key_path_filter()
+{
+    std::shared_ptr<std::vector<DeepChangeChecker::RelatedTable>> filter;
+    for (auto& callback : m_callbacks) {
+        if (!callback.in_use)
+            continue;
+        if (!callback.key_path_filter) {
+            filter = nullptr;
+            break;
+        }
+        if (!filter)
+            filter = std::make_shared<std::vector<DeepChangeChecker::RelatedTable>>();
+        DeepChangeChecker::merge_related_tables(*filter, *callback.key_path_filter);
+    }
+    m_key_path_filter.exchange(std::move(filter));
 }
 
 void CollectionNotifier::suppress_next_notification(uint64_t token)
@@ -230,26 +675,31 @@ void CollectionNotifier::suppress_next_notification(uint64_t token)
     }
 
     std::lock_guard<std::mutex> lock(m_callback_mutex);
-    auto it = find_callback(token);
-    if (it != end(m_callbacks)) {
-        it->skip_next = true;
-    }
+    if (auto callback = find_callback(token))
+        callback->skip_next = true;
 }
 
-std::vector<CollectionNotifier::Callback>::iterator CollectionNotifier::find_callback(uint64_t token)
+CollectionNotifier::Callback* CollectionNotifier::find_callback(uint64_t token)
 {
     REALM_ASSERT(m_error || m_callbacks.size() > 0);
 
-    auto it = find_if(begin(m_callbacks), end(m_callbacks),
-                      [=](const auto& c) { return c.token == token; });
+    size_t slot = static_cast<uint32_t>(token);
+    Callback* callback = nullptr;
+    if (slot < m_callbacks.size() && m_callbacks[slot].in_use && m_callbacks[slot].token == token)
+        callback = &m_callbacks[slot];
     // We should only fail to find the callback if it was removed due to an error
-    REALM_ASSERT(m_error || it != end(m_callbacks));
-    return it;
+    REALM_ASSERT(m_error || callback);
+    return callback;
 }
 
 void CollectionNotifier::unregister() noexcept
 {
     std::lock_guard<std::mutex> lock(m_realm_mutex);
+    if (!m_realm)
+        return;
+    // Must be done before releasing m_realm, which may be keeping the
+    // coordinator alive
+    m_coordinator->notifier_unregistered();
     m_realm = nullptr;
 }
 
@@ -266,32 +716,40 @@ std::unique_lock<std::mutex> CollectionNotifier::lock_target()
 
 void CollectionNotifier::set_table(Table const& table)
 {
-    m_related_tables.clear();
-    DeepChangeChecker::find_related_tables(m_related_tables, table);
+    auto version = m_sg ? m_sg->get_version_of_current_transaction() : m_sg_version;
+    m_related_tables = m_coordinator->get_related_tables(table, version.version);
 }
 
 void CollectionNotifier::add_required_change_info(TransactionChangeInfo& info)
 {
-    if (!do_add_required_change_info(info) || m_related_tables.empty()) {
+    if (!do_add_required_change_info(info) || add_key_path_filter_tables(info) || !m_related_tables) {
         return;
     }
 
-    auto max = max_element(begin(m_related_tables), end(m_related_tables),
-                           [](auto&& a, auto&& b) { return a.table_ndx < b.table_ndx; });
+    for (auto& tbl : *m_related_tables)
+        info.table_modifications_needed.set(tbl.table_ndx);
+}
 
-    if (max->table_ndx >= info.table_modifications_needed.size())
-        info.table_modifications_needed.resize(max->table_ndx + 1, false);
-    for (auto& tbl : m_related_tables) {
-        info.table_modifications_needed[tbl.table_ndx] = true;
-    }
+bool CollectionNotifier::add_key_path_filter_tables(TransactionChangeInfo& info)
+{
+    auto filter = m_key_paths_invalidated ? nullptr : m_key_path_filter.load();
+    if (!filter)
+        return false;
+    for (auto& tbl : *filter)
+        info.table_modifications_needed.set(tbl.table_ndx);
+    return true;
 }
 
 void CollectionNotifier::prepare_handover()
 {
     REALM_ASSERT(m_sg);
-    m_sg_version = m_sg->get_version_of_current_transaction();
-    do_prepare_handover(*m_sg);
-    m_has_run = true;
+    {
+        std::lock_guard<std::mutex> lock(m_handover_mutex);
+        m_sg_version = m_sg->get_version_of_current_transaction();
+        do_prepare_handover(*m_sg);
+        m_has_run = true;
+    }
+    m_published_version = m_sg_version.version;
 
 #ifdef REALM_DEBUG
     std::lock_guard<std::mutex> lock(m_callback_mutex);
@@ -303,7 +761,7 @@ void CollectionNotifier::prepare_handover()
 void CollectionNotifier::before_advance()
 {
     for_each_callback([&](auto& lock, auto& callback) {
-        if (callback.changes_to_deliver.empty()) {
+        if (callback.paused || !callback.changes_to_deliver) {
             return;
         }
 
@@ -312,24 +770,26 @@ void CollectionNotifier::before_advance()
         // callback from within it can't result in a dangling pointer
         auto cb = callback.fn;
         lock.unlock();
-        cb.before(changes);
+        cb.before(*changes);
     });
 }
 
 void CollectionNotifier::after_advance()
 {
+    m_pending_delivery = false;
     for_each_callback([&](auto& lock, auto& callback) {
-        if (callback.initial_delivered && callback.changes_to_deliver.empty()) {
+        if (callback.paused || (callback.initial_delivered && !callback.changes_to_deliver)) {
             return;
         }
         callback.initial_delivered = true;
 
+        static const CollectionChangeSet no_changes;
         auto changes = std::move(callback.changes_to_deliver);
         // acquire a local reference to the callback so that removing the
         // callback from within it can't result in a dangling pointer
         auto cb = callback.fn;
         lock.unlock();
-        cb.after(changes);
+        cb.after(changes ? *changes : no_changes);
     });
 }
 
@@ -337,8 +797,9 @@ void CollectionNotifier::deliver_error(std::exception_ptr error)
 {
     // Don't complain about double-unregistering callbacks
     m_error = true;
+    m_pending_delivery = false;
 
-    m_callback_count = m_callbacks.size();
+    m_delivery_sequence = m_next_sequence;
     for_each_callback([this, &error](auto& lock, auto& callback) {
         // acquire a local reference to the callback so that removing the
         // callback from within it can't result in a dangling pointer
@@ -359,23 +820,103 @@ bool CollectionNotifier::is_for_realm(Realm& realm) const noexcept
 }
 
 bool CollectionNotifier::package_for_delivery()
+{
+    std::lock_guard<std::mutex> lock(m_handover_mutex);
+    return do_package_for_delivery();
+}
+
+util::Optional<VersionID> CollectionNotifier::package_for_delivery(VersionID::version_type version)
+{
+    std::lock_guard<std::mutex> lock(m_handover_mutex);
+    if (!m_has_run || m_sg_version.version != version || !do_package_for_delivery())
+        return util::none;
+    return m_sg_version;
+}
+
+bool CollectionNotifier::do_package_for_delivery()
 {
     if (!prepare_to_deliver())
         return false;
     std::lock_guard<std::mutex> l(m_callback_mutex);
-    for (auto& callback : m_callbacks)
-        callback.changes_to_deliver = std::move(callback.accumulated_changes).finalize();
-    m_callback_count = m_callbacks.size();
+    auto finalize = [](CollectionChangeBuilder& builder) -> std::shared_ptr<const CollectionChangeSet> {
+        auto changes = std::move(builder).finalize();
+        builder = {};
+        if (changes.empty())
+            return nullptr;
+        return std::make_shared<const CollectionChangeSet>(std::move(changes));
+    };
+
+    auto shared_changes = finalize(m_shared_changes);
+    for (auto& callback : m_callbacks) {
+        if (!callback.in_use || callback.paused)
+            continue;
+        if (callback.resuming) {
+            // The changes from while the callback was paused weren't tracked,
+            // so it starts over from the current state
+            callback.changes_to_deliver = nullptr;
+            callback.accumulated_changes = {};
+            callback.initial_delivered = false;
+            callback.resuming = false;
+            callback.shares_changes = true;
+        }
+        else if (callback.shares_changes) {
+            callback.changes_to_deliver = shared_changes;
+        }
+        else {
+            callback.changes_to_deliver = finalize(callback.accumulated_changes);
+            // Everything is now starting from the same point again
+            callback.shares_changes = true;
+        }
+    }
+    m_delivery_sequence = m_next_sequence;
+    m_pending_delivery = true;
     return true;
 }
 
+CollectionNotifier::MemoryStats CollectionNotifier::memory_stats()
+{
+    std::lock_guard<std::mutex> lock(m_callback_mutex);
+    size_t change_bytes = m_shared_changes.heap_size();
+    // The change sets waiting for delivery are usually shared by all of the
+    // callbacks, so each one is only counted once
+    std::vector<CollectionChangeSet const*> counted;
+    for (auto& callback : m_callbacks) {
+        change_bytes += callback.accumulated_changes.heap_size();
+        auto changes = callback.changes_to_deliver.get();
+        if (changes && std::find(counted.begin(), counted.end(), changes) == counted.end()) {
+            counted.push_back(changes);
+            change_bytes += sizeof(CollectionChangeSet) + changes->heap_size();
+        }
+    }
+    return {get_realm(), m_registered_callback_count, m_retained_bytes, m_handover_bytes, change_bytes};
+}
+
+void CollectionNotifier::release_memory(bool release_handover)
+{
+    if (release_handover) {
+        std::lock_guard<std::mutex> lock(m_handover_mutex);
+        do_release_handover();
+        m_handover_bytes = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_callback_mutex);
+    m_shared_changes.shrink_to_fit();
+    for (auto& callback : m_callbacks)
+        callback.accumulated_changes.shrink_to_fit();
+}
+
 template<typename Fn>
 void CollectionNotifier::for_each_callback(Fn&& fn)
 {
     std::unique_lock<std::mutex> callback_lock(m_callback_mutex);
-    REALM_ASSERT_DEBUG(m_callback_count <= m_callbacks.size());
-    for (++m_callback_index; m_callback_index < m_callback_count; ++m_callback_index) {
-        fn(callback_lock, m_callbacks[m_callback_index]);
+    // Only re-locks after calls which unlocked to call user code, which may
+    // add or remove callbacks, and as removing them doesn't move the others
+    // the index stays valid
+    for (++m_callback_index; m_callback_index < m_callbacks.size(); ++m_callback_index) {
+        auto& callback = m_callbacks[m_callback_index];
+        if (!callback.in_use || callback.sequence >= m_delivery_sequence)
+            continue;
+        fn(callback_lock, callback);
         if (!callback_lock.owns_lock())
             callback_lock.lock();
     }
@@ -406,18 +947,30 @@ SharedGroup& CollectionNotifier::source_shared_group()
 void CollectionNotifier::add_changes(CollectionChangeBuilder change)
 {
     std::lock_guard<std::mutex> lock(m_callback_mutex);
+    bool any_shared = false;
     for (auto& callback : m_callbacks) {
-        if (callback.skip_next) {
-            REALM_ASSERT_DEBUG(callback.accumulated_changes.empty());
+        if (!callback.in_use)
+            continue;
+        if (callback.paused) {
+            // There's nothing to skip as the changes are being discarded anyway
+            callback.skip_next = false;
+        }
+        else if (callback.skip_next) {
+            REALM_ASSERT_DEBUG(callback.shares_changes ? m_shared_changes.empty()
+                                                       : callback.accumulated_changes.empty());
             callback.skip_next = false;
+            // This callback no longer has the same changes as the others
+            callback.shares_changes = false;
+        }
+        else if (callback.shares_changes) {
+            any_shared = true;
         }
         else {
-            if (&callback == &m_callbacks.back())
-                callback.accumulated_changes.merge(std::move(change));
-            else
-                callback.accumulated_changes.merge(CollectionChangeBuilder(change));
+            callback.accumulated_changes.merge(CollectionChangeBuilder(change));
         }
     }
+    if (any_shared)
+        m_shared_changes.merge(std::move(change));
 }
 
 NotifierPackage::NotifierPackage(std::exception_ptr error,
@@ -426,6 +979,7 @@ NotifierPackage::NotifierPackage(std::exception_ptr error,
 : m_notifiers(std::move(notifiers))
 , m_coordinator(coordinator)
 , m_error(std::move(error))
+, m_notification_trace(coordinator ? coordinator->notification_trace() : NotificationTraceFunction())
 {
 }
 
@@ -434,24 +988,54 @@ void NotifierPackage::package_and_wait(util::Optional<VersionID::version_type> t
     if (!m_coordinator || m_error || !*this)
         return;
 
-    auto lock = m_coordinator->wait_for_notifiers([&] {
+    // Only the wait itself needs the coordinator's notifier lock. Packaging
+    // uses each notifier's published version and handover lock, so that the
+    // worker isn't blocked from handing over the remaining notifiers while
+    // this thread packages the ones which are ready, and other Realms aren't
+    // blocked waiting for this one.
+    auto ready = [&] {
         if (!target_version)
             return true;
         return std::all_of(begin(m_notifiers), end(m_notifiers), [&](auto const& n) {
-            return !n->have_callbacks() || (n->has_run() && n->version().version >= *target_version);
+            return !n->have_callbacks() || n->is_deferred() || n->published_version() >= *target_version;
         });
-    });
+    };
+    if (!ready())
+        m_coordinator->wait_for_notifiers(ready, m_wait_deadline);
+    // Anything not caught up by the deadline is delivered later, so that
+    // waiting for a slow notifier doesn't block advancing the Realm
+    if (!ready())
+        m_minimum_version = std::max(m_minimum_version.value_or(0), *target_version);
+
+    // Everything in the package has to be for the same version. The worker
+    // may be handing over a newer version while this runs, so package only
+    // the notifiers which are at the newest version seen here; any which
+    // move past it in the meantime keep their changes and are delivered the
+    // next time the Realm advances. Deferred notifiers will be delivered
+    // separately once they've been run.
+    VersionID::version_type newest = 0;
+    for (auto& notifier : m_notifiers) {
+        if (!notifier->is_deferred())
+            newest = std::max(newest, notifier->published_version());
+    }
+    if (m_minimum_version && newest < *m_minimum_version)
+        newest = 0;
 
-    // Package the notifiers for delivery and remove any which don't have anything to deliver
+    // Package the notifiers for delivery and remove any which don't have
+    // anything to deliver
     auto package = [&](auto& notifier) {
-        if (notifier->has_run() && notifier->package_for_delivery()) {
-            m_version = notifier->version();
+        if (!newest || notifier->is_deferred())
+            return true;
+        if (auto version = notifier->package_for_delivery(newest)) {
+            m_version = version;
             return false;
         }
         return true;
     };
     m_notifiers.erase(std::remove_if(begin(m_notifiers), end(m_notifiers), package), end(m_notifiers));
     if (m_version && target_version && m_version->version < *target_version) {
+        for (auto& notifier : m_notifiers)
+            notifier->cancel_delivery();
         m_notifiers.clear();
         m_version = util::none;
     }
@@ -486,8 +1070,13 @@ void NotifierPackage::after_advance()
 {
     if (m_error)
         return;
-    for (auto& notifier : m_notifiers)
+    for (auto& notifier : m_notifiers) {
+        if (m_deadline && std::chrono::steady_clock::now() > *m_deadline)
+            return;
+        NotificationTraceSpan span(m_notification_trace, NotificationSpan::Phase::Callbacks,
+                                   *notifier, m_version ? m_version->version : 0);
         notifier->after_advance();
+    }
 }
 
 void NotifierPackage::add_notifier(std::shared_ptr<CollectionNotifier> notifier)
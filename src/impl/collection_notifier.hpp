@@ -20,18 +20,24 @@
 #define REALM_BACKGROUND_COLLECTION_HPP
 
 #include "impl/collection_change_builder.hpp"
+#include "notification_trace.hpp"
+#include "util/atomic_shared_ptr.hpp"
 
 #include <realm/util/assert.hpp>
 #include <realm/version_id.hpp>
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <exception>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
 namespace realm {
+class ObjectSchema;
 class Realm;
 class SharedGroup;
 class Table;
@@ -46,15 +52,132 @@ struct ListChangeInfo {
     CollectionChangeBuilder* changes;
 };
 
+// A dense set of bits indexed by table, stored as 64-bit words so that
+// checking if any bits are set doesn't have to look at each table
+class TableBitset {
+public:
+    TableBitset() = default;
+    // Implicit for convenience when building from a list of flags
+    TableBitset(std::vector<bool> const& bits);
+
+    size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    void resize(size_t size, bool value = false);
+
+    // Out-of-range indices are reported as not set
+    bool operator[](size_t ndx) const noexcept
+    {
+        return ndx < m_size && (m_words[ndx / bits_per_word] >> (ndx % bits_per_word)) & 1;
+    }
+    // Set the bit at `ndx`, growing the set if needed
+    void set(size_t ndx);
+    // Check if any of the bits are set
+    bool any() const noexcept;
+
+    // Insert a cleared bit at `ndx` if there is anything at or after it
+    void insert(size_t ndx);
+    // Move the bit at `from` to `to`, shifting everything in between
+    void move(size_t from, size_t to);
+
+private:
+    static constexpr size_t bits_per_word = 64;
+    std::vector<uint64_t> m_words;
+    size_t m_size = 0;
+
+    void assign(size_t ndx, bool value);
+};
+
+// The changes for each table in a transaction. Only the tables which are
+// actually observed have change builders allocated for them, stored sorted by
+// table index. The builders are allocated from blocks which never move, so
+// that pointers to them remain valid when changes for other tables are added.
+class TableChanges {
+public:
+    struct Entry {
+        size_t table_ndx;
+        CollectionChangeBuilder* changes;
+    };
+
+    TableChanges() = default;
+    TableChanges(TableChanges&&) = default;
+    TableChanges& operator=(TableChanges&&) = default;
+    TableChanges(TableChanges const&);
+    TableChanges& operator=(TableChanges const&);
+
+    // One past the highest table index which has changes stored
+    size_t size() const noexcept { return m_tables.empty() ? 0 : m_tables.back().table_ndx + 1; }
+    bool empty() const noexcept { return m_tables.empty(); }
+
+    // Get the changes for the given table, or an empty change set if there
+    // aren't any stored for it
+    CollectionChangeBuilder const& operator[](size_t table_ndx) const noexcept;
+    // Get the changes for the given table, or null if there aren't any stored
+    CollectionChangeBuilder* find(size_t table_ndx) noexcept;
+    CollectionChangeBuilder const* find(size_t table_ndx) const noexcept;
+    // Get the changes for the given table, creating them if needed
+    CollectionChangeBuilder& get(size_t table_ndx);
+
+    // Update the stored table indices for a table being inserted at `ndx`
+    void insert_table(size_t ndx);
+    // Update the stored table indices for a table being moved
+    void move_table(size_t from, size_t to);
+
+    // Merge all of the changes in `other` into these changes
+    void merge(TableChanges const& other);
+    // Remove all of the changes, keeping the allocated builders to be reused
+    // for the changes added afterwards
+    void clear();
+
+    std::vector<Entry>::iterator begin() noexcept { return m_tables.begin(); }
+    std::vector<Entry>::iterator end() noexcept { return m_tables.end(); }
+    std::vector<Entry>::const_iterator begin() const noexcept { return m_tables.begin(); }
+    std::vector<Entry>::const_iterator end() const noexcept { return m_tables.end(); }
+
+private:
+    std::vector<Entry> m_tables;
+
+    // The builders pointed to by m_tables. These are allocated in blocks of
+    // increasing size, and are never freed individually, so that parsing a
+    // transaction which touches many tables makes a few allocations rather
+    // than one per table. clear() keeps the blocks to hand out again, and
+    // they're only released when the TableChanges is destroyed or assigned.
+    std::vector<std::unique_ptr<CollectionChangeBuilder[]>> m_blocks;
+    // The number of blocks which builders have been handed out from, and the
+    // number of builders used in the last of them
+    size_t m_blocks_used = 0;
+    size_t m_block_used = 0;
+
+    static size_t block_size(size_t block) noexcept { return size_t(4) << block; }
+    std::vector<Entry>::const_iterator lower_bound(size_t table_ndx) const noexcept;
+    CollectionChangeBuilder& allocate();
+};
+
 struct TransactionChangeInfo {
-    std::vector<bool> table_modifications_needed;
-    std::vector<bool> table_moves_needed;
+    TableBitset table_modifications_needed;
+    TableBitset table_moves_needed;
     std::vector<ListChangeInfo> lists;
-    std::vector<CollectionChangeBuilder> tables;
+    TableChanges tables;
     std::vector<std::vector<size_t>> column_indices;
     std::vector<size_t> table_indices;
     bool track_all;
     bool schema_changed;
+    // Set instead of calculating the changes when advancing over a commit
+    // which was made in bulk-load mode. Notifiers should report everything
+    // they observe as having been replaced, and `tables` is not populated.
+    bool changes_unknown = false;
+
+    // Rows which DeepChangeChecker has determined to have been modified or
+    // not (either directly or via links), indexed by table. These are shared
+    // by all of the notifiers using this change info so that each row only
+    // has to be checked once per transaction, and are only valid for the
+    // version range which this change info covers.
+    mutable std::vector<IndexSet> deep_modified;
+    mutable std::vector<IndexSet> deep_not_modified;
+
+    // Reset to an empty change info which tracks nothing, keeping the
+    // allocated storage so that reusing it for the next notifier pass
+    // doesn't have to reallocate everything
+    void clear();
 };
 
 class DeepChangeChecker {
@@ -66,6 +189,9 @@ public:
     struct RelatedTable {
         size_t table_ndx;
         std::vector<OutgoingLink> links;
+        // If not empty, only modifications to these columns count as the row
+        // being modified. Used for notifications filtered to key paths.
+        std::vector<size_t> columns;
     };
 
     DeepChangeChecker(TransactionChangeInfo const& info, Table const& root_table,
@@ -75,15 +201,32 @@ public:
 
     // Recursively add `table` and all tables it links to to `out`, along with
     // information about the links from them
-    static void find_related_tables(std::vector<RelatedTable>& out, Table const& table);
+    // Links to tables for the object types in `untracked_types` are not
+    // followed, so changes to those objects are not reported via links.
+    static void find_related_tables(std::vector<RelatedTable>& out, Table const& table,
+                                    std::vector<std::string> const& untracked_types={});
+
+    // Get the tables, links and columns which need to be checked for
+    // modifications to the given key paths (such as "dog.name") from objects
+    // of the given type. Throws if a key path doesn't exist or passes through
+    // something other than a link.
+    static std::vector<RelatedTable> find_related_tables(Realm& realm, ObjectSchema const& object_schema,
+                                                         std::vector<std::string> const& key_paths);
+    // Add the tables, links and columns in `tables` to `out`
+    static void merge_related_tables(std::vector<RelatedTable>& out, std::vector<RelatedTable> const& tables);
 
 private:
     TransactionChangeInfo const& m_info;
     Table const& m_root_table;
     const size_t m_root_table_ndx;
     IndexSet const* const m_root_modifications;
-    std::vector<IndexSet> m_not_modified;
     std::vector<RelatedTable> const& m_related_tables;
+    // Whether only some columns are being checked, in which case the results
+    // of checking rows can't be shared with other notifiers, so they're
+    // cached in m_modified and m_not_modified instead of the change info
+    const bool m_filtered;
+    std::vector<IndexSet> m_modified;
+    std::vector<IndexSet> m_not_modified;
 
     struct Path {
         size_t table;
@@ -94,6 +237,8 @@ private:
     std::array<Path, 4> m_current_path;
 
     bool check_row(Table const& table, size_t row_ndx, size_t depth = 0);
+    bool row_modified(RelatedTable const* related_table, size_t table_ndx, size_t row_ndx) const;
+    RelatedTable const* related_table(size_t table_ndx) const;
     bool check_outgoing_links(size_t table_ndx, Table const& table,
                               size_t row_ndx, size_t depth = 0);
 };
@@ -118,7 +263,15 @@ public:
     // Add a callback to be called each time the collection changes
     // This can only be called from the target collection's thread
     // Returns a token which can be passed to remove_callback()
-    uint64_t add_callback(CollectionChangeCallback callback);
+    //
+    // If `key_path_filter` is given, the callback only needs to be told about
+    // modifications to the columns in it, as found by
+    // DeepChangeChecker::find_related_tables(). The notifier checks the
+    // union of the filters of its callbacks, so a callback may still be
+    // called for modifications which only match another callback's filter.
+    uint64_t add_callback(CollectionChangeCallback callback,
+                          NotificationPriority priority=NotificationPriority::Interactive,
+                          std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> key_path_filter=nullptr);
     // Remove a previously added token. The token is no longer valid after
     // calling this function and must not be used again. This function can be
     // called from any thread.
@@ -126,6 +279,16 @@ public:
 
     void suppress_next_notification(uint64_t token);
 
+    // Stop calling the callback for the given token until resume_callback()
+    // is called. Paused callbacks don't count towards have_callbacks(), so a
+    // notifier whose callbacks are all paused stops calculating changes.
+    // Resuming schedules a run of the notifier, after which the callback is
+    // called with an empty change set as if it had just been added, rather
+    // than with the changes which happened while it was paused.
+    // Must be called on the target thread.
+    void pause_callback(uint64_t token);
+    void resume_callback(uint64_t token);
+
     // ------------------------------------------------------------------------
     // API for RealmCoordinator to manage running things and calling callbacks
 
@@ -134,8 +297,15 @@ public:
 
     // Get the SharedGroup version which this collection can attach to (if it's
     // in handover mode), or can deliver to (if it's been handed over to the BG worker alredad)
-    // precondition: RealmCoordinator::m_notifier_mutex is locked
+    // precondition: RealmCoordinator::m_notifier_mutex or this notifier's handover lock is
+    // held, as prepare_handover() updates it while holding both. Use published_version()
+    // to check how far the worker has got without either.
     VersionID version() const noexcept { return m_sg_version; }
+    // The version of the results most recently handed over by
+    // prepare_handover(), or 0 if it hasn't run yet. Can be read without
+    // holding any locks, so a target thread can check if it's caught up
+    // without blocking the worker thread.
+    VersionID::version_type published_version() const noexcept { return m_published_version; }
 
     // Release references to all core types
     // This is called on the worker thread to ensure that non-thread-safe things
@@ -144,9 +314,16 @@ public:
     virtual void release_data() noexcept = 0;
 
     // Prepare to deliver the new collection and call callbacks.
-    // Returns whether or not it has anything to deliver.
-    // precondition: RealmCoordinator::m_notifier_mutex is locked
+    // Returns whether or not it has anything to deliver. Takes this notifier's handover
+    // lock, so the results being packaged are for a single version() even if the worker
+    // is handing over new ones, and can be called without RealmCoordinator::m_notifier_mutex.
     bool package_for_delivery();
+    // Prepare to deliver the new collection if the most recently handed over
+    // results are for `version`, returning the full version packaged, or none
+    // if there's nothing to deliver for it. Only takes this notifier's own
+    // handover lock, so it can be called while the worker is still handing
+    // over other notifiers.
+    util::Optional<VersionID> package_for_delivery(VersionID::version_type version);
 
     // Deliver the new state to the target collection using the given SharedGroup
     // precondition: RealmCoordinator::m_notifier_mutex is unlocked
@@ -161,6 +338,14 @@ public:
     void before_advance();
     void after_advance();
 
+    // Check if the changes prepared by package_for_delivery() have not yet
+    // been passed to the callbacks by after_advance()
+    // Must only be called on the target thread
+    bool has_pending_delivery() const noexcept { return m_pending_delivery; }
+    // Discard the changes prepared by package_for_delivery() without calling
+    // the callbacks
+    void cancel_delivery() noexcept { m_pending_delivery = false; }
+
     bool is_alive() const noexcept;
 
     // precondition: RealmCoordinator::m_notifier_mutex is locked *or* is called on worker thread
@@ -173,6 +358,9 @@ public:
     // SharedGroup
     // precondition: RealmCoordinator::m_notifier_mutex is locked
     void detach();
+    // Check if this notifier is currently attached to the given SharedGroup
+    // precondition: RealmCoordinator::m_notifier_mutex is locked *or* is called on worker thread
+    bool is_attached_to(SharedGroup const& sg) const noexcept { return m_sg == &sg; }
 
     // Set `info` as the new ChangeInfo that will be populated by the next
     // transaction advance, and register all required information in it
@@ -182,20 +370,81 @@ public:
     // precondition: RealmCoordinator::m_notifier_mutex is unlocked
     virtual void run() = 0;
 
+    // The name used for this notifier in NotificationSpans
+    virtual const char* trace_name() const noexcept { return "CollectionNotifier"; }
+
     // precondition: RealmCoordinator::m_notifier_mutex is locked
     void prepare_handover();
 
+    // Check if this is a background priority notifier which is still waiting
+    // to be run in the current notifier pass, and so should not be waited for
+    // or packaged for delivery. Set by the coordinator while holding
+    // m_notifier_mutex, and can be read without it.
+    bool is_deferred() const noexcept { return m_deferred; }
+    void set_deferred(bool deferred) noexcept { m_deferred = deferred; }
+
     template <typename T>
     class Handle;
 
+    // Check if there are any callbacks which aren't paused
     bool have_callbacks() const noexcept { return m_have_callbacks; }
+    // The number of registered callbacks including paused ones, which can be
+    // stale in the same way as have_callbacks()
+    size_t callback_count() const noexcept { return m_registered_callback_count; }
+    // Check if all of the registered callbacks are background priority, and
+    // so this notifier can be run after the interactive ones
+    bool is_background() const noexcept { return m_have_callbacks && m_interactive_callback_count == 0; }
+
+    // An estimate of the memory used by this notifier, in bytes
+    struct MemoryStats {
+        Realm* realm;
+        size_t callbacks;
+        // Data kept by the worker thread between runs, such as the previous
+        // contents of the collection, as of the most recent run
+        size_t retained_bytes;
+        // The results of the most recent run, waiting to be delivered
+        size_t handover_bytes;
+        // Change sets waiting to be delivered to the callbacks
+        size_t change_bytes;
+    };
+    // precondition: RealmCoordinator::m_notifier_mutex is locked
+    MemoryStats memory_stats();
+
+    // Release memory which can be recreated when it's needed, in response to
+    // memory pressure. If `release_handover` is set the most recent results
+    // are discarded as well, which makes the target collection rerun its
+    // query itself the next time it's used.
+    // precondition: RealmCoordinator::m_notifier_mutex is locked
+    void release_memory(bool release_handover);
+
 protected:
     void add_changes(CollectionChangeBuilder change);
     void set_table(Table const& table);
     std::unique_lock<std::mutex> lock_target();
     SharedGroup& source_shared_group();
+    // Wake up the worker thread so that this notifier is run even if there
+    // hasn't been a new commit. Must be called on the target thread.
+    void request_run();
 
     std::function<bool (size_t)> get_modification_checker(TransactionChangeInfo const&, Table const&);
+    // The modified rows of `root_table` if a row being modified is equivalent
+    // to it being in that set (i.e. there are no linked tables to check and
+    // no key path filter), or null if get_modification_checker() is needed.
+    IndexSet const* get_shallow_modifications(TransactionChangeInfo const&, Table const& root_table);
+    // The tables and columns which all of the callbacks are filtered to, or
+    // null if any of them want all modifications or the schema has changed
+    // since they were resolved. Worker thread only.
+    std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> key_path_filter(TransactionChangeInfo const& info);
+    // Mark the tables in the key path filter as needing modification
+    // information. Returns false if there is no filter.
+    bool add_key_path_filter_tables(TransactionChangeInfo& info);
+    // Record the sizes reported by memory_stats(). Should be called by
+    // subclasses from do_prepare_handover().
+    void set_memory_usage(size_t retained_bytes, size_t handover_bytes) noexcept
+    {
+        m_retained_bytes = retained_bytes;
+        m_handover_bytes = handover_bytes;
+    }
 
 private:
     virtual void do_attach_to(SharedGroup&) = 0;
@@ -203,52 +452,121 @@ private:
     virtual void do_prepare_handover(SharedGroup&) = 0;
     virtual bool do_add_required_change_info(TransactionChangeInfo&) = 0;
     virtual bool prepare_to_deliver() { return true; }
+    // Discard the results prepared for handover by do_prepare_handover() if
+    // the target collection can recreate them itself
+    virtual void do_release_handover() noexcept { }
+    // package_for_delivery() with m_handover_mutex held
+    bool do_package_for_delivery();
 
     mutable std::mutex m_realm_mutex;
     std::shared_ptr<Realm> m_realm;
 
+    // The coordinator is guaranteed to outlive any use of this from
+    // set_table(), as that's only called on construction or by the
+    // coordinator's notifier worker
+    RealmCoordinator* m_coordinator;
+
     VersionID m_sg_version;
     SharedGroup* m_sg = nullptr;
 
+    // Guards the results handed over by prepare_handover() until they're
+    // packaged for delivery, along with m_sg_version and m_has_run while
+    // they're being written, so that packaging doesn't need m_notifier_mutex
+    std::mutex m_handover_mutex;
+    std::atomic<VersionID::version_type> m_published_version = {0};
+    std::atomic<bool> m_deferred = {false};
+
     bool m_has_run = false;
     bool m_error = false;
-    std::vector<DeepChangeChecker::RelatedTable> m_related_tables;
+    bool m_pending_delivery = false;
+    // Set by set_memory_usage() while m_notifier_mutex is held
+    size_t m_retained_bytes = 0;
+    size_t m_handover_bytes = 0;
+    std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> m_related_tables;
+    // The union of the callbacks' key path filters, set by add_callback() and
+    // remove_callback() and read by the worker thread
+    util::AtomicSharedPtr<const std::vector<DeepChangeChecker::RelatedTable>> m_key_path_filter;
+    // The filter used by the most recent modification checker, which has to
+    // be kept alive for as long as the checker is in use
+    std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> m_active_key_path_filter;
+    // Set if the schema has changed since the key path filters were resolved,
+    // making their table and column indices unreliable
+    bool m_key_paths_invalidated = false;
 
     struct Callback {
         CollectionChangeCallback fn;
+        // The changes for this callback if it isn't using m_shared_changes
         CollectionChangeBuilder accumulated_changes;
-        CollectionChangeSet changes_to_deliver;
+        // Null if there are no changes to deliver. Shared between all of the
+        // callbacks which received the same changes.
+        std::shared_ptr<const CollectionChangeSet> changes_to_deliver;
         uint64_t token;
         bool initial_delivered;
         bool skip_next;
+        bool interactive;
+        // Set by pause_callback(). Paused callbacks don't accumulate changes
+        // and aren't called.
+        bool paused;
+        // Set by resume_callback() until the next delivery, which reports no
+        // changes as the changes from while the callback was paused are unknown
+        bool resuming;
+        // Has this callback received exactly the changes in m_shared_changes
+        // since the last delivery?
+        bool shares_changes;
+        // The key paths this callback is interested in, or null for all changes
+        std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>> key_path_filter;
+        // The value of m_next_sequence when the callback was added, used to
+        // skip callbacks added after the notifier was packaged for delivery
+        uint64_t sequence;
+        // Incremented each time the slot is reused, so that tokens for a
+        // removed callback don't find the one which replaced it
+        uint32_t generation;
+        bool in_use;
     };
 
     // Currently registered callbacks and a mutex which must always be held
-    // while doing anything with them or m_callback_index
+    // while doing anything with them or m_callback_index. Callbacks stay in
+    // the same slot for as long as they're registered, with the slot index
+    // and generation encoded in the token, so that looking them up by token
+    // doesn't need a search and removing them doesn't move the others.
     std::mutex m_callback_mutex;
     std::vector<Callback> m_callbacks;
-
-    // Cached value for if m_callbacks is empty, needed to avoid deadlocks in
+    // Slots in m_callbacks which are not in use
+    std::vector<uint32_t> m_free_callback_slots;
+    // The changes accumulated since the last delivery for all of the callbacks
+    // with `shares_changes` set, so that the usual case of every callback
+    // seeing the same changes only builds and finalizes them once
+    CollectionChangeBuilder m_shared_changes;
+
+    // Cached value for if m_callbacks has any unpaused callbacks, needed to avoid deadlocks in
     // run() due to lock-order inversion between m_callback_mutex and m_target_mutex
     // It's okay if this value is stale as at worst it'll result in us doing
     // some extra work.
     std::atomic<bool> m_have_callbacks = {false};
+    // The number of unpaused callbacks with NotificationPriority::Interactive, which
+    // can be stale in the same way as m_have_callbacks
+    std::atomic<size_t> m_interactive_callback_count = {0};
+    // The total number of callbacks, which can be stale in the same way
+    std::atomic<size_t> m_registered_callback_count = {0};
 
     // Iteration variable for looping over callbacks
-    // remove_callback() updates this when needed
     size_t m_callback_index = -1;
-    // The number of callbacks which were present when the notifier was packaged
-    // for delivery which are still present.
-    // Updated by packaged_for_delivery and removd_callback(), and used in
+    // The sequence number of the first callback added after the notifier was
+    // packaged for delivery. Set by package_for_delivery() and used in
     // for_each_callback() to avoid calling callbacks registered during delivery.
-    size_t m_callback_count = -1;
+    uint64_t m_delivery_sequence = 0;
 
-    uint64_t m_next_token = 0;
+    uint64_t m_next_sequence = 0;
 
     template<typename Fn>
     void for_each_callback(Fn&& fn);
 
-    std::vector<Callback>::iterator find_callback(uint64_t token);
+    // Get the callback for the given token, or null if it has been removed
+    Callback* find_callback(uint64_t token);
+    // Recalculate m_have_callbacks. Must be called with m_callback_mutex held.
+    void update_have_callbacks();
+    // Recalculate m_key_path_filter. Must be called with m_callback_mutex held.
+    void update_key_path_filter();
 };
 
 // A smart pointer to a CollectionNotifier that unregisters the notifier when
@@ -293,6 +611,13 @@ public:
             std::shared_ptr<T>::reset();
         }
     }
+
+    // Drop this reference without unregistering the notifier, for when the
+    // notifier is still in use by something else
+    void release() noexcept
+    {
+        std::shared_ptr<T>::reset();
+    }
 };
 
 // A package of CollectionNotifiers for a single Realm instance which is passed
@@ -311,7 +636,8 @@ public:
     util::Optional<VersionID> version() { return m_version; }
 
     // Package the notifiers for delivery, blocking if they aren't ready for
-    // the given version.
+    // the given version. If a wait deadline has been set, notifiers which
+    // still aren't ready when it passes are left out of the package instead.
     // No-op if called multiple times
     void package_and_wait(util::Optional<VersionID::version_type> target_version);
 
@@ -319,17 +645,31 @@ public:
     void before_advance();
     // Deliver the payload associated with the contained notifiers and/or the error
     void deliver(SharedGroup& sg);
-    // Send the after-change notifications
+    // Send the after-change notifications. If a deadline has been set, stops
+    // after the first notifier which finishes past it, leaving the rest with
+    // pending deliveries.
     void after_advance();
 
     void add_notifier(std::shared_ptr<CollectionNotifier> notifier);
 
+    void set_delivery_deadline(std::chrono::steady_clock::time_point deadline) { m_deadline = deadline; }
+    void set_wait_deadline(std::chrono::steady_clock::time_point deadline) { m_wait_deadline = deadline; }
+    // Leave notifiers which have only run for versions older than `version`
+    // out of the package without discarding their changes, so that they're
+    // delivered merged with the newer changes once they've caught up
+    void set_minimum_version(VersionID::version_type version) { m_minimum_version = version; }
+
 private:
     util::Optional<VersionID> m_version;
+    util::Optional<std::chrono::steady_clock::time_point> m_deadline;
+    util::Optional<std::chrono::steady_clock::time_point> m_wait_deadline;
+    util::Optional<VersionID::version_type> m_minimum_version;
     std::vector<std::shared_ptr<CollectionNotifier>> m_notifiers;
 
     RealmCoordinator* m_coordinator = nullptr;
     std::exception_ptr m_error;
+    // Kept separately as m_coordinator is cleared once packaged
+    NotificationTraceFunction m_notification_trace;
 };
 
 // Find which column of the row in the table contains the given container.
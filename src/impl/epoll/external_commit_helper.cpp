@@ -24,6 +24,7 @@
 #include <realm/group_shared_options.hpp>
 
 #include <algorithm>
+#include <array>
 #include <errno.h>
 #include <fcntl.h>
 #include <sstream>
@@ -31,6 +32,7 @@
 #include <sys/epoll.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <unordered_set>
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -80,16 +82,23 @@ public:
     ~DaemonThread();
 
     void add_commit_helper(ExternalCommitHelper* helper);
-    // Return true if the m_helper_list is empty after removal.
     void remove_commit_helper(ExternalCommitHelper* helper);
 
-    static DaemonThread& shared();
+    // The listener thread for the Realm file at `path`. Files are spread over
+    // a small fixed number of listener threads, each with its own epoll set,
+    // so that servers with many open files don't funnel every notification
+    // through a single thread and lock.
+    static DaemonThread& for_path(std::string const& path);
 private:
+    static constexpr size_t listener_count = 4;
+
     void listen();
 
     // To protect the accessing m_helpers on the daemon thread.
     std::mutex m_mutex;
-    std::vector<ExternalCommitHelper*> m_helpers;
+    // The epoll events for each helper point to it, and are checked against
+    // this before being used as the helper may have been removed since
+    std::unordered_set<ExternalCommitHelper*> m_helpers;
     // The listener thread
     std::thread m_thread;
     // File descriptor for epoll
@@ -157,13 +166,62 @@ ExternalCommitHelper::ExternalCommitHelper(RealmCoordinator& parent)
         throw std::system_error(errno, std::system_category());
     }
 
+    m_thread = std::thread([this] { run(); });
+
     // Lock is inside add_commit_helper.
-    DaemonThread::shared().add_commit_helper(this);
+    m_daemon = &DaemonThread::for_path(parent.get_path());
+    try {
+        m_daemon->add_commit_helper(this);
+    }
+    catch (...) {
+        stop();
+        throw;
+    }
 }
 
 ExternalCommitHelper::~ExternalCommitHelper()
 {
-    DaemonThread::shared().remove_commit_helper(this);
+    // Stop listening first so that nothing can signal the worker once it's gone
+    m_daemon->remove_commit_helper(this);
+    stop();
+}
+
+void ExternalCommitHelper::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void ExternalCommitHelper::signal()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending)
+            return;
+        m_pending = true;
+    }
+    m_cv.notify_one();
+}
+
+void ExternalCommitHelper::run()
+{
+    pthread_setname_np(pthread_self(), "Realm notifier");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [&] { return m_pending || m_stop; });
+        if (m_stop)
+            return;
+        m_pending = false;
+
+        lock.unlock();
+        m_parent.on_change();
+        lock.lock();
+    }
 }
 
 ExternalCommitHelper::DaemonThread::DaemonThread()
@@ -183,9 +241,10 @@ ExternalCommitHelper::DaemonThread::DaemonThread()
     m_shutdown_read_fd = pipe_fd[0];
     m_shutdown_write_fd = pipe_fd[1];
 
+    // Helpers' events point to the helper, so null identifies the shutdown pipe
     epoll_event event{};
     event.events = EPOLLIN;
-    event.data.fd = m_shutdown_read_fd;
+    event.data.ptr = nullptr;
     ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_shutdown_read_fd, &event);
     if (ret != 0) {
         int err = errno;
@@ -214,10 +273,12 @@ ExternalCommitHelper::DaemonThread::~DaemonThread()
     m_thread.join(); // Wait for the thread to exit
 }
 
-ExternalCommitHelper::DaemonThread& ExternalCommitHelper::DaemonThread::shared()
+constexpr size_t ExternalCommitHelper::DaemonThread::listener_count;
+
+ExternalCommitHelper::DaemonThread& ExternalCommitHelper::DaemonThread::for_path(std::string const& path)
 {
-    static DaemonThread daemon_thread;
-    return daemon_thread;
+    static std::array<DaemonThread, listener_count> daemon_threads;
+    return daemon_threads[std::hash<std::string>()(path) % listener_count];
 }
 
 void ExternalCommitHelper::DaemonThread::add_commit_helper(ExternalCommitHelper* helper)
@@ -227,16 +288,15 @@ void ExternalCommitHelper::DaemonThread::add_commit_helper(ExternalCommitHelper*
 
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    m_helpers.push_back(helper);
-
     epoll_event event{};
     event.events = EPOLLIN | EPOLLET;
-    event.data.fd = helper->m_notify_fd;
+    event.data.ptr = helper;
     int ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, helper->m_notify_fd, &event);
     if (ret != 0) {
         int err = errno;
         throw std::system_error(err, std::system_category());
     }
+    m_helpers.insert(helper);
 }
 
 void ExternalCommitHelper::DaemonThread::remove_commit_helper(ExternalCommitHelper* helper)
@@ -246,7 +306,7 @@ void ExternalCommitHelper::DaemonThread::remove_commit_helper(ExternalCommitHelp
 
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    m_helpers.erase(std::remove(m_helpers.begin(), m_helpers.end(), helper), m_helpers.end());
+    m_helpers.erase(helper);
 
     // In kernel versions before 2.6.9, the EPOLL_CTL_DEL operation required a non-NULL pointer in event, even
     // though this argument is ignored. See man page of epoll_ctl.
@@ -258,11 +318,9 @@ void ExternalCommitHelper::DaemonThread::listen()
 {
     pthread_setname_np(pthread_self(), "Realm notification listener");
 
-    int ret;
-
+    epoll_event events[64];
     while (true) {
-        epoll_event ev{};
-        ret = epoll_wait(m_epoll_fd, &ev, 1, -1);
+        int ret = epoll_wait(m_epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
 
         if (ret == -1 && errno == EINTR) {
             // Interrupted system call, try again.
@@ -273,22 +331,14 @@ void ExternalCommitHelper::DaemonThread::listen()
             int err = errno;
             throw std::system_error(err, std::system_category());
         }
-        if (ret == 0) {
-            // Spurious wakeup; just wait again
-            continue;
-        }
 
-        if (ev.data.u32 == (uint32_t)m_shutdown_read_fd) {
-            return;
-        }
-
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            for (auto helper : m_helpers) {
-                if (ev.data.u32 == (uint32_t)helper->m_notify_fd) {
-                    helper->m_parent.on_change();
-                }
-            }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int i = 0; i < ret; ++i) {
+            auto helper = static_cast<ExternalCommitHelper*>(events[i].data.ptr);
+            if (!helper)
+                return;
+            if (m_helpers.count(helper))
+                helper->signal();
         }
     }
 }
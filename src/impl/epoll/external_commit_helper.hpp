@@ -16,6 +16,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -63,6 +64,26 @@ private:
     // Read-write file descriptor for the named pipe which is waited on for
     // changes and written to when a commit is made
     FdHolder m_notify_fd;
+
+    // The listener thread which waits on m_notify_fd. Listener threads are
+    // shared by many helpers, so they don't call on_change() themselves, and
+    // instead wake up m_thread to do so. A slow on_change() for one file
+    // therefore doesn't delay noticing commits to the others.
+    DaemonThread* m_daemon = nullptr;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    // Set by signal() and cleared by m_thread before it calls on_change(), so
+    // that commits noticed while it's running are coalesced into one more call
+    bool m_pending = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    // Called by the listener thread when the named pipe has been written to
+    void signal();
+    void run();
+    // Stop and join m_thread
+    void stop();
 };
 
 } // namespace _impl
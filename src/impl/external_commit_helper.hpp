@@ -29,6 +29,8 @@
 
 #if REALM_PLATFORM_APPLE
 #include "impl/apple/external_commit_helper.hpp"
+#elif defined(REALM_USE_FUTEX) && REALM_USE_FUTEX
+#include "impl/futex/external_commit_helper.hpp"
 #elif REALM_USE_EPOLL
 #include "impl/epoll/external_commit_helper.hpp"
 #elif defined(_WIN32)
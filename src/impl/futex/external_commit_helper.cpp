@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "impl/external_commit_helper.hpp"
+#include "impl/realm_coordinator.hpp"
+#include "util/fifo.hpp"
+
+#include <realm/util/assert.hpp>
+#include <realm/group_shared_options.hpp>
+
+#include <chrono>
+#include <climits>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace realm;
+using namespace realm::_impl;
+
+namespace {
+int futex(std::atomic<uint32_t>& word, int op, uint32_t value)
+{
+    return static_cast<int>(syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, nullptr, nullptr, 0));
+}
+
+// Open (creating if needed) the file backing the shared state, returning -1
+// if it could not be created at the given path
+int open_note_file(std::string const& path, size_t size)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return -1;
+
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::system_category());
+    }
+    if (!S_ISREG(stat_buf.st_mode)) {
+        close(fd);
+        throw std::runtime_error(path + " exists and it is not a regular file. All processes accessing a Realm "
+                                 "file must use the same commit notification mechanism.");
+    }
+    // Newly-created files are zero-filled by ftruncate(), which is the
+    // correct initial state
+    if (static_cast<size_t>(stat_buf.st_size) < size && ftruncate(fd, size) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::system_category());
+    }
+    return fd;
+}
+} // anonymous namespace
+
+ExternalCommitHelper::ExternalCommitHelper(RealmCoordinator& parent)
+: m_parent(parent)
+{
+    std::string temp_dir = util::normalize_dir(parent.get_config().fifo_files_fallback_path);
+    std::string sys_temp_dir = util::normalize_dir(SharedGroupOptions::get_sys_tmp_dir());
+
+    // Use the same fallback locations as the named pipe used by the epoll
+    // implementation, as the same file system restrictions apply to mmap()
+    std::string path = parent.get_path() + ".note";
+    int fd = open_note_file(path, sizeof(SharedState));
+    if (fd == -1 && !temp_dir.empty()) {
+        path = util::format("%1realm_%2.note", temp_dir, std::hash<std::string>()(parent.get_path()));
+        fd = open_note_file(path, sizeof(SharedState));
+    }
+    if (fd == -1 && !sys_temp_dir.empty()) {
+        path = util::format("%1realm_%2.note", sys_temp_dir, std::hash<std::string>()(parent.get_path()));
+        fd = open_note_file(path, sizeof(SharedState));
+    }
+    if (fd == -1) {
+        throw std::system_error(errno, std::system_category());
+    }
+
+    void* addr = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    // The mapping keeps the file referenced, so the descriptor isn't needed
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(err, std::system_category());
+    }
+    m_shared = static_cast<SharedState*>(addr);
+
+    m_thread = std::async(std::launch::async, [this] { listen(); });
+}
+
+ExternalCommitHelper::~ExternalCommitHelper()
+{
+    m_keep_listening = false;
+    // The listener may have checked m_keep_listening just before it was
+    // cleared and not yet be blocked in FUTEX_WAIT, so keep waking it until
+    // it actually exits rather than relying on a single wake. Any other
+    // listeners woken by this see an unchanged version and go back to sleep.
+    do {
+        wake_listeners();
+    } while (m_thread.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready);
+
+    munmap(m_shared, sizeof(SharedState));
+}
+
+void ExternalCommitHelper::wake_listeners()
+{
+    futex(m_shared->version, FUTEX_WAKE, INT_MAX);
+}
+
+void ExternalCommitHelper::notify_others()
+{
+    m_shared->version.fetch_add(1);
+    // Paired with the increment of `waiters` in listen(): either we see the
+    // waiter here, or the waiter sees the new version and FUTEX_WAIT returns
+    // immediately.
+    if (m_shared->waiters.load() != 0)
+        wake_listeners();
+}
+
+void ExternalCommitHelper::listen()
+{
+    pthread_setname_np(pthread_self(), "Realm notification listener");
+
+    uint32_t last_version = m_shared->version.load();
+    while (m_keep_listening) {
+        m_shared->waiters.fetch_add(1);
+        uint32_t version = m_shared->version.load();
+        if (version == last_version) {
+            int ret = futex(m_shared->version, FUTEX_WAIT, version);
+            if (ret == -1 && errno != EAGAIN && errno != EINTR) {
+                int err = errno;
+                m_shared->waiters.fetch_sub(1);
+                throw std::system_error(err, std::system_category());
+            }
+            version = m_shared->version.load();
+        }
+        m_shared->waiters.fetch_sub(1);
+
+        // Wakeups for shutdown, from other coordinators shutting down, or
+        // which are simply spurious don't advance the version and so don't
+        // need to run the notifiers
+        if (version != last_version && m_keep_listening) {
+            last_version = version;
+            m_parent.on_change();
+        }
+    }
+}
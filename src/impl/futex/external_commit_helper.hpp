@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+
+namespace realm {
+namespace _impl {
+class RealmCoordinator;
+
+class ExternalCommitHelper {
+public:
+    ExternalCommitHelper(RealmCoordinator& parent);
+    ~ExternalCommitHelper();
+
+    void notify_others();
+
+private:
+    // The state shared between all processes which have the Realm file open,
+    // mapped from the .note file
+    struct SharedState {
+        // Incremented on every commit; waited on with FUTEX_WAIT
+        std::atomic<uint32_t> version;
+        // The number of threads currently blocked in FUTEX_WAIT, so that
+        // committing can skip the wake syscall when nobody is listening
+        std::atomic<uint32_t> waiters;
+    };
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && ATOMIC_INT_LOCK_FREE == 2,
+                  "futex words must be plain lock-free 32-bit integers");
+
+    void listen();
+    void wake_listeners();
+
+    RealmCoordinator& m_parent;
+
+    SharedState* m_shared = nullptr;
+
+    // The listener thread
+    std::future<void> m_thread;
+    std::atomic<bool> m_keep_listening{true};
+};
+
+} // namespace _impl
+} // namespace realm
@@ -22,6 +22,8 @@
 
 #include <realm/link_view.hpp>
 
+#include <algorithm>
+
 using namespace realm;
 using namespace realm::_impl;
 
@@ -36,6 +38,8 @@ ListNotifier::ListNotifier(LinkViewRef lv, std::shared_ptr<Realm> realm)
 void ListNotifier::release_data() noexcept
 {
     m_lv.reset();
+    m_target_rows.clear();
+    m_target_rows_valid = false;
 }
 
 void ListNotifier::do_attach_to(SharedGroup& sg)
@@ -65,6 +69,9 @@ bool ListNotifier::do_add_required_change_info(TransactionChangeInfo& info)
     size_t row_ndx = m_lv->get_origin_row_index();
     size_t col_ndx = find_container_column(table, row_ndx, m_lv, type_LinkList, &Table::get_linklist);
     info.lists.push_back({table.get_index_in_group(), row_ndx, col_ndx, &m_change});
+    // Needed to know when the target row indices stored in m_target_rows have
+    // been invalidated
+    info.table_moves_needed.set(m_lv->get_target_table().get_index_in_group());
 
     m_info = &info;
     return true;
@@ -85,7 +92,25 @@ void ListNotifier::run()
         return;
     }
 
-    auto row_did_change = get_modification_checker(*m_info, m_lv->get_target_table());
+    if (m_info->changes_unknown) {
+        // Which entries changed wasn't tracked, so report them all as replaced
+        m_change = {};
+        m_change.deletions.set(m_prev_size);
+        m_change.insertions.set(m_lv->size());
+        m_target_rows_valid = false;
+        m_prev_size = m_lv->size();
+        return;
+    }
+
+    auto& target = m_lv->get_target_table();
+    if (auto modified_rows = get_shallow_modifications(*m_info, target)) {
+        add_modified_positions(*modified_rows);
+        m_prev_size = m_lv->size();
+        return;
+    }
+    m_target_rows_valid = false;
+
+    auto row_did_change = get_modification_checker(*m_info, target);
     for (size_t i = 0; i < m_lv->size(); ++i) {
         if (m_change.modifications.contains(i))
             continue;
@@ -103,6 +128,42 @@ void ListNotifier::run()
     m_prev_size = m_lv->size();
 }
 
+void ListNotifier::add_modified_positions(IndexSet const& modified_rows)
+{
+    // Any change to the list other than modifications of the target rows
+    // (including setting an entry) changes which positions hold which rows,
+    // and inserting, removing or moving target rows changes the row indices
+    // the list holds.
+    auto& target_changes = m_info->tables[m_lv->get_target_table().get_index_in_group()];
+    if (!m_change.empty() || m_info->schema_changed || !target_changes.insertions.empty()
+        || !target_changes.deletions.empty() || !target_changes.moves.empty()) {
+        m_target_rows_valid = false;
+    }
+    if (modified_rows.empty())
+        return;
+
+    if (!m_target_rows_valid) {
+        size_t size = m_lv->size();
+        m_target_rows.clear();
+        m_target_rows.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+            m_target_rows.emplace_back(m_lv->get(i).get_index(), i);
+        std::sort(m_target_rows.begin(), m_target_rows.end());
+        m_target_rows_valid = true;
+    }
+
+    // Both sets are sorted, so walk them together, skipping over the parts
+    // of the list which link to unmodified rows
+    auto it = m_target_rows.begin(), end = m_target_rows.end();
+    for (auto range : modified_rows) {
+        it = std::lower_bound(it, end, std::make_pair(range.first, size_t(0)));
+        for (; it != end && it->first < range.second; ++it)
+            m_change.modifications.add(it->second);
+        if (it == end)
+            break;
+    }
+}
+
 void ListNotifier::do_prepare_handover(SharedGroup&)
 {
     add_changes(std::move(m_change));
@@ -23,6 +23,9 @@
 
 #include <realm/group_shared.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace realm {
 namespace _impl {
 class ListNotifier : public CollectionNotifier {
@@ -43,7 +46,16 @@ private:
     CollectionChangeBuilder m_change;
     TransactionChangeInfo* m_info;
 
+    // (target row, list position) for each entry in the list, sorted by
+    // target row, so that the positions which link to a modified row can be
+    // found without checking every entry in the list. Rebuilt only when the
+    // list or the row indices of the target table have changed.
+    std::vector<std::pair<size_t, size_t>> m_target_rows;
+    bool m_target_rows_valid = false;
+
     void run() override;
+    const char* trace_name() const noexcept override { return "ListNotifier"; }
+    void add_modified_positions(IndexSet const& modified_rows);
 
     void do_prepare_handover(SharedGroup&) override;
 
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_LOCAL_COMMIT_HELPER_HPP
+#define REALM_LOCAL_COMMIT_HELPER_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace realm {
+namespace _impl {
+class RealmCoordinator;
+
+// Used in place of ExternalCommitHelper when Config::single_process is set.
+// Commits are only ever made by this process, so rather than signalling them
+// via the OS's interprocess mechanism, notify_others() just wakes up a
+// listener thread waiting on a condition variable, which then calls the
+// coordinator's on_change() in the same way ExternalCommitHelper's does.
+class LocalCommitHelper {
+public:
+    LocalCommitHelper(RealmCoordinator& parent);
+    ~LocalCommitHelper();
+
+    void notify_others();
+
+private:
+    void listen();
+
+    RealmCoordinator& m_parent;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    // Set by notify_others() and cleared by the listener before it calls
+    // on_change(), so that notifications sent while it's running are
+    // coalesced into one more call
+    bool m_pending = false;
+    bool m_stop = false;
+
+    // The listener thread
+    std::thread m_thread;
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_LOCAL_COMMIT_HELPER_HPP
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_NOTIFICATION_TRACE_SPAN_HPP
+#define REALM_NOTIFICATION_TRACE_SPAN_HPP
+
+#include "impl/collection_notifier.hpp"
+#include "notification_trace.hpp"
+
+namespace realm {
+namespace _impl {
+// Times the enclosing scope and reports it to the config's notification_trace
+// callback when it ends. Does nothing beyond checking whether there's a
+// callback when tracing isn't enabled.
+class NotificationTraceSpan {
+public:
+    NotificationTraceSpan(NotificationTraceFunction const& callback, NotificationSpan::Phase phase,
+                          uint64_t version = 0)
+    : m_callback(callback ? &callback : nullptr)
+    {
+        if (m_callback) {
+            m_span.phase = phase;
+            m_span.version = version;
+            m_span.start = std::chrono::steady_clock::now();
+        }
+    }
+
+    NotificationTraceSpan(NotificationTraceFunction const& callback, NotificationSpan::Phase phase,
+                          CollectionNotifier const& notifier, uint64_t version)
+    : NotificationTraceSpan(callback, phase, version)
+    {
+        if (m_callback) {
+            m_span.notifier_type = notifier.trace_name();
+            m_span.notifier = &notifier;
+        }
+    }
+
+    ~NotificationTraceSpan()
+    {
+        if (m_callback) {
+            m_span.thread = std::this_thread::get_id();
+            m_span.duration = std::chrono::steady_clock::now() - m_span.start;
+            (*m_callback)(m_span);
+        }
+    }
+
+    NotificationTraceSpan(NotificationTraceSpan const&) = delete;
+    NotificationTraceSpan& operator=(NotificationTraceSpan const&) = delete;
+
+    // For spans where the version is only known part way through
+    void set_version(uint64_t version) noexcept { m_span.version = version; }
+
+private:
+    NotificationTraceFunction const* m_callback;
+    NotificationSpan m_span{};
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_NOTIFICATION_TRACE_SPAN_HPP
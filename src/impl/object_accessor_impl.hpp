@@ -39,11 +39,18 @@ public:
     CppContext(CppContext& c, Property const& prop)
     : realm(c.realm)
     , object_schema(prop.type == PropertyType::Object ? &*realm->schema().find(prop.object_type) : c.object_schema)
+    , return_views(c.return_views)
     { }
 
     CppContext() = default;
-    CppContext(std::shared_ptr<Realm> realm, const ObjectSchema* os=nullptr)
-    : realm(std::move(realm)), object_schema(os) { }
+    // If `return_views` is true, strings and binary data are boxed as the
+    // StringData or BinaryData pointing into the Realm file rather than being
+    // copied into a std::string. The views are only valid until the Realm
+    // advances to a new version or the value is modified, so this is only
+    // suitable for code which reads large values and is done with them before
+    // then. unbox() accepts both a view and a std::string.
+    CppContext(std::shared_ptr<Realm> realm, const ObjectSchema* os=nullptr, bool return_views=false)
+    : realm(std::move(realm)), object_schema(os), return_views(return_views) { }
 
     // The use of util::Optional for the following two functions is not a hard
     // requirement; only that it be some type which can be evaluated in a
@@ -91,11 +98,11 @@ public:
     }
 
     // Convert from core types to the boxed type
-    util::Any box(BinaryData v) const { return std::string(v); }
+    util::Any box(BinaryData v) const { return return_views ? util::Any(v) : util::Any(std::string(v)); }
     util::Any box(List v) const { return v; }
     util::Any box(Object v) const { return v; }
     util::Any box(Results v) const { return v; }
-    util::Any box(StringData v) const { return std::string(v); }
+    util::Any box(StringData v) const { return return_views ? util::Any(v) : util::Any(std::string(v)); }
     util::Any box(Timestamp v) const { return v; }
     util::Any box(bool v) const { return v; }
     util::Any box(double v) const { return v; }
@@ -149,7 +156,7 @@ public:
 private:
     std::shared_ptr<Realm> realm;
     const ObjectSchema* object_schema = nullptr;
-
+    bool return_views = false;
 };
 
 inline util::Any CppContext::box(RowExpr row) const
@@ -163,6 +170,8 @@ inline StringData CppContext::unbox(util::Any& v, bool, bool, bool, size_t) cons
 {
     if (!v.has_value())
         return StringData();
+    if (auto view = any_cast<StringData>(&v))
+        return *view;
     auto& value = any_cast<std::string&>(v);
     return StringData(value.c_str(), value.size());
 }
@@ -172,6 +181,8 @@ inline BinaryData CppContext::unbox(util::Any& v, bool, bool, bool, size_t) cons
 {
     if (!v.has_value())
         return BinaryData();
+    if (auto view = any_cast<BinaryData>(&v))
+        return *view;
     auto& value = any_cast<std::string&>(v);
     return BinaryData(value.c_str(), value.size());
 }
@@ -58,10 +58,8 @@ bool ObjectNotifier::do_add_required_change_info(TransactionChangeInfo& info)
     REALM_ASSERT(!m_handover);
     m_info = &info;
     if (m_row && m_row->is_attached()) {
-        size_t table_ndx = m_row->get_table()->get_index_in_group();
-        if (table_ndx >= info.table_modifications_needed.size())
-            info.table_modifications_needed.resize(table_ndx + 1);
-        info.table_modifications_needed[table_ndx] = true;
+        info.table_modifications_needed.set(m_row->get_table()->get_index_in_group());
+        add_key_path_filter_tables(info);
     }
     return false;
 }
@@ -76,15 +74,32 @@ void ObjectNotifier::run()
         return;
     }
 
-    size_t table_ndx = m_row->get_table()->get_index_in_group();
-    if (table_ndx >= m_info->tables.size())
+    if (m_info->changes_unknown) {
+        // Which columns changed wasn't tracked, so just report the object as
+        // modified with none of the columns marked
+        m_change.modifications.add(0);
         return;
-    auto& change = m_info->tables[table_ndx];
-    if (!change.modifications.contains(m_row->get_index()))
-        return;
-    m_change.modifications.add(0);
-    m_change.columns.reserve(change.columns.size());
-    for (auto& col : change.columns) {
+    }
+
+    auto& table = *m_row->get_table();
+    size_t table_ndx = table.get_index_in_group();
+    auto change = m_info->tables.find(table_ndx);
+    if (auto filter = key_path_filter(*m_info)) {
+        // Changes to linked objects are reported as a modification of the
+        // object itself, with no specific columns marked as modified
+        if (!DeepChangeChecker(*m_info, table, *filter)(m_row->get_index()))
+            return;
+        m_change.modifications.add(0);
+        if (!change)
+            return;
+    }
+    else {
+        if (!change || !change->modifications.contains(m_row->get_index()))
+            return;
+        m_change.modifications.add(0);
+    }
+    m_change.columns.reserve(change->columns.size());
+    for (auto& col : change->columns) {
         m_change.columns.emplace_back();
         if (col.contains(m_row->get_index()))
             m_change.columns.back().add(0);
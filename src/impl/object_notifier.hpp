@@ -38,6 +38,7 @@ private:
     TransactionChangeInfo* m_info;
 
     void run() override;
+    const char* trace_name() const noexcept override { return "ObjectNotifier"; }
 
     void do_prepare_handover(SharedGroup&) override;
 
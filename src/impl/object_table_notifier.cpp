@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "impl/object_table_notifier.hpp"
+
+#include "impl/realm_coordinator.hpp"
+#include "shared_realm.hpp"
+
+using namespace realm;
+using namespace realm::_impl;
+
+struct ObjectTableNotifier::Lifetime {
+    std::weak_ptr<ObjectTableNotifier> notifier;
+    ~Lifetime()
+    {
+        if (auto n = notifier.lock())
+            n->unregister();
+    }
+};
+
+struct ObjectTableNotifier::RowLease {
+    std::weak_ptr<ObjectTableNotifier> notifier;
+    size_t slot;
+    ~RowLease()
+    {
+        if (auto n = notifier.lock())
+            n->release_row(slot);
+    }
+};
+
+namespace {
+// The callback for a single object, which extracts the changes for its slot
+// from the change sets for all of the notifier's objects
+class ObjectCallback {
+public:
+    ObjectCallback(CollectionChangeCallback fn, size_t slot, std::shared_ptr<void> lifetime,
+                   std::shared_ptr<void> lease)
+    : m_fn(std::move(fn)), m_slot(slot), m_lifetime(std::move(lifetime)), m_lease(std::move(lease)) { }
+
+    void before(CollectionChangeSet const& c)
+    {
+        CollectionChangeSet changes;
+        if (changes_for_slot(c, changes))
+            m_fn.before(changes);
+    }
+
+    void after(CollectionChangeSet const& c)
+    {
+        // The initial notification is delivered even if there are no changes,
+        // but after that the other objects' changes shouldn't result in a call
+        CollectionChangeSet changes;
+        if (changes_for_slot(c, changes) || !m_initial_delivered)
+            m_fn.after(changes);
+        m_initial_delivered = true;
+    }
+
+    void error(std::exception_ptr e)
+    {
+        m_fn.error(e);
+    }
+
+private:
+    CollectionChangeCallback m_fn;
+    const size_t m_slot;
+    std::shared_ptr<void> m_lifetime;
+    // Stops the notifier from observing the slot's row once the callback is
+    // removed
+    std::shared_ptr<void> m_lease;
+    bool m_initial_delivered = false;
+
+    bool changes_for_slot(CollectionChangeSet const& c, CollectionChangeSet& out) const
+    {
+        if (!c.modifications.contains(m_slot))
+            return false;
+        if (!c.columns.empty() && c.columns[0].contains(m_slot)) {
+            out.deletions.add(0);
+            return true;
+        }
+
+        out.modifications.add(0);
+        out.modifications_new.add(0);
+        if (c.columns.size() > 1) {
+            out.columns.resize(c.columns.size() - 1);
+            for (size_t i = 1; i < c.columns.size(); ++i) {
+                if (c.columns[i].contains(m_slot))
+                    out.columns[i - 1].add(0);
+            }
+        }
+        return true;
+    }
+};
+} // anonymous namespace
+
+NotificationToken ObjectTableNotifier::add_object_callback(std::shared_ptr<Realm> const& realm, Row const& row,
+                                                           CollectionChangeCallback callback)
+{
+    REALM_ASSERT(row.get_table());
+    auto& notifiers = Realm::Internal::get_object_table_notifiers(*realm);
+    auto& cached = notifiers[row.get_table()->get_index_in_group()];
+
+    std::shared_ptr<ObjectTableNotifier> notifier;
+    std::shared_ptr<Lifetime> lifetime;
+    size_t slot = npos;
+    // Rows added in a write transaction may not exist at the version the
+    // notifier starts from, so don't share notifiers created during one
+    if (!realm->is_in_transaction()) {
+        notifier = cached.lock();
+        if (notifier)
+            lifetime = notifier->m_lifetime.lock();
+        if (lifetime)
+            slot = notifier->add_row(row);
+    }
+    if (slot == npos) {
+        notifier = std::make_shared<ObjectTableNotifier>(realm);
+        lifetime = std::make_shared<Lifetime>();
+        lifetime->notifier = notifier;
+        notifier->m_lifetime = lifetime;
+        slot = notifier->add_row(row);
+        REALM_ASSERT(slot != npos);
+        RealmCoordinator::register_notifier(notifier);
+        if (realm->is_in_transaction())
+            cached.reset();
+        else
+            cached = notifier;
+    }
+
+    auto lease = std::make_shared<RowLease>();
+    lease->notifier = notifier;
+    lease->slot = slot;
+    uint64_t token = notifier->add_callback(ObjectCallback(std::move(callback), slot, std::move(lifetime),
+                                                           std::move(lease)));
+    return {std::move(notifier), token};
+}
+
+ObjectTableNotifier::ObjectTableNotifier(std::shared_ptr<Realm> realm)
+: CollectionNotifier(std::move(realm))
+, m_version(source_shared_group().get_version_of_current_transaction())
+{
+}
+
+size_t ObjectTableNotifier::add_row(Row const& row)
+{
+    std::lock_guard<std::mutex> lock(m_rows_mutex);
+    if (m_sealed || source_shared_group().get_version_of_current_transaction() != m_version)
+        return npos;
+    m_handovers.push_back(source_shared_group().export_for_handover(row));
+    return m_handovers.size() - 1;
+}
+
+void ObjectTableNotifier::release_row(size_t slot)
+{
+    // The row accessors are only touched on the worker thread, so the slot
+    // is cleared the next time it prepares to run
+    std::lock_guard<std::mutex> lock(m_rows_mutex);
+    m_released_slots.push_back(slot);
+}
+
+void ObjectTableNotifier::clear_released_slots()
+{
+    for (size_t slot : m_released_slots) {
+        if (!m_rows.empty())
+            m_rows[slot] = nullptr;
+        else if (slot < m_handovers.size())
+            m_handovers[slot] = nullptr;
+    }
+    m_released_slots.clear();
+}
+
+void ObjectTableNotifier::release_data() noexcept
+{
+    m_rows.clear();
+}
+
+void ObjectTableNotifier::do_attach_to(SharedGroup& sg)
+{
+    std::lock_guard<std::mutex> lock(m_rows_mutex);
+    REALM_ASSERT(m_rows.empty());
+    m_sealed = true;
+    clear_released_slots();
+    m_rows.reserve(m_handovers.size());
+    for (auto& handover : m_handovers)
+        m_rows.push_back(handover ? sg.import_from_handover(std::move(handover)) : nullptr);
+    m_handovers.clear();
+}
+
+void ObjectTableNotifier::do_detach_from(SharedGroup& sg)
+{
+    std::lock_guard<std::mutex> lock(m_rows_mutex);
+    REALM_ASSERT(m_handovers.empty());
+    m_handovers.reserve(m_rows.size());
+    for (auto& row : m_rows)
+        m_handovers.push_back(row ? sg.export_for_handover(*row) : nullptr);
+    m_rows.clear();
+}
+
+bool ObjectTableNotifier::do_add_required_change_info(TransactionChangeInfo& info)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_rows_mutex);
+        clear_released_slots();
+    }
+    m_info = &info;
+    m_table_ndx = npos;
+    for (auto& row : m_rows) {
+        if (row && row->is_attached()) {
+            m_table_ndx = row->get_table()->get_index_in_group();
+            info.table_modifications_needed.set(m_table_ndx);
+            break;
+        }
+    }
+    return false;
+}
+
+void ObjectTableNotifier::run()
+{
+    if (m_table_ndx == npos)
+        return;
+    // Rows can only have been modified or deleted if the table was written to,
+    // in which case there's a change for it even if no rows were modified
+    auto change = m_info->tables.find(m_table_ndx);
+    if (!change && !m_info->schema_changed && !m_info->changes_unknown)
+        return;
+
+    for (size_t slot = 0; slot < m_rows.size(); ++slot) {
+        auto& row = m_rows[slot];
+        if (!row)
+            continue;
+        if (!row->is_attached()) {
+            m_change.modify(slot, 0);
+            row = nullptr;
+            continue;
+        }
+
+        // Objects are reported as modified with no columns marked if which
+        // columns changed wasn't tracked
+        if (m_info->changes_unknown) {
+            m_change.modifications.add(slot);
+            continue;
+        }
+        size_t row_ndx = row->get_index();
+        if (!change || !change->modifications.contains(row_ndx))
+            continue;
+        m_change.modifications.add(slot);
+        for (size_t col = 0; col < change->columns.size(); ++col) {
+            if (change->columns[col].contains(row_ndx))
+                m_change.modify(slot, col + 1);
+        }
+    }
+}
+
+void ObjectTableNotifier::do_prepare_handover(SharedGroup&)
+{
+    add_changes(std::move(m_change));
+}
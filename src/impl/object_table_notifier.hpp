@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_OBJECT_TABLE_NOTIFIER_HPP
+#define REALM_OS_OBJECT_TABLE_NOTIFIER_HPP
+
+#include "impl/collection_notifier.hpp"
+
+#include <realm/group_shared.hpp>
+
+#include <mutex>
+
+namespace realm {
+namespace _impl {
+// A notifier for the callbacks on any number of individual objects in a single
+// table, so that observing many objects only has to check the table's changes
+// once per commit rather than once per object.
+//
+// Each observed object is assigned a slot, and the change sets calculated by
+// the notifier treat the slots as the elements of a collection. Slots never
+// move, so deletions are reported as a modification of the slot with the
+// slot also marked in the first column; the remaining columns are the
+// object's columns shifted by one. The callbacks registered with
+// add_object_callback() translate this back into the change set for their
+// own object.
+class ObjectTableNotifier : public CollectionNotifier {
+public:
+    // Add a callback for the given row, sharing a notifier with the other
+    // objects from the same table whose callbacks were added since the
+    // notifier last ran if possible
+    static NotificationToken add_object_callback(std::shared_ptr<Realm> const& realm, Row const& row,
+                                                 CollectionChangeCallback callback);
+
+    ObjectTableNotifier(std::shared_ptr<Realm> realm);
+
+private:
+    // Shared by the callbacks for this notifier, and unregisters it once the
+    // last of them has been removed
+    struct Lifetime;
+    std::weak_ptr<Lifetime> m_lifetime;
+    // Held by each callback, and releases its slot once it's removed
+    struct RowLease;
+
+    // Guards m_handovers, m_sealed and m_released_slots, as rows can be added
+    // on the source thread until the notifier is first attached on the worker
+    // thread, and released by removing their callbacks at any time
+    std::mutex m_rows_mutex;
+    // The rows to observe, indexed by slot. Null for rows whose deletion has
+    // already been reported.
+    std::vector<std::unique_ptr<SharedGroup::Handover<Row>>> m_handovers;
+    std::vector<std::unique_ptr<Row>> m_rows;
+    // Set once the worker thread has taken over the rows
+    bool m_sealed = false;
+    // Slots whose callbacks have been removed, which are cleared on the worker
+    // thread so that their rows are no longer checked on each run. Slots are
+    // never reused, as the other callbacks' slots mustn't move.
+    std::vector<size_t> m_released_slots;
+    // The version of the source Realm at which the rows were exported
+    VersionID m_version;
+
+    // The index of the table the rows are in, or npos if none of them exist
+    // any more. Updated in do_add_required_change_info().
+    size_t m_table_ndx = npos;
+
+    // The actual change, calculated in run() and delivered in prepare_handover()
+    CollectionChangeBuilder m_change;
+    TransactionChangeInfo* m_info;
+
+    // Add a row and return its slot, or npos if the notifier has already
+    // started running or the Realm has moved to a different version
+    size_t add_row(Row const& row);
+    void release_row(size_t slot);
+    // Null out the rows for m_released_slots. m_rows_mutex must be held.
+    void clear_released_slots();
+
+    void run() override;
+    const char* trace_name() const noexcept override { return "ObjectTableNotifier"; }
+
+    void do_prepare_handover(SharedGroup&) override;
+
+    void do_attach_to(SharedGroup& sg) override;
+    void do_detach_from(SharedGroup& sg) override;
+
+    void release_data() noexcept override;
+    bool do_add_required_change_info(TransactionChangeInfo& info) override;
+};
+}
+}
+
+#endif // REALM_OS_OBJECT_TABLE_NOTIFIER_HPP
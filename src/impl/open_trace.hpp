@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OPEN_TRACE_HPP
+#define REALM_OPEN_TRACE_HPP
+
+#include "shared_realm.hpp"
+
+#include <chrono>
+
+namespace realm {
+namespace _impl {
+// Measures the duration of one phase of opening a Realm and reports it to the
+// config's open_trace callback. Phases which throw an exception aren't
+// reported, so done() must be called once the phase has completed. Time spent
+// in a nested phase which is reported separately can be passed to exclude().
+class OpenTraceTimer {
+public:
+    OpenTraceTimer(Realm::OpenTraceFunction const& callback, Realm::OpenPhase phase)
+    : m_callback(callback)
+    , m_phase(phase)
+    {
+        if (m_callback)
+            m_start = std::chrono::steady_clock::now();
+    }
+
+    // Returns the reported duration, or zero if there's no callback
+    std::chrono::nanoseconds done()
+    {
+        if (!m_callback)
+            return {};
+        auto duration = std::chrono::steady_clock::now() - m_start - m_excluded;
+        m_callback(m_phase, duration);
+        return duration;
+    }
+
+    void exclude(std::chrono::nanoseconds duration)
+    {
+        m_excluded += duration;
+    }
+
+private:
+    Realm::OpenTraceFunction const& m_callback;
+    Realm::OpenPhase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::nanoseconds m_excluded{0};
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_OPEN_TRACE_HPP
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_PRIMARY_KEY_CACHE_HPP
+#define REALM_PRIMARY_KEY_CACHE_HPP
+
+#include "property.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/table.hpp>
+#include <realm/util/optional.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace realm {
+namespace _impl {
+// A primary key value which can be used as a map key
+struct PrimaryKey {
+    bool is_null;
+    int64_t int_value;
+    std::string string_value;
+
+    bool operator==(PrimaryKey const& other) const
+    {
+        return is_null == other.is_null && int_value == other.int_value && string_value == other.string_value;
+    }
+
+    struct Hash {
+        size_t operator()(PrimaryKey const& key) const
+        {
+            if (key.is_null)
+                return 0;
+            return std::hash<int64_t>()(key.int_value) ^ std::hash<std::string>()(key.string_value);
+        }
+    };
+};
+
+template<typename ValueType, typename ContextType>
+PrimaryKey primary_key_for(ContextType& ctx, const Property& primary_prop, ValueType const& value)
+{
+    if (ctx.is_null(value))
+        return {true, 0, {}};
+    if (primary_prop.type == PropertyType::String)
+        return {false, 0, std::string(ctx.template unbox<StringData>(value))};
+    return {false, ctx.template unbox<int64_t>(value), {}};
+}
+
+// The row index for each primary key looked up or created by Object during the
+// current write transaction, used when Realm::Config::cache_primary_key_lookups
+// is set. The entries for a table are only used while the table's content
+// version is the one recorded by the last lookup or update_version() call, so
+// any other change to the table (such as deleting a row) discards them.
+class PrimaryKeyCache {
+public:
+    // Get the cache for the Realm's current write transaction, or null if
+    // lookups shouldn't be cached. Duplicate primary keys are allowed during
+    // migrations, so lookups aren't cached then.
+    static PrimaryKeyCache* get(Realm& realm)
+    {
+        if (!realm.config().cache_primary_key_lookups || !realm.is_in_transaction() || realm.is_in_migration())
+            return nullptr;
+        auto& cache = Realm::Internal::get_primary_key_cache(realm);
+        if (!cache)
+            cache = std::make_unique<PrimaryKeyCache>();
+        return cache.get();
+    }
+
+    // The cached row index for the key, which is not_found if the key was
+    // known not to exist, or none if it isn't cached
+    util::Optional<size_t> find(Table const& table, PrimaryKey const& key)
+    {
+        auto& entry = entry_for(table);
+        auto it = entry.rows.find(key);
+        if (it == entry.rows.end())
+            return util::none;
+        return it->second;
+    }
+
+    // Record the row for a key after a lookup with find() in the same
+    // operation, which may have modified the table since
+    void insert(Table const& table, PrimaryKey key, size_t row_ndx)
+    {
+        m_tables[table.get_index_in_group()].rows[std::move(key)] = row_ndx;
+    }
+
+    // Record that the entries for the table reflect its current contents,
+    // after changes made by the code which inserted them
+    void update_version(Table const& table)
+    {
+        m_tables[table.get_index_in_group()].version = table.get_content_version();
+    }
+
+private:
+    struct TableEntry {
+        uint_fast64_t version = 0;
+        std::unordered_map<PrimaryKey, size_t, PrimaryKey::Hash> rows;
+    };
+    std::unordered_map<size_t, TableEntry> m_tables;
+
+    TableEntry& entry_for(Table const& table)
+    {
+        auto& entry = m_tables[table.get_index_in_group()];
+        auto version = table.get_content_version();
+        if (entry.version != version) {
+            entry.rows.clear();
+            entry.version = version;
+        }
+        return entry;
+    }
+};
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_PRIMARY_KEY_CACHE_HPP
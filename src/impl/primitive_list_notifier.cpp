@@ -19,18 +19,73 @@
 #include "impl/primitive_list_notifier.hpp"
 
 #include "shared_realm.hpp"
+#include "util/sequence_diff.hpp"
 
 #include <realm/link_view.hpp>
 
 using namespace realm;
 using namespace realm::_impl;
 
-PrimitiveListNotifier::PrimitiveListNotifier(TableRef table, std::shared_ptr<Realm> realm)
+namespace {
+template<typename T>
+void append_bytes(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Get a representation of the value at the given row which compares equal
+// exactly when the values are equal
+std::string value_key(Table const& table, size_t row)
+{
+    std::string key;
+    if (table.is_nullable(0) && table.is_null(0, row))
+        return key;
+    key.push_back(1);
+    switch (table.get_column_type(0)) {
+        case type_Int:
+            append_bytes(key, table.get_int(0, row));
+            break;
+        case type_Bool:
+            key.push_back(table.get_bool(0, row));
+            break;
+        case type_Float:
+            append_bytes(key, table.get_float(0, row));
+            break;
+        case type_Double:
+            append_bytes(key, table.get_double(0, row));
+            break;
+        case type_String: {
+            auto value = table.get_string(0, row);
+            key.append(value.data(), value.size());
+            break;
+        }
+        case type_Binary: {
+            auto value = table.get_binary(0, row);
+            key.append(value.data(), value.size());
+            break;
+        }
+        case type_Timestamp: {
+            auto value = table.get_timestamp(0, row);
+            append_bytes(key, value.get_seconds());
+            append_bytes(key, value.get_nanoseconds());
+            break;
+        }
+        default:
+            REALM_UNREACHABLE();
+    }
+    return key;
+}
+} // anonymous namespace
+
+PrimitiveListNotifier::PrimitiveListNotifier(TableRef table, std::shared_ptr<Realm> realm, bool diff_values)
 : CollectionNotifier(std::move(realm))
 , m_prev_size(table->size())
+, m_diff_values(diff_values)
 {
     set_table(*table->get_parent_table());
     m_table_handover = source_shared_group().export_table_for_handover(table);
+    if (m_diff_values)
+        m_prev_values = read_values(*table);
 }
 
 void PrimitiveListNotifier::release_data() noexcept
@@ -82,17 +137,66 @@ void PrimitiveListNotifier::run()
         else {
             m_change = {};
         }
+        m_prev_values.clear();
         return;
     }
 
-    if (!m_change.deletions.empty() && m_change.deletions.begin()->second == std::numeric_limits<size_t>::max()) {
+    if (m_info->changes_unknown && !m_diff_values) {
+        // Which values changed wasn't tracked, so report them all as replaced
+        m_change = {};
+        m_change.deletions.set(m_prev_size);
+        m_change.insertions.set(m_table->size());
+    }
+    else if (!m_change.deletions.empty() && m_change.deletions.begin()->second == std::numeric_limits<size_t>::max()) {
         // Table was cleared, so set the deletions to the actual previous size
         m_change.deletions.set(m_prev_size);
     }
 
+    if (m_diff_values && (!m_change.empty() || m_info->changes_unknown))
+        diff_values();
+
     m_prev_size = m_table->size();
 }
 
+std::vector<std::string> PrimitiveListNotifier::read_values(Table const& table)
+{
+    std::vector<std::string> values;
+    values.reserve(table.size());
+    for (size_t i = 0, size = table.size(); i < size; ++i)
+        values.push_back(value_key(table, i));
+    return values;
+}
+
+void PrimitiveListNotifier::diff_values()
+{
+    // Replace the changes from the transaction log with insertions and
+    // deletions of just the values which aren't in the longest common
+    // subsequence of the old and new values. Setting a value to what it
+    // already was is not a change, and any other change to a value is
+    // reported as a deletion and an insertion.
+    auto values = read_values(*m_table);
+    auto matches = util::common_subsequence(m_prev_values.size(), values.size(), [&](size_t i, size_t j) {
+        return m_prev_values[i] == values[j];
+    });
+
+    m_change = {};
+    size_t old_ndx = 0, new_ndx = 0;
+    auto add_gap = [&](size_t old_end, size_t new_end) {
+        for (size_t i = old_ndx; i < old_end; ++i)
+            m_change.deletions.add(i);
+        for (size_t i = new_ndx; i < new_end; ++i)
+            m_change.insertions.add(i);
+    };
+    for (auto& match : matches) {
+        add_gap(match.first, match.second);
+        old_ndx = match.first + 1;
+        new_ndx = match.second + 1;
+    }
+    add_gap(m_prev_values.size(), values.size());
+
+    m_prev_values = std::move(values);
+}
+
 void PrimitiveListNotifier::do_prepare_handover(SharedGroup&)
 {
     add_changes(std::move(m_change));
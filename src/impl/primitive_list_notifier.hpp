@@ -23,11 +23,17 @@
 
 #include <realm/group_shared.hpp>
 
+#include <string>
+#include <vector>
+
 namespace realm {
 namespace _impl {
 class PrimitiveListNotifier : public CollectionNotifier {
 public:
-    PrimitiveListNotifier(TableRef lv, std::shared_ptr<Realm> realm);
+    // If `diff_values` is set the reported changes are calculated by
+    // comparing the values in the list before and after each change rather
+    // than from the operations which were performed on it
+    PrimitiveListNotifier(TableRef lv, std::shared_ptr<Realm> realm, bool diff_values=false);
 
 private:
     // The subtable, in handover form if this has not been attached to the main
@@ -43,7 +49,16 @@ private:
     CollectionChangeBuilder m_change;
     TransactionChangeInfo* m_info;
 
+    // The values in the list as of the last run, stored as comparable byte
+    // strings, when diffing values
+    const bool m_diff_values;
+    std::vector<std::string> m_prev_values;
+
+    static std::vector<std::string> read_values(Table const& table);
+    void diff_values();
+
     void run() override;
+    const char* trace_name() const noexcept override { return "PrimitiveListNotifier"; }
 
     void do_prepare_handover(SharedGroup&) override;
 
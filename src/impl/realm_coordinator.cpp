@@ -18,10 +18,17 @@
 
 #include "impl/realm_coordinator.hpp"
 
+#include "impl/change_journal.hpp"
 #include "impl/collection_notifier.hpp"
 #include "impl/external_commit_helper.hpp"
+#include "impl/local_commit_helper.hpp"
+#include "impl/notification_trace_span.hpp"
+#include "impl/open_trace.hpp"
+#include "impl/results_notifier.hpp"
 #include "impl/transact_log_handler.hpp"
 #include "impl/weak_realm_notifier.hpp"
+#include "util/thread_pool.hpp"
+#include "binding_callback_thread_observer.hpp"
 #include "binding_context.hpp"
 #include "object_schema.hpp"
 #include "object_store.hpp"
@@ -39,24 +46,64 @@
 #include <realm/string_data.hpp>
 
 #include <algorithm>
+#include <array>
+#include <functional>
+#include <thread>
 #include <unordered_map>
 
 using namespace realm;
 using namespace realm::_impl;
 
-static auto& s_coordinator_mutex = *new std::mutex;
-static auto& s_coordinators_per_path = *new std::unordered_map<std::string, std::weak_ptr<RealmCoordinator>>;
+namespace {
+// Coordinators are looked up by path every time a Realm is opened, so the
+// global map is split into independently locked shards to avoid serializing
+// lookups of unrelated paths on a single mutex.
+class CoordinatorRegistry {
+public:
+    using Map = std::unordered_map<std::string, std::weak_ptr<RealmCoordinator>>;
+
+    struct Shard {
+        std::mutex mutex;
+        Map coordinators;
+    };
+
+    Shard& shard_for(std::string const& path)
+    {
+        return m_shards[std::hash<std::string>()(path) % shard_count];
+    }
+
+    // Call `fn` with each shard's map while holding that shard's lock. Only
+    // one shard is locked at a time.
+    template<typename Func>
+    void for_each_shard(Func&& fn)
+    {
+        for (auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            fn(shard.coordinators);
+        }
+    }
+
+private:
+    static constexpr size_t shard_count = 16;
+    std::array<Shard, shard_count> m_shards;
+};
+
+auto& s_coordinators = *new CoordinatorRegistry;
+} // anonymous namespace
 
 std::shared_ptr<RealmCoordinator> RealmCoordinator::get_coordinator(StringData path)
 {
-    std::lock_guard<std::mutex> lock(s_coordinator_mutex);
+    std::string key = path;
+    auto& shard = s_coordinators.shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
 
-    auto& weak_coordinator = s_coordinators_per_path[path];
+    auto& weak_coordinator = shard.coordinators[key];
     if (auto coordinator = weak_coordinator.lock()) {
         return coordinator;
     }
 
     auto coordinator = std::make_shared<RealmCoordinator>();
+    coordinator->m_registered_path = std::move(key);
     weak_coordinator = coordinator;
     return coordinator;
 }
@@ -71,9 +118,11 @@ std::shared_ptr<RealmCoordinator> RealmCoordinator::get_coordinator(const Realm:
 
 std::shared_ptr<RealmCoordinator> RealmCoordinator::get_existing_coordinator(StringData path)
 {
-    std::lock_guard<std::mutex> lock(s_coordinator_mutex);
-    auto it = s_coordinators_per_path.find(path);
-    return it == s_coordinators_per_path.end() ? nullptr : it->second.lock();
+    std::string key = path;
+    auto& shard = s_coordinators.shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.coordinators.find(key);
+    return it == shard.coordinators.end() ? nullptr : it->second.lock();
 }
 
 void RealmCoordinator::create_sync_session(bool force_client_reset)
@@ -102,8 +151,7 @@ void RealmCoordinator::create_sync_session(bool force_client_reset)
         if (auto self = weak_self.lock()) {
             if (self->m_transaction_callback)
                 self->m_transaction_callback(old_version, new_version);
-            if (self->m_notifier)
-                self->m_notifier->notify_others();
+            self->notify_others();
         }
     });
 #else
@@ -156,6 +204,12 @@ void RealmCoordinator::set_config(const Realm::Config& config)
         if (m_config.schema_mode != config.schema_mode) {
             throw MismatchedConfigException("Realm at path '%1' already opened with a different schema mode.", config.path);
         }
+        if (m_config.untracked_object_types != config.untracked_object_types) {
+            throw MismatchedConfigException("Realm at path '%1' already opened with different untracked object types.", config.path);
+        }
+        if (m_config.single_process != config.single_process) {
+            throw MismatchedConfigException("Realm at path '%1' already opened with a different single-process setting.", config.path);
+        }
         if (config.schema && m_schema_version != ObjectStore::NotVersioned && m_schema_version != config.schema_version) {
             throw MismatchedConfigException("Realm at path '%1' already opened with different schema version.", config.path);
         }
@@ -189,28 +243,28 @@ std::shared_ptr<Realm> RealmCoordinator::get_cached_realm(Realm::Config const& c
 {
     if (!config.cache)
         return nullptr;
-    AnyExecutionContextID execution_context(config.execution_context);
-    for (auto& cached_realm : m_weak_realm_notifiers) {
-        if (!cached_realm.is_cached_for_execution_context(execution_context))
-            continue;
-        // can be null if we jumped in between ref count hitting zero and
-        // unregister_realm() getting the lock
-        if (auto realm = cached_realm.realm()) {
-            // If the file is uninitialized and was opened without a schema,
-            // do the normal schema init
-            if (realm->schema_version() == ObjectStore::NotVersioned)
-                break;
+    auto it = m_cached_realms.find(AnyExecutionContextID(config.execution_context));
+    if (it == m_cached_realms.end())
+        return nullptr;
 
-            // Otherwise if we have a realm schema it needs to be an exact
-            // match (even having the same properties but in different
-            // orders isn't good enough)
-            if (config.schema && realm->schema() != *config.schema)
-                throw MismatchedConfigException("Realm at path '%1' already opened on current thread with different schema.", config.path);
+    // can be null if we jumped in between ref count hitting zero and
+    // unregister_realm() getting the lock
+    auto realm = it->second.realm.lock();
+    if (!realm)
+        return nullptr;
 
-            return realm;
-        }
-    }
-    return nullptr;
+    // If the file is uninitialized and was opened without a schema,
+    // do the normal schema init
+    if (realm->schema_version() == ObjectStore::NotVersioned)
+        return nullptr;
+
+    // Otherwise if we have a realm schema it needs to be an exact
+    // match (even having the same properties but in different
+    // orders isn't good enough)
+    if (config.schema && realm->schema() != *config.schema)
+        throw MismatchedConfigException("Realm at path '%1' already opened on current thread with different schema.", config.path);
+
+    return realm;
 }
 
 std::shared_ptr<Realm> RealmCoordinator::get_realm(Realm::Config config)
@@ -231,35 +285,151 @@ void RealmCoordinator::do_get_realm(Realm::Config config, std::shared_ptr<Realm>
     if ((realm = get_cached_realm(config)))
         return;
 
-    auto schema = std::move(config.schema);
     auto migration_function = std::move(config.migration_function);
     auto initialization_function = std::move(config.initialization_function);
     auto audit_factory = std::move(config.audit_factory);
-    config.schema = {};
 
     bool should_initialize_notifier = !config.immutable() && config.automatic_change_notifications;
     realm = Realm::make_shared_realm(std::move(config), shared_from_this());
-    if (!m_notifier && should_initialize_notifier) {
+    auto schema = Realm::Internal::release_config_schema(*realm);
+    if (!m_notifier && !m_local_notifier && should_initialize_notifier) {
+        OpenTraceTimer timer(realm->config().open_trace, Realm::OpenPhase::NotifierSetup);
+        {
+            std::lock_guard<std::mutex> lock(m_notifier_interval_mutex);
+            m_notifier_interval_cancelled = false;
+        }
         try {
-            m_notifier = std::make_unique<ExternalCommitHelper>(*this);
+            if (realm->config().single_process)
+                m_local_notifier = std::make_unique<LocalCommitHelper>(*this);
+            else
+                m_notifier = std::make_unique<ExternalCommitHelper>(*this);
         }
         catch (std::system_error const& ex) {
             throw RealmFileException(RealmFileException::Kind::AccessError, get_path(), ex.code().message(), "");
         }
+        timer.done();
+    }
+    if (!m_change_journal && realm->config().use_change_journal && !realm->config().immutable()) {
+        m_change_journal = ChangeJournal::open(get_path());
+        m_changeset_cache.set_journal(m_change_journal.get());
+    }
+    if (m_weak_realm_notifiers.size() >= m_weak_realm_notifier_prune_size) {
+        m_weak_realm_notifiers.erase(remove_if(begin(m_weak_realm_notifiers), end(m_weak_realm_notifiers),
+                                               [](auto& notifier) { return notifier.expired(); }),
+                                     end(m_weak_realm_notifiers));
+        m_weak_realm_notifier_prune_size = std::max<size_t>(8, m_weak_realm_notifiers.size() * 2);
     }
     m_weak_realm_notifiers.emplace_back(realm, realm->config().cache);
+    if (m_weak_realm_notifiers.back().is_cached())
+        m_cached_realms[m_weak_realm_notifiers.back().execution_context()] = {realm, realm.get()};
 
-    if (realm->config().sync_config)
+    if (realm->config().sync_config) {
+        OpenTraceTimer timer(realm->config().open_trace, Realm::OpenPhase::SyncSessionCreation);
         create_sync_session(false);
+        timer.done();
+    }
 
     if (!m_audit_context && audit_factory)
         m_audit_context = audit_factory();
 
+    // Warming up doesn't need the schema to be updated, but the tables may
+    // not exist until it has been
+    bool should_warm_up = !realm->config().warm_up_object_types.empty() && !realm->config().in_memory
+                       && !m_tables_warmed_up.exchange(true);
+
     if (schema) {
         realm_lock.unlock();
         realm->update_schema(std::move(*schema), config.schema_version, std::move(migration_function),
                              std::move(initialization_function));
     }
+    if (should_warm_up)
+        start_warm_up(realm->config());
+}
+
+void RealmCoordinator::start_warm_up(Realm::Config const& config)
+{
+    auto warm_up_config = config;
+    warm_up_config.cache = false;
+    warm_up_config.schema = util::none;
+    warm_up_config.automatic_change_notifications = false;
+    warm_up_config.execution_context = util::none;
+    warm_up_config.notification_executor = nullptr;
+    auto object_types = std::move(warm_up_config.warm_up_object_types);
+    warm_up_config.warm_up_object_types.clear();
+
+    std::weak_ptr<RealmCoordinator> weak_self = shared_from_this();
+    std::lock_guard<std::mutex> lock(m_warm_up_mutex);
+    m_warm_up_thread = std::thread([weak_self = std::move(weak_self), config = std::move(warm_up_config),
+                                    object_types = std::move(object_types)]() mutable {
+        auto self = weak_self.lock();
+        if (!self || self->m_warm_up_cancelled)
+            return;
+        // Warming up is only a hint, so a failure to open the file or read
+        // from it is left for the Realms which actually use it to report
+        try {
+            auto realm = self->get_realm(std::move(config));
+            self->do_warm_up_tables(*realm, object_types);
+            self->m_warm_up_completed = !self->m_warm_up_cancelled;
+        }
+        catch (...) {
+        }
+    });
+}
+
+bool RealmCoordinator::wait_for_warm_up()
+{
+    std::lock_guard<std::mutex> lock(m_warm_up_mutex);
+    if (m_warm_up_thread.joinable() && m_warm_up_thread.get_id() != std::this_thread::get_id())
+        m_warm_up_thread.join();
+    return m_warm_up_completed;
+}
+
+void RealmCoordinator::warm_up_tables(Realm& realm, std::vector<std::string> const& object_types)
+{
+    if (!m_tables_warmed_up.exchange(true))
+        do_warm_up_tables(realm, object_types);
+}
+
+// Read through the data of each table's columns so that it gets paged in.
+// Aggregates are used as they scan the entire column, and a lookup in each
+// search index reads the top of the index, which exact-match queries start
+// from.
+void RealmCoordinator::do_warm_up_tables(Realm& realm, std::vector<std::string> const& object_types)
+{
+    auto& group = realm.read_group();
+    for (auto& object_type : object_types) {
+        if (m_warm_up_cancelled)
+            return;
+        ConstTableRef table = ObjectStore::table_for_object_type(group, object_type);
+        if (!table)
+            continue;
+        for (size_t col = 0, count = table->get_column_count(); col < count; ++col) {
+            bool indexed = table->has_search_index(col);
+            switch (table->get_column_type(col)) {
+                case type_Int:
+                    table->sum_int(col);
+                    if (indexed)
+                        table->find_first_int(col, 0);
+                    break;
+                case type_Float:
+                    table->sum_float(col);
+                    break;
+                case type_Double:
+                    table->sum_double(col);
+                    break;
+                case type_Timestamp:
+                    table->maximum_timestamp(col);
+                    break;
+                case type_String:
+                    table->count_string(col, StringData());
+                    if (indexed)
+                        table->find_first_string(col, StringData());
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
 }
 
 void RealmCoordinator::get_realm(Realm::Config config,
@@ -303,70 +473,353 @@ std::shared_ptr<Realm> RealmCoordinator::get_realm()
     return get_realm(m_config);
 }
 
+std::shared_ptr<Realm> RealmCoordinator::get_frozen_realm(VersionID version)
+{
+    std::shared_ptr<Realm> realm;
+    std::lock_guard<std::mutex> lock(m_frozen_realm_mutex);
+    for (auto it = m_frozen_realms.begin(); it != m_frozen_realms.end(); ) {
+        if (it->second.expired())
+            it = m_frozen_realms.erase(it);
+        else
+            ++it;
+    }
+
+    auto& weak_realm = m_frozen_realms[version];
+    if ((realm = weak_realm.lock()))
+        return realm;
+
+    Realm::Config config = get_config();
+    config.automatic_change_notifications = false;
+    config.cache = false;
+    config.schema = util::none;
+    config.execution_context = util::none;
+    config.notification_executor = nullptr;
+    // Other Realms are already using the file, and compacting it would
+    // discard the version being frozen
+    config.should_compact_on_launch_function = nullptr;
+    realm = get_realm(std::move(config));
+    Realm::Internal::begin_frozen_read(*realm, version);
+    weak_realm = realm;
+    return realm;
+}
+
+std::vector<RealmCoordinator::PinnedVersion> RealmCoordinator::get_pinned_versions()
+{
+    std::vector<PinnedVersion> pins;
+    {
+        std::lock_guard<std::mutex> lock(m_notifier_mutex);
+        if (!m_notifiers.empty() && m_notifier_sg)
+            pins.push_back({PinnedVersion::Holder::Notifiers, m_notifier_version});
+        if (!m_new_notifiers.empty() && m_advancer_sg)
+            pins.push_back({PinnedVersion::Holder::NewNotifiers, m_advancer_sg->get_version_of_current_transaction()});
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_frozen_realm_mutex);
+        for (auto& frozen : m_frozen_realms) {
+            if (!frozen.second.expired())
+                pins.push_back({PinnedVersion::Holder::FrozenRealm, frozen.first});
+        }
+    }
+
+    std::stable_sort(pins.begin(), pins.end(), [](auto& a, auto& b) { return a.version < b.version; });
+    return pins;
+}
+
+void RealmCoordinator::set_pinned_version_alarm(uint64_t max_versions, PinnedVersionAlarm callback)
+{
+    std::lock_guard<std::mutex> lock(m_notifier_mutex);
+    m_pinned_version_alarm_threshold = max_versions;
+    m_pinned_version_alarm = std::move(callback);
+}
+
+namespace {
+size_t estimate_heap_size(Schema const& schema)
+{
+    size_t size = schema.size() * sizeof(ObjectSchema);
+    auto add_properties = [&](std::vector<Property> const& properties) {
+        size += properties.capacity() * sizeof(Property);
+        for (auto& prop : properties)
+            size += prop.name.capacity() + prop.object_type.capacity() + prop.link_origin_property_name.capacity();
+    };
+    for (auto& object_schema : schema) {
+        size += object_schema.name.capacity() + object_schema.primary_key.capacity();
+        add_properties(object_schema.persisted_properties);
+        add_properties(object_schema.computed_properties);
+    }
+    return size;
+}
+} // anonymous namespace
+
+RealmCoordinator::MemoryStats RealmCoordinator::memory_stats()
+{
+    MemoryStats stats{};
+    {
+        std::lock_guard<std::mutex> lock(m_notifier_mutex);
+        for (auto* notifiers : {&m_new_notifiers, &m_notifiers}) {
+            for (auto& notifier : *notifiers) {
+                if (notifier->is_alive())
+                    stats.notifiers.push_back(notifier->memory_stats());
+            }
+        }
+    }
+    for (auto& notifier : stats.notifiers) {
+        auto it = std::find_if(stats.realms.begin(), stats.realms.end(),
+                               [&](auto& realm) { return realm.realm == notifier.realm; });
+        if (it == stats.realms.end()) {
+            stats.realms.push_back(MemoryStats::RealmStats{notifier.realm, 0, 0});
+            it = stats.realms.end() - 1;
+        }
+        ++it->notifiers;
+        it->notifier_bytes += notifier.retained_bytes + notifier.handover_bytes + notifier.change_bytes;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_realm_mutex);
+        stats.open_realms = std::count_if(m_weak_realm_notifiers.begin(), m_weak_realm_notifiers.end(),
+                                          [](auto& notifier) { return !notifier.expired(); });
+        stats.cached_realms = m_cached_realms.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
+        stats.cached_schemas = m_cached_schemas.size();
+        // Schemas which are shared by several cache entries are only counted once
+        std::vector<Schema const*> counted;
+        for (auto& cached : m_cached_schemas) {
+            if (std::find(counted.begin(), counted.end(), cached.schema.get()) != counted.end())
+                continue;
+            counted.push_back(cached.schema.get());
+            stats.cached_schema_bytes += sizeof(Schema) + estimate_heap_size(*cached.schema);
+        }
+    }
+    return stats;
+}
+
+RealmCoordinator::Metrics RealmCoordinator::metrics() const
+{
+    Metrics metrics;
+    metrics.commits = m_metrics.commits.get();
+    metrics.notifier_passes = m_metrics.notifier_passes.get();
+    metrics.notifier_runs = m_metrics.notifier_runs.get();
+    metrics.notifier_run_microseconds = m_metrics.notifier_run_microseconds.snapshot();
+    metrics.changed_rows = m_metrics.changed_rows.snapshot();
+    metrics.handovers = m_metrics.handovers.get();
+    metrics.thread_safe_reference_imports = m_metrics.thread_safe_reference_imports.get();
+    metrics.schema_cache_hits = m_metrics.schema_cache_hits.get();
+    metrics.schema_cache_misses = m_metrics.schema_cache_misses.get();
+    return metrics;
+}
+
+void RealmCoordinator::Metrics::write_prometheus(util::PrometheusWriter& writer, std::string const& path) const
+{
+    auto labels = util::PrometheusWriter::label("path", path);
+    writer.counter("realm_commits_total", "Write transactions committed", commits, labels);
+    writer.counter("realm_notifier_passes_total", "Runs of the async notifiers", notifier_passes, labels);
+    writer.counter("realm_notifier_runs_total", "Runs of individual notifiers", notifier_runs, labels);
+    writer.histogram("realm_notifier_run_microseconds", "Time taken to run a notifier",
+                     notifier_run_microseconds, labels);
+    writer.histogram("realm_notifier_changed_rows", "Rows changed in observed tables per notifier pass",
+                     changed_rows, labels);
+    writer.counter("realm_handovers_total", "Notifier results handed over to target threads", handovers, labels);
+    writer.counter("realm_thread_safe_reference_imports_total", "Thread safe references resolved",
+                   thread_safe_reference_imports, labels);
+    writer.counter("realm_schema_cache_hits_total", "Schema cache lookups which found a schema",
+                   schema_cache_hits, labels);
+    writer.counter("realm_schema_cache_misses_total", "Schema cache lookups which found nothing",
+                   schema_cache_misses, labels);
+}
+
+void RealmCoordinator::on_memory_pressure(MemoryPressure level)
+{
+    bool critical = level == MemoryPressure::Critical;
+    {
+        std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
+        // Realms at the latest version are the most likely to need the
+        // latest schema, so it's kept unless memory is critically low
+        auto end = critical || m_cached_schemas.empty() ? m_cached_schemas.end() : m_cached_schemas.end() - 1;
+        m_cached_schemas.erase(m_cached_schemas.begin(), end);
+        m_cached_schemas.shrink_to_fit();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_notifier_mutex);
+        for (auto& notifier : m_notifiers)
+            notifier->release_memory(critical || !notifier->have_callbacks());
+        // The advancer is only used while there are notifiers, and is reopened
+        // by pin_version() when the next one is registered
+        if (m_notifiers.empty() && m_new_notifiers.empty()) {
+            m_advancer_sg = nullptr;
+            m_advancer_history = nullptr;
+            m_advancer_change_info.clear();
+        }
+        m_warm_results.clear();
+    }
+    m_changeset_cache.clear();
+}
+
+constexpr size_t RealmCoordinator::MaxCachedSchemas;
+
+bool RealmCoordinator::get_cached_schema(std::shared_ptr<const Schema>& schema, uint64_t& schema_version,
+                                         uint64_t& transaction) const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
+    if (m_cached_schemas.empty()) {
+        m_metrics.schema_cache_misses.add();
+        return false;
+    }
+    m_metrics.schema_cache_hits.add();
+    auto& cached = m_cached_schemas.back();
+    schema = cached.schema;
+    schema_version = cached.schema_version;
+    transaction = cached.transaction_version_max;
+    return true;
+}
+
 bool RealmCoordinator::get_cached_schema(Schema& schema, uint64_t& schema_version,
                                          uint64_t& transaction) const noexcept
+{
+    std::shared_ptr<const Schema> cached;
+    if (!get_cached_schema(cached, schema_version, transaction))
+        return false;
+    schema = *cached;
+    return true;
+}
+
+bool RealmCoordinator::get_cached_schema(uint64_t transaction, std::shared_ptr<const Schema>& schema,
+                                         uint64_t& schema_version) noexcept
 {
     std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
-    if (!m_cached_schema)
+    auto cached = find_cached_schema(transaction);
+    if (!cached) {
+        m_metrics.schema_cache_misses.add();
         return false;
-    schema = *m_cached_schema;
-    schema_version = m_schema_version;
-    transaction = m_schema_transaction_version_max;
+    }
+    m_metrics.schema_cache_hits.add();
+    schema = cached->schema;
+    schema_version = cached->schema_version;
     return true;
 }
 
+RealmCoordinator::CachedSchema* RealmCoordinator::find_cached_schema(uint64_t transaction) noexcept
+{
+    for (auto& cached : m_cached_schemas) {
+        if (transaction >= cached.transaction_version_min && transaction <= cached.transaction_version_max) {
+            cached.last_used = ++m_schema_cache_clock;
+            return &cached;
+        }
+    }
+    return nullptr;
+}
+
 void RealmCoordinator::cache_schema(Schema const& new_schema, uint64_t new_schema_version,
                                     uint64_t transaction_version)
+{
+    cache_schema(std::make_shared<const Schema>(new_schema), new_schema_version, transaction_version);
+}
+
+void RealmCoordinator::cache_schema(std::shared_ptr<const Schema> new_schema, uint64_t new_schema_version,
+                                    uint64_t transaction_version)
 {
     std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
-    if (transaction_version < m_schema_transaction_version_max)
+    if (new_schema->empty() || new_schema_version == ObjectStore::NotVersioned)
         return;
-    if (new_schema.empty() || new_schema_version == ObjectStore::NotVersioned)
+    if (find_cached_schema(transaction_version))
         return;
 
-    m_cached_schema = new_schema;
-    m_schema_version = new_schema_version;
-    m_schema_transaction_version_min = transaction_version;
-    m_schema_transaction_version_max = transaction_version;
+    auto it = std::find_if(m_cached_schemas.begin(), m_cached_schemas.end(), [&](auto const& cached) {
+        return cached.transaction_version_min > transaction_version;
+    });
+    if (it == m_cached_schemas.end())
+        m_schema_version = new_schema_version;
+    m_cached_schemas.insert(it, CachedSchema{std::move(new_schema), new_schema_version, transaction_version,
+                                             transaction_version, ++m_schema_cache_clock, {}});
+
+    if (m_cached_schemas.size() > MaxCachedSchemas) {
+        // The latest schema is never discarded, as it's what new Realms use
+        auto lru = std::min_element(m_cached_schemas.begin(), m_cached_schemas.end() - 1,
+                                    [](auto const& a, auto const& b) { return a.last_used < b.last_used; });
+        m_cached_schemas.erase(lru);
+    }
 }
 
 void RealmCoordinator::clear_schema_cache_and_set_schema_version(uint64_t new_schema_version)
 {
     std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
-    m_cached_schema = util::none;
+    m_cached_schemas.clear();
     m_schema_version = new_schema_version;
 }
 
+void RealmCoordinator::reset_change_journal()
+{
+    if (m_change_journal)
+        m_change_journal->reset(get_path());
+}
+
 void RealmCoordinator::advance_schema_cache(uint64_t previous, uint64_t next)
 {
     std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
-    if (!m_cached_schema)
-        return;
-    REALM_ASSERT(previous <= m_schema_transaction_version_max);
-    if (next < m_schema_transaction_version_min)
+    // The schema didn't change between `previous` and `next`, so whichever
+    // cached schema overlaps that range also applies to all of it
+    for (auto& cached : m_cached_schemas) {
+        if (next < cached.transaction_version_min || previous > cached.transaction_version_max)
+            continue;
+        cached.transaction_version_min = std::min(previous, cached.transaction_version_min);
+        cached.transaction_version_max = std::max(next, cached.transaction_version_max);
         return;
-    m_schema_transaction_version_min = std::min(previous, m_schema_transaction_version_min);
-    m_schema_transaction_version_max = std::max(next, m_schema_transaction_version_max);
+    }
 }
 
-RealmCoordinator::RealmCoordinator()
-#if REALM_ENABLE_SYNC
-: m_partial_sync_work_queue(std::make_unique<partial_sync::WorkQueue>())
-#endif
+std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>>
+RealmCoordinator::get_related_tables(Table const& table, uint64_t transaction_version)
 {
+    auto find_related_tables = [&] {
+        auto related = std::make_shared<std::vector<DeepChangeChecker::RelatedTable>>();
+        DeepChangeChecker::find_related_tables(*related, table, m_config.untracked_object_types);
+        return related;
+    };
+
+    size_t table_ndx = table.get_index_in_group();
+    std::lock_guard<std::mutex> lock(m_schema_cache_mutex);
+    auto cached = table_ndx == npos ? nullptr : find_cached_schema(transaction_version);
+    if (!cached)
+        return find_related_tables();
+
+    auto& related = cached->related_tables[table_ndx];
+    if (!related)
+        related = find_related_tables();
+    return related;
 }
 
+RealmCoordinator::RealmCoordinator() = default;
+
 RealmCoordinator::~RealmCoordinator()
 {
-    std::lock_guard<std::mutex> coordinator_lock(s_coordinator_mutex);
-    for (auto it = s_coordinators_per_path.begin(); it != s_coordinators_per_path.end(); ) {
-        if (it->second.expired()) {
-            it = s_coordinators_per_path.erase(it);
-        }
-        else {
-            ++it;
-        }
+    // The warm-up thread holds a strong reference while it's running, so
+    // it's either done or is the thread releasing the last reference
+    if (m_warm_up_thread.joinable()) {
+        if (m_warm_up_thread.get_id() == std::this_thread::get_id())
+            m_warm_up_thread.detach();
+        else
+            m_warm_up_thread.join();
     }
+    // The commit helpers are destroyed after this, and each joins a thread
+    // which may be waiting in on_change()
+    cancel_notifier_interval();
+    if (m_registered_path.empty())
+        return;
+
+#if REALM_ENABLE_SYNC
+    // Partial sync work for this file runs on a pool shared by all
+    // coordinators, so wait for it here as nothing else will once the
+    // Realm is closed
+    partial_sync::WorkQueue::shared().wait_for(m_registered_path);
+#endif
+
+    // Only our own entry can have become dead, so there's no need to scan the
+    // whole map. The entry may have already been replaced by a new
+    // coordinator for the same path, which must be left alone.
+    auto& shard = s_coordinators.shard_for(m_registered_path);
+    std::lock_guard<std::mutex> coordinator_lock(shard.mutex);
+    auto it = shard.coordinators.find(m_registered_path);
+    if (it != shard.coordinators.end() && it->second.expired())
+        shard.coordinators.erase(it);
 }
 
 void RealmCoordinator::unregister_realm(Realm* realm)
@@ -379,26 +832,37 @@ void RealmCoordinator::unregister_realm(Realm* realm)
         clean_up_dead_notifiers();
     }
     {
+        // Other expired entries are left for the sweep in do_get_realm()
         std::lock_guard<std::mutex> lock(m_realm_mutex);
-        auto new_end = remove_if(begin(m_weak_realm_notifiers), end(m_weak_realm_notifiers),
-                                 [=](auto& notifier) { return notifier.expired() || notifier.is_for_realm(realm); });
-        m_weak_realm_notifiers.erase(new_end, end(m_weak_realm_notifiers));
+        auto it = std::find_if(begin(m_weak_realm_notifiers), end(m_weak_realm_notifiers),
+                               [=](auto& notifier) { return notifier.is_for_realm(realm); });
+        if (it != end(m_weak_realm_notifiers)) {
+            auto cached = m_cached_realms.find(it->execution_context());
+            if (cached != m_cached_realms.end() && cached->second.key == realm)
+                m_cached_realms.erase(cached);
+            m_weak_realm_notifiers.erase(it);
+        }
     }
 }
 
 void RealmCoordinator::clear_cache()
 {
     std::vector<WeakRealm> realms_to_close;
-    {
-        std::lock_guard<std::mutex> lock(s_coordinator_mutex);
-
-        for (auto& weak_coordinator : s_coordinators_per_path) {
+    // Destroying a coordinator removes it from the registry, so the strong
+    // references must outlive the shard locks
+    std::vector<std::shared_ptr<RealmCoordinator>> coordinators_to_release;
+    s_coordinators.for_each_shard([&](CoordinatorRegistry::Map& coordinators) {
+        for (auto& weak_coordinator : coordinators) {
             auto coordinator = weak_coordinator.second.lock();
             if (!coordinator) {
                 continue;
             }
+            coordinators_to_release.push_back(coordinator);
 
+            coordinator->cancel_notifier_interval();
+            coordinator->m_warm_up_cancelled = true;
             coordinator->m_notifier = nullptr;
+            coordinator->m_local_notifier = nullptr;
 
             // Gather a list of all of the realms which will be removed
             for (auto& weak_realm_notifier : coordinator->m_weak_realm_notifiers) {
@@ -408,27 +872,28 @@ void RealmCoordinator::clear_cache()
             }
         }
 
-        s_coordinators_per_path.clear();
-    }
+        coordinators.clear();
+    });
 
     // Close all of the previously cached Realms. This can't be done while
-    // s_coordinator_mutex is held as it may try to re-lock it.
+    // the registry's locks are held as it may try to re-lock them.
     for (auto& weak_realm : realms_to_close) {
         if (auto realm = weak_realm.lock()) {
             realm->close();
         }
     }
+    for (auto& coordinator : coordinators_to_release)
+        coordinator->wait_for_warm_up();
 }
 
 void RealmCoordinator::clear_all_caches()
 {
     std::vector<std::weak_ptr<RealmCoordinator>> to_clear;
-    {
-        std::lock_guard<std::mutex> lock(s_coordinator_mutex);
-        for (auto iter : s_coordinators_per_path) {
+    s_coordinators.for_each_shard([&](CoordinatorRegistry::Map& coordinators) {
+        for (auto& iter : coordinators) {
             to_clear.push_back(iter.second);
         }
-    }
+    });
     for (auto weak_coordinator : to_clear) {
         if (auto coordinator = weak_coordinator.lock()) {
             coordinator->clear_cache();
@@ -439,24 +904,122 @@ void RealmCoordinator::clear_all_caches()
 void RealmCoordinator::assert_no_open_realms() noexcept
 {
 #ifdef REALM_DEBUG
-    std::lock_guard<std::mutex> lock(s_coordinator_mutex);
-    REALM_ASSERT(s_coordinators_per_path.empty());
+    s_coordinators.for_each_shard([](CoordinatorRegistry::Map& coordinators) {
+        REALM_ASSERT(coordinators.empty());
+    });
 #endif
 }
 
+void RealmCoordinator::post_async_write(AsyncWrite write)
+{
+    std::lock_guard<std::mutex> lock(m_async_write_mutex);
+    m_async_writes.push_back(std::move(write));
+    if (m_async_writer_running)
+        return;
+    m_async_writer_running = true;
+
+    // The thread keeps the coordinator alive until it has run out of writes,
+    // so it's detached rather than joined by the destructor
+    std::thread([self = shared_from_this()] {
+        // Kept open between batches so that a burst of writes doesn't have
+        // to open a new Realm for each one
+        std::shared_ptr<Realm> realm;
+        while (true) {
+            std::vector<AsyncWrite> batch;
+            {
+                std::lock_guard<std::mutex> lock(self->m_async_write_mutex);
+                auto& queue = self->m_async_writes;
+                if (queue.empty()) {
+                    self->m_async_writer_running = false;
+                    return;
+                }
+                do {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                } while (batch.front().groupable && !queue.empty() && queue.front().groupable);
+            }
+            self->perform_async_writes(realm, batch);
+        }
+    }).detach();
+}
+
+void RealmCoordinator::perform_async_writes(std::shared_ptr<Realm>& realm, std::vector<AsyncWrite>& writes)
+{
+    std::vector<std::exception_ptr> errors(writes.size());
+    try {
+        if (!realm)
+            realm = Realm::get_shared_realm(writes.front().config);
+
+        // The changes made by a write which throws can't be rolled back
+        // without also rolling back the others, so the transaction is
+        // cancelled and the other writes are performed again without it
+        size_t remaining = writes.size();
+        while (remaining) {
+            realm->begin_transaction();
+            bool failed = false;
+            for (size_t i = 0; i < writes.size() && !failed; ++i) {
+                if (errors[i])
+                    continue;
+                try {
+                    writes[i].write(*realm);
+                }
+                catch (...) {
+                    errors[i] = std::current_exception();
+                    --remaining;
+                    failed = true;
+                }
+            }
+            if (failed) {
+                realm->cancel_transaction();
+                continue;
+            }
+            realm->commit_transaction();
+            break;
+        }
+    }
+    catch (...) {
+        auto error = std::current_exception();
+        for (auto& e : errors) {
+            if (!e)
+                e = error;
+        }
+        // Reopen the Realm for the next batch rather than trying to work out
+        // what state it was left in
+        realm = nullptr;
+    }
+
+    for (size_t i = 0; i < writes.size(); ++i)
+        writes[i].done(errors[i]);
+}
+
 void RealmCoordinator::wake_up_notifier_worker()
 {
-    if (m_notifier) {
+    if (m_notifier || m_local_notifier) {
+        // A wakeup which the worker hasn't acted on yet will also pick up
+        // whatever this one was for, as the pass which it triggers starts
+        // after this point
+        if (m_notifier_wakeup_pending.exchange(true))
+            return;
         // FIXME: this wakes up the notification workers for all processes and
         // not just us. This might be worth optimizing in the future.
-        m_notifier->notify_others();
+        notify_others();
     }
 }
 
-void RealmCoordinator::commit_write(Realm& realm)
+void RealmCoordinator::notify_others()
+{
+    if (m_notifier)
+        m_notifier->notify_others();
+    else if (m_local_notifier)
+        m_local_notifier->notify_others();
+}
+
+void RealmCoordinator::commit_write(Realm& realm, bool bulk_load)
 {
     REALM_ASSERT(!m_config.immutable());
     REALM_ASSERT(realm.is_in_transaction());
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::Commit);
+    m_metrics.commits.add();
 
     {
         // Need to acquire this lock before committing or another process could
@@ -464,7 +1027,17 @@ void RealmCoordinator::commit_write(Realm& realm)
         // skip version
         std::lock_guard<std::mutex> l(m_notifier_mutex);
 
-        transaction::commit(*Realm::Internal::get_shared_group(realm));
+        // Bulk loads are left out of the journal so that other processes
+        // calculate their changes as usual
+        if (m_change_journal && !bulk_load)
+            transaction::commit(*Realm::Internal::get_shared_group(realm), *realm.history(), *m_change_journal);
+        else
+            transaction::commit(*Realm::Internal::get_shared_group(realm));
+        span.set_version(Realm::Internal::get_shared_group(realm)->get_version_of_current_transaction().version);
+        // Recorded while holding the notifier lock so that the notifiers
+        // can't advance over the commit before it's marked
+        if (bulk_load)
+            m_changeset_cache.add_untracked_version(Realm::Internal::get_shared_group(realm)->get_version_of_current_transaction().version);
 
         // Don't need to check m_new_notifiers because those don't skip versions
         bool have_notifiers = std::any_of(m_notifiers.begin(), m_notifiers.end(),
@@ -486,9 +1059,7 @@ void RealmCoordinator::commit_write(Realm& realm)
         realm.m_binding_context->did_change({}, {});
     }
 
-    if (m_notifier) {
-        m_notifier->notify_others();
-    }
+    notify_others();
 }
 
 void RealmCoordinator::pin_version(VersionID versionid)
@@ -538,38 +1109,106 @@ void RealmCoordinator::register_notifier(std::shared_ptr<CollectionNotifier> not
     }
 }
 
+NotificationToken RealmCoordinator::observe_table_changes(std::shared_ptr<Realm> const& realm,
+                                                          std::vector<size_t> table_indices,
+                                                          TableChangeInfoNotifier::Callback callback)
+{
+    // The notifier starts from the version of the Realm's read transaction
+    realm->read_group();
+    auto notifier = std::make_shared<TableChangeInfoNotifier>(realm, std::move(table_indices), std::move(callback));
+
+    // Nothing is delivered to the Realm's thread, so the collection callback
+    // only exists to unregister the notifier once the token is destroyed. It's
+    // background priority so that refreshing the Realm never waits for it.
+    struct Lifetime {
+        std::weak_ptr<TableChangeInfoNotifier> notifier;
+        ~Lifetime()
+        {
+            if (auto n = notifier.lock())
+                n->unregister();
+        }
+    };
+    auto lifetime = std::make_shared<Lifetime>();
+    lifetime->notifier = notifier;
+    uint64_t token = notifier->add_callback([lifetime](CollectionChangeSet, std::exception_ptr) { },
+                                            NotificationPriority::Background);
+    register_notifier(notifier);
+    return {std::move(notifier), token};
+}
+
+std::shared_ptr<ResultsNotifier> RealmCoordinator::find_shared_results_notifier(Realm& realm, std::string const& key)
+{
+    REALM_ASSERT(!key.empty());
+    auto& self = Realm::Internal::get_coordinator(realm);
+    std::lock_guard<std::mutex> lock(self.m_notifier_mutex);
+    auto find = [&](auto const& container) -> std::shared_ptr<ResultsNotifier> {
+        for (auto& notifier : container) {
+            if (!notifier->is_for_realm(realm) || !notifier->is_alive())
+                continue;
+            auto results_notifier = std::dynamic_pointer_cast<ResultsNotifier>(notifier);
+            if (results_notifier && results_notifier->sharing_key() == key)
+                return results_notifier;
+        }
+        return nullptr;
+    };
+    if (auto notifier = find(self.m_new_notifiers))
+        return notifier;
+    return find(self.m_notifiers);
+}
+
 void RealmCoordinator::clean_up_dead_notifiers()
 {
-    auto swap_remove = [&](auto& container) {
+    // Most passes have nothing to clean up, and when notifiers have died we
+    // can stop looking once we've found all of them. The count can include
+    // notifiers which never made it into either container, in which case we
+    // just end up checking everything.
+    size_t dead_count = m_dead_notifier_count.exchange(0);
+    if (dead_count == 0)
+        return;
+
+    auto swap_remove = [&](auto& container, bool retain_rows) {
         bool did_remove = false;
-        for (size_t i = 0; i < container.size(); ++i) {
-            if (container[i]->is_alive())
+        // Recently added notifiers are at the back and are the most likely
+        // to be short-lived, so search from there
+        for (size_t i = container.size(); dead_count > 0 && i > 0; --i) {
+            auto& notifier = container[i - 1];
+            if (notifier->is_alive())
                 continue;
 
+            if (retain_rows)
+                retain_warm_results(*notifier);
             // Ensure the notifier is destroyed here even if there's lingering refs
             // to the async notifier elsewhere
-            container[i]->release_data();
+            notifier->release_data();
 
-            if (container.size() > i + 1)
-                container[i] = std::move(container.back());
+            // Everything after i - 1 has already been checked, so the
+            // notifier moved into this slot doesn't need to be looked at again
+            if (container.size() > i)
+                notifier = std::move(container.back());
             container.pop_back();
-            --i;
+            --dead_count;
             did_remove = true;
         }
         return did_remove;
     };
 
-    if (swap_remove(m_notifiers)) {
+    // New notifiers are checked first as they're the most likely to be ones
+    // which were created and then immediately discarded
+    bool removed_new = swap_remove(m_new_notifiers, false);
+    if (swap_remove(m_notifiers, true)) {
         // Make sure we aren't holding on to read versions needlessly if there
         // are no notifiers left, but don't close them entirely as opening shared
         // groups is expensive
         if (m_notifiers.empty() && m_notifier_sg) {
             REALM_ASSERT_3(m_notifier_sg->get_transact_stage(), ==, SharedGroup::transact_Reading);
             m_notifier_sg->end_read();
+            for (auto& worker : m_notifier_workers)
+                worker.sg->end_read();
             m_notifier_skip_version = {0, 0};
+            m_changeset_cache.clear();
         }
     }
-    if (swap_remove(m_new_notifiers) && m_advancer_sg) {
+    if (removed_new && m_advancer_sg) {
         REALM_ASSERT_3(m_advancer_sg->get_transact_stage(), ==, SharedGroup::transact_Reading);
         if (m_new_notifiers.empty()) {
             m_advancer_sg->end_read();
@@ -577,10 +1216,54 @@ void RealmCoordinator::clean_up_dead_notifiers()
     }
 }
 
+void RealmCoordinator::cancel_notifier_interval()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_notifier_interval_mutex);
+        m_notifier_interval_cancelled = true;
+    }
+    m_notifier_interval_cv.notify_all();
+}
+
 void RealmCoordinator::on_change()
 {
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::OnChange);
+    // Wait for the rest of the interval before running the notifiers again.
+    // Any commits made while waiting are still picked up by this run, as it
+    // always advances to the latest version.
+    if (m_config.notifier_interval.count() > 0) {
+        auto next_run = m_last_notifier_run + m_config.notifier_interval;
+        std::unique_lock<std::mutex> lock(m_notifier_interval_mutex);
+        if (m_notifier_interval_cv.wait_until(lock, next_run, [&] { return m_notifier_interval_cancelled; }))
+            return;
+        m_last_notifier_run = std::chrono::steady_clock::now();
+    }
+
+    auto observer = g_binding_callback_thread_observer;
+    std::chrono::steady_clock::time_point start;
+    if (observer) {
+        start = std::chrono::steady_clock::now();
+        m_notifiers_run = 0;
+        m_longest_notifier_run = 0;
+    }
+
     run_async_notifiers();
+    span.set_version(m_notifier_version.version);
+    notify_realms();
+
+    if (observer) {
+        observer->did_run_loop_iteration({
+            std::chrono::steady_clock::now() - start,
+            m_notifiers_run.load(),
+            std::chrono::nanoseconds(m_longest_notifier_run.load())
+        });
+    }
+}
 
+void RealmCoordinator::notify_realms()
+{
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::SignalRealms,
+                               m_notifier_version.version);
     std::lock_guard<std::mutex> lock(m_realm_mutex);
     for (auto& realm : m_weak_realm_notifiers) {
         realm.notify();
@@ -590,9 +1273,14 @@ void RealmCoordinator::on_change()
 namespace {
 class IncrementalChangeInfo {
 public:
-    IncrementalChangeInfo(SharedGroup& sg,
+    // The change infos are stored in `storage`, which has to outlive running
+    // the notifiers as they hold pointers into it
+    IncrementalChangeInfo(SharedGroup& sg, transaction::ChangesetCache& cache,
+                          std::vector<TransactionChangeInfo>& storage,
                           std::vector<std::shared_ptr<_impl::CollectionNotifier>>& notifiers)
-    : m_sg(sg)
+    : m_info(storage)
+    , m_sg(sg)
+    , m_cache(cache)
     {
         if (notifiers.empty())
             return;
@@ -606,15 +1294,16 @@ public:
         std::sort(notifiers.begin(), notifiers.end(), cmp);
 
         // Preallocate the required amount of space in the vector so that we can
-        // safely give out pointers to within the vector
+        // safely give out pointers to within the vector. The change infos
+        // left from the previous pass are cleared and reused rather than
+        // reallocated.
         size_t count = 1;
         for (auto it = notifiers.begin(), next = it + 1; next != notifiers.end(); ++it, ++next) {
             if (cmp(*it, *next))
                 ++count;
         }
         m_info.reserve(count);
-        m_info.resize(1);
-        m_current = &m_info[0];
+        m_current = &next_info();
     }
 
     TransactionChangeInfo& current() const { return *m_current; }
@@ -622,12 +1311,12 @@ public:
     bool advance_incremental(VersionID version)
     {
         if (version != m_sg.get_version_of_current_transaction()) {
-            transaction::advance(m_sg, *m_current, version);
-            m_info.push_back({
-                m_current->table_modifications_needed,
-                m_current->table_moves_needed,
-                std::move(m_current->lists)});
-            m_current = &m_info.back();
+            m_cache.advance(m_sg, *m_current, version);
+            auto& next = next_info();
+            next.table_modifications_needed = m_current->table_modifications_needed;
+            next.table_moves_needed = m_current->table_moves_needed;
+            next.lists = std::move(m_current->lists);
+            m_current = &next;
             return true;
         }
         return false;
@@ -640,28 +1329,23 @@ public:
             return;
         }
 
-        transaction::advance(m_sg, *m_current, version);
+        m_cache.advance(m_sg, *m_current, version);
 
         // We now need to combine the transaction change info objects so that all of
         // the notifiers see the complete set of changes from their first version to
         // the most recent one
-        for (size_t i = m_info.size() - 1; i > 0; --i) {
+        for (size_t i = m_used - 1; i > 0; --i) {
             auto& cur = m_info[i];
+            auto& prev = m_info[i - 1];
+            if (cur.changes_unknown)
+                prev.changes_unknown = true;
             if (cur.tables.empty())
                 continue;
-            auto& prev = m_info[i - 1];
             if (prev.tables.empty()) {
                 prev.tables = cur.tables;
                 continue;
             }
-
-            for (size_t j = 0; j < prev.tables.size() && j < cur.tables.size(); ++j) {
-                prev.tables[j].merge(CollectionChangeBuilder{cur.tables[j]});
-            }
-            prev.tables.reserve(cur.tables.size());
-            while (prev.tables.size() < cur.tables.size()) {
-                prev.tables.push_back(cur.tables[prev.tables.size()]);
-            }
+            prev.tables.merge(cur.tables);
         }
 
         // Copy the list change info if there are multiple LinkViews for the same LinkList
@@ -676,15 +1360,69 @@ public:
     }
 
 private:
-    std::vector<TransactionChangeInfo> m_info;
+    std::vector<TransactionChangeInfo>& m_info;
+    // The number of entries in m_info used by this pass
+    size_t m_used = 0;
     TransactionChangeInfo* m_current = nullptr;
     SharedGroup& m_sg;
+    transaction::ChangesetCache& m_cache;
+
+    TransactionChangeInfo& next_info()
+    {
+        REALM_ASSERT_DEBUG(m_used < m_info.capacity());
+        if (m_used == m_info.size())
+            m_info.emplace_back();
+        else
+            m_info[m_used].clear();
+        return m_info[m_used++];
+    }
 };
 } // anonymous namespace
 
+constexpr size_t RealmCoordinator::MaxWarmResults;
+
+void RealmCoordinator::retain_warm_results(CollectionNotifier& notifier)
+{
+    auto results_notifier = dynamic_cast<ResultsNotifier*>(&notifier);
+    if (!results_notifier)
+        return;
+    WarmResults warm{results_notifier->sharing_key(), results_notifier->version(), {}};
+    if (!results_notifier->release_rows_for_reuse(warm.rows))
+        return;
+
+    auto it = std::find_if(m_warm_results.begin(), m_warm_results.end(),
+                           [&](auto& entry) { return entry.sharing_key == warm.sharing_key; });
+    if (it != m_warm_results.end())
+        m_warm_results.erase(it);
+    else if (m_warm_results.size() == MaxWarmResults)
+        m_warm_results.erase(m_warm_results.begin());
+    m_warm_results.push_back(std::move(warm));
+}
+
+void RealmCoordinator::adopt_warm_results(CollectionNotifier& notifier)
+{
+    if (m_warm_results.empty())
+        return;
+    auto results_notifier = dynamic_cast<ResultsNotifier*>(&notifier);
+    if (!results_notifier || results_notifier->sharing_key().empty())
+        return;
+
+    auto it = std::find_if(m_warm_results.begin(), m_warm_results.end(), [&](auto& entry) {
+        return entry.sharing_key == results_notifier->sharing_key() && entry.version == notifier.version();
+    });
+    if (it == m_warm_results.end())
+        return;
+    results_notifier->adopt_rows(std::move(it->rows));
+    m_warm_results.erase(it);
+}
+
 void RealmCoordinator::run_async_notifiers()
 {
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::RunNotifiers);
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
+    // Anything registered or requested after this point needs a new wakeup
+    // since it may miss this pass; everything before it will be handled by it
+    m_notifier_wakeup_pending = false;
 
     clean_up_dead_notifiers();
 
@@ -701,12 +1439,20 @@ void RealmCoordinator::run_async_notifiers()
         m_new_notifiers.clear();
         return;
     }
-
+    m_metrics.notifier_passes.add();
+
+    // Each pass advances the notifiers straight to the latest version, however
+    // many commits were made since the previous pass, so a notifier thread
+    // which falls behind catches up in a single run over the merged changes
+    // rather than working through a queue of versions. The only intermediate
+    // version which is stopped at is the skip version below, as the changes
+    // up to it have to be handed over separately for the skipped callbacks.
     VersionID version;
 
     // Advance all of the new notifiers to the most recent version, if any
     auto new_notifiers = std::move(m_new_notifiers);
-    IncrementalChangeInfo new_notifier_change_info(*m_advancer_sg, new_notifiers);
+    IncrementalChangeInfo new_notifier_change_info(*m_advancer_sg, m_changeset_cache,
+                                                   m_advancer_change_info, new_notifiers);
 
     if (!new_notifiers.empty()) {
         REALM_ASSERT_3(m_advancer_sg->get_transact_stage(), ==, SharedGroup::transact_Reading);
@@ -728,6 +1474,7 @@ void RealmCoordinator::run_async_notifiers()
         for (auto& notifier : new_notifiers) {
             new_notifier_change_info.advance_incremental(notifier->version());
             notifier->attach_to(*m_advancer_sg);
+            adopt_warm_results(*notifier);
             notifier->add_required_change_info(new_notifier_change_info.current());
         }
         new_notifier_change_info.advance_to_final(VersionID{});
@@ -753,6 +1500,17 @@ void RealmCoordinator::run_async_notifiers()
         m_advancer_sg->end_read();
     }
     REALM_ASSERT_3(m_advancer_sg->get_transact_stage(), ==, SharedGroup::transact_Ready);
+    m_notifier_version = version;
+    span.set_version(version.version);
+
+    // The alarm is called after releasing the lock, as it's user code
+    PinnedVersionAlarm pinned_version_alarm;
+    uint64_t live_versions = 0;
+    if (m_pinned_version_alarm) {
+        live_versions = m_advancer_sg->get_number_of_versions();
+        if (live_versions > m_pinned_version_alarm_threshold)
+            pinned_version_alarm = m_pinned_version_alarm;
+    }
 
     auto skip_version = m_notifier_skip_version;
     m_notifier_skip_version = {0, 0};
@@ -763,54 +1521,210 @@ void RealmCoordinator::run_async_notifiers()
     m_notifiers.insert(m_notifiers.end(), new_notifiers.begin(), new_notifiers.end());
     lock.unlock();
 
-    if (skip_version.version) {
-        REALM_ASSERT(!notifiers.empty());
+    if (pinned_version_alarm)
+        pinned_version_alarm(live_versions, get_pinned_versions());
+
+    using NotifierVector = std::vector<std::shared_ptr<_impl::CollectionNotifier>>;
+    // The background priority notifiers for each SharedGroup, which are left
+    // for after the others have been handed over
+    std::vector<NotifierVector> deferred(m_notifier_workers.size() + 1);
+
+    if (m_notifier_workers.empty()) {
+        run_notifiers_on(*m_notifier_sg, notifiers, new_notifiers, skip_version, version,
+                         deferred[0], m_notifier_change_info);
+    }
+    else {
+        // Split the notifiers up between the SharedGroups, keeping existing
+        // notifiers on the one they're already attached to and assigning new
+        // ones to whichever currently has the fewest notifiers
+        std::vector<SharedGroup*> sgs = {m_notifier_sg.get()};
+        std::vector<std::vector<TransactionChangeInfo>*> change_info = {&m_notifier_change_info};
+        for (auto& worker : m_notifier_workers) {
+            sgs.push_back(worker.sg.get());
+            change_info.push_back(&worker.change_info);
+        }
+
+        std::vector<NotifierVector> notifiers_for_sg(sgs.size());
+        std::vector<NotifierVector> new_notifiers_for_sg(sgs.size());
+        for (auto& notifier : notifiers) {
+            auto it = std::find_if(sgs.begin(), sgs.end(),
+                                   [&](auto sg) { return notifier->is_attached_to(*sg); });
+            REALM_ASSERT(it != sgs.end());
+            notifiers_for_sg[it - sgs.begin()].push_back(notifier);
+        }
+        auto load = [&](size_t i) { return notifiers_for_sg[i].size() + new_notifiers_for_sg[i].size(); };
+        for (auto& notifier : new_notifiers) {
+            size_t best = 0;
+            for (size_t i = 1; i < sgs.size(); ++i) {
+                if (load(i) < load(best))
+                    best = i;
+            }
+            new_notifiers_for_sg[best].push_back(notifier);
+        }
+
+        std::vector<std::function<void()>> jobs;
+        jobs.reserve(sgs.size());
+        for (size_t i = 0; i < sgs.size(); ++i) {
+            jobs.push_back([&, i] {
+                run_notifiers_on(*sgs[i], notifiers_for_sg[i], new_notifiers_for_sg[i],
+                                 skip_version, version, deferred[i], *change_info[i]);
+            });
+        }
+        m_notifier_thread_pool->run_all(std::move(jobs));
+    }
+
+    // Reacquire the lock while updating the fields that are actually read on
+    // other threads
+    lock.lock();
+    bool any_deferred = false;
+    for (auto& notifiers_for_sg : deferred) {
+        for (auto& notifier : notifiers_for_sg) {
+            notifier->set_deferred(true);
+            any_deferred = true;
+        }
+    }
+    for (auto& notifier : new_notifiers) {
+        if (!notifier->is_deferred())
+            prepare_handover(*notifier);
+    }
+    for (auto& notifier : notifiers) {
+        if (!notifier->is_deferred())
+            prepare_handover(*notifier);
+    }
+
+    if (any_deferred) {
+        // Let the Realms deliver the interactive notifications before running
+        // the background notifiers
+        m_notifier_cv.notify_all();
+        lock.unlock();
+        notify_realms();
+
+        std::vector<std::function<void()>> jobs;
+        for (auto& notifiers_for_sg : deferred) {
+            if (notifiers_for_sg.empty())
+                continue;
+            jobs.push_back([&] {
+                for (auto& notifier : notifiers_for_sg)
+                    run_notifier(*notifier, version);
+            });
+        }
+        if (m_notifier_thread_pool)
+            m_notifier_thread_pool->run_all(std::move(jobs));
+        else
+            jobs.front()();
+
+        lock.lock();
+        for (auto& notifiers_for_sg : deferred) {
+            for (auto& notifier : notifiers_for_sg) {
+                prepare_handover(*notifier);
+                notifier->set_deferred(false);
+            }
+        }
+    }
+
+    clean_up_dead_notifiers();
+    m_notifier_cv.notify_all();
+}
+
+void RealmCoordinator::run_notifier(_impl::CollectionNotifier& notifier, VersionID version)
+{
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::NotifierRun,
+                               notifier, version.version);
+    auto start = std::chrono::steady_clock::now();
+    notifier.run();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    m_metrics.notifier_runs.add();
+    m_metrics.notifier_run_microseconds.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    if (!g_binding_callback_thread_observer)
+        return;
+
+    auto duration = std::chrono::nanoseconds(elapsed).count();
+    ++m_notifiers_run;
+    // May be run on several notifier threads at once
+    auto longest = m_longest_notifier_run.load();
+    while (duration > longest && !m_longest_notifier_run.compare_exchange_weak(longest, duration))
+        ;
+}
+
+void RealmCoordinator::prepare_handover(_impl::CollectionNotifier& notifier)
+{
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::PrepareHandover, notifier, 0);
+    notifier.prepare_handover();
+    span.set_version(notifier.version().version);
+    m_metrics.handovers.add();
+}
+
+void RealmCoordinator::record_changed_rows(TransactionChangeInfo const& info)
+{
+    // Bulk loads don't calculate changes, so there's nothing to count
+    if (info.changes_unknown)
+        return;
+    uint64_t rows = 0;
+    for (auto& table : info.tables)
+        rows += table.changes->insertions.count() + table.changes->deletions.count()
+              + table.changes->modifications.count();
+    m_metrics.changed_rows.record(rows);
+}
+
+// Advance `sg` to `version` and run all of the notifiers attached to it, plus
+// attach and run the new notifiers which have been assigned to it. This may be
+// called for multiple SharedGroups in parallel, and so must not touch any of
+// the coordinator's state without acquiring m_notifier_mutex. The background
+// notifiers added to `deferred` read the change info stored in
+// `change_info_storage` when they're run after this returns.
+void RealmCoordinator::run_notifiers_on(SharedGroup& sg,
+                                        std::vector<std::shared_ptr<_impl::CollectionNotifier>>& notifiers,
+                                        std::vector<std::shared_ptr<_impl::CollectionNotifier>>& new_notifiers,
+                                        VersionID skip_version, VersionID version,
+                                        std::vector<std::shared_ptr<_impl::CollectionNotifier>>& deferred,
+                                        std::vector<TransactionChangeInfo>& change_info_storage)
+{
+    if (skip_version.version && !notifiers.empty()) {
         REALM_ASSERT(version >= skip_version);
-        IncrementalChangeInfo change_info(*m_notifier_sg, notifiers);
+        IncrementalChangeInfo change_info(sg, m_changeset_cache, change_info_storage, notifiers);
         for (auto& notifier : notifiers)
             notifier->add_required_change_info(change_info.current());
         change_info.advance_to_final(skip_version);
 
         for (auto& notifier : notifiers)
-            notifier->run();
+            run_notifier(*notifier, skip_version);
 
-        lock.lock();
+        std::lock_guard<std::mutex> lock(m_notifier_mutex);
         for (auto& notifier : notifiers)
-            notifier->prepare_handover();
-        lock.unlock();
+            prepare_handover(*notifier);
     }
 
     // Advance the non-new notifiers to the same version as we advanced the new
     // ones to (or the latest if there were no new ones)
-    IncrementalChangeInfo change_info(*m_notifier_sg, notifiers);
+    IncrementalChangeInfo change_info(sg, m_changeset_cache, change_info_storage, notifiers);
     for (auto& notifier : notifiers) {
         notifier->add_required_change_info(change_info.current());
     }
     change_info.advance_to_final(version);
+    if (!notifiers.empty())
+        record_changed_rows(change_info.current());
+
+    // Background priority notifiers are run after the others have been
+    // handed over, so that they don't delay the interactive notifications
+    auto run = [&](auto& notifier) {
+        if (notifier->is_background())
+            deferred.push_back(notifier);
+        else
+            run_notifier(*notifier, version);
+    };
 
-    // Attach the new notifiers to the main SG and move them to the main list
+    // Attach the new notifiers to this SG now that it's at the version they
+    // were advanced to
     for (auto& notifier : new_notifiers) {
-        notifier->attach_to(*m_notifier_sg);
-        notifier->run();
+        notifier->attach_to(sg);
+        run(notifier);
     }
 
     // Change info is now all ready, so the notifiers can now perform their
     // background work
     for (auto& notifier : notifiers) {
-        notifier->run();
-    }
-
-    // Reacquire the lock while updating the fields that are actually read on
-    // other threads
-    lock.lock();
-    for (auto& notifier : new_notifiers) {
-        notifier->prepare_handover();
-    }
-    for (auto& notifier : notifiers) {
-        notifier->prepare_handover();
+        run(notifier);
     }
-    clean_up_dead_notifiers();
-    m_notifier_cv.notify_all();
 }
 
 void RealmCoordinator::open_helper_shared_group()
@@ -821,30 +1735,56 @@ void RealmCoordinator::open_helper_shared_group()
             Realm::open_with_config(m_config, m_notifier_history, m_notifier_sg, read_only_group, nullptr);
             REALM_ASSERT(!read_only_group);
             m_notifier_sg->begin_read();
+
+            auto version = m_notifier_sg->get_version_of_current_transaction();
+            m_notifier_workers.resize(std::max<size_t>(m_config.notifier_thread_count, 1) - 1);
+            for (auto& worker : m_notifier_workers) {
+                Realm::open_with_config(m_config, worker.history, worker.sg, read_only_group, nullptr);
+                REALM_ASSERT(!read_only_group);
+                worker.sg->begin_read(version);
+            }
+            if (!m_notifier_workers.empty())
+                m_notifier_thread_pool = std::make_unique<util::ThreadPool>(m_notifier_workers.size());
         }
         catch (...) {
             // Store the error to be passed to the async notifiers
             m_async_error = std::current_exception();
+            m_notifier_thread_pool = nullptr;
+            m_notifier_workers.clear();
             m_notifier_sg = nullptr;
             m_notifier_history = nullptr;
         }
     }
     else if (m_notifiers.empty()) {
         m_notifier_sg->begin_read();
+        auto version = m_notifier_sg->get_version_of_current_transaction();
+        for (auto& worker : m_notifier_workers)
+            worker.sg->begin_read(version);
     }
 }
 
 void RealmCoordinator::advance_to_ready(Realm& realm)
 {
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::DeliverNotifications);
+    if (!deliver_pending_notifications(realm, true))
+        return;
+
+    auto& sg = Realm::Internal::get_shared_group(realm);
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     _impl::NotifierPackage notifiers(m_async_error, notifiers_for_realm(realm), this);
     lock.unlock();
+    // Notifiers which are behind the Realm because advancing it didn't wait
+    // for them would otherwise have their changes discarded below
+    if (m_config.notifier_wait_limit.count() > 0)
+        notifiers.set_minimum_version(sg->get_version_of_current_transaction().version);
     notifiers.package_and_wait(util::none);
+    if (m_config.notification_delivery_budget.count() > 0)
+        notifiers.set_delivery_deadline(std::chrono::steady_clock::now() + m_config.notification_delivery_budget);
 
-    auto& sg = Realm::Internal::get_shared_group(realm);
     if (notifiers) {
         auto version = notifiers.version();
         if (version) {
+            span.set_version(version->version);
             auto current_version = sg->get_version_of_current_transaction();
             // Notifications are out of date, so just discard
             // This should only happen if begin_read() was used to change the
@@ -860,12 +1800,71 @@ void RealmCoordinator::advance_to_ready(Realm& realm)
                 notifiers.after_advance();
                 if (realm.m_binding_context)
                     realm.m_binding_context->did_send_notifications();
+                wake_up_if_pending(realm);
                 return;
             }
         }
     }
 
     transaction::advance(sg, realm.m_binding_context.get(), notifiers);
+    if (!realm.is_closed())
+        wake_up_if_pending(realm);
+}
+
+std::vector<std::shared_ptr<_impl::CollectionNotifier>> RealmCoordinator::pending_notifiers_for_realm(Realm& realm)
+{
+    std::vector<std::shared_ptr<_impl::CollectionNotifier>> ret;
+    if (m_config.notification_delivery_budget.count() == 0)
+        return ret;
+    std::lock_guard<std::mutex> lock(m_notifier_mutex);
+    ret = notifiers_for_realm(realm);
+    ret.erase(std::remove_if(begin(ret), end(ret), [](auto& n) { return !n->has_pending_delivery(); }), end(ret));
+    return ret;
+}
+
+bool RealmCoordinator::deliver_pending_notifications(Realm& realm, bool use_budget)
+{
+    auto notifiers = pending_notifiers_for_realm(realm);
+    if (notifiers.empty())
+        return true;
+
+    auto deadline = std::chrono::steady_clock::now() + m_config.notification_delivery_budget;
+    if (realm.m_binding_context)
+        realm.m_binding_context->will_send_notifications();
+    for (auto& notifier : notifiers) {
+        if (use_budget && std::chrono::steady_clock::now() > deadline)
+            break;
+        notifier->after_advance();
+        if (realm.is_closed())
+            return false;
+    }
+    if (realm.m_binding_context)
+        realm.m_binding_context->did_send_notifications();
+    if (realm.is_closed())
+        return false;
+
+    // Leave anything newer for the next wakeup if we've used up the budget
+    bool pending = std::any_of(begin(notifiers), end(notifiers), [](auto& n) { return n->has_pending_delivery(); });
+    if (use_budget && (pending || std::chrono::steady_clock::now() > deadline)) {
+        wake_up_realm(realm);
+        return false;
+    }
+    return true;
+}
+
+void RealmCoordinator::wake_up_if_pending(Realm& realm)
+{
+    if (!pending_notifiers_for_realm(realm).empty())
+        wake_up_realm(realm);
+}
+
+void RealmCoordinator::wake_up_realm(Realm& realm)
+{
+    std::lock_guard<std::mutex> lock(m_realm_mutex);
+    for (auto& weak_realm_notifier : m_weak_realm_notifiers) {
+        if (weak_realm_notifier.is_for_realm(&realm))
+            weak_realm_notifier.notify();
+    }
 }
 
 std::vector<std::shared_ptr<_impl::CollectionNotifier>> RealmCoordinator::notifiers_for_realm(Realm& realm)
@@ -882,18 +1881,25 @@ std::vector<std::shared_ptr<_impl::CollectionNotifier>> RealmCoordinator::notifi
     return ret;
 }
 
-bool RealmCoordinator::advance_to_latest(Realm& realm)
+bool RealmCoordinator::advance_to_latest(Realm& realm, TransactionChangeInfo* changes)
 {
     using sgf = SharedGroupFriend;
 
+    // Callbacks deferred by the delivery budget have to be called before
+    // advancing to keep them consistent with the Realm's version
+    deliver_pending_notifications(realm, false);
+    if (realm.is_closed())
+        return false;
+
     auto& sg = Realm::Internal::get_shared_group(realm);
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     _impl::NotifierPackage notifiers(m_async_error, notifiers_for_realm(realm), this);
     lock.unlock();
+    set_wait_deadline(notifiers);
     notifiers.package_and_wait(sgf::get_version_of_latest_snapshot(*sg));
 
     auto version = sg->get_version_of_current_transaction();
-    transaction::advance(sg, realm.m_binding_context.get(), notifiers);
+    transaction::advance(sg, realm.m_binding_context.get(), notifiers, changes);
 
     // Realm could be closed in the callbacks.
     if (realm.is_closed())
@@ -906,17 +1912,32 @@ void RealmCoordinator::promote_to_write(Realm& realm)
 {
     REALM_ASSERT(!realm.is_in_transaction());
 
+    deliver_pending_notifications(realm, false);
+    if (realm.is_closed())
+        return;
+
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     _impl::NotifierPackage notifiers(m_async_error, notifiers_for_realm(realm), this);
     lock.unlock();
+    set_wait_deadline(notifiers);
 
     auto& sg = Realm::Internal::get_shared_group(realm);
     transaction::begin(sg, realm.m_binding_context.get(), notifiers);
 }
 
+void RealmCoordinator::set_wait_deadline(_impl::NotifierPackage& notifiers)
+{
+    if (m_config.notifier_wait_limit.count() > 0)
+        notifiers.set_wait_deadline(std::chrono::steady_clock::now() + m_config.notifier_wait_limit);
+}
+
 void RealmCoordinator::process_available_async(Realm& realm)
 {
     REALM_ASSERT(!realm.is_in_transaction());
+    NotificationTraceSpan span(m_config.notification_trace, NotificationSpan::Phase::DeliverNotifications);
+
+    if (!deliver_pending_notifications(realm, true))
+        return;
 
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     auto notifiers = notifiers_for_realm(realm);
@@ -937,6 +1958,7 @@ void RealmCoordinator::process_available_async(Realm& realm)
     bool in_read = realm.is_in_read_transaction();
     auto& sg = Realm::Internal::get_shared_group(realm);
     auto version = sg->get_version_of_current_transaction();
+    span.set_version(version.version);
     auto package = [&](auto& notifier) {
         return !(notifier->has_run() && (!in_read || notifier->version() == version) && notifier->package_for_delivery());
     };
@@ -962,11 +1984,20 @@ void RealmCoordinator::process_available_async(Realm& realm)
     }
 
     // but still call the change callbacks
-    for (auto& notifier : notifiers)
+    auto deadline = std::chrono::steady_clock::now() + m_config.notification_delivery_budget;
+    bool use_budget = m_config.notification_delivery_budget.count() > 0;
+    for (auto& notifier : notifiers) {
+        if (use_budget && std::chrono::steady_clock::now() > deadline)
+            break;
+        NotificationTraceSpan callbacks_span(m_config.notification_trace, NotificationSpan::Phase::Callbacks,
+                                             *notifier, version.version);
         notifier->after_advance();
+    }
 
     if (realm.m_binding_context)
         realm.m_binding_context->did_send_notifications();
+    if (use_budget && !realm.is_closed())
+        wake_up_if_pending(realm);
 }
 
 void RealmCoordinator::set_transaction_callback(std::function<void(VersionID, VersionID)> fn)
@@ -974,10 +2005,3 @@ void RealmCoordinator::set_transaction_callback(std::function<void(VersionID, Ve
     create_sync_session(false);
     m_transaction_callback = std::move(fn);
 }
-
-#if REALM_ENABLE_SYNC
-partial_sync::WorkQueue& RealmCoordinator::partial_sync_work_queue()
-{
-    return *m_partial_sync_work_queue;
-}
-#endif
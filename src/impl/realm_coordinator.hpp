@@ -19,12 +19,23 @@
 #ifndef REALM_COORDINATOR_HPP
 #define REALM_COORDINATOR_HPP
 
+#include "impl/collection_notifier.hpp"
+#include "impl/table_change_info_notifier.hpp"
+#include "impl/transact_log_handler.hpp"
 #include "shared_realm.hpp"
+#include "util/metrics.hpp"
 
 #include <realm/version_id.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace realm {
 class Replication;
@@ -33,15 +44,18 @@ class SharedGroup;
 class StringData;
 class SyncSession;
 
+namespace util {
+class ThreadPool;
+}
+
 namespace _impl {
 class CollectionNotifier;
+class ChangeJournal;
 class ExternalCommitHelper;
+class LocalCommitHelper;
+class ResultsNotifier;
 class WeakRealmNotifier;
 
-namespace partial_sync {
-class WorkQueue;
-}
-
 // RealmCoordinator manages the weak cache of Realm instances and communication
 // between per-thread Realm instances for a given file
 class RealmCoordinator : public std::enable_shared_from_this<RealmCoordinator> {
@@ -60,31 +74,69 @@ public:
     std::shared_ptr<Realm> get_realm();
     void get_realm(Realm::Config config, std::function<void(std::shared_ptr<Realm>, std::exception_ptr)> callback);
 
-    Realm::Config get_config() const { return m_config; }
+    // Get the frozen Realm for the given version, opening it if there isn't
+    // already one open. All frozen Results, Objects and Lists at a version
+    // share that version's frozen Realm and its read transaction, which is
+    // released once the last of them is destroyed. The version must be pinned
+    // (e.g. by a read transaction at that version) for the duration of the call.
+    std::shared_ptr<Realm> get_frozen_realm(VersionID version);
+
+    // The config is only replaced while no Realm is open for this
+    // coordinator, so callers which only need a few fields should read them
+    // through the reference rather than copying the whole config, which
+    // includes the schema and the migration functions.
+    Realm::Config const& get_config() const noexcept { return m_config; }
 
     uint64_t get_schema_version() const noexcept { return m_schema_version; }
     const std::string& get_path() const noexcept { return m_config.path; }
     const std::vector<char>& get_encryption_key() const noexcept { return m_config.encryption_key; }
     bool is_in_memory() const noexcept { return m_config.in_memory; }
+    NotificationTraceFunction const& notification_trace() const noexcept { return m_config.notification_trace; }
 
     // To avoid having to re-read and validate the file's schema every time a
     // new read transaction is begun, RealmCoordinator maintains a cache of the
     // most recently seen file schema and the range of transaction versions
     // which it applies to. Note that this schema may not be identical to that
     // of any Realm instances managed by this coordinator, as individual Realms
-    // may only be using a subset of it.
+    // may only be using a subset of it. The cached schema is immutable, and
+    // Realms take their own copy of it as they update their schema's table
+    // columns in place.
+    //
+    // The schemas for a few earlier ranges of transaction versions are kept as
+    // well, so that Realms which are pinned at older versions around a schema
+    // change don't have to re-read the schema either. The least recently used
+    // ones are discarded once there are more than MaxCachedSchemas.
+    static constexpr size_t MaxCachedSchemas = 4;
 
     // Get the latest cached schema and the transaction version which it applies
     // to. Returns false if there is no cached schema.
+    bool get_cached_schema(std::shared_ptr<const Schema>& schema, uint64_t& schema_version,
+                           uint64_t& transaction) const noexcept;
     bool get_cached_schema(Schema& schema, uint64_t& schema_version, uint64_t& transaction) const noexcept;
+    // Get the cached schema which applies to the given transaction version.
+    // Returns false if there isn't one.
+    bool get_cached_schema(uint64_t transaction, std::shared_ptr<const Schema>& schema,
+                           uint64_t& schema_version) noexcept;
 
     // Cache the state of the schema at the given transaction version
+    void cache_schema(std::shared_ptr<const Schema> new_schema, uint64_t new_schema_version,
+                      uint64_t transaction_version);
     void cache_schema(Schema const& new_schema, uint64_t new_schema_version,
                       uint64_t transaction_version);
     // If there is a schema cached for transaction version `previous`, report
     // that it is still valid at transaction version `next`
     void advance_schema_cache(uint64_t previous, uint64_t next);
     void clear_schema_cache_and_set_schema_version(uint64_t new_schema_version);
+    // Discard the change journal's record of the commits to a file which has
+    // been deleted and recreated at the same path
+    void reset_change_journal();
+
+    // Get the tables related to `table` as computed by
+    // DeepChangeChecker::find_related_tables(). This only depends on the
+    // schema, so it is cached along with it for accessors at transaction
+    // versions which the cached schema applies to.
+    std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>>
+    get_related_tables(Table const& table, uint64_t transaction_version);
 
 
     // Asynchronously call notify() on every Realm instance for this coordinator's
@@ -116,6 +168,28 @@ public:
 
     static void register_notifier(std::shared_ptr<CollectionNotifier> notifier);
 
+    // Call `callback` on a notifier thread with the insertions, deletions and
+    // modifications (including which columns were modified) to the tables
+    // with the given indices which the notifiers calculated, each time they
+    // advance over commits which changed any of them, starting from the
+    // version `realm` is currently at. The change sets are the notifiers'
+    // own rather than copies, so the callback must be quick and must not
+    // throw. A notifier pass covers every commit made since the previous
+    // one, so several commits may be reported together. Stops once the
+    // returned token is destroyed, and keeps `realm` open until then.
+    static NotificationToken observe_table_changes(std::shared_ptr<Realm> const& realm,
+                                                   std::vector<size_t> table_indices,
+                                                   TableChangeInfoNotifier::Callback callback);
+    // Called by a notifier when it is unregistered, so that the next cleanup
+    // pass knows how many dead notifiers there are to look for
+    void notifier_unregistered() noexcept { ++m_dead_notifier_count; }
+
+    // Find a live notifier for the given Realm instance whose Results have
+    // the given sharing key, so that a new Results with an identical query and
+    // ordering can share it rather than registering a new notifier.
+    // Returns null if there isn't one.
+    static std::shared_ptr<ResultsNotifier> find_shared_results_notifier(Realm& realm, std::string const& key);
+
     // Advance the Realm to the most recent transaction version which all async
     // work is complete for
     void advance_to_ready(Realm& realm);
@@ -123,7 +197,7 @@ public:
     // Advance the Realm to the most recent transaction version, blocking if
     // async notifiers are not yet ready for that version
     // returns whether it actually changed the version
-    bool advance_to_latest(Realm& realm);
+    bool advance_to_latest(Realm& realm, TransactionChangeInfo* changes = nullptr);
 
     // Deliver any notifications which are ready for the Realm's version
     void process_available_async(Realm& realm);
@@ -136,69 +210,351 @@ public:
     void promote_to_write(Realm& realm);
 
     // Commit a Realm's current write transaction and send notifications to all
-    // other Realm instances for that path, including in other processes
-    void commit_write(Realm& realm);
-
+    // other Realm instances for that path, including in other processes. If
+    // `bulk_load` is set, the changes made by the commit are not calculated
+    // for this process's notifiers.
+    void commit_write(Realm& realm, bool bulk_load=false);
+
+    // Wait until `wait_predicate` returns true, waking up the notifier worker
+    // if it doesn't initially, or until `deadline` if one is given. Returns
+    // the notifier lock, still held.
     template<typename Pred>
-    std::unique_lock<std::mutex> wait_for_notifiers(Pred&& wait_predicate);
-
-#if REALM_ENABLE_SYNC
-    // A work queue that can be used to perform background work related to partial sync.
-    partial_sync::WorkQueue& partial_sync_work_queue();
-#endif
+    std::unique_lock<std::mutex> wait_for_notifiers(Pred&& wait_predicate,
+                                                    util::Optional<std::chrono::steady_clock::time_point> deadline = util::none);
+
+    // Run or hand over a single notifier, reporting it to the notification trace
+    void run_notifier(_impl::CollectionNotifier& notifier, VersionID version);
+    void prepare_handover(_impl::CollectionNotifier& notifier);
+
+    struct AsyncWrite {
+        // The configuration used to open the Realm the write is performed on
+        Realm::Config config;
+        std::function<void(Realm&)> write;
+        // Called on the async write thread once the write has been committed
+        // or has failed
+        std::function<void(std::exception_ptr)> done;
+        // Can this write be committed in the same transaction as other
+        // groupable writes which are waiting at the same time?
+        bool groupable;
+    };
+    // Perform the write on a background thread used for asynchronous writes to
+    // this coordinator's file. Writes are performed in the order in which they
+    // were posted, and the thread only exists while there are writes waiting.
+    void post_async_write(AsyncWrite write);
+
+    // Read through the data and search indexes of the tables for the given
+    // object types so that they're paged in, unless this file's tables have
+    // already been warmed up. async_open() calls this on its background
+    // thread, and the first other open of a file which lists
+    // Config::warm_up_object_types calls it on a thread owned by the
+    // coordinator, which clear_cache() stops and the destructor joins.
+    void warm_up_tables(Realm& realm, std::vector<std::string> const& object_types);
+
+    // Wait for the warm-up thread started by an open of this file, if any,
+    // and return whether it read through all of the tables
+    bool wait_for_warm_up();
 
     AuditInterface* audit_context() const noexcept { return m_audit_context.get(); }
 
+    // A read transaction held by this coordinator, which keeps the version it
+    // is at and every version after it from being cleaned up
+    struct PinnedVersion {
+        enum class Holder {
+            // The SharedGroups which the async notifiers run on
+            Notifiers,
+            // The SharedGroup holding the versions which new notifiers were
+            // registered at until the notifier thread first runs them
+            NewNotifiers,
+            // A frozen Realm returned by get_frozen_realm()
+            FrozenRealm,
+        };
+        Holder holder;
+        VersionID version;
+    };
+    // Get the versions currently pinned by this coordinator, oldest first.
+    // Versions pinned by the read transactions of Realm instances and by
+    // ThreadSafeReferences aren't included, but are still counted by
+    // Realm::get_number_of_versions().
+    std::vector<PinnedVersion> get_pinned_versions();
+
+    // Call `callback` on the notifier thread whenever a run of the async
+    // notifiers finds more than `max_versions` versions of the file being kept
+    // alive, which usually means that a read transaction somewhere is being
+    // held for far too long. It is passed the number of versions and the
+    // coordinator's own pins. Only checked while there are notifiers.
+    using PinnedVersionAlarm = std::function<void(uint64_t live_versions, std::vector<PinnedVersion> const& pins)>;
+    void set_pinned_version_alarm(uint64_t max_versions, PinnedVersionAlarm callback);
+
+    // Estimates of the memory used by the object store for this file, in
+    // bytes. Memory used by core for the file's data isn't included.
+    struct MemoryStats {
+        struct RealmStats {
+            Realm* realm;
+            size_t notifiers;
+            // The total of the notifiers' retained, handover and change bytes
+            size_t notifier_bytes;
+        };
+        std::vector<CollectionNotifier::MemoryStats> notifiers;
+        // The Realms which have notifiers, in no particular order
+        std::vector<RealmStats> realms;
+        size_t open_realms;
+        size_t cached_realms;
+        size_t cached_schemas;
+        size_t cached_schema_bytes;
+    };
+    MemoryStats memory_stats();
+
+    // Counts of the work done for this file since the coordinator was
+    // created, for monitoring. Each is updated with a relaxed atomic
+    // increment where the work happens, so reading them is cheap but
+    // values from different fields may be very slightly out of step.
+    struct Metrics {
+        uint64_t commits;
+        // Runs of the async notifiers which had notifiers to run, and the
+        // runs of individual notifiers within them
+        uint64_t notifier_passes;
+        uint64_t notifier_runs;
+        util::HistogramSnapshot notifier_run_microseconds;
+        // The number of rows inserted, deleted or modified in the tables
+        // observed by the notifiers in each pass
+        util::HistogramSnapshot changed_rows;
+        uint64_t handovers;
+        uint64_t thread_safe_reference_imports;
+        uint64_t schema_cache_hits;
+        uint64_t schema_cache_misses;
+
+        // Write the metrics with a label for the path of the file they're for
+        void write_prometheus(util::PrometheusWriter& writer, std::string const& path) const;
+    };
+    Metrics metrics() const;
+
+    // Record that a ThreadSafeReference was resolved in a Realm for this file
+    void did_import_thread_safe_reference() noexcept { m_metrics.thread_safe_reference_imports.add(); }
+
+    enum class MemoryPressure {
+        // Release what can be recreated cheaply: cached schemas other than
+        // the latest, notifier results which nothing is waiting for, and the
+        // helper SharedGroup used for new notifiers if there aren't any
+        Moderate,
+        // Also release the latest cached schema and the results of every
+        // notifier, at the cost of rerunning queries on the target threads
+        Critical,
+    };
+    // Release memory used by caches and idle notifier data, for calling when
+    // the app is warned that memory is low. Everything released is recreated
+    // when it's next needed.
+    void on_memory_pressure(MemoryPressure level);
+
 private:
     Realm::Config m_config;
+    // The path this coordinator is registered under in the global coordinator
+    // map, which is set before m_config is
+    std::string m_registered_path;
 
     mutable std::mutex m_schema_cache_mutex;
-    util::Optional<Schema> m_cached_schema;
+    struct CachedSchema {
+        std::shared_ptr<const Schema> schema;
+        uint64_t schema_version;
+        uint64_t transaction_version_min;
+        uint64_t transaction_version_max;
+        // The value of m_schema_cache_clock when this was last looked up
+        uint64_t last_used;
+        // Indexed by table index; discarded along with the schema
+        std::unordered_map<size_t, std::shared_ptr<const std::vector<DeepChangeChecker::RelatedTable>>> related_tables;
+    };
+    // Sorted by transaction version, with the latest schema at the back
+    std::vector<CachedSchema> m_cached_schemas;
+    uint64_t m_schema_cache_clock = 0;
     uint64_t m_schema_version = -1;
-    uint64_t m_schema_transaction_version_min = 0;
-    uint64_t m_schema_transaction_version_max = 0;
+
+    CachedSchema* find_cached_schema(uint64_t transaction) noexcept;
 
     std::mutex m_realm_mutex;
     std::vector<WeakRealmNotifier> m_weak_realm_notifiers;
+    // The cached Realm for each execution context, so that get_cached_realm()
+    // doesn't need to scan all of the open Realms
+    struct CachedRealm {
+        std::weak_ptr<Realm> realm;
+        Realm* key;
+    };
+    std::unordered_map<AnyExecutionContextID, CachedRealm> m_cached_realms;
+    // m_weak_realm_notifiers is swept for expired entries when it grows past
+    // this size rather than on every unregistration
+    size_t m_weak_realm_notifier_prune_size = 8;
 
     std::mutex m_notifier_mutex;
     std::condition_variable m_notifier_cv;
     std::vector<std::shared_ptr<_impl::CollectionNotifier>> m_new_notifiers;
     std::vector<std::shared_ptr<_impl::CollectionNotifier>> m_notifiers;
     VersionID m_notifier_skip_version = {0, 0};
-
+    // The version which the notifiers in m_notifiers were last advanced to
+    VersionID m_notifier_version;
+    uint64_t m_pinned_version_alarm_threshold = 0;
+    PinnedVersionAlarm m_pinned_version_alarm;
+    // The number of notifiers which have been unregistered but not yet
+    // removed by clean_up_dead_notifiers()
+    std::atomic<size_t> m_dead_notifier_count{0};
     // SharedGroup used for actually running async notifiers
     // Will have a read transaction iff m_notifiers is non-empty
     std::unique_ptr<Replication> m_notifier_history;
     std::unique_ptr<SharedGroup> m_notifier_sg;
+    // The change info calculated for each notifier pass on m_notifier_sg,
+    // kept so that the next pass can reuse its storage
+    std::vector<TransactionChangeInfo> m_notifier_change_info;
+
+    // Additional SharedGroups used to run notifiers in parallel with the ones
+    // attached to m_notifier_sg when Config::notifier_thread_count is greater
+    // than one. Each notifier is attached to exactly one of these or to
+    // m_notifier_sg, and all of them have a read transaction iff m_notifiers
+    // is non-empty.
+    struct NotifierWorker {
+        std::unique_ptr<Replication> history;
+        std::unique_ptr<SharedGroup> sg;
+        std::vector<TransactionChangeInfo> change_info;
+    };
+    std::vector<NotifierWorker> m_notifier_workers;
+    std::unique_ptr<util::ThreadPool> m_notifier_thread_pool;
 
     // SharedGroup used to advance notifiers in m_new_notifiers to the main shared
     // group's transaction version
     // Will have a read transaction iff m_new_notifiers is non-empty
     std::unique_ptr<Replication> m_advancer_history;
     std::unique_ptr<SharedGroup> m_advancer_sg;
+    std::vector<TransactionChangeInfo> m_advancer_change_info;
+
+    // The rows of recently discarded ResultsNotifiers, keyed by sharing key
+    // and the version they were calculated at, so that a new notifier for the
+    // same query registered at that version (e.g. when a screen is closed
+    // and reopened) can start from them rather than running its query from
+    // scratch. Most recent last, and guarded by m_notifier_mutex.
+    struct WarmResults {
+        std::string sharing_key;
+        VersionID version;
+        std::vector<size_t> rows;
+    };
+    std::vector<WarmResults> m_warm_results;
+    static constexpr size_t MaxWarmResults = 4;
     std::exception_ptr m_async_error;
 
+    // Summaries of the commits made by all processes, used by
+    // m_changeset_cache when Config::use_change_journal is set
+    std::unique_ptr<_impl::ChangeJournal> m_change_journal;
+
+    // Changes calculated by whichever of the above SharedGroups first advances
+    // over a version range, for reuse by the others
+    _impl::transaction::ChangesetCache m_changeset_cache;
+
+    // Writes waiting to be performed by the async write thread, which is
+    // running iff m_async_writer_running is set
+    std::mutex m_async_write_mutex;
+    std::deque<AsyncWrite> m_async_writes;
+    bool m_async_writer_running = false;
+
+    // Set once warm_up_tables() has been called or started for this file
+    std::atomic<bool> m_tables_warmed_up{false};
+    // The thread started by start_warm_up(). It holds only a weak reference
+    // to the coordinator until it starts, and then a strong one until it's
+    // done, so the destructor may run on it.
+    std::mutex m_warm_up_mutex;
+    std::thread m_warm_up_thread;
+    std::atomic<bool> m_warm_up_cancelled{false};
+    std::atomic<bool> m_warm_up_completed{false};
+
+    void start_warm_up(Realm::Config const& config);
+    void do_warm_up_tables(Realm& realm, std::vector<std::string> const& object_types);
+
+    // When the async notifiers were last run. Only used by on_change() to
+    // apply Config::notifier_interval.
+    std::chrono::steady_clock::time_point m_last_notifier_run;
+    // Guards the wait for the rest of the interval, which is cut short by
+    // cancel_notifier_interval() when the commit helpers are torn down so
+    // that closing the file doesn't block on it
+    std::mutex m_notifier_interval_mutex;
+    std::condition_variable m_notifier_interval_cv;
+    bool m_notifier_interval_cancelled = false;
+
+    void cancel_notifier_interval();
+
+    // The number of notifiers run and the longest time taken by one, since
+    // the start of the current on_change(). Only updated if there's a
+    // BindingCallbackThreadObserver to report them to.
+    std::atomic<size_t> m_notifiers_run{0};
+    std::atomic<std::chrono::nanoseconds::rep> m_longest_notifier_run{0};
+
+    // The live counters behind metrics()
+    struct MetricCounters {
+        util::MetricCounter commits;
+        util::MetricCounter notifier_passes;
+        util::MetricCounter notifier_runs;
+        util::MetricHistogram notifier_run_microseconds;
+        util::MetricHistogram changed_rows;
+        util::MetricCounter handovers;
+        util::MetricCounter thread_safe_reference_imports;
+        util::MetricCounter schema_cache_hits;
+        util::MetricCounter schema_cache_misses;
+    };
+    // Mutable so that the const schema cache lookups can count hits
+    mutable MetricCounters m_metrics;
+
     std::unique_ptr<_impl::ExternalCommitHelper> m_notifier;
+    // Used instead of m_notifier when Config::single_process is set
+    std::unique_ptr<_impl::LocalCommitHelper> m_local_notifier;
+    // Set when wake_up_notifier_worker() has signalled the worker and cleared
+    // when the worker starts its next pass, so that a burst of new notifiers
+    // or callbacks results in a single wakeup rather than one per notifier
+    std::atomic<bool> m_notifier_wakeup_pending{false};
     std::function<void(VersionID, VersionID)> m_transaction_callback;
 
 #if REALM_ENABLE_SYNC
     std::shared_ptr<SyncSession> m_sync_session;
-    std::unique_ptr<partial_sync::WorkQueue> m_partial_sync_work_queue;
 #endif
 
     std::shared_ptr<AuditInterface> m_audit_context;
 
+    std::mutex m_frozen_realm_mutex;
+    std::map<VersionID, std::weak_ptr<Realm>> m_frozen_realms;
+
     // must be called with m_notifier_mutex locked
     void pin_version(VersionID version);
 
     void set_config(const Realm::Config&);
+    // Apply Config::notifier_wait_limit to a package about to be waited on
+    void set_wait_deadline(_impl::NotifierPackage& notifiers);
+    // Wake up the listeners for commit notifications, in all processes
+    // unless Config::single_process is set
+    void notify_others();
+    // Perform a batch of async writes in a single transaction on `realm`,
+    // opening it first if needed
+    void perform_async_writes(std::shared_ptr<Realm>& realm, std::vector<AsyncWrite>& writes);
     void create_sync_session(bool force_client_reset);
     void do_get_realm(Realm::Config config, std::shared_ptr<Realm>& realm,
                       std::unique_lock<std::mutex>& realm_lock);
     std::shared_ptr<Realm> get_cached_realm(Realm::Config const& config);
 
     void run_async_notifiers();
+    // Add the number of rows changed in the observed tables to m_metrics
+    void record_changed_rows(TransactionChangeInfo const& info);
+    // Keep the rows of a discarded notifier for reuse, or give a new notifier
+    // the rows of a matching discarded one. m_notifier_mutex must be held.
+    void retain_warm_results(CollectionNotifier& notifier);
+    void adopt_warm_results(CollectionNotifier& notifier);
+    void run_notifiers_on(SharedGroup& sg,
+                          std::vector<std::shared_ptr<_impl::CollectionNotifier>>& notifiers,
+                          std::vector<std::shared_ptr<_impl::CollectionNotifier>>& new_notifiers,
+                          VersionID skip_version, VersionID version,
+                          std::vector<std::shared_ptr<_impl::CollectionNotifier>>& deferred,
+                          std::vector<TransactionChangeInfo>& change_info_storage);
+    void notify_realms();
+
+    // Support for Config::notification_delivery_budget: notifiers for the
+    // Realm which have been packaged but whose callbacks haven't been called
+    std::vector<std::shared_ptr<_impl::CollectionNotifier>> pending_notifiers_for_realm(Realm& realm);
+    // Call the callbacks left over from a previous delivery, stopping early if
+    // `use_budget` is true and the budget runs out. Returns false if the
+    // caller should not go on to deliver anything newer.
+    bool deliver_pending_notifications(Realm& realm, bool use_budget);
+    void wake_up_if_pending(Realm& realm);
+    void wake_up_realm(Realm& realm);
     void open_helper_shared_group();
     void advance_helper_shared_group_to_latest();
     void clean_up_dead_notifiers();
@@ -208,11 +564,12 @@ private:
 
 
 template<typename Pred>
-std::unique_lock<std::mutex> RealmCoordinator::wait_for_notifiers(Pred&& wait_predicate)
+std::unique_lock<std::mutex> RealmCoordinator::wait_for_notifiers(Pred&& wait_predicate,
+                                                                  util::Optional<std::chrono::steady_clock::time_point> deadline)
 {
     std::unique_lock<std::mutex> lock(m_notifier_mutex);
     bool first = true;
-    m_notifier_cv.wait(lock, [&] {
+    auto predicate = [&] {
         if (wait_predicate())
             return true;
         if (first) {
@@ -220,7 +577,11 @@ std::unique_lock<std::mutex> RealmCoordinator::wait_for_notifiers(Pred&& wait_pr
             first = false;
         }
         return false;
-    });
+    };
+    if (deadline)
+        m_notifier_cv.wait_until(lock, *deadline, predicate);
+    else
+        m_notifier_cv.wait(lock, predicate);
     return lock;
 }
 
@@ -20,12 +20,249 @@
 
 #include "shared_realm.hpp"
 
+#include <realm/util/format.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+
 using namespace realm;
 using namespace realm::_impl;
 
-ResultsNotifier::ResultsNotifier(Results& target)
+namespace {
+using AggregateKind = Results::AggregateKind;
+
+class CountObserver : public AggregateObserver {
+public:
+    CountObserver() : AggregateObserver(npos, AggregateKind::Count) { }
+
+    void reset(Table const&, std::vector<size_t> const& rows) override
+    {
+        m_count = rows.size();
+        m_initialized = true;
+    }
+
+    void update(Table const&, std::vector<size_t> const& rows, CollectionChangeBuilder const&) override
+    {
+        m_count = rows.size();
+    }
+
+    bool only_needs_count() const noexcept override { return true; }
+    void update_count(size_t count) override
+    {
+        m_count = count;
+        m_initialized = true;
+    }
+
+private:
+    size_t m_count = 0;
+
+    util::Optional<Mixed> value() const override { return Mixed(int64_t(m_count)); }
+};
+
+template<typename T>
+bool is_finite(T const&) { return true; }
+bool is_finite(float value) { return std::isfinite(value); }
+bool is_finite(double value) { return std::isfinite(value); }
+
+template<typename T>
+bool is_nan(T const&) { return false; }
+bool is_nan(float value) { return std::isnan(value); }
+bool is_nan(double value) { return std::isnan(value); }
+
+// Sums of ints are ints and sums of floats are doubles, matching Results::sum().
+// Timestamps can't be summed but still need a type for the unused sum.
+template<typename T> struct SumType { using type = double; };
+template<> struct SumType<int64_t> { using type = int64_t; };
+template<> struct SumType<Timestamp> { using type = int64_t; };
+
+template<typename Sum, typename T>
+void add_to_sum(Sum& sum, T value, int sign) { sum += sign > 0 ? Sum(value) : -Sum(value); }
+template<typename Sum>
+void add_to_sum(Sum&, Timestamp, int) { }
+
+template<typename T>
+class TypedAggregateObserver : public AggregateObserver {
+public:
+    TypedAggregateObserver(size_t column, AggregateKind kind)
+    : AggregateObserver(column, kind)
+    {
+    }
+
+    void reset(Table const& table, std::vector<size_t> const& rows) override
+    {
+        m_values.clear();
+        m_values.reserve(rows.size());
+        for (auto row : rows)
+            m_values.push_back(read(table, row));
+        recalculate();
+        m_initialized = true;
+    }
+
+    void update(Table const& table, std::vector<size_t> const& rows, CollectionChangeBuilder const& changes) override
+    {
+        REALM_ASSERT_DEBUG(m_initialized);
+        if (changes.insertions.empty() && changes.deletions.empty()) {
+            // Only modifications, so the cached values can be updated in place
+            for (auto i : changes.modifications.as_indexes()) {
+                remove(m_values[i]);
+                m_values[i] = read(table, rows[i]);
+                add(m_values[i]);
+            }
+        }
+        else {
+            // The rows which weren't deleted are in the same order as the ones
+            // which weren't inserted, so walk them in parallel to build the
+            // cached values for the new rows
+            std::vector<util::Optional<T>> values;
+            values.reserve(rows.size());
+
+            auto deletions = changes.deletions.as_indexes();
+            auto insertions = changes.insertions.as_indexes();
+            auto modifications = changes.modifications.as_indexes();
+            auto deleted = deletions.begin(), inserted = insertions.begin(), modified = modifications.begin();
+            size_t old_ndx = 0;
+            for (size_t i = 0; i < rows.size(); ++i) {
+                bool is_insertion = inserted != insertions.end() && *inserted == i;
+                if (is_insertion)
+                    ++inserted;
+                bool is_modification = modified != modifications.end() && *modified == i;
+                if (is_modification)
+                    ++modified;
+
+                if (is_insertion) {
+                    values.push_back(read(table, rows[i]));
+                    add(values.back());
+                    continue;
+                }
+
+                for (; deleted != deletions.end() && *deleted == old_ndx; ++deleted, ++old_ndx)
+                    remove(m_values[old_ndx]);
+                REALM_ASSERT_DEBUG(old_ndx < m_values.size());
+                values.push_back(std::move(m_values[old_ndx++]));
+                if (is_modification) {
+                    remove(values.back());
+                    values.back() = read(table, rows[i]);
+                    add(values.back());
+                }
+            }
+            for (; old_ndx < m_values.size(); ++old_ndx)
+                remove(m_values[old_ndx]);
+            m_values = std::move(values);
+        }
+
+        if (m_needs_recalculation)
+            recalculate();
+    }
+
+private:
+    // The value of the column for each row in the results
+    std::vector<util::Optional<T>> m_values;
+
+    typename SumType<T>::type m_sum = 0;
+    size_t m_non_null_count = 0;
+    util::Optional<T> m_min;
+    util::Optional<T> m_max;
+    // Set when a value was removed which can't be subtracted from the running
+    // values, i.e. the current min or max or a non-finite floating point value
+    bool m_needs_recalculation = false;
+
+    util::Optional<T> read(Table const& table, size_t row) const
+    {
+        if (table.is_null(m_column, row))
+            return util::none;
+        return table.get<T>(m_column, row);
+    }
+
+    void add(util::Optional<T> const& value)
+    {
+        if (!value)
+            return;
+        ++m_non_null_count;
+        add_to_sum(m_sum, *value, 1);
+        if (is_nan(*value))
+            return;
+        if (!m_min || *value < *m_min)
+            m_min = value;
+        if (!m_max || *m_max < *value)
+            m_max = value;
+    }
+
+    void remove(util::Optional<T> const& value)
+    {
+        if (!value)
+            return;
+        --m_non_null_count;
+        add_to_sum(m_sum, *value, -1);
+        if (!is_finite(*value))
+            m_needs_recalculation = true;
+        else if ((m_min && !(*m_min < *value)) || (m_max && !(*value < *m_max)))
+            m_needs_recalculation = true;
+    }
+
+    void recalculate()
+    {
+        m_sum = 0;
+        m_non_null_count = 0;
+        m_min = util::none;
+        m_max = util::none;
+        m_needs_recalculation = false;
+        for (auto const& value : m_values)
+            add(value);
+    }
+
+    util::Optional<Mixed> value() const override
+    {
+        switch (m_kind) {
+            case AggregateKind::Min:
+                if (!m_min)
+                    return util::none;
+                return Mixed(*m_min);
+            case AggregateKind::Max:
+                if (!m_max)
+                    return util::none;
+                return Mixed(*m_max);
+            case AggregateKind::Sum:
+                return Mixed(m_sum);
+            case AggregateKind::Average:
+                if (m_non_null_count == 0)
+                    return util::none;
+                return Mixed(double(m_sum) / m_non_null_count);
+            case AggregateKind::Count:
+                break;
+        }
+        REALM_COMPILER_HINT_UNREACHABLE();
+    }
+};
+} // anonymous namespace
+
+std::shared_ptr<AggregateObserver> AggregateObserver::make(size_t column, AggregateKind kind, DataType type)
+{
+    if (kind == AggregateKind::Count)
+        return std::make_shared<CountObserver>();
+    switch (type) {
+        case type_Int:       return std::make_shared<TypedAggregateObserver<int64_t>>(column, kind);
+        case type_Float:     return std::make_shared<TypedAggregateObserver<float>>(column, kind);
+        case type_Double:    return std::make_shared<TypedAggregateObserver<double>>(column, kind);
+        case type_Timestamp: return std::make_shared<TypedAggregateObserver<Timestamp>>(column, kind);
+        default: REALM_UNREACHABLE();
+    }
+}
+
+bool AggregateObserver::prepare_to_deliver(VersionID version)
+{
+    if (!m_has_handover)
+        return false;
+    m_to_deliver = m_handover;
+    m_delivered_version = version;
+    return true;
+}
+
+ResultsNotifier::ResultsNotifier(Results& target, std::string sharing_key)
 : CollectionNotifier(target.get_realm())
-, m_target_results(&target)
+, m_target_results{&target}
+, m_sharing_key(std::move(sharing_key))
 , m_target_is_in_table_order(target.is_in_table_order())
 {
     Query q = target.get_query();
@@ -34,17 +271,110 @@ ResultsNotifier::ResultsNotifier(Results& target)
     DescriptorOrdering::generate_patch(target.get_descriptor_ordering(), m_ordering_handover);
 }
 
+ResultsNotifier::ResultsNotifier(Results const& source, Window window)
+: CollectionNotifier(source.get_realm())
+, m_target_is_in_table_order(source.is_in_table_order())
+, m_is_window(true)
+, m_window(window)
+{
+    Query q = source.get_query();
+    set_table(*q.get_table());
+    m_query_handover = source_shared_group().export_for_handover(q, MutableSourcePayload::Move);
+    DescriptorOrdering::generate_patch(source.get_descriptor_ordering(), m_ordering_handover);
+}
+
+void ResultsNotifier::set_window(size_t offset, size_t count)
+{
+    REALM_ASSERT(m_is_window);
+    {
+        auto lock = lock_target();
+        m_window.offset = offset;
+        m_window.count = count;
+        m_window_moved = true;
+    }
+    request_run();
+}
+
 void ResultsNotifier::target_results_moved(Results& old_target, Results& new_target)
 {
     auto lock = lock_target();
 
-    REALM_ASSERT(m_target_results == &old_target);
-    m_target_results = &new_target;
+    auto it = std::find(m_target_results.begin(), m_target_results.end(), &old_target);
+    REALM_ASSERT(it != m_target_results.end());
+    *it = &new_target;
+}
+
+std::string ResultsNotifier::sharing_key_for(Query const& query, DescriptorOrdering const& ordering)
+{
+    auto table = query.get_table();
+    if (!table || !table->is_group_level())
+        return {};
+
+    try {
+        // get_description() throws for queries which can't be serialized,
+        // which includes queries restricted to a LinkView or TableView
+        auto key = util::format("%1:%2", table->get_index_in_group(), query.get_description());
+        if (!ordering.is_empty())
+            key += " " + ordering.get_description(table);
+        return key;
+    }
+    catch (std::exception const&) {
+        return {};
+    }
+}
+
+void ResultsNotifier::add_target(Results& target)
+{
+    auto lock = lock_target();
+    REALM_ASSERT(std::find(m_target_results.begin(), m_target_results.end(), &target) == m_target_results.end());
+    m_target_results.push_back(&target);
+}
+
+bool ResultsNotifier::remove_target(Results& target)
+{
+    auto lock = lock_target();
+    auto it = std::find(m_target_results.begin(), m_target_results.end(), &target);
+    REALM_ASSERT(it != m_target_results.end());
+    m_target_results.erase(it);
+    return m_target_results.empty();
+}
+
+std::shared_ptr<AggregateObserver> ResultsNotifier::add_aggregate(size_t column, Results::AggregateKind kind,
+                                                                  DataType type)
+{
+    auto observer = AggregateObserver::make(column, kind, type);
+    auto lock = lock_target();
+    m_aggregates.push_back(observer);
+    return observer;
+}
+
+std::shared_ptr<AggregateObserver> ResultsNotifier::get_delivered_aggregate(size_t column, Results::AggregateKind kind,
+                                                                            VersionID version)
+{
+    auto lock = lock_target();
+    for (auto& weak : m_aggregates) {
+        auto aggregate = weak.lock();
+        if (!aggregate || aggregate->kind() != kind || aggregate->delivered_version() != version)
+            continue;
+        if (kind == Results::AggregateKind::Count || aggregate->column() == column)
+            return aggregate;
+    }
+    return nullptr;
+}
+
+void ResultsNotifier::update_aggregates(std::vector<size_t> const& rows)
+{
+    auto& table = *m_query->get_table();
+    for (auto& aggregate : m_active_aggregates) {
+        if (aggregate->is_initialized())
+            aggregate->update(table, rows, m_changes);
+    }
 }
 
 void ResultsNotifier::release_data() noexcept
 {
     m_query = nullptr;
+    m_sort_keys = util::none;
 }
 
 // Most of the inter-thread synchronization for run(), prepare_handover(),
@@ -56,8 +386,8 @@ void ResultsNotifier::release_data() noexcept
 // add_required_change_info(), attach_to(), detach(), run(),
 // prepare_handover(), and release_data() are all only ever called on a single
 // background worker thread. call_callbacks() and deliver() are called on the
-// target thread. Calls to prepare_handover() and deliver() are guarded by a
-// lock.
+// target thread. Calls to prepare_handover() and prepare_to_deliver() are
+// guarded by the notifier's handover lock.
 //
 // In total, this means that the safe data flow is as follows:
 //  - add_Required_change_info(), prepare_handover(), attach_to(), detach() and
@@ -85,9 +415,14 @@ bool ResultsNotifier::do_add_required_change_info(TransactionChangeInfo& info)
         info.lists.push_back({parent.get_index_in_group(), row_ndx, col_ndx, &m_changes});
     }
     else { // is a top-level table
-        if (info.table_moves_needed.size() <= table_ndx)
-            info.table_moves_needed.resize(table_ndx + 1);
-        info.table_moves_needed[table_ndx] = true;
+        info.table_moves_needed.set(table_ndx);
+
+        // Need to know which columns were modified even if we don't have any
+        // callbacks to be able to skip rerunning the query
+        if ((has_run() || m_rows_adopted) && !m_used_columns.empty())
+            info.table_modifications_needed.set(table_ndx);
+        if (m_sort_keys)
+            m_sort_keys->add_required_change_info(info);
     }
 
     return has_run() && have_callbacks();
@@ -101,54 +436,465 @@ bool ResultsNotifier::need_to_run()
     {
         auto lock = lock_target();
         // Don't run the query if the results aren't actually going to be used
-        if (!get_realm() || (!have_callbacks() && !m_target_results->wants_background_updates())) {
+        if (!get_realm())
+            return false;
+        auto wants_updates = [](Results* results) { return results->wants_background_updates(); };
+        if (!have_callbacks() && std::none_of(m_target_results.begin(), m_target_results.end(), wants_updates)) {
+            // The previous rows aren't kept up to date while nothing is using
+            // them, so they can't be diffed against once something is again
+            m_previous_rows_stale = has_run() || m_rows_adopted;
             return false;
         }
     }
 
-    // If we've run previously, check if we need to rerun
-    if (has_run() && m_query->sync_view_if_needed() == m_last_seen_version) {
-        return false;
+    // If we've run previously, check if we need to rerun. Adopted rows came
+    // from another SharedGroup, so its table version can't be compared with
+    // ours, but the rows can still be checked against the changes.
+    if (has_run() || m_rows_adopted) {
+        auto version = m_query->sync_view_if_needed();
+        if (version == m_last_seen_version && !m_rows_adopted)
+            return false;
+        if (!m_previous_rows_stale && rows_are_unchanged()) {
+            m_last_seen_version = version;
+            m_rows_unchanged = true;
+            return false;
+        }
     }
 
     return true;
 }
 
-void ResultsNotifier::calculate_changes()
+bool ResultsNotifier::rows_are_unchanged()
+{
+    if (m_info->changes_unknown)
+        return false;
+    if (m_info->schema_changed) {
+        update_used_columns();
+        return false;
+    }
+    if (m_used_columns.empty())
+        return false;
+
+    // The table version is also bumped for changes to tables which it links
+    // to, but we only get here if the query doesn't follow any links and the
+    // ordering only does so for the cached sort keys, so no changes at all to
+    // our table means that only the sort keys have to be checked
+    auto sorted = [&] {
+        return !m_sort_keys || m_sort_keys->is_sorted(m_previous_rows);
+    };
+    size_t table_ndx = m_query->get_table()->get_index_in_group();
+    auto changes_ptr = m_info->tables.find(table_ndx);
+    if (!changes_ptr)
+        return sorted();
+
+    auto const& changes = *changes_ptr;
+    auto matches = [&](size_t row) { return m_query->count(row, row + 1, 1) != 0; };
+
+    // Deleted rows must not have been in the results, and no rows which were
+    // in the results can have been moved or shifted to a different index
+    if (!changes.insertions.empty() || !changes.deletions.empty()) {
+        for (auto row : m_previous_rows) {
+            if (changes.deletions.contains(row))
+                return false;
+            if (changes.insertions.shift(changes.deletions.unshift(row)) != row)
+                return false;
+        }
+    }
+
+    // A changed row which matches the query has to be in the results unless
+    // the results are limited and it sorts after the last row
+    auto can_ignore = [&](size_t row) {
+        return !matches(row) || (m_top_k && sorts_after_last_row(row));
+    };
+
+    // Newly inserted rows (which includes rows moved to a new index) must not
+    // match the query. Only these rows have to be checked rather than
+    // rerunning the query on the entire table.
+    for (auto row : changes.insertions.as_indexes()) {
+        if (!can_ignore(row))
+            return false;
+    }
+
+    // Modifications to columns used by the query are fine as long as they
+    // don't change whether the row matches the query. Sorting and distinct
+    // may also depend on them, so those have to be rerun unless they're
+    // sorted and limited and the row is outside of the limit both before and
+    // after the change, or the sort keys are cached and checked below.
+    bool in_table_order = m_target_is_in_table_order && m_descriptor_ordering.is_empty();
+    std::vector<size_t> sorted_rows;
+    if (m_top_k || m_sort_keys) {
+        sorted_rows = m_previous_rows;
+        std::sort(sorted_rows.begin(), sorted_rows.end());
+    }
+    auto const& rows_by_index = m_top_k || m_sort_keys ? sorted_rows : m_previous_rows;
+    for (size_t col = 0; col < changes.columns.size(); ++col) {
+        if (changes.columns[col].empty())
+            continue;
+        if (col < m_used_columns.size() && !m_used_columns[col])
+            continue;
+        if (!in_table_order && !m_top_k && !m_sort_keys)
+            return false;
+        for (auto row : changes.columns[col].as_indexes()) {
+            if (changes.insertions.contains(row))
+                continue;
+            // m_previous_rows is sorted when the results are in table order
+            bool was_in_results = std::binary_search(rows_by_index.begin(), rows_by_index.end(), row);
+            if (m_top_k) {
+                if (was_in_results || !can_ignore(row))
+                    return false;
+            }
+            else if (was_in_results != matches(row))
+                return false;
+        }
+    }
+    return sorted();
+}
+
+bool ResultsNotifier::sorts_after_last_row(size_t row)
+{
+    REALM_ASSERT(m_top_k);
+    // If the limit hasn't been reached yet then any matching row is included
+    if (m_previous_rows.size() < m_top_k->limit)
+        return false;
+
+    auto cmp = compare_rows(*m_query->get_table(), m_top_k->sort, row, m_previous_rows.back());
+    // Ties are broken by position in the table, which may not be stable here
+    return cmp && *cmp > 0;
+}
+
+util::Optional<int> ResultsNotifier::compare_rows(Table const& table, SortColumns const& sort, size_t a, size_t b)
+{
+    for (auto& column : sort) {
+        size_t col = column.first;
+        if (table.is_null(col, a) || table.is_null(col, b))
+            return util::none;
+
+        int cmp = 0;
+        switch (table.get_column_type(col)) {
+            case type_Int: {
+                auto x = table.get_int(col, a), y = table.get_int(col, b);
+                cmp = x < y ? -1 : x > y;
+                break;
+            }
+            case type_Bool: {
+                bool x = table.get_bool(col, a), y = table.get_bool(col, b);
+                cmp = x < y ? -1 : x > y;
+                break;
+            }
+            case type_Timestamp: {
+                auto x = table.get_timestamp(col, a), y = table.get_timestamp(col, b);
+                cmp = x < y ? -1 : x > y;
+                break;
+            }
+            case type_Float: {
+                float x = table.get_float(col, a), y = table.get_float(col, b);
+                if (std::isnan(x) || std::isnan(y))
+                    return util::none;
+                cmp = x < y ? -1 : x > y;
+                break;
+            }
+            case type_Double: {
+                double x = table.get_double(col, a), y = table.get_double(col, b);
+                if (std::isnan(x) || std::isnan(y))
+                    return util::none;
+                cmp = x < y ? -1 : x > y;
+                break;
+            }
+            default:
+                // Other types don't have a simple enough ordering to be
+                // certain that we match the sort's behavior
+                return util::none;
+        }
+        if (cmp != 0)
+            return column.second ? cmp : -cmp;
+    }
+    return 0;
+}
+
+void ResultsNotifier::update_used_columns()
+{
+    m_used_columns.clear();
+    m_top_k = util::none;
+    m_sort_keys = util::none;
+    m_window_sort = util::none;
+
+    auto table = m_query->get_table();
+    if (!table->is_attached() || !table->is_group_level())
+        return;
+
+    // Column names which would need escaping in the description can't be
+    // reliably found in it
+    size_t column_count = table->get_column_count();
+    for (size_t col = 0; col < column_count; ++col) {
+        auto name = table->get_column_name(col);
+        if (name.size() == 0)
+            return;
+        for (char c : name) {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '$')
+                return;
+        }
+    }
+
+    std::string description, ordering_description;
+    try {
+        description = m_query->get_description();
+        if (!m_descriptor_ordering.is_empty())
+            ordering_description = m_descriptor_ordering.get_description(table);
+    }
+    catch (std::exception const&) {
+        return;
+    }
+
+    std::vector<bool> used(column_count, false);
+    // A sort on key paths which follow links is checked with cached sort
+    // keys, so only the first column of each key path is read directly
+    util::Optional<SortKeyCache> sort_keys;
+    if (ordering_description.find('.') != std::string::npos && m_query->produces_results_in_table_order()) {
+        sort_keys = parse_sort_key_paths(*table, ordering_description);
+        if (sort_keys)
+            ordering_description.clear();
+    }
+    description += " " + ordering_description;
+
+    auto is_identifier = [](char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '@' || c == '.';
+    };
+    for (size_t i = 0; i < description.size();) {
+        char c = description[i];
+        if (c == '"') {
+            // Skip over string literals, which may contain anything
+            for (++i; i < description.size() && description[i] != '"'; ++i) {
+                if (description[i] == '\\')
+                    ++i;
+            }
+            ++i;
+            continue;
+        }
+        if (!is_identifier(c)) {
+            ++i;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < description.size() && is_identifier(description[end]))
+            ++end;
+        std::string token = description.substr(i, end - i);
+        i = end;
+
+        if (isdigit(static_cast<unsigned char>(token[0])))
+            continue; // a numeric literal
+        // Key paths which follow links (or backlinks and subqueries) depend
+        // on other tables too, so we have to rerun for every change
+        if (token[0] == '@' || token.find('.') != std::string::npos)
+            return;
+
+        size_t col = table->get_column_index(token);
+        if (col != npos)
+            used[col] = true;
+    }
+
+    if (sort_keys) {
+        for (size_t col : sort_keys->first_columns())
+            used[col] = true;
+    }
+
+    m_used_columns = std::move(used);
+    m_top_k = parse_sort_and_limit(*table, ordering_description);
+    m_sort_keys = std::move(sort_keys);
+    if (m_is_window && m_query->produces_results_in_table_order()) {
+        if (m_descriptor_ordering.is_empty())
+            m_window_sort = SortColumns{};
+        else if (!ordering_description.empty() && ordering_description.find(')') == ordering_description.size() - 1)
+            m_window_sort = parse_sort(*table, ordering_description);
+    }
+}
+
+util::Optional<ResultsNotifier::SortColumns> ResultsNotifier::parse_sort(Table const& table,
+                                                                      std::string const& description)
+{
+    // Parses the sort at the start of the description, e.g. "SORT(a ASC, b DESC)"
+    static const std::string sort_prefix = "SORT(";
+    if (description.compare(0, sort_prefix.size(), sort_prefix) != 0)
+        return util::none;
+    size_t sort_end = description.find(')');
+    if (sort_end == std::string::npos)
+        return util::none;
+
+    SortColumns columns;
+    std::string sort = description.substr(sort_prefix.size(), sort_end - sort_prefix.size());
+    size_t pos = 0;
+    while (pos < sort.size()) {
+        size_t end = sort.find(", ", pos);
+        if (end == std::string::npos)
+            end = sort.size();
+        auto clause = sort.substr(pos, end - pos);
+        pos = end + 2;
+
+        size_t space = clause.find(' ');
+        if (space == std::string::npos)
+            return util::none;
+        auto direction = clause.substr(space + 1);
+        if (direction != "ASC" && direction != "DESC")
+            return util::none;
+        size_t col = table.get_column_index(clause.substr(0, space));
+        if (col == npos)
+            return util::none;
+        columns.push_back({col, direction == "ASC"});
+    }
+    if (columns.empty())
+        return util::none;
+    return columns;
+}
+
+util::Optional<ResultsNotifier::TopK> ResultsNotifier::parse_sort_and_limit(Table const& table,
+                                                                              std::string const& description)
+{
+    // Only a single sort followed by a limit is supported, i.e.
+    // "SORT(a ASC, b DESC) LIMIT(10)"
+    static const std::string limit_prefix = " LIMIT(";
+    size_t sort_end = description.find(')');
+    if (sort_end == std::string::npos || description.compare(sort_end + 1, limit_prefix.size(), limit_prefix) != 0)
+        return util::none;
+    size_t limit_begin = sort_end + 1 + limit_prefix.size();
+    if (description.size() < limit_begin + 2 || description.back() != ')')
+        return util::none;
+    auto limit_str = description.substr(limit_begin, description.size() - limit_begin - 1);
+    if (limit_str.find_first_not_of("0123456789") != std::string::npos)
+        return util::none;
+
+    auto sort = parse_sort(table, description);
+    if (!sort)
+        return util::none;
+    return TopK{std::move(*sort), static_cast<size_t>(std::stoull(limit_str))};
+}
+
+util::Optional<SortKeyCache> ResultsNotifier::parse_sort_key_paths(Table const& table,
+                                                                  std::string const& description)
+{
+    // Only a single sort with nothing else in the ordering is supported, i.e.
+    // "SORT(a.b ASC, c DESC)"
+    static const std::string sort_prefix = "SORT(";
+    if (description.compare(0, sort_prefix.size(), sort_prefix) != 0)
+        return util::none;
+    size_t sort_end = description.find(')');
+    if (sort_end != description.size() - 1)
+        return util::none;
+
+    std::vector<SortKeyCache::KeyPath> paths;
+    std::string sort = description.substr(sort_prefix.size(), sort_end - sort_prefix.size());
+    size_t pos = 0;
+    while (pos < sort.size()) {
+        size_t end = sort.find(", ", pos);
+        if (end == std::string::npos)
+            end = sort.size();
+        auto clause = sort.substr(pos, end - pos);
+        pos = end + 2;
+
+        size_t space = clause.find(' ');
+        if (space == std::string::npos)
+            return util::none;
+        auto direction = clause.substr(space + 1);
+        if (direction != "ASC" && direction != "DESC")
+            return util::none;
+
+        // Resolve each link in the key path in the table it links to
+        SortKeyCache::KeyPath path{{}, direction == "ASC"};
+        auto key_path = clause.substr(0, space);
+        ConstTableRef current = table.get_table_ref();
+        size_t name_begin = 0;
+        while (true) {
+            size_t name_end = key_path.find('.', name_begin);
+            size_t col = current->get_column_index(key_path.substr(name_begin, name_end - name_begin));
+            if (col == npos)
+                return util::none;
+            path.columns.push_back(col);
+            if (name_end == std::string::npos)
+                break;
+            if (current->get_column_type(col) != type_Link)
+                return util::none;
+            current = current->get_link_target(col);
+            name_begin = name_end + 1;
+        }
+        paths.push_back(std::move(path));
+    }
+    return SortKeyCache::make(table, paths);
+}
+
+void ResultsNotifier::calculate_modifications()
+{
+    if (!have_callbacks())
+        return;
+
+    auto checker = get_modification_checker(*m_info, *m_query->get_table());
+    for (size_t i = 0; i < m_previous_rows.size(); ++i) {
+        if (checker(m_previous_rows[i]))
+            m_changes.modify(i);
+    }
+}
+
+CollectionChangeBuilder const* ResultsNotifier::table_changes() const
 {
     size_t table_ndx = m_query->get_table()->get_index_in_group();
+    if (table_ndx == npos)
+        return &m_changes;
+    return m_info->tables.find(table_ndx);
+}
+
+void ResultsNotifier::map_previous_rows(std::vector<size_t>& rows, CollectionChangeBuilder const& changes)
+{
+    auto const& moves = changes.moves;
+    for (auto& idx : rows) {
+        if (changes.deletions.contains(idx)) {
+            // check if this deletion was actually a move
+            auto it = lower_bound(begin(moves), end(moves), idx,
+                                  [](auto const& a, auto b) { return a.from < b; });
+            idx = it != moves.end() && it->from == idx ? it->to : npos;
+        }
+        else
+            idx = changes.insertions.shift(changes.deletions.unshift(idx));
+    }
+}
+
+// Clearing a table is recorded as deleting every possible row index
+static bool table_was_cleared(CollectionChangeBuilder const& changes)
+{
+    if (changes.deletions.empty())
+        return false;
+    auto first = *changes.deletions.begin();
+    return first.first == 0 && first.second == std::numeric_limits<size_t>::max();
+}
+
+void ResultsNotifier::calculate_changes()
+{
     if (has_run() && have_callbacks()) {
-        CollectionChangeBuilder* changes = nullptr;
-        if (table_ndx == npos)
-            changes = &m_changes;
-        else if (table_ndx < m_info->tables.size())
-            changes = &m_info->tables[table_ndx];
+        auto changes = table_changes();
 
         std::vector<size_t> next_rows;
         next_rows.reserve(m_tv.size());
         for (size_t i = 0; i < m_tv.size(); ++i)
             next_rows.push_back(m_tv[i].get_index());
 
-        util::Optional<IndexSet> move_candidates;
-        if (changes) {
-            auto const& moves = changes->moves;
-            for (auto& idx : m_previous_rows) {
-                if (changes->deletions.contains(idx)) {
-                    // check if this deletion was actually a move
-                    auto it = lower_bound(begin(moves), end(moves), idx,
-                                          [](auto const& a, auto b) { return a.from < b; });
-                    idx = it != moves.end() && it->from == idx ? it->to : npos;
-                }
-                else
-                    idx = changes->insertions.shift(changes->deletions.unshift(idx));
-            }
-            if (m_target_is_in_table_order && !m_descriptor_ordering.will_apply_sort())
-                move_candidates = changes->insertions;
+        if (m_info->changes_unknown || m_previous_rows_stale || (changes && table_was_cleared(*changes))) {
+            // None of the previous rows still exist (or what happened to them
+            // wasn't tracked), so there's nothing to gain from mapping them to
+            // their new indices and diffing them
+            m_changes = {};
+            m_changes.deletions.set(m_previous_rows.size());
+            m_changes.insertions.set(next_rows.size());
         }
+        else {
+            util::Optional<IndexSet> move_candidates;
+            if (changes) {
+                map_previous_rows(m_previous_rows, *changes);
+                if (m_target_is_in_table_order && !m_descriptor_ordering.will_apply_sort())
+                    move_candidates = changes->insertions;
+            }
 
-        m_changes = CollectionChangeBuilder::calculate(m_previous_rows, next_rows,
-                                                       get_modification_checker(*m_info, *m_query->get_table()),
-                                                       move_candidates);
+            m_changes = CollectionChangeBuilder::calculate(m_previous_rows, next_rows,
+                                                           get_modification_checker(*m_info, *m_query->get_table()),
+                                                           move_candidates);
+        }
+        update_aggregates(next_rows);
 
         m_previous_rows = std::move(next_rows);
     }
@@ -156,47 +902,376 @@ void ResultsNotifier::calculate_changes()
         m_previous_rows.resize(m_tv.size());
         for (size_t i = 0; i < m_tv.size(); ++i)
             m_previous_rows[i] = m_tv[i].get_index();
+        for (auto& aggregate : m_active_aggregates)
+            aggregate->reset(*m_query->get_table(), m_previous_rows);
     }
+    m_previous_rows_stale = false;
 }
 
 void ResultsNotifier::run()
 {
+    {
+        auto lock = lock_target();
+        m_active_aggregates.clear();
+        for (auto& weak : m_aggregates) {
+            if (auto aggregate = weak.lock())
+                m_active_aggregates.push_back(std::move(aggregate));
+        }
+        m_aggregates.erase(std::remove_if(m_aggregates.begin(), m_aggregates.end(),
+                                          [](auto& weak) { return weak.expired(); }),
+                           m_aggregates.end());
+    }
+
     // Table's been deleted, so report all rows as deleted
     if (!m_query->get_table()->is_attached()) {
         m_changes = {};
-        m_changes.deletions.set(m_previous_rows.size());
+        m_changes.deletions.set(m_count_only_size != npos ? m_count_only_size : m_previous_rows.size());
+        m_count_only_size = npos;
         m_previous_rows.clear();
+        m_fetched_rows.clear();
+        m_window_changed = m_is_window;
+        for (auto& aggregate : m_active_aggregates)
+            aggregate->reset(*m_query->get_table(), m_previous_rows);
+        return;
+    }
+
+    // The cached sort keys are kept up to date even when the query is rerun,
+    // so that only the keys of the affected rows have to be read again
+    if (m_sort_keys && has_run())
+        m_sort_keys->update(*m_info);
+
+    m_rows_unchanged = false;
+    if (m_is_window) {
+        run_window();
+        return;
+    }
+    if (can_run_count_only()) {
+        run_count_only();
+        return;
+    }
+
+    if (m_count_only_size != npos) {
+        // We were previously only counting the rows, so which rows were in
+        // the results isn't known and they all have to be reported as replaced
+        size_t previous_size = m_count_only_size;
+        m_count_only_size = npos;
+        run_query();
+        m_previous_rows.resize(m_tv.size());
+        for (size_t i = 0; i < m_tv.size(); ++i)
+            m_previous_rows[i] = m_tv[i].get_index();
+        m_changes = {};
+        m_changes.deletions.set(previous_size);
+        m_changes.insertions.set(m_previous_rows.size());
+        for (auto& aggregate : m_active_aggregates)
+            aggregate->reset(*m_query->get_table(), m_previous_rows);
         return;
     }
 
-    if (!need_to_run())
+    if (!need_to_run()) {
+        if (m_rows_unchanged && m_rows_adopted) {
+            // As with running the query for the first time there are no
+            // changes to report, only the rows to start from
+            for (auto& aggregate : m_active_aggregates)
+                aggregate->reset(*m_query->get_table(), m_previous_rows);
+        }
+        else if (m_rows_unchanged) {
+            calculate_modifications();
+            update_aggregates(m_previous_rows);
+        }
+    }
+    else {
+        run_query();
+        calculate_changes();
+    }
+
+    // Aggregates added since the last run start from the current rows, if
+    // there are any yet
+    if (has_run()) {
+        for (auto& aggregate : m_active_aggregates) {
+            if (!aggregate->is_initialized())
+                aggregate->reset(*m_query->get_table(), m_previous_rows);
+        }
+    }
+}
+
+bool ResultsNotifier::release_rows_for_reuse(std::vector<size_t>& rows)
+{
+    if (!has_run() || m_previous_rows_stale || m_rows_adopted || m_is_window || m_count_only_size != npos)
+        return false;
+    if (m_sharing_key.empty() || !m_query || !m_query->get_table()->is_attached())
+        return false;
+    rows = std::move(m_previous_rows);
+    m_previous_rows.clear();
+    return true;
+}
+
+void ResultsNotifier::adopt_rows(std::vector<size_t> rows)
+{
+    REALM_ASSERT(!has_run());
+    if (m_is_window)
         return;
+    m_previous_rows = std::move(rows);
+    m_previous_rows_stale = false;
+    m_rows_adopted = true;
+}
 
+void ResultsNotifier::run_query()
+{
     m_query->sync_view_if_needed();
     m_tv = m_query->find_all();
     m_tv.apply_descriptor_ordering(m_descriptor_ordering);
     m_last_seen_version = m_tv.sync_if_needed();
+}
+
+static size_t saturating_add(size_t a, size_t b)
+{
+    return a > npos - b ? npos : a + b;
+}
+
+void ResultsNotifier::run_window()
+{
+    Window window;
+    bool moved;
+    {
+        auto lock = lock_target();
+        if (!get_realm())
+            return;
+        window = m_window;
+        moved = m_window_moved;
+        m_window_moved = false;
+    }
+
+    auto version = m_query->sync_view_if_needed();
+    bool changed = !has_run() || version != m_last_seen_version;
+    if (!changed && !moved)
+        return;
+
+    // Rows appended to the table can often just be inserted into the rows
+    // which were already fetched rather than rerunning the query
+    bool inserted = changed && has_run() && insert_into_fetched_rows();
+    if (inserted)
+        m_last_seen_version = version;
+
+    // Moving the window within the rows which were already fetched doesn't
+    // require rerunning the query
+    size_t end = saturating_add(window.offset, window.count);
+    size_t fetched_end = m_fetched_offset + m_fetched_rows.size();
+    if ((changed && !inserted) || window.offset < m_fetched_offset || (end > fetched_end && !m_fetched_to_end)) {
+        fetch_window(window);
+        fetched_end = m_fetched_offset + m_fetched_rows.size();
+    }
+
+    std::vector<size_t> next_rows;
+    if (window.offset < fetched_end) {
+        next_rows.assign(m_fetched_rows.begin() + (window.offset - m_fetched_offset),
+                         m_fetched_rows.begin() + (std::min(end, fetched_end) - m_fetched_offset));
+    }
+
+    if (has_run() && have_callbacks()) {
+        // If only the window moved then no rows were modified, and the
+        // previous rows are still at the same indices in the table
+        std::function<bool (size_t)> checker = [](size_t) { return false; };
+        if (changed && m_info->changes_unknown) {
+            // The previous rows can't be mapped to their new indices, so
+            // report the whole window as replaced
+            m_changes = {};
+            m_changes.deletions.set(m_previous_rows.size());
+            m_changes.insertions.set(next_rows.size());
+        }
+        else {
+            if (changed) {
+                if (auto changes = table_changes())
+                    map_previous_rows(m_previous_rows, *changes);
+                checker = get_modification_checker(*m_info, *m_query->get_table());
+            }
+            m_changes = CollectionChangeBuilder::calculate(m_previous_rows, next_rows, checker);
+        }
+    }
+    else {
+        m_changes = {};
+    }
+
+    m_previous_rows = std::move(next_rows);
+    m_window_offset = window.offset;
+    m_window_changed = true;
+}
+
+void ResultsNotifier::fetch_window(Window const& window)
+{
+    size_t begin = window.offset > window.margin ? window.offset - window.margin : 0;
+    size_t limit = saturating_add(saturating_add(window.offset, window.count), window.margin);
+
+    TableView tv;
+    if (m_descriptor_ordering.is_empty()) {
+        tv = m_query->find_all(0, npos, limit);
+    }
+    else {
+        // Sorting still has to look at every matching row, but only the rows
+        // up to the end of the margin after the window are kept
+        auto ordering = m_descriptor_ordering;
+        if (limit != npos)
+            ordering.append_limit(limit);
+        tv = m_query->find_all(ordering);
+    }
+    m_last_seen_version = tv.sync_if_needed();
+
+    m_fetched_rows.clear();
+    for (size_t i = begin; i < tv.size(); ++i)
+        m_fetched_rows.push_back(tv.get_source_ndx(i));
+    m_fetched_offset = begin;
+    m_fetched_to_end = tv.size() < limit;
+}
+
+bool ResultsNotifier::insert_into_fetched_rows()
+{
+    if (!m_window_sort || m_used_columns.empty() || m_info->changes_unknown || m_info->schema_changed)
+        return false;
+
+    // The query doesn't follow links if m_used_columns is set, and although
+    // the ordering may for the cached sort keys, m_window_sort is only set
+    // for a sort on columns of this table, so changes to other tables don't
+    // matter
+    auto& table = *m_query->get_table();
+    auto changes = m_info->tables.find(table.get_index_in_group());
+    if (!changes)
+        return true;
+
+    // The rows already in the table must be exactly as they were, and the
+    // new rows must have been added after all of them
+    if (!changes->deletions.empty() || !changes->moves.empty())
+        return false;
+    size_t old_size = table.size() - changes->insertions.count();
+    if (!changes->insertions.empty() && changes->insertions.begin()->first < old_size)
+        return false;
+    for (size_t col = 0; col < changes->columns.size() && col < m_used_columns.size(); ++col) {
+        auto& modified = changes->columns[col];
+        if (m_used_columns[col] && !modified.empty() && modified.begin()->first < old_size)
+            return false;
+    }
+
+    bool comparable = true;
+    // Rows with equal sort keys are in table order, so each new row goes
+    // after all of the existing rows which it ties with
+    auto sorts_before = [&](size_t row, size_t existing) {
+        auto cmp = compare_rows(table, *m_window_sort, row, existing);
+        if (!cmp)
+            comparable = false;
+        return cmp && *cmp < 0;
+    };
+    for (auto row : changes->insertions.as_indexes()) {
+        if (m_query->count(row, row + 1, 1) == 0)
+            continue;
+        auto pos = std::upper_bound(m_fetched_rows.begin(), m_fetched_rows.end(), row, sorts_before);
+        if (!comparable)
+            return false;
+        // A row before the fetched rows changes which rows they are, while
+        // one after them isn't needed unless they run to the end
+        if (pos == m_fetched_rows.begin() && m_fetched_offset > 0)
+            return false;
+        if (pos == m_fetched_rows.end() && !m_fetched_to_end)
+            continue;
+        m_fetched_rows.insert(pos, row);
+    }
+    return true;
+}
+
+bool ResultsNotifier::can_run_count_only()
+{
+    if (m_active_aggregates.empty() || m_descriptor_ordering.will_apply_distinct())
+        return false;
+    // Every callback which has been added belongs to an aggregate, so this
+    // can only be true if there are no ordinary callbacks
+    size_t observed = 0;
+    for (auto& aggregate : m_active_aggregates) {
+        if (!aggregate->only_needs_count())
+            return false;
+        if (aggregate->has_callback())
+            ++observed;
+    }
+    if (observed != callback_count())
+        return false;
+
+    auto lock = lock_target();
+    if (!get_realm())
+        return false;
+    auto wants_updates = [](Results* results) { return results->wants_background_updates(); };
+    return std::none_of(m_target_results.begin(), m_target_results.end(), wants_updates);
+}
+
+void ResultsNotifier::run_count_only()
+{
+    auto version = m_query->sync_view_if_needed();
+    bool was_count_only = m_count_only_size != npos;
+    if (!was_count_only || version != m_last_seen_version) {
+        m_last_seen_version = version;
+        size_t previous_size = was_count_only ? m_count_only_size : m_previous_rows.size();
+        m_count_only_size = m_query->count(m_descriptor_ordering);
+        if (!was_count_only) {
+            m_previous_rows.clear();
+            m_previous_rows.shrink_to_fit();
+        }
+
+        // The callbacks don't look at the changes, but there has to be some
+        // for them to be called
+        m_changes = {};
+        if (has_run() && previous_size != m_count_only_size) {
+            m_changes.deletions.set(previous_size);
+            m_changes.insertions.set(m_count_only_size);
+        }
+    }
 
-    calculate_changes();
+    for (auto& aggregate : m_active_aggregates)
+        aggregate->update_count(m_count_only_size);
 }
 
 void ResultsNotifier::do_prepare_handover(SharedGroup& sg)
 {
+    m_rows_adopted = false;
+    for (auto& aggregate : m_active_aggregates) {
+        if (aggregate->is_initialized())
+            aggregate->prepare_handover();
+    }
+    m_active_aggregates.clear();
+
+    if (m_window_changed) {
+        m_window_handover = std::make_shared<WindowRows>(WindowRows{m_window_offset, m_previous_rows});
+        m_window_changed = false;
+    }
+
+    // Any TableView from before the notifier started only counting the rows
+    // may no longer be current
+    if (m_count_only_size != npos)
+        m_tv_handover = nullptr;
+
     if (!m_tv.is_attached()) {
         // if the table version didn't change we can just reuse the same handover
         // object and bump its version to the current SG version
         if (m_tv_handover)
             m_tv_handover->version = sg.get_version_of_current_transaction();
+        // Otherwise if the previous TableView has already been delivered, let
+        // the target know that it's still valid so that it doesn't rerun the
+        // query itself
+        else if (m_rows_unchanged) {
+            // Reuse the buffer from the last delivery if there is one, as
+            // otherwise this would allocate a copy of every row each commit
+            if (!m_rows_to_confirm)
+                m_rows_to_confirm = m_spare_rows ? std::move(m_spare_rows) : std::make_unique<std::vector<size_t>>();
+            *m_rows_to_confirm = m_previous_rows;
+        }
 
         // add_changes() needs to be called even if there are no changes to
         // clear the skip flag on the callbacks
         add_changes(std::move(m_changes));
+        report_memory_usage();
         return;
     }
 
     REALM_ASSERT(m_tv.is_in_sync());
 
+    m_tv_handover_rows = m_tv.size();
     m_tv_handover = sg.export_for_handover(m_tv, MutableSourcePayload::Move);
+    if (m_rows_to_confirm)
+        m_spare_rows = std::move(m_rows_to_confirm);
 
     add_changes(std::move(m_changes));
     REALM_ASSERT(m_changes.empty());
@@ -204,6 +1279,33 @@ void ResultsNotifier::do_prepare_handover(SharedGroup& sg)
     // detach the TableView as we won't need it again and keeping it around
     // makes advance_read() much more expensive
     m_tv = {};
+    report_memory_usage();
+}
+
+void ResultsNotifier::do_release_handover() noexcept
+{
+    // Results reruns its query if it isn't given a new TableView, and the
+    // rows to confirm only let it skip doing so
+    m_tv_handover = nullptr;
+    m_tv_handover_rows = 0;
+    m_rows_to_confirm = nullptr;
+    m_spare_rows = nullptr;
+}
+
+void ResultsNotifier::report_memory_usage() noexcept
+{
+    size_t retained = (m_previous_rows.capacity() + m_fetched_rows.capacity()) * sizeof(size_t);
+    if (m_sort_keys)
+        retained += m_sort_keys->heap_size();
+    if (m_spare_rows)
+        retained += m_spare_rows->capacity() * sizeof(size_t);
+    // A handed-over TableView holds a row index for each row
+    size_t handover = m_tv_handover ? m_tv_handover_rows * sizeof(int64_t) : 0;
+    if (m_rows_to_confirm)
+        handover += m_rows_to_confirm->size() * sizeof(size_t);
+    if (m_window_handover)
+        handover += m_window_handover->rows.size() * sizeof(size_t);
+    set_memory_usage(retained, handover);
 }
 
 void ResultsNotifier::deliver(SharedGroup& sg)
@@ -213,14 +1315,22 @@ void ResultsNotifier::deliver(SharedGroup& sg)
     // Target realm being null here indicates that we were unregistered while we
     // were in the process of advancing the Realm version and preparing for
     // delivery, i.e. the results was destroyed from the "wrong" thread
-    if (!get_realm()) {
+    if (!get_realm() || m_target_results.empty()) {
         return;
     }
 
     REALM_ASSERT(!m_query_handover);
     if (m_tv_to_deliver) {
-        Results::Internal::set_table_view(*m_target_results,
-                                          std::move(*sg.import_from_handover(std::move(m_tv_to_deliver))));
+        auto tv = sg.import_from_handover(std::move(m_tv_to_deliver));
+        // Each target needs its own copy of the TableView, so copy it for all
+        // but the last one and then give it the original
+        for (size_t i = 0; i + 1 < m_target_results.size(); ++i)
+            Results::Internal::set_table_view(*m_target_results[i], TableView(*tv));
+        Results::Internal::set_table_view(*m_target_results.back(), std::move(*tv));
+    }
+    else if (m_rows_to_deliver) {
+        for (auto target : m_target_results)
+            Results::Internal::confirm_table_view(*target, *m_rows_to_deliver);
     }
     REALM_ASSERT(!m_tv_to_deliver);
 }
@@ -230,7 +1340,22 @@ bool ResultsNotifier::prepare_to_deliver()
     auto lock = lock_target();
     if (!get_realm())
         return false;
+    // Wait for the worker thread to calculate the initial value of any newly
+    // added aggregates so that their callbacks aren't called without one
+    for (auto& weak : m_aggregates) {
+        auto aggregate = weak.lock();
+        if (aggregate && !aggregate->prepare_to_deliver(version()))
+            return false;
+    }
     m_tv_to_deliver = std::move(m_tv_handover);
+    // The rows from the previous delivery have been confirmed by deliver() by
+    // now, and as this is called with the handover lock held this is where
+    // their buffer can be handed back to the worker thread
+    if (m_rows_to_deliver && !m_spare_rows)
+        m_spare_rows = std::move(m_rows_to_deliver);
+    m_rows_to_deliver = std::move(m_rows_to_confirm);
+    if (m_window_handover)
+        m_window_rows = std::move(m_window_handover);
     return true;
 }
 
@@ -239,6 +1364,7 @@ void ResultsNotifier::do_attach_to(SharedGroup& sg)
     REALM_ASSERT(m_query_handover);
     m_query = sg.import_from_handover(std::move(m_query_handover));
     m_descriptor_ordering = DescriptorOrdering::create_from_and_consume_patch(m_ordering_handover, *m_query->get_table());
+    update_used_columns();
 }
 
 void ResultsNotifier::do_detach_from(SharedGroup& sg)
@@ -249,4 +1375,5 @@ void ResultsNotifier::do_detach_from(SharedGroup& sg)
     DescriptorOrdering::generate_patch(m_descriptor_ordering, m_ordering_handover);
     m_query_handover = sg.export_for_handover(*m_query, MutableSourcePayload::Move);
     m_query = nullptr;
+    m_sort_keys = util::none;
 }
@@ -20,22 +20,152 @@
 #define REALM_RESULTS_NOTIFIER_HPP
 
 #include "collection_notifier.hpp"
+#include "impl/sort_key_cache.hpp"
 #include "results.hpp"
 
 #include <realm/group_shared.hpp>
 
+#include <atomic>
+
 namespace realm {
 namespace _impl {
+// The value of an aggregate observed with Results::observe_aggregate(). The
+// value is maintained on the worker thread by applying the changes to the rows
+// of the results to a cached copy of the aggregated column, and then handed
+// over to the target thread along with the rest of the notifier's data.
+class AggregateObserver {
+public:
+    static std::shared_ptr<AggregateObserver> make(size_t column, Results::AggregateKind kind, DataType type);
+    virtual ~AggregateObserver() = default;
+
+    // Worker thread {
+    bool is_initialized() const noexcept { return m_initialized; }
+    // Compute the value from scratch for the given table rows
+    virtual void reset(Table const& table, std::vector<size_t> const& rows) = 0;
+    // Update the value for `rows` which were produced from the previously seen
+    // rows by `changes`, where deletions are indices in the previous rows and
+    // insertions and modifications are indices in `rows`
+    virtual void update(Table const& table, std::vector<size_t> const& rows,
+                        CollectionChangeBuilder const& changes) = 0;
+    void prepare_handover() { m_handover = value(); m_has_handover = true; }
+
+    // Whether the value depends only on the number of rows, in which case the
+    // notifier can maintain it with update_count() without knowing the rows
+    virtual bool only_needs_count() const noexcept { return false; }
+    virtual void update_count(size_t) { REALM_UNREACHABLE(); }
+    // }
+
+    // Set by the target thread once the callback which delivers the value
+    // has been added to the notifier
+    void set_has_callback() noexcept { m_has_callback = true; }
+    bool has_callback() const noexcept { return m_has_callback; }
+
+    size_t column() const noexcept { return m_column; }
+    Results::AggregateKind kind() const noexcept { return m_kind; }
+
+    // Target thread, with the handover copied to m_to_deliver by
+    // prepare_to_deliver() while holding the notifier lock. Returns false if
+    // the worker thread hasn't calculated a value yet.
+    bool prepare_to_deliver(VersionID version);
+    util::Optional<Mixed> const& delivered_value() const noexcept { return m_to_deliver; }
+    // The version of the Realm which the delivered value is for
+    VersionID delivered_version() const noexcept { return m_delivered_version; }
+
+protected:
+    AggregateObserver(size_t column, Results::AggregateKind kind) : m_column(column), m_kind(kind) { }
+    virtual util::Optional<Mixed> value() const = 0;
+
+    const size_t m_column;
+    const Results::AggregateKind m_kind;
+    bool m_initialized = false;
+
+private:
+    std::atomic<bool> m_has_callback = {false};
+    bool m_has_handover = false;
+    util::Optional<Mixed> m_handover;
+    util::Optional<Mixed> m_to_deliver;
+    VersionID m_delivered_version;
+};
+
 class ResultsNotifier : public CollectionNotifier {
 public:
-    ResultsNotifier(Results& target);
+    ResultsNotifier(Results& target, std::string sharing_key = {});
+
+    // The range of the results observed by a ResultsWindow, plus the number
+    // of rows on each side of it to fetch so that small moves of the window
+    // don't require rerunning the query
+    struct Window {
+        size_t offset;
+        size_t count;
+        size_t margin;
+    };
+    // The rows in a window and the offset of the first one in the results
+    struct WindowRows {
+        size_t offset;
+        std::vector<size_t> rows;
+    };
+
+    // Create a notifier which only calculates the rows inside `window` of
+    // the results of `source`, and which has no target Results
+    ResultsNotifier(Results const& source, Window window);
+
+    // Target thread: change the observed range of a window notifier and wake
+    // up the worker thread to calculate it
+    void set_window(size_t offset, size_t count);
+    // Target thread: the rows of the window as of the most recently delivered
+    // notification, or null if nothing has been delivered yet
+    std::shared_ptr<const WindowRows> const& window_rows() const noexcept { return m_window_rows; }
 
     void target_results_moved(Results& old_target, Results& new_target);
 
+    // Get a key which uniquely identifies the given query and ordering, or an
+    // empty string if the query can't be serialized (e.g. because it is
+    // restricted to a LinkView or TableView). Results with identical
+    // non-empty keys for the same Realm instance can share a single notifier,
+    // which then runs the query once per commit for all of them.
+    static std::string sharing_key_for(Query const& query, DescriptorOrdering const& ordering);
+    std::string const& sharing_key() const noexcept { return m_sharing_key; }
+
+    // Add another Results with an identical query and ordering to be updated
+    // by this notifier
+    void add_target(Results& target);
+    // Stop updating the given Results. Returns true if there are no Results
+    // left using this notifier, in which case it should be unregistered.
+    bool remove_target(Results& target);
+
+    // Start maintaining the given aggregate. The returned observer is updated
+    // for as long as something other than the notifier holds a reference to it.
+    std::shared_ptr<AggregateObserver> add_aggregate(size_t column, Results::AggregateKind kind, DataType type);
+    // Target thread: get an observed aggregate whose most recently delivered
+    // value is for the given version, or null if there isn't one
+    std::shared_ptr<AggregateObserver> get_delivered_aggregate(size_t column, Results::AggregateKind kind,
+                                                               VersionID version);
+
+    // Worker thread: give up the rows as of version() so that a new notifier
+    // with the same sharing key can start from them, returning false if they
+    // aren't known to be current. Only for notifiers being discarded.
+    bool release_rows_for_reuse(std::vector<size_t>& rows);
+    // Worker thread: start from rows calculated by a previous notifier with
+    // the same sharing key at this notifier's version, so that the first run
+    // only has to check that they're still current rather than rerunning the
+    // query. Must be called after attaching and before the first run.
+    void adopt_rows(std::vector<size_t> rows);
+
+    // Sort columns and whether each is ascending
+    using SortColumns = std::vector<std::pair<size_t, bool>>;
+    // Parse the sort at the start of an ordering's description, returning
+    // none if it isn't a sort on columns of `table`
+    static util::Optional<SortColumns> parse_sort(Table const& table, std::string const& description);
+    // Compare two rows by the given sort columns, returning none if they
+    // can't be compared in the same way as core's sort compares them
+    static util::Optional<int> compare_rows(Table const& table, SortColumns const& sort, size_t a, size_t b);
+
 private:
-    // Target Results to update
+    // Target Results to update. There is more than one only if other Results
+    // with identical queries were attached via add_target().
     // Can only be used with lock_target() held
-    Results* m_target_results;
+    std::vector<Results*> m_target_results;
+    const std::string m_sharing_key;
 
     // The source Query, in handover form iff m_sg is null
     std::unique_ptr<SharedGroup::Handover<Query>> m_query_handover;
@@ -49,6 +179,8 @@ private:
     // the query was (re)run since the last time the handover object was created
     TableView m_tv;
     std::unique_ptr<SharedGroup::Handover<TableView>> m_tv_handover;
+    // The number of rows in m_tv_handover, for memory_stats()
+    size_t m_tv_handover_rows = 0;
     std::unique_ptr<SharedGroup::Handover<TableView>> m_tv_to_deliver;
 
     // The table version from the last time the query was run. Used to avoid
@@ -57,17 +189,111 @@ private:
 
     // The rows from the previous run of the query, for calculating diffs
     std::vector<size_t> m_previous_rows;
+    // Set if runs were skipped because there were no callbacks or targets
+    // wanting updates, so m_previous_rows no longer holds valid row indices
+    bool m_previous_rows_stale = false;
+    // Set by adopt_rows() until the first run, when m_previous_rows came from
+    // a previous notifier rather than from running the query
+    bool m_rows_adopted = false;
+
+    // The columns of the source table which are read by the query or ordering,
+    // indexed by column. Empty if they couldn't be determined (or the query
+    // isn't a simple single-table query), in which case the query is rerun for
+    // every change to the table.
+    std::vector<bool> m_used_columns;
+
+    // The sort columns and the limit when the ordering is a single sort
+    // followed by a limit, which lets changes to rows which sort after the
+    // last row be ignored
+    struct TopK {
+        SortColumns sort;
+        size_t limit;
+    };
+    util::Optional<TopK> m_top_k;
+    // The cached sort keys when the ordering is only a sort on key paths
+    // which follow links (and the query doesn't). Changes to the linked
+    // objects can then be checked against the cached keys of just the
+    // affected rows to skip rerunning the query when they don't change the
+    // order of the results.
+    util::Optional<SortKeyCache> m_sort_keys;
+
+    // Set by run() when the table changed but checking just the changed rows
+    // showed that the rows in the results and their order are unchanged, so
+    // the previous rows are still valid and the query was not rerun
+    bool m_rows_unchanged = false;
+    // A copy of the rows to confirm as still being current for the target
+    // Results, set when the query was skipped and there's no TableView to
+    // deliver, in handover form iff m_rows_to_deliver is null
+    std::unique_ptr<std::vector<size_t>> m_rows_to_confirm;
+    std::unique_ptr<std::vector<size_t>> m_rows_to_deliver;
+    // The buffer of the last rows delivered, handed back by the next
+    // prepare_to_deliver() so that the rows to confirm after that can be
+    // copied into it without allocating. Guarded by the handover lock, along
+    // with m_rows_to_confirm; m_rows_to_deliver is only used on the target
+    // thread once it has been packaged.
+    std::unique_ptr<std::vector<size_t>> m_spare_rows;
+
+    // Aggregates added with add_aggregate(), guarded by the target lock, and
+    // the ones which are still in use for the current run on the worker thread
+    std::vector<std::weak_ptr<AggregateObserver>> m_aggregates;
+    std::vector<std::shared_ptr<AggregateObserver>> m_active_aggregates;
+
+    // The number of rows in the results when the notifier is only counting
+    // them rather than running the query, or npos otherwise. This is done
+    // when the only callbacks are for aggregates which need just the count.
+    size_t m_count_only_size = npos;
+
+    // Set if this notifier is for a ResultsWindow. m_window and
+    // m_window_moved are guarded by the target lock.
+    const bool m_is_window = false;
+    Window m_window = {0, 0, 0};
+    bool m_window_moved = false;
+
+    // The rows fetched by the last run of a window's query, which are the
+    // rows of the results starting at m_fetched_offset. m_fetched_to_end is
+    // set if there were no more rows after these.
+    std::vector<size_t> m_fetched_rows;
+    size_t m_fetched_offset = 0;
+    bool m_fetched_to_end = false;
+    // The sort columns of a window whose ordering is either empty or a single
+    // sort on columns of the table, which lets rows appended to the table be
+    // inserted into the fetched rows without rerunning the query
+    util::Optional<SortColumns> m_window_sort;
+    // The offset of the window described by m_previous_rows
+    size_t m_window_offset = 0;
+    bool m_window_changed = false;
+    // Window rows in handover form iff m_window_rows is not the most recent
+    std::shared_ptr<const WindowRows> m_window_handover;
+    std::shared_ptr<const WindowRows> m_window_rows;
 
     // The changeset calculated during run() and delivered in do_prepare_handover()
     CollectionChangeBuilder m_changes;
     TransactionChangeInfo* m_info = nullptr;
 
     bool need_to_run();
+    bool rows_are_unchanged();
+    bool sorts_after_last_row(size_t row);
+    static util::Optional<TopK> parse_sort_and_limit(Table const& table, std::string const& description);
+    static util::Optional<SortKeyCache> parse_sort_key_paths(Table const& table, std::string const& description);
+    CollectionChangeBuilder const* table_changes() const;
+    static void map_previous_rows(std::vector<size_t>& rows, CollectionChangeBuilder const& changes);
     void calculate_changes();
+    void calculate_modifications();
+    void update_used_columns();
+    void update_aggregates(std::vector<size_t> const& rows);
+    bool can_run_count_only();
+    void run_count_only();
+    void run_query();
+    void run_window();
+    void fetch_window(Window const& window);
+    bool insert_into_fetched_rows();
     void deliver(SharedGroup&) override;
 
     void run() override;
+    const char* trace_name() const noexcept override { return "ResultsNotifier"; }
     void do_prepare_handover(SharedGroup&) override;
+    void report_memory_usage() noexcept;
+    void do_release_handover() noexcept override;
     bool do_add_required_change_info(TransactionChangeInfo& info) override;
     bool prepare_to_deliver() override;
 
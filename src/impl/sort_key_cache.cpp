@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "impl/sort_key_cache.hpp"
+
+#include "impl/collection_notifier.hpp"
+
+#include <realm/table.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace realm;
+using namespace realm::_impl;
+
+util::Optional<SortKeyCache> SortKeyCache::make(Table const& table, std::vector<KeyPath> const& paths)
+{
+    if (paths.empty())
+        return util::none;
+
+    SortKeyCache cache;
+    for (auto& key_path : paths) {
+        if (key_path.columns.empty())
+            return util::none;
+        Path path;
+        path.columns = key_path.columns;
+        path.ascending = key_path.ascending;
+        path.tables.push_back(table.get_table_ref());
+        for (size_t i = 0; i + 1 < path.columns.size(); ++i) {
+            auto& current = *path.tables.back();
+            if (path.columns[i] >= current.get_column_count() || current.get_column_type(path.columns[i]) != type_Link)
+                return util::none;
+            path.tables.push_back(current.get_link_target(path.columns[i]));
+        }
+        auto& last = *path.tables.back();
+        if (path.columns.back() >= last.get_column_count())
+            return util::none;
+        path.type = last.get_column_type(path.columns.back());
+        if (path.type != type_Int && path.type != type_Bool && path.type != type_Float
+            && path.type != type_Double && path.type != type_Timestamp)
+            return util::none;
+        cache.m_paths.push_back(std::move(path));
+    }
+    return cache;
+}
+
+void SortKeyCache::add_required_change_info(TransactionChangeInfo& info) const
+{
+    for (auto& path : m_paths) {
+        for (auto& table : path.tables)
+            info.table_modifications_needed.set(table->get_index_in_group());
+    }
+}
+
+void SortKeyCache::clear() noexcept
+{
+    m_rows.clear();
+    m_values.clear();
+}
+
+bool SortKeyCache::chain_modified(TransactionChangeInfo const& info, size_t row) const
+{
+    for (auto& path : m_paths) {
+        size_t current = row;
+        for (size_t i = 0; i < path.columns.size(); ++i) {
+            auto& table = *path.tables[i];
+            auto changes = info.tables.find(table.get_index_in_group());
+            // Nullified links are reported as modifications, so a modified
+            // link column covers the target being deleted too
+            if (changes && changes->modifications.contains(current))
+                return true;
+            if (i + 1 == path.columns.size() || table.is_null_link(path.columns[i], current))
+                break;
+            current = table.get_link(path.columns[i], current);
+        }
+    }
+    return false;
+}
+
+void SortKeyCache::update(TransactionChangeInfo const& info)
+{
+    if (m_rows.empty())
+        return;
+    if (info.changes_unknown || info.schema_changed) {
+        clear();
+        return;
+    }
+
+    auto changes = info.tables.find(m_paths.front().tables.front()->get_index_in_group());
+    size_t path_count = m_paths.size();
+    std::vector<std::pair<size_t, size_t>> rows; // new row index, old position
+    rows.reserve(m_rows.size());
+    for (size_t i = 0; i < m_rows.size(); ++i) {
+        size_t row = m_rows[i];
+        if (changes) {
+            if (changes->deletions.contains(row)) {
+                auto& moves = changes->moves;
+                auto it = std::lower_bound(moves.begin(), moves.end(), row,
+                                           [](auto const& a, auto b) { return a.from < b; });
+                if (it == moves.end() || it->from != row)
+                    continue;
+                row = it->to;
+            }
+            else {
+                row = changes->insertions.shift(changes->deletions.unshift(row));
+            }
+        }
+        if (!chain_modified(info, row))
+            rows.push_back({row, i});
+    }
+
+    // Moved rows may no longer be in order
+    std::sort(rows.begin(), rows.end());
+    std::vector<size_t> new_rows;
+    std::vector<Value> new_values;
+    new_rows.reserve(rows.size());
+    new_values.reserve(rows.size() * path_count);
+    for (auto& row : rows) {
+        new_rows.push_back(row.first);
+        auto values = m_values.begin() + row.second * path_count;
+        new_values.insert(new_values.end(), values, values + path_count);
+    }
+    m_rows = std::move(new_rows);
+    m_values = std::move(new_values);
+}
+
+bool SortKeyCache::read(Path const& path, size_t row, Value& value) const
+{
+    value = {};
+    for (size_t i = 0; i + 1 < path.columns.size(); ++i) {
+        if (path.tables[i]->is_null_link(path.columns[i], row)) {
+            value.null_link = true;
+            return true;
+        }
+        row = path.tables[i]->get_link(path.columns[i], row);
+    }
+
+    auto& table = *path.tables.back();
+    size_t col = path.columns.back();
+    if (table.is_nullable(col) && table.is_null(col, row)) {
+        value.null = true;
+        return true;
+    }
+    switch (path.type) {
+        case type_Int:
+            value.i = table.get_int(col, row);
+            break;
+        case type_Bool:
+            value.i = table.get_bool(col, row);
+            break;
+        case type_Float:
+        case type_Double:
+            value.d = path.type == type_Float ? table.get_float(col, row) : table.get_double(col, row);
+            if (std::isnan(value.d))
+                return false;
+            break;
+        case type_Timestamp: {
+            auto ts = table.get_timestamp(col, row);
+            value.i = ts.get_seconds();
+            value.nanoseconds = ts.get_nanoseconds();
+            break;
+        }
+        default:
+            REALM_UNREACHABLE();
+    }
+    return true;
+}
+
+int SortKeyCache::compare(size_t path, Value const& a, Value const& b) const
+{
+    // As with core's SortDescriptor, a null link anywhere along the key path
+    // sorts after everything else, even null values, when ascending, while
+    // null values sort before all other values
+    if (a.null_link || b.null_link)
+        return a.null_link == b.null_link ? 0 : a.null_link ? 1 : -1;
+    if (a.null || b.null)
+        return a.null == b.null ? 0 : a.null ? -1 : 1;
+    switch (m_paths[path].type) {
+        case type_Float:
+        case type_Double:
+            return a.d < b.d ? -1 : b.d < a.d;
+        case type_Timestamp:
+            if (a.i != b.i)
+                return a.i < b.i ? -1 : 1;
+            return a.nanoseconds < b.nanoseconds ? -1 : b.nanoseconds < a.nanoseconds;
+        default:
+            return a.i < b.i ? -1 : b.i < a.i;
+    }
+}
+
+bool SortKeyCache::is_sorted(std::vector<size_t> const& rows)
+{
+    size_t path_count = m_paths.size();
+    std::vector<size_t> new_rows = rows;
+    std::sort(new_rows.begin(), new_rows.end());
+
+    // Reuse the cached values for the rows which have them and read the rest
+    std::vector<Value> new_values(new_rows.size() * path_count);
+    auto cached = m_rows.begin();
+    for (size_t i = 0; i < new_rows.size(); ++i) {
+        cached = std::lower_bound(cached, m_rows.end(), new_rows[i]);
+        if (cached != m_rows.end() && *cached == new_rows[i]) {
+            auto values = m_values.begin() + (cached - m_rows.begin()) * path_count;
+            std::copy(values, values + path_count, new_values.begin() + i * path_count);
+            continue;
+        }
+        for (size_t j = 0; j < path_count; ++j) {
+            if (!read(m_paths[j], new_rows[i], new_values[i * path_count + j])) {
+                clear();
+                return false;
+            }
+        }
+    }
+    m_rows = std::move(new_rows);
+    m_values = std::move(new_values);
+
+    auto values_for = [&](size_t row) {
+        auto it = std::lower_bound(m_rows.begin(), m_rows.end(), row);
+        return &m_values[(it - m_rows.begin()) * path_count];
+    };
+    for (size_t i = 1; i < rows.size(); ++i) {
+        auto a = values_for(rows[i - 1]), b = values_for(rows[i]);
+        int cmp = 0;
+        for (size_t j = 0; j < path_count && cmp == 0; ++j) {
+            cmp = compare(j, a[j], b[j]);
+            if (!m_paths[j].ascending)
+                cmp = -cmp;
+        }
+        // Rows with equal keys stay in table order
+        if (cmp > 0 || (cmp == 0 && rows[i - 1] > rows[i]))
+            return false;
+    }
+    return true;
+}
+
+std::vector<size_t> SortKeyCache::first_columns() const
+{
+    std::vector<size_t> columns;
+    for (auto& path : m_paths)
+        columns.push_back(path.columns.front());
+    return columns;
+}
+
+size_t SortKeyCache::heap_size() const noexcept
+{
+    return m_rows.capacity() * sizeof(size_t) + m_values.capacity() * sizeof(Value);
+}
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_SORT_KEY_CACHE_HPP
+#define REALM_SORT_KEY_CACHE_HPP
+
+#include <realm/data_type.hpp>
+#include <realm/table_ref.hpp>
+#include <realm/util/optional.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace realm {
+namespace _impl {
+struct TransactionChangeInfo;
+
+// The values which a notifier's rows are sorted on, read by following the
+// links along each sort key path, cached for each row of the sorted table.
+// After each commit the cached rows are mapped to their new indices, and only
+// the keys of rows where one of the objects along a key path was modified
+// are discarded, so checking whether the sorted rows are still in order only
+// has to follow the links for those rows rather than for every row.
+class SortKeyCache {
+public:
+    // The column indices of a key path starting from the sorted table, and
+    // whether it's sorted in ascending order
+    struct KeyPath {
+        std::vector<size_t> columns;
+        bool ascending;
+    };
+
+    // Returns none if the key paths can't be compared here in the same way as
+    // core's SortDescriptor compares them
+    static util::Optional<SortKeyCache> make(Table const& table, std::vector<KeyPath> const& paths);
+
+    // Request the changes to every table along the key paths, which are
+    // needed by update()
+    void add_required_change_info(TransactionChangeInfo& info) const;
+    // Update the cached rows for the changes from a transaction
+    void update(TransactionChangeInfo const& info);
+    void clear() noexcept;
+
+    // Check if `rows` of the sorted table are in the order which sorting them
+    // would produce, with ties broken by table order, reading the keys which
+    // aren't cached. Afterwards only the keys for `rows` are cached.
+    bool is_sorted(std::vector<size_t> const& rows);
+
+    // The first column of each key path, which is in the sorted table
+    std::vector<size_t> first_columns() const;
+
+    size_t heap_size() const noexcept;
+
+private:
+    struct Path {
+        // The table containing each of the columns
+        std::vector<ConstTableRef> tables;
+        std::vector<size_t> columns;
+        DataType type;
+        bool ascending;
+    };
+    struct Value {
+        int64_t i = 0;
+        double d = 0;
+        int32_t nanoseconds = 0;
+        bool null = false;
+        // A null link somewhere along the key path, which core sorts
+        // differently from a null value
+        bool null_link = false;
+    };
+
+    std::vector<Path> m_paths;
+    // The cached rows sorted by row index, and their values for each path
+    std::vector<size_t> m_rows;
+    std::vector<Value> m_values;
+
+    bool chain_modified(TransactionChangeInfo const& info, size_t row) const;
+    // Returns false if the value can't be compared in the same way as core
+    bool read(Path const& path, size_t row, Value& value) const;
+    int compare(size_t path, Value const& a, Value const& b) const;
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_SORT_KEY_CACHE_HPP
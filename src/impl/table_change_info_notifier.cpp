@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#include "impl/table_change_info_notifier.hpp"
+
+#include <realm/group_shared.hpp>
+
+#include <algorithm>
+
+using namespace realm;
+using namespace realm::_impl;
+
+TableChangeInfoNotifier::TableChangeInfoNotifier(std::shared_ptr<Realm> realm, std::vector<size_t> table_indices,
+                                                 Callback callback)
+: CollectionNotifier(std::move(realm))
+, m_table_indices(std::move(table_indices))
+, m_callback(std::move(callback))
+{
+    std::sort(m_table_indices.begin(), m_table_indices.end());
+    m_table_indices.erase(std::unique(m_table_indices.begin(), m_table_indices.end()), m_table_indices.end());
+    m_changes.tables.reserve(m_table_indices.size());
+}
+
+bool TableChangeInfoNotifier::do_add_required_change_info(TransactionChangeInfo& info)
+{
+    m_info = &info;
+    for (auto table_ndx : m_table_indices)
+        info.table_modifications_needed.set(table_ndx);
+    return false;
+}
+
+void TableChangeInfoNotifier::run()
+{
+    REALM_ASSERT(m_sg);
+    m_changes.version = m_sg->get_version_of_current_transaction();
+    m_changes.changes_unknown = m_info->changes_unknown || m_info->schema_changed;
+    m_changes.tables.clear();
+    if (!m_changes.changes_unknown) {
+        for (auto table_ndx : m_table_indices) {
+            auto changes = m_info->tables.find(table_ndx);
+            if (changes && !changes->empty())
+                m_changes.tables.push_back({table_ndx, changes});
+        }
+        if (m_changes.tables.empty())
+            return;
+    }
+    m_callback(m_changes);
+    m_changes.tables.clear();
+}
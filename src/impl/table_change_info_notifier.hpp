@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef REALM_OS_TABLE_CHANGE_INFO_NOTIFIER_HPP
+#define REALM_OS_TABLE_CHANGE_INFO_NOTIFIER_HPP
+
+#include "impl/collection_notifier.hpp"
+
+namespace realm {
+namespace _impl {
+// The changes to a set of tables calculated by each notifier pass, passed on
+// to a callback on the notifier thread as they are, for feeding external
+// consumers such as search indexes. See RealmCoordinator::observe_table_changes().
+class TableChangeInfoNotifier : public CollectionNotifier {
+public:
+    struct Table {
+        size_t table_ndx;
+        CollectionChangeSet const* changes;
+    };
+    struct Changes {
+        // The version the changes advance the Realm to
+        VersionID version;
+        // Set if the changes weren't calculated, either because the commit
+        // was made in bulk-load mode or because the schema changed, in which
+        // case `tables` is empty and everything observed should be reread
+        bool changes_unknown;
+        // The observed tables which changed, in order of table index. The
+        // change sets are only valid for the duration of the callback.
+        std::vector<Table> tables;
+    };
+    using Callback = std::function<void(Changes const&)>;
+
+    TableChangeInfoNotifier(std::shared_ptr<Realm> realm, std::vector<size_t> table_indices, Callback callback);
+
+private:
+    std::vector<size_t> m_table_indices;
+    Callback m_callback;
+    // Reused for every run so that reporting changes doesn't allocate
+    Changes m_changes;
+
+    SharedGroup* m_sg = nullptr;
+    TransactionChangeInfo* m_info = nullptr;
+
+    void run() override;
+    const char* trace_name() const noexcept override { return "TableChangeInfoNotifier"; }
+
+    void do_prepare_handover(SharedGroup&) override { }
+    void do_attach_to(SharedGroup& sg) override { m_sg = &sg; }
+    void do_detach_from(SharedGroup&) override { m_sg = nullptr; }
+
+    void release_data() noexcept override { }
+    bool do_add_required_change_info(TransactionChangeInfo& info) override;
+};
+}
+}
+
+#endif // REALM_OS_TABLE_CHANGE_INFO_NOTIFIER_HPP
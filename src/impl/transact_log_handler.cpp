@@ -19,15 +19,20 @@
 #include "impl/transact_log_handler.hpp"
 
 #include "binding_context.hpp"
+#include "impl/change_journal.hpp"
 #include "impl/collection_notifier.hpp"
 #include "index_set.hpp"
 #include "shared_realm.hpp"
 
 #include <realm/group_shared.hpp>
+#include <realm/impl/input_stream.hpp>
+#include <realm/impl/transact_log.hpp>
 #include <realm/lang_bind_helper.hpp>
+#include <realm/replication.hpp>
 
 #include <algorithm>
 #include <numeric>
+#include <tuple>
 
 using namespace realm;
 
@@ -85,14 +90,9 @@ KVOAdapter::KVOAdapter(std::vector<BindingContext::ObserverState>& observers, Bi
         }
     }
 
-    auto max = std::max_element(begin(tables_needed), end(tables_needed));
-    if (*max >= table_modifications_needed.size())
-        table_modifications_needed.resize(*max + 1, false);
-    if (*max >= table_moves_needed.size())
-        table_moves_needed.resize(*max + 1, false);
     for (auto& tbl : tables_needed) {
-        table_modifications_needed[tbl] = true;
-        table_moves_needed[tbl] = true;
+        table_modifications_needed.set(tbl);
+        table_moves_needed.set(tbl);
     }
     for (auto& list : m_lists)
         lists.push_back({list.observer->table_ndx, list.observer->row_ndx, list.col, &list.builder});
@@ -336,6 +336,59 @@ struct TransactLogValidator : public TransactLogValidationMixin, public MarkDirt
     void mark_dirty(size_t, size_t) { }
 };
 
+// A transaction log handler which records which tables are modified, for
+// publishing to a ChangeJournal. Unlike the other handlers this is used on
+// the log for a commit being made by this process, which may include the
+// schema changes made by a migration, so those are recorded rather than
+// rejected.
+class TransactLogSummarizer : public TransactLogValidationMixin, public MarkDirtyMixin<TransactLogSummarizer> {
+    _impl::ChangeJournal::Summary& m_summary;
+
+    bool mark_table()
+    {
+        m_summary.add_table(current_table());
+        return true;
+    }
+
+    bool schema_changed()
+    {
+        m_summary.schema_changed = true;
+        return true;
+    }
+
+public:
+    TransactLogSummarizer(_impl::ChangeJournal::Summary& summary) : m_summary(summary) { }
+
+    void mark_dirty(size_t, size_t) { mark_table(); }
+
+    bool insert_group_level_table(size_t, size_t, StringData) { return schema_changed(); }
+    bool erase_group_level_table(size_t, size_t) { return schema_changed(); }
+    bool rename_group_level_table(size_t, StringData) { return schema_changed(); }
+    bool move_group_level_table(size_t, size_t) { return schema_changed(); }
+    bool insert_column(size_t, DataType, StringData, bool) { return schema_changed(); }
+    bool insert_link_column(size_t, DataType, StringData, size_t, size_t) { return schema_changed(); }
+    bool erase_column(size_t) { return schema_changed(); }
+    bool erase_link_column(size_t, size_t, size_t) { return schema_changed(); }
+    bool rename_column(size_t, StringData) { return schema_changed(); }
+    bool move_column(size_t, size_t) { return schema_changed(); }
+    bool set_link_type(size_t, LinkType) { return schema_changed(); }
+
+    bool insert_empty_rows(size_t, size_t, size_t, bool) { return mark_table(); }
+    bool add_row_with_key(size_t, size_t, size_t, int64_t) { return mark_table(); }
+    bool erase_rows(size_t, size_t, size_t, bool) { return mark_table(); }
+    bool swap_rows(size_t, size_t) { return mark_table(); }
+    bool move_row(size_t, size_t) { return mark_table(); }
+    bool merge_rows(size_t, size_t) { return mark_table(); }
+    bool clear_table(size_t=0) { return mark_table(); }
+    bool link_list_set(size_t, size_t, size_t) { return mark_table(); }
+    bool link_list_insert(size_t, size_t, size_t) { return mark_table(); }
+    bool link_list_erase(size_t, size_t) { return mark_table(); }
+    bool link_list_nullify(size_t, size_t) { return mark_table(); }
+    bool link_list_clear(size_t) { return mark_table(); }
+    bool link_list_move(size_t, size_t) { return mark_table(); }
+    bool link_list_swap(size_t, size_t) { return mark_table(); }
+};
+
 // Move the value at container[from] to container[to], shifting everything in
 // between, or do nothing if either are out of bounds
 template<typename Container>
@@ -405,15 +458,55 @@ class TransactLogObserver : public TransactLogValidationMixin, public MarkDirtyM
     bool m_need_move_info = false;
     bool m_is_top_level_table = true;
 
+    // The entries in m_info.lists sorted by (table, row, column, position),
+    // so that finding the list for a LinkList selection doesn't have to scan
+    // every observed list. Rebuilt on the next lookup after any of the
+    // observed positions change.
+    struct ListIndexEntry {
+        size_t table_ndx;
+        size_t row_ndx;
+        size_t col_ndx;
+        size_t list_ndx;
+    };
+    std::vector<ListIndexEntry> m_list_index;
+    bool m_list_index_valid = false;
+
+    static auto list_key(ListIndexEntry const& entry)
+    {
+        return std::tie(entry.table_ndx, entry.row_ndx, entry.col_ndx, entry.list_ndx);
+    }
+
+    void rebuild_list_index()
+    {
+        m_list_index.clear();
+        m_list_index.reserve(m_info.lists.size());
+        for (size_t i = 0; i < m_info.lists.size(); ++i) {
+            auto& list = m_info.lists[i];
+            m_list_index.push_back({list.table_ndx, list.row_ndx, list.col_ndx, i});
+        }
+        std::sort(begin(m_list_index), end(m_list_index),
+                  [](auto const& a, auto const& b) { return list_key(a) < list_key(b); });
+        m_list_index_valid = true;
+    }
+
     _impl::CollectionChangeBuilder* find_list(size_t tbl, size_t col, size_t row)
     {
+        if (m_info.lists.empty())
+            return nullptr;
+        if (!m_list_index_valid)
+            rebuild_list_index();
+
         // When there are multiple source versions there could be multiple
         // change objects for a single LinkView, in which case we need to use
         // the last one
-        for (auto it = m_info.lists.rbegin(), end = m_info.lists.rend(); it != end; ++it) {
-            if (it->table_ndx == tbl && it->row_ndx == row && it->col_ndx == col)
-                return it->changes;
-        }
+        ListIndexEntry key{tbl, row, col, npos};
+        auto it = std::upper_bound(begin(m_list_index), end(m_list_index), key,
+                                   [](auto const& a, auto const& b) { return list_key(a) < list_key(b); });
+        if (it == begin(m_list_index))
+            return nullptr;
+        --it;
+        if (it->table_ndx == tbl && it->row_ndx == row && it->col_ndx == col)
+            return m_info.lists[it->list_ndx].changes;
         return nullptr;
     }
 
@@ -430,7 +523,7 @@ public:
     void parse_complete()
     {
         for (auto& table : m_info.tables)
-            table.parse_complete();
+            table.changes->parse_complete();
         for (auto& list : m_info.lists)
             list.changes->clean_up_stale_moves();
     }
@@ -457,14 +550,11 @@ public:
         }
 
         auto tbl_ndx = current_table();
-        if (!m_info.track_all && (tbl_ndx >= m_info.table_modifications_needed.size() || !m_info.table_modifications_needed[tbl_ndx]))
+        if (!m_info.track_all && !m_info.table_modifications_needed[tbl_ndx])
             return true;
 
-        m_need_move_info = m_info.track_all || (tbl_ndx < m_info.table_moves_needed.size() &&
-                                                m_info.table_moves_needed[tbl_ndx]);
-        if (m_info.tables.size() <= tbl_ndx)
-            m_info.tables.resize(std::max(m_info.tables.size() * 2, tbl_ndx + 1));
-        m_active_table = &m_info.tables[tbl_ndx];
+        m_need_move_info = m_info.track_all || m_info.table_moves_needed[tbl_ndx];
+        m_active_table = &m_info.tables.get(tbl_ndx);
 
         if (len == 1) {
             // Mark the cell containing the subtable as modified since selecting
@@ -544,8 +634,10 @@ public:
         if (!m_is_top_level_table)
             return true;
         for (auto& list : m_info.lists) {
-            if (list.table_ndx == current_table() && list.row_ndx >= row_ndx)
+            if (list.table_ndx == current_table() && list.row_ndx >= row_ndx) {
                 list.row_ndx += num_rows_to_insert;
+                m_list_index_valid = false;
+            }
         }
         return true;
     }
@@ -577,10 +669,13 @@ public:
                 if (i + 1 < m_info.lists.size())
                     m_info.lists[i] = std::move(m_info.lists.back());
                 m_info.lists.pop_back();
+                m_list_index_valid = false;
                 continue;
             }
-            if (list.row_ndx == last_row)
+            if (list.row_ndx == last_row) {
                 list.row_ndx = row_ndx;
+                m_list_index_valid = false;
+            }
         }
 
         return true;
@@ -605,6 +700,9 @@ public:
                     list.row_ndx = row_ndx_2;
                 else if (list.row_ndx == row_ndx_2)
                     list.row_ndx = row_ndx_1;
+                else
+                    continue;
+                m_list_index_valid = false;
             }
         }
         return true;
@@ -626,8 +724,10 @@ public:
         if (!m_is_top_level_table)
             return true;
         for (auto& list : m_info.lists) {
-            if (list.table_ndx == current_table() && list.row_ndx == from)
+            if (list.table_ndx == current_table() && list.row_ndx == from) {
                 list.row_ndx = to;
+                m_list_index_valid = false;
+            }
         }
         return true;
     }
@@ -641,7 +741,10 @@ public:
             return true;
         auto it = remove_if(begin(m_info.lists), end(m_info.lists),
                             [&](auto const& lv) { return lv.table_ndx == tbl_ndx; });
-        m_info.lists.erase(it, end(m_info.lists));
+        if (it != end(m_info.lists)) {
+            m_info.lists.erase(it, end(m_info.lists));
+            m_list_index_valid = false;
+        }
         return true;
     }
 
@@ -657,6 +760,7 @@ public:
             if (list.table_ndx == current_table() && list.col_ndx >= ndx)
                 ++list.col_ndx;
         }
+        m_list_index_valid = false;
         if (m_info.column_indices.size() <= current_table())
             m_info.column_indices.resize(current_table() + 1);
         auto& indices = m_info.column_indices[current_table()];
@@ -682,11 +786,12 @@ public:
             if (list.table_ndx >= ndx)
                 ++list.table_ndx;
         }
+        m_list_index_valid = false;
         prepare_table_indices();
         adjust_ge(m_info.table_indices, ndx);
-        insert_empty_at(m_info.tables, ndx);
-        insert_empty_at(m_info.table_moves_needed, ndx);
-        insert_empty_at(m_info.table_modifications_needed, ndx);
+        m_info.tables.insert_table(ndx);
+        m_info.table_moves_needed.insert(ndx);
+        m_info.table_modifications_needed.insert(ndx);
         return true;
     }
 
@@ -702,6 +807,7 @@ public:
             if (list.table_ndx == current_table())
                 adjust_for_move(list.col_ndx, from, to);
         }
+        m_list_index_valid = false;
         if (m_info.column_indices.size() <= current_table())
             m_info.column_indices.resize(current_table() + 1);
         expand_to(m_info.column_indices[current_table()], std::max(from, to) + 1);
@@ -715,12 +821,13 @@ public:
 
         for (auto& list : m_info.lists)
             adjust_for_move(list.table_ndx, from, to);
+        m_list_index_valid = false;
 
         prepare_table_indices();
         adjust_for_move(m_info.table_indices, from, to);
-        rotate(m_info.tables, from, to);
-        rotate(m_info.table_modifications_needed, from, to);
-        rotate(m_info.table_moves_needed, from, to);
+        m_info.tables.move_table(from, to);
+        m_info.table_modifications_needed.move(from, to);
+        m_info.table_moves_needed.move(from, to);
         return true;
     }
 
@@ -731,22 +838,33 @@ class KVOTransactLogObserver : public TransactLogObserver {
     KVOAdapter m_adapter;
     _impl::NotifierPackage& m_notifiers;
     SharedGroup& m_sg;
+    _impl::TransactionChangeInfo* m_changes;
 
 public:
     KVOTransactLogObserver(std::vector<BindingContext::ObserverState>& observers,
                            BindingContext* context,
                            _impl::NotifierPackage& notifiers,
-                           SharedGroup& sg)
+                           SharedGroup& sg,
+                           _impl::TransactionChangeInfo* changes)
     : TransactLogObserver(m_adapter)
     , m_adapter(observers, context)
     , m_notifiers(notifiers)
     , m_sg(sg)
+    , m_changes(changes)
     {
+        // Tracking everything reports the same changes for the observed
+        // tables, as the adapter already tracks moves for them
+        if (m_changes)
+            m_adapter.track_all = true;
     }
 
     ~KVOTransactLogObserver()
     {
         m_adapter.after(m_sg);
+        if (m_changes) {
+            m_changes->tables = std::move(m_adapter.tables);
+            m_changes->schema_changed = m_adapter.schema_changed;
+        }
     }
 
     void parse_complete()
@@ -762,7 +880,8 @@ public:
 
 template<typename Func>
 void advance_with_notifications(BindingContext* context, const std::unique_ptr<SharedGroup>& sg,
-                                Func&& func, _impl::NotifierPackage& notifiers)
+                                Func&& func, _impl::NotifierPackage& notifiers,
+                                _impl::TransactionChangeInfo* changes = nullptr)
 {
     auto old_version = sg->get_version_of_current_transaction();
     std::vector<BindingContext::ObserverState> observers;
@@ -775,7 +894,10 @@ void advance_with_notifications(BindingContext* context, const std::unique_ptr<S
     // version we're going to before we actually advance to that version
     if (observers.empty() && (!notifiers || notifiers.version())) {
         notifiers.before_advance();
-        func(TransactLogValidator());
+        if (changes)
+            func(TransactLogObserver(*changes));
+        else
+            func(TransactLogValidator());
         auto new_version = sg->get_version_of_current_transaction();
         if (context && old_version != new_version)
             context->did_change({}, {});
@@ -797,7 +919,7 @@ void advance_with_notifications(BindingContext* context, const std::unique_ptr<S
 
     if (context)
         context->will_send_notifications();
-    func(KVOTransactLogObserver(observers, context, notifiers, *sg));
+    func(KVOTransactLogObserver(observers, context, notifiers, *sg, changes));
     notifiers.package_and_wait(sg->get_version_of_current_transaction().version); // is a no-op if parse_complete() was called
     notifiers.deliver(*sg);
     notifiers.after_advance();
@@ -821,11 +943,12 @@ void advance(SharedGroup& sg, BindingContext*, VersionID version)
     LangBindHelper::advance_read(sg, TransactLogValidator(), version);
 }
 
-void advance(const std::unique_ptr<SharedGroup>& sg, BindingContext* context, NotifierPackage& notifiers)
+void advance(const std::unique_ptr<SharedGroup>& sg, BindingContext* context, NotifierPackage& notifiers,
+             TransactionChangeInfo* changes)
 {
     advance_with_notifications(context, sg, [&](auto&&... args) {
         LangBindHelper::advance_read(*sg, std::move(args)..., notifiers.version().value_or(VersionID{}));
-    }, notifiers);
+    }, notifiers, changes);
 }
 
 void begin_without_validation(SharedGroup& sg)
@@ -845,6 +968,19 @@ void commit(SharedGroup& sg)
     LangBindHelper::commit_and_continue_as_read(sg);
 }
 
+void commit(SharedGroup& sg, Replication& history, ChangeJournal& journal)
+{
+    // The uncommitted changes are only valid until the commit begins
+    ChangeJournal::Summary summary;
+    BinaryData changes = history.get_uncommitted_changes();
+    _impl::SimpleInputStream in(changes.data(), changes.size());
+    TransactLogSummarizer summarizer(summary);
+    _impl::TransactLogParser().parse(in, summarizer);
+
+    LangBindHelper::commit_and_continue_as_read(sg);
+    journal.publish(sg.get_version_of_current_transaction().version, summary);
+}
+
 void cancel(SharedGroup& sg, BindingContext* context)
 {
     std::vector<BindingContext::ObserverState> observers;
@@ -870,6 +1006,155 @@ void advance(SharedGroup& sg, TransactionChangeInfo& info, VersionID version)
     }
 }
 
+struct ChangesetCache::Entry {
+    uint_fast64_t from_version;
+    uint_fast64_t to_version;
+    bool track_all;
+    TableBitset table_modifications_needed;
+    TableBitset table_moves_needed;
+    TableChanges tables;
+
+    // Check if these changes include everything needed by `info`, and nothing
+    // which would not have been calculated for it
+    bool can_be_used_for(TransactionChangeInfo const& info) const
+    {
+        if (info.track_all)
+            return track_all;
+        for (size_t i = 0; i < info.table_modifications_needed.size(); ++i) {
+            if (!info.table_modifications_needed[i])
+                continue;
+            if (!track_all && !table_modifications_needed[i])
+                return false;
+            // Tracking moves changes how some operations are reported, so
+            // this has to match exactly
+            if ((track_all || table_moves_needed[i]) != info.table_moves_needed[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+// Only the most recent few version ranges are likely to be advanced over
+// again, and the changes for a large transaction can be quite large
+static const size_t max_cached_changesets = 4;
+
+std::shared_ptr<const ChangesetCache::Entry>
+ChangesetCache::find(uint_fast64_t from, uint_fast64_t to, TransactionChangeInfo const& info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_entries) {
+        if (entry->from_version == from && entry->to_version == to && entry->can_be_used_for(info))
+            return entry;
+    }
+    return nullptr;
+}
+
+void ChangesetCache::add(uint_fast64_t from, uint_fast64_t to, TransactionChangeInfo const& info)
+{
+    auto entry = std::make_shared<Entry>(Entry{from, to, info.track_all, info.table_modifications_needed,
+                                               info.table_moves_needed, info.tables});
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() >= max_cached_changesets)
+        m_entries.erase(m_entries.begin());
+    m_entries.push_back(std::move(entry));
+}
+
+void ChangesetCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+// Forgetting about an untracked version just means that advancing over it
+// calculates the changes after all, so only the most recent few are kept
+static const size_t max_untracked_versions = 16;
+
+void ChangesetCache::add_untracked_version(uint_fast64_t version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_untracked_versions.size() >= max_untracked_versions)
+        m_untracked_versions.erase(m_untracked_versions.begin());
+    m_untracked_versions.push_back(version);
+}
+
+bool ChangesetCache::is_untracked(uint_fast64_t from, VersionID to)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Versions are only recorded once they've been committed, so advancing
+    // to the latest version always includes all of them
+    auto it = std::upper_bound(m_untracked_versions.begin(), m_untracked_versions.end(), from);
+    return it != m_untracked_versions.end() && (to == VersionID{} || *it <= to.version);
+}
+
+bool ChangesetCache::journal_says_unchanged(SharedGroup& sg, TransactionChangeInfo const& info, uint_fast64_t to)
+{
+    if (info.track_all)
+        return false;
+
+    ChangeJournal::Summary needed;
+    auto add_all = [&](TableBitset const& tables) {
+        for (size_t i = 0; i < tables.size(); ++i) {
+            if (tables[i])
+                needed.add_table(i);
+        }
+    };
+    add_all(info.table_modifications_needed);
+    add_all(info.table_moves_needed);
+    for (auto& list : info.lists)
+        needed.add_table(list.table_ndx);
+    return m_journal->unchanged(sg.get_version_of_current_transaction().version, to, needed);
+}
+
+void ChangesetCache::advance(SharedGroup& sg, TransactionChangeInfo& info, VersionID version)
+{
+    if (is_untracked(sg.get_version_of_current_transaction().version, version)) {
+        LangBindHelper::advance_read(sg, version);
+        info.changes_unknown = true;
+        return;
+    }
+
+    if (m_journal && version != VersionID{} && journal_says_unchanged(sg, info, version.version)) {
+        // As with cached changes, the SharedGroup still has to read the log,
+        // but the changes don't need to be observed as there aren't any
+        LangBindHelper::advance_read(sg, version);
+        return;
+    }
+
+    // LinkList changes are tracked per accessor rather than per table, and the
+    // cache can only hold changes not already merged with an earlier range,
+    // so these cases always have to parse the transaction log themselves
+    bool cacheable = info.lists.empty() && info.tables.empty();
+    if (!cacheable || (!info.track_all && info.table_modifications_needed.empty())) {
+        transaction::advance(sg, info, version);
+        return;
+    }
+
+    auto from = sg.get_version_of_current_transaction().version;
+    if (version != VersionID{}) {
+        if (version.version == from) {
+            transaction::advance(sg, info, version);
+            return;
+        }
+        if (auto entry = find(from, version.version, info)) {
+            // The SharedGroup still has to read the log to update its
+            // accessors, but there's no need to observe it
+            LangBindHelper::advance_read(sg, version);
+            for (auto& table : entry->tables) {
+                if (info.track_all || info.table_modifications_needed[table.table_ndx])
+                    info.tables.get(table.table_ndx) = *table.changes;
+            }
+            return;
+        }
+    }
+
+    transaction::advance(sg, info, version);
+    auto to = sg.get_version_of_current_transaction().version;
+    // Schema changes update index mappings which are cumulative over
+    // multiple ranges, so there's nothing reusable to cache
+    if (to != from && !info.schema_changed)
+        add(from, to, info);
+}
+
 } // namespace transaction
 } // namespace _impl
 } // namespace realm
@@ -22,14 +22,18 @@
 #include <cstdint>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <realm/version_id.hpp>
 
 namespace realm {
 class BindingContext;
+class Replication;
 class SharedGroup;
 
 namespace _impl {
+class ChangeJournal;
 class NotifierPackage;
 struct TransactionChangeInfo;
 
@@ -40,7 +44,9 @@ struct UnsupportedSchemaChange : std::logic_error {
 namespace transaction {
 // Advance the read transaction version, with change notifications sent to delegate
 // Must not be called from within a write transaction.
-void advance(const std::unique_ptr<SharedGroup>& sg, BindingContext* binding_context, NotifierPackage&);
+// If `changes` is given, the changes to every table are also calculated in it.
+void advance(const std::unique_ptr<SharedGroup>& sg, BindingContext* binding_context, NotifierPackage&,
+             TransactionChangeInfo* changes = nullptr);
 void advance(SharedGroup& sg, BindingContext* binding_context, VersionID);
 
 // Begin a write transaction
@@ -51,6 +57,9 @@ void begin_without_validation(SharedGroup& sg);
 
 // Commit a write transaction
 void commit(SharedGroup& sg);
+// Commit a write transaction and publish the tables it modified to `journal`.
+// `history` must be the Replication which `sg` was opened with.
+void commit(SharedGroup& sg, Replication& history, ChangeJournal& journal);
 
 // Cancel a write transaction and roll back all changes, with change notifications
 // for reverting to the old values sent to delegate
@@ -58,6 +67,44 @@ void cancel(SharedGroup& sg, BindingContext* binding_context);
 
 // Advance the read transaction version, with change information gathered in info
 void advance(SharedGroup& sg, TransactionChangeInfo& info, VersionID version=VersionID{});
+
+// The table changes calculated while advancing over recent version ranges, so
+// that multiple SharedGroups advancing over the same range only have to
+// calculate them once. Safe to use from multiple threads at once.
+class ChangesetCache {
+public:
+    // Advance the read transaction version as with advance() above, reusing
+    // the cached changes for the version range if they're suitable for `info`
+    // and caching the newly calculated changes if not
+    void advance(SharedGroup& sg, TransactionChangeInfo& info, VersionID version=VersionID{});
+
+    void clear();
+
+    // Record that the commit which produced `version` should not have its
+    // changes calculated, so that advancing over it sets
+    // TransactionChangeInfo::changes_unknown rather than observing the
+    // transaction log
+    void add_untracked_version(uint_fast64_t version);
+
+    // Skip observing the transaction logs when advancing over commits which
+    // `journal` says didn't modify anything the change info needs. The
+    // journal must outlive the cache or be unset first.
+    void set_journal(ChangeJournal* journal) { m_journal = journal; }
+
+private:
+    struct Entry;
+    ChangeJournal* m_journal = nullptr;
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<const Entry>> m_entries;
+    // The most recent untracked versions, in ascending order
+    std::vector<uint_fast64_t> m_untracked_versions;
+
+    bool is_untracked(uint_fast64_t from, VersionID to);
+    bool journal_says_unchanged(SharedGroup& sg, TransactionChangeInfo const& info, uint_fast64_t to);
+
+    std::shared_ptr<const Entry> find(uint_fast64_t from, uint_fast64_t to, TransactionChangeInfo const& info);
+    void add(uint_fast64_t from, uint_fast64_t to, TransactionChangeInfo const& info);
+};
 } // namespace transaction
 } // namespace _impl
 } // namespace realm
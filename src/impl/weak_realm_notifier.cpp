@@ -20,6 +20,7 @@
 
 #include "shared_realm.hpp"
 #include "util/event_loop_signal.hpp"
+#include "util/executor.hpp"
 
 using namespace realm;
 using namespace realm::_impl;
@@ -30,8 +31,12 @@ WeakRealmNotifier::WeakRealmNotifier(const std::shared_ptr<Realm>& realm, bool c
 , m_execution_context(realm->config().execution_context)
 , m_realm_key(realm.get())
 , m_cache(cache)
-, m_signal(std::make_shared<util::EventLoopSignal<Callback>>(Callback{realm}))
+, m_executor(realm->config().notification_executor)
 {
+    if (m_executor)
+        m_task_pending = std::make_shared<std::atomic<bool>>(false);
+    else
+        m_signal = std::make_shared<util::EventLoopSignal<Callback>>(Callback{realm});
 }
 
 WeakRealmNotifier::~WeakRealmNotifier() = default;
@@ -45,5 +50,15 @@ void WeakRealmNotifier::Callback::operator()() const
 
 void WeakRealmNotifier::notify()
 {
-    m_signal->notify();
+    if (!m_executor) {
+        m_signal->notify();
+        return;
+    }
+
+    if (m_task_pending->exchange(true))
+        return;
+    m_executor->post([callback = Callback{m_realm}, pending = m_task_pending] {
+        *pending = false;
+        callback();
+    });
 }
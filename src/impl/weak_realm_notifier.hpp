@@ -21,6 +21,7 @@
 
 #include "execution_context_id.hpp"
 
+#include <atomic>
 #include <memory>
 #include <thread>
 
@@ -29,6 +30,7 @@ class Realm;
 
 namespace util {
 template<typename> class EventLoopSignal;
+class Executor;
 }
 
 namespace _impl {
@@ -51,6 +53,11 @@ public:
         return m_cache && m_execution_context == execution_context;
     }
 
+    // The execution context the Realm was opened in
+    AnyExecutionContextID const& execution_context() const { return m_execution_context; }
+    // Should the Realm instance be reused for further opens in its execution context?
+    bool is_cached() const { return m_cache; }
+
     // Has the Realm instance been destroyed?
     bool expired() const { return m_realm.expired(); }
 
@@ -70,6 +77,12 @@ private:
         void operator()() const;
     };
     std::shared_ptr<util::EventLoopSignal<Callback>> m_signal;
+
+    // Used instead of m_signal if the Realm has a notification executor, along
+    // with a flag to coalesce notifications which arrive before the previous
+    // task has run, as the event loop signals do
+    std::shared_ptr<util::Executor> m_executor;
+    std::shared_ptr<std::atomic<bool>> m_task_pending;
 };
 
 } // namespace _impl
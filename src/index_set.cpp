@@ -200,9 +200,9 @@ public:
     ChunkedRangeVectorBuilder(ChunkedRangeVector const& expected);
     void push_back(size_t index);
     void push_back(std::pair<size_t, size_t> range);
-    std::vector<ChunkedRangeVector::Chunk> finalize();
+    decltype(ChunkedRangeVector::m_data) finalize();
 private:
-    std::vector<ChunkedRangeVector::Chunk> m_data;
+    decltype(ChunkedRangeVector::m_data) m_data;
     size_t m_outer_pos = 0;
 };
 
@@ -241,7 +241,7 @@ void ChunkedRangeVectorBuilder::push_back(std::pair<size_t, size_t> range)
         chunk.end = chunk.data.back().second;
         ++m_outer_pos;
         if (m_outer_pos >= m_data.size())
-            m_data.push_back({{range}, range.first, 0, 1});
+            m_data.push_back({{range}, range.first, 0, range.second - range.first});
         else {
             auto& chunk = m_data[m_outer_pos];
             chunk.data.push_back(range);
@@ -251,7 +251,7 @@ void ChunkedRangeVectorBuilder::push_back(std::pair<size_t, size_t> range)
     }
 }
 
-std::vector<ChunkedRangeVector::Chunk> ChunkedRangeVectorBuilder::finalize()
+decltype(ChunkedRangeVector::m_data) ChunkedRangeVectorBuilder::finalize()
 {
     if (!m_data.empty()) {
         m_data.resize(m_outer_pos + 1);
@@ -327,8 +327,10 @@ IndexSet::iterator IndexSet::find(size_t index) noexcept
 
 IndexSet::iterator IndexSet::find(size_t index, iterator begin) noexcept
 {
-    auto it = std::find_if(begin.outer(), m_data.end(),
-                           [&](auto const& lft) { return lft.end > index; });
+    // Chunks are sorted and non-overlapping, so the chunk summaries can be
+    // binary searched rather than walking every chunk before the target
+    auto it = std::partition_point(begin.outer(), m_data.end(),
+                                   [&](auto const& lft) { return lft.end <= index; });
     if (it == m_data.end())
         return end();
     if (index < it->begin)
@@ -345,15 +347,82 @@ IndexSet::iterator IndexSet::find(size_t index, iterator begin) noexcept
 
 void IndexSet::add(size_t index)
 {
-    do_add(find(index), index);
+    // Change sets are mostly built in row order, so appending after the last
+    // range is the common case and doesn't need to search for the position
+    if (!empty() && index >= m_data.back().end)
+        do_add(end(), index);
+    else
+        do_add(find(index), index);
+}
+
+void IndexSet::add_range(size_t begin, size_t end)
+{
+    if (begin >= end)
+        return;
+    if (empty() || begin > m_data.back().end) {
+        push_back({begin, end});
+        return;
+    }
+    if (begin == m_data.back().end) {
+        std::prev(this->end()).adjust(0, end - begin);
+        return;
+    }
+    for (size_t i = begin; i < end; ++i)
+        add(i);
 }
 
 void IndexSet::add(IndexSet const& other)
 {
-    auto it = begin();
-    for (size_t index : other.as_indexes()) {
-        it = do_add(find(index, it), index);
+    if (other.empty())
+        return;
+    if (empty()) {
+        *this = other;
+        return;
     }
+
+    // Adding a handful of indexes to a large set is cheaper to do in place
+    // than by rebuilding the whole set
+    size_t other_count = 0, range_count = 0;
+    for (auto const& chunk : other.m_data)
+        other_count += chunk.count;
+    for (auto const& chunk : m_data)
+        range_count += chunk.data.size();
+    if (other_count * 8 < range_count) {
+        auto it = begin();
+        for (size_t index : other.as_indexes()) {
+            it = do_add(find(index, it), index);
+        }
+        return;
+    }
+
+    // Otherwise merge the two sorted lists of ranges, which is linear in the
+    // number of ranges rather than in the number of indexes being added
+    ChunkedRangeVectorBuilder builder(*this);
+    value_type current = {0, 0};
+    auto append = [&](value_type range) {
+        if (current.first == current.second) {
+            current = range;
+        }
+        else if (range.first <= current.second) {
+            current.second = std::max(current.second, range.second);
+        }
+        else {
+            builder.push_back(current);
+            current = range;
+        }
+    };
+
+    auto it1 = cbegin(), end1 = cend();
+    auto it2 = other.cbegin(), end2 = other.cend();
+    while (it1 != end1 || it2 != end2) {
+        if (it2 == end2 || (it1 != end1 && it1->first < it2->first))
+            append(*it1++);
+        else
+            append(*it2++);
+    }
+    builder.push_back(current);
+    m_data = builder.finalize();
+    verify();
 }
 
 size_t IndexSet::add_shifted(size_t index)
@@ -655,12 +724,15 @@ void IndexSet::remove(realm::IndexSet const& values)
 
 size_t IndexSet::shift(size_t index) const noexcept
 {
-    // FIXME: optimize
-    for (auto range : *this) {
-        if (range.first > index)
-            break;
-        index += range.second - range.first;
-    }
+    auto it = cbegin(), end = cend();
+
+    // Every range in a chunk which ends before the index shifts it, so those
+    // can be skipped using the chunk's count
+    for (; it != end && it.outer()->end <= index; it.next_chunk())
+        index += it.outer()->count;
+
+    for (; it != end && it->first <= index; ++it)
+        index += it->second - it->first;
     return index;
 }
 
@@ -19,6 +19,8 @@
 #ifndef REALM_INDEX_SET_HPP
 #define REALM_INDEX_SET_HPP
 
+#include "util/small_vector.hpp"
+
 #include <cstddef>
 #include <initializer_list>
 #include <iterator>
@@ -86,14 +88,17 @@ public:
 };
 
 // A vector which stores ranges in chunks with a maximum size
+//
+// Most index sets contain only a few ranges, so the first chunk and its first
+// few ranges are stored inline and small sets never need to allocate.
 struct ChunkedRangeVector {
     struct Chunk {
-        std::vector<std::pair<size_t, size_t>> data;
+        util::SmallVector<std::pair<size_t, size_t>, 2> data;
         size_t begin;
         size_t end;
         size_t count;
     };
-    std::vector<Chunk> m_data;
+    util::SmallVector<Chunk, 1> m_data;
 
     using value_type = std::pair<size_t, size_t>;
     using iterator = MutableChunkedRangeVectorIterator<typename decltype(m_data)::iterator>;
@@ -114,6 +119,23 @@ struct ChunkedRangeVector {
 
     bool empty() const noexcept { return m_data.empty(); }
 
+    // The number of bytes allocated outside of the inline storage
+    size_t heap_size() const noexcept
+    {
+        size_t size = m_data.heap_size();
+        for (auto& chunk : m_data)
+            size += chunk.data.heap_size();
+        return size;
+    }
+
+    // Release unused capacity in the chunks and the list of chunks
+    void shrink_to_fit()
+    {
+        for (auto& chunk : m_data)
+            chunk.data.shrink_to_fit();
+        m_data.shrink_to_fit();
+    }
+
     iterator insert(iterator pos, value_type value);
     iterator erase(iterator pos) noexcept;
     void push_back(value_type value);
@@ -133,6 +155,8 @@ public:
     using ChunkedRangeVector::begin;
     using ChunkedRangeVector::end;
     using ChunkedRangeVector::empty;
+    using ChunkedRangeVector::heap_size;
+    using ChunkedRangeVector::shrink_to_fit;
     using ChunkedRangeVector::verify;
 
     IndexSet() = default;
@@ -147,6 +171,9 @@ public:
     // Add an index to the set, doing nothing if it's already present
     void add(size_t index);
     void add(IndexSet const& is);
+    // Add each index in [begin, end), which is fast if the range is after
+    // every index already in the set
+    void add_range(size_t begin, size_t end);
 
     // Add an index which has had all of the ranges in the set before it removed
     // Returns the unshifted index
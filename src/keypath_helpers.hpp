@@ -22,6 +22,11 @@
 
 #include <realm/parser/keypath_mapping.hpp>
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace realm {
 /// Create the mappings from user defined names of linkingObjects into the verbose
 /// syntax that the parser supports: @links.Class.property.
@@ -92,4 +97,71 @@ inline IncludeDescriptor generate_include_from_keypaths(std::vector<StringData>
     }
     return IncludeDescriptor{*base_table, properties};
 }
+
+namespace _impl {
+// The backlink aliases and INCLUDE descriptors for a Realm's current schema,
+// which are created on first use and then kept on the Realm until the schema
+// changes or the Realm is invalidated
+class KeyPathMappingCache {
+public:
+    static KeyPathMappingCache& get(Realm& realm)
+    {
+        auto lock = KeyPathMappingCache::lock(realm);
+        return get(realm, lock);
+    }
+
+    // Frozen Realms may be used from several threads at once, so the cache
+    // for one must only be created or modified while holding this lock
+    static std::unique_lock<std::mutex> lock(Realm& realm)
+    {
+        return Realm::Internal::lock_if_frozen(realm);
+    }
+
+    // Get the cache while holding the lock returned by lock()
+    static KeyPathMappingCache& get(Realm& realm, std::unique_lock<std::mutex> const&)
+    {
+        auto& cache = Realm::Internal::get_keypath_mapping_cache(realm);
+        if (!cache) {
+            cache.reset(new KeyPathMappingCache);
+            alias_backlinks(cache->mapping, realm);
+        }
+        return *cache;
+    }
+
+    parser::KeyPathMapping mapping;
+    // Keyed by object type and the list of key paths
+    std::map<std::pair<std::string, std::vector<std::string>>, IncludeDescriptor> includes;
+};
+} // namespace _impl
+
+/// Get a mapping populated by alias_backlinks() for the Realm's current schema.
+/// The mapping is only built the first time it's requested for each schema,
+/// and is shared by every caller, so it must be copied if other mappings are
+/// needed.
+inline parser::KeyPathMapping const& backlink_mapping_for(Realm& realm)
+{
+    return _impl::KeyPathMappingCache::get(realm).mapping;
+}
+
+/// Generate an IncludeDescriptor from a list of key paths using the mapping from
+/// backlink_mapping_for(). The descriptor for each list of key paths is
+/// generated once and then reused until the Realm's schema changes.
+inline IncludeDescriptor include_for_keypaths(std::vector<StringData> const& paths,
+                                              Realm& realm, ObjectSchema const& object_schema)
+{
+    auto lock = _impl::KeyPathMappingCache::lock(realm);
+    auto& cache = _impl::KeyPathMappingCache::get(realm, lock);
+    std::pair<std::string, std::vector<std::string>> key;
+    key.first = object_schema.name;
+    key.second.reserve(paths.size());
+    for (auto& path : paths)
+        key.second.push_back(path);
+
+    auto it = cache.includes.find(key);
+    if (it == cache.includes.end()) {
+        auto include = generate_include_from_keypaths(paths, realm, object_schema, cache.mapping);
+        it = cache.includes.emplace(std::move(key), std::move(include)).first;
+    }
+    return it->second;
+}
 }
@@ -181,6 +181,22 @@ T List::get(size_t row_ndx) const
 
 template RowExpr List::get(size_t) const;
 
+template<typename T>
+size_t List::read_into(T* out, size_t count, size_t offset) const
+{
+    verify_attached();
+    if (m_link_view)
+        throw std::logic_error("read_into() can only be used on Lists of primitives.");
+    size_t size = m_table->size();
+    if (offset > size)
+        throw OutOfBoundsIndexException{offset, size + 1};
+
+    count = std::min(count, size - offset);
+    for (size_t i = 0; i < count; ++i)
+        out[i] = m_table->get<T>(0, offset + i);
+    return count;
+}
+
 template<typename T>
 size_t List::find(T const& value) const
 {
@@ -264,6 +280,83 @@ void List::insert(size_t row_ndx, RowExpr row)
     insert(row_ndx, row.get_index());
 }
 
+template<typename T>
+void List::insert_range(size_t row_ndx, T const* begin, T const* end)
+{
+    verify_in_transaction();
+    verify_valid_row(row_ndx, true);
+    if (begin == end)
+        return;
+    m_table->insert_empty_row(row_ndx, end - begin);
+    for (auto it = begin; it != end; ++it)
+        m_table->set(0, row_ndx++, *it);
+}
+
+template<>
+void List::insert_range(size_t row_ndx, size_t const* begin, size_t const* end)
+{
+    verify_in_transaction();
+    verify_valid_row(row_ndx, true);
+    for (auto it = begin; it != end; ++it)
+        m_link_view->insert(row_ndx++, *it);
+}
+
+template<>
+void List::insert_range(size_t row_ndx, RowExpr const* begin, RowExpr const* end)
+{
+    verify_in_transaction();
+    verify_valid_row(row_ndx, true);
+    for (auto it = begin; it != end; ++it)
+        validate(*it);
+    for (auto it = begin; it != end; ++it)
+        m_link_view->insert(row_ndx++, it->get_index());
+}
+
+void List::add_all(Results& results)
+{
+    verify_in_transaction();
+    if (!m_link_view)
+        throw std::logic_error("Only Lists of objects can have Results added to them.");
+
+    // Read all of the rows before adding any so that adding to a Results
+    // which is derived from this List is well-defined
+    auto tv = results.get_tableview();
+    std::vector<size_t> rows;
+    rows.reserve(tv.size());
+    for (size_t i = 0; i < tv.size(); ++i) {
+        if (!tv.is_row_attached(i))
+            throw std::invalid_argument("Object has been deleted or invalidated");
+        rows.push_back(tv.get_source_ndx(i));
+    }
+    if (rows.empty())
+        return;
+    validate(tv.get(0));
+
+    for (auto row : rows)
+        m_link_view->add(row);
+}
+
+void List::remove_range(size_t begin, size_t end)
+{
+    verify_in_transaction();
+    size_t s = size();
+    if (end > s)
+        throw OutOfBoundsIndexException{end, s + 1};
+    if (begin > end)
+        throw OutOfBoundsIndexException{begin, end + 1};
+    if (begin == 0 && end == s) {
+        remove_all();
+        return;
+    }
+
+    for (size_t i = end; i > begin; --i) {
+        if (m_link_view)
+            m_link_view->remove(i - 1);
+        else
+            m_table->remove(i - 1);
+    }
+}
+
 void List::move(size_t source_ndx, size_t dest_ndx)
 {
     verify_in_transaction();
@@ -385,26 +478,34 @@ Results List::snapshot() const
     return as_results().snapshot();
 }
 
+Results& List::aggregate_results()
+{
+    verify_attached();
+    if (!m_aggregate_results)
+        m_aggregate_results = std::make_shared<Results>(as_results());
+    return *m_aggregate_results;
+}
+
 util::Optional<Mixed> List::max(size_t column)
 {
-    return as_results().max(column);
+    return aggregate_results().max(column);
 }
 
 util::Optional<Mixed> List::min(size_t column)
 {
-    return as_results().min(column);
+    return aggregate_results().min(column);
 }
 
 Mixed List::sum(size_t column)
 {
     // Results::sum() returns none only for Mode::Empty Results, so we can
     // safely ignore that possibility here
-    return *as_results().sum(column);
+    return *aggregate_results().sum(column);
 }
 
 util::Optional<double> List::average(size_t column)
 {
-    return as_results().average(column);
+    return aggregate_results().average(column);
 }
 
 // These definitions rely on that LinkViews and Tables are interned by core
@@ -416,6 +517,8 @@ bool List::operator==(List const& rgt) const noexcept
 NotificationToken List::add_notification_callback(CollectionChangeCallback cb) &
 {
     verify_attached();
+    if (m_realm->is_frozen())
+        throw InvalidTransactionException("Cannot register notification callbacks for frozen Realms");
     // Adding a new callback to a notifier which had all of its callbacks
     // removed does not properly reinitialize the notifier. Work around this by
     // recreating it instead.
@@ -434,6 +537,22 @@ NotificationToken List::add_notification_callback(CollectionChangeCallback cb) &
     return {m_notifier, m_notifier->add_callback(std::move(cb))};
 }
 
+NotificationToken List::add_value_diff_notification_callback(CollectionChangeCallback cb) &
+{
+    verify_attached();
+    if (m_realm->is_frozen())
+        throw InvalidTransactionException("Cannot register notification callbacks for frozen Realms");
+    if (get_type() == PropertyType::Object)
+        throw std::logic_error("Value-diffing notifications are only supported for Lists of primitives.");
+    if (m_value_diff_notifier && !m_value_diff_notifier->have_callbacks())
+        m_value_diff_notifier.reset();
+    if (!m_value_diff_notifier) {
+        m_value_diff_notifier = std::static_pointer_cast<_impl::CollectionNotifier>(std::make_shared<PrimitiveListNotifier>(m_table, m_realm, true));
+        RealmCoordinator::register_notifier(m_value_diff_notifier);
+    }
+    return {m_value_diff_notifier, m_value_diff_notifier->add_callback(std::move(cb))};
+}
+
 List::OutOfBoundsIndexException::OutOfBoundsIndexException(size_t r, size_t c)
 : std::out_of_range(util::format("Requested index %1 greater than max %2", r, c - 1))
 , requested(r), valid_count(c) {}
@@ -443,7 +562,9 @@ List::OutOfBoundsIndexException::OutOfBoundsIndexException(size_t r, size_t c)
     template size_t List::find<T>(T const&) const; \
     template void List::add<T>(T); \
     template void List::insert<T>(size_t, T); \
-    template void List::set<T>(size_t, T);
+    template void List::set<T>(size_t, T); \
+    template void List::insert_range<T>(size_t, T const*, T const*); \
+    template size_t List::read_into<T>(T*, size_t, size_t) const;
 
 REALM_PRIMITIVE_LIST_TYPE(bool)
 REALM_PRIMITIVE_LIST_TYPE(int64_t)
@@ -22,14 +22,17 @@
 #include "collection_notifications.hpp"
 #include "impl/collection_notifier.hpp"
 #include "property.hpp"
+#include "util/sequence_diff.hpp"
 
 #include <realm/link_view_fwd.hpp>
 #include <realm/row.hpp>
 #include <realm/table_ref.hpp>
 #include <realm/util/any.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace realm {
 class ObjectSchema;
@@ -82,6 +85,13 @@ public:
 
     template<typename T = RowExpr>
     T get(size_t row_ndx) const;
+    // Copy up to `count` values starting at `offset` into `out`, returning the
+    // number copied. Only valid for Lists of primitives, and is much cheaper
+    // than calling get() for each value when reading large lists. Nullable
+    // lists are read into util::Optional<T> (or a nullable StringData,
+    // BinaryData or Timestamp) in the same way as get().
+    template<typename T>
+    size_t read_into(T* out, size_t count, size_t offset = 0) const;
     template<typename T>
     size_t find(T const& value) const;
 
@@ -95,6 +105,19 @@ public:
     template<typename T>
     void set(size_t row_ndx, T value);
 
+    // Insert or append the values in [begin, end). The list and all of the
+    // values are validated before any are inserted, so either all of them
+    // are inserted or none are.
+    template<typename T>
+    void insert_range(size_t list_ndx, T const* begin, T const* end);
+    template<typename T>
+    void add_all(T const* begin, T const* end) { insert_range(size(), begin, end); }
+    // Append all of the objects in `results`, which must be of the same type
+    // as this List's objects
+    void add_all(Results& results);
+    // Remove the values at indices [begin, end)
+    void remove_range(size_t begin, size_t end);
+
     Results sort(SortDescriptor order) const;
     Results sort(std::vector<std::pair<std::string, bool>> const& keypaths) const;
     Results filter(Query q) const;
@@ -118,6 +141,13 @@ public:
     bool operator==(List const& rgt) const noexcept;
 
     NotificationToken add_notification_callback(CollectionChangeCallback cb) &;
+    // Add a callback whose changes are calculated by comparing the values in
+    // the list before and after each commit rather than from the operations
+    // performed, so that replacing the contents of the list with mostly the
+    // same values reports only the values which actually differ. A value being
+    // changed is reported as a deletion and an insertion rather than a
+    // modification. Only supported for lists of primitives.
+    NotificationToken add_value_diff_notification_callback(CollectionChangeCallback cb) &;
 
     template<typename Context>
     auto get(Context&, size_t row_ndx) const;
@@ -157,6 +187,12 @@ private:
     LinkViewRef m_link_view;
     TableRef m_table;
     _impl::CollectionNotifier::Handle<_impl::CollectionNotifier> m_notifier;
+    // The notifier for callbacks added with add_value_diff_notification_callback()
+    _impl::CollectionNotifier::Handle<_impl::CollectionNotifier> m_value_diff_notifier;
+    // The Results used to calculate aggregates, which is kept between calls
+    // so that the values it gathers from a LinkView are only gathered again
+    // after the list or the target table has changed
+    std::shared_ptr<Results> m_aggregate_results;
 
     void verify_valid_row(size_t row_ndx, bool insertion = false) const;
     void validate(RowExpr) const;
@@ -166,8 +202,13 @@ private:
 
     template<typename T, typename Context>
     void set_if_different(Context&, size_t row_ndx, T&& value, bool update=false);
+    // Replace the values in this list with `values` using a minimal sequence
+    // of insertions, removals and sets
+    template<typename U, typename T, typename Context>
+    void assign_diff(Context&, T&& values, bool update);
 
     size_t to_table_ndx(size_t row) const noexcept;
+    Results& aggregate_results();
 
     friend struct std::hash<List>;
 };
@@ -246,6 +287,58 @@ void List::set_if_different(Context& ctx, size_t row_ndx, T&& value, bool update
 }
 
 
+template<typename U, typename T, typename Context>
+void List::assign_diff(Context& ctx, T&& values, bool update)
+{
+    size_t old_size = size();
+    std::vector<U> old_values;
+    old_values.reserve(old_size);
+    for (size_t i = 0; i < old_size; ++i)
+        old_values.push_back(get<U>(i));
+
+    // Objects without primary keys are updated in place using the object
+    // which was previously at the same position, so all of the new values are
+    // unboxed before the list is modified
+    std::vector<U> new_values;
+    ctx.enumerate_list(values, [&](auto&& element) {
+        size_t index = new_values.size();
+        if (index < old_size)
+            new_values.push_back(ctx.template unbox<U>(element, true, update, true,
+                                                       _impl::help_get_current_row(old_values[index])));
+        else
+            new_values.push_back(ctx.template unbox<U>(element, true, update));
+    });
+
+    auto matches = util::common_subsequence(old_size, new_values.size(), [&](size_t i, size_t j) {
+        return !_impl::help_compare_values(old_values[i], new_values[j]);
+    });
+
+    // Apply the changes for each run of unmatched elements, starting from the
+    // end so that the positions of the earlier elements aren't changed.
+    // Values which were replaced by the same number of new values are set
+    // in place so that they're reported as modifications.
+    size_t old_end = old_size, new_end = new_values.size();
+    for (size_t i = matches.size() + 1; i > 0; --i) {
+        size_t old_begin = i > 1 ? matches[i - 2].first + 1 : 0;
+        size_t new_begin = i > 1 ? matches[i - 2].second + 1 : 0;
+        size_t old_count = old_end - old_begin, new_count = new_end - new_begin;
+        size_t common = std::min(old_count, new_count);
+        for (size_t j = 0; j < common; ++j) {
+            if (_impl::help_compare_values(old_values[old_begin + j], new_values[new_begin + j]))
+                set(old_begin + j, new_values[new_begin + j]);
+        }
+        for (size_t j = old_count; j > common; --j)
+            remove(old_begin + j - 1);
+        for (size_t j = common; j < new_count; ++j)
+            insert(old_begin + j, new_values[new_begin + j]);
+
+        if (i > 1) {
+            old_end = matches[i - 2].first;
+            new_end = matches[i - 2].second;
+        }
+    }
+}
+
 template<typename T, typename Context>
 void List::assign(Context& ctx, T&& values, bool update, bool update_only_diff)
 {
@@ -258,21 +351,7 @@ void List::assign(Context& ctx, T&& values, bool update, bool update_only_diff)
     }
 
     if (update_only_diff) {
-        size_t sz = size();
-        size_t index = 0;
-        ctx.enumerate_list(values, [&](auto&& element) {
-            if (index < sz) {
-                this->set_if_different(ctx, index, element, update);
-            }
-            else {
-                this->add(ctx, element, update);
-            }
-            index++;
-        });
-        while (index < sz) {
-            remove(index);
-            sz--;
-        }
+        dispatch([&](auto t) { this->assign_diff<std::decay_t<decltype(*t)>>(ctx, values, update); });
     }
     else {
         remove_all();
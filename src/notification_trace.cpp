@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "notification_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <sstream>
+
+using namespace realm;
+
+const char* realm::to_string(NotificationSpan::Phase phase) noexcept
+{
+    switch (phase) {
+        case NotificationSpan::Phase::Commit:               return "Commit";
+        case NotificationSpan::Phase::OnChange:             return "OnChange";
+        case NotificationSpan::Phase::RunNotifiers:         return "RunNotifiers";
+        case NotificationSpan::Phase::NotifierRun:          return "NotifierRun";
+        case NotificationSpan::Phase::PrepareHandover:      return "PrepareHandover";
+        case NotificationSpan::Phase::SignalRealms:         return "SignalRealms";
+        case NotificationSpan::Phase::DeliverNotifications: return "DeliverNotifications";
+        case NotificationSpan::Phase::Callbacks:            return "Callbacks";
+    }
+    return "Unknown";
+}
+
+ChromeTraceRecorder::ChromeTraceRecorder()
+: m_epoch(std::chrono::steady_clock::now())
+{
+}
+
+NotificationTraceFunction ChromeTraceRecorder::callback()
+{
+    return [this](NotificationSpan const& span) { record(span); };
+}
+
+void ChromeTraceRecorder::record(NotificationSpan const& span)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spans.push_back(span);
+    m_thread_ids.emplace(span.thread, m_thread_ids.size() + 1);
+}
+
+size_t ChromeTraceRecorder::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_spans.size();
+}
+
+void ChromeTraceRecorder::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spans.clear();
+}
+
+namespace {
+// Trace timestamps are in microseconds, but allow fractions
+std::string format_microseconds(std::chrono::nanoseconds ns)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", ns.count() / 1000.0);
+    return buffer;
+}
+} // anonymous namespace
+
+void ChromeTraceRecorder::write(std::ostream& out) const
+{
+    std::vector<NotificationSpan> spans;
+    std::unordered_map<std::thread::id, size_t> thread_ids;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        spans = m_spans;
+        thread_ids = m_thread_ids;
+    }
+    std::stable_sort(spans.begin(), spans.end(), [](auto& a, auto& b) { return a.start < b.start; });
+
+    auto ts = [&](NotificationSpan const& span) { return format_microseconds(span.start - m_epoch); };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto begin_event = [&] {
+        if (!first)
+            out << ',';
+        first = false;
+    };
+
+    std::map<uint64_t, std::vector<NotificationSpan const*>> spans_by_version;
+    for (auto& span : spans) {
+        begin_event();
+        out << "{\"name\":\"" << to_string(span.phase) << "\",\"cat\":\"realm\",\"ph\":\"X\""
+            << ",\"ts\":" << ts(span) << ",\"dur\":" << format_microseconds(span.duration)
+            << ",\"pid\":1,\"tid\":" << thread_ids[span.thread]
+            << ",\"args\":{\"version\":" << span.version;
+        if (span.notifier_type) {
+            out << ",\"notifier_type\":\"" << span.notifier_type << "\""
+                << ",\"notifier\":\"" << span.notifier << "\"";
+        }
+        out << "}}";
+
+        if (span.version)
+            spans_by_version[span.version].push_back(&span);
+    }
+
+    // Link the spans for each version with a flow, so that the viewer draws
+    // arrows following the commit between threads
+    for (auto& version : spans_by_version) {
+        auto& flow = version.second;
+        if (flow.size() < 2)
+            continue;
+        for (size_t i = 0; i < flow.size(); ++i) {
+            const char* ph = i == 0 ? "s" : i + 1 == flow.size() ? "f" : "t";
+            begin_event();
+            out << "{\"name\":\"version\",\"cat\":\"realm\",\"ph\":\"" << ph << "\",\"bp\":\"e\""
+                << ",\"id\":" << version.first << ",\"ts\":" << ts(*flow[i])
+                << ",\"pid\":1,\"tid\":" << thread_ids[flow[i]->thread] << "}";
+        }
+    }
+    out << "]}";
+}
+
+std::string ChromeTraceRecorder::to_json() const
+{
+    std::ostringstream out;
+    write(out);
+    return out.str();
+}
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_NOTIFICATION_TRACE_HPP
+#define REALM_OS_NOTIFICATION_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace realm {
+// One timed step of getting from a commit to the change notification
+// callbacks, reported to Realm::Config::notification_trace. Spans are
+// reported when they end, on the thread which performed them, so spans which
+// contain other spans are reported after them.
+struct NotificationSpan {
+    enum class Phase {
+        // Committing a write transaction, including waking up the
+        // notifier thread
+        Commit,
+        // Handling a commit notification on the notifier thread, including
+        // any wait for Config::notifier_interval
+        OnChange,
+        // One pass of running all of the async notifiers
+        RunNotifiers,
+        // One notifier running the query or calculating changes
+        NotifierRun,
+        // One notifier handing its results over for delivery
+        PrepareHandover,
+        // Waking up the Realms which may have notifications to deliver
+        SignalRealms,
+        // A Realm delivering its available notifications on its own thread
+        DeliverNotifications,
+        // Calling one notifier's callbacks
+        Callbacks,
+    };
+
+    Phase phase;
+    // The type of notifier for the per-notifier phases, and null otherwise
+    const char* notifier_type;
+    // Identifies the notifier for the per-notifier phases, and null otherwise
+    const void* notifier;
+    // The version of the Realm which the span is for, or zero if not known.
+    // Spans for the same version can be combined to follow a commit from
+    // thread to thread.
+    uint64_t version;
+    std::thread::id thread;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds duration;
+};
+
+const char* to_string(NotificationSpan::Phase phase) noexcept;
+
+// A callback function called with each NotificationSpan. It's called on
+// whichever thread performed the span, possibly with locks held, so it must
+// be thread-safe, must be quick, and must not throw or use the Realm.
+using NotificationTraceFunction = std::function<void (NotificationSpan const& span)>;
+
+// Collects NotificationSpans and writes them in the Chrome trace event format,
+// which can be loaded by chrome://tracing or Perfetto. Each span becomes a
+// complete event on its thread, and the spans for each version are linked by
+// flow events.
+class ChromeTraceRecorder {
+public:
+    ChromeTraceRecorder();
+
+    // A callback which records spans into this recorder, for use as
+    // Config::notification_trace. The recorder must outlive every Realm
+    // which uses the callback.
+    NotificationTraceFunction callback();
+
+    void record(NotificationSpan const& span);
+
+    // The number of spans recorded since creation or the last clear()
+    size_t size() const;
+    void clear();
+
+    // Write the recorded spans as a JSON trace object
+    void write(std::ostream& out) const;
+    std::string to_json() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::vector<NotificationSpan> m_spans;
+    // Small sequential ids for threads, as the trace format wants integers
+    std::unordered_map<std::thread::id, size_t> m_thread_ids;
+};
+} // namespace realm
+
+#endif // REALM_OS_NOTIFICATION_TRACE_HPP
@@ -19,9 +19,14 @@
 #include "object.hpp"
 
 #include "impl/object_notifier.hpp"
+#include "impl/object_table_notifier.hpp"
 #include "impl/realm_coordinator.hpp"
 #include "object_schema.hpp"
 #include "object_store.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include <algorithm>
 
 using namespace realm;
 
@@ -72,11 +77,32 @@ Object& Object::operator=(Object&&) = default;
 NotificationToken Object::add_notification_callback(CollectionChangeCallback callback) &
 {
     verify_attached();
+    if (m_realm->is_frozen())
+        throw InvalidTransactionException("Cannot register notification callbacks for frozen Realms");
+    // Unfiltered callbacks for objects in the same table share a notifier, so
+    // that observing many objects doesn't mean running a notifier per object
+    return _impl::ObjectTableNotifier::add_object_callback(m_realm, m_row, std::move(callback));
+}
+
+NotificationToken Object::add_notification_callback(CollectionChangeCallback callback,
+                                                    std::vector<std::string> const& key_paths) &
+{
+    verify_attached();
+    auto filter = std::make_shared<const std::vector<_impl::DeepChangeChecker::RelatedTable>>(
+        _impl::DeepChangeChecker::find_related_tables(*m_realm, *m_object_schema, key_paths));
+    prepare_async();
+    return {m_notifier, m_notifier->add_callback(std::move(callback), NotificationPriority::Interactive, std::move(filter))};
+}
+
+void Object::prepare_async()
+{
+    verify_attached();
+    if (m_realm->is_frozen())
+        throw InvalidTransactionException("Cannot register notification callbacks for frozen Realms");
     if (!m_notifier) {
         m_notifier = std::make_shared<_impl::ObjectNotifier>(m_row, m_realm);
         _impl::RealmCoordinator::register_notifier(m_notifier);
     }
-    return {m_notifier, m_notifier->add_callback(std::move(callback))};
 }
 
 void Object::verify_attached() const
@@ -87,6 +113,56 @@ void Object::verify_attached() const
     }
 }
 
+List const& Object::list_for_column(size_t column)
+{
+    // Immutable Realms only ever have a single version
+    auto version = m_realm->config().immutable() ? VersionID() : m_realm->read_transaction_version();
+    if (version != m_lists_version) {
+        m_lists.clear();
+        m_lists_version = version;
+    }
+
+    auto it = std::find_if(m_lists.begin(), m_lists.end(), [&](auto const& list) { return list.first == column; });
+    if (it != m_lists.end()) {
+        if (it->second.is_valid())
+            return it->second;
+        m_lists.erase(it);
+    }
+    m_lists.emplace_back(column, List(m_realm, *m_row.get_table(), column, m_row.get_index()));
+    return m_lists.back().second;
+}
+
+std::vector<size_t> Object::properties_linking_to_own_type(Schema const& schema, ObjectSchema const& object_schema)
+{
+    // Grow the set of types which can reach object_schema's type by adding
+    // every type with a link to one already in it until nothing changes
+    std::vector<StringData> reaches_self = {object_schema.name};
+    auto reaches = [&](StringData type) {
+        return std::find(reaches_self.begin(), reaches_self.end(), type) != reaches_self.end();
+    };
+    auto links_to_reaching_type = [&](Property const& prop) {
+        return prop.type == PropertyType::Object && reaches(prop.object_type);
+    };
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (auto& os : schema) {
+            if (reaches(os.name))
+                continue;
+            if (std::any_of(os.persisted_properties.begin(), os.persisted_properties.end(), links_to_reaching_type)) {
+                reaches_self.push_back(os.name);
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<size_t> properties;
+    for (size_t i = 0; i < object_schema.persisted_properties.size(); ++i) {
+        if (links_to_reaching_type(object_schema.persisted_properties[i]))
+            properties.push_back(i);
+    }
+    return properties;
+}
+
 Property const& Object::property_for_name(StringData prop_name) const
 {
     auto prop = m_object_schema->property_for_name(prop_name);
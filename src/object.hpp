@@ -20,11 +20,17 @@
 #define REALM_OS_OBJECT_HPP
 
 #include "impl/collection_notifier.hpp"
+#include "list.hpp"
 
 #include <realm/row.hpp>
+#include <realm/version_id.hpp>
+
+#include <utility>
+#include <vector>
 
 namespace realm {
 class ObjectSchema;
+class Schema;
 struct Property;
 using RowExpr = BasicRowExpr<Table>;
 
@@ -52,6 +58,11 @@ public:
     bool is_valid() const { return m_row.is_attached(); }
 
     NotificationToken add_notification_callback(CollectionChangeCallback callback) &;
+    // Add a callback which is only called for modifications to the given key
+    // paths (such as "name" or "dog.name") and for deletion of the object.
+    // Throws if a key path is invalid.
+    NotificationToken add_notification_callback(CollectionChangeCallback callback,
+                                                std::vector<std::string> const& key_paths) &;
 
     void ensure_user_in_everyone_role();
     void ensure_private_role_exists_for_user();
@@ -67,6 +78,17 @@ public:
     void set_property_value(ContextType& ctx, StringData prop_name,
                             ValueType value, bool try_update);
 
+    // Set several properties at once. Every property name is looked up and
+    // primary key changes are rejected before anything is written, so an
+    // invalid name leaves the object unchanged. The values themselves are
+    // only validated as each is written, so an invalid value may throw after
+    // some of the earlier values have been set; cancel the write transaction
+    // to discard them.
+    template<typename ValueType, typename ContextType>
+    void set_property_values(ContextType& ctx,
+                             std::vector<std::pair<StringData, ValueType>> const& values,
+                             bool try_update);
+
     template<typename ValueType, typename ContextType>
     ValueType get_property_value(ContextType& ctx, StringData prop_name);
 
@@ -86,6 +108,20 @@ public:
                          bool try_update = false, bool update_only_diff = false,
                          size_t current_row = size_t(-1), Row* = nullptr);
 
+    // Create or update an object from each of the native representations in
+    // `values`, with the same result as calling create() for each of them
+    // in order. The primary keys of the whole batch are resolved before any
+    // objects are created, new rows are added together, and the values are
+    // then written one property at a time. Batches which set a link which
+    // can lead back to this type are just created one object at a time, as
+    // the nested objects could otherwise be created or updated out of order.
+    // Returns the row index of the object for each value.
+    template<typename ValueType, typename ContextType>
+    static std::vector<size_t> create_bulk(ContextType& ctx, std::shared_ptr<Realm> const& realm,
+                                           const ObjectSchema &object_schema,
+                                           std::vector<ValueType> const& values,
+                                           bool try_update = false, bool update_only_diff = false);
+
     template<typename ValueType, typename ContextType>
     static Object get_for_primary_key(ContextType& ctx,
                                       std::shared_ptr<Realm> const& realm,
@@ -105,7 +141,10 @@ private:
     const ObjectSchema *m_object_schema;
     Row m_row;
     _impl::CollectionNotifier::Handle<_impl::ObjectNotifier> m_notifier;
-
+    // List accessors for the array properties which have been read, by
+    // column, and the read transaction version they were created at
+    std::vector<std::pair<size_t, List>> m_lists;
+    VersionID m_lists_version;
 
     template<typename ValueType, typename ContextType>
     void set_property_value_impl(ContextType& ctx, const Property &property,
@@ -114,10 +153,21 @@ private:
     ValueType get_property_value_impl(ContextType& ctx, const Property &property);
 
     template<typename ValueType, typename ContextType>
-    static size_t get_for_primary_key_impl(ContextType& ctx, Table const& table,
+    static size_t get_for_primary_key_impl(ContextType& ctx, Realm& realm, Table const& table,
                                            const Property &primary_prop, ValueType primary_value);
 
+    // The indices in persisted_properties of the link and list properties
+    // whose target is `object_schema`'s type or links to it, directly or
+    // through other types
+    static std::vector<size_t> properties_linking_to_own_type(Schema const& schema,
+                                                              ObjectSchema const& object_schema);
+
     void verify_attached() const;
+    // Get the List accessor for an array column, reusing the one from an
+    // earlier read in the same read transaction if it's still valid
+    List const& list_for_column(size_t column);
+    // Create and register the notifier if needed
+    void prepare_async();
     Property const& property_for_name(StringData prop_name) const;
 };
 
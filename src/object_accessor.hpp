@@ -22,6 +22,7 @@
 #include "object.hpp"
 
 #include "feature_checks.hpp"
+#include "impl/primary_key_cache.hpp"
 #include "list.hpp"
 #include "object_schema.hpp"
 #include "object_store.hpp"
@@ -37,7 +38,10 @@
 #include <realm/sync/object.hpp>
 #endif // REALM_ENABLE_SYNC
 
+#include <algorithm>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace realm {
 template <typename ValueType, typename ContextType>
@@ -56,6 +60,28 @@ void Object::set_property_value(ContextType& ctx, StringData prop_name, ValueTyp
     set_property_value_impl(ctx, property, value, try_update, false, false);
 }
 
+template <typename ValueType, typename ContextType>
+void Object::set_property_values(ContextType& ctx,
+                                 std::vector<std::pair<StringData, ValueType>> const& values,
+                                 bool try_update)
+{
+    verify_attached();
+    m_realm->verify_in_write();
+
+    std::vector<Property const*> properties;
+    properties.reserve(values.size());
+    bool in_migration = m_realm->is_in_migration();
+    for (auto& value : values) {
+        auto& property = property_for_name(value.first);
+        if (property.is_primary && !in_migration)
+            throw ModifyPrimaryKeyException(m_object_schema->name, property.name);
+        properties.push_back(&property);
+    }
+
+    for (size_t i = 0; i < values.size(); ++i)
+        set_property_value_impl(ctx, *properties[i], values[i].second, try_update, false, false);
+}
+
 template <typename ValueType, typename ContextType>
 ValueType Object::get_property_value(ContextType& ctx, const Property& property)
 {
@@ -162,7 +188,7 @@ ValueType Object::get_property_value_impl(ContextType& ctx, const Property &prop
     if (is_nullable(property.type) && m_row.is_null(column))
         return ctx.null_value();
     if (is_array(property.type) && property.type != PropertyType::LinkingObjects)
-        return ctx.box(List(m_realm, *m_row.get_table(), column, m_row.get_index()));
+        return ctx.box(list_for_column(column));
 
     switch (property.type & ~PropertyType::Flags) {
         case PropertyType::Bool:   return ctx.box(m_row.get_bool(column));
@@ -225,7 +251,7 @@ Object Object::create(ContextType& ctx, std::shared_ptr<Realm> const& realm,
                 throw MissingPropertyValueException(object_schema.name, primary_prop->name);
             primary_value = ctx.null_value();
         }
-        row_index = get_for_primary_key_impl(ctx, *table, *primary_prop, *primary_value);
+        row_index = get_for_primary_key_impl(ctx, *realm, *table, *primary_prop, *primary_value);
 
         if (row_index == realm::not_found) {
             created = true;
@@ -252,6 +278,8 @@ Object Object::create(ContextType& ctx, std::shared_ptr<Realm> const& realm,
             else {
                 REALM_TERMINATE("Unsupported primary key type.");
             }
+            if (auto cache = _impl::PrimaryKeyCache::get(*realm))
+                cache->insert(*table, _impl::primary_key_for(ctx, *primary_prop, *primary_value), row_index);
         }
         else if (!try_update) {
             if (realm->is_in_migration()) {
@@ -313,9 +341,185 @@ Object Object::create(ContextType& ctx, std::shared_ptr<Realm> const& realm,
         object.ensure_private_role_exists_for_user();
     }
 #endif
+    // Setting the properties modified the table, but not in a way which
+    // invalidates the cached row indices
+    if (auto cache = _impl::PrimaryKeyCache::get(*realm))
+        cache->update_version(*table);
     return object;
 }
 
+template<typename ValueType, typename ContextType>
+std::vector<size_t> Object::create_bulk(ContextType& ctx, std::shared_ptr<Realm> const& realm,
+                                        ObjectSchema const& object_schema, std::vector<ValueType> const& values,
+                                        bool try_update, bool update_only_diff)
+{
+    realm->verify_in_write();
+
+    std::vector<size_t> rows;
+    rows.reserve(values.size());
+
+    // Duplicate primary keys are allowed during migrations and new users need
+    // their permissions set up, both of which create() handles one object at
+    // a time
+    bool create_individually = realm->is_in_migration();
+#if REALM_ENABLE_SYNC
+    create_individually = create_individually || (realm->is_partial() && object_schema.name == "__User");
+#endif
+    // Writing one property at a time would create or update nested objects of
+    // this type out of order relative to the values in the batch, so batches
+    // with any non-null links which could lead back to this type are also
+    // created one object at a time
+    if (!create_individually) {
+        auto linking_properties = properties_linking_to_own_type(realm->schema(), object_schema);
+        create_individually = std::any_of(values.begin(), values.end(), [&](auto const& value) {
+            return std::any_of(linking_properties.begin(), linking_properties.end(), [&](size_t i) {
+                auto v = ctx.value_for_property(value, object_schema.persisted_properties[i], i);
+                return v && !ctx.is_null(*v);
+            });
+        });
+    }
+    if (create_individually) {
+        for (auto& value : values)
+            rows.push_back(create(ctx, realm, object_schema, value, try_update, update_only_diff).row().get_index());
+        return rows;
+    }
+
+    TableRef table = ObjectStore::table_for_object_type(realm->read_group(), object_schema.name);
+    // Whether the object for each value is new, and so needs the properties
+    // which aren't in the value set to their defaults
+    std::vector<bool> created(values.size());
+    auto primary_prop = object_schema.primary_key_property();
+
+    if (primary_prop) {
+        size_t primary_ndx = primary_prop - &object_schema.persisted_properties[0];
+        std::vector<util::Optional<ValueType>> primary_values(values.size());
+        // The index in `values` of the first value with each primary key
+        std::unordered_map<_impl::PrimaryKey, size_t, _impl::PrimaryKey::Hash> first_for_key;
+        // The index of each value whose primary key appeared earlier in the
+        // batch, and the index of that earlier value
+        std::vector<std::pair<size_t, size_t>> duplicates;
+        std::vector<size_t> new_objects;
+
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto& primary_value = primary_values[i];
+            primary_value = ctx.value_for_property(values[i], *primary_prop, primary_ndx);
+            if (!primary_value)
+                primary_value = ctx.default_value_for_property(object_schema, *primary_prop);
+            if (!primary_value) {
+                if (!is_nullable(primary_prop->type))
+                    throw MissingPropertyValueException(object_schema.name, primary_prop->name);
+                primary_value = ctx.null_value();
+            }
+
+            auto key = _impl::primary_key_for(ctx, *primary_prop, *primary_value);
+            auto it = first_for_key.find(key);
+            if (it != first_for_key.end()) {
+                // Creating the same object again within the batch updates it
+                if (!try_update)
+                    throw std::logic_error(util::format("Attempting to create an object of type '%1' with an existing primary key value '%2'.",
+                                                        object_schema.name, ctx.print(*primary_value)));
+                duplicates.emplace_back(i, it->second);
+                rows.push_back(realm::not_found);
+                continue;
+            }
+            first_for_key.emplace(std::move(key), i);
+
+            size_t row_index = get_for_primary_key_impl(ctx, *realm, *table, *primary_prop, *primary_value);
+            if (row_index == realm::not_found) {
+                new_objects.push_back(i);
+                created[i] = true;
+            }
+            else if (!try_update) {
+                throw std::logic_error(util::format("Attempting to create an object of type '%1' with an existing primary key value '%2'.",
+                                                    object_schema.name, ctx.print(*primary_value)));
+            }
+            rows.push_back(row_index);
+        }
+
+#if REALM_ENABLE_SYNC
+        for (size_t i : new_objects) {
+            if (primary_prop->type == PropertyType::Int)
+                rows[i] = sync::create_object_with_primary_key(realm->read_group(), *table, ctx.template unbox<util::Optional<int64_t>>(*primary_values[i]));
+            else if (primary_prop->type == PropertyType::String)
+                rows[i] = sync::create_object_with_primary_key(realm->read_group(), *table, ctx.template unbox<StringData>(*primary_values[i]));
+            else
+                REALM_TERMINATE("Unsupported primary key type.");
+        }
+#else
+        size_t row_index = table->size();
+        if (!new_objects.empty())
+            table->add_empty_row(new_objects.size());
+        for (size_t i : new_objects) {
+            auto& primary_value = *primary_values[i];
+            rows[i] = row_index++;
+            if (primary_prop->type == PropertyType::Int) {
+                if (ctx.is_null(primary_value))
+                    table->set_null_unique(primary_prop->table_column, rows[i]);
+                else
+                    table->set_unique(primary_prop->table_column, rows[i], ctx.template unbox<int64_t>(primary_value));
+            }
+            else if (primary_prop->type == PropertyType::String) {
+                table->set_unique(primary_prop->table_column, rows[i], ctx.template unbox<StringData>(primary_value));
+            }
+            else {
+                REALM_TERMINATE("Unsupported primary key type.");
+            }
+        }
+#endif // REALM_ENABLE_SYNC
+
+        for (auto& duplicate : duplicates)
+            rows[duplicate.first] = rows[duplicate.second];
+        if (auto cache = _impl::PrimaryKeyCache::get(*realm)) {
+            for (size_t i : new_objects)
+                cache->insert(*table, _impl::primary_key_for(ctx, *primary_prop, *primary_values[i]), rows[i]);
+        }
+    }
+    else {
+#if REALM_ENABLE_SYNC
+        for (size_t i = 0; i < values.size(); ++i)
+            rows.push_back(sync::create_object(realm->read_group(), *table));
+#else
+        size_t row_index = table->size();
+        if (!values.empty())
+            table->add_empty_row(values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+            rows.push_back(row_index++);
+#endif // REALM_ENABLE_SYNC
+        std::fill(created.begin(), created.end(), true);
+    }
+
+    // populate one property at a time, reusing a single accessor
+    Object object(realm, object_schema, RowExpr());
+    for (size_t i = 0; i < object_schema.persisted_properties.size(); ++i) {
+        auto& prop = object_schema.persisted_properties[i];
+        if (prop.is_primary)
+            continue;
+
+        for (size_t j = 0; j < values.size(); ++j) {
+            auto v = ctx.value_for_property(values[j], prop, i);
+            if (!created[j] && !v)
+                continue;
+
+            bool is_default = false;
+            if (!v) {
+                v = ctx.default_value_for_property(object_schema, prop);
+                is_default = true;
+            }
+            if ((!v || ctx.is_null(*v)) && !is_nullable(prop.type) && !is_array(prop.type)) {
+                if (!ctx.allow_missing(values[j]))
+                    throw MissingPropertyValueException(object_schema.name, prop.name);
+            }
+            if (v) {
+                object.m_row = table->get(rows[j]);
+                object.set_property_value_impl(ctx, prop, *v, try_update, update_only_diff, is_default);
+            }
+        }
+    }
+    if (auto cache = _impl::PrimaryKeyCache::get(*realm))
+        cache->update_version(*table);
+    return rows;
+}
+
 template<typename ValueType, typename ContextType>
 Object Object::get_for_primary_key(ContextType& ctx, std::shared_ptr<Realm> const& realm,
                       StringData object_type, ValueType primary_value)
@@ -338,27 +542,43 @@ Object Object::get_for_primary_key(ContextType& ctx, std::shared_ptr<Realm> cons
     auto table = ObjectStore::table_for_object_type(realm->read_group(), object_schema.name);
     if (!table)
         return Object(realm, object_schema, RowExpr());
-    auto row_index = get_for_primary_key_impl(ctx, *table, *primary_prop, primary_value);
+    auto row_index = get_for_primary_key_impl(ctx, *realm, *table, *primary_prop, primary_value);
 
     return Object(realm, object_schema, row_index == realm::not_found ? Row() : Row(table->get(row_index)));
 }
 
 template<typename ValueType, typename ContextType>
-size_t Object::get_for_primary_key_impl(ContextType& ctx, Table const& table,
+size_t Object::get_for_primary_key_impl(ContextType& ctx, Realm& realm, Table const& table,
                                         const Property &primary_prop,
                                         ValueType primary_value) {
     bool is_null = ctx.is_null(primary_value);
     if (is_null && !is_nullable(primary_prop.type))
         throw std::logic_error("Invalid null value for non-nullable primary key.");
+
+    auto cache = _impl::PrimaryKeyCache::get(realm);
+    _impl::PrimaryKey key;
+    if (cache) {
+        key = _impl::primary_key_for(ctx, primary_prop, primary_value);
+        if (auto row_ndx = cache->find(table, key))
+            return *row_ndx;
+    }
+
+    size_t row_ndx;
     if (primary_prop.type == PropertyType::String) {
-        return table.find_first(primary_prop.table_column,
-                                ctx.template unbox<StringData>(primary_value));
+        row_ndx = table.find_first(primary_prop.table_column,
+                                   ctx.template unbox<StringData>(primary_value));
+    }
+    else if (is_nullable(primary_prop.type)) {
+        row_ndx = table.find_first(primary_prop.table_column,
+                                   ctx.template unbox<util::Optional<int64_t>>(primary_value));
+    }
+    else {
+        row_ndx = table.find_first(primary_prop.table_column,
+                                   ctx.template unbox<int64_t>(primary_value));
     }
-    if (is_nullable(primary_prop.type))
-        return table.find_first(primary_prop.table_column,
-                                ctx.template unbox<util::Optional<int64_t>>(primary_value));
-    return table.find_first(primary_prop.table_column,
-                            ctx.template unbox<int64_t>(primary_value));
+    if (cache)
+        cache->insert(table, std::move(key), row_ndx);
+    return row_ndx;
 }
 
 } // namespace realm
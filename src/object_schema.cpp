@@ -22,6 +22,7 @@
 #include "object_store.hpp"
 #include "property.hpp"
 #include "schema.hpp"
+#include "util/string_hash.hpp"
 
 
 #include <realm/data_type.hpp>
@@ -51,6 +52,7 @@ ObjectSchema::ObjectSchema(std::string name, std::initializer_list<Property> per
             break;
         }
     }
+    rebuild_property_index();
 }
 
 PropertyType ObjectSchema::from_core_type(Descriptor const& table, size_t col)
@@ -90,11 +92,62 @@ ObjectSchema::ObjectSchema(Group const& group, StringData name, size_t index) :
     }
 
     primary_key = realm::ObjectStore::get_primary_key_for_object(group, name);
+    rebuild_property_index();
     set_primary_key_property();
 }
 
+static StringData public_name_of(Property const& prop)
+{
+    // If no `public_name` is defined, the internal `name` is also considered the public name.
+    return prop.public_name.empty() ? StringData(prop.name) : StringData(prop.public_name);
+}
+
+void ObjectSchema::rebuild_property_index()
+{
+    m_name_index.clear();
+    m_public_name_index.clear();
+    size_t count = persisted_properties.size() + computed_properties.size();
+    m_name_index.reserve(count);
+    m_public_name_index.reserve(count);
+    // emplace() doesn't replace existing entries, so the first property wins
+    // for duplicate names (which fail validation anyway) and hash collisions,
+    // matching the order of the linear search
+    for (size_t i = 0; i < count; ++i) {
+        auto& prop = *property_at(i);
+        m_name_index.emplace(util::string_hash(prop.name), i);
+        m_public_name_index.emplace(util::string_hash(public_name_of(prop)), i);
+    }
+
+    auto combine = [&](size_t value) {
+        m_fingerprint ^= value + 0x9e3779b9 + (m_fingerprint << 6) + (m_fingerprint >> 2);
+    };
+    m_fingerprint = util::string_hash(primary_key);
+    for (auto& prop : persisted_properties) {
+        combine(util::string_hash(prop.name));
+        combine(to_underlying(prop.type));
+        combine(util::string_hash(prop.object_type));
+        combine(prop.requires_index());
+    }
+}
+
+Property* ObjectSchema::property_at(size_t ndx)
+{
+    if (ndx < persisted_properties.size())
+        return &persisted_properties[ndx];
+    ndx -= persisted_properties.size();
+    return ndx < computed_properties.size() ? &computed_properties[ndx] : nullptr;
+}
+
 Property *ObjectSchema::property_for_name(StringData name)
 {
+    auto it = m_name_index.find(util::string_hash(name));
+    if (it != m_name_index.end()) {
+        auto prop = property_at(it->second);
+        if (prop && StringData(prop->name) == name)
+            return prop;
+    }
+
+    // The name either doesn't exist or the index is out of date
     for (auto& prop : persisted_properties) {
         if (StringData(prop.name) == name) {
             return &prop;
@@ -110,9 +163,15 @@ Property *ObjectSchema::property_for_name(StringData name)
 
 Property *ObjectSchema::property_for_public_name(StringData public_name)
 {
-    // If no `public_name` is defined, the internal `name` is also considered the public name.
+    auto it = m_public_name_index.find(util::string_hash(public_name));
+    if (it != m_public_name_index.end()) {
+        auto prop = property_at(it->second);
+        if (prop && public_name_of(*prop) == public_name)
+            return prop;
+    }
+
     for (auto& prop : persisted_properties) {
-        if (prop.public_name == public_name || (prop.public_name.empty() && prop.name == public_name))
+        if (public_name_of(prop) == public_name)
             return &prop;
     }
 
@@ -120,7 +179,7 @@ Property *ObjectSchema::property_for_public_name(StringData public_name)
     // are a bit pointless since the internal name is already the "public name", but since
     // this distinction isn't visible in the Property struct we allow it anyway.
     for (auto& prop : computed_properties) {
-        if ((prop.public_name.empty() ? StringData(prop.name) :  StringData(prop.public_name)) == public_name)
+        if (public_name_of(prop) == public_name)
             return &prop;
     }
     return nullptr;
@@ -22,6 +22,7 @@
 #include <realm/string_data.hpp>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace realm {
@@ -61,6 +62,20 @@ public:
     }
     bool property_is_computed(Property const& property) const;
 
+    // Rebuild the index used by property_for_name() and
+    // property_for_public_name(). The index is built on construction and
+    // when a Schema's columns are set, and should be rebuilt after adding,
+    // removing or renaming properties. Lookups are still correct with an out
+    // of date index, but must fall back to checking each property.
+    void rebuild_property_index();
+
+    // A hash of the persisted properties and primary key as compared by
+    // Schema::compare(), computed along with the property index. Classes
+    // with different fingerprints can skip straight to finding what differs,
+    // while equal fingerprints still have to be confirmed by comparing the
+    // properties, as they may be hash collisions or out of date.
+    size_t fingerprint() const noexcept { return m_fingerprint; }
+
     void validate(Schema const& schema, std::vector<ObjectSchemaValidationException>& exceptions) const;
 
     friend bool operator==(ObjectSchema const& a, ObjectSchema const& b);
@@ -68,7 +83,16 @@ public:
     static PropertyType from_core_type(Descriptor const& table, size_t col);
 
 private:
+    // Hash of the name (or public name) of each property to its position in
+    // persisted_properties followed by computed_properties. Only hashes and
+    // positions are stored so that the index stays safe to use when the
+    // properties are modified, and each hit is checked against the property.
+    std::unordered_map<size_t, size_t> m_name_index;
+    std::unordered_map<size_t, size_t> m_public_name_index;
+    size_t m_fingerprint = 0;
+
     void set_primary_key_property();
+    Property* property_at(size_t ndx);
 };
 }
 
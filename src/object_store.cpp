@@ -23,6 +23,7 @@
 #include "schema.hpp"
 #include "shared_realm.hpp"
 #include "sync/partial_sync.hpp"
+#include "util/string_hash.hpp"
 
 #include <realm/descriptor.hpp>
 #include <realm/group.hpp>
@@ -36,7 +37,10 @@
 #include <realm/sync/instruction_replication.hpp>
 #endif // REALM_ENABLE_SYNC
 
+#include <algorithm>
 #include <string.h>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace realm;
 
@@ -46,6 +50,7 @@ namespace {
 const char * const c_metadataTableName = "metadata";
 const char * const c_versionColumnName = "version";
 const size_t c_versionColumnIndex = 0;
+const char * const c_schemaHashColumnName = "schema_hash";
 
 const char * const c_primaryKeyTableName = "pk";
 const char * const c_primaryKeyObjectClassColumnName = "pk_table";
@@ -57,6 +62,29 @@ const size_t c_zeroRowIndex = 0;
 
 const char c_object_table_prefix[] = "class_";
 
+// Progress is reported after copying this many rows when converting columns
+const size_t c_progressRowChunkSize = 10000;
+
+// Tracks the amount of work done by a migration and reports it to the
+// optional callback passed to apply_schema_changes()
+class MigrationProgress {
+public:
+    MigrationProgress(std::function<void(uint64_t, uint64_t)> const& callback, uint64_t total)
+    : m_callback(callback), m_total(total) { }
+
+    void advance(uint64_t units)
+    {
+        m_completed += units;
+        if (m_callback)
+            m_callback(m_completed, m_total);
+    }
+
+private:
+    std::function<void(uint64_t, uint64_t)> const& m_callback;
+    uint64_t m_completed = 0;
+    uint64_t m_total;
+};
+
 void create_metadata_tables(Group& group) {
     // The tables 'pk' and 'metadata' are treated specially by Sync. The 'pk' table
     // is populated by `sync::create_table` and friends, while the 'metadata' table
@@ -78,6 +106,51 @@ void create_metadata_tables(Group& group) {
     pk_table->add_search_index(c_primaryKeyObjectClassColumnIndex);
 }
 
+uint64_t combine_hash(uint64_t seed, uint64_t value)
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// The hash recorded in the metadata table covers the group's schema version
+// and the names and types of all of its columns as well as the schema, so that
+// it stops matching if tables or columns are added, removed or renamed by
+// anything which doesn't update it. Zero is reserved for "no valid hash".
+uint64_t group_schema_hash(Group const& group, uint64_t schema_hash)
+{
+    uint64_t hash = combine_hash(schema_hash, ObjectStore::get_schema_version(group));
+    for (size_t i = 0; i < group.size(); ++i) {
+        hash = combine_hash(hash, util::string_hash(group.get_table_name(i)));
+        ConstTableRef table = group.get_table(i);
+        for (size_t col = 0, count = table->get_column_count(); col < count; ++col) {
+            hash = combine_hash(hash, util::string_hash(table->get_column_name(col)));
+            hash = combine_hash(hash, table->get_column_type(col));
+        }
+    }
+    return hash ? hash : 1;
+}
+
+// Check if the schema read from a group has exactly the persisted properties
+// of the given schema, in any order
+bool group_schema_matches(Schema const& group_schema, Schema const& schema)
+{
+    if (group_schema.size() != schema.size())
+        return false;
+    // Both schemas are sorted by name
+    return std::equal(schema.begin(), schema.end(), group_schema.begin(),
+                      [](ObjectSchema const& expected, ObjectSchema const& actual) {
+        if (actual.name != expected.name || actual.primary_key != expected.primary_key)
+            return false;
+        if (actual.persisted_properties.size() != expected.persisted_properties.size())
+            return false;
+        for (auto& prop : expected.persisted_properties) {
+            auto actual_prop = actual.property_for_name(prop.name);
+            if (!actual_prop || !(*actual_prop == prop))
+                return false;
+        }
+        return true;
+    });
+}
+
 void set_schema_version(Group& group, uint64_t version) {
     TableRef table = group.get_table(c_metadataTableName);
     table->set_int(c_versionColumnIndex, c_zeroRowIndex, version);
@@ -178,48 +251,59 @@ void add_initial_columns(Group& group, ObjectSchema const& object_schema)
     }
 }
 
-void copy_property_values(Property const& prop, Table& table)
+// Copies the values from the column after prop.table_column into it. The
+// copying is done in chunks by a loop specialized for the column type so that
+// there's no per-row dispatch, and each chunk copied is reported as progress.
+void copy_property_values(Property const& prop, Table& table, MigrationProgress* progress = nullptr)
 {
-    auto copy_property_values = [&](auto getter, auto setter) {
-        for (size_t i = 0, count = table.size(); i < count; i++) {
-            bool is_default = false;
-            (table.*setter)(prop.table_column, i, (table.*getter)(prop.table_column + 1, i),
-                            is_default);
+    const size_t count = table.size();
+    const size_t dst = prop.table_column, src = prop.table_column + 1;
+    auto copy_property_values = [&](auto copy_row) {
+        for (size_t begin = 0; begin < count; begin += c_progressRowChunkSize) {
+            size_t end = std::min(count, begin + c_progressRowChunkSize);
+            for (size_t i = begin; i < end; ++i)
+                copy_row(i);
+            if (progress)
+                progress->advance(end - begin);
         }
     };
 
     switch (prop.type & ~PropertyType::Flags) {
         case PropertyType::Int:
-            copy_property_values(&Table::get_int, &Table::set_int);
+            copy_property_values([&](size_t i) { table.set_int(dst, i, table.get_int(src, i)); });
             break;
         case PropertyType::Bool:
-            copy_property_values(&Table::get_bool, &Table::set_bool);
+            copy_property_values([&](size_t i) { table.set_bool(dst, i, table.get_bool(src, i)); });
             break;
         case PropertyType::Float:
-            copy_property_values(&Table::get_float, &Table::set_float);
+            copy_property_values([&](size_t i) { table.set_float(dst, i, table.get_float(src, i)); });
             break;
         case PropertyType::Double:
-            copy_property_values(&Table::get_double, &Table::set_double);
+            copy_property_values([&](size_t i) { table.set_double(dst, i, table.get_double(src, i)); });
             break;
         case PropertyType::String:
-            copy_property_values(&Table::get_string, &Table::set_string);
+            copy_property_values([&](size_t i) { table.set_string(dst, i, table.get_string(src, i)); });
             break;
         case PropertyType::Data:
-            copy_property_values(&Table::get_binary, &Table::set_binary);
+            copy_property_values([&](size_t i) { table.set_binary(dst, i, table.get_binary(src, i)); });
             break;
         case PropertyType::Date:
-            copy_property_values(&Table::get_timestamp, &Table::set_timestamp);
+            copy_property_values([&](size_t i) { table.set_timestamp(dst, i, table.get_timestamp(src, i)); });
             break;
         default:
+            // Nothing is copied, but the rows still count towards the total
+            if (progress)
+                progress->advance(count);
             break;
     }
 }
 
-void make_property_optional(Group& group, Table& table, Property property)
+void make_property_optional(Group& group, Table& table, Property property,
+                            MigrationProgress* progress = nullptr)
 {
     property.type |= PropertyType::Nullable;
     insert_column(group, table, property, property.table_column);
-    copy_property_values(property, table);
+    copy_property_values(property, table, progress);
     table.remove_column(property.table_column + 1);
 }
 
@@ -230,23 +314,81 @@ void make_property_required(Group& group, Table& table, Property property)
     table.remove_column(property.table_column + 1);
 }
 
+// Returns true if any two rows have the same value in the column, stopping at
+// the first duplicate found. Null is treated as a distinct value.
+template<typename T, typename Hash = std::hash<T>, typename Getter>
+bool column_has_duplicates(Table const& table, size_t col, Getter getter)
+{
+    std::unordered_set<T, Hash> seen;
+    seen.reserve(table.size());
+    bool seen_null = false;
+    bool nullable = table.is_nullable(col);
+    for (size_t i = 0, count = table.size(); i < count; ++i) {
+        if (nullable && table.is_null(col, i)) {
+            if (seen_null)
+                return true;
+            seen_null = true;
+        }
+        else if (!seen.insert(getter(i)).second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct StringDataHash {
+    size_t operator()(StringData str) const noexcept { return util::string_hash(str); }
+};
+
 void validate_primary_column_uniqueness(Group const& group, StringData object_type, StringData primary_property)
 {
     auto table = ObjectStore::table_for_object_type(group, object_type);
-    if (table->get_distinct_view(table->get_column_index(primary_property)).size() != table->size()) {
+    size_t col = table->get_column_index(primary_property);
+    bool has_duplicates;
+    switch (table->get_column_type(col)) {
+        case type_Int:
+            has_duplicates = column_has_duplicates<int64_t>(*table, col, [&](size_t i) {
+                return table->get_int(col, i);
+            });
+            break;
+        case type_String:
+            has_duplicates = column_has_duplicates<StringData, StringDataHash>(*table, col, [&](size_t i) {
+                return table->get_string(col, i);
+            });
+            break;
+        default:
+            has_duplicates = table->get_distinct_view(col).size() != table->size();
+            break;
+    }
+    if (has_duplicates) {
         throw DuplicatePrimaryKeyValueException(object_type, primary_property);
     }
 }
 
-void validate_primary_column_uniqueness(Group const& group)
+// Validates each of the given (object type, primary key property) pairs once,
+// plus every primary key in the group if `all_primary_keys` is set
+void validate_primary_column_uniqueness(Group const& group, std::vector<std::pair<StringData, StringData>> primary_keys,
+                                        bool all_primary_keys)
 {
-    auto pk_table = group.get_table(c_primaryKeyTableName);
-    for (size_t i = 0, count = pk_table->size(); i < count; ++i) {
-        validate_primary_column_uniqueness(group,
-                                           pk_table->get_string(c_primaryKeyObjectClassColumnIndex, i),
-                                           pk_table->get_string(c_primaryKeyPropertyNameColumnIndex, i));
+    if (all_primary_keys) {
+        auto pk_table = group.get_table(c_primaryKeyTableName);
+        for (size_t i = 0, count = pk_table->size(); i < count; ++i) {
+            primary_keys.emplace_back(pk_table->get_string(c_primaryKeyObjectClassColumnIndex, i),
+                                      pk_table->get_string(c_primaryKeyPropertyNameColumnIndex, i));
+        }
+    }
+
+    std::sort(primary_keys.begin(), primary_keys.end());
+    primary_keys.erase(std::unique(primary_keys.begin(), primary_keys.end()), primary_keys.end());
+    for (auto& pk : primary_keys) {
+        validate_primary_column_uniqueness(group, pk.first, pk.second);
     }
 }
+
+void validate_primary_column_uniqueness(Group const& group)
+{
+    validate_primary_column_uniqueness(group, {}, true);
+}
 } // anonymous namespace
 
 void ObjectStore::set_schema_version(Group& group, uint64_t version) {
@@ -262,6 +404,59 @@ uint64_t ObjectStore::get_schema_version(Group const& group) {
     return table->get_int(c_versionColumnIndex, c_zeroRowIndex);
 }
 
+uint64_t ObjectStore::schema_hash(Schema const& schema)
+{
+    uint64_t hash = 0;
+    auto add_property = [&](Property const& prop) {
+        hash = combine_hash(hash, util::string_hash(prop.name));
+        hash = combine_hash(hash, to_underlying(prop.type));
+        hash = combine_hash(hash, prop.is_primary);
+        hash = combine_hash(hash, prop.requires_index());
+        hash = combine_hash(hash, util::string_hash(prop.object_type));
+        hash = combine_hash(hash, util::string_hash(prop.link_origin_property_name));
+    };
+    for (auto& object_schema : schema) {
+        hash = combine_hash(hash, util::string_hash(object_schema.name));
+        hash = combine_hash(hash, util::string_hash(object_schema.primary_key));
+        for (auto& prop : object_schema.persisted_properties)
+            add_property(prop);
+        hash = combine_hash(hash, object_schema.persisted_properties.size());
+        for (auto& prop : object_schema.computed_properties)
+            add_property(prop);
+    }
+    return hash;
+}
+
+void ObjectStore::update_schema_hash(Group& group, Schema const& schema)
+{
+    TableRef table = group.get_table(c_metadataTableName);
+    if (!table || table->size() == 0)
+        return;
+
+    bool matches = group_schema_matches(schema_from_group(group), schema);
+    size_t col = table->get_column_index(c_schemaHashColumnName);
+    if (col == npos) {
+        if (!matches)
+            return;
+        col = table->add_column(type_Int, c_schemaHashColumnName);
+    }
+    // The column has to exist before calculating the hash as it's covered by it
+    uint64_t hash = matches ? group_schema_hash(group, schema_hash(schema)) : 0;
+    table->set_int(col, c_zeroRowIndex, static_cast<int64_t>(hash));
+}
+
+bool ObjectStore::schema_hash_matches(Group const& group, uint64_t schema_hash)
+{
+    ConstTableRef table = group.get_table(c_metadataTableName);
+    if (!table || table->size() == 0)
+        return false;
+    size_t col = table->get_column_index(c_schemaHashColumnName);
+    if (col == npos)
+        return false;
+    auto stored = static_cast<uint64_t>(table->get_int(col, c_zeroRowIndex));
+    return stored != 0 && stored == group_schema_hash(group, schema_hash);
+}
+
 StringData ObjectStore::get_primary_key_for_object(Group const& group, StringData object_type) {
     ConstTableRef table = group.get_table(c_primaryKeyTableName);
     if (!table) {
@@ -620,13 +815,36 @@ void ObjectStore::apply_additive_changes(Group& group, std::vector<SchemaChange>
     }
 }
 
-static void apply_pre_migration_changes(Group& group, std::vector<SchemaChange> const& changes)
+// The number of units of progress which apply_pre_migration_changes() reports:
+// one per change plus one per row copied by changes which copy values
+static uint64_t pre_migration_progress_total(Group& group, std::vector<SchemaChange> const& changes)
+{
+    using namespace schema_change;
+    struct Counter {
+        Counter(Group& group) : table{group} { }
+        TableHelper table;
+        uint64_t total = 0;
+
+        void operator()(MakePropertyNullable op) { total += table(op.object).size(); }
+        template<typename Change>
+        void operator()(Change) { }
+    } counter{group};
+
+    for (auto& change : changes) {
+        change.visit(counter);
+    }
+    return counter.total + changes.size();
+}
+
+static void apply_pre_migration_changes(Group& group, std::vector<SchemaChange> const& changes,
+                                        MigrationProgress* progress)
 {
     using namespace schema_change;
     struct Applier {
-        Applier(Group& group) : group{group}, table{group} { }
+        Applier(Group& group, MigrationProgress* progress) : group{group}, table{group}, progress{progress} { }
         Group& group;
         TableHelper table;
+        MigrationProgress* progress;
 
         void operator()(AddTable op) { create_table(group, *op.object); }
         void operator()(RemoveTable) { }
@@ -634,15 +852,17 @@ static void apply_pre_migration_changes(Group& group, std::vector<SchemaChange>
         void operator()(AddProperty op) { add_column(group, table(op.object), *op.property); }
         void operator()(RemoveProperty) { /* delayed until after the migration */ }
         void operator()(ChangePropertyType op) { replace_column(group, table(op.object), *op.old_property, *op.new_property); }
-        void operator()(MakePropertyNullable op) { make_property_optional(group, table(op.object), *op.property); }
+        void operator()(MakePropertyNullable op) { make_property_optional(group, table(op.object), *op.property, progress); }
         void operator()(MakePropertyRequired op) { make_property_required(group, table(op.object), *op.property); }
         void operator()(ChangePrimaryKey op) { ObjectStore::set_primary_key_for_object(group, op.object->name.c_str(), op.property ? op.property->name.c_str() : ""); }
         void operator()(AddIndex op) { table(op.object).add_search_index(op.property->table_column); }
         void operator()(RemoveIndex op) { table(op.object).remove_search_index(op.property->table_column); }
-    } applier{group};
+    } applier{group, progress};
 
     for (auto& change : changes) {
         change.visit(applier);
+        if (progress)
+            progress->advance(1);
     }
 }
 
@@ -661,6 +881,7 @@ static void apply_post_migration_changes(Group& group, std::vector<SchemaChange>
         Schema const& initial_schema;
         TableHelper table;
         bool did_reread_schema;
+        std::vector<std::pair<StringData, StringData>> primary_keys;
 
         void operator()(RemoveProperty op)
         {
@@ -672,8 +893,10 @@ static void apply_post_migration_changes(Group& group, std::vector<SchemaChange>
 
         void operator()(ChangePrimaryKey op)
         {
+            // Validated after all of the other changes have been applied so
+            // that each table is only scanned once
             if (op.property) {
-                validate_primary_column_uniqueness(group, op.object->name, op.property->name);
+                primary_keys.emplace_back(op.object->name, op.property->name);
             }
         }
 
@@ -701,6 +924,11 @@ static void apply_post_migration_changes(Group& group, std::vector<SchemaChange>
     for (auto& change : changes) {
         change.visit(applier);
     }
+
+    // The migration function may have inserted duplicate values into any of
+    // the existing primary keys, so if it was run they all need to be checked
+    validate_primary_column_uniqueness(group, std::move(applier.primary_keys),
+                                       did_reread_schema == DidRereadSchema::Yes);
 }
 
 static void create_default_permissions(Group& group, std::vector<SchemaChange> const& changes,
@@ -777,7 +1005,8 @@ void ObjectStore::apply_schema_changes(Group& group, uint64_t schema_version,
                                        Schema& target_schema, uint64_t target_schema_version,
                                        SchemaMode mode, std::vector<SchemaChange> const& changes,
                                        util::Optional<std::string> sync_user_id,
-                                       std::function<void()> migration_function)
+                                       std::function<void()> migration_function,
+                                       std::function<void(uint64_t, uint64_t)> progress_callback)
 {
     create_metadata_tables(group);
 
@@ -807,6 +1036,7 @@ void ObjectStore::apply_schema_changes(Group& group, uint64_t schema_version,
     }
 
     if (mode == SchemaMode::Manual) {
+        MigrationProgress progress(progress_callback, 1);
         set_schema_columns(group, target_schema);
         if (migration_function) {
             migration_function();
@@ -816,6 +1046,7 @@ void ObjectStore::apply_schema_changes(Group& group, uint64_t schema_version,
         validate_primary_column_uniqueness(group);
         set_schema_columns(group, target_schema);
         set_schema_version(group, target_schema_version);
+        progress.advance(1);
         return;
     }
 
@@ -825,16 +1056,22 @@ void ObjectStore::apply_schema_changes(Group& group, uint64_t schema_version,
         return;
     }
 
+    // The migration function and the post-migration changes are one unit each
+    uint64_t progress_total = 0;
+    if (progress_callback)
+        progress_total = pre_migration_progress_total(group, changes) + (migration_function ? 2 : 1);
+    MigrationProgress progress(progress_callback, progress_total);
+
     auto old_schema = schema_from_group(group);
-    apply_pre_migration_changes(group, changes);
+    apply_pre_migration_changes(group, changes, progress_callback ? &progress : nullptr);
     if (migration_function) {
         set_schema_columns(group, target_schema);
         migration_function();
+        progress.advance(1);
 
         // Migration function may have changed the schema, so we need to re-read it
         auto schema = schema_from_group(group);
         apply_post_migration_changes(group, schema.compare(target_schema), old_schema, DidRereadSchema::Yes);
-        validate_primary_column_uniqueness(group);
     }
     else {
         apply_post_migration_changes(group, changes, {}, DidRereadSchema::No);
@@ -842,6 +1079,7 @@ void ObjectStore::apply_schema_changes(Group& group, uint64_t schema_version,
 
     set_schema_version(group, target_schema_version);
     set_schema_columns(group, target_schema);
+    progress.advance(1);
 }
 
 Schema ObjectStore::schema_from_group(Group const& group) {
@@ -897,6 +1135,7 @@ void ObjectStore::set_schema_columns(Group const& group, Schema& schema)
         for (auto& property : object_schema.persisted_properties) {
             property.table_column = table->get_column_index(property.name);
         }
+        object_schema.rebuild_property_index();
     }
 }
 
@@ -921,24 +1160,20 @@ bool ObjectStore::is_empty(Group const& group) {
     return true;
 }
 
-void ObjectStore::rename_property(Group& group, Schema& target_schema, StringData object_type, StringData old_name, StringData new_name)
+namespace {
+// Rename a property of `table`, whose current columns are described by
+// `table_object_schema`, and update both it and the target schema's table
+// columns to match the table afterwards so that further renames of the same
+// type don't need to read the table's columns again
+void rename_property(Group& group, Table& table, ObjectSchema& target_object_schema,
+                     ObjectSchema& table_object_schema, StringData old_name, StringData new_name)
 {
-    TableRef table = table_for_object_type(group, object_type);
-    if (!table) {
-        throw std::logic_error(util::format("Cannot rename properties for type '%1' because it does not exist.", object_type));
-    }
-
-    auto target_object_schema = target_schema.find(object_type);
-    if (target_object_schema == target_schema.end()) {
-        throw std::logic_error(util::format("Cannot rename properties for type '%1' because it has been removed from the Realm.", object_type));
-    }
-
-    if (target_object_schema->property_for_name(old_name)) {
+    StringData object_type = target_object_schema.name;
+    if (target_object_schema.property_for_name(old_name)) {
         throw std::logic_error(util::format("Cannot rename property '%1.%2' to '%3' because the source property still exists.",
                                             object_type, old_name, new_name));
     }
 
-    ObjectSchema table_object_schema(group, object_type);
     Property *old_property = table_object_schema.property_for_name(old_name);
     if (!old_property) {
         throw std::logic_error(util::format("Cannot rename property '%1.%2' because it does not exist.", object_type, old_name));
@@ -950,7 +1185,9 @@ void ObjectStore::rename_property(Group& group, Schema& target_schema, StringDat
         // renaming to an intermediate property in a multi-version migration.
         // This is safe because the migration will fail schema validation unless
         // this property is renamed again to a valid name before the end.
-        table->rename_column(old_property->table_column, new_name);
+        table.rename_column(old_property->table_column, new_name);
+        old_property->name = new_name;
+        table_object_schema.rebuild_property_index();
         return;
     }
 
@@ -965,22 +1202,85 @@ void ObjectStore::rename_property(Group& group, Schema& target_schema, StringDat
     }
 
     size_t column_to_remove = new_property->table_column;
-    table->rename_column(old_property->table_column, new_name);
-    table->remove_column(column_to_remove);
+    // The renamed column shifts down if it comes after the removed one
+    size_t renamed_column = old_property->table_column;
+    if (renamed_column > column_to_remove)
+        --renamed_column;
+    table.rename_column(old_property->table_column, new_name);
+    table.remove_column(column_to_remove);
 
     // update table_column for each property since it may have shifted
-    for (auto& current_prop : target_object_schema->persisted_properties) {
+    for (auto& current_prop : target_object_schema.persisted_properties) {
         if (current_prop.table_column == column_to_remove)
-            current_prop.table_column = old_property->table_column;
+            current_prop.table_column = renamed_column;
         else if (current_prop.table_column > column_to_remove)
             --current_prop.table_column;
     }
 
     // update nullability for column
-    if (is_nullable(new_property->type) && !is_nullable(old_property->type)) {
+    bool make_optional = is_nullable(new_property->type) && !is_nullable(old_property->type);
+    if (make_optional) {
         auto prop = *new_property;
-        prop.table_column = old_property->table_column;
-        make_property_optional(group, *table, prop);
+        prop.table_column = renamed_column;
+        make_property_optional(group, table, prop);
+    }
+
+    old_property->name = new_name;
+    if (make_optional)
+        old_property->type |= PropertyType::Nullable;
+    auto& table_properties = table_object_schema.persisted_properties;
+    table_properties.erase(table_properties.begin() + (new_property - table_properties.data()));
+    for (auto& current_prop : table_properties) {
+        if (current_prop.table_column > column_to_remove)
+            --current_prop.table_column;
+    }
+    table_object_schema.rebuild_property_index();
+}
+
+ObjectSchema& object_schema_to_rename(Group& group, Schema& target_schema, StringData object_type, TableRef& table)
+{
+    table = ObjectStore::table_for_object_type(group, object_type);
+    if (!table) {
+        throw std::logic_error(util::format("Cannot rename properties for type '%1' because it does not exist.", object_type));
+    }
+
+    auto target_object_schema = target_schema.find(object_type);
+    if (target_object_schema == target_schema.end()) {
+        throw std::logic_error(util::format("Cannot rename properties for type '%1' because it has been removed from the Realm.", object_type));
+    }
+    return *target_object_schema;
+}
+} // anonymous namespace
+
+void ObjectStore::rename_property(Group& group, Schema& target_schema, StringData object_type, StringData old_name, StringData new_name)
+{
+    TableRef table;
+    auto& target_object_schema = object_schema_to_rename(group, target_schema, object_type, table);
+    ObjectSchema table_object_schema(group, object_type);
+    ::rename_property(group, *table, target_object_schema, table_object_schema, old_name, new_name);
+}
+
+void ObjectStore::rename_properties(Group& group, Schema& target_schema, std::vector<PropertyRename> const& renames)
+{
+    // The table's columns are read once for each type and then kept up to
+    // date with the renames rather than being read again for each of them
+    struct TypeToRename {
+        TableRef table;
+        ObjectSchema* target_object_schema;
+        ObjectSchema table_object_schema;
+    };
+    std::unordered_map<std::string, TypeToRename> types;
+    for (auto& rename : renames) {
+        auto it = types.find(rename.object_type);
+        if (it == types.end()) {
+            TableRef table;
+            auto& target_object_schema = object_schema_to_rename(group, target_schema, rename.object_type, table);
+            it = types.emplace(rename.object_type, TypeToRename{std::move(table), &target_object_schema,
+                                                                ObjectSchema(group, rename.object_type)}).first;
+        }
+        auto& type = it->second;
+        ::rename_property(group, *type.table, *type.target_object_schema, type.table_object_schema,
+                          rename.old_name, rename.new_name);
     }
 }
 
@@ -81,12 +81,15 @@ public:
     // updates a Realm from old_schema to the given target schema, creating and updating tables as needed
     // passed in target schema is updated with the correct column mapping
     // optionally runs migration function if schema is out of date
+    // if the schema version is changed in Automatic or Manual mode, progress_callback is called
+    // with the units of work completed and the total as the migration proceeds
     // NOTE: must be performed within a write transaction
     static void apply_schema_changes(Group& group, uint64_t schema_version,
                                      Schema& target_schema, uint64_t target_schema_version,
                                      SchemaMode mode, std::vector<SchemaChange> const& changes,
                                      util::Optional<std::string> sync_user_id,
-                                     std::function<void()> migration_function={});
+                                     std::function<void()> migration_function={},
+                                     std::function<void(uint64_t, uint64_t)> progress_callback={});
 
     static void apply_additive_changes(Group&, std::vector<SchemaChange> const&, bool update_indexes);
 
@@ -103,6 +106,19 @@ public:
 
     static void set_schema_columns(Group const& group, Schema& schema);
 
+    // get a hash of the structure of the schema, ignoring column indices
+    static uint64_t schema_hash(Schema const& schema);
+
+    // record in the metadata table whether the schema of the group is now
+    // exactly the given schema, so that a later open with the same schema can
+    // skip reading the schema from the group
+    // NOTE: must be performed within a write transaction
+    static void update_schema_hash(Group& group, Schema const& schema);
+
+    // check if the hash last recorded by update_schema_hash() is for the given
+    // schema and the group's tables haven't been changed since then
+    static bool schema_hash_matches(Group const& group, uint64_t schema_hash);
+
     // deletes the table for the given type
     static void delete_data_for_object(Group& group, StringData object_type);
 
@@ -112,6 +128,15 @@ public:
     // renames the object_type's column of the old_name to the new name
     static void rename_property(Group& group, Schema& schema, StringData object_type, StringData old_name, StringData new_name);
 
+    struct PropertyRename {
+        std::string object_type;
+        std::string old_name;
+        std::string new_name;
+    };
+    // performs each of the renames in order, as if by rename_property(), but
+    // reads the columns of each table only once rather than for every rename
+    static void rename_properties(Group& group, Schema& schema, std::vector<PropertyRename> const& renames);
+
     // get primary key property name for object type
     static StringData get_primary_key_for_object(Group const& group, StringData object_type);
 
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_PREDICATE_CACHE_HPP
+#define REALM_OS_PREDICATE_CACHE_HPP
+
+#include "keypath_helpers.hpp"
+#include "results.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/parser/parser.hpp>
+#include <realm/parser/query_builder.hpp>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace realm {
+namespace _impl {
+// A least-recently-used cache of parsed query strings. The result of parsing
+// doesn't depend on the object type or the arguments, so a cached parse can be
+// applied to any table with new arguments bound each time.
+class PredicateCache {
+public:
+    static const size_t default_capacity = 128;
+
+    // Frozen Realms may be used from several threads at once, so the cache
+    // for one must only be used while holding this lock
+    static std::unique_lock<std::mutex> lock(Realm& realm)
+    {
+        return Realm::Internal::lock_if_frozen(realm);
+    }
+
+    // Get the cache for the given Realm, creating it if needed
+    static PredicateCache& get(Realm& realm)
+    {
+        auto& cache = Realm::Internal::get_predicate_cache(realm);
+        if (!cache)
+            cache = std::make_shared<PredicateCache>();
+        return *cache;
+    }
+
+    explicit PredicateCache(size_t capacity = default_capacity) : m_capacity(capacity) { }
+
+    // Parse the given query string, or return the previous result of parsing
+    // it. Throws if the string can't be parsed, and failures aren't cached.
+    std::shared_ptr<const parser::ParserResult> parse(std::string const& predicate)
+    {
+        auto it = m_entries.find(predicate);
+        if (it != m_entries.end()) {
+            m_order.splice(m_order.begin(), m_order, it->second.position);
+            return it->second.result;
+        }
+
+        auto result = std::make_shared<const parser::ParserResult>(parser::parse(predicate));
+        if (m_capacity == 0)
+            return result;
+        if (m_entries.size() >= m_capacity) {
+            m_entries.erase(m_order.back());
+            m_order.pop_back();
+        }
+        m_order.push_front(predicate);
+        m_entries.emplace(predicate, Entry{result, m_order.begin()});
+        return result;
+    }
+
+    size_t size() const noexcept { return m_entries.size(); }
+    // Check if a query string is cached, without marking it as used
+    bool contains(std::string const& predicate) const { return m_entries.count(predicate) != 0; }
+    size_t capacity() const noexcept { return m_capacity; }
+    void set_capacity(size_t capacity)
+    {
+        m_capacity = capacity;
+        while (m_entries.size() > m_capacity) {
+            m_entries.erase(m_order.back());
+            m_order.pop_back();
+        }
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const parser::ParserResult> result;
+        std::list<std::string>::iterator position;
+    };
+
+    size_t m_capacity;
+    // The cached query strings, most recently used first
+    std::list<std::string> m_order;
+    std::unordered_map<std::string, Entry> m_entries;
+};
+} // namespace _impl
+
+/// Filter and order `results` with a query string, parsing it using the Realm's
+/// cache of recently used query strings so that repeatedly filtering with the
+/// same string only parses it once. `arguments` are bound to the placeholders
+/// in the string each time. Backlinks can be referred to by their property
+/// names, as with backlink_mapping_for().
+inline Results filter_with_predicate(Results const& results, std::string const& predicate,
+                                     query_builder::Arguments& arguments)
+{
+    TableRef table = results.get_query().get_table();
+    if (!table)
+        return results;
+
+    auto& realm = *results.get_realm();
+    std::shared_ptr<const parser::ParserResult> parsed;
+    {
+        auto lock = _impl::PredicateCache::lock(realm);
+        parsed = _impl::PredicateCache::get(realm).parse(predicate);
+    }
+    auto const& mapping = backlink_mapping_for(realm);
+    Query query = table->where();
+    query_builder::apply_predicate(query, parsed->predicate, arguments, mapping);
+
+    DescriptorOrdering ordering;
+    query_builder::apply_ordering(ordering, table, parsed->ordering, mapping);
+    return results.filter(std::move(query)).apply_ordering(std::move(ordering));
+}
+} // namespace realm
+
+#endif // REALM_OS_PREDICATE_CACHE_HPP
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#include "realm_pool.hpp"
+
+#include "util/executor.hpp"
+
+using namespace realm;
+
+namespace {
+// Notifications are delivered to a Realm on whichever thread its executor
+// runs tasks on, which for a checked out instance could be a thread other
+// than the one using it. They'd have nothing to do anyway, as checked out
+// instances don't refresh and idle ones have no read transaction to advance.
+class DiscardingExecutor : public util::Executor {
+public:
+    void post(std::function<void()>) override { }
+};
+} // anonymous namespace
+
+std::shared_ptr<RealmPool> RealmPool::make(Realm::Config config, size_t max_idle)
+{
+    return std::make_shared<RealmPool>(std::move(config), max_idle);
+}
+
+RealmPool::RealmPool(Realm::Config config, size_t max_idle)
+: m_config(std::move(config))
+, m_max_idle(max_idle)
+{
+    // Pooled instances aren't cached, and the executor both opts them out of
+    // being confined to the thread which opened them and keeps commits made
+    // elsewhere from trying to notify an instance in use by some other thread
+    m_config.cache = false;
+    m_config.automatic_change_notifications = false;
+    m_config.notification_executor = std::make_shared<DiscardingExecutor>();
+}
+
+SharedRealm RealmPool::get_realm()
+{
+    SharedRealm realm;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_idle.empty()) {
+            realm = std::move(m_idle.back());
+            m_idle.pop_back();
+        }
+    }
+    if (!realm) {
+        realm = Realm::get_shared_realm(m_config);
+        realm->set_auto_refresh(false);
+    }
+
+    // Idle instances have no read transaction, so this begins one at the
+    // latest version
+    realm->read_group();
+
+    // The handle shares ownership with the pooled instance rather than with
+    // the Realm itself, so that the deleter runs when the caller is done with it
+    std::weak_ptr<RealmPool> weak_pool = shared_from_this();
+    Realm* ptr = realm.get();
+    return SharedRealm(ptr, [weak_pool, realm = std::move(realm)](Realm*) mutable {
+        if (auto pool = weak_pool.lock())
+            pool->release(std::move(realm));
+    });
+}
+
+void RealmPool::release(SharedRealm realm)
+{
+    // Accessors obtained from the Realm hold their own references to it
+    if (realm.use_count() > 1 || realm->is_closed())
+        return;
+    // Ends the read transaction, cancelling any write transaction first
+    realm->invalidate();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_idle.size() < m_max_idle)
+        m_idle.push_back(std::move(realm));
+}
+
+size_t RealmPool::idle_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idle.size();
+}
+
+void RealmPool::clear()
+{
+    std::vector<SharedRealm> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        idle.swap(m_idle);
+    }
+}
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef REALM_OS_REALM_POOL_HPP
+#define REALM_OS_REALM_POOL_HPP
+
+#include "shared_realm.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace realm {
+// A pool of Realm instances for reading the latest version of a file from
+// whichever thread happens to be handling a request, such as in a server.
+// Opening a Realm is far more expensive than beginning a read transaction, so
+// rather than each request opening its own instance, get_realm() hands out
+// one which an earlier request has returned to the pool, and only opens a new
+// one if all of them are in use.
+//
+// Idle instances don't hold a read transaction, so they don't keep old
+// versions of the file alive. They begin a read transaction at the latest
+// version when checked out, and stay at that version until they're returned:
+// pooled instances never refresh or receive change notifications.
+class RealmPool : public std::enable_shared_from_this<RealmPool> {
+public:
+    // `max_idle` is the number of returned instances kept open for reuse.
+    // Instances returned while the pool is full are closed.
+    static std::shared_ptr<RealmPool> make(Realm::Config config, size_t max_idle = 16);
+
+    // Check out a Realm at the latest version of the file. It may be used from
+    // any thread, but by only one thread at a time, and is only meant to be
+    // read from: a write transaction which is still open when it's returned
+    // is cancelled. It's returned to the pool once the SharedRealm and any
+    // copies of it have been destroyed. If anything obtained from it, such as
+    // a Results or Object, is still alive at that point it's dropped from the
+    // pool and left to those accessors, as otherwise the next request could
+    // end up using it at the same time.
+    SharedRealm get_realm();
+
+    // The number of instances waiting to be checked out
+    size_t idle_count() const;
+
+    // Close all of the idle instances. Instances which are checked out are
+    // still returned to the pool afterwards.
+    void clear();
+
+    RealmPool(Realm::Config config, size_t max_idle);
+
+private:
+    Realm::Config m_config;
+    const size_t m_max_idle;
+
+    mutable std::mutex m_mutex;
+    std::vector<SharedRealm> m_idle;
+
+    void release(SharedRealm realm);
+};
+} // namespace realm
+
+#endif // REALM_OS_REALM_POOL_HPP
@@ -24,13 +24,20 @@
 #include "object_schema.hpp"
 #include "object_store.hpp"
 #include "schema.hpp"
+#include "util/parallel_sort.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <unordered_set>
 
 namespace realm {
 
 Results::Results() = default;
-Results::~Results() = default;
+Results::~Results()
+{
+    release_notifier();
+}
 
 Results::Results(SharedRealm r, Query q, DescriptorOrdering o)
 : m_realm(std::move(r))
@@ -67,11 +74,18 @@ Results::Results(SharedRealm r, TableView tv, DescriptorOrdering o)
 , m_descriptor_ordering(std::move(o))
 , m_mode(Mode::TableView)
 {
-    m_table.reset(&m_table_view.get_parent());
+    m_table.reset(&m_table_view.mutate().get_parent());
 }
 
 Results::Results(const Results&) = default;
-Results& Results::operator=(const Results&) = default;
+Results& Results::operator=(const Results& other)
+{
+    // Copying the notifier Handle would reset it, which unregisters the
+    // notifier even if it's shared with other Results
+    if (this != &other)
+        *this = Results(other);
+    return *this;
+}
 
 Results::Results(Results&& other)
 : m_realm(std::move(other.m_realm))
@@ -86,6 +100,12 @@ Results::Results(Results&& other)
 , m_update_policy(other.m_update_policy)
 , m_has_used_table_view(other.m_has_used_table_view)
 , m_wants_background_updates(other.m_wants_background_updates)
+, m_table_view_confirmed_version(other.m_table_view_confirmed_version)
+, m_row_positions(std::move(other.m_row_positions))
+, m_searched_table_view(other.m_searched_table_view)
+, m_query_count(std::move(other.m_query_count))
+, m_sorted_first_row(std::move(other.m_sorted_first_row))
+, m_sorted_last_row(std::move(other.m_sorted_last_row))
 {
     if (m_notifier) {
         m_notifier->target_results_moved(other, *this);
@@ -124,6 +144,17 @@ void Results::validate_write() const
         throw InvalidTransactionException("Must be in a write transaction");
 }
 
+// The version which the results of evaluating a query can be cached for, or
+// none if they can't be as the data can change without the version changing
+static util::Optional<VersionID> cacheable_version(Realm& realm)
+{
+    if (realm.config().immutable())
+        return VersionID();
+    if (!realm.is_in_read_transaction() || realm.is_in_transaction())
+        return util::none;
+    return realm.read_transaction_version();
+}
+
 size_t Results::size()
 {
     validate_read();
@@ -131,14 +162,25 @@ size_t Results::size()
         case Mode::Empty:    return 0;
         case Mode::Table:    return m_table->size();
         case Mode::LinkView: return m_link_view->size();
-        case Mode::Query:
-            m_query.sync_view_if_needed();
-            if (!m_descriptor_ordering.will_apply_distinct())
-                return m_query.count(m_descriptor_ordering);
+        case Mode::Query: {
+            util::Optional<Mixed> count;
+            if (get_precomputed_aggregate(npos, AggregateKind::Count, count))
+                return size_t(count->get_int());
+            if (!m_descriptor_ordering.will_apply_distinct()) {
+                auto version = cacheable_version(*m_realm);
+                if (version && m_query_count && m_query_count->first == *version)
+                    return m_query_count->second;
+                m_query.sync_view_if_needed();
+                size_t count = m_query.count(m_descriptor_ordering);
+                if (version)
+                    m_query_count = std::make_pair(*version, count);
+                return count;
+            }
             REALM_FALLTHROUGH;
+        }
         case Mode::TableView:
             evaluate_query_if_needed();
-            return m_table_view.size();
+            return m_table_view->size();
     }
     REALM_COMPILER_HINT_UNREACHABLE();
 }
@@ -201,11 +243,11 @@ util::Optional<T> Results::try_get(size_t row_ndx)
         case Mode::Query:
         case Mode::TableView:
             evaluate_query_if_needed();
-            if (row_ndx >= m_table_view.size())
+            if (row_ndx >= m_table_view->size())
                 break;
-            if (m_update_policy == UpdatePolicy::Never && !m_table_view.is_row_attached(row_ndx))
+            if (m_update_policy == UpdatePolicy::Never && !m_table_view->is_row_attached(row_ndx))
                 return T{};
-            return realm::get<T>(*m_table, m_table_view.get(row_ndx).get_index());
+            return realm::get<T>(*m_table, m_table_view->get(row_ndx).get_index());
     }
     return util::none;
 }
@@ -218,9 +260,156 @@ T Results::get(size_t row_ndx)
     throw OutOfBoundsIndexException{row_ndx, size()};
 }
 
+template<typename Fn>
+size_t Results::for_each_row_in_range(size_t begin, size_t count, Fn&& fn)
+{
+    auto clamp = [&](size_t size) {
+        count = begin < size ? std::min(count, size - begin) : 0;
+    };
+
+    validate_read();
+    switch (m_mode) {
+        case Mode::Empty:
+            return 0;
+        case Mode::Table:
+            clamp(m_table->size());
+            for (size_t i = 0; i < count; ++i)
+                fn(i, begin + i);
+            return count;
+        case Mode::LinkView:
+            if (update_linkview()) {
+                clamp(m_link_view->size());
+                for (size_t i = 0; i < count; ++i)
+                    fn(i, m_link_view->get(begin + i).get_index());
+                return count;
+            }
+            REALM_FALLTHROUGH;
+        case Mode::Query:
+        case Mode::TableView:
+            evaluate_query_if_needed();
+            clamp(m_table_view->size());
+            if (m_update_policy == UpdatePolicy::Never) {
+                for (size_t i = 0; i < count; ++i) {
+                    bool attached = m_table_view->is_row_attached(begin + i);
+                    fn(i, attached ? m_table_view->get_source_ndx(begin + i) : npos);
+                }
+                return count;
+            }
+            for (size_t i = 0; i < count; ++i)
+                fn(i, m_table_view->get_source_ndx(begin + i));
+            return count;
+    }
+    REALM_COMPILER_HINT_UNREACHABLE();
+}
+
+template<typename T>
+size_t Results::get_range(size_t begin, size_t count, T* out)
+{
+    return for_each_row_in_range(begin, count, [&](size_t i, size_t row_ndx) {
+        out[i] = row_ndx == npos ? T{} : realm::get<T>(*m_table, row_ndx);
+    });
+}
+
+size_t Results::get_row_indices(size_t begin, size_t count, size_t* out)
+{
+    return for_each_row_in_range(begin, count, [&](size_t i, size_t row_ndx) {
+        out[i] = row_ndx;
+    });
+}
+
+namespace {
+template<typename T> struct ExportType;
+template<> struct ExportType<bool> { static const DataType type = type_Bool; static const bool nullable = false; };
+template<> struct ExportType<int64_t> { static const DataType type = type_Int; static const bool nullable = false; };
+template<> struct ExportType<float> { static const DataType type = type_Float; static const bool nullable = false; };
+template<> struct ExportType<double> { static const DataType type = type_Double; static const bool nullable = false; };
+// These types can represent null themselves
+template<> struct ExportType<StringData> { static const DataType type = type_String; static const bool nullable = true; };
+template<> struct ExportType<BinaryData> { static const DataType type = type_Binary; static const bool nullable = true; };
+template<> struct ExportType<Timestamp> { static const DataType type = type_Timestamp; static const bool nullable = true; };
+template<typename T> struct ExportType<util::Optional<T>> {
+    static const DataType type = ExportType<T>::type;
+    static const bool nullable = true;
+};
+}
+
+template<typename T>
+size_t Results::export_column(size_t column, T* out, size_t size)
+{
+    validate_read();
+    if (!m_table)
+        return 0;
+    if (column >= m_table->get_column_count())
+        throw OutOfBoundsIndexException{column, m_table->get_column_count()};
+    if (m_table->get_column_type(column) != ExportType<T>::type
+        || (m_table->is_nullable(column) && !ExportType<T>::nullable))
+        throw UnsupportedColumnTypeException{column, m_table.get(), "export"};
+
+    auto& table = *m_table;
+    return for_each_row_in_range(0, size, [&](size_t i, size_t row_ndx) {
+        out[i] = row_ndx == npos ? T{} : table.get<T>(column, row_ndx);
+    });
+}
+
+bool Results::find_sorted_endpoint(bool last, size_t& row)
+{
+    if (m_mode != Mode::Query || m_descriptor_ordering.is_empty() || !m_query.produces_results_in_table_order())
+        return false;
+    // Audited queries need the full TableView to record
+    if (m_realm->audit_context())
+        return false;
+
+    auto& cached = last ? m_sorted_last_row : m_sorted_first_row;
+    auto version = cacheable_version(*m_realm);
+    if (version && cached && cached->first == *version) {
+        row = cached->second;
+        return true;
+    }
+
+    std::string description;
+    try {
+        description = m_descriptor_ordering.get_description(m_table);
+    }
+    catch (std::exception const&) {
+        return false;
+    }
+    // Only a single sort, and not one followed by e.g. a distinct or limit
+    if (description.find(')') != description.size() - 1)
+        return false;
+    auto sort = _impl::ResultsNotifier::parse_sort(*m_table, description);
+    if (!sort)
+        return false;
+
+    // Rows with equal sort keys stay in table order, so the first row keeps
+    // the lowest index of its ties and the last row the highest
+    m_query.sync_view_if_needed();
+    row = npos;
+    for (size_t i = m_query.find(); i != npos; i = m_query.find(i + 1)) {
+        if (row == npos) {
+            row = i;
+            continue;
+        }
+        auto cmp = _impl::ResultsNotifier::compare_rows(*m_table, *sort, i, row);
+        if (!cmp)
+            return false;
+        if (last ? *cmp >= 0 : *cmp < 0)
+            row = i;
+    }
+    if (version)
+        cached = std::make_pair(*version, row);
+    return true;
+}
+
 template<typename T>
 util::Optional<T> Results::first()
 {
+    validate_read();
+    size_t row;
+    if (find_sorted_endpoint(false, row)) {
+        if (row == npos)
+            return util::none;
+        return realm::get<T>(*m_table, row);
+    }
     return try_get<T>(0);
 }
 
@@ -228,6 +417,12 @@ template<typename T>
 util::Optional<T> Results::last()
 {
     validate_read();
+    size_t row;
+    if (find_sorted_endpoint(true, row)) {
+        if (row == npos)
+            return util::none;
+        return realm::get<T>(*m_table, row);
+    }
     if (m_mode == Mode::Query)
         evaluate_query_if_needed(); // avoid running the query twice (for size() and for get())
     return try_get<T>(size() - 1);
@@ -253,25 +448,38 @@ void Results::evaluate_query_if_needed(bool wants_notifications)
         return;
     }
 
+    AuditInterface* audit = nullptr;
     switch (m_mode) {
         case Mode::Empty:
         case Mode::Table:
         case Mode::LinkView:
             return;
         case Mode::Query:
-            m_query.sync_view_if_needed();
-            m_table_view = m_query.find_all(m_descriptor_ordering);
-            m_mode = Mode::TableView;
-            REALM_FALLTHROUGH;
         case Mode::TableView:
-            if (wants_notifications)
-                prepare_async(ForCallback{false});
-            m_has_used_table_view = true;
-            m_table_view.sync_if_needed();
-            if (auto audit = m_realm->audit_context())
-                audit->record_query(m_realm->read_transaction_version(), m_table_view);
+            // Apply the audit policy before evaluating anything, so that a
+            // query which isn't recorded only costs the check
+            audit = m_realm->audit_context(AuditEvent::Query, m_table.get());
             break;
     }
+
+    if (m_mode == Mode::Query) {
+        m_query.sync_view_if_needed();
+        m_table_view = m_query.find_all(m_descriptor_ordering);
+        m_row_positions = nullptr;
+        m_mode = Mode::TableView;
+    }
+
+    if (wants_notifications)
+        prepare_async(ForCallback{false});
+    m_has_used_table_view = true;
+    // Only modify the TableView if it has to be rerun, as it may be
+    // shared with snapshots of this Results
+    if (!table_view_is_confirmed() && !m_table_view->is_in_sync()) {
+        m_table_view.mutate().sync_if_needed();
+        m_row_positions = nullptr;
+    }
+    if (audit)
+        audit->record_query(m_realm->read_transaction_version(), *m_table_view);
 }
 
 template<>
@@ -301,11 +509,55 @@ size_t Results::index_of(RowExpr const& row)
         case Mode::Query:
         case Mode::TableView:
             evaluate_query_if_needed();
-            return m_table_view.find_by_source_ndx(row.get_index());
+            return find_in_table_view(row.get_index());
     }
     REALM_COMPILER_HINT_UNREACHABLE();
 }
 
+size_t Results::find_in_table_view(size_t row_ndx)
+{
+    // Below this size searching the TableView is cheap enough that building
+    // the map of positions isn't worth it
+    static constexpr size_t min_rows_for_map = 1024;
+
+    auto& tv = *m_table_view;
+    if (tv.size() < min_rows_for_map)
+        return tv.find_by_source_ndx(row_ndx);
+
+    if (!m_row_positions || m_row_positions->table_view != &tv) {
+        m_row_positions = nullptr;
+        // Lookups which happen only once per TableView just search it
+        if (m_searched_table_view != &tv) {
+            m_searched_table_view = &tv;
+            return tv.find_by_source_ndx(row_ndx);
+        }
+
+        auto positions = std::make_shared<RowPositions>();
+        positions->table_view = &tv;
+        positions->rows.reserve(tv.size());
+        for (size_t i = 0, size = tv.size(); i < size; ++i)
+            positions->rows.push_back({tv.get_source_ndx(i), i});
+        std::sort(positions->rows.begin(), positions->rows.end());
+        // Rows which appear more than once (which only LinkViews can produce)
+        // could end up with the wrong position being verified after the
+        // TableView changes, so such TableViews are always searched
+        auto duplicate = std::adjacent_find(positions->rows.begin(), positions->rows.end(),
+                                            [](auto& a, auto& b) { return a.first == b.first; });
+        if (duplicate != positions->rows.end())
+            positions->rows.clear();
+        m_row_positions = std::move(positions);
+    }
+
+    auto& rows = m_row_positions->rows;
+    auto it = std::lower_bound(rows.begin(), rows.end(), std::make_pair(row_ndx, size_t(0)));
+    if (it != rows.end() && it->first == row_ndx && it->second < tv.size()
+        && tv.get_source_ndx(it->second) == row_ndx)
+        return it->second;
+    // Either the row isn't in the TableView or the TableView has changed
+    // since the map was built
+    return tv.find_by_source_ndx(row_ndx);
+}
+
 template<typename T>
 size_t Results::index_of(T const& value)
 {
@@ -320,7 +572,7 @@ size_t Results::index_of(T const& value)
         case Mode::Query:
         case Mode::TableView:
             evaluate_query_if_needed();
-            return m_table_view.find_first(0, value);
+            return m_table_view->find_first(0, value);
     }
     REALM_COMPILER_HINT_UNREACHABLE();
 }
@@ -374,7 +626,7 @@ util::Optional<Mixed> Results::aggregate(size_t column,
     prepare_for_aggregate(column, name);
 
     auto do_agg = [&](auto const& getter) {
-        return Mixed(m_mode == Mode::Table ? getter(*m_table) : getter(m_table_view));
+        return Mixed(m_mode == Mode::Table ? getter(*m_table) : getter(*m_table_view));
     };
     switch (m_table->get_column_type(column)) {
         case type_Timestamp: return do_agg(agg_timestamp);
@@ -385,8 +637,26 @@ util::Optional<Mixed> Results::aggregate(size_t column,
     }
 }
 
+bool Results::get_precomputed_aggregate(size_t column, AggregateKind kind, util::Optional<Mixed>& value)
+{
+    // The value delivered by the notifier is only usable if this Results is
+    // still showing the version it was calculated for
+    validate_read();
+    if (!m_notifier || m_update_policy != UpdatePolicy::Auto || m_realm->is_in_transaction())
+        return false;
+    auto observer = m_notifier->get_delivered_aggregate(column, kind, m_realm->read_transaction_version());
+    if (!observer)
+        return false;
+    value = observer->delivered_value();
+    return true;
+}
+
 util::Optional<Mixed> Results::max(size_t column)
 {
+    util::Optional<Mixed> value;
+    if (get_precomputed_aggregate(column, AggregateKind::Max, value))
+        return value;
+
     size_t return_ndx = npos;
     auto results = aggregate(column, "max",
                              [&](auto const& table) { return table.maximum_int(column, &return_ndx); },
@@ -398,6 +668,10 @@ util::Optional<Mixed> Results::max(size_t column)
 
 util::Optional<Mixed> Results::min(size_t column)
 {
+    util::Optional<Mixed> value;
+    if (get_precomputed_aggregate(column, AggregateKind::Min, value))
+        return value;
+
     size_t return_ndx = npos;
     auto results = aggregate(column, "min",
                              [&](auto const& table) { return table.minimum_int(column, &return_ndx); },
@@ -409,6 +683,10 @@ util::Optional<Mixed> Results::min(size_t column)
 
 util::Optional<Mixed> Results::sum(size_t column)
 {
+    util::Optional<Mixed> value;
+    if (get_precomputed_aggregate(column, AggregateKind::Sum, value))
+        return value;
+
     return aggregate(column, "sum",
                      [=](auto const& table) { return table.sum_int(column); },
                      [=](auto const& table) { return table.sum_float(column); },
@@ -418,6 +696,10 @@ util::Optional<Mixed> Results::sum(size_t column)
 
 util::Optional<double> Results::average(size_t column)
 {
+    util::Optional<Mixed> value;
+    if (get_precomputed_aggregate(column, AggregateKind::Average, value))
+        return value ? util::make_optional(value->get_double()) : none;
+
     size_t value_count = 0;
     auto results = aggregate(column, "average",
                              [&](auto const& table) { return table.average_int(column, &value_count); },
@@ -427,6 +709,26 @@ util::Optional<double> Results::average(size_t column)
     return value_count == 0 ? none : util::make_optional(results->get_double());
 }
 
+// Check if the TableView contains each row of the table exactly once, in which
+// case clearing it is equivalent to clearing the table
+static bool contains_every_row(TableView const& tv, Table const& table)
+{
+    size_t size = table.size();
+    if (tv.size() != size)
+        return false;
+
+    std::vector<bool> seen(size);
+    for (size_t i = 0; i < size; ++i) {
+        if (!tv.is_row_attached(i))
+            return false;
+        size_t row_ndx = tv.get_source_ndx(i);
+        if (seen[row_ndx])
+            return false;
+        seen[row_ndx] = true;
+    }
+    return true;
+}
+
 void Results::clear()
 {
     switch (m_mode) {
@@ -446,13 +748,21 @@ void Results::clear()
             validate_write();
             evaluate_query_if_needed();
 
+            // Clearing the table is a single instruction in the transaction
+            // log rather than one per row, and lets notifiers skip diffing the
+            // old rows against the new ones
+            if (!m_realm->is_partial() && contains_every_row(*m_table_view, *m_table)) {
+                m_table->clear();
+                break;
+            }
+
             switch (m_update_policy) {
                 case UpdatePolicy::Auto:
-                    m_table_view.clear(RemoveMode::unordered);
+                    m_table_view.mutate().clear(RemoveMode::unordered);
                     break;
                 case UpdatePolicy::Never: {
                     // Copy the TableView because a frozen Results shouldn't let its size() change.
-                    TableView copy(m_table_view);
+                    TableView copy(*m_table_view);
                     copy.clear(RemoveMode::unordered);
                     break;
                 }
@@ -492,17 +802,18 @@ Query Results::get_query() const
         case Mode::TableView: {
             // A TableView has an associated Query if it was produced by Query::find_all. This is indicated
             // by TableView::get_query returning a Query with a non-null table.
-            Query query = m_table_view.get_query();
+            Query query = m_table_view->get_query();
             if (query.get_table()) {
                 return query;
             }
 
             // The TableView has no associated query so create one with no conditions that is restricted
             // to the rows in the TableView.
-            if (m_update_policy == UpdatePolicy::Auto) {
-                m_table_view.sync_if_needed();
+            if (m_update_policy == UpdatePolicy::Auto && !m_table_view->is_in_sync()) {
+                m_table_view.mutate().sync_if_needed();
+                m_row_positions = nullptr;
             }
-            return Query(*m_table, std::unique_ptr<TableViewBase>(new TableView(m_table_view)));
+            return Query(*m_table, std::unique_ptr<TableViewBase>(new TableView(*m_table_view)));
         }
         case Mode::LinkView:
             return m_table->where(m_link_view);
@@ -525,7 +836,7 @@ TableView Results::get_tableview()
         case Mode::Query:
         case Mode::TableView:
             evaluate_query_if_needed();
-            return m_table_view;
+            return *m_table_view;
         case Mode::Table:
             return m_table->where().find_all();
     }
@@ -573,6 +884,18 @@ static std::vector<size_t> parse_keypath(StringData keypath, Schema const& schem
     return indices;
 }
 
+std::vector<size_t> Results::resolve_keypath(StringData keypath) const
+{
+    auto& object_schema = get_object_schema();
+    auto lock = Realm::Internal::lock_if_frozen(*m_realm);
+    auto& cache = Realm::Internal::get_keypath_cache(*m_realm)[object_schema.name];
+    std::string key(keypath);
+    auto it = cache.find(key);
+    if (it == cache.end())
+        it = cache.emplace(std::move(key), parse_keypath(keypath, m_realm->schema(), &object_schema)).first;
+    return it->second;
+}
+
 Results Results::sort(std::vector<std::pair<std::string, bool>> const& keypaths) const
 {
     if (keypaths.empty())
@@ -593,12 +916,277 @@ Results Results::sort(std::vector<std::pair<std::string, bool>> const& keypaths)
     ascending.reserve(keypaths.size());
 
     for (auto& keypath : keypaths) {
-        column_indices.push_back(parse_keypath(keypath.first, m_realm->schema(), &get_object_schema()));
+        column_indices.push_back(resolve_keypath(keypath.first));
         ascending.push_back(keypath.second);
     }
     return sort({*m_table, std::move(column_indices), std::move(ascending)});
 }
 
+namespace {
+// The values of a single sort column for each row being sorted, compared in
+// the same way as core's SortDescriptor: nulls before all other values when
+// ascending, and ties broken by the original order of the rows
+struct SortColumn {
+    size_t column;
+    DataType type;
+    bool ascending;
+    std::vector<bool> nulls;
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<Timestamp> timestamps;
+
+    // Returns false if the values can't be compared in the same way as core
+    bool read(Table const& table, std::vector<size_t> const& rows)
+    {
+        size_t col = column;
+        bool nullable = table.is_nullable(col);
+        if (nullable)
+            nulls.resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (nullable && table.is_null(col, rows[i])) {
+                nulls[i] = true;
+                if (type == type_Timestamp)
+                    timestamps.emplace_back();
+                else if (type == type_Float || type == type_Double)
+                    doubles.push_back(0);
+                else
+                    ints.push_back(0);
+                continue;
+            }
+            switch (type) {
+                case type_Int:  ints.push_back(table.get_int(col, rows[i])); break;
+                case type_Bool: ints.push_back(table.get_bool(col, rows[i])); break;
+                case type_Float:
+                case type_Double: {
+                    double value = type == type_Float ? table.get_float(col, rows[i]) : table.get_double(col, rows[i]);
+                    if (std::isnan(value))
+                        return false;
+                    doubles.push_back(value);
+                    break;
+                }
+                case type_Timestamp: timestamps.push_back(table.get_timestamp(col, rows[i])); break;
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    int compare(size_t a, size_t b) const
+    {
+        bool null_a = !nulls.empty() && nulls[a], null_b = !nulls.empty() && nulls[b];
+        if (null_a || null_b)
+            return null_a == null_b ? 0 : null_a ? -1 : 1;
+        switch (type) {
+            case type_Float:
+            case type_Double:
+                return doubles[a] < doubles[b] ? -1 : doubles[b] < doubles[a];
+            case type_Timestamp:
+                return timestamps[a] < timestamps[b] ? -1 : timestamps[b] < timestamps[a];
+            default:
+                return ints[a] < ints[b] ? -1 : ints[b] < ints[a];
+        }
+    }
+};
+} // anonymous namespace
+
+std::vector<size_t> Results::get_sorted_row_indices(std::vector<std::pair<std::string, bool>> const& keypaths,
+                                                    util::ThreadPool& pool, size_t parallel_threshold)
+{
+    validate_read();
+    auto sort_with_core = [&] {
+        auto sorted = sort(keypaths);
+        std::vector<size_t> rows(sorted.size());
+        rows.resize(sorted.get_row_indices(0, rows.size(), rows.data()));
+        return rows;
+    };
+    if (!m_table || keypaths.empty() || get_type() != PropertyType::Object)
+        return sort_with_core();
+
+    std::vector<SortColumn> columns;
+    columns.reserve(keypaths.size());
+    for (auto& keypath : keypaths) {
+        auto indices = resolve_keypath(keypath.first);
+        if (indices.size() != 1)
+            return sort_with_core();
+        auto type = m_table->get_column_type(indices[0]);
+        if (type != type_Int && type != type_Bool && type != type_Float && type != type_Double && type != type_Timestamp)
+            return sort_with_core();
+        columns.push_back({indices[0], type, keypath.second, {}, {}, {}, {}});
+    }
+
+    size_t row_count = size();
+    if (row_count < parallel_threshold)
+        return sort_with_core();
+
+    std::vector<size_t> rows(row_count);
+    rows.resize(get_row_indices(0, rows.size(), rows.data()));
+    // A snapshot's deleted rows aren't in the sorted Results
+    rows.erase(std::remove(rows.begin(), rows.end(), npos), rows.end());
+
+    // Reading from the table isn't thread-safe, so all of the values are
+    // read on this thread and only the comparisons are done in parallel
+    for (auto& column : columns) {
+        if (!column.read(*m_table, rows))
+            return sort_with_core();
+    }
+
+    std::vector<size_t> order(rows.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    util::parallel_stable_sort(order, [&](size_t a, size_t b) {
+        for (auto& column : columns) {
+            int cmp = column.compare(a, b);
+            if (cmp != 0)
+                return column.ascending ? cmp < 0 : cmp > 0;
+        }
+        return false;
+    }, pool);
+
+    std::vector<size_t> sorted_rows;
+    sorted_rows.reserve(order.size());
+    for (auto i : order)
+        sorted_rows.push_back(rows[i]);
+    return sorted_rows;
+}
+
+namespace {
+// The values of one distinct key path for each row, hashed and compared by
+// value. Links along the key path are followed when reading, and rows with a
+// null link before the final property are excluded as they are by core's
+// DistinctDescriptor.
+struct DistinctColumn {
+    std::vector<size_t> path;
+    DataType type;
+    std::vector<bool> nulls;
+    // Int, Bool and Link values, with links stored as the target row index
+    std::vector<int64_t> ints;
+    std::vector<StringData> strings;
+
+    // Returns false if the key path can't be handled here
+    bool read(Table const& table, std::vector<size_t> const& rows, std::vector<bool>& excluded)
+    {
+        // The table containing each column of the path
+        std::vector<Table const*> tables = {&table};
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            if (tables.back()->get_column_type(path[i]) != type_Link)
+                return false;
+            tables.push_back(tables.back()->get_link_target(path[i]).get());
+        }
+        auto& last_table = *tables.back();
+        size_t col = path.back();
+        type = last_table.get_column_type(col);
+        if (type != type_Int && type != type_Bool && type != type_String && type != type_Link)
+            return false;
+        bool nullable = type == type_Link || last_table.is_nullable(col);
+
+        nulls.resize(rows.size());
+        if (type == type_String)
+            strings.resize(rows.size());
+        else
+            ints.resize(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (excluded[i])
+                continue;
+            size_t row = rows[i];
+            for (size_t j = 0; j + 1 < path.size(); ++j) {
+                if (tables[j]->is_null_link(path[j], row)) {
+                    row = npos;
+                    break;
+                }
+                row = tables[j]->get_link(path[j], row);
+            }
+            if (row == npos) {
+                excluded[i] = true;
+                continue;
+            }
+            if (nullable && (type == type_Link ? last_table.is_null_link(col, row) : last_table.is_null(col, row))) {
+                nulls[i] = true;
+                continue;
+            }
+            switch (type) {
+                case type_Int:    ints[i] = last_table.get_int(col, row); break;
+                case type_Bool:   ints[i] = last_table.get_bool(col, row); break;
+                case type_Link:   ints[i] = last_table.get_link(col, row); break;
+                case type_String: strings[i] = last_table.get_string(col, row); break;
+                default: REALM_UNREACHABLE();
+            }
+        }
+        return true;
+    }
+
+    size_t hash(size_t i) const
+    {
+        if (nulls[i])
+            return 0;
+        if (type != type_String)
+            return std::hash<int64_t>()(ints[i]);
+        // FNV-1a
+        size_t h = 14695981039346656037ULL & size_t(-1);
+        for (char c : strings[i]) {
+            h ^= static_cast<unsigned char>(c);
+            h *= size_t(1099511628211ULL);
+        }
+        return h;
+    }
+
+    bool equal(size_t a, size_t b) const
+    {
+        if (nulls[a] || nulls[b])
+            return nulls[a] == nulls[b];
+        return type == type_String ? strings[a] == strings[b] : ints[a] == ints[b];
+    }
+};
+} // anonymous namespace
+
+std::vector<size_t> Results::get_distinct_row_indices(std::vector<std::string> const& keypaths)
+{
+    validate_read();
+    auto distinct_with_core = [&] {
+        auto unique = distinct(keypaths);
+        std::vector<size_t> rows(unique.size());
+        rows.resize(unique.get_row_indices(0, rows.size(), rows.data()));
+        return rows;
+    };
+    if (!m_table || keypaths.empty() || get_type() != PropertyType::Object)
+        return distinct_with_core();
+
+    std::vector<DistinctColumn> columns(keypaths.size());
+    for (size_t i = 0; i < keypaths.size(); ++i)
+        columns[i].path = resolve_keypath(keypaths[i]);
+
+    std::vector<size_t> rows(size());
+    rows.resize(get_row_indices(0, rows.size(), rows.data()));
+    // A snapshot's deleted rows aren't in the distinct Results
+    rows.erase(std::remove(rows.begin(), rows.end(), npos), rows.end());
+
+    std::vector<bool> excluded(rows.size());
+    for (auto& column : columns) {
+        if (!column.read(*m_table, rows, excluded))
+            return distinct_with_core();
+    }
+
+    std::vector<size_t> hashes(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        size_t h = 0;
+        for (auto& column : columns)
+            h ^= column.hash(i) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        hashes[i] = h;
+    }
+    auto hash = [&](size_t i) { return hashes[i]; };
+    auto equal = [&](size_t a, size_t b) {
+        return std::all_of(columns.begin(), columns.end(), [&](auto& column) { return column.equal(a, b); });
+    };
+    std::unordered_set<size_t, decltype(hash), decltype(equal)> seen(rows.size(), hash, equal);
+
+    // Keep the first row with each distinct value, in the existing order
+    std::vector<size_t> unique_rows;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!excluded[i] && seen.insert(i).second)
+            unique_rows.push_back(rows[i]);
+    }
+    return unique_rows;
+}
+
 Results Results::sort(SortDescriptor&& sort) const
 {
     if (m_mode == Mode::LinkView)
@@ -670,7 +1258,7 @@ Results Results::distinct(std::vector<std::string> const& keypaths) const
     std::vector<std::vector<size_t>> column_indices;
     column_indices.reserve(keypaths.size());
     for (auto& keypath : keypaths)
-        column_indices.push_back(parse_keypath(keypath, m_realm->schema(), &get_object_schema()));
+        column_indices.push_back(resolve_keypath(keypath));
     return distinct({*m_table, std::move(column_indices)});
 }
 
@@ -697,14 +1285,14 @@ Results Results::snapshot() &&
         case Mode::Query:
         case Mode::TableView:
             evaluate_query_if_needed(false);
-            m_notifier.reset();
+            release_notifier();
             m_update_policy = UpdatePolicy::Never;
             return std::move(*this);
     }
     REALM_COMPILER_HINT_UNREACHABLE();
 }
 
-void Results::prepare_async(ForCallback force)
+void Results::prepare_async(ForCallback force, bool wants_background_updates)
 {
     if (m_notifier) {
         return;
@@ -714,6 +1302,11 @@ void Results::prepare_async(ForCallback force)
             throw InvalidTransactionException("Cannot create asynchronous query for immutable Realms");
         return;
     }
+    if (m_realm->is_frozen()) {
+        if (force)
+            throw InvalidTransactionException("Cannot create asynchronous query for frozen Realms");
+        return;
+    }
     if (m_realm->is_in_transaction()) {
         if (force)
             throw InvalidTransactionException("Cannot create asynchronous query while in a write transaction");
@@ -734,15 +1327,88 @@ void Results::prepare_async(ForCallback force)
             return;
     }
 
-    m_wants_background_updates = true;
-    m_notifier = std::make_shared<_impl::ResultsNotifier>(*this);
+    m_wants_background_updates = wants_background_updates;
+
+    // Results with identical queries on the same Realm instance share a
+    // notifier so that the query is only run once for each commit. Results
+    // created directly from a TableView may have rows or an ordering which
+    // isn't captured by the query, so those always get their own notifier.
+    std::string key;
+    if (!m_link_view && (m_mode == Mode::Table || m_query.get_table()))
+        key = _impl::ResultsNotifier::sharing_key_for(get_query(), m_descriptor_ordering);
+    if (!key.empty()) {
+        if (auto notifier = _impl::RealmCoordinator::find_shared_results_notifier(*m_realm, key)) {
+            notifier->add_target(*this);
+            m_notifier = std::move(notifier);
+            return;
+        }
+    }
+
+    m_notifier = std::make_shared<_impl::ResultsNotifier>(*this, std::move(key));
     _impl::RealmCoordinator::register_notifier(m_notifier);
 }
 
-NotificationToken Results::add_notification_callback(CollectionChangeCallback cb) &
+void Results::release_notifier()
+{
+    if (m_notifier && !m_notifier->remove_target(*this))
+        m_notifier.release();
+    else
+        m_notifier.reset();
+}
+
+NotificationToken Results::add_notification_callback(CollectionChangeCallback cb, NotificationPriority priority) &
+{
+    prepare_async(ForCallback{true});
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority)};
+}
+
+NotificationToken Results::add_notification_callback(CollectionChangeCallback cb,
+                                                     std::vector<std::string> const& key_paths,
+                                                     NotificationPriority priority) &
 {
+    if (get_type() != PropertyType::Object)
+        throw std::logic_error("Key path filtered notifications are only supported for Results of objects.");
+    std::shared_ptr<const std::vector<_impl::DeepChangeChecker::RelatedTable>> filter;
+    if (m_table) {
+        filter = std::make_shared<const std::vector<_impl::DeepChangeChecker::RelatedTable>>(
+            _impl::DeepChangeChecker::find_related_tables(*m_realm, get_object_schema(), key_paths));
+    }
     prepare_async(ForCallback{true});
-    return {m_notifier, m_notifier->add_callback(std::move(cb))};
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority, std::move(filter))};
+}
+
+NotificationToken Results::observe_aggregate(size_t column, AggregateKind kind, AggregateCallback callback,
+                                             NotificationPriority priority) &
+{
+    validate_read();
+    DataType type = type_Int;
+    if (m_table && kind != AggregateKind::Count) {
+        if (column >= m_table->get_column_count())
+            throw OutOfBoundsIndexException{column, m_table->get_column_count()};
+        type = m_table->get_column_type(column);
+        bool is_numeric = type == type_Int || type == type_Float || type == type_Double;
+        bool supported = kind == AggregateKind::Min || kind == AggregateKind::Max ? is_numeric || type == type_Timestamp : is_numeric;
+        if (!supported) {
+            const char* name = kind == AggregateKind::Sum ? "sum" : kind == AggregateKind::Average ? "average"
+                             : kind == AggregateKind::Min ? "min" : "max";
+            throw UnsupportedColumnTypeException{column, m_table.get(), name};
+        }
+    }
+
+    // Observing an aggregate doesn't require the rows on this thread, and if
+    // the only thing observed is the count the notifier can skip running the
+    // query entirely
+    prepare_async(ForCallback{true}, false);
+    auto observer = m_notifier->add_aggregate(column, kind, type);
+    auto cb = [observer, callback = std::move(callback)](CollectionChangeSet const&, std::exception_ptr err) {
+        if (err)
+            callback(util::none, err);
+        else
+            callback(observer->delivered_value(), nullptr);
+    };
+    NotificationToken token{m_notifier, m_notifier->add_callback(std::move(cb), priority)};
+    observer->set_has_callback();
+    return token;
 }
 
 bool Results::is_in_table_order() const
@@ -756,7 +1422,7 @@ bool Results::is_in_table_order() const
         case Mode::Query:
             return m_query.produces_results_in_table_order() && !m_descriptor_ordering.will_apply_sort();
         case Mode::TableView:
-            return m_table_view.is_in_table_order();
+            return m_table_view->is_in_table_order();
     }
     REALM_COMPILER_HINT_UNREACHABLE();
 }
@@ -771,18 +1437,46 @@ void Results::Internal::set_table_view(Results& results, TableView &&tv)
     }
 
     results.m_table_view = std::move(tv);
+    results.m_row_positions = nullptr;
     results.m_mode = Mode::TableView;
     results.m_has_used_table_view = false;
-    REALM_ASSERT(results.m_table_view.is_in_sync());
-    REALM_ASSERT(results.m_table_view.is_attached());
+    results.m_table_view_confirmed_version = util::none;
+    REALM_ASSERT(results.m_table_view->is_in_sync());
+    REALM_ASSERT(results.m_table_view->is_attached());
+}
+
+void Results::Internal::confirm_table_view(Results& results, std::vector<size_t> const& rows)
+{
+    REALM_ASSERT(results.m_update_policy != UpdatePolicy::Never);
+    auto& tv = *results.m_table_view;
+    if (results.m_mode != Mode::TableView || !tv.is_attached() || tv.size() != rows.size())
+        return;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (tv.get_source_ndx(i) != rows[i])
+            return;
+    }
+
+    results.m_wants_background_updates = results.m_has_used_table_view;
+    results.m_has_used_table_view = false;
+    results.m_table_view_confirmed_version = results.m_realm->read_transaction_version();
+}
+
+bool Results::table_view_is_confirmed() const
+{
+    // Writes made in a transaction on this thread aren't covered by the notifier
+    return m_table_view_confirmed_version && !m_realm->is_in_transaction()
+        && *m_table_view_confirmed_version == m_realm->read_transaction_version();
 }
 #define REALM_RESULTS_TYPE(T) \
     template T Results::get<T>(size_t); \
+    template size_t Results::get_range<T>(size_t, size_t, T*); \
+    template size_t Results::export_column<T>(size_t, T*, size_t); \
     template util::Optional<T> Results::first<T>(); \
     template util::Optional<T> Results::last<T>(); \
     template size_t Results::index_of<T>(T const&);
 
 template RowExpr Results::get<RowExpr>(size_t);
+template size_t Results::get_range<RowExpr>(size_t, size_t, RowExpr*);
 template util::Optional<RowExpr> Results::first<RowExpr>();
 template util::Optional<RowExpr> Results::last<RowExpr>();
 
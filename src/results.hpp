@@ -26,6 +26,7 @@
 #include "object_schema.hpp"
 #include "property.hpp"
 #include "shared_realm.hpp"
+#include "util/copy_on_write.hpp"
 
 #include <realm/table_view.hpp>
 #include <realm/util/optional.hpp>
@@ -37,6 +38,9 @@ class ObjectSchema;
 namespace _impl {
     class ResultsNotifier;
 }
+namespace util {
+    class ThreadPool;
+}
 
 class Results {
 public:
@@ -94,6 +98,18 @@ public:
     template<typename Context>
     auto get(Context&, size_t index);
 
+    // Write the row accessors for up to `count` rows starting at `begin` to
+    // `out`, returning the number written. Fewer than `count` are written if
+    // the end of the Results is reached. Validation and evaluation of the
+    // query are done once for the entire range rather than once per row.
+    template<typename T = RowExpr>
+    size_t get_range(size_t begin, size_t count, T* out);
+
+    // Write the table row indices for up to `count` rows starting at `begin`
+    // to `out`, returning the number written. Rows which have been deleted from
+    // a snapshot are reported as npos.
+    size_t get_row_indices(size_t begin, size_t count, size_t* out);
+
     // Get a row accessor for the first/last row, or none if the results are empty
     // More efficient than calling size()+get()
     template<typename T = RowExpr>
@@ -120,10 +136,29 @@ public:
     Results sort(SortDescriptor&& sort) const;
     Results sort(std::vector<std::pair<std::string, bool>> const& keypaths) const;
 
+    // Get the table row indices of the rows of this Results in the order
+    // which sort(keypaths) would produce. When there are at least
+    // `parallel_threshold` rows and every keypath is a single Int, Bool,
+    // Float, Double or Timestamp property, the sort values are read on this
+    // thread and then sorted using the threads of `pool`. Other sorts (and
+    // sorts on floating point columns which contain NaN) are done by core on
+    // the calling thread.
+    std::vector<size_t> get_sorted_row_indices(std::vector<std::pair<std::string, bool>> const& keypaths,
+                                               util::ThreadPool& pool, size_t parallel_threshold = 100000);
+
     // Create a new Results by removing duplicates
     Results distinct(DistinctDescriptor&& uniqueness) const;
     Results distinct(std::vector<std::string> const& keypaths) const;
 
+    // Get the table row indices of the rows which distinct(keypaths) would
+    // produce, keeping the first of each set of duplicates in the current
+    // order. When every keypath ends in an Int, Bool, String or Link property
+    // (following any number of links), duplicates are found by hashing the
+    // values of each row, which takes linear time rather than sorting the
+    // rows as core does. Each row's hash depends only on that row's values.
+    // Other keypaths are handled by core.
+    std::vector<size_t> get_distinct_row_indices(std::vector<std::string> const& keypaths);
+
     // Create a new Results with only the first `max_count` entries
     Results limit(size_t max_count) const;
 
@@ -131,6 +166,8 @@ public:
     Results apply_ordering(DescriptorOrdering&& ordering);
 
     // Return a snapshot of this Results that never updates to reflect changes in the underlying data.
+    // The snapshot shares its rows with this Results until this Results next
+    // has to rerun its query, so snapshotting evaluated Results doesn't copy them.
     Results snapshot() const &;
     Results snapshot() &&;
 
@@ -144,6 +181,15 @@ public:
     util::Optional<double> average(size_t column=0);
     util::Optional<Mixed> sum(size_t column=0);
 
+    // Copy the values of the given column for the first `size` rows into `out`,
+    // returning the number of values written. T must be the column's type,
+    // wrapped in util::Optional for nullable bool, int, float and double
+    // columns. Rows which have been deleted from a snapshot produce T{}.
+    // Throws UnsupportedColumnTypeException if T does not match the column
+    // Throws OutOfBoundsIndexException for an out-of-bounds column
+    template<typename T>
+    size_t export_column(size_t column, T* out, size_t size);
+
     enum class Mode {
         Empty, // Backed by nothing (for missing tables)
         Table, // Backed directly by a Table
@@ -210,7 +256,34 @@ public:
     // and then rerun after each commit (if needed) and redelivered if it changed
     template<typename Func>
     NotificationToken async(Func&& target);
-    NotificationToken add_notification_callback(CollectionChangeCallback cb) &;
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
+    // Add a callback which only needs to be told about modifications to the
+    // given key paths (such as "name" or "dog.name") of the objects in the
+    // Results. Insertions and deletions are reported as usual. Throws if a key
+    // path is invalid or this Results is not of objects.
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                std::vector<std::string> const& key_paths,
+                                                NotificationPriority priority=NotificationPriority::Interactive) &;
+
+    // Observe the value of an aggregate over the given column. The callback is
+    // called with the initial value and then again each time the results
+    // change. The value is maintained on the background thread from the rows
+    // which were inserted, deleted or modified rather than by recomputing it
+    // over every row. Count is the number of rows and ignores the column, and
+    // the other kinds produce the same values as the synchronous functions.
+    // While the Realm is at the version of the most recent notification (and
+    // not in a write transaction), size(), sum(), min(), max() and average()
+    // return the delivered value rather than computing it on this thread.
+    // Sums of floating point columns may then differ in the last bits from a
+    // recomputed sum, as the values are added in a different order.
+    // Throws UnsupportedColumnTypeException if the aggregate isn't supported
+    // for the column's type
+    // Throws OutOfBoundsIndexException for an out-of-bounds column
+    enum class AggregateKind { Count, Sum, Min, Max, Average };
+    using AggregateCallback = std::function<void (util::Optional<Mixed>, std::exception_ptr)>;
+    NotificationToken observe_aggregate(size_t column, AggregateKind kind, AggregateCallback callback,
+                                        NotificationPriority priority=NotificationPriority::Interactive) &;
 
     bool wants_background_updates() const { return m_wants_background_updates; }
 
@@ -222,6 +295,10 @@ public:
     class Internal {
         friend class _impl::ResultsNotifier;
         static void set_table_view(Results& results, TableView&& tv);
+        // Mark the current TableView as being up to date for the current
+        // read version if it contains exactly the given rows, even though the
+        // table has changed since it was last synchronized
+        static void confirm_table_view(Results& results, std::vector<size_t> const& rows);
     };
 
     template<typename Context> auto first(Context&);
@@ -250,7 +327,9 @@ private:
     std::shared_ptr<Realm> m_realm;
     mutable const ObjectSchema *m_object_schema = nullptr;
     Query m_query;
-    TableView m_table_view;
+    // Shared between copies of this Results (including snapshots) until one
+    // of them needs to modify it
+    util::CopyOnWrite<TableView> m_table_view;
     LinkViewRef m_link_view;
     TableRef m_table;
     DescriptorOrdering m_descriptor_ordering;
@@ -261,6 +340,31 @@ private:
     UpdatePolicy m_update_policy = UpdatePolicy::Auto;
     bool m_has_used_table_view = false;
     bool m_wants_background_updates = true;
+    // The read version at which the notifier confirmed that m_table_view is
+    // still current despite not being in sync with its table
+    util::Optional<VersionID> m_table_view_confirmed_version;
+
+    // The position of each row in a large TableView, sorted by row index, so
+    // that repeated calls to index_of() don't each have to search the whole
+    // TableView. Built on the second lookup in the same TableView, and shared
+    // between copies of this Results along with the TableView. Positions are
+    // checked against the TableView before being used, as the TableView can
+    // be updated in place by core.
+    struct RowPositions {
+        TableView const* table_view;
+        std::vector<std::pair<size_t, size_t>> rows;
+    };
+    std::shared_ptr<const RowPositions> m_row_positions;
+    TableView const* m_searched_table_view = nullptr;
+    // The result of the last count of m_query in Mode::Query and the read
+    // version it was counted at, so that size() doesn't rerun the query
+    // until there's a new version
+    util::Optional<std::pair<VersionID, size_t>> m_query_count;
+    // The rows found by find_sorted_endpoint() and the read version they
+    // were found at, so that repeated calls to first() and last() don't each
+    // rescan the query until there's a new version
+    util::Optional<std::pair<VersionID, size_t>> m_sorted_first_row;
+    util::Optional<std::pair<VersionID, size_t>> m_sorted_last_row;
 
     bool update_linkview();
 
@@ -268,10 +372,25 @@ private:
     void validate_write() const;
 
     using ForCallback = util::TaggedBool<class ForCallback>;
-    void prepare_async(ForCallback);
+    // If `wants_background_updates` is false the notifier won't produce
+    // TableViews for this Results until it delivers one which is used
+    void prepare_async(ForCallback, bool wants_background_updates=true);
+    // Stop using m_notifier, unregistering it if no other Results share it
+    void release_notifier();
+    bool table_view_is_confirmed() const;
+    size_t find_in_table_view(size_t row_ndx);
 
     template<typename T>
     util::Optional<T> try_get(size_t);
+    // Find the first or last row of a sorted query with a single pass over
+    // the matching rows rather than by sorting all of them. Returns false if
+    // the ordering can't be evaluated this way, and otherwise sets `row` to
+    // the row found or to npos if nothing matches.
+    bool find_sorted_endpoint(bool last, size_t& row);
+
+    // Call fn(offset, row_ndx) for each row in the given range
+    template<typename Fn>
+    size_t for_each_row_in_range(size_t begin, size_t count, Fn&& fn);
 
     template<typename Int, typename Float, typename Double, typename Timestamp>
     util::Optional<Mixed> aggregate(size_t column,
@@ -279,6 +398,12 @@ private:
                                     Int agg_int, Float agg_float,
                                     Double agg_double, Timestamp agg_timestamp);
     void prepare_for_aggregate(size_t column, const char* name);
+    // Get the column indices for a sort or distinct key path, which are
+    // cached on the Realm until its schema changes
+    std::vector<size_t> resolve_keypath(StringData keypath) const;
+    // Get the value of an aggregate observed with observe_aggregate() if the
+    // notifier has delivered one for the version currently being read
+    bool get_precomputed_aggregate(size_t column, AggregateKind kind, util::Optional<Mixed>& value);
 
     void set_table_view(TableView&& tv);
 
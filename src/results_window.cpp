@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "results_window.hpp"
+
+#include "impl/realm_coordinator.hpp"
+#include "impl/results_notifier.hpp"
+#include "results.hpp"
+#include "shared_realm.hpp"
+
+using namespace realm;
+
+ResultsWindow::ResultsWindow(Results const& results, size_t offset, size_t count, size_t margin)
+: m_realm(results.get_realm())
+{
+    if (!m_realm)
+        throw std::logic_error("Cannot observe a window of Results which are not backed by a Realm.");
+    m_realm->verify_thread();
+    if (m_realm->config().immutable())
+        throw InvalidTransactionException("Cannot create asynchronous query for immutable Realms");
+    if (m_realm->is_frozen())
+        throw InvalidTransactionException("Cannot create asynchronous query for frozen Realms");
+    if (m_realm->is_in_transaction())
+        throw InvalidTransactionException("Cannot create asynchronous query while in a write transaction");
+
+    m_table = results.get_query().get_table();
+    if (!m_table)
+        throw std::logic_error("Cannot observe a window of Results which are not backed by a table.");
+
+    m_notifier = std::make_shared<_impl::ResultsNotifier>(results, _impl::ResultsNotifier::Window{offset, count, margin});
+    _impl::RealmCoordinator::register_notifier(m_notifier);
+}
+
+ResultsWindow::~ResultsWindow() = default;
+ResultsWindow::ResultsWindow(ResultsWindow&&) = default;
+ResultsWindow& ResultsWindow::operator=(ResultsWindow&&) = default;
+
+void ResultsWindow::move(size_t offset, size_t count)
+{
+    m_notifier->set_window(offset, count);
+}
+
+size_t ResultsWindow::offset() const noexcept
+{
+    auto& rows = m_notifier->window_rows();
+    return rows ? rows->offset : 0;
+}
+
+size_t ResultsWindow::size() const noexcept
+{
+    auto& rows = m_notifier->window_rows();
+    return rows ? rows->rows.size() : 0;
+}
+
+size_t ResultsWindow::get_row_index(size_t index) const
+{
+    m_realm->verify_thread();
+    size_t size = this->size();
+    if (index >= size)
+        throw Results::OutOfBoundsIndexException{index, size};
+    return m_notifier->window_rows()->rows[index];
+}
+
+RowExpr ResultsWindow::get(size_t index) const
+{
+    size_t row_ndx = get_row_index(index);
+    if (!m_table->is_attached() || row_ndx >= m_table->size())
+        throw Results::InvalidatedException();
+    return m_table->get(row_ndx);
+}
+
+NotificationToken ResultsWindow::add_notification_callback(CollectionChangeCallback cb, NotificationPriority priority) &
+{
+    return {m_notifier, m_notifier->add_callback(std::move(cb), priority)};
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_RESULTS_WINDOW_HPP
+#define REALM_RESULTS_WINDOW_HPP
+
+#include "collection_notifications.hpp"
+#include "impl/collection_notifier.hpp"
+
+#include <realm/row.hpp>
+#include <realm/table_ref.hpp>
+
+#include <memory>
+
+namespace realm {
+class Realm;
+class Results;
+
+namespace _impl {
+    class ResultsNotifier;
+}
+
+// A view of the rows [offset, offset + count) of some Results, for Results
+// which are too large to be worth observing in full. The background worker
+// only diffs and hands over the rows in the window, so the cost of each
+// notification depends on the size of the window rather than the size of the
+// Results, and the indices in the change sets passed to the callbacks are
+// relative to the start of the window.
+//
+// Moving the window to a range which was fetched by the previous run of the
+// query (the window plus `margin` rows on each side) does not require
+// rerunning the query.
+//
+// The rows in the window are only available once the first notification has
+// been delivered, and reflect the window as of the most recent notification
+// rather than the most recent call to move().
+class ResultsWindow {
+public:
+    static const size_t default_margin = 100;
+
+    ResultsWindow(Results const& results, size_t offset, size_t count, size_t margin = default_margin);
+    ~ResultsWindow();
+
+    ResultsWindow(ResultsWindow&&);
+    ResultsWindow& operator=(ResultsWindow&&);
+
+    // Change the range of the Results covered by the window. The callbacks
+    // are called with the changes from the old window to the new one once
+    // the new window has been calculated.
+    void move(size_t offset, size_t count);
+
+    // The offset within the Results of the first row of the window, and the
+    // number of rows in it, as of the most recent notification. There may be
+    // fewer rows than requested if the window extends past the end of the
+    // Results.
+    size_t offset() const noexcept;
+    size_t size() const noexcept;
+
+    // Get the row at the given index within the window
+    RowExpr get(size_t index) const;
+    // Get the index in the table of the row at the given index within the window
+    size_t get_row_index(size_t index) const;
+
+    NotificationToken add_notification_callback(CollectionChangeCallback cb,
+                                                NotificationPriority priority = NotificationPriority::Interactive) &;
+
+private:
+    std::shared_ptr<Realm> m_realm;
+    TableRef m_table;
+    _impl::CollectionNotifier::Handle<_impl::ResultsNotifier> m_notifier;
+};
+}
+
+#endif // REALM_RESULTS_WINDOW_HPP
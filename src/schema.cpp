@@ -22,6 +22,7 @@
 #include "object_store.hpp"
 #include "object_schema.hpp"
 #include "property.hpp"
+#include "util/string_hash.hpp"
 
 #include <algorithm>
 
@@ -43,15 +44,36 @@ Schema& Schema::operator=(Schema&&) = default;
 
 Schema::Schema(std::initializer_list<ObjectSchema> types) : Schema(base(types)) { }
 
+// Binary searching a handful of names is faster than hashing the name
+static const size_t small_schema_size = 8;
+
 Schema::Schema(base types) : base(std::move(types))
 {
     std::sort(begin(), end(), [](ObjectSchema const& lft, ObjectSchema const& rgt) {
         return lft.name < rgt.name;
     });
+    // The object schemas may have been built up a property at a time
+    for (auto& object_schema : *this)
+        object_schema.rebuild_property_index();
+
+    if (size() > small_schema_size) {
+        m_name_index.reserve(size());
+        for (size_t i = 0; i < size(); ++i)
+            m_name_index.emplace(util::string_hash((*this)[i].name), i);
+    }
 }
 
 Schema::iterator Schema::find(StringData name)
 {
+    if (!m_name_index.empty()) {
+        auto index_it = m_name_index.find(util::string_hash(name));
+        if (index_it != m_name_index.end() && index_it->second < size()) {
+            auto it = begin() + index_it->second;
+            if (it->name == name)
+                return it;
+        }
+    }
+
     auto it = std::lower_bound(begin(), end(), name, [](ObjectSchema const& lft, StringData rgt) {
         return lft.name < rgt;
     });
@@ -114,10 +136,39 @@ struct GetRemovedColumn {
 };
 }
 
+// Check if the persisted properties are the same and in the same order, which
+// is the common case when opening a Realm with an unchanged schema and is
+// much cheaper than looking up each property by name
+static bool properties_match(ObjectSchema const& existing_schema, ObjectSchema const& target_schema)
+{
+    if (existing_schema.fingerprint() != target_schema.fingerprint())
+        return false;
+    if (existing_schema.primary_key != target_schema.primary_key)
+        return false;
+    auto& existing_props = existing_schema.persisted_properties;
+    auto& target_props = target_schema.persisted_properties;
+    if (existing_props.size() != target_props.size())
+        return false;
+    for (size_t i = 0; i < existing_props.size(); ++i) {
+        auto& current_prop = existing_props[i];
+        auto& target_prop = target_props[i];
+        if (current_prop.type != target_prop.type || current_prop.name != target_prop.name ||
+            current_prop.object_type != target_prop.object_type)
+            return false;
+        // Mirrors the index checks below
+        if (target_prop.requires_index() ? !current_prop.is_indexed : current_prop.requires_index())
+            return false;
+    }
+    return true;
+}
+
 static void compare(ObjectSchema const& existing_schema,
                     ObjectSchema const& target_schema,
                     std::vector<SchemaChange>& changes)
 {
+    if (properties_match(existing_schema, target_schema))
+        return;
+
     for (auto& current_prop : existing_schema.persisted_properties) {
         auto target_prop = target_schema.property_for_name(current_prop.name);
 
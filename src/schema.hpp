@@ -20,6 +20,7 @@
 #define REALM_SCHEMA_HPP
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <realm/util/features.h>
@@ -45,7 +46,8 @@ public:
     Schema& operator=(Schema const&);
     Schema& operator=(Schema&&);
 
-    // find an ObjectSchema by name
+    // find an ObjectSchema by name, which for schemas with more than a few
+    // types uses a hash index of the names built when the schema is created
     iterator find(StringData name);
     const_iterator find(StringData name) const;
 
@@ -73,6 +75,11 @@ public:
     using base::size;
 
 private:
+    // Hash of each type name to its position in the (sorted) vector. Only
+    // hashes are stored so that copies of the schema can share the index, and
+    // lookups check the name found and fall back to a binary search.
+    std::unordered_map<size_t, size_t> m_name_index;
+
     template<typename T, typename U, typename Func>
     static void zip_matching(T&& a, U&& b, Func&& func);
 };
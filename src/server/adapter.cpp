@@ -22,6 +22,7 @@
 #include "impl/realm_coordinator.hpp"
 #include "object_schema.hpp"
 #include "object_store.hpp"
+#include "util/atomic_shared_ptr.hpp"
 
 #include <realm/sync/changeset_cooker.hpp>
 #include <realm/sync/changeset_parser.hpp>
@@ -30,20 +31,23 @@
 #include <realm/util/base64.hpp>
 
 #include <json.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 
-namespace {
-// This needs to appear before `using namespace realm`. After that,
-// realm::Schema's operator== becomes a candidate function to call for the
-// comparison of array values within json. This occurs in a SFINAE context
-// and so should simply be discarded as a candidate, but VC++ 2017 incorrectly
-// considers it a hard error.
-bool equals(nlohmann::json const& a, nlohmann::json const& b) {
-    return a == b;
-}
-} // anonymous namespace
-
 using namespace realm;
 
 using ObjectID = sync::ObjectID;
@@ -68,114 +72,607 @@ static PropertyType from_core_type(DataType type)
     }
 }
 
+// A value within a cooked instruction: the identity of an object or the new
+// value of one of its properties
+struct CookedValue {
+    enum class Type {
+        Null,
+        Int,
+        Bool,
+        Float,
+        Double,
+        String,
+        Data,
+        Date,
+    } type = Type::Null;
+    int64_t integer = 0; // Int, Bool and Date (in milliseconds)
+    double fnum = 0;     // Float and Double
+    std::string str;     // String and Data (unencoded)
+
+    CookedValue() = default;
+    CookedValue(std::nullptr_t) { }
+    CookedValue(int64_t value) : type(Type::Int), integer(value) { }
+    CookedValue(bool value) : type(Type::Bool), integer(value) { }
+    CookedValue(float value) : type(Type::Float), fnum(value) { }
+    CookedValue(double value) : type(Type::Double), fnum(value) { }
+    CookedValue(std::string value) : type(Type::String), str(std::move(value)) { }
+    CookedValue(Type type, std::string value) : type(type), str(std::move(value)) { }
+    CookedValue(Type type, int64_t value) : type(type), integer(value) { }
+
+    bool operator==(CookedValue const& other) const
+    {
+        return type == other.type && integer == other.integer && fnum == other.fnum && str == other.str;
+    }
+};
+
+struct CookedProperty {
+    std::string type;
+    util::Optional<bool> nullable;
+    util::Optional<std::string> object_type;
+};
+
+// An instruction in the cooked changeset. Which of the fields are present
+// depends on the instruction type, and both the JSON and MessagePack output
+// write the fields in the same (alphabetical) order.
+struct CookedInstruction {
+    Adapter::InstructionType type = Adapter::InstructionType::Insert;
+    std::string object_type;
+    util::Optional<CookedValue> identity;
+    util::Optional<uint32_t> list_index;
+    util::Optional<CookedValue> object_identity;
+    util::Optional<std::string> primary_key;
+    // Written as null when empty
+    bool has_properties = false;
+    std::map<std::string, CookedProperty> properties;
+    util::Optional<std::string> property;
+    // Written as null when empty
+    bool has_values = false;
+    std::map<std::string, CookedValue> values;
+
+    size_t field_count() const
+    {
+        return 2 + bool(identity) + bool(list_index) + bool(object_identity) + bool(primary_key)
+             + has_properties + bool(property) + has_values;
+    }
+};
+
+// Writes cooked instructions as a JSON array of objects, in the same shape as
+// nlohmann::json would produce for them
+class JsonInstructionWriter {
+public:
+    JsonInstructionWriter(util::AppendBuffer<char>& out) : m_out(out) { }
+
+    void write(CookedInstruction const& inst)
+    {
+        m_out.append(m_out.size() ? "," : "[", 1);
+        char separator = '{';
+        auto key = [&](const char* name) {
+            append(&separator, 1);
+            separator = ',';
+            write_string(name);
+            append(":", 1);
+        };
+
+        if (inst.identity) {
+            key("identity");
+            write_value(*inst.identity);
+        }
+        if (inst.list_index) {
+            key("list_index");
+            write_int(*inst.list_index);
+        }
+        if (inst.object_identity) {
+            key("object_identity");
+            write_value(*inst.object_identity);
+        }
+        key("object_type");
+        write_string(inst.object_type);
+        if (inst.primary_key) {
+            key("primary_key");
+            write_string(*inst.primary_key);
+        }
+        if (inst.has_properties) {
+            key("properties");
+            write_map(inst.properties, [&](CookedProperty const& prop) {
+                char prop_separator = '{';
+                auto prop_key = [&](const char* name) {
+                    append(&prop_separator, 1);
+                    prop_separator = ',';
+                    write_string(name);
+                    append(":", 1);
+                };
+                if (prop.nullable) {
+                    prop_key("nullable");
+                    append(*prop.nullable ? "true" : "false");
+                }
+                if (prop.object_type) {
+                    prop_key("object_type");
+                    write_string(*prop.object_type);
+                }
+                prop_key("type");
+                write_string(prop.type);
+                append("}", 1);
+            });
+        }
+        if (inst.property) {
+            key("property");
+            write_string(*inst.property);
+        }
+        key("type");
+        write_string(Adapter::instruction_type_string(inst.type));
+        if (inst.has_values) {
+            key("values");
+            write_map(inst.values, [&](CookedValue const& value) { write_value(value); });
+        }
+        append("}", 1);
+    }
+
+    bool finish()
+    {
+        if (!m_out.size())
+            return false;
+        m_out.append("]", 1);
+        return true;
+    }
+
+private:
+    util::AppendBuffer<char>& m_out;
+
+    void append(const char* str, size_t size) { m_out.append(str, size); }
+    void append(StringData str) { m_out.append(str.data(), str.size()); }
+
+    void write_int(int64_t value)
+    {
+        char buffer[24];
+        int size = snprintf(buffer, sizeof(buffer), "%" PRId64, value);
+        append(buffer, size);
+    }
+
+    template<typename Value, typename Fn>
+    void write_map(std::map<std::string, Value> const& map, Fn&& write_value)
+    {
+        if (map.empty()) {
+            append("null");
+            return;
+        }
+        char separator = '{';
+        for (auto& entry : map) {
+            append(&separator, 1);
+            separator = ',';
+            write_string(entry.first);
+            append(":", 1);
+            write_value(entry.second);
+        }
+        append("}", 1);
+    }
+
+    void write_string(StringData str)
+    {
+        static const char hex[] = "0123456789abcdef";
+        append("\"", 1);
+        const char* begin = str.data();
+        const char* end = begin + str.size();
+        const char* run = begin;
+        for (const char* p = begin; p != end; ++p) {
+            unsigned char c = *p;
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            append(run, p - run);
+            run = p + 1;
+            switch (c) {
+                case '"':  append("\\\"", 2); break;
+                case '\\': append("\\\\", 2); break;
+                case '\b': append("\\b", 2); break;
+                case '\f': append("\\f", 2); break;
+                case '\n': append("\\n", 2); break;
+                case '\r': append("\\r", 2); break;
+                case '\t': append("\\t", 2); break;
+                default: {
+                    char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                    append(escaped, sizeof(escaped));
+                }
+            }
+        }
+        append(run, end - run);
+        append("\"", 1);
+    }
+
+    void write_value(CookedValue const& value)
+    {
+        switch (value.type) {
+            case CookedValue::Type::Null:
+                return append("null");
+            case CookedValue::Type::Int:
+                return write_int(value.integer);
+            case CookedValue::Type::Bool:
+                return append(value.integer ? "true" : "false");
+            case CookedValue::Type::Float:
+            case CookedValue::Type::Double:
+                // Formatting doubles the same way as everything else which
+                // reads this is fiddly, so leave that to the json library
+                return append(nlohmann::json(value.fnum).dump());
+            case CookedValue::Type::String:
+                return write_string(value.str);
+            case CookedValue::Type::Data: {
+                std::vector<char> encoded(util::base64_encoded_size(value.str.size()));
+                size_t size = util::base64_encode(value.str.data(), value.str.size(),
+                                                  encoded.data(), encoded.size());
+                append("[\"data64\",");
+                write_string(StringData(encoded.data(), size));
+                return append("]", 1);
+            }
+            case CookedValue::Type::Date:
+                append("[\"date\",");
+                write_int(value.integer);
+                return append("]", 1);
+        }
+    }
+};
+
+// Writes cooked instructions as a MessagePack array of maps, with the same
+// keys and nesting as the JSON output. Binary data is written as `bin` rather
+// than being base64-encoded.
+class MessagePackInstructionWriter {
+public:
+    MessagePackInstructionWriter(util::AppendBuffer<char>& out) : m_out(out) { }
+
+    void write(CookedInstruction const& inst)
+    {
+        begin_instruction();
+        write_map_header(inst.field_count());
+        if (inst.identity) {
+            write_string("identity");
+            write_value(*inst.identity);
+        }
+        if (inst.list_index) {
+            write_string("list_index");
+            write_int(*inst.list_index);
+        }
+        if (inst.object_identity) {
+            write_string("object_identity");
+            write_value(*inst.object_identity);
+        }
+        write_string("object_type");
+        write_string(inst.object_type);
+        if (inst.primary_key) {
+            write_string("primary_key");
+            write_string(*inst.primary_key);
+        }
+        if (inst.has_properties) {
+            write_string("properties");
+            write_map(inst.properties, [&](CookedProperty const& prop) {
+                write_map_header(1 + bool(prop.nullable) + bool(prop.object_type));
+                if (prop.nullable) {
+                    write_string("nullable");
+                    write_byte(*prop.nullable ? 0xc3 : 0xc2);
+                }
+                if (prop.object_type) {
+                    write_string("object_type");
+                    write_string(*prop.object_type);
+                }
+                write_string("type");
+                write_string(prop.type);
+            });
+        }
+        if (inst.property) {
+            write_string("property");
+            write_string(*inst.property);
+        }
+        write_string("type");
+        write_string(Adapter::instruction_type_string(inst.type));
+        if (inst.has_values) {
+            write_string("values");
+            write_map(inst.values, [&](CookedValue const& value) { write_value(value); });
+        }
+    }
+
+    bool finish()
+    {
+        if (!m_count)
+            return false;
+        REALM_ASSERT(m_out.size() >= 5 && m_out.data()[0] == '\xdd');
+        write_big_endian(m_out.data() + 1, m_count, 4);
+        return true;
+    }
+
+    // Lower-level functions for writing an instruction piece by piece, which
+    // must start with begin_instruction()
+    void begin_instruction()
+    {
+        if (m_count++ == 0) {
+            // The number of instructions isn't known until the end, so always
+            // use a 32-bit array header and fill it in in finish()
+            m_out.append("\xdd\0\0\0\0", 5);
+        }
+    }
+
+    void write_map_header(size_t size) { write_header(0x80, 0xde, size); }
+
+    void write_string(StringData str)
+    {
+        if (str.size() >= 32 && str.size() <= 0xff)
+            write_sized(0xd9, str.size(), 1);
+        else
+            write_header(0xa0, 0xda, str.size());
+        m_out.append(str.data(), str.size());
+    }
+
+    // Write an already-encoded value
+    void write_raw(StringData data) { m_out.append(data.data(), data.size()); }
+
+private:
+    util::AppendBuffer<char>& m_out;
+    uint32_t m_count = 0;
+
+    static void write_big_endian(char* out, uint64_t value, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            out[i] = char(value >> (8 * (size - i - 1)));
+    }
+
+    void write_byte(unsigned char byte)
+    {
+        char c = byte;
+        m_out.append(&c, 1);
+    }
+
+    // Write a type byte followed by `value` as a `size`-byte big endian integer
+    void write_sized(unsigned char type, uint64_t value, size_t size)
+    {
+        char buffer[9];
+        buffer[0] = type;
+        write_big_endian(buffer + 1, value, size);
+        m_out.append(buffer, size + 1);
+    }
+
+    // Array, map, string and binary headers all have 8 (except for arrays and
+    // maps), 16 and 32 bit forms with consecutive type bytes, and arrays,
+    // maps and strings have a compact form with the size in the type byte
+    void write_header(unsigned char fix, unsigned char type16, size_t size)
+    {
+        size_t fix_limit = fix == 0xa0 ? 32 : 16;
+        if (size < fix_limit)
+            write_byte(fix | unsigned(size));
+        else if (size <= 0xffff)
+            write_sized(type16, size, 2);
+        else
+            write_sized(type16 + 1, size, 4);
+    }
+
+    void write_binary(StringData data)
+    {
+        if (data.size() <= 0xff)
+            write_sized(0xc4, data.size(), 1);
+        else if (data.size() <= 0xffff)
+            write_sized(0xc5, data.size(), 2);
+        else
+            write_sized(0xc6, data.size(), 4);
+        m_out.append(data.data(), data.size());
+    }
+
+    void write_int(int64_t value)
+    {
+        if (value >= -32 && value <= 127)
+            write_byte(static_cast<unsigned char>(value));
+        else if (value >= 0 && value <= std::numeric_limits<uint8_t>::max())
+            write_sized(0xcc, value, 1);
+        else if (value >= 0 && value <= std::numeric_limits<uint16_t>::max())
+            write_sized(0xcd, value, 2);
+        else if (value >= 0 && value <= std::numeric_limits<uint32_t>::max())
+            write_sized(0xce, value, 4);
+        else if (value >= 0)
+            write_sized(0xcf, value, 8);
+        else if (value >= std::numeric_limits<int8_t>::min())
+            write_sized(0xd0, value, 1);
+        else if (value >= std::numeric_limits<int16_t>::min())
+            write_sized(0xd1, value, 2);
+        else if (value >= std::numeric_limits<int32_t>::min())
+            write_sized(0xd2, value, 4);
+        else
+            write_sized(0xd3, value, 8);
+    }
+
+    template<typename Value, typename Fn>
+    void write_map(std::map<std::string, Value> const& map, Fn&& write_value)
+    {
+        if (map.empty()) {
+            write_byte(0xc0);
+            return;
+        }
+        write_map_header(map.size());
+        for (auto& entry : map) {
+            write_string(entry.first);
+            write_value(entry.second);
+        }
+    }
+
+    void write_value(CookedValue const& value)
+    {
+        switch (value.type) {
+            case CookedValue::Type::Null:
+                return write_byte(0xc0);
+            case CookedValue::Type::Int:
+                return write_int(value.integer);
+            case CookedValue::Type::Bool:
+                return write_byte(value.integer ? 0xc3 : 0xc2);
+            case CookedValue::Type::Float: {
+                float fnum = float(value.fnum);
+                uint32_t bits;
+                memcpy(&bits, &fnum, sizeof(bits));
+                return write_sized(0xca, bits, 4);
+            }
+            case CookedValue::Type::Double: {
+                uint64_t bits;
+                memcpy(&bits, &value.fnum, sizeof(bits));
+                return write_sized(0xcb, bits, 8);
+            }
+            case CookedValue::Type::String:
+                return write_string(value.str);
+            case CookedValue::Type::Data:
+                return write_binary(value.str);
+            case CookedValue::Type::Date:
+                write_byte(0x92);
+                write_string("date");
+                return write_int(value.integer);
+        }
+    }
+};
+
+// The object types and properties set by Adapter::set_projection()
+struct CookerProjection {
+    // An empty set of properties includes all of them
+    std::unordered_map<std::string, std::unordered_set<std::string>> types;
+
+    // Get the properties included for the object type, or null if the type
+    // isn't included at all
+    std::unordered_set<std::string> const* properties(std::string const& object_type) const
+    {
+        auto it = types.find(object_type);
+        return it == types.end() ? nullptr : &it->second;
+    }
+};
+
 class ChangesetCookerInstructionHandler final : public sync::InstructionHandler {
 public:
     friend Adapter;
 
-    ChangesetCookerInstructionHandler(const Group &group, util::Logger& logger, util::AppendBuffer<char>& out_buffer)
+    ChangesetCookerInstructionHandler(const Group &group, util::Logger& logger, util::AppendBuffer<char>& out_buffer,
+                                      Adapter::OutputFormat format, CookerProjection const* projection)
     : m_group(group)
     , m_table_info(m_group)
     , m_logger(logger)
-    , m_out_buffer(out_buffer)
+    , m_format(format)
+    , m_projection(projection)
+    , m_json_writer(out_buffer)
+    , m_msgpack_writer(out_buffer)
     {
     }
 
     const Group &m_group;
     sync::TableInfoCache m_table_info;
     util::Logger& m_logger;
-    util::AppendBuffer<char>& m_out_buffer;
+    const Adapter::OutputFormat m_format;
+    // Null if everything is included
+    CookerProjection const* const m_projection;
+    JsonInstructionWriter m_json_writer;
+    MessagePackInstructionWriter m_msgpack_writer;
     std::unordered_map<std::string, ObjectSchema> m_schema;
 
     std::unordered_map<std::string, std::unordered_map<ObjectID, int64_t>> m_int_primaries;
     std::unordered_map<std::string, std::unordered_map<ObjectID, std::string>> m_string_primaries;
     std::unordered_map<std::string, std::unordered_set<ObjectID>> m_null_primaries;
 
-    nlohmann::json m_pending_instruction = nullptr;
+    util::Optional<CookedInstruction> m_pending_instruction;
 
     std::string m_selected_object_type;
     ConstTableRef m_selected_table;
     ObjectSchema *m_selected_object_schema = nullptr;
     Property *m_selected_primary = nullptr;
+    // Set if the selected object type is left out by the projection, in
+    // which case the table isn't selected and its instructions are skipped
+    bool m_selected_excluded = false;
+    // The properties of the selected object type included by the projection,
+    // or null for all of them
+    std::unordered_set<std::string> const* m_selected_properties = nullptr;
 
     std::string m_list_property_name;
-    nlohmann::json m_list_parent_identity;
+    CookedValue m_list_parent_identity;
+    // Set if the selected list is left out by the projection
+    bool m_list_excluded = false;
 
     ConstTableRef m_list_target_table;
     ObjectSchema *m_list_target_object_schema = nullptr;
     Property *m_list_target_primary = nullptr;
 
     void flush() {
-        if (m_pending_instruction.is_null())
+        if (!m_pending_instruction)
             return;
-        if (m_out_buffer.size())
-            m_out_buffer.append(",", 1);
+        if (m_format == Adapter::OutputFormat::MessagePack)
+            m_msgpack_writer.write(*m_pending_instruction);
         else
-            m_out_buffer.append("[", 1);
-        auto str = m_pending_instruction.dump();
-        m_out_buffer.append(str.data(), str.size());
-        m_pending_instruction = nullptr;
+            m_json_writer.write(*m_pending_instruction);
+        m_pending_instruction = util::none;
     }
 
     bool finish() {
         flush();
-        if (!m_out_buffer.size())
-            return false;
-        m_out_buffer.append("]", 1);
-        return true;
+        if (m_format == Adapter::OutputFormat::MessagePack)
+            return m_msgpack_writer.finish();
+        return m_json_writer.finish();
     }
 
     void add_instruction(Adapter::InstructionType type,
-                         nlohmann::json &&inst = {}, bool collapsible = false,
+                         CookedInstruction&& inst = {}, bool collapsible = false,
                          util::Optional<std::string> object_type = util::none) {
         if (!object_type && !m_selected_object_schema) {
             return; // FIXME: support objects without schemas
         }
         flush();
 
-        inst["type"] = Adapter::instruction_type_string(type);
-        inst["object_type"] = object_type ? *object_type : m_selected_object_schema->name;
+        inst.type = type;
+        inst.object_type = object_type ? *object_type : m_selected_object_schema->name;
         m_pending_instruction = std::move(inst);
         if (!collapsible)
             flush();
     }
 
-    void add_set_instruction(ObjectID row, StringData column, nlohmann::json &&value) {
-        nlohmann::json identity = get_identity(row, *m_selected_table, m_selected_primary);
+    void add_set_instruction(ObjectID row, StringData column, CookedValue&& value) {
+        CookedValue identity = get_identity(row, *m_selected_table, m_selected_primary);
 
         // collapse values if inserting/setting values for the last object
-        if (!m_pending_instruction.is_null()) {
-            nlohmann::json &last = m_pending_instruction;
-            if (equals(identity, last["identity"]) && m_selected_object_schema && m_selected_object_schema->name == last["object_type"].get<std::string>()) {
-                last["values"][column] = value;
+        if (m_pending_instruction) {
+            CookedInstruction &last = *m_pending_instruction;
+            if (last.has_values && last.identity && identity == *last.identity && m_selected_object_schema && m_selected_object_schema->name == last.object_type) {
+                last.values[column] = std::move(value);
                 return;
             }
         }
 
         // if not collapsed create new
-        add_instruction(Adapter::InstructionType::Set, {
-            {"identity", std::move(identity)},
-            {"values", {{column, value}}}
-        }, true);
-    }
-
-    void add_column_instruction(std::string object_type, std::string prop_name, nlohmann::json &&prop) {
-        if (!m_pending_instruction.is_null()) {
-            nlohmann::json &last = m_pending_instruction;
-            if (last["object_type"].get<std::string>() == object_type && (
-                last["type"].get<std::string>() == "ADD_TYPE" ||
-                last["type"].get<std::string>() == "ADD_PROPERTIES"))
+        CookedInstruction inst;
+        inst.identity = std::move(identity);
+        inst.has_values = true;
+        inst.values[column] = std::move(value);
+        add_instruction(Adapter::InstructionType::Set, std::move(inst), true);
+    }
+
+    void add_column_instruction(std::string object_type, std::string prop_name, CookedProperty &&prop) {
+        if (m_pending_instruction) {
+            CookedInstruction &last = *m_pending_instruction;
+            if (last.object_type == object_type && (
+                last.type == Adapter::InstructionType::AddType ||
+                last.type == Adapter::InstructionType::AddProperties))
             {
-                last["properties"][prop_name] = prop;
+                last.properties[prop_name] = std::move(prop);
                 return;
             }
         }
 
-        add_instruction(Adapter::InstructionType::AddProperties, {{"properties",
-            {{prop_name, prop}}
-        }}, true, object_type);
+        CookedInstruction inst;
+        inst.has_properties = true;
+        inst.properties[prop_name] = std::move(prop);
+        add_instruction(Adapter::InstructionType::AddProperties, std::move(inst), true, object_type);
+    }
+
+    // Check if the property of the selected object type is included by the
+    // projection. Primary keys are always included as they identify objects.
+    bool includes_property(StringData name) const {
+        if (!m_selected_properties || m_selected_properties->empty())
+            return true;
+        if (m_selected_primary && m_selected_primary->name == name)
+            return true;
+        return m_selected_properties->count(std::string(name)) != 0;
+    }
+
+    // An instruction on the currently selected list
+    CookedInstruction list_instruction() {
+        CookedInstruction inst;
+        inst.identity = m_list_parent_identity;
+        inst.property = m_list_property_name;
+        return inst;
     }
 
-    nlohmann::json get_identity(ObjectID object_id, const Table& table, Property *primary_key) {
+    CookedValue get_identity(ObjectID object_id, const Table& table, Property *primary_key) {
         if (primary_key) {
             std::string object_type = ObjectStore::object_type_for_table_name(table.get_name());
 
@@ -275,11 +772,29 @@ public:
     void operator()(const Instruction::SelectTable& instr)
     {
         m_selected_object_type = get_string(instr.table);
+        m_selected_properties = nullptr;
+        m_selected_excluded = false;
+        if (m_projection && !m_selected_object_type.empty()) {
+            m_selected_properties = m_projection->properties(m_selected_object_type);
+            m_selected_excluded = !m_selected_properties;
+        }
+        if (m_selected_excluded) {
+            // Skip building the ObjectSchema for a table nothing is cooked for
+            m_selected_object_schema = nullptr;
+            m_selected_table = ConstTableRef();
+            m_selected_primary = nullptr;
+            return;
+        }
         select(m_selected_object_type, m_selected_object_schema, m_selected_table, m_selected_primary);
     }
 
     void operator()(const Instruction::SelectField& instr)
     {
+        m_list_excluded = m_selected_excluded || !includes_property(get_string(instr.field));
+        if (m_list_excluded) {
+            m_list_property_name.clear();
+            return;
+        }
         REALM_ASSERT(m_selected_object_schema);
 
         m_list_parent_identity = get_identity(instr.object, *m_selected_table, m_selected_primary);
@@ -292,16 +807,20 @@ public:
     void operator()(const Instruction::AddTable& instr)
     {
         std::string object_type = get_string(instr.table);
+        if (m_projection && !m_projection->properties(object_type))
+            return;
         if (object_type.size()) {
-            nlohmann::json dict = {{"properties", nullptr}};
+            CookedInstruction inst;
+            inst.has_properties = true;
             if (instr.has_primary_key) {
-                dict["primary_key"] = get_string(instr.primary_key_field);
-                dict["properties"][get_string(instr.primary_key_field)] = {
-                    {"nullable", instr.primary_key_nullable},
-                    {"type", string_for_property_type(from_core_type(instr.primary_key_type))}
+                std::string primary_key = get_string(instr.primary_key_field);
+                inst.properties[primary_key] = {
+                    string_for_property_type(from_core_type(instr.primary_key_type)),
+                    instr.primary_key_nullable, util::none
                 };
+                inst.primary_key = std::move(primary_key);
             }
-            add_instruction(Adapter::InstructionType::AddType, std::move(dict),
+            add_instruction(Adapter::InstructionType::AddType, std::move(inst),
                             true, object_type);
         }
     }
@@ -314,13 +833,27 @@ public:
     // Must have table selected:
     void operator()(const Instruction::CreateObject& instr)
     {
+        if (m_selected_excluded) {
+            // Links from included types to this object still need its
+            // primary key, and it isn't in the Group until after this changeset
+            if (!instr.has_primary_key)
+                return;
+            if (instr.payload.type == type_Int)
+                m_int_primaries[m_selected_object_type][instr.object] = instr.payload.data.integer;
+            else if (instr.payload.type == type_String)
+                m_string_primaries[m_selected_object_type][instr.object] = get_string(instr.payload.data.str);
+            else if (instr.payload.is_null())
+                m_null_primaries[m_selected_object_type].insert(instr.object);
+            return;
+        }
         if (!m_selected_object_schema) {
             m_logger.warn("Adapter: Ignoring CreateObject instruction with no object schema");
             return; // FIXME: Support objects without schemas
         }
 
-        nlohmann::json identity;
-        nlohmann::json values;
+        CookedValue identity;
+        CookedInstruction inst;
+        inst.has_values = true;
 
         if (instr.has_primary_key) {
             if (instr.payload.type == type_Int) {
@@ -340,29 +873,31 @@ public:
                 REALM_TERMINATE("Non-integer/non-string primary keys not supported by adapter.");
             }
 
-            values[m_selected_primary->name] = identity;
+            inst.values[m_selected_primary->name] = identity;
         }
         else {
             identity = instr.object.to_string(); // Use the stringified Object ID
         }
-        add_instruction(Adapter::InstructionType::Insert, {
-            {"identity", std::move(identity)},
-            {"values", std::move(values)}
-        }, true);
+        inst.identity = std::move(identity);
+        add_instruction(Adapter::InstructionType::Insert, std::move(inst), true);
     }
 
     void operator()(const Instruction::EraseObject& instr)
     {
-        if (!m_selected_object_schema) {
+        if (!m_selected_object_schema && !m_selected_excluded) {
             m_logger.warn("Adapter: Ignoring EraseObject instruction with no object schema");
             return; // FIXME: Support objects without schemas
         }
 
-        add_instruction(Adapter::InstructionType::Delete, {
-            {"identity", get_identity(instr.object, *m_selected_table, m_selected_primary)}
-        });
+        if (!m_selected_excluded) {
+            CookedInstruction inst;
+            inst.identity = get_identity(instr.object, *m_selected_table, m_selected_primary);
+            add_instruction(Adapter::InstructionType::Delete, std::move(inst));
+        }
 
-        if (m_selected_primary) {
+        // The primary key of an excluded type isn't known without its schema,
+        // so clear any which CreateObject may have cached for it
+        if (m_selected_primary || m_selected_excluded) {
             auto& int_primaries    = m_int_primaries[m_selected_object_type];
             auto& string_primaries = m_string_primaries[m_selected_object_type];
             auto& null_primaries   = m_null_primaries[m_selected_object_type];
@@ -376,12 +911,16 @@ public:
 
     void operator()(const Instruction::Set& instr)
     {
+        if (m_selected_excluded)
+            return;
         if (!m_selected_object_schema) {
             m_logger.warn("Adapter: Ignoring Set instruction with no object schema");
             return; // FIXME: Support objects without schemas
         }
 
         StringData field = get_string(instr.field);
+        if (!includes_property(field))
+            return;
 
         if (instr.payload.is_null()) {
             return add_set_instruction(instr.object, field, nullptr);
@@ -399,16 +938,13 @@ public:
             case type_String:
                 return add_set_instruction(instr.object, field, std::string(get_string(instr.payload.data.str)));
             case type_Binary: {
-                StringData data = get_string(instr.payload.data.str);
-                auto encoded_size = util::base64_encoded_size(data.size());
-                std::vector<char> encoded_data(encoded_size + 1, '\0');
-                util::base64_encode(data.data(), data.size(), encoded_data.data(), encoded_data.size());
-                return add_set_instruction(instr.object, field, {"data64", encoded_data.data()});
+                std::string data = get_string(instr.payload.data.str);
+                return add_set_instruction(instr.object, field, {CookedValue::Type::Data, std::move(data)});
             }
             case type_Timestamp: {
                 Timestamp ts = instr.payload.data.timestamp;
                 int64_t value = ts.get_seconds() * 1000 + ts.get_nanoseconds() / 1000000;
-                return add_set_instruction(instr.object, field, {"date", value});
+                return add_set_instruction(instr.object, field, {CookedValue::Type::Date, value});
             }
             case type_Link: {
                 ObjectSchema *target_object_schema;
@@ -416,7 +952,7 @@ public:
                 Property *target_primary;
                 std::string table_name = get_string(instr.payload.data.link.target_table);
                 select(table_name, target_object_schema, target_table, target_primary);
-                nlohmann::json value = get_identity(instr.payload.data.link.target, *target_table, target_primary);
+                CookedValue value = get_identity(instr.payload.data.link.target, *target_table, target_primary);
                 return add_set_instruction(instr.object, field, std::move(value));
             }
 
@@ -431,34 +967,44 @@ public:
 
     void operator()(const Instruction::AddInteger&)
     {
+        if (m_selected_excluded)
+            return;
         // FIXME
         REALM_TERMINATE("AddInteger not supported by adapter.");
     }
 
     void operator()(const Instruction::InsertSubstring&)
     {
+        if (m_selected_excluded)
+            return;
         // FIXME
         REALM_TERMINATE("InsertSubstring not supported by adapter.");
     }
 
     void operator()(const Instruction::EraseSubstring&)
     {
+        if (m_selected_excluded)
+            return;
         // FIXME
         REALM_TERMINATE("EraseSubstring not supported by adapter.");
     }
 
     void operator()(const Instruction::ClearTable&)
     {
+        if (m_selected_excluded)
+            return;
         add_instruction(Adapter::InstructionType::Clear);
     }
 
     void operator()(const Instruction::AddColumn& instr)
     {
+        if (m_selected_excluded || !includes_property(get_string(instr.field)))
+            return;
         if (m_selected_object_type.size()) {
             if (instr.type == type_Link || instr.type == type_LinkList) {
                 add_column_instruction(m_selected_object_type, get_string(instr.field), {
-                    {"type", (instr.type == type_Link ? "object" : "list")},
-                    {"object_type", get_string(instr.link_target_table)}
+                    instr.type == type_Link ? "object" : "list", util::none,
+                    std::string(get_string(instr.link_target_table))
                 });
             }
             else if (instr.type == type_Table) {
@@ -466,8 +1012,7 @@ public:
             }
             else {
                 add_column_instruction(m_selected_object_type, get_string(instr.field), {
-                    {"type", string_for_property_type(from_core_type(instr.type))},
-                    {"nullable", instr.nullable}
+                    string_for_property_type(from_core_type(instr.type)), instr.nullable, util::none
                 });
             }
         }
@@ -481,6 +1026,8 @@ public:
     // Must have linklist selected:
     void operator()(const Instruction::ArraySet& instr)
     {
+        if (m_list_excluded)
+            return;
         if (!m_list_property_name.size()) {
             m_logger.warn("Adapter: Ignoring ArraySet instruction on unknown list property");
             return; // FIXME
@@ -488,16 +1035,16 @@ public:
 
         // FIXME: Support arrays of primitives
 
-        add_instruction(Adapter::InstructionType::ListSet, {
-            {"identity", m_list_parent_identity},
-            {"property", m_list_property_name},
-            {"list_index", instr.ndx},
-            {"object_identity", get_identity(instr.payload.data.link.target, *m_list_target_table, m_list_target_primary)}
-        });
+        auto inst = list_instruction();
+        inst.list_index = instr.ndx;
+        inst.object_identity = get_identity(instr.payload.data.link.target, *m_list_target_table, m_list_target_primary);
+        add_instruction(Adapter::InstructionType::ListSet, std::move(inst));
     }
 
     void operator()(const Instruction::ArrayInsert& instr)
     {
+        if (m_list_excluded)
+            return;
         if (!m_list_property_name.size()) {
             m_logger.warn("Adapter: Ignoring ArrayInsert instruction on unknown list property");
             return; // FIXME
@@ -506,17 +1053,15 @@ public:
 
         // FIXME: Support arrays of primitives
 
-        add_instruction(Adapter::InstructionType::ListInsert, {
-            {"identity", m_list_parent_identity},
-            {"property", m_list_property_name},
-            {"list_index", instr.ndx},
-            {"object_identity", get_identity(instr.payload.data.link.target, *m_list_target_table, m_list_target_primary)}
-        });
+        auto inst = list_instruction();
+        inst.list_index = instr.ndx;
+        inst.object_identity = get_identity(instr.payload.data.link.target, *m_list_target_table, m_list_target_primary);
+        add_instruction(Adapter::InstructionType::ListInsert, std::move(inst));
     }
 
     void operator()(const Instruction::ArrayMove&)
     {
-        if (!m_list_property_name.size())
+        if (m_list_excluded || !m_list_property_name.size())
             return; // FIXME
 
         REALM_TERMINATE("ArrayMove not supported by adapter.");
@@ -524,7 +1069,7 @@ public:
 
     void operator()(const Instruction::ArraySwap&)
     {
-        if (!m_list_property_name.size())
+        if (m_list_excluded || !m_list_property_name.size())
             return; // FIXME
 
         REALM_TERMINATE("ArraySwap not supported by adapter.");
@@ -532,25 +1077,20 @@ public:
 
     void operator()(const Instruction::ArrayErase& instr)
     {
-        if (!m_list_property_name.size())
+        if (m_list_excluded || !m_list_property_name.size())
             return; // FIXME
 
-        add_instruction(Adapter::InstructionType::ListErase, {
-            {"identity", m_list_parent_identity},
-            {"property", m_list_property_name},
-            {"list_index", instr.ndx},
-        });
+        auto inst = list_instruction();
+        inst.list_index = instr.ndx;
+        add_instruction(Adapter::InstructionType::ListErase, std::move(inst));
     }
 
     void operator()(const Instruction::ArrayClear&)
     {
-        if (!m_list_property_name.size())
+        if (m_list_excluded || !m_list_property_name.size())
             return; // FIXME
 
-        add_instruction(Adapter::InstructionType::ListClear, {
-            {"identity", m_list_parent_identity},
-            {"property", m_list_property_name},
-        });
+        add_instruction(Adapter::InstructionType::ListClear, list_instruction());
     }
 
     void operator()(const Instruction& instr) final override
@@ -559,34 +1099,350 @@ public:
     }
 };
 
+// Reads the subset of MessagePack which MessagePackInstructionWriter produces
+class MessagePackReader {
+public:
+    MessagePackReader(StringData data) : m_pos(data.data()), m_end(data.data() + data.size()) { }
+
+    bool at_end() const { return m_pos == m_end; }
+
+    size_t read_array_header() { return read_header(0x90, 0xdc); }
+    size_t read_map_header() { return read_header(0x80, 0xde); }
+
+    bool read_nil()
+    {
+        if (peek() != 0xc0)
+            return false;
+        ++m_pos;
+        return true;
+    }
+
+    StringData read_string()
+    {
+        unsigned char type = read_byte();
+        size_t size;
+        if ((type & 0xe0) == 0xa0)
+            size = type & 0x1f;
+        else if (type >= 0xd9 && type <= 0xdb)
+            size = read_uint(size_t(1) << (type - 0xd9));
+        else
+            throw std::runtime_error("Adapter: malformed cooked changeset (expected a string)");
+        return StringData(read_bytes(size), size);
+    }
+
+    // Skip over the next value, returning its encoded representation
+    StringData skip_value()
+    {
+        const char* begin = m_pos;
+        unsigned char type = read_byte();
+        auto skip = [&](size_t count) {
+            for (size_t i = 0; i < count; ++i)
+                skip_value();
+        };
+        if (type <= 0x7f || type >= 0xe0 || type == 0xc0 || type == 0xc2 || type == 0xc3)
+            ;
+        else if ((type & 0xf0) == 0x80)
+            skip(2 * (type & 0x0f));
+        else if ((type & 0xf0) == 0x90)
+            skip(type & 0x0f);
+        else if ((type & 0xe0) == 0xa0)
+            read_bytes(type & 0x1f);
+        else if (type >= 0xc4 && type <= 0xc6)
+            read_bytes(read_uint(size_t(1) << (type - 0xc4)));
+        else if (type >= 0xd9 && type <= 0xdb)
+            read_bytes(read_uint(size_t(1) << (type - 0xd9)));
+        else if (type == 0xca || type == 0xce || type == 0xd2)
+            read_bytes(4);
+        else if (type == 0xcb || type == 0xcf || type == 0xd3)
+            read_bytes(8);
+        else if (type == 0xcc || type == 0xd0)
+            read_bytes(1);
+        else if (type == 0xcd || type == 0xd1)
+            read_bytes(2);
+        else if (type == 0xdc || type == 0xdd)
+            skip(read_uint(type == 0xdc ? 2 : 4));
+        else if (type == 0xde || type == 0xdf)
+            skip(2 * read_uint(type == 0xde ? 2 : 4));
+        else
+            throw std::runtime_error("Adapter: malformed cooked changeset (unsupported type)");
+        return StringData(begin, m_pos - begin);
+    }
+
+private:
+    const char* m_pos;
+    const char* m_end;
+
+    unsigned char peek() const
+    {
+        if (m_pos == m_end)
+            throw std::runtime_error("Adapter: malformed cooked changeset (truncated)");
+        return *m_pos;
+    }
+
+    unsigned char read_byte()
+    {
+        unsigned char byte = peek();
+        ++m_pos;
+        return byte;
+    }
+
+    const char* read_bytes(size_t size)
+    {
+        if (size_t(m_end - m_pos) < size)
+            throw std::runtime_error("Adapter: malformed cooked changeset (truncated)");
+        const char* bytes = m_pos;
+        m_pos += size;
+        return bytes;
+    }
+
+    uint64_t read_uint(size_t size)
+    {
+        const char* bytes = read_bytes(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i)
+            value = (value << 8) | static_cast<unsigned char>(bytes[i]);
+        return value;
+    }
+
+    size_t read_header(unsigned char fix, unsigned char type16)
+    {
+        unsigned char type = read_byte();
+        if ((type & 0xf0) == fix)
+            return type & 0x0f;
+        if (type == type16)
+            return read_uint(2);
+        if (type == type16 + 1)
+            return read_uint(4);
+        throw std::runtime_error("Adapter: malformed cooked changeset (expected an array or map)");
+    }
+};
+
+// The parts of a cooked instruction needed to find overwritten Set values
+struct BatchedInstruction {
+    std::string type;
+    std::string object_type;
+    util::Optional<std::string> identity; // encoded, so that it can be compared
+    std::vector<std::string> fields;      // the properties set by SET instructions
+    std::vector<bool> keep_field;
+};
+
+// Mark the values of SET instructions which are overwritten by a later SET of
+// the same property on the same object as not being kept. Anything else done
+// to the object, or to the whole type, stops earlier sets being dropped.
+static void drop_overwritten_sets(std::vector<BatchedInstruction>& instructions)
+{
+    using Key = std::tuple<std::string, std::string, std::string>;
+    std::set<Key> later_sets;
+    auto forget = [&](std::string const& object_type, util::Optional<std::string> const& identity) {
+        auto it = later_sets.lower_bound(Key{object_type, identity ? *identity : "", ""});
+        while (it != later_sets.end() && std::get<0>(*it) == object_type && (!identity || std::get<1>(*it) == *identity))
+            it = later_sets.erase(it);
+    };
+
+    for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+        auto& inst = *it;
+        inst.keep_field.assign(inst.fields.size(), true);
+        if (inst.type == "SET" && inst.identity) {
+            for (size_t i = 0; i < inst.fields.size(); ++i) {
+                if (!later_sets.emplace(inst.object_type, *inst.identity, inst.fields[i]).second)
+                    inst.keep_field[i] = false;
+            }
+        }
+        else if (inst.type == "INSERT" || inst.type == "DELETE") {
+            forget(inst.object_type, inst.identity);
+        }
+        else if (inst.type == "CLEAR" || inst.type == "ADD_TYPE" || inst.type == "ADD_PROPERTIES") {
+            forget(inst.object_type, util::none);
+        }
+    }
+}
+
+static bool keeps_anything(BatchedInstruction const& inst)
+{
+    return inst.fields.empty() || std::find(inst.keep_field.begin(), inst.keep_field.end(), true) != inst.keep_field.end();
+}
+
+// Merge consecutive cooked changesets into a single changeset in `out`
+static void merge_json_changesets(std::vector<StringData> const& changesets,
+                                  util::AppendBuffer<char>& out)
+{
+    std::vector<nlohmann::json> parsed;
+    std::vector<BatchedInstruction> instructions;
+    for (auto& changeset : changesets) {
+        auto array = nlohmann::json::parse(changeset.data(), changeset.data() + changeset.size());
+        for (auto& inst : array) {
+            BatchedInstruction batched;
+            batched.type = inst["type"].get<std::string>();
+            batched.object_type = inst["object_type"].get<std::string>();
+            auto identity = inst.find("identity");
+            if (identity != inst.end())
+                batched.identity = identity->dump();
+            if (batched.type == "SET") {
+                for (auto it = inst["values"].begin(); it != inst["values"].end(); ++it)
+                    batched.fields.push_back(it.key());
+            }
+            instructions.push_back(std::move(batched));
+            parsed.push_back(std::move(inst));
+        }
+    }
+
+    drop_overwritten_sets(instructions);
+
+    nlohmann::json merged = nlohmann::json::array();
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        auto& batched = instructions[i];
+        if (!keeps_anything(batched))
+            continue;
+        for (size_t j = 0; j < batched.fields.size(); ++j) {
+            if (!batched.keep_field[j])
+                parsed[i]["values"].erase(batched.fields[j]);
+        }
+        merged.push_back(std::move(parsed[i]));
+    }
+
+    out.clear();
+    if (merged.empty())
+        return;
+    auto str = merged.dump();
+    out.append(str.data(), str.size());
+}
+
+static void merge_msgpack_changesets(std::vector<StringData> const& changesets,
+                                     util::AppendBuffer<char>& out)
+{
+    struct Field {
+        StringData key;
+        StringData value;
+    };
+    struct Instruction {
+        StringData encoded;
+        std::vector<Field> fields;
+        std::vector<Field> values; // for SET only
+    };
+    std::vector<Instruction> parsed;
+    std::vector<BatchedInstruction> instructions;
+    for (auto& changeset : changesets) {
+        MessagePackReader reader(changeset);
+        for (size_t count = reader.read_array_header(); count; --count) {
+            Instruction inst;
+            BatchedInstruction batched;
+            inst.encoded = MessagePackReader(reader).skip_value();
+            for (size_t fields = reader.read_map_header(); fields; --fields) {
+                Field field;
+                field.key = reader.read_string();
+                field.value = reader.skip_value();
+                if (field.key == "type")
+                    batched.type = std::string(MessagePackReader(field.value).read_string());
+                else if (field.key == "object_type")
+                    batched.object_type = std::string(MessagePackReader(field.value).read_string());
+                else if (field.key == "identity")
+                    batched.identity = std::string(field.value);
+                inst.fields.push_back(field);
+            }
+            if (batched.type == "SET") {
+                for (auto& field : inst.fields) {
+                    if (field.key != "values")
+                        continue;
+                    MessagePackReader values(field.value);
+                    for (size_t count = values.read_nil() ? 0 : values.read_map_header(); count; --count) {
+                        Field value;
+                        value.key = values.read_string();
+                        value.value = values.skip_value();
+                        batched.fields.push_back(std::string(value.key));
+                        inst.values.push_back(value);
+                    }
+                }
+            }
+            parsed.push_back(std::move(inst));
+            instructions.push_back(std::move(batched));
+        }
+    }
+
+    drop_overwritten_sets(instructions);
+
+    out.clear();
+    MessagePackInstructionWriter writer(out);
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        auto& batched = instructions[i];
+        auto& inst = parsed[i];
+        if (!keeps_anything(batched))
+            continue;
+        writer.begin_instruction();
+        if (std::find(batched.keep_field.begin(), batched.keep_field.end(), false) == batched.keep_field.end()) {
+            writer.write_raw(inst.encoded);
+            continue;
+        }
+
+        writer.write_map_header(inst.fields.size());
+        for (auto& field : inst.fields) {
+            writer.write_string(field.key);
+            if (field.key != "values") {
+                writer.write_raw(field.value);
+                continue;
+            }
+            writer.write_map_header(std::count(batched.keep_field.begin(), batched.keep_field.end(), true));
+            for (size_t j = 0; j < inst.values.size(); ++j) {
+                if (batched.keep_field[j]) {
+                    writer.write_string(inst.values[j].key);
+                    writer.write_raw(inst.values[j].value);
+                }
+            }
+        }
+    }
+    writer.finish();
+}
+
 class ChangesetCooker final : public sync::ClientHistory::ChangesetCooker {
 public:
-    ChangesetCooker(util::Logger& logger) : m_logger(logger) { }
+    ChangesetCooker(util::Logger& logger, Adapter::OutputFormat format) : m_logger(logger), m_format(format) { }
 
     bool cook_changeset(const Group& group, const char* changeset,
                         std::size_t changeset_size,
                         util::AppendBuffer<char>& out_buffer) override {
         _impl::SimpleNoCopyInputStream stream(changeset, changeset_size);
-        ChangesetCookerInstructionHandler cooker_handler(group, m_logger, out_buffer);
+        auto projection = m_projection.load();
+        ChangesetCookerInstructionHandler cooker_handler(group, m_logger, out_buffer, m_format, projection.get());
         sync::ChangesetParser().parse(stream, cooker_handler);
         return cooker_handler.finish();
     }
 
+    // Changesets are cooked on the sync client's thread, so the projection
+    // is swapped atomically rather than locked for every changeset
+    void set_projection(std::shared_ptr<const CookerProjection> projection) {
+        m_projection.exchange(std::move(projection));
+    }
+
 private:
     util::Logger& m_logger;
+    const Adapter::OutputFormat m_format;
+    util::AtomicSharedPtr<const CookerProjection> m_projection;
 };
 
 } // anonymous namespace
 
 class Adapter::Impl final : public AdminRealmListener {
 public:
-    Impl(std::function<void(std::string)> realm_changed, std::regex regex,
-         std::string local_root_dir, SyncConfig sync_config_template);
+    Impl(std::function<void(std::string)> realm_changed,
+         std::string local_root_dir, SyncConfig sync_config_template, OutputFormat format,
+         size_t worker_count);
+    ~Impl();
 
     Realm::Config get_config(StringData virtual_path, util::Optional<Schema> schema) const;
 
     using AdminRealmListener::start;
 
+    const OutputFormat m_format;
+
+    void set_batching(std::chrono::milliseconds interval, size_t max_batch_size);
+    void set_projection(Adapter::Projection const& projection);
+
+    // The number of cooked changesets merged into the last batch returned
+    // by current() for each Realm, so that advance() can skip all of them
+    std::mutex m_batch_mutex;
+    std::chrono::milliseconds m_batch_interval{0};
+    size_t m_max_batch_size = 0;
+    std::unordered_map<std::string, size_t> m_batch_lengths;
+
 private:
     void register_realm(sync::ObjectID, StringData virtual_path) override;
     void unregister_realm(sync::ObjectID, StringData) override {}
@@ -601,20 +1457,66 @@ private:
     const std::shared_ptr<ChangesetCooker> m_transformer;
 
     const std::function<void(std::string)> m_realm_changed;
-    const std::regex m_regex;
 
     std::vector<std::shared_ptr<_impl::RealmCoordinator>> m_realms;
 
+    // Call m_realm_changed for the Realm once the current batching interval
+    // for it has passed
+    void notify_realm_changed(std::string const& path);
+    // Call m_realm_changed for the Realm, either directly or by handing it
+    // off to the worker threads
+    void deliver_realm_changed(std::string const& path);
+    void notify_loop();
+
+    // Realms which have changed since they were last notified, and when to
+    // notify them
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> m_batch_deadlines;
+    std::condition_variable m_batch_cv;
+    std::thread m_batch_thread;
+    void batch_loop();
+
+    // Notifications waiting to be delivered by the workers. Each Realm is
+    // queued at most once and is never being notified on two workers at
+    // once, so that its notifications stay in order.
+    struct PendingNotifications {
+        size_t count = 0;
+        bool queued = false;
+        bool running = false;
+    };
+    std::mutex m_notify_mutex;
+    std::condition_variable m_notify_cv;
+    std::unordered_map<std::string, PendingNotifications> m_pending_notifications;
+    std::queue<std::string> m_notify_queue;
+    std::vector<std::thread> m_workers;
+    bool m_stopping = false;
 };
 
-Adapter::Impl::Impl(std::function<void(std::string)> realm_changed, std::regex regex,
-                    std::string local_root_dir, SyncConfig sync_config_template)
+Adapter::Impl::Impl(std::function<void(std::string)> realm_changed,
+                    std::string local_root_dir, SyncConfig sync_config_template,
+                    OutputFormat format, size_t worker_count)
 : AdminRealmListener(std::move(local_root_dir), std::move(sync_config_template))
+, m_format(format)
 , m_logger(SyncManager::shared().make_logger())
-, m_transformer(std::make_shared<ChangesetCooker>(*m_logger))
+, m_transformer(std::make_shared<ChangesetCooker>(*m_logger, format))
 , m_realm_changed(std::move(realm_changed))
-, m_regex(std::move(regex))
 {
+    for (size_t i = 0; i < worker_count; ++i)
+        m_workers.emplace_back([this] { notify_loop(); });
+}
+
+Adapter::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        std::lock_guard<std::mutex> batch_lock(m_batch_mutex);
+        m_stopping = true;
+    }
+    m_notify_cv.notify_all();
+    m_batch_cv.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+    if (m_batch_thread.joinable())
+        m_batch_thread.join();
 }
 
 Realm::Config Adapter::Impl::get_config(StringData virtual_path, util::Optional<Schema> schema) const {
@@ -629,51 +1531,247 @@ Realm::Config Adapter::Impl::get_config(StringData virtual_path, util::Optional<
 
 void Adapter::Impl::register_realm(sync::ObjectID, StringData virtual_path) {
     std::string path = virtual_path;
-    if (!std::regex_match(path, m_regex))
-        return;
-
     auto coordinator = _impl::RealmCoordinator::get_coordinator(get_config(path, util::none));
     std::weak_ptr<Impl> weak_self = std::static_pointer_cast<Impl>(shared_from_this());
     coordinator->set_transaction_callback([path = std::move(path), weak_self = std::move(weak_self)](VersionID, VersionID) {
         if (auto self = weak_self.lock())
-            self->m_realm_changed(path);
+            self->notify_realm_changed(path);
     });
     m_realms.push_back(coordinator);
 }
 
-Adapter::Adapter(std::function<void(std::string)> realm_changed, std::regex regex,
-                 std::string local_root_dir, SyncConfig sync_config_template)
-: m_impl(std::make_shared<Adapter::Impl>(std::move(realm_changed), std::move(regex),
-                                         std::move(local_root_dir), std::move(sync_config_template)))
+void Adapter::Impl::set_projection(Adapter::Projection const& projection) {
+    std::shared_ptr<CookerProjection> cooker_projection;
+    if (!projection.empty()) {
+        cooker_projection = std::make_shared<CookerProjection>();
+        for (auto& type : projection)
+            cooker_projection->types[type.first].insert(type.second.begin(), type.second.end());
+    }
+    m_transformer->set_projection(std::move(cooker_projection));
+}
+
+void Adapter::Impl::set_batching(std::chrono::milliseconds interval, size_t max_batch_size) {
+    std::lock_guard<std::mutex> lock(m_batch_mutex);
+    m_batch_interval = interval;
+    m_max_batch_size = max_batch_size;
+    if (interval.count() && !m_batch_thread.joinable())
+        m_batch_thread = std::thread([this] { batch_loop(); });
+}
+
+void Adapter::Impl::notify_realm_changed(std::string const& path) {
+    {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        if (m_batch_interval.count()) {
+            // Anything arriving before the deadline will be picked up by the
+            // notification which is already scheduled
+            if (m_batch_deadlines.emplace(path, std::chrono::steady_clock::now() + m_batch_interval).second)
+                m_batch_cv.notify_one();
+            return;
+        }
+    }
+    deliver_realm_changed(path);
+}
+
+void Adapter::Impl::batch_loop() {
+    std::unique_lock<std::mutex> lock(m_batch_mutex);
+    while (!m_stopping) {
+        if (m_batch_deadlines.empty()) {
+            m_batch_cv.wait(lock);
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto next = std::chrono::steady_clock::time_point::max();
+        std::vector<std::string> due;
+        for (auto it = m_batch_deadlines.begin(); it != m_batch_deadlines.end(); ) {
+            if (it->second <= now) {
+                due.push_back(it->first);
+                it = m_batch_deadlines.erase(it);
+            }
+            else {
+                next = std::min(next, it->second);
+                ++it;
+            }
+        }
+
+        if (due.empty()) {
+            m_batch_cv.wait_until(lock, next);
+            continue;
+        }
+
+        lock.unlock();
+        for (auto& path : due)
+            deliver_realm_changed(path);
+        lock.lock();
+    }
+}
+
+void Adapter::Impl::deliver_realm_changed(std::string const& path) {
+    if (m_workers.empty()) {
+        m_realm_changed(path);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_notify_mutex);
+    auto& pending = m_pending_notifications[path];
+    ++pending.count;
+    if (!pending.queued && !pending.running) {
+        pending.queued = true;
+        m_notify_queue.push(path);
+        m_notify_cv.notify_one();
+    }
+}
+
+void Adapter::Impl::notify_loop() {
+    std::unique_lock<std::mutex> lock(m_notify_mutex);
+    while (true) {
+        m_notify_cv.wait(lock, [&] { return m_stopping || !m_notify_queue.empty(); });
+        if (m_stopping)
+            return;
+
+        std::string path = std::move(m_notify_queue.front());
+        m_notify_queue.pop();
+        auto& pending = m_pending_notifications[path];
+        pending.queued = false;
+        pending.running = true;
+        --pending.count;
+
+        lock.unlock();
+        m_realm_changed(path);
+        lock.lock();
+
+        // References into the map stay valid across rehashing, and entries
+        // are only erased here, so `pending` is still ours
+        pending.running = false;
+        if (pending.count) {
+            pending.queued = true;
+            m_notify_queue.push(std::move(path));
+            m_notify_cv.notify_one();
+        }
+        else {
+            m_pending_notifications.erase(path);
+        }
+    }
+}
+
+Adapter::Adapter(std::function<void(std::string)> realm_changed, RealmPathMatcher matcher,
+                 std::string local_root_dir, SyncConfig sync_config_template,
+                 OutputFormat format, size_t worker_count)
+: m_impl(std::make_shared<Adapter::Impl>(std::move(realm_changed),
+                                         std::move(local_root_dir), std::move(sync_config_template),
+                                         format, worker_count))
 {
+    m_impl->set_path_matcher(std::move(matcher));
     m_impl->start();
 }
 
 util::Optional<util::AppendBuffer<char>> Adapter::current(std::string realm_path) {
+    util::AppendBuffer<char> buffer;
+    if (!current(realm_path, buffer))
+        return util::none;
+    return buffer;
+}
+
+bool Adapter::current(std::string const& realm_path, util::AppendBuffer<char>& buffer) {
     auto history = realm::sync::make_client_history(get_config(realm_path, util::none).path);
     SharedGroup sg(*history);
 
     auto progress = history->get_cooked_progress();
-    if (progress.changeset_index >= history->get_num_cooked_changesets()) {
-        return util::none;
+    auto count = history->get_num_cooked_changesets();
+    if (progress.changeset_index >= count) {
+        return false;
     }
 
-    util::AppendBuffer<char> buffer;
+    size_t max_batch_size;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m_batch_mutex);
+        max_batch_size = m_impl->m_max_batch_size;
+        m_impl->m_batch_lengths.erase(realm_path);
+    }
+
+    buffer.clear();
     history->get_cooked_changeset(progress.changeset_index, buffer);
-    return buffer;
+    if (!max_batch_size || progress.changeset_index + 1 == count || buffer.size() >= max_batch_size)
+        return true;
+
+    // Gather up following changesets until the batch would be too large,
+    // always taking at least the first one
+    std::vector<util::AppendBuffer<char>> following;
+    size_t batch_size = buffer.size();
+    for (auto index = progress.changeset_index + 1; index < count; ++index) {
+        util::AppendBuffer<char> changeset;
+        history->get_cooked_changeset(index, changeset);
+        if (batch_size + changeset.size() > max_batch_size)
+            break;
+        batch_size += changeset.size();
+        following.push_back(std::move(changeset));
+    }
+    if (following.empty())
+        return true;
+
+    // The first changeset is merged from `buffer` and the result copied back
+    // into it, so that the caller's storage is reused for the batch
+    std::vector<StringData> changesets;
+    changesets.reserve(following.size() + 1);
+    changesets.emplace_back(buffer.data(), buffer.size());
+    for (auto& changeset : following)
+        changesets.emplace_back(changeset.data(), changeset.size());
+    util::AppendBuffer<char> merged;
+    if (m_impl->m_format == OutputFormat::MessagePack)
+        merge_msgpack_changesets(changesets, merged);
+    else
+        merge_json_changesets(changesets, merged);
+    buffer.clear();
+    buffer.append(merged.data(), merged.size());
+
+    std::lock_guard<std::mutex> lock(m_impl->m_batch_mutex);
+    m_impl->m_batch_lengths[realm_path] = changesets.size();
+    return true;
+}
+
+bool Adapter::read_current(std::string const& realm_path, size_t max_chunk_size, util::AppendBuffer<char>& buffer,
+                           std::function<bool(const char*, size_t)> const& fn) {
+    REALM_ASSERT(max_chunk_size > 0);
+    if (!current(realm_path, buffer))
+        return false;
+
+    for (size_t offset = 0; offset < buffer.size(); offset += max_chunk_size) {
+        if (!fn(buffer.data() + offset, std::min(max_chunk_size, buffer.size() - offset)))
+            break;
+    }
+    return true;
 }
 
 void Adapter::advance(std::string realm_path) {
     auto history = realm::sync::make_client_history(get_config(realm_path, util::none).path);
     SharedGroup sg(*history);
 
+    size_t batch_length = 1;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m_batch_mutex);
+        auto it = m_impl->m_batch_lengths.find(realm_path);
+        if (it != m_impl->m_batch_lengths.end()) {
+            batch_length = it->second;
+            m_impl->m_batch_lengths.erase(it);
+        }
+    }
+
     auto progress = history->get_cooked_progress();
-    if (progress.changeset_index < history->get_num_cooked_changesets()) {
-        progress.changeset_index++;
+    auto count = history->get_num_cooked_changesets();
+    if (progress.changeset_index < count) {
+        progress.changeset_index = std::min(progress.changeset_index + decltype(count)(batch_length), count);
         history->set_cooked_progress(progress);
     }
 }
 
+void Adapter::set_batching(std::chrono::milliseconds interval, size_t max_batch_size) {
+    m_impl->set_batching(interval, max_batch_size);
+}
+
+void Adapter::set_projection(Projection const& projection) {
+    m_impl->set_projection(projection);
+}
+
 Realm::Config Adapter::get_config(std::string path, util::Optional<Schema> schema) {
     return m_impl->get_config(path, std::move(schema));
 }
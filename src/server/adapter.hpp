@@ -19,10 +19,15 @@
 #ifndef REALM_SYNC_ADAPTER_HPP
 #define REALM_SYNC_ADAPTER_HPP
 
+#include "realm_path_matcher.hpp"
 #include "shared_realm.hpp"
 #include "sync/sync_config.hpp"
 
+#include <chrono>
 #include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace realm {
 
@@ -31,8 +36,30 @@ class SyncLoggerFactory;
 
 class Adapter {
 public:
+    // The encoding used for the cooked changesets returned by current().
+    // Both are an array of instructions, each of which is a map with the
+    // same keys, but MessagePack is much cheaper to produce and parse on
+    // busy Realms.
+    enum class OutputFormat {
+        Json,
+        MessagePack,
+    };
+
+    // Changesets are cooked as they are integrated by the sync client, as
+    // cooking needs the Realm's state from immediately before each one. If
+    // `worker_count` is non-zero, `realm_changed` is then called on that many
+    // background threads rather than on the sync client's thread, so that
+    // slow consumers don't hold up integration. Calls for different Realms
+    // may then happen concurrently, but calls for a single Realm are never
+    // concurrent and are made in order.
+    Adapter(std::function<void(std::string)> realm_changed, RealmPathMatcher matcher,
+            std::string local_root_dir, SyncConfig sync_config_template,
+            OutputFormat format = OutputFormat::Json, size_t worker_count = 0);
     Adapter(std::function<void(std::string)> realm_changed, std::regex regex,
-            std::string local_root_dir, SyncConfig sync_config_template);
+            std::string local_root_dir, SyncConfig sync_config_template,
+            OutputFormat format = OutputFormat::Json, size_t worker_count = 0)
+    : Adapter(std::move(realm_changed), RealmPathMatcher::regex(std::move(regex)), std::move(local_root_dir),
+              std::move(sync_config_template), format, worker_count) { }
 
     enum class InstructionType {
         Insert,
@@ -65,6 +92,41 @@ public:
     util::Optional<util::AppendBuffer<char>> current(std::string realm_path);
     void advance(std::string realm_path);
 
+    // Read the next cooked changeset for the Realm into `buffer`, replacing
+    // its contents but reusing its storage. Returns false if every cooked
+    // changeset has already been consumed.
+    bool current(std::string const& realm_path, util::AppendBuffer<char>& buffer);
+
+    // Pass the next cooked changeset for the Realm to `fn` in chunks of at
+    // most `max_chunk_size` bytes, stopping early if `fn` returns false. The
+    // changeset is staged in `buffer`, so reusing one buffer for every call
+    // keeps memory use at the size of the largest changeset rather than
+    // allocating for each one. Returns false if there was no changeset to
+    // read. This does not advance past the changeset.
+    bool read_current(std::string const& realm_path, size_t max_chunk_size, util::AppendBuffer<char>& buffer,
+                      std::function<bool(const char*, size_t)> const& fn);
+
+    // Batch up changes for consumers which prefer fewer, larger batches.
+    //
+    // If `interval` is non-zero, `realm_changed` is called at most once per
+    // interval for each Realm, at the end of an interval which starts with
+    // the first change after the previous call. If `max_batch_size` is
+    // non-zero, current() merges consecutive unconsumed changesets into one
+    // of at most that many bytes (but always at least one changeset), and
+    // drops any values in SET instructions which are overwritten by a later
+    // SET of the same property on the same object within the batch. advance()
+    // then moves past every changeset in the last batch returned by current().
+    void set_batching(std::chrono::milliseconds interval, size_t max_batch_size);
+
+    // Limit the cooked changesets to the object types in `projection`, and
+    // for each type which maps to a non-empty list, to those properties and
+    // its primary key. Instructions for anything else are skipped while
+    // cooking, before any of their values are encoded. Applies to changesets
+    // cooked after the call. An empty projection, the default, includes
+    // every object type, including internal ones such as __ResultSets.
+    using Projection = std::unordered_map<std::string, std::vector<std::string>>;
+    void set_projection(Projection const& projection);
+
     Realm::Config get_config(std::string path, util::Optional<Schema> schema = util::none);
 
     void close() { m_impl.reset(); }
@@ -32,9 +32,12 @@
 #include <realm/util/scope_exit.hpp>
 #include <realm/util/uri.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 
+#include <sys/stat.h>
+
 using namespace realm;
 using namespace realm::_impl;
 
@@ -64,6 +67,14 @@ AdminRealmListener::AdminRealmListener(std::string local_root_dir, SyncConfig sy
     m_config.sync_config->reference_realm_url += "/__admin";
 }
 
+AdminRealmListener::~AdminRealmListener() = default;
+
+void AdminRealmListener::set_registration_pacing(size_t batch_size, std::chrono::milliseconds interval)
+{
+    m_registration_batch_size = batch_size;
+    m_registration_interval = interval;
+}
+
 void AdminRealmListener::start()
 {
     if (m_download_session) {
@@ -77,8 +88,10 @@ void AdminRealmListener::start()
         auto& table = *ObjectStore::table_for_object_type(group, "RealmFile");
         size_t path_col_ndx = table.get_column_index("path");
 
+        std::vector<std::pair<sync::ObjectID, std::string>> realms;
         for (size_t i = 0, size = table.size(); i < size; ++i)
-            register_realm(id_for_row(group, table[i]), table.get_string(path_col_ndx, i));
+            realms.emplace_back(id_for_row(group, table[i]), table.get_string(path_col_ndx, i));
+        register_initial(std::move(realms));
         return;
     }
 
@@ -126,7 +139,7 @@ void AdminRealmListener::start()
                 size_t path_col_ndx = self->m_results.get(0).get_column_index("path");
                 for (auto i : c.deletions.as_indexes()) {
                     auto row = self->m_results.get(i);
-                    self->unregister_realm(id_for_row(group, row), row.get_string(path_col_ndx));
+                    self->unregister_if_matched(id_for_row(group, row), row.get_string(path_col_ndx));
                 }
             }
 
@@ -145,16 +158,18 @@ void AdminRealmListener::start()
                 size_t path_col_ndx = self->m_results.get(0).get_column_index("path");
 
                 if (!initial_sent) {
+                    std::vector<std::pair<sync::ObjectID, std::string>> realms;
                     for (size_t i = 0, size = self->m_results.size(); i < size; ++i) {
                         auto row = self->m_results.get(i);
-                        self->register_realm(id_for_row(group, row), row.get_string(path_col_ndx));
+                        realms.emplace_back(id_for_row(group, row), row.get_string(path_col_ndx));
                     }
+                    self->register_initial(std::move(realms));
                     initial_sent = true;
                 }
                 else {
                     for (auto i : c.insertions.as_indexes()) {
                         auto row = self->m_results.get(i);
-                        self->register_realm(id_for_row(group, row), row.get_string(path_col_ndx));
+                        self->register_if_matched(id_for_row(group, row), row.get_string(path_col_ndx));
                     }
                 }
             }
@@ -172,6 +187,121 @@ void AdminRealmListener::start()
     REALM_ASSERT_RELEASE(result);
 }
 
+void AdminRealmListener::register_if_matched(sync::ObjectID id, StringData virtual_path)
+{
+    if (m_path_matcher.matches(virtual_path))
+        register_realm(id, virtual_path);
+}
+
+void AdminRealmListener::unregister_if_matched(sync::ObjectID id, StringData virtual_path)
+{
+    if (!m_path_matcher.matches(virtual_path))
+        return;
+
+    // Realms which haven't been registered yet can just be forgotten about,
+    // and are skipped once their turn comes
+    if (m_pending_paths.erase(std::string(virtual_path)))
+        return;
+    unregister_realm(id, virtual_path);
+}
+
+void AdminRealmListener::register_initial(std::vector<std::pair<sync::ObjectID, std::string>> realms)
+{
+    realms.erase(std::remove_if(realms.begin(), realms.end(),
+                                [&](auto const& realm) { return !m_path_matcher.matches(realm.second); }),
+                 realms.end());
+
+    if (m_registration_batch_size == 0 || realms.size() <= m_registration_batch_size) {
+        for (auto& realm : realms)
+            register_realm(realm.first, realm.second);
+        write_checkpoint();
+        return;
+    }
+
+    // Look up each file's modification time only once rather than in the comparator
+    time_t checkpoint = 0;
+    struct stat checkpoint_stat;
+    if (stat(checkpoint_path().c_str(), &checkpoint_stat) == 0)
+        checkpoint = checkpoint_stat.st_mtime;
+
+    struct Candidate {
+        time_t last_write;
+        bool active;
+        size_t index;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(realms.size());
+    for (size_t i = 0; i < realms.size(); ++i) {
+        time_t last_write = last_write_time(realms[i].second, realms[i].first);
+        candidates.push_back({last_write, last_write >= checkpoint, i});
+    }
+    // Stored in reverse so that the next batch can be popped off the end
+    std::stable_sort(candidates.begin(), candidates.end(), [](auto const& a, auto const& b) {
+        if (a.active != b.active)
+            return b.active;
+        return a.last_write < b.last_write;
+    });
+
+    m_pending_registrations.clear();
+    m_pending_paths.clear();
+    m_pending_registrations.reserve(candidates.size());
+    for (auto& candidate : candidates) {
+        m_pending_paths.insert(realms[candidate.index].second);
+        m_pending_registrations.push_back(std::move(realms[candidate.index]));
+    }
+    register_next_batch();
+}
+
+void AdminRealmListener::register_next_batch()
+{
+    for (size_t i = 0; i < m_registration_batch_size && !m_pending_registrations.empty(); ) {
+        auto realm = std::move(m_pending_registrations.back());
+        m_pending_registrations.pop_back();
+        // Deleted from the admin Realm while waiting
+        if (!m_pending_paths.erase(realm.second))
+            continue;
+        register_realm(realm.first, realm.second);
+        ++i;
+    }
+
+    if (m_pending_registrations.empty()) {
+        write_checkpoint();
+        return;
+    }
+
+    std::weak_ptr<AdminRealmListener> weak_self = shared_from_this();
+    util::EventLoopDispatcher<void()> next_batch([weak_self] {
+        if (auto self = weak_self.lock())
+            self->register_next_batch();
+    });
+    m_timers.schedule_after(m_registration_interval, std::move(next_batch));
+}
+
+std::string AdminRealmListener::checkpoint_path() const
+{
+    return util::File::resolve("realms.checkpoint", m_local_root_dir);
+}
+
+void AdminRealmListener::write_checkpoint() const
+{
+    // Everything has been registered, so anything not written to after this
+    // point counts as inactive for the next startup
+    util::File(checkpoint_path(), util::File::mode_Write);
+}
+
+time_t AdminRealmListener::last_write_time(StringData virtual_path, sync::ObjectID id) const
+{
+    // Depending on the listener the local file may or may not include the id
+    std::string base_path = m_local_root_dir + "/realms" + virtual_path.data();
+    time_t last_write = 0;
+    for (auto& path : {base_path + ".realm", base_path + "/" + id.to_string() + ".realm"}) {
+        struct stat file_stat;
+        if (stat(path.c_str(), &file_stat) == 0)
+            last_write = std::max(last_write, file_stat.st_mtime);
+    }
+    return last_write;
+}
+
 Realm::Config AdminRealmListener::get_config(StringData virtual_path, StringData id) const {
     Realm::Config config;
 
@@ -19,11 +19,18 @@
 #ifndef REALM_JS_ADMIN_REALM_HPP
 #define REALM_JS_ADMIN_REALM_HPP
 
+#include "realm_path_matcher.hpp"
 #include "results.hpp"
 #include "shared_realm.hpp"
 #include "sync/sync_config.hpp"
+#include "util/timer_queue.hpp"
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace realm {
 class SyncUser;
@@ -35,9 +42,24 @@ struct ObjectID;
 class AdminRealmListener : public std::enable_shared_from_this<AdminRealmListener> {
 public:
     AdminRealmListener(std::string local_root_dir, SyncConfig sync_config_template);
+    virtual ~AdminRealmListener();
 
     void start();
 
+    // Only report Realms whose virtual paths match `matcher` to
+    // register_realm() and unregister_realm(). Should be called before start().
+    void set_path_matcher(RealmPathMatcher matcher) { m_path_matcher = std::move(matcher); }
+
+    // Register the Realms which are already listed in the admin Realm when
+    // starting in batches of `batch_size`, waiting `interval` between each
+    // batch, rather than all at once. Realms whose local files were written
+    // to most recently are registered first, and Realms which haven't been
+    // written to since the previous startup finished are left until after
+    // all of the others. Realms added later are registered immediately. A
+    // batch size of zero (the default) registers everything at once. Should
+    // be called before start().
+    void set_registration_pacing(size_t batch_size, std::chrono::milliseconds interval);
+
     Realm::Config get_config(StringData virtual_path, StringData id = nullptr) const;
 
     virtual void register_realm(sync::ObjectID id, StringData virtual_path) = 0;
@@ -52,6 +74,36 @@ private:
     Results m_results;
     NotificationToken m_notification_token;
     std::shared_ptr<SyncSession> m_download_session;
+    RealmPathMatcher m_path_matcher;
+
+    size_t m_registration_batch_size = 0;
+    std::chrono::milliseconds m_registration_interval{0};
+    // Realms from the initial listing which have yet to be registered, in
+    // the reverse of the order they'll be registered in
+    std::vector<std::pair<sync::ObjectID, std::string>> m_pending_registrations;
+    // The paths of the pending Realms which are still in the admin Realm.
+    // Paths are unique as they're the primary key of RealmFile.
+    std::unordered_set<std::string> m_pending_paths;
+
+    // Waits out the interval between batches. Declared last so that it's
+    // destroyed, discarding any batch still waiting, before anything else.
+    util::TimerQueue m_timers;
+
+    void register_if_matched(sync::ObjectID id, StringData virtual_path);
+    void unregister_if_matched(sync::ObjectID id, StringData virtual_path);
+
+    // Register the Realms listed in the admin Realm at startup, paced as
+    // configured by set_registration_pacing()
+    void register_initial(std::vector<std::pair<sync::ObjectID, std::string>> realms);
+    void register_next_batch();
+
+    // The modification time of the checkpoint file records when the initial
+    // registration of Realms last finished
+    std::string checkpoint_path() const;
+    void write_checkpoint() const;
+    // The last time the local files for the Realm were written to, or zero
+    // if there aren't any
+    time_t last_write_time(StringData virtual_path, sync::ObjectID id) const;
 };
 
 } // namespace realm
@@ -38,10 +38,13 @@
 
 #include <json.hpp>
 
+#include <algorithm>
 #include <condition_variable>
+#include <list>
 #include <mutex>
 #include <queue>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -76,7 +79,10 @@ static void from_json(nlohmann::json const& j, ObjectID& v)
 class GlobalNotifier::Impl final : public AdminRealmListener {
 public:
     Impl(std::unique_ptr<Callback>,
-         std::string local_root_dir, SyncConfig sync_config_template);
+         std::string local_root_dir, SyncConfig sync_config_template, size_t worker_count);
+    ~Impl();
+
+    void start_workers();
 
     util::Optional<ChangeNotification> next_changed_realm();
     void release_version(sync::ObjectID id, VersionID old_version, VersionID new_version);
@@ -100,6 +106,17 @@ public:
         std::queue<VersionID> versions;
         bool pending_deletion = false;
 
+        // The object types and properties reported by the callback's
+        // observed_object_types(), and a read transaction which follows
+        // every commit so that they can be checked for relevant changes.
+        std::unordered_map<std::string, std::vector<std::string>> observed_types;
+        // Guarded by m_filter_mutex
+        std::unique_ptr<Replication> filter_history;
+        std::unique_ptr<SharedGroup> filter_shared_group;
+        Group const* filter_group = nullptr;
+        // Position in m_open_filter_realms while filter_shared_group is open
+        std::list<RealmToCalculate*>::iterator filter_lru_position;
+
         // constructor to make GCC 4.9 happy
         RealmToCalculate(sync::ObjectID realm_id, std::string virtual_path)
         : realm_id(realm_id)
@@ -110,6 +127,51 @@ public:
     std::queue<RealmToCalculate*> m_work_queue;
     std::unordered_map<sync::ObjectID, RealmToCalculate> m_realms;
 
+    // Realms with an open filter read transaction, most recently used first.
+    // Once there are more than m_max_open_filter_realms, the least recently
+    // used are closed, to be reopened by their next commit.
+    std::mutex m_filter_mutex;
+    std::list<RealmToCalculate*> m_open_filter_realms;
+    size_t m_max_open_filter_realms = 0;
+    void close_filter_realm(RealmToCalculate& realm);
+
+    size_t m_max_pending_versions = 0;
+    PendingVersionPolicy m_pending_version_policy = PendingVersionPolicy::Block;
+    // Notified whenever a version is released or a Realm is deleted
+    std::condition_variable m_version_released_cv;
+
+    // Add the version produced by a sync transaction to the Realm's pending
+    // versions, applying the pending version limit and opening the Realm at
+    // `old_version` if needed. `lock` must be held on m_work_queue_mutex.
+    void push_version(std::unique_lock<std::mutex>& lock, RealmToCalculate& realm,
+                      VersionID old_version, VersionID new_version);
+
+    // Check if the commit from `old_version` to `new_version` modified any of
+    // the object types which the callback observes for this Realm
+    bool commit_is_observed(RealmToCalculate& realm, VersionID old_version, VersionID new_version);
+
+    // Queue a Realm which has a notification to produce. With workers, they
+    // pick it up from the work queue and signal the main thread once its
+    // changes are ready; otherwise the main thread is signalled immediately.
+    // Must be called with m_work_queue_mutex held.
+    void enqueue(RealmToCalculate* realm);
+
+    // A notification whose changes have been calculated by a worker
+    struct ReadyNotification {
+        RealmToCalculate* realm;
+        VersionID old_version;
+        VersionID new_version;
+        // Left unset if calculating them failed, so that get_changes() can
+        // try again and report the error
+        util::Optional<std::unordered_map<std::string, CollectionChangeSet>> changes;
+    };
+    const size_t m_worker_count;
+    std::vector<std::thread> m_workers;
+    std::condition_variable m_work_cv;
+    std::queue<ReadyNotification> m_ready_queue;
+    bool m_stopping = false;
+    void calculate_changes_loop();
+
     struct SignalCallback {
         std::weak_ptr<Impl> notifier;
         void operator()()
@@ -125,13 +187,81 @@ public:
 };
 
 GlobalNotifier::Impl::Impl(std::unique_ptr<Callback> async_target,
-                           std::string local_root_dir, SyncConfig sync_config_template)
+                           std::string local_root_dir, SyncConfig sync_config_template,
+                           size_t worker_count)
 : AdminRealmListener(local_root_dir, std::move(sync_config_template))
 , m_logger(SyncManager::shared().make_logger())
 , m_target(std::move(async_target))
+, m_worker_count(worker_count)
 {
 }
 
+GlobalNotifier::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> l(m_work_queue_mutex);
+        m_stopping = true;
+    }
+    m_work_cv.notify_all();
+    m_version_released_cv.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void GlobalNotifier::Impl::start_workers()
+{
+    std::lock_guard<std::mutex> l(m_work_queue_mutex);
+    while (m_workers.size() < m_worker_count)
+        m_workers.emplace_back([this] { calculate_changes_loop(); });
+}
+
+void GlobalNotifier::Impl::enqueue(RealmToCalculate* realm)
+{
+    m_work_queue.push(realm);
+    if (m_worker_count) {
+        m_work_cv.notify_one();
+    }
+    else {
+        m_logger->trace("Global notifier: Signaling main thread");
+        m_signal->notify();
+    }
+}
+
+void GlobalNotifier::Impl::calculate_changes_loop()
+{
+    std::unique_lock<std::mutex> l(m_work_queue_mutex);
+    while (true) {
+        m_work_cv.wait(l, [&] { return m_stopping || !m_work_queue.empty(); });
+        if (m_stopping)
+            return;
+
+        auto next = m_work_queue.front();
+        m_work_queue.pop();
+        if (next->versions.empty() && next->pending_deletion) {
+            m_ready_queue.push({next, {}, {}, util::none});
+            m_signal->notify();
+            continue;
+        }
+
+        // The Realm isn't queued again until this notification is released,
+        // so nothing else touches it while we calculate its changes
+        ReadyNotification ready{next, next->shared_group->get_version_of_current_transaction(),
+                                next->versions.front(), util::none};
+        auto path = next->coordinator->get_config().path;
+        l.unlock();
+        try {
+            ready.changes = ChangeNotification::calculate_changes(path, ready.old_version, ready.new_version);
+        }
+        catch (std::exception const& e) {
+            m_logger->error("Global notifier: calculating changes for (%1) failed: %2", next->virtual_path, e.what());
+        }
+        l.lock();
+        m_ready_queue.push(std::move(ready));
+        m_logger->trace("Global notifier: Signaling main thread");
+        m_signal->notify();
+    }
+}
+
 void GlobalNotifier::Impl::register_realm(sync::ObjectID id, StringData path) {
     auto info = &m_realms.emplace(id, RealmToCalculate{id, path}).first->second;
     m_realms.emplace(id, RealmToCalculate{id, path});
@@ -149,6 +279,7 @@ void GlobalNotifier::Impl::register_realm(sync::ObjectID id, StringData path) {
     m_logger->trace("Global notifier: watching %1", path);
     auto config = get_config(path, strid);
     info->coordinator = _impl::RealmCoordinator::get_coordinator(config);
+    info->observed_types = m_target->observed_object_types(strid, path);
 
     std::weak_ptr<Impl> weak_self = std::static_pointer_cast<Impl>(shared_from_this());
     info->coordinator->set_transaction_callback([=, weak_self = std::move(weak_self)](VersionID old_version, VersionID new_version) {
@@ -156,26 +287,148 @@ void GlobalNotifier::Impl::register_realm(sync::ObjectID id, StringData path) {
         if (!self)
             return;
 
-        std::lock_guard<std::mutex> l(m_work_queue_mutex);
-        if (info->shared_group) {
-            m_logger->trace("Global notifier: sync transaction on (%1): Realm already open", info->virtual_path);
+        if (!commit_is_observed(*info, old_version, new_version)) {
+            m_logger->trace("Global notifier: sync transaction on (%1): no observed changes", info->virtual_path);
+            return;
         }
-        else {
-            m_logger->trace("Global notifier: sync transaction on (%1): opening Realm", info->virtual_path);
-            std::unique_ptr<Group> read_only_group;
-            auto config = info->coordinator->get_config();
-            config.force_sync_history = true; // FIXME: needed?
-            config.schema = util::none;
-            Realm::open_with_config(config, info->history, info->shared_group, read_only_group, nullptr);
-            info->shared_group->begin_read(old_version);
+
+        std::unique_lock<std::mutex> l(m_work_queue_mutex);
+        push_version(l, *info, old_version, new_version);
+    });
+}
+
+void GlobalNotifier::Impl::push_version(std::unique_lock<std::mutex>& lock, RealmToCalculate& info,
+                                        VersionID old_version, VersionID new_version)
+{
+    if (m_max_pending_versions && info.versions.size() >= m_max_pending_versions) {
+        if (m_pending_version_policy == PendingVersionPolicy::Coalesce && info.versions.size() > 1) {
+            // Only the oldest version can have been handed out, so the newest
+            // one can be replaced without anyone noticing
+            m_logger->trace("Global notifier: sync transaction on (%1): coalescing with pending version", info.virtual_path);
+            info.versions.back() = new_version;
+            return;
         }
-        info->versions.push(new_version);
-        if (info->versions.size() == 1) {
-            m_logger->trace("Global notifier: Signaling main thread");
-            m_work_queue.push(info);
-            m_signal->notify();
+        if (m_pending_version_policy == PendingVersionPolicy::Block) {
+            m_logger->trace("Global notifier: sync transaction on (%1): waiting for pending versions to be released", info.virtual_path);
+            m_version_released_cv.wait(lock, [&] {
+                return m_stopping || info.pending_deletion || info.versions.size() < m_max_pending_versions;
+            });
+            if (m_stopping || info.pending_deletion)
+                return;
         }
-    });
+    }
+
+    // Checked after waiting, as the Realm is closed once it has no pending versions
+    if (info.shared_group) {
+        m_logger->trace("Global notifier: sync transaction on (%1): Realm already open", info.virtual_path);
+    }
+    else {
+        m_logger->trace("Global notifier: sync transaction on (%1): opening Realm", info.virtual_path);
+        std::unique_ptr<Group> read_only_group;
+        auto config = info.coordinator->get_config();
+        config.force_sync_history = true; // FIXME: needed?
+        config.schema = util::none;
+        Realm::open_with_config(config, info.history, info.shared_group, read_only_group, nullptr);
+        info.shared_group->begin_read(old_version);
+    }
+
+    info.versions.push(new_version);
+    if (info.versions.size() == 1)
+        enqueue(&info);
+}
+
+bool GlobalNotifier::Impl::commit_is_observed(RealmToCalculate& info, VersionID old_version, VersionID new_version)
+{
+    if (info.observed_types.empty())
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_filter_mutex);
+
+    if (!info.filter_shared_group) {
+        std::unique_ptr<Group> read_only_group;
+        auto config = info.coordinator->get_config();
+        config.force_sync_history = true;
+        config.schema = util::none;
+        Realm::open_with_config(config, info.filter_history, info.filter_shared_group, read_only_group, nullptr);
+        info.filter_group = &info.filter_shared_group->begin_read(old_version);
+        info.filter_lru_position = m_open_filter_realms.insert(m_open_filter_realms.begin(), &info);
+
+        while (m_max_open_filter_realms && m_open_filter_realms.size() > m_max_open_filter_realms) {
+            m_logger->trace("Global notifier: closing idle Realm (%1)", m_open_filter_realms.back()->virtual_path);
+            close_filter_realm(*m_open_filter_realms.back());
+        }
+    }
+    else {
+        m_open_filter_realms.splice(m_open_filter_realms.begin(), m_open_filter_realms, info.filter_lru_position);
+    }
+    auto& group = *info.filter_group;
+
+    struct ObservedTable {
+        size_t table_ndx;
+        std::vector<size_t> columns; // empty for all columns
+    };
+    std::vector<ObservedTable> tables;
+    bool missing_table = false;
+
+    _impl::TransactionChangeInfo change_info;
+    change_info.track_all = false;
+    change_info.schema_changed = false;
+    change_info.table_modifications_needed.resize(group.size());
+    change_info.table_moves_needed.resize(group.size());
+    for (auto& type : info.observed_types) {
+        auto table = ObjectStore::table_for_object_type(group, type.first);
+        if (!table) {
+            missing_table = true;
+            continue;
+        }
+        ObservedTable observed{table->get_index_in_group(), {}};
+        for (auto& property : type.second) {
+            size_t col = table->get_column_index(property);
+            if (col != npos)
+                observed.columns.push_back(col);
+        }
+        // None of the observed properties exist yet, so only insertions and
+        // deletions of objects can be relevant
+        if (observed.columns.empty() && !type.second.empty())
+            observed.columns.push_back(npos);
+        change_info.table_modifications_needed.set(observed.table_ndx);
+        tables.push_back(std::move(observed));
+    }
+
+    _impl::transaction::advance(*info.filter_shared_group, change_info, new_version);
+
+    // Table and column indices may have shifted, or an observed type may
+    // have just been created, so err on the side of notifying. The log isn't
+    // parsed at all if the Realm had no tables, so check the count too.
+    if (change_info.changes_unknown || change_info.schema_changed)
+        return true;
+    if (missing_table && group.size() != change_info.table_modifications_needed.size())
+        return true;
+
+    for (auto& observed : tables) {
+        auto changes = change_info.tables.find(observed.table_ndx);
+        if (!changes || changes->empty())
+            continue;
+        if (observed.columns.empty())
+            return true;
+        if (!changes->insertions.empty() || !changes->deletions.empty() || !changes->moves.empty())
+            return true;
+        for (size_t col : observed.columns) {
+            if (col < changes->columns.size() && !changes->columns[col].empty())
+                return true;
+        }
+    }
+    return false;
+}
+
+void GlobalNotifier::Impl::close_filter_realm(RealmToCalculate& info)
+{
+    if (!info.filter_shared_group)
+        return;
+    m_open_filter_realms.erase(info.filter_lru_position);
+    info.filter_group = nullptr;
+    info.filter_shared_group = nullptr;
+    info.filter_history = nullptr;
 }
 
 void GlobalNotifier::Impl::unregister_realm(sync::ObjectID id, StringData path) {
@@ -191,11 +444,10 @@ void GlobalNotifier::Impl::unregister_realm(sync::ObjectID id, StringData path)
     if (realm->second.coordinator)
         realm->second.coordinator->set_transaction_callback(nullptr);
     realm->second.pending_deletion = true;
+    m_version_released_cv.notify_all();
 
-    if (realm->second.versions.empty()) {
-        m_work_queue.push(&realm->second);
-        m_signal->notify();
-    }
+    if (realm->second.versions.empty())
+        enqueue(&realm->second);
 }
 
 void GlobalNotifier::Impl::release_version(sync::ObjectID id, VersionID old_version, VersionID new_version)
@@ -208,6 +460,10 @@ void GlobalNotifier::Impl::release_version(sync::ObjectID id, VersionID old_vers
 
     if (info.pending_deletion && old_version == VersionID()) {
         m_logger->trace("Global notifier: completing pending deletion of (%1)", info.virtual_path);
+        {
+            std::lock_guard<std::mutex> filter_lock(m_filter_mutex);
+            close_filter_realm(info);
+        }
         if (info.coordinator) {
             std::string path = info.coordinator->get_config().path;
             m_realms.erase(it);
@@ -231,35 +487,60 @@ void GlobalNotifier::Impl::release_version(sync::ObjectID id, VersionID old_vers
 
             if (info.pending_deletion) {
                 m_logger->trace("Global notifier: enqueuing deletion notification for (%1)", info.virtual_path);
-                m_work_queue.push(&info);
+                enqueue(&info);
             }
         }
         else {
             LangBindHelper::advance_read(*sg, new_version);
-            m_work_queue.push(&info);
             m_logger->trace("Global notifier: release version on (%1): enqueuing next version", info.virtual_path);
+            enqueue(&info);
         }
     }
 
-    if (!m_work_queue.empty()) {
+    m_version_released_cv.notify_all();
+
+    // Remind the main thread of anything else which is waiting for it
+    bool pending = m_worker_count ? !m_ready_queue.empty() : !m_work_queue.empty();
+    if (pending) {
         m_logger->trace("Global notifier: Signaling main thread");
         m_signal->notify();
     }
 }
 
 GlobalNotifier::GlobalNotifier(std::unique_ptr<Callback> async_target,
-                               std::string local_root_dir, SyncConfig sync_config_template)
+                               std::string local_root_dir, SyncConfig sync_config_template,
+                               size_t worker_count)
 : m_impl(std::make_shared<GlobalNotifier::Impl>(std::move(async_target),
                                                 std::move(local_root_dir),
-                                                std::move(sync_config_template)))
+                                                std::move(sync_config_template),
+                                                worker_count))
 {
     std::weak_ptr<GlobalNotifier::Impl> weak_impl = m_impl;
     m_impl->m_signal = std::make_shared<util::EventLoopSignal<Impl::SignalCallback>>(Impl::SignalCallback{weak_impl});
 }
 
+void GlobalNotifier::set_open_realm_limit(size_t max_open_realms)
+{
+    std::lock_guard<std::mutex> l(m_impl->m_filter_mutex);
+    m_impl->m_max_open_filter_realms = max_open_realms;
+}
+
+void GlobalNotifier::set_pending_version_limit(size_t max_pending_versions, PendingVersionPolicy policy)
+{
+    std::lock_guard<std::mutex> l(m_impl->m_work_queue_mutex);
+    m_impl->m_max_pending_versions = max_pending_versions;
+    m_impl->m_pending_version_policy = policy;
+}
+
+void GlobalNotifier::set_path_matcher(RealmPathMatcher matcher)
+{
+    m_impl->set_path_matcher(std::move(matcher));
+}
+
 void GlobalNotifier::start()
 {
     m_impl->m_logger->trace("Global notifier: start()");
+    m_impl->start_workers();
     m_impl->start();
 }
 
@@ -268,6 +549,28 @@ GlobalNotifier::~GlobalNotifier() = default;
 util::Optional<GlobalNotifier::ChangeNotification> GlobalNotifier::next_changed_realm()
 {
     std::lock_guard<std::mutex> l(m_impl->m_work_queue_mutex);
+    if (m_impl->m_worker_count) {
+        if (m_impl->m_ready_queue.empty()) {
+            m_impl->m_logger->trace("Global notifier: next_changed_realm(): no realms ready");
+            return util::none;
+        }
+        auto ready = std::move(m_impl->m_ready_queue.front());
+        m_impl->m_ready_queue.pop();
+        auto next = ready.realm;
+        m_impl->m_logger->trace("Global notifier: notifying for realm at %1", next->virtual_path);
+        if (next->versions.empty() && next->pending_deletion)
+            return ChangeNotification(m_impl, next->virtual_path, next->realm_id);
+
+        ChangeNotification notification(m_impl, next->virtual_path, next->realm_id,
+                                        next->coordinator->get_config(),
+                                        ready.old_version, ready.new_version);
+        if (ready.changes) {
+            notification.m_changes = std::move(*ready.changes);
+            notification.m_have_calculated_changes = true;
+        }
+        return std::move(notification);
+    }
+
     if (m_impl->m_work_queue.empty()) {
         m_impl->m_logger->trace("Global notifier: next_changed_realm(): no realms pending");
         return util::none;
@@ -390,8 +693,57 @@ std::unordered_map<std::string, CollectionChangeSet> const& GlobalNotifier::Chan
     if (m_have_calculated_changes)
         return m_changes;
 
+    m_changes = calculate_changes(m_config.path, m_old_version, m_new_version);
+    m_have_calculated_changes = true;
+    m_calculated_types.clear();
+    return m_changes;
+}
+
+std::unordered_map<std::string, CollectionChangeSet>
+GlobalNotifier::ChangeNotification::get_changes(std::vector<std::string> const& object_types) const
+{
+    if (!m_have_calculated_changes) {
+        std::vector<std::string> missing;
+        for (auto& object_type : object_types) {
+            if (!m_calculated_types.count(object_type) &&
+                std::find(missing.begin(), missing.end(), object_type) == missing.end())
+                missing.push_back(object_type);
+        }
+
+        if (!missing.empty()) {
+            bool calculated_all = false;
+            auto changes = calculate_changes(m_config.path, m_old_version, m_new_version,
+                                             &missing, &calculated_all);
+            if (calculated_all) {
+                m_changes = std::move(changes);
+                m_have_calculated_changes = true;
+                m_calculated_types.clear();
+            }
+            else {
+                for (auto& change : changes)
+                    m_changes[change.first] = std::move(change.second);
+                m_calculated_types.insert(missing.begin(), missing.end());
+            }
+        }
+    }
+
+    std::unordered_map<std::string, CollectionChangeSet> changes;
+    for (auto& object_type : object_types) {
+        auto it = m_changes.find(object_type);
+        if (it != m_changes.end())
+            changes.emplace(object_type, it->second);
+    }
+    return changes;
+}
+
+std::unordered_map<std::string, CollectionChangeSet>
+GlobalNotifier::ChangeNotification::calculate_changes(std::string const& path,
+                                                      VersionID old_version, VersionID new_version,
+                                                      std::vector<std::string> const* object_types,
+                                                      bool* calculated_all)
+{
     Realm::Config config;
-    config.path = m_config.path;
+    config.path = path;
     config.cache = false;
     config.force_sync_history = true;
     config.automatic_change_notifications = false;
@@ -399,26 +751,47 @@ std::unordered_map<std::string, CollectionChangeSet> const& GlobalNotifier::Chan
     auto realm = Realm::get_shared_realm(config);
 
     auto& sg = Realm::Internal::get_shared_group(*realm);
-    Realm::Internal::begin_read(*realm, m_old_version);
+    Realm::Internal::begin_read(*realm, old_version);
     Group const& g = realm->read_group();
 
     _impl::TransactionChangeInfo info;
-    info.track_all = true;
-    _impl::transaction::advance(*sg, info, m_new_version);
+    info.track_all = !object_types;
+    if (object_types) {
+        info.table_modifications_needed.resize(g.size());
+        info.table_moves_needed.resize(g.size());
+        for (auto& object_type : *object_types) {
+            auto table = ObjectStore::table_for_object_type(g, object_type);
+            if (!table) {
+                // Tables created after the old version have no index to
+                // observe yet, so fall back to tracking everything
+                info.track_all = true;
+                break;
+            }
+            info.table_modifications_needed.set(table->get_index_in_group());
+            info.table_moves_needed.set(table->get_index_in_group());
+        }
+    }
+    if (calculated_all)
+        *calculated_all = info.track_all;
+    _impl::transaction::advance(*sg, info, new_version);
 
-    m_changes.reserve(info.tables.size());
-    for (size_t i = 0; i < info.tables.size(); ++i) {
-        auto& change = info.tables[i];
+    std::unordered_map<std::string, CollectionChangeSet> changes;
+    for (auto& table : info.tables) {
+        auto& change = *table.changes;
         if (!change.empty()) {
-            auto name = ObjectStore::object_type_for_table_name(g.get_table_name(i));
+            auto name = ObjectStore::object_type_for_table_name(g.get_table_name(table.table_ndx));
             if (name) {
-                m_changes[name] = std::move(change).finalize();
+                changes[name] = std::move(change).finalize();
             }
         }
     }
-
-    m_have_calculated_changes = true;
-    return m_changes;
+    return changes;
 }
 
 GlobalNotifier::Callback::~Callback() = default;
+
+std::unordered_map<std::string, std::vector<std::string>>
+GlobalNotifier::Callback::observed_object_types(StringData, StringData)
+{
+    return {};
+}
@@ -20,9 +20,12 @@
 #define REALM_OBJECT_STORE_GLOBAL_NOTIFIER_HPP
 
 #include "impl/collection_notifier.hpp"
+#include "realm_path_matcher.hpp"
 #include "shared_realm.hpp"
 #include "sync/sync_config.hpp"
 
+#include <unordered_set>
+
 namespace realm {
 class SyncUser;
 namespace sync {
@@ -34,15 +37,49 @@ struct ObjectID;
 class GlobalNotifier {
 public:
     class Callback;
+    // If `worker_count` is non-zero, the changes for each notification are
+    // calculated ahead of time on that many background threads, so that the
+    // changes to different Realms are calculated in parallel. Notifications
+    // for a single Realm are still produced one at a time and in version
+    // order. Otherwise they are calculated when get_changes() is first called.
     GlobalNotifier(std::unique_ptr<Callback>, std::string local_root_dir,
-                   SyncConfig sync_config_template);
+                   SyncConfig sync_config_template, size_t worker_count=0);
     ~GlobalNotifier();
 
     // Returns the target callback
     Callback& target();
 
+    // Only consider Realms whose virtual paths match `matcher`, which is
+    // much cheaper than filtering them in Callback::realm_available() when
+    // there are very many Realms. Should be called before start().
+    void set_path_matcher(RealmPathMatcher matcher);
+
     void start();
 
+    // What to do when a new version of a Realm arrives while the maximum
+    // number of versions are already waiting to be notified for it.
+    enum class PendingVersionPolicy {
+        // Block the thread which integrated the commit until the oldest
+        // pending notification for the Realm has been released
+        Block,
+        // Merge the new version into the newest pending notification, so
+        // that it covers a wider range of versions
+        Coalesce,
+    };
+    // Limit the number of pending versions held for each observed Realm. A
+    // limit of zero (the default) leaves the queue unbounded. The limit is
+    // treated as being at least two when coalescing, as the oldest pending
+    // version may already be being notified for. Should be called before
+    // start().
+    void set_pending_version_limit(size_t max_pending_versions, PendingVersionPolicy policy);
+
+    // Limit the number of Realms which are kept open between commits to
+    // check them against Callback::observed_object_types(). Once the limit
+    // is reached the least recently changed Realm is closed, and is reopened
+    // automatically when it is next changed. Realms are always open while
+    // they have pending notifications. Zero (the default) means no limit.
+    void set_open_realm_limit(size_t max_open_realms);
+
     class ChangeNotification;
     util::Optional<ChangeNotification> next_changed_realm();
 
@@ -81,6 +118,23 @@ public:
     // GlobalNotifier was started.
     std::unordered_map<std::string, CollectionChangeSet> const& get_changes() const;
 
+    // The changes made to only the given object types, keyed on object name.
+    // Only the tables for the requested types are examined, so this is much
+    // cheaper than get_changes() when just a few types are of interest. Each
+    // type's changes are calculated at most once per notification, and types
+    // which were not changed are omitted from the result.
+    std::unordered_map<std::string, CollectionChangeSet> get_changes(std::vector<std::string> const& object_types) const;
+
+    // Calculate the changes made to the Realm at `path` between two versions.
+    // If `object_types` is non-null only those types are tracked, unless one
+    // of them did not exist at `old_version`, in which case every table has
+    // to be tracked and `calculated_all` (if given) is set to true.
+    static std::unordered_map<std::string, CollectionChangeSet> calculate_changes(std::string const& path,
+                                                                                 VersionID old_version,
+                                                                                 VersionID new_version,
+                                                                                 std::vector<std::string> const* object_types = nullptr,
+                                                                                 bool* calculated_all = nullptr);
+
     ~ChangeNotification();
 
     std::string serialize() const;
@@ -109,6 +163,8 @@ private:
     mutable std::shared_ptr<Realm> m_new_realm;
     mutable std::unordered_map<std::string, CollectionChangeSet> m_changes;
     mutable bool m_have_calculated_changes = false;
+    // Object types whose changes have been calculated by the per-type get_changes()
+    mutable std::unordered_set<std::string> m_calculated_types;
 
     ChangeNotification() = default;
 
@@ -142,6 +198,18 @@ public:
     /// Realm.
     virtual bool realm_available(StringData id, StringData virtual_path) = 0;
 
+    /// Called after realm_available() returns true to determine which object
+    /// types the application wants to be notified about in that Realm.
+    ///
+    /// The result maps object type names to the names of the properties of
+    /// interest, with an empty list meaning every property of that type.
+    /// Commits which do not touch any of these are skipped entirely, rather
+    /// than producing a ChangeNotification and holding on to their version
+    /// until it is released. Returning an empty map (the default) observes
+    /// every change made to the Realm.
+    virtual std::unordered_map<std::string, std::vector<std::string>>
+    observed_object_types(StringData id, StringData virtual_path);
+
     /// Called when a new version is available in an observed Realm.
     virtual void realm_changed(GlobalNotifier*) = 0;
 };
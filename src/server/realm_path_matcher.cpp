@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "realm_path_matcher.hpp"
+
+#include <algorithm>
+
+using namespace realm;
+
+RealmPathMatcher RealmPathMatcher::prefix(std::string prefix)
+{
+    RealmPathMatcher matcher;
+    matcher.m_kind = Kind::Prefix;
+    matcher.m_prefix = std::move(prefix);
+    return matcher;
+}
+
+RealmPathMatcher RealmPathMatcher::glob(std::string const& pattern)
+{
+    std::vector<GlobToken> tokens;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '?') {
+            tokens.push_back({GlobToken::Type::AnyChar, {}});
+        }
+        else if (c == '*') {
+            bool double_star = i + 1 < pattern.size() && pattern[i + 1] == '*';
+            while (i + 1 < pattern.size() && pattern[i + 1] == '*')
+                ++i;
+            auto type = double_star ? GlobToken::Type::DoubleStar : GlobToken::Type::Star;
+            // Adjacent stars match the same things as the widest of them
+            if (!tokens.empty() && (tokens.back().type == GlobToken::Type::Star ||
+                                    tokens.back().type == GlobToken::Type::DoubleStar)) {
+                if (type == GlobToken::Type::DoubleStar)
+                    tokens.back().type = type;
+                continue;
+            }
+            tokens.push_back({type, {}});
+        }
+        else if (!tokens.empty() && tokens.back().type == GlobToken::Type::Literal) {
+            tokens.back().literal += c;
+        }
+        else {
+            tokens.push_back({GlobToken::Type::Literal, std::string(1, c)});
+        }
+    }
+
+    RealmPathMatcher matcher;
+    matcher.m_kind = Kind::Glob;
+    if (!tokens.empty() && tokens.front().type == GlobToken::Type::Literal) {
+        matcher.m_prefix = std::move(tokens.front().literal);
+        tokens.erase(tokens.begin());
+    }
+    matcher.m_glob = std::make_shared<std::vector<GlobToken>>(std::move(tokens));
+    return matcher;
+}
+
+RealmPathMatcher RealmPathMatcher::regex(std::regex regex)
+{
+    RealmPathMatcher matcher;
+    matcher.m_kind = Kind::Regex;
+    matcher.m_regex = std::make_shared<std::regex>(std::move(regex));
+    return matcher;
+}
+
+bool RealmPathMatcher::matches(StringData path) const
+{
+    switch (m_kind) {
+        case Kind::All:
+            return true;
+        case Kind::Prefix:
+            return path.begins_with(m_prefix);
+        case Kind::Glob:
+            return path.begins_with(m_prefix) && glob_matches(path, 0, m_prefix.size());
+        case Kind::Regex:
+            return std::regex_match(path.data(), path.data() + path.size(), *m_regex);
+    }
+    return false;
+}
+
+bool RealmPathMatcher::glob_matches(StringData path, size_t token, size_t pos) const
+{
+    auto& tokens = *m_glob;
+    for (; token < tokens.size(); ++token) {
+        auto& current = tokens[token];
+        switch (current.type) {
+            case GlobToken::Type::Literal:
+                if (path.size() - pos < current.literal.size() ||
+                    path.substr(pos, current.literal.size()) != current.literal)
+                    return false;
+                pos += current.literal.size();
+                break;
+            case GlobToken::Type::AnyChar:
+                if (pos == path.size() || path[pos] == '/')
+                    return false;
+                ++pos;
+                break;
+            case GlobToken::Type::Star:
+            case GlobToken::Type::DoubleStar: {
+                bool cross_components = current.type == GlobToken::Type::DoubleStar;
+                if (token + 1 == tokens.size())
+                    return cross_components || std::find(path.data() + pos, path.data() + path.size(), '/') == path.data() + path.size();
+                for (size_t end = pos; end <= path.size(); ++end) {
+                    if (glob_matches(path, token + 1, end))
+                        return true;
+                    if (end == path.size() || (!cross_components && path[end] == '/'))
+                        break;
+                }
+                return false;
+            }
+        }
+    }
+    return pos == path.size();
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_REALM_PATH_MATCHER_HPP
+#define REALM_OS_REALM_PATH_MATCHER_HPP
+
+#include <realm/string_data.hpp>
+
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace realm {
+// Selects which of the Realms listed in the admin Realm a server-side
+// listener is interested in, by virtual path. Matchers are compiled when
+// they are created so that checking each of a very large number of paths
+// is cheap, and are cheap to copy.
+class RealmPathMatcher {
+public:
+    // Matches every path
+    RealmPathMatcher() = default;
+
+    // Matches paths which start with `prefix`
+    static RealmPathMatcher prefix(std::string prefix);
+
+    // Matches paths against a glob pattern, where `?` matches any single
+    // character other than `/`, `*` matches any number of characters other
+    // than `/` and `**` matches any number of characters including `/`.
+    // Every other character matches itself.
+    static RealmPathMatcher glob(std::string const& pattern);
+
+    // Matches paths which entirely match `regex`
+    static RealmPathMatcher regex(std::regex regex);
+
+    bool matches(StringData path) const;
+
+private:
+    enum class Kind {
+        All,
+        Prefix,
+        Glob,
+        Regex,
+    };
+
+    struct GlobToken {
+        enum class Type {
+            Literal,
+            AnyChar,
+            Star,
+            DoubleStar,
+        } type;
+        std::string literal;
+    };
+
+    Kind m_kind = Kind::All;
+    // The prefix for Prefix, or the literal text at the start of the pattern
+    // for Glob, which lets most paths be rejected without running the matcher
+    std::string m_prefix;
+    std::shared_ptr<const std::vector<GlobToken>> m_glob;
+    std::shared_ptr<const std::regex> m_regex;
+
+    bool glob_matches(StringData path, size_t token, size_t pos) const;
+};
+} // namespace realm
+
+#endif // REALM_OS_REALM_PATH_MATCHER_HPP
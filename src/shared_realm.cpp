@@ -19,12 +19,17 @@
 #include "shared_realm.hpp"
 
 #include "impl/collection_notifier.hpp"
+#include "impl/open_trace.hpp"
+#include "impl/primary_key_cache.hpp"
 #include "impl/realm_coordinator.hpp"
 #include "impl/transact_log_handler.hpp"
+#include "util/event_loop_signal.hpp"
+#include "util/executor.hpp"
 #include "util/fifo.hpp"
 
 #include "audit.hpp"
 #include "binding_context.hpp"
+#include "keypath_helpers.hpp"
 #include "list.hpp"
 #include "object.hpp"
 #include "object_schema.hpp"
@@ -36,6 +41,11 @@
 #include <realm/history.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <algorithm>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
 #if REALM_ENABLE_SYNC
 #include "sync/impl/sync_file.hpp"
 #include "sync/sync_config.hpp"
@@ -56,36 +66,46 @@ namespace sync {
 using namespace realm;
 using namespace realm::_impl;
 
+static bool get_file_stats(SharedGroup& sg, size_t& free_space, size_t& used_space)
+{
+    // getting stats requires committing a write transaction beforehand.
+    Group* group = nullptr;
+    if (!sg.try_begin_write(group))
+        return false;
+    sg.commit();
+    sg.get_stats(free_space, used_space);
+    return true;
+}
+
 Realm::Realm(Config config, std::shared_ptr<_impl::RealmCoordinator> coordinator)
 : m_config(std::move(config))
 , m_execution_context(m_config.execution_context)
 {
+    OpenTraceTimer open_timer(m_config.open_trace, OpenPhase::FileOpen);
     open_with_config(m_config, m_history, m_shared_group, m_read_only_group, this);
+    open_timer.done();
 
+    OpenTraceTimer schema_timer(m_config.open_trace, OpenPhase::SchemaRead);
     if (m_read_only_group) {
         m_group = m_read_only_group.get();
         m_schema_version = ObjectStore::get_schema_version(*m_group);
-        m_schema = ObjectStore::schema_from_group(*m_group);
+        m_schema = std::make_shared<Schema>(ObjectStore::schema_from_group(*m_group));
     }
-    else if (!coordinator || !coordinator->get_cached_schema(m_schema, m_schema_version, m_schema_transaction_version)) {
+    else if (!coordinator || !coordinator->get_cached_schema(*m_schema, m_schema_version, m_schema_transaction_version)) {
         if (m_config.should_compact_on_launch_function) {
             size_t free_space = -1;
             size_t used_space = -1;
-            // getting stats requires committing a write transaction beforehand.
-            Group* group = nullptr;
-            if (m_shared_group->try_begin_write(group)) {
-                m_shared_group->commit();
-                m_shared_group->get_stats(free_space, used_space);
-                if (m_config.should_compact_on_launch_function(free_space + used_space, used_space))
-                    compact();
-            }
+            if (get_file_stats(*m_shared_group, free_space, used_space)
+                && m_config.should_compact_on_launch_function(free_space + used_space, used_space))
+                compact();
         }
         read_group();
         if (coordinator)
-            coordinator->cache_schema(m_schema, m_schema_version, m_schema_transaction_version);
+            coordinator->cache_schema(*m_schema, m_schema_version, m_schema_transaction_version);
         m_shared_group->end_read();
         m_group = nullptr;
     }
+    schema_timer.done();
 
     m_coordinator = std::move(coordinator);
 }
@@ -258,6 +278,17 @@ void Realm::Internal::begin_read(Realm& realm, VersionID version_id)
     realm.begin_read(version_id);
 }
 
+void Realm::Internal::begin_frozen_read(Realm& realm, VersionID version_id)
+{
+    realm.m_frozen = true;
+    realm.begin_read(version_id);
+
+    // Create all of the table accessors up front so that concurrent readers
+    // don't race to create them
+    for (size_t i = 0, size = realm.m_group->size(); i < size; ++i)
+        realm.m_group->get_table(i);
+}
+
 void Realm::begin_read(VersionID version_id)
 {
     REALM_ASSERT(!m_group);
@@ -268,7 +299,9 @@ void Realm::begin_read(VersionID version_id)
 
 SharedRealm Realm::get_shared_realm(Config config)
 {
+    OpenTraceTimer timer(config.open_trace, OpenPhase::CoordinatorLookup);
     auto coordinator = RealmCoordinator::get_coordinator(config.path);
+    timer.done();
     return coordinator->get_realm(std::move(config));
 }
 
@@ -278,14 +311,111 @@ void Realm::get_shared_realm(Config config, std::function<void(SharedRealm, std:
     coordinator->get_realm(std::move(config), callback);
 }
 
+namespace {
+struct AsyncOpenState;
+
+// Opens the Realm for the thread which called async_open() once the
+// background open has finished
+struct AsyncOpenCallback {
+    std::shared_ptr<AsyncOpenState> state;
+    void operator()() const;
+};
+
+struct AsyncOpenState {
+    Realm::Config config;
+    std::function<void(SharedRealm, std::exception_ptr)> callback;
+    std::exception_ptr error;
+    // Keeps the schema cached by the background open around until the Realm
+    // for the calling thread has been opened
+    std::shared_ptr<RealmCoordinator> coordinator;
+    // Exactly one of these is set, depending on if the config has a notification executor
+    std::shared_ptr<util::Executor> executor;
+    std::shared_ptr<util::EventLoopSignal<AsyncOpenCallback>> signal;
+};
+
+void AsyncOpenCallback::operator()() const
+{
+    // Resetting the signal destroys this callback, so keep the state alive
+    auto state = this->state;
+    state->signal.reset();
+
+    SharedRealm realm;
+    auto error = state->error;
+    if (!error) {
+        try {
+            realm = Realm::get_shared_realm(std::move(state->config));
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+    }
+    state->coordinator = nullptr;
+    state->callback(std::move(realm), error);
+}
+
+} // anonymous namespace
+
+void Realm::async_open(Config config, std::function<void(SharedRealm, std::exception_ptr)> callback)
+{
+    auto state = std::make_shared<AsyncOpenState>();
+    state->coordinator = RealmCoordinator::get_coordinator(config.path);
+    state->callback = std::move(callback);
+    if (config.notification_executor)
+        state->executor = config.notification_executor;
+    else
+        state->signal = std::make_shared<util::EventLoopSignal<AsyncOpenCallback>>(AsyncOpenCallback{state});
+
+    auto background_config = config;
+    background_config.cache = false;
+    background_config.execution_context = util::none;
+    background_config.notification_executor = nullptr;
+    // Warmed up before calling back rather than on a thread of its own
+    auto warm_up_object_types = std::move(background_config.warm_up_object_types);
+    background_config.warm_up_object_types.clear();
+    state->config = std::move(config);
+
+    std::thread([state, config = std::move(background_config),
+                 warm_up_object_types = std::move(warm_up_object_types)]() mutable {
+        try {
+            auto realm = Realm::get_shared_realm(std::move(config));
+            // A schema change performed by the open clears the coordinator's
+            // schema cache, so put the file's schema back into it for the open
+            // on the calling thread to use
+            if (!realm->m_read_only_group) {
+                auto full_schema = realm->get_full_schema();
+                auto transaction = realm->m_shared_group->get_version_of_current_transaction().version;
+                realm->m_coordinator->cache_schema(full_schema, realm->m_schema_version, transaction);
+            }
+            realm->m_coordinator->warm_up_tables(*realm, warm_up_object_types);
+        }
+        catch (...) {
+            state->error = std::current_exception();
+        }
+        if (state->executor)
+            state->executor->post(AsyncOpenCallback{state});
+        else
+            state->signal->notify();
+    }).detach();
+}
+
 void Realm::set_schema(Schema const& reference, Schema schema)
 {
     m_dynamic_schema = false;
     schema.copy_table_columns_from(reference);
-    m_schema = std::move(schema);
+    replace_schema(std::move(schema));
     notify_schema_changed();
 }
 
+void Realm::replace_schema(Schema schema)
+{
+    m_schema = std::make_shared<Schema>(std::move(schema));
+}
+
+void Realm::copy_table_columns_from(Schema const& schema)
+{
+    m_schema->copy_table_columns_from(schema);
+}
+
 void Realm::read_schema_from_group_if_needed()
 {
     REALM_ASSERT(!m_read_only_group);
@@ -296,27 +426,51 @@ void Realm::read_schema_from_group_if_needed()
         return;
 
     m_schema_transaction_version = current_version;
-    m_schema_version = ObjectStore::get_schema_version(group);
-    auto schema = ObjectStore::schema_from_group(group);
-    if (m_coordinator)
-        m_coordinator->cache_schema(schema, m_schema_version,
-                                    m_schema_transaction_version);
+    m_validated_schema_hash = 0;
+    std::shared_ptr<const Schema> shared_schema;
+    // Another Realm or notifier may have already read the schema for this
+    // version even if it isn't the latest one
+    if (!m_coordinator || !m_coordinator->get_cached_schema(current_version, shared_schema, m_schema_version)) {
+        m_schema_version = ObjectStore::get_schema_version(group);
+        Schema schema;
+        // If the last schema update recorded that the file's schema is exactly the
+        // schema we're being opened with then we can use that rather than reading
+        // it from the group. Sync can change the schema behind our back, so it
+        // doesn't get to skip this.
+        if (m_config.schema && !m_config.sync_config) {
+            uint64_t hash = ObjectStore::schema_hash(*m_config.schema);
+            if (ObjectStore::schema_hash_matches(group, hash)) {
+                schema = *m_config.schema;
+                // Computed properties aren't part of the file's schema
+                for (auto& object_schema : schema)
+                    object_schema.computed_properties.clear();
+                ObjectStore::set_schema_columns(group, schema);
+                m_validated_schema_hash = hash;
+            }
+        }
+        if (!m_validated_schema_hash)
+            schema = ObjectStore::schema_from_group(group);
+        shared_schema = std::make_shared<const Schema>(std::move(schema));
+        if (m_coordinator)
+            m_coordinator->cache_schema(shared_schema, m_schema_version,
+                                        m_schema_transaction_version);
+    }
 
     if (m_dynamic_schema) {
-        if (m_schema == schema) {
+        if (*m_schema == *shared_schema) {
             // The structure of the schema hasn't changed. Bring the table column indices up to date.
-            m_schema.copy_table_columns_from(schema);
+            copy_table_columns_from(*shared_schema);
         }
         else {
             // The structure of the schema has changed, so replace our copy of the schema.
             // FIXME: This invalidates any pointers to the object schemas within the schema vector,
             // which will cause problems for anyone that caches such a pointer.
-            m_schema = std::move(schema);
+            replace_schema(*shared_schema);
         }
     }
     else {
-        ObjectStore::verify_valid_external_changes(m_schema.compare(schema));
-        m_schema.copy_table_columns_from(schema);
+        ObjectStore::verify_valid_external_changes(m_schema->compare(*shared_schema));
+        copy_table_columns_from(*shared_schema);
     }
     notify_schema_changed();
 }
@@ -333,9 +487,11 @@ bool Realm::reset_file(Schema& schema, std::vector<SchemaChange>& required_chang
     util::File::remove(m_config.path);
 
     open_with_config(m_config, m_history, m_shared_group, m_read_only_group, this);
-    m_schema = ObjectStore::schema_from_group(read_group());
+    m_coordinator->reset_change_journal();
+    m_validated_schema_hash = 0;
+    replace_schema(ObjectStore::schema_from_group(read_group()));
     m_schema_version = ObjectStore::get_schema_version(read_group());
-    required_changes = m_schema.compare(schema);
+    required_changes = m_schema->compare(schema);
     m_coordinator->clear_schema_cache_and_set_schema_version(m_schema_version);
     return false;
 }
@@ -396,20 +552,20 @@ Schema Realm::get_full_schema()
     // If the user hasn't specified a schema previously then m_schema is always
     // the full schema
     if (m_dynamic_schema)
-        return m_schema;
+        return *m_schema;
 
     // Otherwise we may have a subset of the file's schema, so we need to get
     // the complete thing to calculate what changes to make
     if (m_read_only_group)
         return ObjectStore::schema_from_group(read_group());
 
-    Schema actual_schema;
+    std::shared_ptr<const Schema> actual_schema;
     uint64_t actual_version;
     uint64_t transaction = -1;
     bool got_cached = m_coordinator->get_cached_schema(actual_schema, actual_version, transaction);
     if (!got_cached || transaction != m_shared_group->get_version_of_current_transaction().version)
         return ObjectStore::schema_from_group(read_group());
-    return actual_schema;
+    return *actual_schema;
 }
 
 void Realm::set_schema_subset(Schema schema)
@@ -417,7 +573,7 @@ void Realm::set_schema_subset(Schema schema)
     REALM_ASSERT(m_dynamic_schema);
     REALM_ASSERT(m_schema_version != ObjectStore::NotVersioned);
 
-    std::vector<SchemaChange> changes = m_schema.compare(schema);
+    std::vector<SchemaChange> changes = m_schema->compare(schema);
     switch (m_config.schema_mode) {
         case SchemaMode::Automatic:
         case SchemaMode::ResetFile:
@@ -438,7 +594,7 @@ void Realm::set_schema_subset(Schema schema)
             break;
     }
 
-    set_schema(m_schema, std::move(schema));
+    set_schema(*m_schema, std::move(schema));
 }
 
 void Realm::update_schema(Schema schema, uint64_t version, MigrationFunction migration_function,
@@ -446,14 +602,26 @@ void Realm::update_schema(Schema schema, uint64_t version, MigrationFunction mig
 {
     schema.validate();
 
+    OpenTraceTimer compare_timer(m_config.open_trace, OpenPhase::SchemaCompare);
     Schema actual_schema = get_full_schema();
-    std::vector<SchemaChange> required_changes = actual_schema.compare(schema);
+    std::vector<SchemaChange> required_changes;
+    // No need to compare the schemas if opening the file found that its schema
+    // is this exact schema and it hasn't changed since then
+    if (!m_validated_schema_hash || m_validated_schema_hash != ObjectStore::schema_hash(schema))
+        required_changes = actual_schema.compare(schema);
+    compare_timer.done();
 
     if (!schema_change_needs_write_transaction(schema, required_changes, version)) {
         set_schema(actual_schema, std::move(schema));
         return;
     }
+    // Bulk-load commits aren't parsed for notifications, so the notifiers
+    // would never learn about the new tables and columns
+    if (m_bulk_load)
+        throw InvalidTransactionException("Cannot change the schema in a bulk-load write transaction.");
+
     // Either the schema version has changed or we need to do non-migration changes
+    OpenTraceTimer migration_timer(m_config.open_trace, OpenPhase::Migration);
 
     if (!in_transaction) {
         transaction::begin_without_validation(*m_shared_group);
@@ -483,26 +651,38 @@ void Realm::update_schema(Schema schema, uint64_t version, MigrationFunction mig
     uint64_t old_schema_version = m_schema_version;
     bool additive = m_config.schema_mode == SchemaMode::Additive;
     if (migration_function && !additive) {
+        std::shared_ptr<Schema> migration_schema;
         auto wrapper = [&] {
-            SharedRealm old_realm(new Realm(m_config, nullptr));
+            // The old Realm's phases would otherwise be reported as if they
+            // were part of opening this one
+            auto old_config = m_config;
+            old_config.open_trace = nullptr;
+            OpenTraceTimer old_realm_timer(m_config.open_trace, OpenPhase::MigrationOldRealmOpen);
+            SharedRealm old_realm(new Realm(std::move(old_config), nullptr));
+            migration_timer.exclude(old_realm_timer.done());
             // Need to open in read-write mode so that it uses a SharedGroup, but
             // users shouldn't actually be able to write via the old realm
             old_realm->m_config.schema_mode = SchemaMode::Immutable;
-            migration_function(old_realm, shared_from_this(), m_schema);
+            migration_function(old_realm, shared_from_this(), *migration_schema);
         };
 
         // migration function needs to see the target schema on the "new" Realm
-        std::swap(m_schema, schema);
+        migration_schema = std::make_shared<Schema>(std::move(schema));
+        auto old_schema = std::exchange(m_schema, migration_schema);
         std::swap(m_schema_version, version);
+        clear_schema_caches();
         m_in_migration = true;
         auto restore = util::make_scope_exit([&]() noexcept {
-            std::swap(m_schema, schema);
+            schema = std::move(*migration_schema);
+            m_schema = std::move(old_schema);
             std::swap(m_schema_version, version);
+            clear_schema_caches();
             m_in_migration = false;
         });
 
-        ObjectStore::apply_schema_changes(read_group(), version, m_schema, m_schema_version,
-                                          m_config.schema_mode, required_changes, util::none, wrapper);
+        ObjectStore::apply_schema_changes(read_group(), version, *migration_schema, m_schema_version,
+                                          m_config.schema_mode, required_changes, util::none, wrapper,
+                                          m_config.migration_progress);
     }
     else {
         util::Optional<std::string> sync_user_id;
@@ -511,28 +691,38 @@ void Realm::update_schema(Schema schema, uint64_t version, MigrationFunction mig
             sync_user_id = m_config.sync_config->user->identity();
 #endif
         ObjectStore::apply_schema_changes(read_group(), m_schema_version, schema, version,
-                                          m_config.schema_mode, required_changes, std::move(sync_user_id));
+                                          m_config.schema_mode, required_changes, std::move(sync_user_id),
+                                          {}, m_config.migration_progress);
         REALM_ASSERT_DEBUG(additive || (required_changes = ObjectStore::schema_from_group(read_group()).compare(schema)).empty());
     }
 
     if (initialization_function && old_schema_version == ObjectStore::NotVersioned) {
         // Initialization function needs to see the latest schema
         uint64_t temp_version = ObjectStore::get_schema_version(read_group());
-        std::swap(m_schema, schema);
+        auto new_schema = std::make_shared<Schema>(std::move(schema));
+        auto old_schema = std::exchange(m_schema, new_schema);
         std::swap(m_schema_version, temp_version);
+        clear_schema_caches();
         auto restore = util::make_scope_exit([&]() noexcept {
-            std::swap(m_schema, schema);
+            schema = std::move(*new_schema);
+            m_schema = std::move(old_schema);
             std::swap(m_schema_version, temp_version);
+            clear_schema_caches();
         });
         initialization_function(shared_from_this());
     }
 
+    if (!m_config.sync_config)
+        ObjectStore::update_schema_hash(read_group(), schema);
+
     if (!in_transaction) {
         commit_transaction();
     }
+    migration_timer.done();
 
-    m_schema = std::move(schema);
+    replace_schema(std::move(schema));
     m_schema_version = ObjectStore::get_schema_version(read_group());
+    m_validated_schema_hash = 0;
     m_dynamic_schema = false;
     m_coordinator->clear_schema_cache_and_set_schema_version(version);
     notify_schema_changed();
@@ -540,18 +730,20 @@ void Realm::update_schema(Schema schema, uint64_t version, MigrationFunction mig
 
 void Realm::add_schema_change_handler()
 {
-    if (m_config.immutable())
+    // Frozen Realms never advance, so the schema can't change
+    if (m_config.immutable() || m_frozen)
         return;
     m_group->set_schema_change_notification_handler([&] {
-        m_new_schema = ObjectStore::schema_from_group(read_group());
+        m_validated_schema_hash = 0;
+        m_new_schema = std::make_shared<const Schema>(ObjectStore::schema_from_group(read_group()));
         m_schema_version = ObjectStore::get_schema_version(read_group());
         if (m_dynamic_schema) {
             // FIXME: This invalidates any pointers to the object schemas within the schema vector,
             // which will cause problems for anyone that caches such a pointer.
-            m_schema = *m_new_schema;
+            replace_schema(*m_new_schema);
         }
         else
-            m_schema.copy_table_columns_from(*m_new_schema);
+            copy_table_columns_from(*m_new_schema);
 
         notify_schema_changed();
     });
@@ -565,12 +757,12 @@ void Realm::cache_new_schema()
     auto new_version = m_shared_group->get_version_of_current_transaction().version;
     if (m_coordinator) {
         if (m_new_schema)
-            m_coordinator->cache_schema(std::move(*m_new_schema), m_schema_version, new_version);
+            m_coordinator->cache_schema(std::move(m_new_schema), m_schema_version, new_version);
         else
             m_coordinator->advance_schema_cache(m_schema_transaction_version, new_version);
     }
     m_schema_transaction_version = new_version;
-    m_new_schema = util::none;
+    m_new_schema = nullptr;
 }
 
 void Realm::translate_schema_error()
@@ -583,16 +775,24 @@ void Realm::translate_schema_error()
     auto& new_schema = realm->schema();
 
     // Should always throw
-    ObjectStore::verify_valid_external_changes(m_schema.compare(new_schema, true));
+    ObjectStore::verify_valid_external_changes(m_schema->compare(new_schema, true));
 
     // Something strange happened so just rethrow the old exception
     throw;
 }
 
+void Realm::clear_schema_caches()
+{
+    m_keypath_cache.clear();
+    m_keypath_mapping_cache = nullptr;
+    m_audit_table_in_scope.clear();
+}
+
 void Realm::notify_schema_changed()
 {
+    clear_schema_caches();
     if (m_binding_context) {
-        m_binding_context->schema_did_change(m_schema);
+        m_binding_context->schema_did_change(*m_schema);
     }
 }
 
@@ -608,10 +808,22 @@ static void check_write(const Realm* realm)
     if (realm->config().immutable() || realm->config().read_only_alternative()) {
         throw InvalidTransactionException("Can't perform transactions on read-only Realms.");
     }
+    if (realm->is_frozen()) {
+        throw InvalidTransactionException("Can't perform transactions on frozen Realms.");
+    }
 }
 
 void Realm::verify_thread() const
 {
+    if (m_frozen)
+        return;
+
+    if (m_config.notification_executor) {
+        if (!m_config.notification_executor->is_current())
+            throw IncorrectThreadException();
+        return;
+    }
+
     if (!m_execution_context.contains<std::thread::id>())
         return;
 
@@ -642,6 +854,15 @@ VersionID Realm::read_transaction_version() const
     return m_shared_group->get_version_of_current_transaction();
 }
 
+uint64_t Realm::get_number_of_versions() const
+{
+    verify_thread();
+    verify_open();
+    if (m_read_only_group)
+        return 1;
+    return m_shared_group->get_number_of_versions();
+}
+
 bool Realm::is_in_transaction() const noexcept
 {
     if (!m_shared_group) {
@@ -650,7 +871,7 @@ bool Realm::is_in_transaction() const noexcept
     return m_shared_group->get_transact_stage() == SharedGroup::transact_Writing;
 }
 
-void Realm::begin_transaction()
+void Realm::begin_transaction(BulkLoad bulk_load)
 {
     check_write(this);
     verify_thread();
@@ -658,6 +879,7 @@ void Realm::begin_transaction()
     if (is_in_transaction()) {
         throw InvalidTransactionException("The Realm is already in a write transaction");
     }
+    m_bulk_load = bulk_load;
 
     // Any of the callbacks to user code below could drop the last remaining
     // strong reference to `this`
@@ -697,15 +919,17 @@ void Realm::commit_transaction()
         throw InvalidTransactionException("Can't commit a non-existing write transaction");
     }
 
-    if (auto audit = audit_context()) {
+    if (auto audit = audit_context(AuditEvent::Write)) {
         auto prev_version = m_shared_group->pin_version();
-        m_coordinator->commit_write(*this);
+        m_coordinator->commit_write(*this, m_bulk_load);
         audit->record_write(prev_version, m_shared_group->get_version_of_current_transaction());
         m_shared_group->unpin_version(prev_version);
     }
     else {
-        m_coordinator->commit_write(*this);
+        m_coordinator->commit_write(*this, m_bulk_load);
     }
+    m_bulk_load = false;
+    m_primary_key_cache = nullptr;
     cache_new_schema();
     invalidate_permission_cache();
 }
@@ -720,16 +944,87 @@ void Realm::cancel_transaction()
     }
 
     transaction::cancel(*m_shared_group, m_binding_context.get());
+    m_bulk_load = false;
+    m_primary_key_cache = nullptr;
     invalidate_permission_cache();
 }
 
+struct Realm::AsyncWriteState {
+    std::weak_ptr<Realm> realm;
+    std::function<void(std::exception_ptr)> completion;
+    std::exception_ptr error;
+    // Exactly one of these is set, depending on if the Realm has a notification executor
+    std::shared_ptr<util::Executor> executor;
+    std::shared_ptr<util::EventLoopSignal<std::function<void()>>> signal;
+};
+
+// Deliver the result of an async write on the thread of the Realm which
+// requested it
+void Realm::deliver_async_write(std::weak_ptr<AsyncWriteState> const& weak_state)
+{
+    auto state = weak_state.lock();
+    if (!state)
+        return;
+    auto realm = state->realm.lock();
+    if (!realm)
+        return;
+    // Released at the end of this function rather than here, as the signal
+    // owns the callback which is running
+    auto& pending = realm->m_async_writes;
+    pending.erase(std::remove(pending.begin(), pending.end(), state), pending.end());
+
+    if (realm->is_closed())
+        return;
+    if (!realm->is_in_transaction())
+        realm->refresh();
+    state->completion(state->error);
+}
+
+void Realm::async_write(std::function<void(Realm&)> write, std::function<void(std::exception_ptr)> completion,
+                        bool allow_grouping)
+{
+    check_write(this);
+    verify_thread();
+    verify_open();
+
+    auto state = std::make_shared<AsyncWriteState>();
+    std::weak_ptr<AsyncWriteState> weak_state = state;
+    auto deliver = [weak_state] { deliver_async_write(weak_state); };
+    state->realm = shared_from_this();
+    state->completion = std::move(completion);
+    if (m_config.notification_executor)
+        state->executor = m_config.notification_executor;
+    else
+        state->signal = std::make_shared<util::EventLoopSignal<std::function<void()>>>(deliver);
+    m_async_writes.push_back(std::move(state));
+
+    // The write is performed by a Realm instance confined to the background
+    // thread, which is shared by all of the async writes for the file
+    auto config = m_config;
+    config.cache = false;
+    config.execution_context = util::none;
+    config.notification_executor = nullptr;
+    auto done = [weak_state = std::move(weak_state), deliver = std::move(deliver)](std::exception_ptr error) {
+        auto state = weak_state.lock();
+        if (!state)
+            return;
+        state->error = error;
+        if (state->executor)
+            state->executor->post(deliver);
+        else
+            state->signal->notify();
+    };
+    m_coordinator->post_async_write({std::move(config), std::move(write), std::move(done), allow_grouping});
+}
+
 void Realm::invalidate()
 {
     verify_open();
     verify_thread();
     check_read_write(this);
 
-    if (m_is_sending_notifications) {
+    // Other threads may be reading from a frozen Realm's read transaction
+    if (m_is_sending_notifications || m_frozen) {
         return;
     }
 
@@ -742,11 +1037,12 @@ void Realm::invalidate()
 
     m_permissions_cache = nullptr;
     m_table_info_cache = nullptr;
+    m_keypath_mapping_cache = nullptr;
     m_shared_group->end_read();
     m_group = nullptr;
 }
 
-bool Realm::compact()
+void Realm::verify_can_compact() const
 {
     verify_thread();
 
@@ -758,15 +1054,47 @@ bool Realm::compact()
     }
 
     verify_open();
+}
+
+bool Realm::compact()
+{
+    verify_can_compact();
     // FIXME: when enum columns are ready, optimise all tables in a write transaction
     if (m_group) {
         m_shared_group->end_read();
     }
     m_group = nullptr;
+    m_keypath_mapping_cache = nullptr;
 
     return m_shared_group->compact();
 }
 
+util::Optional<uint64_t> Realm::compact_if_needed(ShouldCompactOnLaunchFunction const& should_compact)
+{
+    verify_can_compact();
+    if (m_group) {
+        m_shared_group->end_read();
+        m_group = nullptr;
+        m_keypath_mapping_cache = nullptr;
+    }
+
+    // Unlike on launch, don't commit an empty write transaction to bring the
+    // free-list up to date, as that would add a version to the file every
+    // time this is called. The stats of the latest snapshot can only
+    // understate the free space, so this never compacts when it wouldn't have
+    // otherwise.
+    size_t free_space = -1;
+    size_t used_space = -1;
+    m_shared_group->get_stats(free_space, used_space);
+    if (!should_compact(free_space + used_space, used_space) || !m_shared_group->compact())
+        return util::none;
+
+    uint64_t old_size = free_space + used_space;
+    m_shared_group->get_stats(free_space, used_space);
+    uint64_t new_size = free_space + used_space;
+    return old_size > new_size ? old_size - new_size : 0;
+}
+
 void Realm::write_copy(StringData path, BinaryData key)
 {
     if (key.data() && key.size() != 64) {
@@ -781,6 +1109,77 @@ void Realm::write_copy(StringData path, BinaryData key)
     }
 }
 
+namespace {
+// A streambuf which passes the data written to it to a callback in chunks of
+// at most `buffer_size` bytes, so that the data never has to be in memory all
+// at once. Writes which don't fit in the buffer are passed along directly.
+class SinkStreamBuf : public std::streambuf {
+public:
+    SinkStreamBuf(Realm::WriteCopySink& sink, size_t buffer_size)
+    : m_sink(sink), m_buffer(buffer_size)
+    {
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        flush_buffer();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override
+    {
+        if (size < epptr() - pptr()) {
+            std::copy(data, data + size, pptr());
+            pbump(int(size));
+            return size;
+        }
+        flush_buffer();
+        for (std::streamsize offset = 0; offset < size; ) {
+            size_t chunk = std::min(size_t(size - offset), m_buffer.size());
+            m_sink(data + offset, chunk);
+            offset += chunk;
+        }
+        return size;
+    }
+
+    int sync() override
+    {
+        flush_buffer();
+        return 0;
+    }
+
+private:
+    Realm::WriteCopySink& m_sink;
+    std::vector<char> m_buffer;
+
+    void flush_buffer()
+    {
+        if (pptr() != pbase())
+            m_sink(pbase(), size_t(pptr() - pbase()));
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+};
+} // anonymous namespace
+
+void Realm::write_copy(WriteCopySink sink, size_t buffer_size)
+{
+    verify_thread();
+    REALM_ASSERT(sink && buffer_size > 0);
+
+    SinkStreamBuf buf(sink, buffer_size);
+    std::ostream out(&buf);
+    // Rethrow exceptions from the sink rather than just setting badbit
+    out.exceptions(std::ios_base::badbit);
+    read_group().write(out);
+    out.flush();
+}
+
 OwnedBinaryData Realm::write_copy()
 {
     verify_thread();
@@ -793,7 +1192,7 @@ OwnedBinaryData Realm::write_copy()
 
 void Realm::notify()
 {
-    if (is_closed() || is_in_transaction()) {
+    if (is_closed() || is_in_transaction() || m_frozen) {
         return;
     }
 
@@ -847,12 +1246,51 @@ void Realm::notify()
 }
 
 bool Realm::refresh()
+{
+    return do_refresh(nullptr);
+}
+
+bool Realm::refresh(ChangeSummary& summary)
+{
+    summary = {};
+    if (m_group)
+        summary.from_version = read_transaction_version();
+
+    _impl::TransactionChangeInfo info{};
+    info.track_all = true;
+    bool version_changed = do_refresh(&info);
+    if (is_closed() || !m_group)
+        return version_changed;
+
+    summary.to_version = read_transaction_version();
+    if (!version_changed || summary.from_version == VersionID{})
+        return version_changed;
+
+    summary.schema_changed = info.schema_changed;
+    auto& group = read_group();
+    for (auto& entry : info.tables) {
+        if (entry.table_ndx >= group.size())
+            continue;
+        auto object_type = ObjectStore::object_type_for_table_name(group.get_table_name(entry.table_ndx));
+        if (object_type.size() == 0)
+            continue;
+        auto changes = std::move(*entry.changes).finalize();
+        if (changes.empty())
+            continue;
+        summary.object_types.push_back({std::string(object_type), changes.insertions.count(),
+                                        changes.deletions.count(), changes.modifications.count()});
+    }
+    return version_changed;
+}
+
+bool Realm::do_refresh(_impl::TransactionChangeInfo* changes)
 {
     verify_thread();
     check_read_write(this);
 
-    // can't be any new changes if we're in a write transaction
-    if (is_in_transaction()) {
+    // can't be any new changes if we're in a write transaction, and frozen
+    // Realms never change
+    if (is_in_transaction() || m_frozen) {
         return false;
     }
     // don't advance if we're already in the process of advancing as that just
@@ -874,7 +1312,7 @@ bool Realm::refresh()
     }
     if (m_group) {
         try {
-            bool version_changed = m_coordinator->advance_to_latest(*this);
+            bool version_changed = m_coordinator->advance_to_latest(*this, changes);
             cache_new_schema();
             return version_changed;
         }
@@ -891,7 +1329,7 @@ bool Realm::refresh()
 
 bool Realm::can_deliver_notifications() const noexcept
 {
-    if (m_config.immutable() || !m_config.automatic_change_notifications) {
+    if (m_config.immutable() || m_frozen || !m_config.automatic_change_notifications) {
         return false;
     }
 
@@ -920,6 +1358,8 @@ void Realm::close()
 
     m_permissions_cache = nullptr;
     m_table_info_cache = nullptr;
+    m_keypath_mapping_cache = nullptr;
+    m_primary_key_cache = nullptr;
     m_group = nullptr;
     m_shared_group = nullptr;
     m_history = nullptr;
@@ -949,6 +1389,20 @@ realm::ThreadSafeReference<T> Realm::obtain_thread_safe_reference(T const& value
 template ThreadSafeReference<Object> Realm::obtain_thread_safe_reference(Object const& value);
 template ThreadSafeReference<List> Realm::obtain_thread_safe_reference(List const& value);
 template ThreadSafeReference<Results> Realm::obtain_thread_safe_reference(Results const& value);
+template ThreadSafeReference<std::vector<Object>> Realm::obtain_thread_safe_reference(std::vector<Object> const& value);
+
+template <typename T>
+static bool is_valid(T const& value)
+{
+    return value.is_valid();
+}
+
+// Individual objects in a batch may have been deleted, but the batch itself
+// can always be handed over again
+static bool is_valid(std::vector<Object> const&)
+{
+    return true;
+}
 
 template <typename T>
 T Realm::resolve_thread_safe_reference(ThreadSafeReference<T> reference)
@@ -965,6 +1419,7 @@ T Realm::resolve_thread_safe_reference(ThreadSafeReference<T> reference)
                                        "than the source Realm.");
     }
     invalidate_permission_cache();
+    m_coordinator->did_import_thread_safe_reference();
 
     // Any of the callbacks to user code below could drop the last remaining
     // strong reference to `this`
@@ -1001,7 +1456,7 @@ T Realm::resolve_thread_safe_reference(ThreadSafeReference<T> reference)
             // With reference imported, advance temporary Realm to our version
             T imported_value = std::move(reference).import_into_realm(temporary_realm);
             transaction::advance(*temporary_realm->m_shared_group, nullptr, current_version);
-            if (!imported_value.is_valid())
+            if (!is_valid(imported_value))
                 return T{};
             reference = ThreadSafeReference<T>(imported_value);
         }
@@ -1013,12 +1468,85 @@ T Realm::resolve_thread_safe_reference(ThreadSafeReference<T> reference)
 template Object Realm::resolve_thread_safe_reference(ThreadSafeReference<Object> reference);
 template List Realm::resolve_thread_safe_reference(ThreadSafeReference<List> reference);
 template Results Realm::resolve_thread_safe_reference(ThreadSafeReference<Results> reference);
+template std::vector<Object> Realm::resolve_thread_safe_reference(ThreadSafeReference<std::vector<Object>> reference);
+
+SharedRealm Realm::freeze()
+{
+    verify_thread();
+    if (m_frozen)
+        return shared_from_this();
+    if (is_in_transaction()) {
+        throw InvalidTransactionException("Cannot freeze a Realm during a write transaction.");
+    }
+
+    // The read transaction keeps the version pinned while the frozen Realm
+    // begins its own read transaction at it
+    read_group();
+    return m_coordinator->get_frozen_realm(read_transaction_version());
+}
+
+template <typename T>
+T Realm::freeze(T const& value)
+{
+    verify_thread();
+    if (m_frozen)
+        return value;
+
+    auto frozen_realm = freeze();
+    ThreadSafeReference<T> reference(value);
+    // Importing creates accessors in the frozen Realm's Group, which other
+    // threads may be reading from
+    auto lock = Internal::lock_if_frozen(*frozen_realm);
+    return std::move(reference).import_into_realm(std::move(frozen_realm));
+}
+
+template Object Realm::freeze(Object const& value);
+template List Realm::freeze(List const& value);
+template Results Realm::freeze(Results const& value);
+template std::vector<Object> Realm::freeze(std::vector<Object> const& value);
 
 AuditInterface* Realm::audit_context() const noexcept
 {
     return m_coordinator ? m_coordinator->audit_context() : nullptr;
 }
 
+AuditInterface* Realm::audit_context(AuditEvent event, Table const* table)
+{
+    auto audit = audit_context();
+    if (!audit)
+        return nullptr;
+    auto& policy = m_config.audit_policy;
+
+    if (table && event != AuditEvent::Write && !policy.object_types.empty()) {
+        size_t ndx = table->get_index_in_group();
+        if (ndx >= m_audit_table_in_scope.size())
+            m_audit_table_in_scope.resize(ndx + 1, 0);
+        auto& in_scope = m_audit_table_in_scope[ndx];
+        if (in_scope == 0) {
+            auto object_type = ObjectStore::object_type_for_table_name(table->get_name());
+            auto it = std::find_if(policy.object_types.begin(), policy.object_types.end(),
+                                   [&](auto const& type) { return object_type == type; });
+            in_scope = it != policy.object_types.end() ? 1 : -1;
+        }
+        if (in_scope < 0)
+            return nullptr;
+    }
+
+    uint32_t interval = 0;
+    switch (event) {
+        case AuditEvent::Read:  interval = policy.read_sample_interval; break;
+        case AuditEvent::Query: interval = policy.query_sample_interval; break;
+        case AuditEvent::Write: interval = policy.write_sample_interval; break;
+    }
+    if (interval == 0)
+        return nullptr;
+    auto& counter = m_audit_sample_counters[size_t(event)];
+    bool record = counter == 0;
+    if (++counter >= interval)
+        counter = 0;
+    return record ? audit : nullptr;
+}
+
 #if REALM_ENABLE_SYNC
 static_assert(static_cast<int>(ComputedPrivileges::Read) == static_cast<int>(sync::Privilege::Read), "");
 static_assert(static_cast<int>(ComputedPrivileges::Update) == static_cast<int>(sync::Privilege::Update), "");
@@ -19,8 +19,11 @@
 #ifndef REALM_REALM_HPP
 #define REALM_REALM_HPP
 
+#include "audit.hpp"
 #include "execution_context_id.hpp"
+#include "notification_trace.hpp"
 #include "schema.hpp"
+#include "util/tagged_bool.hpp"
 
 #include <realm/util/optional.hpp>
 #include <realm/binary_data.hpp>
@@ -29,14 +32,22 @@
 #include <realm/sync/client.hpp>
 #endif
 
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace realm {
-class AuditInterface;
+namespace util {
+class Executor;
+}
 class BindingContext;
 class Group;
 class Realm;
 class Replication;
+class Results;
 class SharedGroup;
 class StringData;
 class Table;
@@ -54,9 +65,15 @@ typedef std::weak_ptr<Realm> WeakRealm;
 namespace _impl {
     class AnyHandover;
     class CollectionNotifier;
+    class KeyPathMappingCache;
+    class ObjectTableNotifier;
+    class PredicateCache;
+    class PrimaryKeyCache;
     class PartialSyncHelper;
     class RealmCoordinator;
     class RealmFriend;
+    class SubscriptionNotifier;
+    struct TransactionChangeInfo;
 }
 namespace sync {
     struct PermissionsCache;
@@ -164,6 +181,17 @@ public:
     // functions which take a Schema from within the migration function.
     using MigrationFunction = std::function<void (SharedRealm old_realm, SharedRealm realm, Schema&)>;
 
+    // A callback function called while a migration is being applied. It is
+    // passed the number of units of work completed so far and the total number
+    // of units, and is called at least once with completed == total when the
+    // migration finishes. Making a property nullable copies its values to a new
+    // column and counts one unit per row in the table; making a property
+    // required discards the values without copying them, so like every other
+    // step it counts as one unit. It is only called when the schema version
+    // changes in Automatic or Manual mode, and the migration is still committed
+    // as a single write transaction.
+    using MigrationProgressFunction = std::function<void (uint64_t completed, uint64_t total)>;
+
     // A callback function to be called the first time when a schema is created.
     // It is passed a SharedRealm which is in a write transaction with the schema
     // initialized. So it is possible to create some initial objects inside the callback
@@ -182,6 +210,38 @@ public:
     // because it's not crash safe! It may corrupt your database if something fails
     using ShouldCompactOnLaunchFunction = std::function<bool (uint64_t total_bytes, uint64_t used_bytes)>;
 
+    // A callback function passed each chunk of the file by write_copy(WriteCopySink)
+    using WriteCopySink = std::function<void (const char* data, size_t size)>;
+
+    // The phases of opening a Realm which are reported to Config::open_trace
+    enum class OpenPhase {
+        // Looking up or creating the RealmCoordinator for the file
+        CoordinatorLookup,
+        // Opening the file and its SharedGroup
+        FileOpen,
+        // Reading the schema from the file or the coordinator's cache,
+        // including any compaction requested by should_compact_on_launch_function
+        SchemaRead,
+        // Comparing the file's schema to the one in the config
+        SchemaCompare,
+        // Applying the schema changes, including any migration function but
+        // not the time spent in MigrationOldRealmOpen
+        Migration,
+        // Opening the Realm passed to the migration function as old_realm.
+        // Its own file open and schema read aren't reported separately.
+        MigrationOldRealmOpen,
+        // Creating the sync session
+        SyncSessionCreation,
+        // Setting up the commit helper which delivers change notifications
+        NotifierSetup,
+    };
+
+    // A callback function called with the time taken by each phase of opening
+    // a Realm. Only CoordinatorLookup is reported when the Realm is retrieved
+    // from the cache, and phases which aren't needed or which throw an
+    // exception aren't reported.
+    using OpenTraceFunction = std::function<void (OpenPhase phase, std::chrono::nanoseconds duration)>;
+
     struct Config {
         // Path and binary data are mutually exclusive
         std::string path;
@@ -204,6 +264,8 @@ public:
         util::Optional<Schema> schema;
         uint64_t schema_version = -1;
         MigrationFunction migration_function;
+        // Optional callback for reporting the progress of a migration
+        MigrationProgressFunction migration_progress;
 
         DataInitializationFunction initialization_function;
 
@@ -218,6 +280,18 @@ public:
         // because it's not crash safe! It may corrupt your database if something fails
         ShouldCompactOnLaunchFunction should_compact_on_launch_function;
 
+        // Optional callback for profiling how long opening the Realm takes.
+        // SchemaCompare and Migration are also reported by later calls to
+        // update_schema().
+        OpenTraceFunction open_trace;
+
+        // Optional callback for tracing the delivery of change notifications.
+        // Each step from a commit to the callbacks being called is reported
+        // as a NotificationSpan, which ChromeTraceRecorder can collect for
+        // viewing. The callback is used by every Realm instance for the file
+        // and is taken from the config of the first one opened.
+        NotificationTraceFunction notification_trace;
+
         // WARNING: The original read_only() has been renamed to immutable().
         bool immutable() const { return schema_mode == SchemaMode::Immutable; }
         // FIXME: Rename this to read_only().
@@ -240,11 +314,81 @@ public:
         // everything can be done deterministically on one thread, and
         // speeds up tests that don't need notifications.
         bool automatic_change_notifications = true;
+        // The number of threads used to run the async notifiers for this
+        // file. Each thread beyond the first uses its own SharedGroup pinned
+        // to the same version as the others, so this is only worth increasing
+        // for files with many notifiers which are each expensive to run.
+        size_t notifier_thread_count = 1;
+        // The minimum time between runs of the async notifiers for this file.
+        // Commits made by other processes or threads within the interval are
+        // batched into a single run covering all of them. The wait happens on
+        // this file's own commit notification thread and is cut short when
+        // the file is closed, but notifications for the file are delayed by
+        // up to the full interval.
+        std::chrono::milliseconds notifier_interval{0};
+        // The maximum time to spend calling collection notification callbacks
+        // each time the Realm is woken up to deliver notifications. Once
+        // exceeded, the remaining callbacks are called on the next wakeup,
+        // and the Realm is not advanced to a newer version until all of them
+        // have been called. Explicitly refreshing or beginning a write
+        // transaction always calls all of them. Zero means no limit.
+        std::chrono::milliseconds notification_delivery_budget{0};
+        // The maximum time that refresh() and begin_transaction() wait for
+        // the async notifiers to catch up to the version being advanced to.
+        // Notifiers which aren't ready in time are skipped, and their changes
+        // are delivered later, merged with any newer ones, once they've
+        // caught up to the Realm's version. Zero means wait for as long as
+        // it takes.
+        std::chrono::milliseconds notifier_wait_limit{0};
+        // Remember the row found for each primary key looked up by
+        // Object::create() and Object::get_for_primary_key() within a write
+        // transaction, so that creating or updating many objects doesn't
+        // search the primary key index for each one. The cache is discarded
+        // at the end of each write transaction.
+        bool cache_primary_key_lookups = false;
+        // Share a summary of the tables modified by each commit with the
+        // other processes which have the file open, via a `.journal` file
+        // next to it, so that their notifiers can skip commits which don't
+        // touch anything they observe without reading the transaction logs.
+        // This only helps if every process which writes to the file enables
+        // it, and is ignored if the journal file can't be created.
+        bool use_change_journal = false;
+        // Declare that no other process will open the file while this
+        // process has it open. Commit notifications are then delivered by a
+        // thread within this process rather than through the OS's
+        // interprocess signalling, which removes a system call from every
+        // commit. Commits made by other processes will not be noticed until
+        // the Realm is next refreshed for some other reason. Must be the same
+        // for every Realm open for the file within this process.
+        bool single_process = false;
 
         // The identifier of the abstract execution context in which this Realm will be used.
         // If unset, the current thread's identifier will be used to identify the execution context.
         util::Optional<AbstractExecutionContextID> execution_context;
 
+        // If set, notifications for this Realm are delivered by posting tasks
+        // to this executor rather than via the current thread's event loop,
+        // and the Realm may be used from any thread for which the executor's
+        // is_current() returns true. Realms used from a multi-threaded
+        // executor should also set `execution_context` so that the cached
+        // instance is shared between its threads.
+        std::shared_ptr<util::Executor> notification_executor;
+
+        // Object types whose changes are never reported via links from other
+        // objects, such as append-only logs which are written frequently but
+        // are only linked to. Notifiers don't request change information for
+        // these types unless they observe them directly, so parsing the
+        // transaction log can skip their instructions. Must be the same for
+        // all Realm instances for a file.
+        std::vector<std::string> untracked_object_types;
+
+        // Object types whose tables are read through after the file is first
+        // opened by this process, so that their data and search indexes are
+        // likely to already be paged in when they're first used. async_open()
+        // does this on its background thread before calling back, and other
+        // opens start a thread to do it which the open doesn't wait for.
+        std::vector<std::string> warm_up_object_types;
+
         /// A data structure storing data used to configure the Realm for sync support.
         std::shared_ptr<SyncConfig> sync_config;
 
@@ -254,6 +398,10 @@ public:
 
         // A factory function which produces an audit implementation.
         std::function<std::shared_ptr<AuditInterface>()> audit_factory;
+
+        // Which events are passed to the audit implementation. Records
+        // everything by default.
+        AuditPolicy audit_policy;
     };
 
     // Get a cached Realm or create a new one if no cached copies exists
@@ -271,6 +419,16 @@ public:
     // open while this is happening.
     static void get_shared_realm(Config config, std::function<void(SharedRealm, std::exception_ptr)> callback);
 
+    // Open a Realm without blocking the calling thread on opening the file,
+    // validating and migrating its schema, or reading the tables listed in
+    // Config::warm_up_object_types. That is done with a Realm on a background
+    // thread, after which `callback` is called on this thread, via the config's
+    // notification executor or this thread's event loop, with a Realm for this
+    // thread which picks up the already validated schema from the file's
+    // coordinator. The migration and initialization functions are called on
+    // the background thread.
+    static void async_open(Config config, std::function<void(SharedRealm, std::exception_ptr)> callback);
+
     // Updates a Realm to a given schema, using the Realm's pre-set schema mode.
     void update_schema(Schema schema, uint64_t version=0,
                        MigrationFunction migration_function=nullptr,
@@ -288,24 +446,84 @@ public:
     static uint64_t get_schema_version(Config const& config);
 
     Config const& config() const { return m_config; }
-    Schema const& schema() const { return m_schema; }
+    Schema const& schema() const { return *m_schema; }
     uint64_t schema_version() const { return m_schema_version; }
 
     // Returns `true` if this Realm is a Partially synchronized Realm.
     bool is_partial() const noexcept;
 
-    void begin_transaction();
+    // A write transaction begun with BulkLoad{true} is committed without the
+    // changes it makes being calculated for notifications. Notifiers for this
+    // file in this process instead report everything they observe as having
+    // been replaced (or, for objects, modified), which avoids the cost of
+    // computing change sets for very large writes such as imports. Calling
+    // update_schema() with changes to make within a bulk-load write throws
+    // InvalidTransactionException; changing the tables directly through the
+    // Group isn't detected and must not be done either.
+    using BulkLoad = util::TaggedBool<class BulkLoadTag>;
+    void begin_transaction(BulkLoad bulk_load=false);
     void commit_transaction();
     void cancel_transaction();
     bool is_in_transaction() const noexcept;
 
+    // Perform a write transaction on a background thread, so that the calling
+    // thread never blocks on acquiring the write lock or on the commit being
+    // made durable. `write` is called on the background thread with a Realm
+    // instance for that thread which is in a write transaction, which is
+    // committed once it returns or cancelled if it throws. `completion` is then
+    // called on this Realm's thread via its notification executor or event
+    // loop, after refreshing this Realm so that the write is visible, with the
+    // exception thrown by the write or commit if any. It is not called if this
+    // Realm has been closed or destroyed by then. Writes are performed in the
+    // order in which they were requested.
+    //
+    // If `allow_grouping` is set, the write may be committed in a single
+    // transaction with other such writes to the same file (from any Realm
+    // instance) which are waiting at the same time, so that they share one
+    // durable commit. If one of the writes in a group throws, the transaction
+    // is cancelled and the others are performed again without it, so grouped
+    // write functions must be safe to call more than once.
+    void async_write(std::function<void(Realm&)> write, std::function<void(std::exception_ptr)> completion,
+                     bool allow_grouping=false);
+
     bool is_in_read_transaction() const { return !!m_group; }
     VersionID read_transaction_version() const;
+    // The number of versions of the file which are currently kept alive by
+    // read transactions in all processes. Versions between the oldest pinned
+    // one and the latest can't have their space reused, so a number which
+    // keeps growing means that a read transaction is being held for too long.
+    uint64_t get_number_of_versions() const;
     Group& read_group();
 
     bool is_in_migration() const noexcept { return m_in_migration; }
 
     bool refresh();
+    // A summary of what changed in the file between the versions a Realm was
+    // refreshed from and to, for bindings which want to decide whether
+    // anything needs to be reloaded without observing the individual objects.
+    // Moved objects are counted as both a deletion and an insertion, and
+    // objects which were inserted are not also counted as modified.
+    struct ChangeSummary {
+        struct ObjectTypeChanges {
+            std::string object_type;
+            size_t insertions = 0;
+            size_t deletions = 0;
+            size_t modifications = 0;
+        };
+
+        // `from_version` is the default VersionID if there was no read
+        // transaction to refresh from, in which case nothing is reported
+        VersionID from_version;
+        VersionID to_version;
+        // Only the object types which actually changed are included
+        std::vector<ObjectTypeChanges> object_types;
+        bool schema_changed = false;
+    };
+    // Refresh the Realm as refresh() does, and also report what was changed
+    // by the versions advanced over. This requires calculating the changes
+    // to every table, so it's more expensive than refresh() when nothing is
+    // observing most of them.
+    bool refresh(ChangeSummary& summary);
     void set_auto_refresh(bool auto_refresh) { m_auto_refresh = auto_refresh; }
     bool auto_refresh() const { return m_auto_refresh; }
     void notify();
@@ -315,8 +533,24 @@ public:
     // WARNING / FIXME: compact() should NOT be exposed publicly on Windows
     // because it's not crash safe! It may corrupt your database if something fails
     bool compact();
+    // Compact the file if `should_compact` returns true when passed the
+    // current size of the file and the bytes used by data in it, for calling
+    // periodically from a long-lived Realm at a point where the app is idle.
+    // Compacting requires that this is the only open instance of the file,
+    // including the ones used internally for notifications, and like compact()
+    // this ends the current read transaction. The sizes come from the latest
+    // snapshot without writing to the file, so space freed by versions which
+    // haven't been cleaned up by a later commit yet isn't counted as free.
+    // Returns the number of bytes reclaimed, or none if the file wasn't
+    // compacted.
+    util::Optional<uint64_t> compact_if_needed(ShouldCompactOnLaunchFunction const& should_compact);
     void write_copy(StringData path, BinaryData encryption_key);
     OwnedBinaryData write_copy();
+    // Write an unencrypted copy of the file to `sink` in chunks of at most
+    // `buffer_size` bytes as it's produced, rather than building the whole
+    // copy in memory like write_copy() does. Exceptions thrown by `sink` abort
+    // the copy and are propagated.
+    void write_copy(WriteCopySink sink, size_t buffer_size = 64 * 1024);
 
     void verify_thread() const;
     void verify_in_write() const;
@@ -347,11 +581,38 @@ public:
     template <typename T>
     T resolve_thread_safe_reference(ThreadSafeReference<T> reference);
 
+    // Get a frozen Realm at this Realm's current read version. Frozen Realms
+    // are read-only, never advance to a newer version, don't deliver
+    // notifications, and can be used from any thread without a handover. Every
+    // frozen Realm for a version is the same instance, and the version stays
+    // pinned for as long as it or anything obtained from it is alive.
+    SharedRealm freeze();
+    bool is_frozen() const noexcept { return m_frozen; }
+
+    // Get a copy of a Results, Object, List or batch of Objects which belongs to the frozen Realm
+    // for this Realm's current read version, and so can be passed to and read
+    // on any thread without a handover. A single accessor caches state as it's
+    // read, so it mustn't be read by several threads at the same time; copy it
+    // for each thread instead, as copies of a frozen accessor can all be read
+    // concurrently.
+    //
+    // Core creates the accessors for link lists lazily and without
+    // synchronization, so rather than reading a List property of a frozen
+    // Object from several threads at once, freeze the List itself.
+    template <typename T>
+    T freeze(T const& value);
+
     ComputedPrivileges get_privileges();
     ComputedPrivileges get_privileges(StringData object_type);
     ComputedPrivileges get_privileges(RowExpr row);
 
     AuditInterface* audit_context() const noexcept;
+    // Get the audit implementation if the given event should be recorded
+    // according to the config's audit_policy, or nullptr if it should not be
+    // or there is no audit implementation. Reads and queries should pass the
+    // table they read from. Sampling is per Realm instance, so this counts as
+    // one event of the given kind whenever it is called.
+    AuditInterface* audit_context(AuditEvent event, Table const* table = nullptr);
 
     static SharedRealm make_shared_realm(Config config, std::shared_ptr<_impl::RealmCoordinator> coordinator = nullptr) {
         struct make_shared_enabler : public Realm {
@@ -365,10 +626,15 @@ public:
     // without making it public to everyone
     class Internal {
         friend class _impl::CollectionNotifier;
+        friend class _impl::KeyPathMappingCache;
+        friend class _impl::ObjectTableNotifier;
         friend class _impl::PartialSyncHelper;
+        friend class _impl::PredicateCache;
+        friend class _impl::PrimaryKeyCache;
         friend class _impl::RealmCoordinator;
         friend class ThreadSafeReferenceBase;
         friend class GlobalNotifier;
+        friend class Results;
         friend class TestHelper;
 
         // ResultsNotifier and ListNotifier need access to the SharedGroup
@@ -381,6 +647,65 @@ public:
         static _impl::RealmCoordinator& get_coordinator(Realm& realm) { return *realm.m_coordinator; }
 
         static void begin_read(Realm&, VersionID);
+        // The config's schema is only used by the Realm to avoid reading the
+        // schema from the file when it's opened, after which the coordinator
+        // takes it back to pass to update_schema()
+        static util::Optional<Schema> release_config_schema(Realm& realm)
+        {
+            util::Optional<Schema> schema;
+            std::swap(schema, realm.m_config.schema);
+            return schema;
+        }
+        // Begin the read transaction which a frozen Realm is pinned to
+        static void begin_frozen_read(Realm&, VersionID);
+        // Frozen Realms can be used from several threads at once, so the caches
+        // kept on them have to be guarded. Returns an unlocked lock for Realms
+        // which aren't frozen.
+        static std::unique_lock<std::mutex> lock_if_frozen(Realm& realm)
+        {
+            if (!realm.m_frozen)
+                return {};
+            return std::unique_lock<std::mutex>(realm.m_frozen_mutex);
+        }
+
+        // Results caches the column indices which the key paths passed to
+        // sort() and distinct() resolve to, by object type and then key path
+        using KeyPathCache = std::unordered_map<std::string, std::unordered_map<std::string, std::vector<size_t>>>;
+        static KeyPathCache& get_keypath_cache(Realm& realm) { return realm.m_keypath_cache; }
+
+        // The query parser helpers in keypath_helpers.hpp cache the mappings
+        // and descriptors they generate for the current schema
+        static std::unique_ptr<_impl::KeyPathMappingCache>& get_keypath_mapping_cache(Realm& realm)
+        {
+            return realm.m_keypath_mapping_cache;
+        }
+        static std::shared_ptr<_impl::PredicateCache>& get_predicate_cache(Realm& realm)
+        {
+            return realm.m_predicate_cache;
+        }
+
+        // Object caches the rows found by primary key lookups within a write
+        // transaction when Config::cache_primary_key_lookups is set
+        static std::unique_ptr<_impl::PrimaryKeyCache>& get_primary_key_cache(Realm& realm)
+        {
+            return realm.m_primary_key_cache;
+        }
+
+        // The most recently created notifier for Object callbacks on each
+        // table, by table index, which further objects from that table can
+        // be added to until it starts running
+        using ObjectTableNotifiers = std::unordered_map<size_t, std::weak_ptr<_impl::ObjectTableNotifier>>;
+        static ObjectTableNotifiers& get_object_table_notifiers(Realm& realm)
+        {
+            return realm.m_object_table_notifiers;
+        }
+
+        // The notifier which all of the partial sync Subscriptions created
+        // from the Realm share
+        static std::weak_ptr<_impl::SubscriptionNotifier>& get_subscription_notifier(Realm& realm)
+        {
+            return realm.m_subscription_notifier;
+        }
     };
 
     static void open_with_config(const Config& config,
@@ -404,14 +729,40 @@ private:
     Group *m_group = nullptr;
 
     uint64_t m_schema_version;
-    Schema m_schema;
-    util::Optional<Schema> m_new_schema;
+    // Owned by this Realm alone. Object, List and Results accessors hold
+    // pointers to its ObjectSchemas, so table column changes are applied to
+    // it in place rather than by replacing it.
+    std::shared_ptr<Schema> m_schema = std::make_shared<Schema>();
+    std::shared_ptr<const Schema> m_new_schema;
     uint64_t m_schema_transaction_version = -1;
+    // The hash of the config's schema if the file's schema was found to be
+    // exactly that schema by the hash persisted in the file, or zero
+    uint64_t m_validated_schema_hash = 0;
 
     // FIXME: this should be a Dynamic schema mode instead, but only once
     // that's actually fully working
     bool m_dynamic_schema = true;
 
+    // Resolved key paths and query parser mappings, which are only valid for
+    // the current schema and so are discarded by clear_schema_caches()
+    Internal::KeyPathCache m_keypath_cache;
+    std::unique_ptr<_impl::KeyPathMappingCache> m_keypath_mapping_cache;
+    // Recently parsed query strings, which don't depend on the schema. A
+    // shared_ptr so that the object store doesn't need the parser's headers.
+    std::shared_ptr<_impl::PredicateCache> m_predicate_cache;
+    // Rows found by primary key in the current write transaction
+    std::unique_ptr<_impl::PrimaryKeyCache> m_primary_key_cache;
+    // Whether each table, by its index in the group, is one of the audit
+    // policy's object types: 0 for not yet checked, 1 for yes and -1 for no.
+    // Discarded by clear_schema_caches() as the indices may have changed.
+    std::vector<int8_t> m_audit_table_in_scope;
+    // The number of events of each AuditEvent kind since the last one recorded
+    uint32_t m_audit_sample_counters[3] = {0, 0, 0};
+    // Notifiers which new Object callbacks can share
+    Internal::ObjectTableNotifiers m_object_table_notifiers;
+    // Notifier which partial sync Subscriptions share
+    std::weak_ptr<_impl::SubscriptionNotifier> m_subscription_notifier;
+
     std::shared_ptr<_impl::RealmCoordinator> m_coordinator;
     std::unique_ptr<sync::TableInfoCache> m_table_info_cache;
     std::unique_ptr<sync::PermissionsCache> m_permissions_cache;
@@ -428,9 +779,29 @@ private:
     // primary key values)
     bool m_in_migration = false;
 
+    // True if the current write transaction was begun with BulkLoad
+    bool m_bulk_load = false;
+
+    // True if this Realm was created by freeze(), in which case m_frozen_mutex
+    // guards everything which is lazily created while reading from it
+    bool m_frozen = false;
+    std::mutex m_frozen_mutex;
+
+    // The async writes whose completions haven't been delivered yet. The
+    // Realm owns them, and the background thread and the signal or executor
+    // which deliver the completion only hold weak references, so that
+    // nothing keeps a write's state alive after the Realm is destroyed.
+    struct AsyncWriteState;
+    std::vector<std::shared_ptr<AsyncWriteState>> m_async_writes;
+    static void deliver_async_write(std::weak_ptr<AsyncWriteState> const& weak_state);
+
     void begin_read(VersionID);
 
     void set_schema(Schema const& reference, Schema schema);
+    // Replace m_schema
+    void replace_schema(Schema schema);
+    // Update the table column indices of m_schema from the given schema
+    void copy_table_columns_from(Schema const& schema);
     bool reset_file(Schema& schema, std::vector<SchemaChange>& changes_required);
     bool schema_change_needs_write_transaction(Schema& schema, std::vector<SchemaChange>& changes, uint64_t version);
     Schema get_full_schema();
@@ -440,9 +811,12 @@ private:
     void read_schema_from_group_if_needed();
 
     void add_schema_change_handler();
+    bool do_refresh(_impl::TransactionChangeInfo* changes);
     void cache_new_schema();
     void translate_schema_error();
     void notify_schema_changed();
+    void clear_schema_caches();
+    void verify_can_compact() const;
 
     bool init_permission_cache();
     void invalidate_permission_cache();
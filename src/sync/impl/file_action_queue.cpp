@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "sync/impl/file_action_queue.hpp"
+
+#include <algorithm>
+
+using namespace realm;
+using namespace realm::_impl;
+
+FileActionQueue::FileActionQueue(size_t max_threads)
+: m_max_threads(std::max<size_t>(max_threads, 1))
+{
+}
+
+FileActionQueue::~FileActionQueue()
+{
+    // The threads are taken under the lock so that a concurrent enqueue()
+    // can't add one while they're being joined, and the notification is sent
+    // under it so that a worker can't miss it between checking m_stopping
+    // and starting to wait
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_work_cv.notify_all();
+        threads.swap(m_threads);
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void FileActionQueue::enqueue(std::string key, std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_outstanding[key];
+        m_queue.push_back({std::move(key), std::move(job)});
+        if (!m_stopping && m_idle_threads == 0 && m_threads.size() < m_max_threads)
+            m_threads.emplace_back([this] { run(); });
+    }
+    m_work_cv.notify_one();
+}
+
+void FileActionQueue::wait_for(std::string const& key)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [&] { return m_outstanding.count(key) == 0; });
+}
+
+void FileActionQueue::wait_for_all()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [&] { return m_outstanding.empty(); });
+}
+
+void FileActionQueue::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        // Take the oldest job whose key doesn't already have a job running,
+        // which preserves the order of jobs for each key
+        auto next = m_queue.end();
+        ++m_idle_threads;
+        m_work_cv.wait(lock, [&] {
+            next = std::find_if(m_queue.begin(), m_queue.end(), [&](auto const& job) {
+                return m_running.count(job.key) == 0;
+            });
+            return next != m_queue.end() || (m_stopping && m_queue.empty());
+        });
+        --m_idle_threads;
+        if (next == m_queue.end())
+            return;
+
+        Job job = std::move(*next);
+        m_queue.erase(next);
+        m_running.insert(job.key);
+
+        lock.unlock();
+        try {
+            job.function();
+        }
+        catch (...) {
+            // Jobs are expected to report their own errors
+        }
+        lock.lock();
+
+        m_running.erase(job.key);
+        auto it = m_outstanding.find(job.key);
+        if (--it->second == 0)
+            m_outstanding.erase(it);
+        // The next job with this key may now be runnable by another thread
+        m_work_cv.notify_all();
+        m_done_cv.notify_all();
+    }
+}
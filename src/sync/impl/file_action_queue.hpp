@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_SYNC_FILE_ACTION_QUEUE_HPP
+#define REALM_OS_SYNC_FILE_ACTION_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace realm {
+namespace _impl {
+
+// Runs file system operations on a pool of background threads. Each job has a
+// key identifying what it operates on, such as a file's path: jobs with the
+// same key are run one at a time in the order they were queued, while jobs
+// with different keys may be run in parallel. Threads are created on demand,
+// up to the given limit.
+class FileActionQueue {
+public:
+    explicit FileActionQueue(size_t max_threads);
+    // Runs all of the queued jobs before returning
+    ~FileActionQueue();
+
+    FileActionQueue(FileActionQueue const&) = delete;
+    FileActionQueue& operator=(FileActionQueue const&) = delete;
+
+    // Queue `job` to be run on a background thread. Exceptions thrown by jobs
+    // are discarded, so jobs which can fail should report errors themselves.
+    void enqueue(std::string key, std::function<void()> job);
+
+    // Block until there are no queued or running jobs with the given key, or
+    // with any key. Must not be called from within a job.
+    void wait_for(std::string const& key);
+    void wait_for_all();
+
+private:
+    struct Job {
+        std::string key;
+        std::function<void()> function;
+    };
+
+    const size_t m_max_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    std::deque<Job> m_queue;
+    // The number of queued or running jobs for each key with any
+    std::unordered_map<std::string, size_t> m_outstanding;
+    // The keys which currently have a job running
+    std::unordered_set<std::string> m_running;
+    std::vector<std::thread> m_threads;
+    size_t m_idle_threads = 0;
+    bool m_stopping = false;
+
+    void run();
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_OS_SYNC_FILE_ACTION_QUEUE_HPP
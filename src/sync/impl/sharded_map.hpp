@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_SYNC_SHARDED_MAP_HPP
+#define REALM_OS_SYNC_SHARDED_MAP_HPP
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace realm {
+namespace _impl {
+
+// An unordered_map split into a fixed number of shards which each have their
+// own lock, so that operations on keys in different shards don't contend
+// with each other. Operations which need to see every entry visit the shards
+// one at a time, and so aren't atomic with respect to concurrent changes.
+template<typename Key, typename Value, size_t ShardCount = 16, typename Hash = std::hash<Key>>
+class ShardedMap {
+public:
+    using Map = std::unordered_map<Key, Value, Hash>;
+
+    // Call `fn` with the map for the shard which holds `key`, with that shard
+    // locked for the duration of the call
+    template<typename Fn>
+    auto with_shard(Key const& key, Fn&& fn) -> decltype(fn(std::declval<Map&>()))
+    {
+        auto& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return fn(shard.map);
+    }
+
+    template<typename Fn>
+    auto with_shard(Key const& key, Fn&& fn) const -> decltype(fn(std::declval<Map const&>()))
+    {
+        auto& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return fn(static_cast<Map const&>(shard.map));
+    }
+
+    // Call `fn` with the map for each shard in turn, with only that shard
+    // locked. Iteration stops early if `fn` returns true.
+    template<typename Fn>
+    bool any_shard(Fn&& fn)
+    {
+        for (auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (fn(shard.map))
+                return true;
+        }
+        return false;
+    }
+
+    template<typename Fn>
+    bool any_shard(Fn&& fn) const
+    {
+        for (auto& shard : m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (fn(static_cast<Map const&>(shard.map)))
+                return true;
+        }
+        return false;
+    }
+
+    template<typename Fn>
+    void for_each_shard(Fn&& fn)
+    {
+        any_shard([&](Map& map) { fn(map); return false; });
+    }
+
+    template<typename Fn>
+    void for_each_shard(Fn&& fn) const
+    {
+        any_shard([&](Map const& map) { fn(map); return false; });
+    }
+
+    void clear()
+    {
+        for_each_shard([](Map& map) { map.clear(); });
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        Map map;
+    };
+    std::array<Shard, ShardCount> m_shards;
+
+    Shard& shard_for(Key const& key) { return m_shards[Hash()(key) % ShardCount]; }
+    Shard const& shard_for(Key const& key) const { return m_shards[Hash()(key) % ShardCount]; }
+};
+
+} // namespace _impl
+} // namespace realm
+
+#endif // REALM_OS_SYNC_SHARDED_MAP_HPP
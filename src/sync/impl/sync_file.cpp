@@ -18,6 +18,8 @@
 
 #include "sync/impl/sync_file.hpp"
 
+#include "impl/change_journal.hpp"
+
 #include <realm/util/file.hpp>
 #include <realm/util/time.hpp>
 #include <realm/util/scope_exit.hpp>
@@ -281,6 +283,8 @@ bool SyncFileManager::remove_realm(const std::string& absolute_path) const
     // Remove the lock file (e.g. "example.realm.lock").
     auto lock_path = util::file_path_by_appending_extension(absolute_path, "lock");
     success = File::try_remove(lock_path);
+    // Remove the change journal (e.g. "example.realm.journal"), if any.
+    File::try_remove(_impl::ChangeJournal::journal_path(absolute_path));
     // Remove the management directory (e.g. "example.realm.management").
     auto management_path = util::file_path_by_appending_extension(absolute_path, "management");
     try {
@@ -29,8 +29,16 @@
 #endif
 
 #include <realm/descriptor.hpp>
+#include <realm/group_shared.hpp>
 #include <realm/table.hpp>
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace {
 static const char * const c_sync_userMetadata = "UserMetadata";
 static const char * const c_sync_marked_for_removal = "marked_for_removal";
@@ -77,6 +85,436 @@ realm::Schema make_schema()
 } // anonymous namespace
 
 namespace realm {
+namespace _impl {
+class SyncMetadataCache;
+
+namespace {
+// All of the metadata managers for a file share a single cache, as otherwise
+// each would have its own increasingly stale view of the file's contents.
+//
+// The cache is owned here rather than by the handles given out, so that when
+// the last handle goes away the cache's pending changes can be flushed before
+// another cache for the file is loaded. Each set of handles has a generation,
+// so that a release racing with get_cache() handing out new ones is ignored.
+struct CacheEntry {
+    std::shared_ptr<SyncMetadataCache> cache;
+    std::weak_ptr<SyncMetadataCache> handle;
+    uint64_t generation = 0;
+};
+std::mutex s_cache_mutex;
+auto& s_caches = *new std::unordered_map<std::string, CacheEntry>;
+}
+
+struct SyncUserMetadataEntry {
+    std::string identity;
+    std::string local_uuid;
+    std::string auth_server_url;
+    util::Optional<std::string> user_token;
+    bool is_admin = false;
+    bool marked_for_removal = false;
+    bool removed = false;
+};
+
+struct SyncFileActionMetadataEntry {
+    std::string original_name;
+    util::Optional<std::string> new_name;
+    SyncFileActionMetadata::Action action;
+    std::string url;
+    std::string local_uuid;
+    bool removed = false;
+};
+
+// The in-memory copy of the metadata Realm's users and file actions, along
+// with the set of entries which have been modified since they were last
+// written back to the Realm.
+class SyncMetadataCache {
+public:
+    using UserKey = std::pair<std::string, std::string>;
+
+    SyncMetadataCache(Realm::Config config, SyncUserMetadata::Schema user_schema,
+                      SyncFileActionMetadata::Schema file_action_schema);
+    ~SyncMetadataCache();
+
+    // Guards all of the cached entries and everything below
+    std::mutex mutex;
+    // Incremented whenever an entry is added or removed or a user is
+    // (un)marked for removal, so that results know when to recompute
+    uint64_t version = 0;
+    std::map<UserKey, std::shared_ptr<SyncUserMetadataEntry>> users;
+    std::map<std::string, std::shared_ptr<SyncFileActionMetadataEntry>> file_actions;
+
+    // Record that the given entry needs to be written to the Realm, and then
+    // either write it or schedule a flush depending on the flush interval.
+    // Releases `lock`, which must hold `mutex`.
+    void did_change(std::unique_lock<std::mutex>& lock, std::shared_ptr<SyncUserMetadataEntry> const& entry);
+    void did_change(std::unique_lock<std::mutex>& lock, std::shared_ptr<SyncFileActionMetadataEntry> const& entry);
+
+    void set_flush_interval(std::chrono::milliseconds interval);
+    void flush();
+
+    // Look up the cache for the metadata Realm at the given path, creating
+    // and loading it from the file if there isn't an existing one.
+    static std::shared_ptr<SyncMetadataCache> get_cache(Realm::Config config,
+                                                        SyncUserMetadata::Schema user_schema,
+                                                        SyncFileActionMetadata::Schema file_action_schema);
+
+private:
+    const Realm::Config m_config;
+    const SyncUserMetadata::Schema m_user_schema;
+    const SyncFileActionMetadata::Schema m_file_action_schema;
+
+    // Guards the SharedGroup and serializes flushes, so that batches are
+    // written in the order they were collected in. Acquired before `mutex`.
+    std::mutex m_flush_mutex;
+    std::unique_ptr<Replication> m_history;
+    std::unique_ptr<SharedGroup> m_shared_group;
+    std::unique_ptr<Group> m_read_only_group;
+
+    // All guarded by `mutex`
+    std::unordered_set<std::shared_ptr<SyncUserMetadataEntry>> m_dirty_users;
+    std::unordered_set<std::shared_ptr<SyncFileActionMetadataEntry>> m_dirty_file_actions;
+    std::chrono::steady_clock::time_point m_first_dirty;
+    std::chrono::milliseconds m_flush_interval{0};
+    bool m_stopping = false;
+    std::condition_variable m_flush_cv;
+    std::thread m_flush_thread;
+
+    // Called when the last handle from the given generation is released
+    static void release(std::string const& path, uint64_t generation);
+
+    bool has_pending_changes() const { return !m_dirty_users.empty() || !m_dirty_file_actions.empty(); }
+    void schedule_flush(std::unique_lock<std::mutex>& lock);
+    void flush_loop();
+    void stop_flush_thread(std::unique_lock<std::mutex>& lock);
+    // Stop the background flusher and write any pending changes
+    void close();
+
+    void write_users(Group& group, std::vector<SyncUserMetadataEntry> const& dirty);
+    void write_file_actions(Group& group, std::vector<SyncFileActionMetadataEntry> const& dirty);
+};
+
+SyncMetadataCache::SyncMetadataCache(Realm::Config config, SyncUserMetadata::Schema user_schema,
+                                     SyncFileActionMetadata::Schema file_action_schema)
+: m_config(std::move(config))
+, m_user_schema(user_schema)
+, m_file_action_schema(file_action_schema)
+{
+    // This can't use get_shared_realm() because flushes may be performed on
+    // background threads and that's currently not supported by the libuv
+    // implementation of EventLoopSignal
+    Realm::open_with_config(m_config, m_history, m_shared_group, m_read_only_group, nullptr);
+
+    // Read from a new transaction rather than the caller's, which may
+    // predate the previous cache for this file flushing its last changes
+    ReadTransaction rt(*m_shared_group);
+    auto& group = rt.get_group();
+    ConstTableRef table = ObjectStore::table_for_object_type(group, c_sync_userMetadata);
+    for (size_t i = 0, size = table->size(); i < size; ++i) {
+        auto entry = std::make_shared<SyncUserMetadataEntry>();
+        entry->identity = std::string(table->get_string(m_user_schema.idx_identity, i));
+        entry->local_uuid = std::string(table->get_string(m_user_schema.idx_local_uuid, i));
+        entry->auth_server_url = std::string(table->get_string(m_user_schema.idx_auth_server_url, i));
+        StringData token = table->get_string(m_user_schema.idx_user_token, i);
+        if (!token.is_null())
+            entry->user_token = std::string(token);
+        entry->is_admin = table->get_bool(m_user_schema.idx_user_is_admin, i);
+        entry->marked_for_removal = table->get_bool(m_user_schema.idx_marked_for_removal, i);
+        UserKey key{entry->identity, entry->auth_server_url};
+        users.emplace(std::move(key), std::move(entry));
+    }
+
+    table = ObjectStore::table_for_object_type(group, c_sync_fileActionMetadata);
+    for (size_t i = 0, size = table->size(); i < size; ++i) {
+        auto entry = std::make_shared<SyncFileActionMetadataEntry>();
+        entry->original_name = std::string(table->get_string(m_file_action_schema.idx_original_name, i));
+        StringData new_name = table->get_string(m_file_action_schema.idx_new_name, i);
+        if (!new_name.is_null())
+            entry->new_name = std::string(new_name);
+        entry->action = static_cast<SyncFileActionMetadata::Action>(table->get_int(m_file_action_schema.idx_action, i));
+        entry->url = std::string(table->get_string(m_file_action_schema.idx_url, i));
+        entry->local_uuid = std::string(table->get_string(m_file_action_schema.idx_user_identity, i));
+        std::string key = entry->original_name;
+        file_actions.emplace(std::move(key), std::move(entry));
+    }
+}
+
+SyncMetadataCache::~SyncMetadataCache()
+{
+    try {
+        close();
+    }
+    catch (...) {
+        // Nothing can be done about a failed write at this point
+    }
+}
+
+std::shared_ptr<SyncMetadataCache> SyncMetadataCache::get_cache(Realm::Config config,
+                                                                SyncUserMetadata::Schema user_schema,
+                                                                SyncFileActionMetadata::Schema file_action_schema)
+{
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    auto path = config.path;
+    auto& entry = s_caches[path];
+    if (auto handle = entry.handle.lock())
+        return handle;
+
+    // If the previous handles have all gone but haven't been released yet,
+    // the cache is still open and up to date and can just be reused
+    if (!entry.cache)
+        entry.cache = std::make_shared<SyncMetadataCache>(std::move(config), user_schema, file_action_schema);
+    auto generation = ++entry.generation;
+    std::shared_ptr<SyncMetadataCache> handle(entry.cache.get(), [path, generation](SyncMetadataCache*) {
+        release(path, generation);
+    });
+    entry.handle = handle;
+    return handle;
+}
+
+void SyncMetadataCache::release(std::string const& path, uint64_t generation)
+{
+    std::shared_ptr<SyncMetadataCache> cache;
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    auto it = s_caches.find(path);
+    if (it == s_caches.end() || it->second.generation != generation)
+        return;
+
+    // Write the pending changes while still holding the lock, so that a new
+    // cache for the file can't be loaded until they're on disk
+    cache = std::move(it->second.cache);
+    s_caches.erase(it);
+    try {
+        cache->close();
+    }
+    catch (...) {
+        // Nothing can be done about a failed write at this point
+    }
+}
+
+void SyncMetadataCache::did_change(std::unique_lock<std::mutex>& lock,
+                                   std::shared_ptr<SyncUserMetadataEntry> const& entry)
+{
+    if (!has_pending_changes())
+        m_first_dirty = std::chrono::steady_clock::now();
+    m_dirty_users.insert(entry);
+    schedule_flush(lock);
+}
+
+void SyncMetadataCache::did_change(std::unique_lock<std::mutex>& lock,
+                                   std::shared_ptr<SyncFileActionMetadataEntry> const& entry)
+{
+    if (!has_pending_changes())
+        m_first_dirty = std::chrono::steady_clock::now();
+    m_dirty_file_actions.insert(entry);
+    schedule_flush(lock);
+}
+
+void SyncMetadataCache::schedule_flush(std::unique_lock<std::mutex>& lock)
+{
+    if (m_flush_interval.count() == 0) {
+        lock.unlock();
+        flush();
+        return;
+    }
+    if (!m_flush_thread.joinable())
+        m_flush_thread = std::thread([this] { flush_loop(); });
+    m_flush_cv.notify_one();
+    lock.unlock();
+}
+
+void SyncMetadataCache::flush_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!m_stopping) {
+        m_flush_cv.wait(lock, [&] { return m_stopping || has_pending_changes(); });
+        if (m_stopping)
+            break;
+        // Wait until the oldest pending change has been held for the full
+        // interval. Shortening the interval wakes us up to recheck.
+        m_flush_cv.wait_until(lock, m_first_dirty + m_flush_interval, [&] {
+            return m_stopping || std::chrono::steady_clock::now() >= m_first_dirty + m_flush_interval;
+        });
+        if (m_stopping)
+            break;
+        lock.unlock();
+        try {
+            flush();
+        }
+        catch (...) {
+            // The changes are still pending, so the write will be retried
+            // by the next flush.
+        }
+        lock.lock();
+    }
+}
+
+void SyncMetadataCache::stop_flush_thread(std::unique_lock<std::mutex>& lock)
+{
+    if (!m_flush_thread.joinable())
+        return;
+    m_stopping = true;
+    m_flush_cv.notify_one();
+    auto thread = std::move(m_flush_thread);
+    lock.unlock();
+    thread.join();
+    lock.lock();
+    m_stopping = false;
+}
+
+void SyncMetadataCache::set_flush_interval(std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool shorter = interval < m_flush_interval;
+    m_flush_interval = interval;
+    if (interval.count() == 0)
+        stop_flush_thread(lock);
+    else if (shorter)
+        m_flush_cv.notify_one();
+
+    bool pending = has_pending_changes();
+    lock.unlock();
+    // Changes made with the old interval need to be written now if there's
+    // no longer a thread which will do so
+    if (interval.count() == 0 && pending)
+        flush();
+}
+
+void SyncMetadataCache::close()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        m_flush_interval = std::chrono::milliseconds(0);
+        stop_flush_thread(lock);
+    }
+    flush();
+}
+
+void SyncMetadataCache::flush()
+{
+    std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+
+    // Copy the pending entries so that the write transaction doesn't need to
+    // block readers. Any entries modified after this will be marked as dirty
+    // again and written by the next flush.
+    decltype(m_dirty_users) pending_users;
+    decltype(m_dirty_file_actions) pending_actions;
+    std::vector<SyncUserMetadataEntry> dirty_users;
+    std::vector<SyncFileActionMetadataEntry> dirty_file_actions;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!has_pending_changes())
+            return;
+        std::swap(pending_users, m_dirty_users);
+        std::swap(pending_actions, m_dirty_file_actions);
+        dirty_users.reserve(pending_users.size());
+        for (auto& entry : pending_users)
+            dirty_users.push_back(*entry);
+        dirty_file_actions.reserve(pending_actions.size());
+        for (auto& entry : pending_actions)
+            dirty_file_actions.push_back(*entry);
+    }
+
+    try {
+        WriteTransaction wt(*m_shared_group);
+        if (!dirty_users.empty())
+            write_users(wt.get_group(), dirty_users);
+        if (!dirty_file_actions.empty())
+            write_file_actions(wt.get_group(), dirty_file_actions);
+        wt.commit();
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!has_pending_changes())
+            m_first_dirty = std::chrono::steady_clock::now();
+        m_dirty_users.insert(pending_users.begin(), pending_users.end());
+        m_dirty_file_actions.insert(pending_actions.begin(), pending_actions.end());
+        throw;
+    }
+}
+
+void SyncMetadataCache::write_users(Group& group, std::vector<SyncUserMetadataEntry> const& dirty)
+{
+    auto& schema = m_user_schema;
+    TableRef table = ObjectStore::table_for_object_type(group, c_sync_userMetadata);
+
+    // The user table has no index on identity, so build a lookup table once
+    // per batch rather than running a query for each user.
+    auto key_for_row = [&](size_t row) {
+        return UserKey{std::string(table->get_string(schema.idx_identity, row)),
+                       std::string(table->get_string(schema.idx_auth_server_url, row))};
+    };
+    std::map<UserKey, size_t> rows;
+    for (size_t i = 0, size = table->size(); i < size; ++i)
+        rows.emplace(key_for_row(i), i);
+
+    // Removals have to be applied first, as a user which is removed and then
+    // recreated within a single batch has two entries with the same key.
+    for (auto& user : dirty) {
+        if (!user.removed)
+            continue;
+        auto it = rows.find({user.identity, user.auth_server_url});
+        if (it == rows.end())
+            continue;
+        size_t row = it->second;
+        size_t last = table->size() - 1;
+        rows.erase(it);
+        if (row != last)
+            rows[key_for_row(last)] = row;
+        table->move_last_over(row);
+    }
+
+    for (auto& user : dirty) {
+        if (user.removed)
+            continue;
+        UserKey key{user.identity, user.auth_server_url};
+        size_t row;
+        auto it = rows.find(key);
+        if (it != rows.end()) {
+            row = it->second;
+        }
+        else {
+            row = table->add_empty_row();
+            table->set_string(schema.idx_identity, row, user.identity);
+            table->set_string(schema.idx_auth_server_url, row, user.auth_server_url);
+            rows.emplace(std::move(key), row);
+        }
+        table->set_string(schema.idx_local_uuid, row, user.local_uuid);
+        table->set_string(schema.idx_user_token, row,
+                          user.user_token ? StringData(*user.user_token) : StringData());
+        table->set_bool(schema.idx_user_is_admin, row, user.is_admin);
+        table->set_bool(schema.idx_marked_for_removal, row, user.marked_for_removal);
+    }
+}
+
+void SyncMetadataCache::write_file_actions(Group& group, std::vector<SyncFileActionMetadataEntry> const& dirty)
+{
+    auto& schema = m_file_action_schema;
+    TableRef table = ObjectStore::table_for_object_type(group, c_sync_fileActionMetadata);
+
+    for (auto& action : dirty) {
+        if (!action.removed)
+            continue;
+        size_t row = table->find_first_string(schema.idx_original_name, action.original_name);
+        if (row != not_found)
+            table->move_last_over(row);
+    }
+
+    for (auto& action : dirty) {
+        if (action.removed)
+            continue;
+        size_t row = table->find_first_string(schema.idx_original_name, action.original_name);
+        if (row == not_found) {
+            row = table->add_empty_row();
+            table->set_string(schema.idx_original_name, row, action.original_name);
+        }
+        table->set_string(schema.idx_new_name, row,
+                          action.new_name ? StringData(*action.new_name) : StringData());
+        table->set_int(schema.idx_action, row, static_cast<int64_t>(action.action));
+        table->set_string(schema.idx_url, row, action.url);
+        table->set_string(schema.idx_user_identity, row, action.local_uuid);
+    }
+}
+
+} // namespace _impl
 
 // MARK: - Sync metadata manager
 
@@ -131,10 +569,13 @@ SyncMetadataManager::SyncMetadataManager(std::string path,
     };
 
     SharedRealm realm = Realm::get_shared_realm(config);
+    // The Realm may be a cached instance from a previous manager, so make
+    // sure the cache is loaded from the latest version
+    realm->refresh();
 
     // Get data about the (hardcoded) schemas
     auto object_schema = realm->schema().find(c_sync_userMetadata);
-    m_user_schema = {
+    SyncUserMetadata::Schema user_schema = {
         object_schema->persisted_properties[0].table_column,
         object_schema->persisted_properties[1].table_column,
         object_schema->persisted_properties[2].table_column,
@@ -144,7 +585,7 @@ SyncMetadataManager::SyncMetadataManager(std::string path,
     };
 
     object_schema = realm->schema().find(c_sync_fileActionMetadata);
-    m_file_action_schema = {
+    SyncFileActionMetadata::Schema file_action_schema = {
         object_schema->persisted_properties[0].table_column,
         object_schema->persisted_properties[1].table_column,
         object_schema->persisted_properties[2].table_column,
@@ -153,12 +594,10 @@ SyncMetadataManager::SyncMetadataManager(std::string path,
     };
 
     object_schema = realm->schema().find(c_sync_clientMetadata);
-    m_client_schema = {
+    SyncClientMetadata::Schema client_schema = {
         object_schema->persisted_properties[0].table_column,
     };
 
-    m_metadata_config = std::move(config);
-
     m_client_uuid = [&]() -> std::string {
         TableRef table = ObjectStore::table_for_object_type(realm->read_group(), c_sync_clientMetadata);
         if (table->is_empty()) {
@@ -167,14 +606,37 @@ SyncMetadataManager::SyncMetadataManager(std::string path,
                 size_t idx = table->add_empty_row();
                 REALM_ASSERT_DEBUG(idx == 0);
                 auto uuid = uuid_string();
-                table->set_string(m_client_schema.idx_uuid, idx, uuid);
+                table->set_string(client_schema.idx_uuid, idx, uuid);
                 realm->commit_transaction();
                 return uuid;
             }
             realm->cancel_transaction();
         }
-        return table->get_string(m_client_schema.idx_uuid, 0);
+        return table->get_string(client_schema.idx_uuid, 0);
     }();
+
+    m_cache = _impl::SyncMetadataCache::get_cache(std::move(config), user_schema, file_action_schema);
+}
+
+SyncMetadataManager::~SyncMetadataManager()
+{
+    try {
+        m_cache->flush();
+    }
+    catch (...) {
+        // The changes are still pending, and the cache will retry writing
+        // them when it is destroyed if there's no other flush before then
+    }
+}
+
+void SyncMetadataManager::set_flush_interval(std::chrono::milliseconds interval) const
+{
+    m_cache->set_flush_interval(interval);
+}
+
+void SyncMetadataManager::flush() const
+{
+    m_cache->flush();
 }
 
 SyncUserMetadataResults SyncMetadataManager::all_unmarked_users() const
@@ -189,84 +651,64 @@ SyncUserMetadataResults SyncMetadataManager::all_users_marked_for_removal() cons
 
 SyncUserMetadataResults SyncMetadataManager::get_users(bool marked) const
 {
-    auto realm = get_realm();
-    TableRef table = ObjectStore::table_for_object_type(realm->read_group(), c_sync_userMetadata);
-    Query query = table->where().equal(m_user_schema.idx_marked_for_removal, marked);
-
-    Results results(realm, std::move(query));
-    return SyncUserMetadataResults(std::move(results), std::move(realm), m_user_schema);
+    auto cache = m_cache;
+    return SyncUserMetadataResults([=](uint64_t& version, std::vector<SyncUserMetadata>& items) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if (version == cache->version)
+            return;
+        items.clear();
+        for (auto& user : cache->users) {
+            if (user.second->marked_for_removal == marked)
+                items.emplace_back(cache, user.second);
+        }
+        version = cache->version;
+    });
 }
 
 SyncFileActionMetadataResults SyncMetadataManager::all_pending_actions() const
 {
-    auto realm = get_realm();
-    TableRef table = ObjectStore::table_for_object_type(realm->read_group(), c_sync_fileActionMetadata);
-    Results results(realm, table->where());
-    return SyncFileActionMetadataResults(std::move(results), std::move(realm), m_file_action_schema);
+    auto cache = m_cache;
+    return SyncFileActionMetadataResults([=](uint64_t& version, std::vector<SyncFileActionMetadata>& items) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if (version == cache->version)
+            return;
+        items.clear();
+        for (auto& action : cache->file_actions)
+            items.emplace_back(cache, action.second);
+        version = cache->version;
+    });
 }
 
 util::Optional<SyncUserMetadata> SyncMetadataManager::get_or_make_user_metadata(const std::string& identity,
                                                                                 const std::string& url,
                                                                                 bool make_if_absent) const
 {
-    auto realm = get_realm();
-    auto& schema = m_user_schema;
-
-    // Retrieve or create the row for this object.
-    TableRef table = ObjectStore::table_for_object_type(realm->read_group(), c_sync_userMetadata);
-    Query query = table->where().equal(schema.idx_identity, identity).equal(schema.idx_auth_server_url, url);
-    Results results(realm, std::move(query));
-    REALM_ASSERT_DEBUG(results.size() < 2);
-    auto row = results.first();
-
-    if (!row) {
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    auto it = m_cache->users.find({identity, url});
+    if (it == m_cache->users.end()) {
         if (!make_if_absent)
             return none;
 
-        realm->begin_transaction();
-        // Check the results again.
-        row = results.first();
-        if (!row) {
-            auto row = table->get(table->add_empty_row());
-            std::string uuid = util::uuid_string();
-            row.set_string(schema.idx_identity, identity);
-            row.set_string(schema.idx_auth_server_url, url);
-            row.set_string(schema.idx_local_uuid, uuid);
-            row.set_bool(schema.idx_user_is_admin, false);
-            row.set_bool(schema.idx_marked_for_removal, false);
-            realm->commit_transaction();
-            return SyncUserMetadata(schema, std::move(realm), std::move(row));
-        } else {
-            // Someone beat us to adding this user.
-            if (row->get_bool(schema.idx_marked_for_removal)) {
-                // User is dead. Revive or return none.
-                if (make_if_absent) {
-                    row->set_bool(schema.idx_marked_for_removal, false);
-                    realm->commit_transaction();
-                } else {
-                    realm->cancel_transaction();
-                    return none;
-                }
-            } else {
-                // User is alive, nothing else to do.
-                realm->cancel_transaction();
-            }
-            return SyncUserMetadata(schema, std::move(realm), std::move(*row));
-        }
+        auto entry = std::make_shared<_impl::SyncUserMetadataEntry>();
+        entry->identity = identity;
+        entry->auth_server_url = url;
+        entry->local_uuid = util::uuid_string();
+        m_cache->users.emplace(std::make_pair(identity, url), entry);
+        ++m_cache->version;
+        m_cache->did_change(lock, entry);
+        return SyncUserMetadata(m_cache, std::move(entry));
     }
 
-    // Got an existing user.
-    if (row->get_bool(schema.idx_marked_for_removal)) {
+    auto entry = it->second;
+    if (entry->marked_for_removal) {
         // User is dead. Revive or return none.
-        if (make_if_absent) {
-            realm->begin_transaction();
-            row->set_bool(schema.idx_marked_for_removal, false);
-            realm->commit_transaction();
-        } else {
+        if (!make_if_absent)
             return none;
-        }
+        entry->marked_for_removal = false;
+        ++m_cache->version;
+        m_cache->did_change(lock, entry);
     }
-    return SyncUserMetadata(schema, std::move(realm), std::move(*row));
+    return SyncUserMetadata(m_cache, std::move(entry));
 }
 
 void SyncMetadataManager::make_file_action_metadata(StringData original_name,
@@ -275,192 +717,159 @@ void SyncMetadataManager::make_file_action_metadata(StringData original_name,
                                                     SyncFileActionMetadata::Action action,
                                                     StringData new_name) const
 {
-    // This function can't use get_shared_realm() because it's called on a
-    // background thread and that's currently not supported by the libuv
-    // implementation of EventLoopSignal
-    std::unique_ptr<Replication> history;
-    std::unique_ptr<SharedGroup> shared_group;
-    std::unique_ptr<Group> read_only_group;
-    Realm::open_with_config(m_metadata_config, history, shared_group, read_only_group, nullptr);
-
-    // Retrieve or create the row for this object.
-    WriteTransaction wt(*shared_group);
-    TableRef table = ObjectStore::table_for_object_type(wt.get_group(), c_sync_fileActionMetadata);
-
-    auto& schema = m_file_action_schema;
-    size_t row_idx = table->find_first_string(schema.idx_original_name, original_name);
-    if (row_idx == not_found) {
-        row_idx = table->add_empty_row();
-        table->set_string(schema.idx_original_name, row_idx, original_name);
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    auto& entry = m_cache->file_actions[std::string(original_name)];
+    if (!entry) {
+        entry = std::make_shared<_impl::SyncFileActionMetadataEntry>();
+        entry->original_name = std::string(original_name);
+        ++m_cache->version;
     }
-    table->set_string(schema.idx_new_name, row_idx, new_name);
-    table->set_int(schema.idx_action, row_idx, static_cast<int64_t>(action));
-    table->set_string(schema.idx_url, row_idx, url);
-    table->set_string(schema.idx_user_identity, row_idx, local_uuid);
-    wt.commit();
+    entry->new_name = new_name.is_null() ? util::none : util::make_optional(std::string(new_name));
+    entry->action = action;
+    entry->url = std::string(url);
+    entry->local_uuid = std::string(local_uuid);
+    m_cache->did_change(lock, entry);
 }
 
 util::Optional<SyncFileActionMetadata> SyncMetadataManager::get_file_action_metadata(StringData original_name) const
 {
-    auto realm = get_realm();
-    auto& schema = m_file_action_schema;
-    TableRef table = ObjectStore::table_for_object_type(realm->read_group(), c_sync_fileActionMetadata);
-    size_t row_idx = table->find_first_string(schema.idx_original_name, original_name);
-    if (row_idx == not_found)
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    auto it = m_cache->file_actions.find(std::string(original_name));
+    if (it == m_cache->file_actions.end())
         return none;
-
-    return SyncFileActionMetadata(std::move(schema), std::move(realm), table->get(row_idx));
-}
-
-std::shared_ptr<Realm> SyncMetadataManager::get_realm() const
-{
-    auto realm = Realm::get_shared_realm(m_metadata_config);
-    realm->refresh();
-    return realm;
+    return SyncFileActionMetadata(m_cache, it->second);
 }
 
 // MARK: - Sync user metadata
 
-SyncUserMetadata::SyncUserMetadata(Schema schema, SharedRealm realm, RowExpr row)
-: m_realm(std::move(realm))
-, m_schema(std::move(schema))
-, m_row(row)
+SyncUserMetadata::SyncUserMetadata(std::shared_ptr<_impl::SyncMetadataCache> cache,
+                                   std::shared_ptr<_impl::SyncUserMetadataEntry> entry)
+: m_cache(std::move(cache))
+, m_entry(std::move(entry))
 { }
 
 std::string SyncUserMetadata::identity() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_identity);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->identity;
 }
 
 std::string SyncUserMetadata::local_uuid() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_local_uuid);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->local_uuid;
 }
 
 util::Optional<std::string> SyncUserMetadata::user_token() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    StringData result = m_row.get_string(m_schema.idx_user_token);
-    return result.is_null() ? util::none : util::make_optional(std::string(result));
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->user_token;
 }
 
 std::string SyncUserMetadata::auth_server_url() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_auth_server_url);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->auth_server_url;
 }
 
 bool SyncUserMetadata::is_admin() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_bool(m_schema.idx_user_is_admin);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->is_admin;
+}
+
+bool SyncUserMetadata::is_valid() const
+{
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return !m_entry->removed;
 }
 
 void SyncUserMetadata::set_user_token(util::Optional<std::string> user_token)
 {
-    if (m_invalid)
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    if (m_entry->removed || m_entry->user_token == user_token)
         return;
-
-    REALM_ASSERT_DEBUG(m_realm);
-    m_realm->verify_thread();
-    m_realm->begin_transaction();
-    m_row.set_string(m_schema.idx_user_token, *user_token);
-    m_realm->commit_transaction();
+    m_entry->user_token = std::move(user_token);
+    m_cache->did_change(lock, m_entry);
 }
 
 void SyncUserMetadata::set_is_admin(bool is_admin)
 {
-    if (m_invalid)
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    if (m_entry->removed || m_entry->is_admin == is_admin)
         return;
-
-    REALM_ASSERT_DEBUG(m_realm);
-    m_realm->verify_thread();
-    m_realm->begin_transaction();
-    m_row.set_bool(m_schema.idx_user_is_admin, is_admin);
-    m_realm->commit_transaction();
+    m_entry->is_admin = is_admin;
+    m_cache->did_change(lock, m_entry);
 }
 
 void SyncUserMetadata::mark_for_removal()
 {
-    if (m_invalid)
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    if (m_entry->removed || m_entry->marked_for_removal)
         return;
-
-    m_realm->verify_thread();
-    m_realm->begin_transaction();
-    m_row.set_bool(m_schema.idx_marked_for_removal, true);
-    m_realm->commit_transaction();
+    m_entry->marked_for_removal = true;
+    ++m_cache->version;
+    m_cache->did_change(lock, m_entry);
 }
 
 void SyncUserMetadata::remove()
 {
-    m_invalid = true;
-    m_realm->begin_transaction();
-    TableRef table = ObjectStore::table_for_object_type(m_realm->read_group(), c_sync_userMetadata);
-    table->move_last_over(m_row.get_index());
-    m_realm->commit_transaction();
-    m_realm = nullptr;
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    if (m_entry->removed)
+        return;
+    m_entry->removed = true;
+    m_cache->users.erase({m_entry->identity, m_entry->auth_server_url});
+    ++m_cache->version;
+    m_cache->did_change(lock, m_entry);
 }
 
 // MARK: - File action metadata
 
-SyncFileActionMetadata::SyncFileActionMetadata(Schema schema, SharedRealm realm, RowExpr row)
-: m_realm(std::move(realm))
-, m_schema(std::move(schema))
-, m_row(row)
+SyncFileActionMetadata::SyncFileActionMetadata(std::shared_ptr<_impl::SyncMetadataCache> cache,
+                                               std::shared_ptr<_impl::SyncFileActionMetadataEntry> entry)
+: m_cache(std::move(cache))
+, m_entry(std::move(entry))
 { }
 
 std::string SyncFileActionMetadata::original_name() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_original_name);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->original_name;
 }
 
 util::Optional<std::string> SyncFileActionMetadata::new_name() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    StringData result = m_row.get_string(m_schema.idx_new_name);
-    return result.is_null() ? util::none : util::make_optional(std::string(result));
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->new_name;
 }
 
 std::string SyncFileActionMetadata::user_local_uuid() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_user_identity);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->local_uuid;
 }
 
 SyncFileActionMetadata::Action SyncFileActionMetadata::action() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return static_cast<SyncFileActionMetadata::Action>(m_row.get_int(m_schema.idx_action));
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->action;
 }
 
 std::string SyncFileActionMetadata::url() const
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    return m_row.get_string(m_schema.idx_url);
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    return m_entry->url;
 }
 
 void SyncFileActionMetadata::remove()
 {
-    REALM_ASSERT(m_realm);
-    m_realm->verify_thread();
-    m_realm->begin_transaction();
-    TableRef table = ObjectStore::table_for_object_type(m_realm->read_group(), c_sync_fileActionMetadata);
-    table->move_last_over(m_row.get_index());
-    m_realm->commit_transaction();
-    m_realm = nullptr;
+    std::unique_lock<std::mutex> lock(m_cache->mutex);
+    if (m_entry->removed)
+        return;
+    m_entry->removed = true;
+    m_cache->file_actions.erase(m_entry->original_name);
+    ++m_cache->version;
+    m_cache->did_change(lock, m_entry);
 }
 
 } // namespace realm
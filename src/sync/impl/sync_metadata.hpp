@@ -19,7 +19,11 @@
 #ifndef REALM_OS_SYNC_METADATA_HPP
 #define REALM_OS_SYNC_METADATA_HPP
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <realm/row.hpp>
 #include <realm/table.hpp>
@@ -29,10 +33,14 @@
 #include "shared_realm.hpp"
 
 namespace realm {
-template<typename T> class BasicRowExpr;
-using RowExpr = BasicRowExpr<Table>;
 class SyncMetadataManager;
 
+namespace _impl {
+class SyncMetadataCache;
+struct SyncUserMetadataEntry;
+struct SyncFileActionMetadataEntry;
+}
+
 // A facade for a metadata Realm object representing a sync user.
 class SyncUserMetadata {
 public:
@@ -72,18 +80,14 @@ public:
 
     void remove();
 
-    bool is_valid() const
-    {
-        return !m_invalid;
-    }
+    bool is_valid() const;
 
     // INTERNAL USE ONLY
-    SyncUserMetadata(Schema schema, SharedRealm realm, RowExpr row);
+    SyncUserMetadata(std::shared_ptr<_impl::SyncMetadataCache> cache,
+                     std::shared_ptr<_impl::SyncUserMetadataEntry> entry);
 private:
-    bool m_invalid = false;
-    SharedRealm m_realm;
-    Schema m_schema;
-    Row m_row;
+    std::shared_ptr<_impl::SyncMetadataCache> m_cache;
+    std::shared_ptr<_impl::SyncUserMetadataEntry> m_entry;
 };
 
 // A facade for a metadata Realm object representing a pending action to be carried out upon a specific file(s).
@@ -126,11 +130,11 @@ public:
     void remove();
 
     // INTERNAL USE ONLY
-    SyncFileActionMetadata(Schema schema, SharedRealm realm, RowExpr row);
+    SyncFileActionMetadata(std::shared_ptr<_impl::SyncMetadataCache> cache,
+                           std::shared_ptr<_impl::SyncFileActionMetadataEntry> entry);
 private:
-    SharedRealm m_realm;
-    Schema m_schema;
-    Row m_row;
+    std::shared_ptr<_impl::SyncMetadataCache> m_cache;
+    std::shared_ptr<_impl::SyncFileActionMetadataEntry> m_entry;
 };
 
 class SyncClientMetadata {
@@ -141,38 +145,51 @@ public:
     };
 };
 
+// A live view of the cached metadata objects matching some predicate. The
+// set of objects is recomputed lazily whenever the cache has changed since
+// it was last read.
 template<class T>
 class SyncMetadataResults {
 public:
     size_t size() const
     {
-        return m_results.size();
+        m_update(m_version, m_items);
+        return m_items.size();
     }
 
     T get(size_t idx) const
     {
-        RowExpr row = m_results.get(idx);
-        return T(m_schema, m_realm, row);
+        m_update(m_version, m_items);
+        return m_items.at(idx);
     }
 
-    SyncMetadataResults(Results results, SharedRealm realm, typename T::Schema schema)
-    : m_schema(std::move(schema))
-    , m_realm(std::move(realm))
-    , m_results(std::move(results))
+    // INTERNAL USE ONLY
+    // `update` is called with the version of the cache the current contents
+    // were computed from and should refresh both if the cache has changed.
+    using UpdateFunction = std::function<void(uint64_t& version, std::vector<T>& items)>;
+    SyncMetadataResults(UpdateFunction update)
+    : m_update(std::move(update))
     { }
 private:
-    typename T::Schema m_schema;
-    SharedRealm m_realm;
-    // FIXME: remove 'mutable' once `realm::Results` is properly annotated for const
-    mutable Results m_results;
+    UpdateFunction m_update;
+    mutable uint64_t m_version = uint64_t(-1);
+    mutable std::vector<T> m_items;
 };
 using SyncUserMetadataResults = SyncMetadataResults<SyncUserMetadata>;
 using SyncFileActionMetadataResults = SyncMetadataResults<SyncFileActionMetadata>;
 
 // A facade for the application's metadata Realm.
+//
+// The contents of the metadata Realm are loaded into memory when the manager
+// is constructed, and all reads are served from that cache. Changes are
+// applied to the cache immediately and written back to the Realm in batches:
+// by default every change is persisted before the call making it returns,
+// but with a non-zero flush interval changes are instead accumulated and
+// written in a single transaction on a background thread. All managers for
+// the same file within a process share a single cache, which is
+// authoritative: the metadata Realm must not be modified other than through
+// a metadata manager while one is open.
 class SyncMetadataManager {
-friend class SyncUserMetadata;
-friend class SyncFileActionMetadata;
 public:
     // Return a Results object containing all users not marked for removal.
     SyncUserMetadataResults all_unmarked_users() const;
@@ -202,6 +219,15 @@ public:
     // Get the unique identifier of this client.
     const std::string& client_uuid() const { return m_client_uuid; }
 
+    // Set how long changes may be held in memory before being written to the
+    // metadata Realm. Zero (the default) writes each change synchronously.
+    // This applies to every manager sharing this manager's cache. Setting it
+    // to zero flushes any changes which are already pending.
+    void set_flush_interval(std::chrono::milliseconds interval) const;
+
+    // Synchronously write all pending changes to the metadata Realm.
+    void flush() const;
+
     /// Construct the metadata manager.
     ///
     /// If the platform supports it, setting `should_encrypt` to `true` and not specifying an encryption key will make
@@ -210,16 +236,12 @@ public:
     SyncMetadataManager(std::string path,
                         bool should_encrypt,
                         util::Optional<std::vector<char>> encryption_key=none);
+    ~SyncMetadataManager();
 
 private:
     SyncUserMetadataResults get_users(bool marked) const;
-    Realm::Config m_metadata_config;
-    SyncUserMetadata::Schema m_user_schema;
-    SyncFileActionMetadata::Schema m_file_action_schema;
-    SyncClientMetadata::Schema m_client_schema;
+    std::shared_ptr<_impl::SyncMetadataCache> m_cache;
     std::string m_client_uuid;
-
-    std::shared_ptr<Realm> get_realm() const;
 };
 
 }
@@ -18,61 +18,138 @@
 
 #include "sync/impl/work_queue.hpp"
 
-#include <chrono>
+#include <algorithm>
 
 namespace realm {
 namespace _impl {
 namespace partial_sync {
 
+WorkQueue& WorkQueue::shared()
+{
+    // Heap-allocated and never destroyed so that Realms closed during static
+    // destruction can't find it already gone
+    static WorkQueue& queue = *new WorkQueue(4, 1024);
+    return queue;
+}
+
+WorkQueue::WorkQueue(size_t max_threads, size_t max_queued)
+: m_max_threads(std::max<size_t>(max_threads, 1))
+, m_max_queued(std::max<size_t>(max_queued, 1))
+{
+}
+
 WorkQueue::~WorkQueue()
 {
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_stopping = true;
     }
-    m_cv.notify_one();
+    m_work_cv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
 
-    if (m_thread.joinable())
-        m_thread.join();
+bool WorkQueue::is_worker_thread() const
+{
+    auto id = std::this_thread::get_id();
+    return std::any_of(m_threads.begin(), m_threads.end(), [&](auto& thread) { return thread.get_id() == id; });
 }
 
-void WorkQueue::enqueue(std::function<void()> function)
+void WorkQueue::enqueue(std::string const& key, Priority priority, std::function<void()> function)
 {
     {
         std::unique_lock<std::mutex> lock(m_mutex);
-        m_queue.push_back(std::move(function));
+        if (!is_worker_thread())
+            m_space_cv.wait(lock, [&] { return m_queued < m_max_queued; });
 
-        if (m_stopped)
-            create_thread();
+        m_keys[key].queue.push_back({priority, m_next_sequence++, std::move(function)});
+        ++m_queued;
+        if (m_idle_threads == 0 && m_threads.size() < m_max_threads)
+            m_threads.emplace_back([this] { run(); });
     }
-    m_cv.notify_one();
+    m_work_cv.notify_one();
 }
 
-void WorkQueue::create_thread()
+void WorkQueue::wait_for(std::string const& key)
 {
-    if (m_thread.joinable())
-        m_thread.join();
-
-    m_thread = std::thread([this] {
-        std::vector<std::function<void()>> queue;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (is_worker_thread())
+        return;
+    m_done_cv.wait(lock, [&] { return m_keys.count(key) == 0; });
+}
 
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (!m_stopping &&
-               m_cv.wait_for(lock, std::chrono::milliseconds(500),
-                             [&] { return !m_queue.empty() || m_stopping; })) {
+bool WorkQueue::has_queued(std::string const& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_keys.find(key);
+    return it != m_keys.end() && !it->second.queue.empty();
+}
 
-            swap(queue, m_queue);
+size_t WorkQueue::queued_count()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queued;
+}
 
-            lock.unlock();
-            for (auto& f : queue)
-                f();
-            queue.clear();
-            lock.lock();
+WorkQueue::KeyMap::iterator WorkQueue::next_runnable()
+{
+    auto best = m_keys.end();
+    Priority best_priority = Priority::Background;
+    for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
+        auto& state = it->second;
+        if (state.running || state.queue.empty())
+            continue;
+        // Work for a key runs in order, so later high priority work raises
+        // the priority of everything queued ahead of it
+        auto priority = std::max_element(state.queue.begin(), state.queue.end(), [](auto& a, auto& b) {
+            return a.priority < b.priority;
+        })->priority;
+        if (best == m_keys.end() || priority > best_priority ||
+            (priority == best_priority && state.queue.front().sequence < best->second.queue.front().sequence)) {
+            best = it;
+            best_priority = priority;
         }
+    }
+    return best;
+}
+
+void WorkQueue::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        auto next = m_keys.end();
+        ++m_idle_threads;
+        m_work_cv.wait(lock, [&] {
+            next = next_runnable();
+            return next != m_keys.end() || (m_stopping && m_queued == 0);
+        });
+        --m_idle_threads;
+        if (next == m_keys.end())
+            return;
 
-        m_stopped = true;
-    });
-    m_stopped = false;
+        auto& state = next->second;
+        auto function = std::move(state.queue.front().function);
+        state.queue.pop_front();
+        state.running = true;
+        --m_queued;
+        m_space_cv.notify_one();
+
+        // m_keys may be rehashed while the lock is released, so look the
+        // entry up again afterwards
+        std::string key = next->first;
+        lock.unlock();
+        function();
+        function = nullptr;
+        lock.lock();
+
+        auto it = m_keys.find(key);
+        it->second.running = false;
+        if (it->second.queue.empty())
+            m_keys.erase(it);
+        // Other work for this key may now be runnable
+        m_work_cv.notify_all();
+        m_done_cv.notify_all();
+    }
 }
 
 } // namespace partial_sync
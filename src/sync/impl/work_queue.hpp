@@ -20,31 +20,95 @@
 #define REALM_OS_PARTIAL_SYNC_WORK_QUEUE
 
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace realm {
 namespace _impl {
 namespace partial_sync {
 
+// A pool of threads for performing background partial sync work. Each piece
+// of work has a key, normally the path of the Realm it is for: work with the
+// same key is run one at a time in the order it was queued, while work with
+// different keys may be run in parallel. When there is more runnable work
+// than idle threads, the keys which have higher priority work queued go first.
 class WorkQueue {
 public:
+    enum class Priority {
+        // Work which nothing visible waits on, such as removing subscriptions
+        Background,
+        // Work which the user is likely to be waiting on, such as creating subscriptions
+        Interactive,
+    };
+
+    // The queue shared by all Realms
+    static WorkQueue& shared();
+
+    // Threads are created on demand, up to `max_threads`, and then kept for
+    // the lifetime of the queue. At most `max_queued` pieces of work can be
+    // waiting to start at once.
+    WorkQueue(size_t max_threads, size_t max_queued);
     ~WorkQueue();
-    void enqueue(std::function<void()> function);
+
+    WorkQueue(WorkQueue const&) = delete;
+    WorkQueue& operator=(WorkQueue const&) = delete;
+
+    // Queue `function` to be run on a worker thread. If the queue is full this
+    // blocks until there is space, except when called from a worker thread
+    // (where waiting could deadlock).
+    void enqueue(std::string const& key, Priority priority, std::function<void()> function);
+
+    // Block until all of the work queued with the given key has completed.
+    // Returns immediately if called from a worker thread.
+    void wait_for(std::string const& key);
+
+    // Check if there is work queued with the given key which hasn't started
+    // yet. Work which is currently running isn't counted.
+    bool has_queued(std::string const& key);
+
+    // The total number of pieces of work which haven't started yet
+    size_t queued_count();
 
 private:
-    void create_thread();
+    struct Work {
+        Priority priority;
+        // Orders work between keys of equal priority
+        uint64_t sequence;
+        std::function<void()> function;
+    };
+    struct KeyState {
+        std::deque<Work> queue;
+        bool running = false;
+    };
+    using KeyMap = std::unordered_map<std::string, KeyState>;
+
+    const size_t m_max_threads;
+    const size_t m_max_queued;
 
     std::mutex m_mutex;
-    std::condition_variable m_cv;
-    std::vector<std::function<void()>> m_queue;
-    std::thread m_thread;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_space_cv;
+    std::condition_variable m_done_cv;
+    // Entries are removed once they have nothing queued or running
+    KeyMap m_keys;
+    size_t m_queued = 0;
+    uint64_t m_next_sequence = 0;
+    std::vector<std::thread> m_threads;
+    size_t m_idle_threads = 0;
     bool m_stopping = false;
-    bool m_stopped = true;
-};
 
+    bool is_worker_thread() const;
+    // Find the key whose work should be run next, or m_keys.end() if none can be
+    // precondition: m_mutex is locked
+    KeyMap::iterator next_runnable();
+    void run();
+};
 
 } // namespace partial_sync
 } // namespace _impl
@@ -32,12 +32,24 @@
 #include "sync/impl/work_queue.hpp"
 #include "sync/subscription_state.hpp"
 #include "sync/sync_config.hpp"
+#include "sync/sync_manager.hpp"
 #include "sync/sync_session.hpp"
 
 #include <realm/lang_bind_helper.hpp>
+#include <realm/parser/parser.hpp>
+#include <realm/parser/query_builder.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <stdint.h>
+#include <system_error>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
 using namespace std::chrono;
 
@@ -241,6 +253,11 @@ public:
     {
         return Realm::Internal::get_coordinator(realm);
     }
+
+    static decltype(auto) get_subscription_notifier(Realm& realm)
+    {
+        return Realm::Internal::get_subscription_notifier(realm);
+    }
 };
 
 template<typename... Args>
@@ -279,19 +296,218 @@ QueryTypeMismatchException::QueryTypeMismatchException(const std::string& msg)
 : std::logic_error(msg)
 {}
 
+SubscriptionTimeoutException::SubscriptionTimeoutException(const std::string& msg)
+: std::runtime_error(msg)
+{}
+
 namespace {
 
+// SharedGroups left open between pieces of partial sync work for the same
+// Realm file, so that a burst of subscription changes opens the file once
+// rather than once per change. Work for a file never runs concurrently, so a
+// pooled SharedGroup is only ever used by one thread at a time. A SharedGroup
+// is only pooled while there is more work queued for its file, as leaving it
+// open any longer would prevent the file from being compacted or deleted.
+//
+// Entries are looked up by path, but the file at a path can be deleted and
+// recreated between pieces of work (e.g. by a client reset), so each entry
+// also records the identity of the file it has open and is discarded rather
+// than reused if the path now refers to a different file. Windows can't delete
+// a file which is open, so the path alone is enough there.
+class SharedGroupPool {
+public:
+    struct FileIdentity {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+
+        bool operator==(FileIdentity const& other) const noexcept
+        {
+            return device == other.device && inode == other.inode;
+        }
+    };
+
+    struct Entry {
+        std::unique_ptr<Replication> history;
+        std::unique_ptr<SharedGroup> sg;
+        FileIdentity identity;
+    };
+
+    static SharedGroupPool& shared()
+    {
+        // Never destroyed for the same reason as the WorkQueue
+        static SharedGroupPool& pool = *new SharedGroupPool;
+        return pool;
+    }
+
+    Entry acquire(Realm::Config const& config)
+    {
+        Entry stale;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_entries.find(config.path);
+            if (it != m_entries.end()) {
+                auto entry = std::move(it->second);
+                m_entries.erase(it);
+                auto identity = identity_of(config.path);
+                if (identity && *identity == entry.identity)
+                    return entry;
+                // Closed after releasing the lock, as closing may be slow
+                stale = std::move(entry);
+            }
+        }
+
+        Entry entry;
+        std::unique_ptr<Group> read_only_group;
+        Realm::open_with_config(config, entry.history, entry.sg, read_only_group, nullptr);
+        return entry;
+    }
+
+    void release(std::string const& path, Entry entry)
+    {
+        // The identity is read after the work rather than when opening, as
+        // the file may not have existed until the SharedGroup created it
+        auto identity = identity_of(path);
+        if (!identity)
+            return;
+        entry.identity = *identity;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[path] = std::move(entry);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+
+    static util::Optional<FileIdentity> identity_of(std::string const& path)
+    {
+#ifdef _WIN32
+        static_cast<void>(path);
+        return FileIdentity{};
+#else
+        struct stat path_stat;
+        if (stat(path.c_str(), &path_stat) != 0)
+            return util::none;
+        return FileIdentity{static_cast<uint64_t>(path_stat.st_dev), static_cast<uint64_t>(path_stat.st_ino)};
+#endif
+    }
+};
+
 template<typename F>
 void with_open_shared_group(Realm::Config const& config, F&& function)
 {
-    std::unique_ptr<Replication> history;
-    std::unique_ptr<SharedGroup> sg;
-    std::unique_ptr<Group> read_only_group;
-    Realm::open_with_config(config, history, sg, read_only_group, nullptr);
+    auto& pool = SharedGroupPool::shared();
+    auto entry = pool.acquire(config);
 
-    function(*sg);
+    // If this throws the SharedGroup is closed rather than pooled, as it may
+    // have been left in a transaction
+    function(*entry.sg);
+
+    if (entry.sg->get_transact_stage() == SharedGroup::transact_Ready
+        && _impl::partial_sync::WorkQueue::shared().has_queued(config.path))
+        pool.release(config.path, std::move(entry));
 }
 
+// Subscriptions written from the work queue don't delete the expired ones
+// themselves, as apps which create many short-lived subscriptions would then
+// query __ResultSets for expired rows on every write. Instead a sweep of each
+// Realm file is queued at most once per interval, which deletes all of the
+// expired subscriptions in a single write transaction, or doesn't write at
+// all if there aren't any.
+//
+// There's no timer: sweeps are only queued by registrations, so expired
+// subscriptions are removed by the first registration for the file after the
+// interval has passed, or when the file is next opened. A file which gets no
+// further registrations keeps them until then.
+class ExpiredSubscriptionSweeper {
+public:
+    static ExpiredSubscriptionSweeper& shared()
+    {
+        // Never destroyed for the same reason as the WorkQueue
+        static ExpiredSubscriptionSweeper& sweeper = *new ExpiredSubscriptionSweeper;
+        return sweeper;
+    }
+
+    void set_interval(std::chrono::milliseconds interval)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interval = interval;
+        m_next_sweep.clear();
+    }
+
+    // Queue a sweep of the Realm unless one was already queued for it within
+    // the current interval
+    void schedule(Realm::Config const& config)
+    {
+        auto now = steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_next_sweep.find(config.path);
+            if (it != m_next_sweep.end() && now < it->second)
+                return;
+
+            // Files whose interval has passed would be swept by their next
+            // registration anyway, so their entries are only kept for files
+            // which are still being written to
+            for (auto it = m_next_sweep.begin(); it != m_next_sweep.end();) {
+                if (it->second <= now)
+                    it = m_next_sweep.erase(it);
+                else
+                    ++it;
+            }
+            m_next_sweep[config.path] = now + m_interval;
+        }
+
+        _impl::partial_sync::WorkQueue::shared().enqueue(config.path, _impl::partial_sync::WorkQueue::Priority::Background,
+                                                         [this, config] {
+            // There's no one waiting on the sweep to report a failure to, so
+            // it's logged and the next registration tries again rather than
+            // waiting out the interval
+            try {
+                with_open_shared_group(config, [&](SharedGroup& sg) {
+                    sweep(config, sg);
+                });
+            }
+            catch (std::exception const& e) {
+                SyncManager::shared().make_logger()->error("Failed to remove expired subscriptions from '%1': %2",
+                                                           config.path, e.what());
+                retry(config.path);
+            }
+            catch (...) {
+                SyncManager::shared().make_logger()->error("Failed to remove expired subscriptions from '%1'",
+                                                           config.path);
+                retry(config.path);
+            }
+        });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::chrono::milliseconds m_interval = std::chrono::seconds(30);
+    std::unordered_map<std::string, steady_clock::time_point> m_next_sweep;
+
+    void retry(std::string const& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_next_sweep.erase(path);
+    }
+
+    static void sweep(Realm::Config const& config, SharedGroup& sg)
+    {
+        Timestamp now = timestamp_now();
+        auto& group = sg.begin_read();
+        auto table = ObjectStore::table_for_object_type(group, result_sets_type_name);
+        size_t expires_at = table ? table->get_column_index(property_expires_at) : npos;
+        if (expires_at == npos || table->where().less(expires_at, now).count() == 0) {
+            sg.end_read();
+            return;
+        }
+
+        _impl::WriteTransactionNotifyingSync write(config, sg);
+        cleanup_subscriptions(write.get_group(), now);
+        write.commit();
+    }
+};
+
 struct ResultSetsColumns {
     ResultSetsColumns(Table& table, std::string const& matches_property_name)
     {
@@ -338,6 +554,88 @@ struct ResultSetsColumns {
     size_t time_to_live;
 };
 
+// Build the description of a parsed predicate. The parser and the serializer
+// can only be combined by applying the predicate to a Query.
+std::string describe_predicate(Table& table, parser::Predicate const& predicate)
+{
+    Query query = table.where();
+    query_builder::NoArguments no_args;
+    query_builder::apply_predicate(query, predicate, no_args);
+    return query.get_description();
+}
+
+void flatten_operands(parser::Predicate::Type type, std::vector<parser::Predicate>& operands,
+                      std::vector<parser::Predicate>& out)
+{
+    for (auto& operand : operands) {
+        if (operand.type == type && !operand.negate)
+            flatten_operands(type, operand.cpnd.sub_predicates, out);
+        else
+            out.push_back(std::move(operand));
+    }
+}
+
+// Rewrite `predicate` so that predicates which only differ in the order or
+// grouping of the operands of AND and OR, or in repeating an operand, become
+// identical, and return its description.
+std::string canonicalize_predicate(Table& table, parser::Predicate& predicate)
+{
+    using Type = parser::Predicate::Type;
+    if (predicate.type != Type::And && predicate.type != Type::Or)
+        return describe_predicate(table, predicate);
+
+    std::vector<parser::Predicate> operands;
+    flatten_operands(predicate.type, predicate.cpnd.sub_predicates, operands);
+
+    std::vector<std::pair<std::string, parser::Predicate>> described;
+    described.reserve(operands.size());
+    for (auto& operand : operands) {
+        auto description = canonicalize_predicate(table, operand);
+        described.emplace_back(std::move(description), std::move(operand));
+    }
+    std::sort(described.begin(), described.end(), [](auto& a, auto& b) { return a.first < b.first; });
+    described.erase(std::unique(described.begin(), described.end(), [](auto& a, auto& b) { return a.first == b.first; }),
+                    described.end());
+
+    predicate.cpnd.sub_predicates.clear();
+    for (auto& operand : described)
+        predicate.cpnd.sub_predicates.push_back(std::move(operand.second));
+    return describe_predicate(table, predicate);
+}
+
+// The description of a query with the operands of its ANDs and ORs flattened,
+// sorted and deduplicated, so that the descriptions of semantically identical
+// queries which were built differently compare equal. Descriptions which
+// can't be parsed back are returned as they are.
+std::string canonical_description(Table& table, std::string const& description)
+{
+    try {
+        auto parsed = parser::parse(description);
+        auto canonical = canonicalize_predicate(table, parsed.predicate);
+        DescriptorOrdering ordering;
+        query_builder::apply_ordering(ordering, table.get_table_ref(), parsed.ordering);
+        if (!ordering.is_empty())
+            canonical += " " + ordering.get_description(table.get_table_ref());
+        return canonical;
+    }
+    catch (std::exception const&) {
+        return description;
+    }
+}
+
+// Check if the query persisted for a subscription and a newly serialized one
+// are equivalent. Both are stored as serialized, as existing subscriptions are
+// named and looked up by that form, so each is canonicalized to compare them.
+bool queries_match(Group& group, std::string const& object_type, StringData existing, std::string const& query)
+{
+    if (existing == query)
+        return true;
+    auto table = ObjectStore::table_for_object_type(group, object_type);
+    if (!table)
+        return false;
+    return canonical_description(*table, std::string(existing)) == canonical_description(*table, query);
+}
+
 // Performs the logic of actually writing the subscription (if needed) to the Realm and making sure
 // that the `matches_property` field is setup correctly. This method will throw if the query cannot
 // be serialized or the name is already used by another subscription.
@@ -349,8 +647,11 @@ struct ResultSetsColumns {
 // If `update = true` and  if a subscription with `name` already exists, its query and time_to_live
 // will be updated instead of an exception being thrown if the query parsed in was different than
 // the persisted query.
+//
+// If `clean_up_expired` is set, expired subscriptions are deleted in the same write. Otherwise they're
+// left for the ExpiredSubscriptionSweeper.
 Row write_subscription(std::string const& object_type, std::string const& name, std::string const& query,
-        util::Optional<int64_t> time_to_live_ms, bool update, Group& group)
+        util::Optional<int64_t> time_to_live_ms, bool update, Group& group, bool clean_up_expired = true)
 {
     Timestamp now = timestamp_now();
     auto matches_property = std::string(object_type) + "_matches";
@@ -386,7 +687,7 @@ Row write_subscription(std::string const& object_type, std::string const& name,
         // updating TTL using this API and instead require updates to TTL to go through a managed Subscription.
         if (update) {
             // If the query changed we must reset state to force the server to re-evaluate the subscription.
-            if (table->get_string(columns.query, row_ndx) != query) {
+            if (!queries_match(group, object_type, table->get_string(columns.query, row_ndx), query)) {
                 table->set_string(columns.error_message, row_ndx, "");
                 table->set_int(columns.status, row_ndx, 0);
             }
@@ -395,7 +696,7 @@ Row write_subscription(std::string const& object_type, std::string const& name,
         }
         else {
             StringData existing_query = table->get_string(columns.query, row_ndx);
-            if (existing_query != query)
+            if (!queries_match(group, object_type, existing_query, query))
                 throw ExistingSubscriptionException(util::format("An existing subscription exists with the name '%1' "
                                                                  "but with a different query: '%1' vs '%2'",
                                                                  name, existing_query, query));
@@ -425,44 +726,87 @@ Row write_subscription(std::string const& object_type, std::string const& name,
     // Fetch subscription first and return it. Cleanup needs to be performed after as it might delete subscription
     // causing the row_ndx to change.
     Row subscription = table->get(row_ndx);
-    cleanup_subscriptions(group, now);
+    if (clean_up_expired)
+        cleanup_subscriptions(group, now);
     return subscription;
 }
 
-void enqueue_registration(Realm& realm, std::string object_type, std::string query, std::string name,
-                          util::Optional<int64_t> time_to_live, bool update,
-                          std::function<void(std::exception_ptr)> callback)
+struct PendingRegistration {
+    std::string object_type;
+    std::string query;
+    std::string name;
+    util::Optional<int64_t> time_to_live;
+    bool update;
+    std::function<void(std::exception_ptr)> callback;
+};
+
+// Writes all of the given subscriptions in a single write transaction on the
+// partial sync worker thread. Each subscription which cannot be written has
+// its own callback invoked with the error without preventing the others from
+// being created, while a failure to commit is reported to all of them.
+void enqueue_registrations(Realm& realm, std::vector<PendingRegistration> registrations)
 {
     auto config = realm.config();
 
-    auto& work_queue = _impl::PartialSyncHelper::get_coordinator(realm).partial_sync_work_queue();
-    work_queue.enqueue([object_type=std::move(object_type), query=std::move(query), name=std::move(name),
-                        callback=std::move(callback), config=std::move(config), time_to_live=time_to_live, update=update] {
+    // Queued first so that, as when each write cleaned up, subscriptions
+    // which had already expired are deleted but the new ones aren't
+    ExpiredSubscriptionSweeper::shared().schedule(config);
+
+    auto& work_queue = _impl::partial_sync::WorkQueue::shared();
+    auto key = config.path;
+    work_queue.enqueue(key, _impl::partial_sync::WorkQueue::Priority::Interactive,
+                       [registrations=std::move(registrations), config=std::move(config)] {
+        std::vector<std::exception_ptr> errors(registrations.size());
         try {
             with_open_shared_group(config, [&](SharedGroup& sg) {
                 _impl::WriteTransactionNotifyingSync write(config, sg);
-                write_subscription(object_type, name, query, time_to_live, update, write.get_group());
+                for (size_t i = 0; i < registrations.size(); ++i) {
+                    auto& registration = registrations[i];
+                    try {
+                        write_subscription(registration.object_type, registration.name, registration.query,
+                                           registration.time_to_live, registration.update, write.get_group(),
+                                           false);
+                    }
+                    catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
                 write.commit();
             });
         } catch (...) {
-            callback(std::current_exception());
+            auto error = std::current_exception();
+            for (auto& registration : registrations)
+                registration.callback(error);
             return;
         }
 
-        callback(nullptr);
+        for (size_t i = 0; i < registrations.size(); ++i)
+            registrations[i].callback(errors[i]);
     });
 }
 
+void enqueue_registration(Realm& realm, std::string object_type, std::string query, std::string name,
+                          util::Optional<int64_t> time_to_live, bool update,
+                          std::function<void(std::exception_ptr)> callback)
+{
+    std::vector<PendingRegistration> registrations;
+    registrations.push_back({std::move(object_type), std::move(query), std::move(name),
+                             std::move(time_to_live), update, std::move(callback)});
+    enqueue_registrations(realm, std::move(registrations));
+}
+
 void enqueue_unregistration(Object result_set, std::function<void()> callback)
 {
     auto realm = result_set.realm();
     auto config = realm->config();
-    auto& work_queue = _impl::PartialSyncHelper::get_coordinator(*realm).partial_sync_work_queue();
+    auto& work_queue = _impl::partial_sync::WorkQueue::shared();
 
     // Export a reference to the __ResultSets row so we can hand it to the worker thread.
     auto handover = _impl::export_for_handover(*realm, Row(result_set.row()));
 
-    work_queue.enqueue([handover=std::move(handover), callback=std::move(callback),
+    auto key = config.path;
+    work_queue.enqueue(key, _impl::partial_sync::WorkQueue::Priority::Background,
+                       [handover=std::move(handover), callback=std::move(callback),
                         config=std::move(config)] () {
         with_open_shared_group(config, [&](SharedGroup& sg) {
             Row row = _impl::import_from_handover(sg, *handover);
@@ -480,27 +824,30 @@ void enqueue_unregistration(Object result_set, std::function<void()> callback)
 }
 
 template<typename Notifier>
-void enqueue_unregistration(Results const& result_set, std::shared_ptr<Notifier> notifier,
-                            std::function<void()> callback)
+void enqueue_unregistration(Results const& result_set, std::shared_ptr<Notifier> notifier, size_t slot,
+                            std::shared_ptr<void> slot_lease, std::function<void()> callback)
 {
     auto realm = result_set.get_realm();
     auto config = realm->config();
-    auto& work_queue = _impl::PartialSyncHelper::get_coordinator(*realm).partial_sync_work_queue();
+    auto& work_queue = _impl::partial_sync::WorkQueue::shared();
 
     // Export a reference to the query which will match the __ResultSets row
     // once it's created so we can hand it to the worker thread
     Query q = result_set.get_query();
     auto handover = _impl::export_for_handover(*realm, q, MutableSourcePayload::Move);
 
-    work_queue.enqueue([handover=std::move(handover), callback=std::move(callback),
-                        config=std::move(config), notifier=std::move(notifier)] () {
+    auto key = config.path;
+    work_queue.enqueue(key, _impl::partial_sync::WorkQueue::Priority::Background,
+                       [handover=std::move(handover), callback=std::move(callback),
+                        config=std::move(config), notifier=std::move(notifier), slot,
+                        slot_lease=std::move(slot_lease)] () {
         with_open_shared_group(config, [&](SharedGroup& sg) {
             Query query = _impl::import_from_handover(sg, *handover);
 
             // If creating the subscription failed there might be another
             // pre-existing subscription which matches our query, so we need to
             // not remove that
-            if (notifier->failed())
+            if (notifier->failed(slot))
                 return;
 
             _impl::WriteTransactionNotifyingSync write(config, sg);
@@ -527,140 +874,471 @@ std::string default_name_for_query(const std::string& query, const std::string&
 } // unnamed namespace
 
 
-struct Subscription::Notifier : public _impl::CollectionNotifier {
+} // namespace partial_sync
+
+namespace _impl {
+
+void set_expired_subscription_sweep_interval(std::chrono::milliseconds interval)
+{
+    partial_sync::ExpiredSubscriptionSweeper::shared().set_interval(interval);
+}
+
+// A notifier for all of the partial sync Subscriptions in a Realm, so that
+// observing many subscriptions reads the __ResultSets table once per commit
+// rather than running a query over it for each subscription.
+//
+// Each Subscription is assigned a slot. The change sets delivered by the
+// notifier report a modification of a slot whenever the __ResultSets row with
+// that slot's name is created, changed or removed, or when the registration of
+// the subscription on the partial sync worker thread progresses. The callbacks
+// added by Subscription::add_notification_callback() are only called for
+// changes to their own slot. A slot is reused once the Subscription it was
+// assigned to and everything waiting on it have been destroyed, which can
+// result in a single spurious call of the new owner's callbacks for a change
+// reported before the slot was released.
+class SubscriptionNotifier : public CollectionNotifier {
+public:
     enum State {
         Creating,
         Complete,
         Removed,
     };
 
-    Notifier(std::shared_ptr<Realm> realm)
-    : _impl::CollectionNotifier(std::move(realm))
-    , m_coordinator(&_impl::PartialSyncHelper::get_coordinator(*get_realm()))
+    // Get the notifier shared by the Subscriptions in `realm`, creating and
+    // registering a new one if needed. The notifier is unregistered once the
+    // last copy of `lifetime` has been destroyed.
+    static std::shared_ptr<SubscriptionNotifier> get(std::shared_ptr<Realm> const& realm,
+                                                     std::shared_ptr<void>& lifetime)
     {
+        auto& cached = PartialSyncHelper::get_subscription_notifier(*realm);
+        auto notifier = cached.lock();
+        std::shared_ptr<Lifetime> shared_lifetime;
+        if (notifier)
+            shared_lifetime = notifier->m_lifetime.lock();
+        if (!shared_lifetime) {
+            notifier = std::make_shared<SubscriptionNotifier>(realm);
+            shared_lifetime = std::make_shared<Lifetime>();
+            shared_lifetime->notifier = notifier;
+            notifier->m_lifetime = shared_lifetime;
+            notifier->m_self = notifier;
+            RealmCoordinator::register_notifier(notifier);
+            cached = notifier;
+        }
+        lifetime = std::move(shared_lifetime);
+        return notifier;
     }
 
-    void release_data() noexcept override { }
-    void run() override
+    SubscriptionNotifier(std::shared_ptr<Realm> realm)
+    : CollectionNotifier(std::move(realm))
+    , m_coordinator(&PartialSyncHelper::get_coordinator(*get_realm()))
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_has_results_to_deliver) {
-            // Mark the object as being modified so that CollectionNotifier is aware
-            // that there are changes to deliver.
-            m_changes.modify(0);
-        }
     }
 
-    void deliver(SharedGroup&) override
+    // Assign a slot to a new subscription. The slot is released for reuse
+    // once the last copy of `lease` has been destroyed.
+    size_t add_slot(std::string name, std::shared_ptr<void>& lease)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_error = m_pending_error;
-        m_pending_error = nullptr;
+        size_t slot;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_free_slots.empty()) {
+                slot = m_slots.size();
+                m_slots.push_back({});
+            }
+            else {
+                slot = m_free_slots.back();
+                m_free_slots.pop_back();
+            }
+            m_slots_by_name[name].push_back(slot);
+            m_slots[slot].name = std::move(name);
+        }
+        auto slot_lease = std::make_shared<SlotLease>();
+        slot_lease->notifier = m_self;
+        slot_lease->slot = slot;
+        lease = std::move(slot_lease);
+        return slot;
+    }
 
-        m_state = m_pending_state;
-        m_has_results_to_deliver = false;
+    // Report a change for the slot in the next delivery even if nothing has
+    // changed, so that a newly added callback is called for it
+    void mark_changed(size_t slot)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changed_slots.push_back(slot);
     }
 
-    void finished_subscribing(std::exception_ptr error)
+    void finished_subscribing(size_t slot, std::exception_ptr error)
     {
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_pending_error = error;
-            m_pending_state = Complete;
-            m_has_results_to_deliver = true;
-            m_failed = error != nullptr;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& s = m_slots[slot];
+            s.pending_error = error;
+            s.pending_state = Complete;
+            s.failed = error != nullptr;
+            m_changed_slots.push_back(slot);
         }
 
         // Trigger processing of change notifications.
         m_coordinator->wake_up_notifier_worker();
     }
 
-    void finished_unsubscribing()
+    void finished_unsubscribing(size_t slot)
     {
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
-
-            m_pending_state = Removed;
-            m_has_results_to_deliver = true;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& s = m_slots[slot];
+            s.pending_error = nullptr;
+            s.pending_state = Removed;
+            m_changed_slots.push_back(slot);
         }
 
         // Trigger processing of change notifications.
         m_coordinator->wake_up_notifier_worker();
     }
 
-    std::exception_ptr error() const
+    std::exception_ptr error(size_t slot) const
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        return m_error;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slots[slot].error;
     }
 
-    State state() const
+    State state(size_t slot) const
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        return m_state;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slots[slot].state;
     }
 
-    bool failed() const
+    bool failed(size_t slot) const
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        return m_failed;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slots[slot].failed;
+    }
+
+    // Look up the index in the __ResultSets table of the row for the named
+    // subscription, or npos if there isn't one, as of the most recently
+    // delivered version. Returns false if `sg` isn't at that version, in
+    // which case the table has to be searched instead.
+    // Must be called on the target thread.
+    bool find_row(std::string const& name, std::string const& matches_property,
+                  SharedGroup const& sg, size_t& row_ndx) const
+    {
+        if (!m_has_rows || sg.get_version_of_current_transaction() != m_rows_version)
+            return false;
+        auto it = m_rows.find(name);
+        row_ndx = it != m_rows.end() && it->second.matches_property == matches_property ? it->second.row_ndx : npos;
+        return true;
     }
 
 private:
-    void do_attach_to(SharedGroup&) override { }
-    void do_detach_from(SharedGroup&) override { }
+    struct Lifetime {
+        std::weak_ptr<SubscriptionNotifier> notifier;
+        ~Lifetime()
+        {
+            if (auto n = notifier.lock())
+                n->unregister();
+        }
+    };
+    std::weak_ptr<Lifetime> m_lifetime;
+    std::weak_ptr<SubscriptionNotifier> m_self;
 
-    void do_prepare_handover(SharedGroup&) override
+    struct SlotLease {
+        std::weak_ptr<SubscriptionNotifier> notifier;
+        size_t slot;
+        ~SlotLease()
+        {
+            if (auto n = notifier.lock())
+                n->release_slot(slot);
+        }
+    };
+
+    void release_slot(size_t slot)
     {
-        add_changes(std::move(m_changes));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& s = m_slots[slot];
+        auto it = m_slots_by_name.find(s.name);
+        REALM_ASSERT(it != m_slots_by_name.end());
+        auto& slots = it->second;
+        slots.erase(std::find(slots.begin(), slots.end(), slot));
+        if (slots.empty())
+            m_slots_by_name.erase(it);
+        s = {};
+        m_free_slots.push_back(slot);
     }
 
-    bool do_add_required_change_info(_impl::TransactionChangeInfo&) override { return false; }
-    bool prepare_to_deliver() override { return m_has_results_to_deliver; }
+    struct Slot {
+        std::string name;
+        State state = Creating;
+        State pending_state = Creating;
+        std::exception_ptr error;
+        std::exception_ptr pending_error;
+        // Read by the partial sync worker thread, so not delayed until delivery
+        bool failed = false;
+    };
+
+    // The parts of a __ResultSets row which the state of a Subscription
+    // depends on, by subscription name
+    struct RowState {
+        size_t row_ndx;
+        std::string matches_property;
+        int64_t status;
+        std::string error_message;
+        Timestamp updated_at;
+
+        bool same_state(RowState const& other) const
+        {
+            return status == other.status && updated_at == other.updated_at
+                && matches_property == other.matches_property && error_message == other.error_message;
+        }
+    };
+    using Rows = std::unordered_map<std::string, RowState>;
 
-    _impl::RealmCoordinator *m_coordinator;
+    RealmCoordinator *m_coordinator;
 
+    // Guards the slots, which are added on the target thread, updated by the
+    // partial sync worker thread and read by the notifier worker thread
     mutable std::mutex m_mutex;
-    _impl::CollectionChangeBuilder m_changes;
-    std::exception_ptr m_pending_error = nullptr;
-    std::exception_ptr m_error = nullptr;
-    bool m_has_results_to_deliver = false;
-    bool m_failed = false;
-
-    State m_state = Creating;
-    State m_pending_state = Creating;
+    std::vector<Slot> m_slots;
+    std::unordered_map<std::string, std::vector<size_t>> m_slots_by_name;
+    std::vector<size_t> m_free_slots;
+    std::vector<size_t> m_changed_slots;
+
+    // Worker thread state
+    Group* m_group = nullptr;
+    TransactionChangeInfo* m_info = nullptr;
+    size_t m_table_ndx = npos;
+    bool m_has_scanned = false;
+    bool m_rows_changed = false;
+    Rows m_worker_rows;
+    CollectionChangeBuilder m_changes;
+
+    // Handed over from the worker thread in do_prepare_handover()
+    Rows m_rows_to_deliver;
+    bool m_has_rows_to_deliver = false;
+
+    // Target thread state
+    Rows m_rows;
+    VersionID m_rows_version;
+    bool m_has_rows = false;
+
+    void release_data() noexcept override
+    {
+        m_group = nullptr;
+    }
+
+    void do_attach_to(SharedGroup& sg) override
+    {
+        m_group = &SharedGroupFriend::get_group(sg);
+    }
+
+    void do_detach_from(SharedGroup&) override
+    {
+        m_group = nullptr;
+    }
+
+    bool do_add_required_change_info(TransactionChangeInfo& info) override
+    {
+        m_info = &info;
+        if (m_table_ndx != npos)
+            info.table_modifications_needed.set(m_table_ndx);
+        return false;
+    }
+
+    const char* trace_name() const noexcept override { return "SubscriptionNotifier"; }
+
+    void run() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t slot : m_changed_slots)
+                m_changes.modify(slot);
+            m_changed_slots.clear();
+        }
+
+        if (!m_group)
+            return;
+        // The rows only need to be read again if the table was written to,
+        // in which case there's a change for it even if no rows were modified
+        if (m_has_scanned && m_info && !m_info->schema_changed && !m_info->changes_unknown
+            && !m_info->tables.find(m_table_ndx))
+            return;
+
+        auto table = ObjectStore::table_for_object_type(*m_group, result_sets_type_name);
+        if (!table)
+            return;
+        m_table_ndx = table->get_index_in_group();
+        bool first_scan = !m_has_scanned;
+        m_has_scanned = true;
+
+        size_t name_col = table->get_column_index(property_name);
+        size_t matches_property_col = table->get_column_index(property_matches_property_name);
+        size_t status_col = table->get_column_index(property_status);
+        size_t error_message_col = table->get_column_index(property_error_message);
+        size_t updated_at_col = table->get_column_index(property_updated_at);
+
+        Rows rows;
+        rows.reserve(table->size());
+        for (size_t i = 0, size = table->size(); i < size; ++i) {
+            rows.emplace(std::string(table->get_string(name_col, i)),
+                         RowState{i, std::string(table->get_string(matches_property_col, i)),
+                                  table->get_int(status_col, i),
+                                  std::string(table->get_string(error_message_col, i)),
+                                  table->get_timestamp(updated_at_col, i)});
+        }
+
+        std::vector<std::string const*> changed_names;
+        bool rows_changed = rows.size() != m_worker_rows.size();
+        for (auto& row : rows) {
+            auto it = m_worker_rows.find(row.first);
+            if (it == m_worker_rows.end() || !it->second.same_state(row.second))
+                changed_names.push_back(&row.first);
+            else if (it->second.row_ndx != row.second.row_ndx)
+                rows_changed = true;
+        }
+        for (auto& row : m_worker_rows) {
+            if (!rows.count(row.first))
+                changed_names.push_back(&row.first);
+        }
+
+        if (!changed_names.empty()) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto name : changed_names) {
+                auto it = m_slots_by_name.find(*name);
+                if (it == m_slots_by_name.end())
+                    continue;
+                for (size_t slot : it->second)
+                    m_changes.modify(slot);
+            }
+        }
+        m_rows_changed = m_rows_changed || first_scan || rows_changed || !changed_names.empty();
+        m_worker_rows = std::move(rows);
+    }
+
+    void do_prepare_handover(SharedGroup&) override
+    {
+        if (m_rows_changed) {
+            m_rows_to_deliver = m_worker_rows;
+            m_has_rows_to_deliver = true;
+            m_rows_changed = false;
+        }
+        add_changes(std::move(m_changes));
+        m_changes = {};
+    }
+
+    void deliver(SharedGroup& sg) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& slot : m_slots) {
+                slot.state = slot.pending_state;
+                slot.error = slot.pending_error;
+            }
+        }
+
+        if (m_has_rows_to_deliver) {
+            m_rows = std::move(m_rows_to_deliver);
+            m_rows_to_deliver = {};
+            m_has_rows_to_deliver = false;
+            m_has_rows = true;
+        }
+        // The rows are only rescanned when they change, so the most recently
+        // delivered ones are also correct for each later version delivered
+        m_rows_version = sg.get_version_of_current_transaction();
+    }
 };
 
-Subscription subscribe(Results const& results, SubscriptionOptions options)
-{
-    auto realm = results.get_realm();
+} // namespace _impl
 
-    auto sync_config = realm->config().sync_config;
-    if (!sync_config || !sync_config->is_partial)
-        throw InvalidRealmStateException("A Subscription can only be created in a Query-based Realm.");
+namespace partial_sync {
+
+namespace {
 
+std::string query_description(Results const& results, IncludeDescriptor const& inclusions)
+{
     auto query = results.get_query().get_description(); // Throws if the query cannot be serialized.
     if (!results.get_descriptor_ordering().is_empty()) {
         query += " " + results.get_descriptor_ordering().get_description(results.get_query().get_table());
     }
 
-    if (options.inclusions.is_valid()) {
-        query += " " + options.inclusions.get_description(results.get_query().get_table());
+    if (inclusions.is_valid()) {
+        query += " " + inclusions.get_description(results.get_query().get_table());
     }
+    return query;
+}
 
+} // unnamed namespace
+
+Subscription subscribe(Results const& results, SubscriptionOptions options)
+{
+    auto realm = results.get_realm();
+
+    auto sync_config = realm->config().sync_config;
+    if (!sync_config || !sync_config->is_partial)
+        throw InvalidRealmStateException("A Subscription can only be created in a Query-based Realm.");
+
+    auto query = query_description(results, options.inclusions);
     std::string name = options.user_provided_name ? std::move(*options.user_provided_name)
                                                   : default_name_for_query(query, results.get_object_type());
 
-    Subscription subscription(name, results.get_object_type(), realm);
-    std::weak_ptr<Subscription::Notifier> weak_notifier = subscription.m_notifier;
+    Subscription subscription(name, results.get_object_type(), query, realm);
+    std::weak_ptr<_impl::SubscriptionNotifier> weak_notifier = subscription.m_notifier;
+    std::weak_ptr<void> weak_lease = subscription.m_slot_lease;
     enqueue_registration(*realm, results.get_object_type(), std::move(query), std::move(name), std::move(options.time_to_live_ms), options.update,
-                         [weak_notifier=std::move(weak_notifier)](std::exception_ptr error) {
-        if (auto notifier = weak_notifier.lock())
-            notifier->finished_subscribing(error);
+                         [weak_notifier=std::move(weak_notifier), weak_lease=std::move(weak_lease),
+                          slot=subscription.m_slot](std::exception_ptr error) {
+        // The slot may have been reused if the Subscription is gone
+        auto lease = weak_lease.lock();
+        auto notifier = weak_notifier.lock();
+        if (lease && notifier)
+            notifier->finished_subscribing(slot, error);
     });
     return subscription;
 }
 
+std::vector<Subscription> subscribe_all(std::vector<std::pair<Results, SubscriptionOptions>> subscriptions)
+{
+    std::vector<Subscription> handles;
+    if (subscriptions.empty())
+        return handles;
+
+    auto realm = subscriptions.front().first.get_realm();
+    auto sync_config = realm->config().sync_config;
+    if (!sync_config || !sync_config->is_partial)
+        throw InvalidRealmStateException("A Subscription can only be created in a Query-based Realm.");
+
+    // Serialize every query before creating anything so that a programming
+    // error in any of them leaves no subscriptions behind.
+    std::vector<PendingRegistration> registrations;
+    registrations.reserve(subscriptions.size());
+    for (auto& subscription : subscriptions) {
+        auto& results = subscription.first;
+        auto& options = subscription.second;
+        if (results.get_realm() != realm)
+            throw InvalidRealmStateException("All subscriptions created together must be in the same Realm.");
+
+        auto query = query_description(results, options.inclusions);
+        std::string name = options.user_provided_name ? std::move(*options.user_provided_name)
+                                                      : default_name_for_query(query, results.get_object_type());
+        registrations.push_back({results.get_object_type(), std::move(query), std::move(name),
+                                 std::move(options.time_to_live_ms), options.update, nullptr});
+    }
+
+    handles.reserve(registrations.size());
+    for (auto& registration : registrations) {
+        handles.push_back(Subscription(registration.name, registration.object_type, registration.query, realm));
+        std::weak_ptr<_impl::SubscriptionNotifier> weak_notifier = handles.back().m_notifier;
+        std::weak_ptr<void> weak_lease = handles.back().m_slot_lease;
+        registration.callback = [weak_notifier=std::move(weak_notifier), weak_lease=std::move(weak_lease),
+                                 slot=handles.back().m_slot](std::exception_ptr error) {
+            auto lease = weak_lease.lock();
+            auto notifier = weak_notifier.lock();
+            if (lease && notifier)
+                notifier->finished_subscribing(slot, error);
+        };
+    }
+    enqueue_registrations(*realm, std::move(registrations));
+    return handles;
+}
+
 Row subscribe_blocking(Results const& results, util::Optional<std::string> user_provided_name,
                        util::Optional<int64_t> time_to_live_ms, bool update)
 {
@@ -674,34 +1352,132 @@ Row subscribe_blocking(Results const& results, util::Optional<std::string> user_
         throw InvalidRealmStateException("A Subscription can only be created in a Query-based Realm.");
     }
 
-    auto query = results.get_query().get_description(); // Throws if the query cannot be serialized.
-    if (!results.get_descriptor_ordering().is_empty()) {
-        query += " " + results.get_descriptor_ordering().get_description(results.get_query().get_table());
-    }
+    auto query = query_description(results, IncludeDescriptor{});
     std::string name = user_provided_name ? std::move(*user_provided_name)
                                           : default_name_for_query(query, results.get_object_type());
     return write_subscription(results.get_object_type(), name, query, time_to_live_ms, update, realm->read_group());
 }
 
+namespace {
+
+// Block until the session has uploaded everything committed so far and then
+// downloaded everything the server had afterwards, or until the deadline
+void wait_for_server_round_trip(std::shared_ptr<SyncSession> const& session, steady_clock::time_point deadline)
+{
+    struct Waiter {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        std::error_code error;
+
+        void finish(std::error_code ec)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = ec;
+            done = true;
+            cv.notify_all();
+        }
+    };
+    // Shared with the completion handlers, which outlive this call if it times out
+    auto waiter = std::make_shared<Waiter>();
+    std::weak_ptr<SyncSession> weak_session = session;
+    bool registered = session->wait_for_upload_completion([waiter, weak_session](std::error_code ec) {
+        if (ec)
+            return waiter->finish(ec);
+        auto session = weak_session.lock();
+        if (!session || !session->wait_for_download_completion([waiter](std::error_code ec) { waiter->finish(ec); }))
+            waiter->finish(make_error_code(std::errc::operation_canceled));
+    });
+    if (!registered)
+        throw std::runtime_error("The sync session for the Realm is not active.");
+
+    std::unique_lock<std::mutex> lock(waiter->mutex);
+    if (!waiter->cv.wait_until(lock, deadline, [&] { return waiter->done; }))
+        throw SubscriptionTimeoutException("Timed out waiting for the subscription to be processed by the server.");
+    if (waiter->error)
+        throw std::system_error(waiter->error);
+}
+
+} // unnamed namespace
+
+Row subscribe_blocking(Results const& results, SubscriptionOptions options, std::chrono::milliseconds timeout)
+{
+    auto deadline = steady_clock::now() + timeout;
+
+    auto realm = results.get_realm();
+    if (realm->is_in_transaction()) {
+        throw InvalidRealmStateException("Waiting for a subscription cannot be done inside a write transaction.");
+    }
+    auto sync_config = realm->config().sync_config;
+    if (!sync_config || !sync_config->is_partial) {
+        throw InvalidRealmStateException("A Subscription can only be created in a Query-based Realm.");
+    }
+
+    auto query = query_description(results, options.inclusions);
+    std::string name = options.user_provided_name ? std::move(*options.user_provided_name)
+                                                  : default_name_for_query(query, results.get_object_type());
+    realm->begin_transaction();
+    Row row;
+    try {
+        row = write_subscription(results.get_object_type(), name, query, options.time_to_live_ms,
+                                 options.update, realm->read_group());
+        realm->commit_transaction();
+    }
+    catch (...) {
+        realm->cancel_transaction();
+        throw;
+    }
+
+    auto session = SyncManager::shared().get_session(realm->config().path, *sync_config);
+    ResultSetsColumns columns(*row.get_table(), std::string(results.get_object_type()) + "_matches");
+    while (true) {
+        if (!row.is_attached())
+            throw std::runtime_error(util::format("The subscription '%1' was removed before it was processed.", name));
+
+        auto state = static_cast<SubscriptionState>(row.get_int(columns.status));
+        if (state == SubscriptionState::Complete)
+            return row;
+        if (state == SubscriptionState::Error)
+            throw std::runtime_error(std::string(row.get_string(columns.error_message)));
+
+        wait_for_server_round_trip(session, deadline);
+        realm->refresh();
+    }
+}
+
 void unsubscribe(Subscription& subscription)
 {
     if (auto result_set_object = subscription.result_set_object()) {
         // The subscription has its result set object, so we can queue up the unsubscription immediately.
-        std::weak_ptr<Subscription::Notifier> weak_notifier = subscription.m_notifier;
-        enqueue_unregistration(*result_set_object, [weak_notifier=std::move(weak_notifier)]() {
-            if (auto notifier = weak_notifier.lock())
-                notifier->finished_unsubscribing();
+        std::weak_ptr<_impl::SubscriptionNotifier> weak_notifier = subscription.m_notifier;
+        std::weak_ptr<void> weak_lease = subscription.m_slot_lease;
+        enqueue_unregistration(*result_set_object, [weak_notifier=std::move(weak_notifier), weak_lease=std::move(weak_lease),
+                                                    slot=subscription.m_slot]() {
+            auto lease = weak_lease.lock();
+            auto notifier = weak_notifier.lock();
+            if (lease && notifier)
+                notifier->finished_unsubscribing(slot);
         });
         return;
     }
 
     switch (subscription.state()) {
-        case SubscriptionState::Creating: {
-            // The result set object is in the process of being created. Try unsubscribing again once it exists.
-            std::weak_ptr<Subscription::Notifier> weak_notifier = subscription.m_notifier;
-            enqueue_unregistration(subscription.m_result_sets, subscription.m_notifier, [weak_notifier=std::move(weak_notifier)]() {
-                if (auto notifier = weak_notifier.lock())
-                    notifier->finished_unsubscribing();
+        case SubscriptionState::Creating:
+        case SubscriptionState::Complete: {
+            // The result set object is in the process of being created (or updated, if the subscription is
+            // reported as complete from an existing result set). Try unsubscribing again once it exists.
+            // The worker thread reads the slot's state, so it keeps the slot
+            // from being reused until it's done
+            std::weak_ptr<_impl::SubscriptionNotifier> weak_notifier = subscription.m_notifier;
+            std::weak_ptr<void> weak_lease = subscription.m_slot_lease;
+            enqueue_unregistration(subscription.m_result_sets, subscription.m_notifier, subscription.m_slot,
+                                   subscription.m_slot_lease,
+                                   [weak_notifier=std::move(weak_notifier), weak_lease=std::move(weak_lease),
+                                    slot=subscription.m_slot]() {
+                auto lease = weak_lease.lock();
+                auto notifier = weak_notifier.lock();
+                if (lease && notifier)
+                    notifier->finished_unsubscribing(slot);
             });
             return;
         }
@@ -709,7 +1485,7 @@ void unsubscribe(Subscription& subscription)
         case SubscriptionState::Error:
             // We encountered an error when creating the subscription. There's nothing to remove, so just
             // mark the subscription as removed.
-            subscription.m_notifier->finished_unsubscribing();
+            subscription.m_notifier->finished_unsubscribing(subscription.m_slot);
             break;
 
         case SubscriptionState::Invalidated:
@@ -717,8 +1493,7 @@ void unsubscribe(Subscription& subscription)
             break;
 
         case SubscriptionState::Pending:
-        case SubscriptionState::Complete:
-            // This should not be reachable as these states require the result set object to exist.
+            // This should not be reachable as this state requires the result set object to exist.
             REALM_ASSERT(false);
             break;
     }
@@ -736,20 +1511,19 @@ void unsubscribe(Object&& subscription)
     });
 }
 
-Subscription::Subscription(std::string name, std::string object_type, std::shared_ptr<Realm> realm)
+Subscription::Subscription(std::string name, std::string object_type, std::string query, std::shared_ptr<Realm> realm)
 : m_object_schema(realm->read_group(), result_sets_type_name)
+, m_name(std::move(name))
+, m_matches_property(std::string(object_type) + "_matches")
+, m_query(std::move(query))
+, m_notifier(_impl::SubscriptionNotifier::get(realm, m_notifier_lifetime))
+, m_slot(m_notifier->add_slot(m_name, m_slot_lease))
 {
-    // FIXME: Why can't I do this in the initializer list?
-    m_notifier = std::make_shared<Notifier>(realm);
-    _impl::RealmCoordinator::register_notifier(m_notifier);
-
-    auto matches_property = std::string(object_type) + "_matches";
-
     m_wrapper_created_at = timestamp_now();
     TableRef table = ObjectStore::table_for_object_type(realm->read_group(), result_sets_type_name);
     Query query = table->where();
-    query.equal(m_object_schema.property_for_name("name")->table_column, name);
-    query.equal(m_object_schema.property_for_name("matches_property")->table_column, matches_property);
+    query.equal(m_object_schema.property_for_name("name")->table_column, m_name);
+    query.equal(m_object_schema.property_for_name("matches_property")->table_column, m_matches_property);
     m_result_sets = Results(std::move(realm), std::move(query));
 }
 
@@ -757,23 +1531,77 @@ Subscription::~Subscription() = default;
 Subscription::Subscription(Subscription&&) = default;
 Subscription& Subscription::operator=(Subscription&&) = default;
 
+namespace {
+// The callback for a single Subscription, which is only called for changes
+// to its own slot in the shared notifier
+class SlotCallback {
+public:
+    SlotCallback(std::function<void()> fn, size_t slot, std::shared_ptr<void> slot_lease,
+                 std::shared_ptr<void> lifetime)
+    : m_fn(std::move(fn)), m_slot(slot), m_slot_lease(std::move(slot_lease)), m_lifetime(std::move(lifetime)) { }
+
+    void before(CollectionChangeSet const&) { }
+
+    void after(CollectionChangeSet const& c)
+    {
+        if (c.modifications.contains(m_slot) || !m_initial_delivered)
+            m_fn();
+        m_initial_delivered = true;
+    }
+
+    void error(std::exception_ptr)
+    {
+        m_fn();
+    }
+
+private:
+    std::function<void()> m_fn;
+    const size_t m_slot;
+    std::shared_ptr<void> m_slot_lease;
+    std::shared_ptr<void> m_lifetime;
+    bool m_initial_delivered = false;
+};
+} // unnamed namespace
+
 SubscriptionNotificationToken Subscription::add_notification_callback(std::function<void ()> callback)
 {
     auto callback_wrapper = std::make_shared<SubscriptionCallbackWrapper>(SubscriptionCallbackWrapper{callback, none});
-    auto result_sets_token = m_result_sets.add_notification_callback([this, callback_wrapper] (CollectionChangeSet, std::exception_ptr) {
+    m_notifier->mark_changed(m_slot);
+    auto token = m_notifier->add_callback(SlotCallback([this, callback_wrapper] {
         run_callback(*callback_wrapper);
-    });
-    NotificationToken registration_token(m_notifier, m_notifier->add_callback([this, callback_wrapper] (CollectionChangeSet, std::exception_ptr) {
-        run_callback(*callback_wrapper);
-    }));
+    }, m_slot, m_slot_lease, m_notifier_lifetime));
 
-    return SubscriptionNotificationToken{std::move(registration_token), std::move(result_sets_token)};
+    return SubscriptionNotificationToken{NotificationToken(m_notifier, token), {}};
+}
+
+util::Optional<Row> Subscription::result_set_row() const
+{
+    auto realm = m_result_sets.get_realm();
+    // The notifier's copy of the table is only usable if the Realm hasn't
+    // moved on from the version it was delivered for, including by writing
+    size_t row_ndx;
+    if (!realm->is_in_transaction()
+        && m_notifier->find_row(m_name, m_matches_property, *_impl::PartialSyncHelper::get_shared_group(*realm), row_ndx)) {
+        if (row_ndx == npos)
+            return util::none;
+        return Row(ObjectStore::table_for_object_type(realm->read_group(), result_sets_type_name)->get(row_ndx));
+    }
+    if (auto row = m_result_sets.first())
+        return Row(*row);
+    return util::none;
+}
+
+bool Subscription::has_cached_results(Row const& row) const
+{
+    auto status = row.get_int(m_object_schema.property_for_name(property_status)->table_column);
+    return status == static_cast<int64_t>(SubscriptionState::Complete)
+        && row.get_string(m_object_schema.property_for_name(property_query)->table_column) == m_query;
 }
 
 util::Optional<Object> Subscription::result_set_object() const
 {
-    if (m_notifier->state() == Notifier::Complete) {
-        if (auto row = m_result_sets.first())
+    if (m_notifier->state(m_slot) == _impl::SubscriptionNotifier::Complete) {
+        if (auto row = result_set_row())
             return Object(m_result_sets.get_realm(), m_object_schema, *row);
     }
 
@@ -783,10 +1611,8 @@ util::Optional<Object> Subscription::result_set_object() const
 void Subscription::run_callback(SubscriptionCallbackWrapper& callback_wrapper) {
     // Store reference to underlying subscription object the first time we encounter it.
     // Used to track if anyone is later deleting it.
-    if (!m_result_sets_object && m_result_sets.size() > 0) {
-        auto row = m_result_sets.first().value();
-        m_result_sets_object = util::Optional<Row>(row);
-    }
+    if (!m_result_sets_object)
+        m_result_sets_object = result_set_row();
 
     // Verify this is a state change we actually want to report to the user
     auto new_state = state();
@@ -820,7 +1646,7 @@ SubscriptionState Subscription::state() const
     //   reaches that state.
 
     // Errors take precedence over all other notifications
-    if (m_notifier->error())
+    if (m_notifier->error(m_slot))
         return SubscriptionState::Error;
 
     // In some cases the subscription already exists. In that case we just report the state of the __ResultSets object.
@@ -833,8 +1659,9 @@ SubscriptionState Subscription::state() const
             // If the `updated_at` property on an existing subscription wasn't updated after the wrapper was created,
             // it meant the query callback triggered before the async write completed. In that case we don't want
             // to return the state associated with the subscription before it was updated. So we override the state
-            // in the actual subscription and return the expected state after the update.
-            return partial_sync::SubscriptionState::Pending;
+            // in the actual subscription and return the expected state after the update, unless the update
+            // can't change the state (see below).
+            return has_cached_results(object->row()) ? SubscriptionState::Complete : SubscriptionState::Pending;
         } else {
             return state;
         }
@@ -842,12 +1669,20 @@ SubscriptionState Subscription::state() const
 
     // If no existing subscription exist, we can use the state of the Notifier as an indication of the underlying
     // progress.
-    switch (m_notifier->state()) {
-        case Notifier::Creating:
+    switch (m_notifier->state(m_slot)) {
+        case _impl::SubscriptionNotifier::Creating:
+            // Re-creating a subscription for the same query as an existing complete one (such as after a relaunch
+            // or to renew its time-to-live) leaves it complete, and its objects are already in the Realm, so report
+            // that straight away rather than after the async write. The write still happens and the server
+            // revalidates the subscription, and any change it makes to the state is reported as usual.
+            if (auto row = result_set_row()) {
+                if (has_cached_results(*row))
+                    return SubscriptionState::Complete;
+            }
             return SubscriptionState::Creating;
-        case Notifier::Removed:
+        case _impl::SubscriptionNotifier::Removed:
             return SubscriptionState::Invalidated;
-        case Notifier::Complete:
+        case _impl::SubscriptionNotifier::Complete:
             break;
     }
 
@@ -864,7 +1699,7 @@ SubscriptionState Subscription::state() const
 
 std::exception_ptr Subscription::error() const
 {
-    if (auto error = m_notifier->error())
+    if (auto error = m_notifier->error(m_slot))
         return error;
 
     if (auto object = result_set_object()) {
@@ -24,9 +24,12 @@
 
 #include <realm/util/optional.hpp>
 
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace realm {
 
@@ -34,6 +37,10 @@ class Group;
 class Object;
 class Realm;
 
+namespace _impl {
+class SubscriptionNotifier;
+}
+
 namespace partial_sync {
 static constexpr const char* result_sets_type_name = "__ResultSets";
 static constexpr const char* property_name = "name";
@@ -55,6 +62,10 @@ struct ExistingSubscriptionException : public std::runtime_error {
     ExistingSubscriptionException(const std::string& msg);
 };
 
+struct SubscriptionTimeoutException : public std::runtime_error {
+    SubscriptionTimeoutException(const std::string& msg);
+};
+
 struct QueryTypeMismatchException: public std::logic_error {
     QueryTypeMismatchException(const std::string& msg);
 };
@@ -63,6 +74,7 @@ enum class SubscriptionState : int8_t;
 
 struct SubscriptionNotificationToken {
     NotificationToken registration_token;
+    // Unused, as the registration token receives every change to the subscription
     NotificationToken result_sets_token;
 };
 
@@ -103,12 +115,20 @@ public:
     util::Optional<Object> result_set_object() const;
 
 private:
-    Subscription(std::string name, std::string object_type, std::shared_ptr<Realm>);
+    Subscription(std::string name, std::string object_type, std::string query, std::shared_ptr<Realm>);
 
     void error_occurred(std::exception_ptr);
     void run_callback(SubscriptionCallbackWrapper& callback_wrapper);
+    // Find the subscription's row in the __ResultSets table, if it exists
+    util::Optional<Row> result_set_row() const;
+    // Check if the row is a complete subscription for the same query, whose
+    // objects are therefore already in the Realm
+    bool has_cached_results(Row const& row) const;
 
     ObjectSchema m_object_schema;
+    std::string m_name;
+    std::string m_matches_property;
+    std::string m_query;
 
     mutable Results m_result_sets;
 
@@ -121,10 +141,16 @@ private:
     // unsubscriptions.
     util::Optional<Row> m_result_sets_object = none;
 
-    struct Notifier;
-    _impl::CollectionNotifier::Handle<Notifier> m_notifier;
+    // A reference which keeps the notifier shared by all of the Subscriptions
+    // in the Realm registered, the notifier itself, and this subscription's
+    // slot in it along with the reference which keeps it from being reused
+    std::shared_ptr<void> m_notifier_lifetime;
+    std::shared_ptr<_impl::SubscriptionNotifier> m_notifier;
+    std::shared_ptr<void> m_slot_lease;
+    size_t m_slot;
 
     friend Subscription subscribe(Results const&, SubscriptionOptions);
+    friend std::vector<Subscription> subscribe_all(std::vector<std::pair<Results, SubscriptionOptions>>);
     friend void unsubscribe(Subscription&);
 
 };
@@ -140,6 +166,17 @@ private:
 /// Query-based, or subscribing to an unsupported query, will throw an exception.
 Subscription subscribe(Results const&, SubscriptionOptions options);
 
+/// Create several Query-based subscriptions at once.
+///
+/// This behaves like calling `subscribe()` for each pair of `Results` and options,
+/// except that all of the subscriptions are written in a single write transaction
+/// and so are uploaded to the server together. All of the `Results` must belong to
+/// the same Realm. A runtime error in one subscription is reported only to that
+/// subscription's handle and does not stop the others from being created.
+///
+/// The returned `Subscription`s are in the same order as the input.
+std::vector<Subscription> subscribe_all(std::vector<std::pair<Results, SubscriptionOptions>> subscriptions);
+
 // Create a subscription from the query associated with the `Results`
 //
 // The subscription is created synchronously, so this method should only be called inside
@@ -160,6 +197,19 @@ Subscription subscribe(Results const&, SubscriptionOptions options);
 // deleted.
 Row subscribe_blocking(Results const&, util::Optional<std::string> name, util::Optional<int64_t> time_to_live_ms = none, bool update = false);
 
+/// Create a Query-based subscription and block the calling thread until the server has processed it.
+///
+/// This must be called outside of a write transaction. The subscription is written by the calling
+/// thread, which then sleeps until the session reports that it has uploaded the subscription and
+/// downloaded the server's response to it, and only refreshes the Realm to check the subscription's
+/// state each time that happens.
+///
+/// The Row that represents the Subscription in the __ResultSets table is returned once the subscription
+/// is `Complete`. If the server reports an error for the subscription, a `std::runtime_error` with the
+/// server's message is thrown, and if the subscription has not completed within `timeout` a
+/// `SubscriptionTimeoutException` is thrown. The subscription is left in place in both cases.
+Row subscribe_blocking(Results const&, SubscriptionOptions options, std::chrono::milliseconds timeout);
+
 /// Remove a partial sync subscription.
 ///
 /// The operation is performed asynchronously. Completion will be indicated by the
@@ -179,6 +229,10 @@ namespace _impl {
 
 void initialize_schema(Group&);
 
+// Set the minimum time between sweeps for expired subscriptions queued by
+// subscribe() for each file, which is 30 seconds by default. For testing.
+void set_expired_subscription_sweep_interval(std::chrono::milliseconds);
+
 } // namespace _impl
 } // namespace realm
 
@@ -45,6 +45,15 @@ std::string SyncConfig::partial_sync_identifier(const SyncUser& user)
     return ss.str();
 }
 
+std::string SyncConfig::server_url() const
+{
+    auto url = realm_url();
+    auto host_begin = url.find("://");
+    if (host_begin == std::string::npos)
+        return url;
+    return url.substr(0, url.find('/', host_begin + 3));
+}
+
 std::string SyncConfig::realm_url() const
 {
     REALM_ASSERT(reference_realm_url.length() > 0);
@@ -43,6 +43,20 @@ using ChangesetTransformer = sync::ClientHistory::ChangesetCooker;
 
 enum class SyncSessionStopPolicy;
 
+// How a session recovers when the server requires a client reset
+enum class SyncClientResetMode {
+    // Mark the local file to be backed up and deleted, and report the error to
+    // the binding, which must close the Realm so that it can be downloaded
+    // again from scratch.
+    DiscardLocalRealm,
+    // Restart the session with sync's in-place client reset, which keeps the
+    // local file as the starting point, fetches the server's current state
+    // and reconciles the two, so that only the difference needs to be
+    // downloaded. The error isn't reported to the binding unless the reset
+    // itself fails, in which case the session falls back to DiscardLocalRealm.
+    ResetInPlace,
+};
+
 struct SyncConfig;
 using SyncBindSessionHandler = void(const std::string&,          // path on disk of the Realm file.
                                     const SyncConfig&,           // the sync configuration object.
@@ -141,10 +155,21 @@ struct SyncConfig {
     // a client reset
     util::Optional<std::string> recovery_directory = none;
 
+    // The order in which this session is started relative to other sessions
+    // when SyncManager::set_max_starting_sessions() is limiting how many can
+    // start at once. Higher priorities are started first.
+    int start_priority = 0;
+
+    SyncClientResetMode client_reset_mode = SyncClientResetMode::DiscardLocalRealm;
+
     // The URL that will be used when connecting to the object server.
     // This will differ from `reference_realm_url` when partial sync is being used.
     std::string realm_url() const;
 
+    // The scheme, host and port of `realm_url()`, which identify the server
+    // the session connects to.
+    std::string server_url() const;
+
     SyncConfig(std::shared_ptr<SyncUser> user, std::string reference_realm_url)
     : user(std::move(user))
     , reference_realm_url(std::move(reference_realm_url))
@@ -21,8 +21,20 @@
 #include "sync/impl/sync_client.hpp"
 #include "sync/impl/sync_file.hpp"
 #include "sync/impl/sync_metadata.hpp"
+#include "sync/impl/work_queue.hpp"
 #include "sync/sync_session.hpp"
 #include "sync/sync_user.hpp"
+#if REALM_PLATFORM_APPLE
+#include "impl/apple/keychain_helper.hpp"
+#endif
+
+#include <realm/util/basic_system_errors.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <random>
+#include <thread>
 
 using namespace realm;
 using namespace realm::_impl;
@@ -41,7 +53,8 @@ void SyncManager::configure(const std::string& base_file_path,
                                         MetadataMode metadata_mode,
                                         const std::string& user_agent_binding_info,
                                         util::Optional<std::vector<char>> custom_encryption_key,
-                                        bool reset_metadata_on_error)
+                                        bool reset_metadata_on_error,
+                                        bool run_file_actions_in_background)
 {
     struct UserCreationData {
         std::string identity;
@@ -67,6 +80,12 @@ void SyncManager::configure(const std::string& base_file_path,
         if (m_metadata_manager) {
             return;
         }
+#if REALM_PLATFORM_APPLE
+        // Read the key from the keychain in parallel with setting up the
+        // metadata Realm. It stays cached for reopening the metadata Realm.
+        if (metadata_mode == MetadataMode::Encryption && !custom_encryption_key)
+            keychain::prefetch_metadata_realm_encryption_key(util::File::exists(m_file_manager->metadata_path()));
+#endif
         switch (metadata_mode) {
             case MetadataMode::NoEncryption:
                 m_metadata_manager = std::make_unique<SyncMetadataManager>(m_file_manager->metadata_path(),
@@ -94,18 +113,9 @@ void SyncManager::configure(const std::string& base_file_path,
         REALM_ASSERT(m_metadata_manager);
         m_client_uuid = m_metadata_manager->client_uuid();
 
-        // Perform any necessary file actions.
-        std::vector<SyncFileActionMetadata> completed_actions;
-        SyncFileActionMetadataResults file_actions = m_metadata_manager->all_pending_actions();
-        for (size_t i = 0; i < file_actions.size(); i++) {
-            auto file_action = file_actions.get(i);
-            if (run_file_action(file_action)) {
-                completed_actions.emplace_back(std::move(file_action));
-            }
-        }
-        for (auto& action : completed_actions) {
-            action.remove();
-        }
+        // Perform any necessary file actions and delete the data of any users marked for death.
+        queue_startup_file_actions(*m_metadata_manager);
+
         // Load persisted users into the users map.
         SyncUserMetadataResults users = m_metadata_manager->all_unmarked_users();
         for (size_t i = 0; i < users.size(); i++) {
@@ -125,44 +135,93 @@ void SyncManager::configure(const std::string& base_file_path,
                 users_to_add.emplace_back(std::move(data));
             }
         }
-        // Delete any users marked for death.
-        std::vector<SyncUserMetadata> dead_users;
-        SyncUserMetadataResults users_to_remove = m_metadata_manager->all_users_marked_for_removal();
-        dead_users.reserve(users_to_remove.size());
-        for (size_t i = 0; i < users_to_remove.size(); i++) {
-            auto user = users_to_remove.get(i);
-            // FIXME: delete user data in a different way? (This deletes a logged-out user's data as soon as the app
-            // launches again, which might not be how some apps want to treat their data.)
-            try {
-                m_file_manager->remove_user_directory(user.local_uuid());
-                dead_users.emplace_back(std::move(user));
-            } catch (util::File::AccessError const&) {
-                continue;
-            }
-        }
+    }
+    if (!run_file_actions_in_background)
+        m_file_action_queue.wait_for_all();
+
+    for (auto& user_data : users_to_add) {
+        auto& identity = user_data.identity;
+        auto& server_url = user_data.server_url;
+        auto user = std::make_shared<SyncUser>(user_data.user_token, identity, server_url);
+        user->set_is_admin(user_data.is_admin);
+        SyncUserIdentifier identifier{identity, server_url};
+        m_users.with_shard(identifier, [&](auto& users) {
+            users.insert({ std::move(identifier), std::move(user) });
+        });
+    }
+}
+
+void SyncManager::queue_startup_file_actions(SyncMetadataManager const& metadata_manager)
+{
+    // Copy the metadata out of the results up front, as the results update as
+    // the actions complete and are removed.
+    std::vector<SyncFileActionMetadata> file_actions;
+    SyncFileActionMetadataResults file_action_results = metadata_manager.all_pending_actions();
+    file_actions.reserve(file_action_results.size());
+    for (size_t i = 0; i < file_action_results.size(); i++)
+        file_actions.push_back(file_action_results.get(i));
+
+    std::vector<SyncUserMetadata> dead_users;
+    SyncUserMetadataResults users_to_remove = metadata_manager.all_users_marked_for_removal();
+    dead_users.reserve(users_to_remove.size());
+    for (size_t i = 0; i < users_to_remove.size(); i++)
+        dead_users.push_back(users_to_remove.get(i));
+
+    SyncFileManager file_manager = *m_file_manager;
+    auto queue_user_removals = [this, file_manager, dead_users = std::move(dead_users)]() mutable {
         for (auto& user : dead_users) {
-            user.remove();
+            auto local_uuid = user.local_uuid();
+            m_file_action_queue.enqueue(local_uuid, [file_manager, user, local_uuid]() mutable {
+                // FIXME: delete user data in a different way? (This deletes a logged-out user's data as soon as the app
+                // launches again, which might not be how some apps want to treat their data.)
+                try {
+                    file_manager.remove_user_directory(local_uuid);
+                    user.remove();
+                } catch (util::File::AccessError const&) {
+                }
+            });
         }
+    };
+    if (file_actions.empty()) {
+        queue_user_removals();
+        return;
     }
-    {
-        std::lock_guard<std::mutex> lock(m_user_mutex);
-        for (auto& user_data : users_to_add) {
-            auto& identity = user_data.identity;
-            auto& server_url = user_data.server_url;
-            auto user = std::make_shared<SyncUser>(user_data.user_token, identity, server_url);
-            user->set_is_admin(user_data.is_admin);
-            m_users.insert({ {identity, server_url}, std::move(user) });
-        }
+
+    // The users' directories may contain the Realms which the file actions
+    // operate on, so they're only removed once all of the actions are done.
+    struct Remaining {
+        std::atomic<size_t> count;
+        std::function<void()> then;
+    };
+    auto remaining = std::make_shared<Remaining>();
+    remaining->count = file_actions.size();
+    remaining->then = std::move(queue_user_removals);
+    for (auto& action : file_actions) {
+        auto path = action.original_name();
+        m_file_action_queue.enqueue(std::move(path), [file_manager, action, remaining]() mutable {
+            try {
+                if (run_file_action(file_manager, action))
+                    action.remove();
+            }
+            catch (...) {
+                // The action stays pending and will be retried on the next launch
+            }
+            if (--remaining->count == 0)
+                remaining->then();
+        });
     }
 }
 
 bool SyncManager::immediately_run_file_actions(const std::string& realm_path)
 {
+    m_file_action_queue.wait_for(realm_path);
+
+    std::lock_guard<std::mutex> lock(m_file_system_mutex);
     if (!m_metadata_manager) {
         return false;
     }
     if (auto metadata = m_metadata_manager->get_file_action_metadata(realm_path)) {
-        if (run_file_action(*metadata)) {
+        if (run_file_action(*m_file_manager, *metadata)) {
             metadata->remove();
             return true;
         }
@@ -170,13 +229,46 @@ bool SyncManager::immediately_run_file_actions(const std::string& realm_path)
     return false;
 }
 
-// Perform a file action. Returns whether or not the file action can be removed.
-bool SyncManager::run_file_action(const SyncFileActionMetadata& md)
+void SyncManager::run_file_actions_async(const std::string& realm_path,
+                                         std::function<void(bool, std::exception_ptr)> completion)
+{
+    std::shared_ptr<SyncFileManager> file_manager;
+    util::Optional<SyncFileActionMetadata> metadata;
+    {
+        std::lock_guard<std::mutex> lock(m_file_system_mutex);
+        if (m_metadata_manager) {
+            file_manager = std::make_shared<SyncFileManager>(*m_file_manager);
+            metadata = m_metadata_manager->get_file_action_metadata(realm_path);
+        }
+    }
+
+    m_file_action_queue.enqueue(realm_path, [=]() mutable {
+        bool ran = false;
+        try {
+            if (metadata && run_file_action(*file_manager, *metadata)) {
+                metadata->remove();
+                ran = true;
+            }
+        }
+        catch (...) {
+            completion(false, std::current_exception());
+            return;
+        }
+        completion(ran, nullptr);
+    });
+}
+
+void SyncManager::wait_for_file_actions()
+{
+    m_file_action_queue.wait_for_all();
+}
+
+bool SyncManager::run_file_action(SyncFileManager const& file_manager, const SyncFileActionMetadata& md)
 {
     switch (md.action()) {
         case SyncFileActionMetadata::Action::DeleteRealm:
             // Delete all the files for the given Realm.
-            m_file_manager->remove_realm(md.original_name());
+            file_manager.remove_realm(md.original_name());
             return true;
         case SyncFileActionMetadata::Action::BackUpThenDeleteRealm:
             // Copy the primary Realm file to the recovery dir, and then delete the Realm.
@@ -186,9 +278,9 @@ bool SyncManager::run_file_action(const SyncFileActionMetadata& md)
                 // The Realm file doesn't exist anymore.
                 return true;
             }
-            if (new_name && !util::File::exists(*new_name) && m_file_manager->copy_realm_file(original_name, *new_name)) {
+            if (new_name && !util::File::exists(*new_name) && file_manager.copy_realm_file(original_name, *new_name)) {
                 // We successfully copied the Realm file to the recovery directory.
-                m_file_manager->remove_realm(original_name);
+                file_manager.remove_realm(original_name);
                 return true;
             }
             return false;
@@ -198,15 +290,20 @@ bool SyncManager::run_file_action(const SyncFileActionMetadata& md)
 
 void SyncManager::reset_for_testing()
 {
+    m_file_action_queue.wait_for_all();
+
     std::lock_guard<std::mutex> lock(m_file_system_mutex);
     m_file_manager = nullptr;
     m_metadata_manager = nullptr;
     m_client_uuid = util::none;
+#if REALM_PLATFORM_APPLE
+    keychain::clear_cached_metadata_realm_encryption_key();
+#endif
 
     {
         // Destroy all the users.
-        std::lock_guard<std::mutex> lock(m_user_mutex);
         m_users.clear();
+        std::lock_guard<std::mutex> lock(m_user_mutex);
         m_admin_token_users.clear();
     }
     {
@@ -217,10 +314,9 @@ void SyncManager::reset_for_testing()
             m_sync_client->stop();
 
         {
-            std::lock_guard<std::mutex> lock(m_session_mutex);
             // Callers of `SyncManager::reset_for_testing` should ensure there are no existing sessions
             // prior to calling `reset_for_testing`.
-            bool no_sessions = !do_has_existing_sessions();
+            bool no_sessions = !has_existing_sessions();
             REALM_ASSERT_RELEASE(no_sessions);
 
             // Destroy any inactive sessions.
@@ -234,6 +330,32 @@ void SyncManager::reset_for_testing()
         // Destroy the client now that we have no remaining sessions.
         m_sync_client = nullptr;
 
+        {
+            std::lock_guard<std::mutex> lock(m_session_start_mutex);
+            m_max_starting_sessions = 0;
+            m_session_start_timeout = {};
+            m_start_slots.clear();
+            m_session_start_queue.clear();
+        }
+        m_timers.cancel_all();
+
+        {
+            std::lock_guard<std::mutex> lock(m_reconnect_mutex);
+            m_reconnect_batch_size = 0;
+            m_reconnect_batch_interval = std::chrono::milliseconds::zero();
+            m_reconnect_max_jitter = std::chrono::milliseconds::zero();
+            // Any reconnect batches still pending were cancelled along with
+            // the rest of the timers above
+            m_reconnect_batches.clear();
+            ++m_reconnect_generation;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_connection_mutex);
+            m_auto_multiplex_threshold = 0;
+            m_server_connections.clear();
+        }
+
         // Reset even more state.
         // NOTE: these should always match the defaults.
         m_log_level = util::Logger::Level::info;
@@ -274,12 +396,91 @@ void SyncManager::set_user_agent(std::string user_agent)
 
 void SyncManager::reconnect()
 {
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    for (auto& it : m_sessions) {
-        it.second->handle_reconnect();
+    struct Candidate {
+        bool in_use;
+        int priority;
+        std::shared_ptr<SyncSession> session;
+    };
+    std::vector<Candidate> candidates;
+    m_sessions.for_each_shard([&](auto& sessions) {
+        for (auto& it : sessions)
+            candidates.push_back({false, it.second->config().start_priority, it.second});
+    });
+    // Checked outside of the shard locks as it takes the session's lock
+    for (auto& candidate : candidates)
+        candidate.in_use = candidate.session->existing_external_reference() != nullptr;
+    std::stable_sort(candidates.begin(), candidates.end(), [](auto const& a, auto const& b) {
+        if (a.in_use != b.in_use)
+            return a.in_use;
+        return a.priority > b.priority;
+    });
+
+    size_t batch_size;
+    std::chrono::milliseconds batch_interval, max_jitter;
+    uint64_t generation;
+    std::vector<util::TimerQueue::Token> superseded;
+    {
+        std::lock_guard<std::mutex> lock(m_reconnect_mutex);
+        batch_size = m_reconnect_batch_size;
+        batch_interval = m_reconnect_batch_interval;
+        max_jitter = m_reconnect_max_jitter;
+        generation = ++m_reconnect_generation;
+        superseded = std::move(m_reconnect_batches);
+        m_reconnect_batches.clear();
+    }
+    // This call covers all of the sessions which the batches still pending
+    // from a previous one were waiting to handle
+    for (auto token : superseded)
+        m_timers.cancel(token);
+
+    if (batch_size == 0 || batch_size > candidates.size())
+        batch_size = candidates.size();
+    for (size_t i = 0; i < batch_size; ++i)
+        candidates[i].session->handle_reconnect();
+    if (batch_size == candidates.size())
+        return;
+
+    // Don't keep the remaining sessions alive just to reconnect them
+    auto remaining = std::make_shared<std::vector<std::weak_ptr<SyncSession>>>();
+    remaining->reserve(candidates.size() - batch_size);
+    for (size_t i = batch_size; i < candidates.size(); ++i)
+        remaining->push_back(std::move(candidates[i].session));
+
+    std::mt19937 rng{std::random_device{}()};
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0, max_jitter.count());
+    auto scheduled = util::TimerQueue::Clock::now();
+    std::lock_guard<std::mutex> lock(m_reconnect_mutex);
+    // A later call has already superseded this one
+    if (m_reconnect_generation != generation)
+        return;
+    for (size_t begin = 0; begin < remaining->size(); begin += batch_size) {
+        scheduled += batch_interval;
+        size_t end = std::min(begin + batch_size, remaining->size());
+        m_reconnect_batches.push_back(m_timers.schedule(scheduled + std::chrono::milliseconds(jitter(rng)),
+                                                        [this, generation, remaining, begin, end] {
+            {
+                // Cancelling the batch can race with it starting to run
+                std::lock_guard<std::mutex> lock(m_reconnect_mutex);
+                if (m_reconnect_generation != generation)
+                    return;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                if (auto session = (*remaining)[i].lock())
+                    session->handle_reconnect();
+            }
+        }));
     }
 }
 
+void SyncManager::set_reconnect_pacing(size_t batch_size, std::chrono::milliseconds batch_interval,
+                                       std::chrono::milliseconds max_jitter)
+{
+    std::lock_guard<std::mutex> lock(m_reconnect_mutex);
+    m_reconnect_batch_size = batch_size;
+    m_reconnect_batch_interval = batch_interval;
+    m_reconnect_max_jitter = max_jitter;
+}
+
 util::Logger::Level SyncManager::log_level() const noexcept
 {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -298,25 +499,26 @@ bool SyncManager::perform_metadata_update(std::function<void(const SyncMetadataM
 
 std::shared_ptr<SyncUser> SyncManager::get_user(const SyncUserIdentifier& identifier, std::string refresh_token)
 {
-    std::lock_guard<std::mutex> lock(m_user_mutex);
-    auto it = m_users.find(identifier);
-    if (it == m_users.end()) {
-        // No existing user.
-        auto new_user = std::make_shared<SyncUser>(std::move(refresh_token),
-                                                   identifier.user_id,
-                                                   identifier.auth_server_url,
-                                                   none,
-                                                   SyncUser::TokenType::Normal);
-        m_users.insert({ identifier, new_user });
-        return new_user;
-    } else {
-        auto user = it->second;
-        if (user->state() == SyncUser::State::Error) {
-            return nullptr;
+    return m_users.with_shard(identifier, [&](auto& users) -> std::shared_ptr<SyncUser> {
+        auto it = users.find(identifier);
+        if (it == users.end()) {
+            // No existing user.
+            auto new_user = std::make_shared<SyncUser>(std::move(refresh_token),
+                                                       identifier.user_id,
+                                                       identifier.auth_server_url,
+                                                       none,
+                                                       SyncUser::TokenType::Normal);
+            users.insert({ identifier, new_user });
+            return new_user;
+        } else {
+            auto user = it->second;
+            if (user->state() == SyncUser::State::Error) {
+                return nullptr;
+            }
+            user->update_refresh_token(std::move(refresh_token));
+            return user;
         }
-        user->update_refresh_token(std::move(refresh_token));
-        return user;
-    }
+    });
 }
 
 std::shared_ptr<SyncUser> SyncManager::get_admin_token_user_from_identity(const std::string& identity,
@@ -375,15 +577,16 @@ std::shared_ptr<SyncUser> SyncManager::get_admin_token_user(const std::string& s
 
 std::vector<std::shared_ptr<SyncUser>> SyncManager::all_logged_in_users() const
 {
-    std::lock_guard<std::mutex> lock(m_user_mutex);
     std::vector<std::shared_ptr<SyncUser>> users;
-    users.reserve(m_users.size() + m_admin_token_users.size());
-    for (auto& it : m_users) {
-        auto user = it.second;
-        if (user->state() == SyncUser::State::Active) {
-            users.emplace_back(std::move(user));
+    m_users.for_each_shard([&](auto& shard) {
+        for (auto& it : shard) {
+            auto user = it.second;
+            if (user->state() == SyncUser::State::Active) {
+                users.emplace_back(std::move(user));
+            }
         }
-    }
+    });
+    std::lock_guard<std::mutex> lock(m_user_mutex);
     for (auto& it : m_admin_token_users) {
         users.emplace_back(std::move(it.second));
     }
@@ -392,28 +595,33 @@ std::vector<std::shared_ptr<SyncUser>> SyncManager::all_logged_in_users() const
 
 std::shared_ptr<SyncUser> SyncManager::get_current_user() const
 {
-    std::lock_guard<std::mutex> lock(m_user_mutex);
-
-    auto is_active_user = [](auto& el) { return el.second->state() == SyncUser::State::Active; };
-    auto it = std::find_if(m_users.begin(), m_users.end(), is_active_user);
-    if (it == m_users.end())
-        return nullptr;
-
-    if (std::find_if(std::next(it), m_users.end(), is_active_user) != m_users.end())
+    std::shared_ptr<SyncUser> current_user;
+    bool multiple_users = m_users.any_shard([&](auto& users) {
+        for (auto& it : users) {
+            if (it.second->state() != SyncUser::State::Active)
+                continue;
+            if (current_user)
+                return true;
+            current_user = it.second;
+        }
+        return false;
+    });
+    if (multiple_users)
         throw std::logic_error("Current user is not valid if more that one valid, logged-in user exists.");
 
-    return it->second;
+    return current_user;
 }
 
 std::shared_ptr<SyncUser> SyncManager::get_existing_logged_in_user(const SyncUserIdentifier& identifier) const
 {
-    std::lock_guard<std::mutex> lock(m_user_mutex);
-    auto it = m_users.find(identifier);
-    if (it == m_users.end())
-        return nullptr;
+    return m_users.with_shard(identifier, [&](auto& users) -> std::shared_ptr<SyncUser> {
+        auto it = users.find(identifier);
+        if (it == users.end())
+            return nullptr;
 
-    auto user = it->second;
-    return user->state() == SyncUser::State::Active ? user : nullptr;
+        auto user = it->second;
+        return user->state() == SyncUser::State::Active ? user : nullptr;
+    });
 }
 
 std::string SyncManager::path_for_realm(const SyncUser& user, const std::string& raw_realm_url) const
@@ -432,78 +640,281 @@ std::string SyncManager::recovery_directory_path(util::Optional<std::string> con
 
 std::shared_ptr<SyncSession> SyncManager::get_existing_active_session(const std::string& path) const
 {
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    if (auto session = get_existing_session_locked(path)) {
-        if (auto external_reference = session->existing_external_reference())
-            return external_reference;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<SyncSession> SyncManager::get_existing_session_locked(const std::string& path) const
-{
-    REALM_ASSERT(!m_session_mutex.try_lock());
-    auto it = m_sessions.find(path);
-    return it == m_sessions.end() ? nullptr : it->second;
+    return m_sessions.with_shard(path, [&](auto& sessions) -> std::shared_ptr<SyncSession> {
+        auto it = sessions.find(path);
+        if (it != sessions.end()) {
+            if (auto external_reference = it->second->existing_external_reference())
+                return external_reference;
+        }
+        return nullptr;
+    });
 }
 
 std::shared_ptr<SyncSession> SyncManager::get_existing_session(const std::string& path) const
 {
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    if (auto session = get_existing_session_locked(path))
-        return session->external_reference();
+    return m_sessions.with_shard(path, [&](auto& sessions) -> std::shared_ptr<SyncSession> {
+        auto it = sessions.find(path);
+        if (it != sessions.end())
+            return it->second->external_reference();
 
-    return nullptr;
+        return nullptr;
+    });
 }
 
 std::shared_ptr<SyncSession> SyncManager::get_session(const std::string& path, const SyncConfig& sync_config, bool force_client_reset)
 {
     auto& client = get_sync_client(); // Throws
 
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    if (auto session = get_existing_session_locked(path)) {
-        sync_config.user->register_session(session);
-        return session->external_reference();
-    }
+    // Don't let the session open a file which a queued file action is about to delete or move
+    m_file_action_queue.wait_for(path);
+
+    return m_sessions.with_shard(path, [&](auto& sessions) {
+        auto it = sessions.find(path);
+        if (it != sessions.end()) {
+            sync_config.user->register_session(it->second);
+            return it->second->external_reference();
+        }
 
-    auto shared_session = SyncSession::create(client, path, sync_config, force_client_reset);
-    m_sessions[path] = shared_session;
+        auto shared_session = SyncSession::create(client, path, sync_config, force_client_reset);
+        sessions[path] = shared_session;
 
-    // Create the external reference immediately to ensure that the session will become
-    // inactive if an exception is thrown in the following code.
-    auto external_reference = shared_session->external_reference();
+        // Create the external reference immediately to ensure that the session will become
+        // inactive if an exception is thrown in the following code.
+        auto external_reference = shared_session->external_reference();
 
-    sync_config.user->register_session(std::move(shared_session));
+        sync_config.user->register_session(std::move(shared_session));
 
-    return external_reference;
+        return external_reference;
+    });
 }
 
 
 bool SyncManager::has_existing_sessions()
 {
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    return do_has_existing_sessions();
+    return m_sessions.any_shard([](auto& sessions) {
+        return std::any_of(sessions.begin(), sessions.end(), [](auto& element){
+            return element.second->existing_external_reference();
+        });
+    });
 }
 
-bool SyncManager::do_has_existing_sessions(){
-    return std::any_of(m_sessions.begin(), m_sessions.end(), [](auto& element){
-        return element.second->existing_external_reference();
+std::vector<std::shared_ptr<SyncSession>> SyncManager::get_all_sessions() const
+{
+    std::vector<std::shared_ptr<SyncSession>> all_sessions;
+    m_sessions.for_each_shard([&](auto& sessions) {
+        for (auto& it : sessions) {
+            if (auto session = it.second->existing_external_reference())
+                all_sessions.push_back(std::move(session));
+        }
     });
+    return all_sessions;
 }
 
-void SyncManager::unregister_session(const std::string& path)
+void SyncManager::wait_for_upload_completion(std::vector<std::shared_ptr<SyncSession>> sessions,
+                                             std::chrono::milliseconds timeout,
+                                             std::function<SessionCompletionCallback> callback)
+{
+    wait_for_completion(std::move(sessions), true, timeout, std::move(callback));
+}
+
+void SyncManager::wait_for_download_completion(std::vector<std::shared_ptr<SyncSession>> sessions,
+                                               std::chrono::milliseconds timeout,
+                                               std::function<SessionCompletionCallback> callback)
+{
+    wait_for_completion(std::move(sessions), false, timeout, std::move(callback));
+}
+
+namespace {
+// The state shared between the completion handlers registered with each of
+// the sessions and the timeout for one wait_for_completion() call. The
+// sessions own their handlers and so this, so it must only refer to them
+// weakly or a session which never completes would never be freed.
+struct CompletionBarrier {
+    std::mutex mutex;
+    std::vector<std::weak_ptr<SyncSession>> sessions;
+    std::vector<std::error_code> errors;
+    std::vector<bool> completed;
+    size_t remaining;
+    bool done = false;
+    std::function<SyncManager::SessionCompletionCallback> callback;
+
+    // Record the result for session `index`, and if that was the last one
+    // return the callback to be called once the lock is released
+    std::function<void()> complete(std::unique_lock<std::mutex>& lock, size_t index, std::error_code ec)
+    {
+        REALM_ASSERT(lock.owns_lock());
+        // Sessions may call their completion handlers more than once
+        if (done || completed[index])
+            return nullptr;
+        completed[index] = true;
+        errors[index] = ec;
+        if (--remaining > 0)
+            return nullptr;
+        return finish();
+    }
+
+    std::function<void()> finish()
+    {
+        done = true;
+        std::vector<SyncManager::SessionCompletion> results;
+        results.reserve(sessions.size());
+        for (size_t i = 0; i < sessions.size(); ++i)
+            results.push_back({sessions[i].lock(), errors[i]});
+        sessions.clear();
+        return [callback = std::move(callback), results = std::move(results)]() mutable {
+            callback(std::move(results));
+        };
+    }
+};
+} // anonymous namespace
+
+void SyncManager::wait_for_completion(std::vector<std::shared_ptr<SyncSession>> sessions, bool upload,
+                                      std::chrono::milliseconds timeout,
+                                      std::function<SessionCompletionCallback> callback)
 {
-    std::lock_guard<std::mutex> lock(m_session_mutex);
-    auto it = m_sessions.find(path);
-    REALM_ASSERT(it != m_sessions.end());
+    auto barrier = std::make_shared<CompletionBarrier>();
+    barrier->sessions.assign(sessions.begin(), sessions.end());
+    barrier->errors.resize(sessions.size());
+    barrier->completed.resize(sessions.size());
+    barrier->remaining = sessions.size();
+    barrier->callback = std::move(callback);
+
+    if (sessions.empty()) {
+        barrier->finish()();
+        return;
+    }
 
-    // If the session has an active external reference, leave it be. This will happen if the session
-    // moves to an inactive state while still externally reference, for instance, as a result of
-    // the session's user being logged out.
-    if (it->second->existing_external_reference())
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        auto handler = [barrier, i](std::error_code ec) {
+            std::unique_lock<std::mutex> lock(barrier->mutex);
+            if (auto finish = barrier->complete(lock, i, ec)) {
+                lock.unlock();
+                finish();
+            }
+        };
+        bool registered = upload ? sessions[i]->wait_for_upload_completion(handler)
+                                 : sessions[i]->wait_for_download_completion(handler);
+        if (!registered)
+            handler(util::error::operation_aborted);
+    }
+
+    if (timeout == std::chrono::milliseconds::zero())
         return;
 
-    m_sessions.erase(path);
+    // A single timer handles the timeout for all of the sessions
+    m_timers.schedule_after(timeout, [barrier] {
+        std::unique_lock<std::mutex> lock(barrier->mutex);
+        if (barrier->done)
+            return;
+        for (size_t i = 0; i < barrier->errors.size(); ++i) {
+            if (!barrier->completed[i])
+                barrier->errors[i] = make_error_code(std::errc::timed_out);
+        }
+        auto finish = barrier->finish();
+        lock.unlock();
+        finish();
+    });
+}
+
+void SyncManager::unregister_session(const std::string& path)
+{
+    m_sessions.with_shard(path, [&](auto& sessions) {
+        auto it = sessions.find(path);
+        REALM_ASSERT(it != sessions.end());
+
+        // If the session has an active external reference, leave it be. This will happen if the session
+        // moves to an inactive state while still externally reference, for instance, as a result of
+        // the session's user being logged out.
+        if (it->second->existing_external_reference())
+            return;
+
+        sessions.erase(it);
+    });
+}
+
+void SyncManager::set_max_starting_sessions(size_t limit, std::chrono::milliseconds timeout)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_session_start_mutex);
+        m_max_starting_sessions = limit;
+        m_session_start_timeout = timeout;
+    }
+    // Raising the limit may have freed up slots for queued sessions
+    start_queued_sessions();
+}
+
+uint64_t SyncManager::take_start_slot()
+{
+    auto slot = ++m_next_start_slot;
+    util::TimerQueue::Token timer = 0;
+    if (m_session_start_timeout.count() > 0) {
+        // The session keeps waiting for its token, but stops holding up the
+        // sessions queued behind it
+        timer = m_timers.schedule_after(m_session_start_timeout, [this, slot] { release_start_slot(slot); });
+    }
+    m_start_slots.emplace(slot, timer);
+    return slot;
+}
+
+bool SyncManager::erase_start_slot(uint64_t slot)
+{
+    auto it = m_start_slots.find(slot);
+    if (it == m_start_slots.end())
+        return false;
+    if (it->second)
+        m_timers.cancel(it->second);
+    m_start_slots.erase(it);
+    return true;
+}
+
+uint64_t SyncManager::try_start_session(std::shared_ptr<SyncSession> const& session, int priority)
+{
+    std::lock_guard<std::mutex> lock(m_session_start_mutex);
+    if (m_max_starting_sessions == 0 || m_start_slots.size() < m_max_starting_sessions)
+        return take_start_slot();
+
+    m_session_start_queue.push_back({priority, m_next_session_start_sequence++, session});
+    std::push_heap(m_session_start_queue.begin(), m_session_start_queue.end());
+    return 0;
+}
+
+void SyncManager::release_start_slot(uint64_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_session_start_mutex);
+        if (!erase_start_slot(slot))
+            return;
+    }
+    start_queued_sessions();
+}
+
+void SyncManager::start_queued_sessions()
+{
+    while (true) {
+        std::shared_ptr<SyncSession> session;
+        uint64_t slot;
+        {
+            std::lock_guard<std::mutex> lock(m_session_start_mutex);
+            if (m_max_starting_sessions != 0 && m_start_slots.size() >= m_max_starting_sessions)
+                return;
+            if (m_session_start_queue.empty())
+                return;
+            std::pop_heap(m_session_start_queue.begin(), m_session_start_queue.end());
+            session = m_session_start_queue.back().session.lock();
+            m_session_start_queue.pop_back();
+            if (!session)
+                continue;
+            slot = take_start_slot();
+        }
+
+        // The session is started without holding the lock as it calls the
+        // binding's bind handler. If it was closed or revived again while
+        // queued then it no longer needs the slot.
+        if (!session->start_queued(slot)) {
+            std::lock_guard<std::mutex> lock(m_session_start_mutex);
+            erase_start_slot(slot);
+        }
+    }
 }
 
 void SyncManager::enable_session_multiplexing()
@@ -518,6 +929,127 @@ void SyncManager::enable_session_multiplexing()
     m_multiplex_sessions = true;
 }
 
+void SyncManager::enable_automatic_session_multiplexing(size_t threshold)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_sync_client && !m_multiplex_sessions)
+            throw std::logic_error("Cannot enable session multiplexing after creating the sync client");
+        m_multiplex_sessions = true;
+    }
+    std::lock_guard<std::mutex> lock(m_connection_mutex);
+    m_auto_multiplex_threshold = threshold;
+}
+
+std::string SyncManager::open_server_connection(std::string const& server_url, std::string const& path,
+                                                std::string const& multiplex_identity)
+{
+    std::lock_guard<std::mutex> lock(m_connection_mutex);
+    auto& server = m_server_connections[server_url];
+    ++server.session_count;
+
+    // Sessions under the threshold are given a unique identity so that they
+    // don't share a connection
+    std::string identity = multiplex_identity;
+    if (identity.empty() && m_auto_multiplex_threshold && server.session_count <= m_auto_multiplex_threshold)
+        identity = path;
+    ++server.sessions_per_identity[identity];
+    return identity;
+}
+
+void SyncManager::close_server_connection(std::string const& server_url, std::string const& multiplex_identity)
+{
+    std::lock_guard<std::mutex> lock(m_connection_mutex);
+    // The tracking state is discarded by reset_for_testing()
+    auto it = m_server_connections.find(server_url);
+    if (it == m_server_connections.end())
+        return;
+    auto& server = it->second;
+    auto identity = server.sessions_per_identity.find(multiplex_identity);
+    if (identity != server.sessions_per_identity.end() && --identity->second == 0)
+        server.sessions_per_identity.erase(identity);
+    if (--server.session_count == 0)
+        m_server_connections.erase(it);
+}
+
+std::vector<SyncManager::ServerConnectionStats> SyncManager::connection_stats() const
+{
+    bool multiplexing;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        multiplexing = m_multiplex_sessions;
+    }
+
+    std::vector<ServerConnectionStats> stats;
+    std::unordered_map<std::string, size_t> index;
+    {
+        std::lock_guard<std::mutex> lock(m_connection_mutex);
+        for (auto& server : m_server_connections) {
+            index[server.first] = stats.size();
+            size_t connections = multiplexing ? server.second.sessions_per_identity.size() : server.second.session_count;
+            stats.push_back({server.first, server.second.session_count, connections, 0, 0, 0});
+        }
+    }
+
+    m_sessions.for_each_shard([&](auto& sessions) {
+        for (auto& it : sessions) {
+            auto& session = *it.second;
+            std::lock_guard<std::mutex> lock(session.m_state_mutex);
+            if (!session.m_session)
+                continue;
+            auto server = index.find(session.m_connection_server);
+            if (server == index.end())
+                continue;
+            auto& server_stats = stats[server->second];
+            using NotifierType = SyncSession::NotifierType;
+            server_stats.uploaded_bytes += session.m_progress_notifier.estimate(NotifierType::upload).transferred;
+            server_stats.downloaded_bytes += session.m_progress_notifier.estimate(NotifierType::download).transferred;
+            server_stats.reconnect_count += session.m_reconnect_count.load();
+        }
+    });
+    return stats;
+}
+
+SyncManager::Metrics SyncManager::metrics() const
+{
+    Metrics metrics{};
+    m_sessions.for_each_shard([&](auto& sessions) {
+        for (auto& it : sessions) {
+            switch (it.second->state()) {
+                case SyncSession::PublicState::WaitingForAccessToken:
+                    ++metrics.sessions_waiting_for_access_token;
+                    break;
+                case SyncSession::PublicState::Active:
+                    ++metrics.sessions_active;
+                    break;
+                case SyncSession::PublicState::Dying:
+                    ++metrics.sessions_dying;
+                    break;
+                case SyncSession::PublicState::Inactive:
+                    ++metrics.sessions_inactive;
+                    break;
+            }
+        }
+    });
+    metrics.partial_sync_queued_work = _impl::partial_sync::WorkQueue::shared().queued_count();
+    return metrics;
+}
+
+void SyncManager::Metrics::write_prometheus(util::PrometheusWriter& writer) const
+{
+    const char* sessions_help = "Sync sessions by state";
+    writer.gauge("realm_sync_sessions", sessions_help, sessions_waiting_for_access_token,
+                 util::PrometheusWriter::label("state", "waiting_for_access_token"));
+    writer.gauge("realm_sync_sessions", sessions_help, sessions_active,
+                 util::PrometheusWriter::label("state", "active"));
+    writer.gauge("realm_sync_sessions", sessions_help, sessions_dying,
+                 util::PrometheusWriter::label("state", "dying"));
+    writer.gauge("realm_sync_sessions", sessions_help, sessions_inactive,
+                 util::PrometheusWriter::label("state", "inactive"));
+    writer.gauge("realm_partial_sync_queued_work", "Partial sync background work waiting to start",
+                 partial_sync_queued_work);
+}
+
 SyncClient& SyncManager::get_sync_client() const
 {
     std::lock_guard<std::mutex> lock(m_mutex);
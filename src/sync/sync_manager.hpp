@@ -22,14 +22,22 @@
 #include "shared_realm.hpp"
 
 #include "sync_user.hpp"
+#include "sync/impl/file_action_queue.hpp"
+#include "sync/impl/sharded_map.hpp"
+#include "util/metrics.hpp"
+#include "util/timer_queue.hpp"
 
 #include <realm/sync/client.hpp>
 #include <realm/util/logger.hpp>
 #include <realm/util/optional.hpp>
 
+#include <chrono>
+#include <exception>
 #include <memory>
 #include <mutex>
+#include <system_error>
 #include <unordered_map>
+#include <vector>
 
 namespace realm {
 
@@ -67,11 +75,18 @@ public:
     static SyncManager& shared();
 
     // Configure the metadata and file management subsystems. This MUST be called upon startup.
+    // Pending file actions and the removal of the data of users marked for removal are run in
+    // parallel on background threads. If `run_file_actions_in_background` is false this waits
+    // for them to complete before returning; otherwise they continue after it returns, and
+    // opening a synchronized Realm waits for any still pending on that Realm's file.
+    // wait_for_file_actions() must be used before opening a Realm they might affect via any
+    // other means.
     void configure(const std::string& base_file_path,
                    MetadataMode metadata_mode=MetadataMode::Encryption,
                    const std::string& user_agent_binding_info = "",
                    util::Optional<std::vector<char>> custom_encryption_key=none,
-                   bool reset_metadata_on_error=false);
+                   bool reset_metadata_on_error=false,
+                   bool run_file_actions_in_background=false);
 
     // Immediately run file actions for a single Realm at a given original path.
     // Returns whether or not a file action was successfully executed for the specified Realm.
@@ -79,6 +94,17 @@ public:
     // The metadata and file management subsystems must also have already been configured.
     bool immediately_run_file_actions(const std::string& original_name);
 
+    // Run file actions for a single Realm at a given original path on a background thread,
+    // after any other file operations already queued for that path. `completion` is called
+    // on that thread with whether or not a file action was executed, as for
+    // immediately_run_file_actions(), or with the exception thrown while trying to run it.
+    // The same preconditions apply, and must continue to hold until the completion is called.
+    void run_file_actions_async(const std::string& original_name,
+                                std::function<void(bool, std::exception_ptr)> completion);
+
+    // Block until all file operations queued on background threads have completed.
+    void wait_for_file_actions();
+
     // Use a single connection for all sync sessions for each host/port rather
     // than one per session.
     // This must be called before any sync sessions are created, cannot be
@@ -86,6 +112,45 @@ public:
     // balancer or automatic failover.
     void enable_session_multiplexing();
 
+    // Give each session its own connection until more than `threshold`
+    // sessions are connected to a server, and then multiplex any further
+    // sessions for that server over a shared connection. Sessions which
+    // already have their own connection keep it. Has the same restrictions as
+    // enable_session_multiplexing(), which it implies.
+    void enable_automatic_session_multiplexing(size_t threshold);
+
+    // Connection statistics for one server (scheme, host and port), covering
+    // the sessions which currently have a sync session for it.
+    struct ServerConnectionStats {
+        std::string server_url;
+        size_t session_count;
+        // The number of connections those sessions are spread over
+        size_t connection_count;
+        // Bytes transferred by those sessions since they were opened
+        uint64_t uploaded_bytes;
+        uint64_t downloaded_bytes;
+        // How many times those sessions have connected again after having
+        // already been connected once
+        uint64_t reconnect_count;
+    };
+    // Get the statistics for every server with connected sessions, in no
+    // particular order.
+    std::vector<ServerConnectionStats> connection_stats() const;
+
+    // A snapshot of the sync work in progress, for monitoring
+    struct Metrics {
+        // The number of sync sessions in each state
+        size_t sessions_waiting_for_access_token;
+        size_t sessions_active;
+        size_t sessions_dying;
+        size_t sessions_inactive;
+        // Background partial sync work which is waiting to start
+        size_t partial_sync_queued_work;
+
+        void write_prometheus(util::PrometheusWriter& writer) const;
+    };
+    Metrics metrics() const;
+
     // Sets the log level for the Sync Client.
     // The log level can only be set up until the point the Sync Client is created. This happens when the first Session
     // is created.
@@ -107,8 +172,24 @@ public:
     ///
     /// Refer to `SyncSession::handle_reconnect()` to see what sort of work is done
     /// on a per-session basis.
+    ///
+    /// Sessions which are in use (have an external reference) go first, followed
+    /// by the rest in order of `SyncConfig::start_priority`. If reconnect pacing
+    /// is enabled, only the first batch of sessions is handled immediately and the
+    /// rest are handled in batches on a background thread, replacing any batches
+    /// still pending from a previous call.
     void reconnect();
 
+    /// Spread the work done by `reconnect()` over time rather than waking every
+    /// session at once when connectivity returns. Sessions are handled
+    /// `batch_size` at a time, with each batch after the first starting
+    /// `batch_interval` after the previous one's scheduled start plus a random
+    /// delay of up to `max_jitter`, so that many clients regaining connectivity
+    /// together don't all reconnect in lockstep. A `batch_size` of 0 (the
+    /// default) handles every session immediately.
+    void set_reconnect_pacing(size_t batch_size, std::chrono::milliseconds batch_interval,
+                              std::chrono::milliseconds max_jitter=std::chrono::milliseconds::zero());
+
     util::Logger::Level log_level() const noexcept;
 
     std::shared_ptr<SyncSession> get_session(const std::string& path, const SyncConfig& config, bool force_client_reset=false);
@@ -120,6 +201,33 @@ public:
     // the state of that session.
     bool has_existing_sessions();
 
+    // The outcome of waiting for one of the sessions passed to wait_for_upload_completion()
+    // or wait_for_download_completion(). `error` is empty if the session finished
+    // transferring, `std::errc::timed_out` if the timeout expired first, and otherwise the
+    // error which the session reported or `util::error::operation_aborted` if it couldn't
+    // be waited for. The sessions aren't kept alive while waiting, so `session` is null
+    // if it was destroyed before the callback was called.
+    struct SessionCompletion {
+        std::shared_ptr<SyncSession> session;
+        std::error_code error;
+    };
+    using SessionCompletionCallback = void(std::vector<SessionCompletion>);
+
+    // Wait for all of the given sessions to finish uploading or downloading, calling
+    // `callback` once with the results for every session in the order they were given,
+    // either when the last one completes or when `timeout` expires (if non-zero).
+    // The callback is called on the sync client's thread, or on the SyncManager's timer
+    // thread if the timeout expires.
+    void wait_for_upload_completion(std::vector<std::shared_ptr<SyncSession>> sessions,
+                                    std::chrono::milliseconds timeout,
+                                    std::function<SessionCompletionCallback> callback);
+    void wait_for_download_completion(std::vector<std::shared_ptr<SyncSession>> sessions,
+                                      std::chrono::milliseconds timeout,
+                                      std::function<SessionCompletionCallback> callback);
+    // Get all of the sessions which currently have external references, such as to
+    // wait for all of them to complete
+    std::vector<std::shared_ptr<SyncSession>> get_all_sessions() const;
+
     // If the metadata manager is configured, perform an update. Returns `true` iff the code was run.
     bool perform_metadata_update(std::function<void(const SyncMetadataManager&)> update_function) const;
 
@@ -162,6 +270,19 @@ public:
     // Get the unique identifier of this client.
     std::string client_uuid() const;
 
+    // Limit how many sessions can be starting at once, to avoid a flood of
+    // token requests, file opens and connections when many sessions are
+    // opened together. A session is starting from when it asks the binding
+    // for an access token until it has been bound or becomes inactive, or
+    // until `timeout` has passed so that a token request which never
+    // completes can't hold a slot forever (a zero timeout never expires).
+    // Sessions over the limit stay in the WaitingForAccessToken state without
+    // asking for a token until a slot frees up, and are started in order of
+    // `SyncConfig::start_priority` and then the order in which they were
+    // queued. A `limit` of 0 (the default) means no limit.
+    void set_max_starting_sessions(size_t limit,
+                                   std::chrono::milliseconds timeout=std::chrono::seconds(30));
+
     // Reset the singleton state for testing purposes. DO NOT CALL OUTSIDE OF TESTING CODE.
     // Precondition: any synced Realms or `SyncSession`s must be closed or rendered inactive prior to
     // calling this method.
@@ -184,7 +305,26 @@ private:
     _impl::SyncClient& get_sync_client() const;
     std::unique_ptr<_impl::SyncClient> create_sync_client() const;
 
-    std::shared_ptr<SyncSession> get_existing_session_locked(const std::string& path) const;
+    // Take a starting slot for `session` if one is free, and otherwise queue
+    // it to be started by start_queued_sessions() once one is. Returns the
+    // slot taken, or 0 if the session was queued.
+    uint64_t try_start_session(std::shared_ptr<SyncSession> const& session, int priority);
+    // Release a slot taken by a session which has finished starting. Slots
+    // which have already been released, such as by timing out, are ignored.
+    void release_start_slot(uint64_t slot);
+    void start_queued_sessions();
+    // precondition: m_session_start_mutex is locked
+    uint64_t take_start_slot();
+    bool erase_start_slot(uint64_t slot);
+
+    // Record that a session is opening a connection to `server_url`,
+    // returning the multiplex identity it should use
+    std::string open_server_connection(std::string const& server_url, std::string const& path,
+                                       std::string const& multiplex_identity);
+    void close_server_connection(std::string const& server_url, std::string const& multiplex_identity);
+
+    void wait_for_completion(std::vector<std::shared_ptr<SyncSession>> sessions, bool upload,
+                             std::chrono::milliseconds timeout, std::function<SessionCompletionCallback> callback);
 
     mutable std::mutex m_mutex;
 
@@ -193,13 +333,19 @@ private:
     SyncLoggerFactory* m_logger_factory = nullptr;
     ReconnectMode m_client_reconnect_mode = ReconnectMode::normal;
 
-    bool run_file_action(const SyncFileActionMetadata&);
+    // Perform a file action. Returns whether or not the file action can be removed.
+    static bool run_file_action(SyncFileManager const&, const SyncFileActionMetadata&);
 
-    // Protects m_users
-    mutable std::mutex m_user_mutex;
+    // Queue the file actions and user directory removals found at startup on
+    // the file action queue
+    void queue_startup_file_actions(SyncMetadataManager const&);
 
     // A map of user ID/auth server URL pairs to (shared pointers to) SyncUser objects.
-    std::unordered_map<SyncUserIdentifier, std::shared_ptr<SyncUser>> m_users;
+    // Sharded so that looking up users doesn't contend with logins for other users.
+    _impl::ShardedMap<SyncUserIdentifier, std::shared_ptr<SyncUser>> m_users;
+
+    // Protects m_admin_token_users
+    mutable std::mutex m_user_mutex;
     // A map of local identifiers to admin token users.
     std::unordered_map<std::string, std::shared_ptr<SyncUser>> m_admin_token_users;
 
@@ -216,20 +362,71 @@ private:
     std::unique_ptr<SyncFileManager> m_file_manager;
     std::unique_ptr<SyncMetadataManager> m_metadata_manager;
 
-    // Protects m_sessions
-    mutable std::mutex m_session_mutex;
+    // Runs file actions and other potentially slow file system operations in
+    // the background. Jobs capture copies of the SyncFileManager, so they
+    // don't need m_file_system_mutex.
+    _impl::FileActionQueue m_file_action_queue{4};
 
     // Map of sessions by path name.
     // Sessions remove themselves from this map by calling `unregister_session` once they're
     // inactive and have performed any necessary cleanup work.
-    std::unordered_map<std::string, std::shared_ptr<SyncSession>> m_sessions;
-
-    // Internal method returning `true` if the SyncManager still contains sessions not yet fully closed.
-    // Callers of this method should hold the `m_session_mutex` themselves.
-    bool do_has_existing_sessions();
+    // Each shard has its own lock, so that looking up or registering a session only contends
+    // with operations on other sessions in the same shard.
+    _impl::ShardedMap<std::string, std::shared_ptr<SyncSession>> m_sessions;
 
     // The unique identifier of this client.
     util::Optional<std::string> m_client_uuid;
+
+    // Protects the session start scheduling state below
+    std::mutex m_session_start_mutex;
+    size_t m_max_starting_sessions = 0;
+    std::chrono::milliseconds m_session_start_timeout{0};
+    // The timer token for each slot currently taken, which is 0 if it has no
+    // timeout
+    std::unordered_map<uint64_t, util::TimerQueue::Token> m_start_slots;
+    uint64_t m_next_start_slot = 0;
+    struct QueuedSessionStart {
+        int priority;
+        uint64_t sequence;
+        std::weak_ptr<SyncSession> session;
+
+        // Orders the highest priority and then oldest queued session last
+        bool operator<(QueuedSessionStart const& other) const
+        {
+            if (priority != other.priority)
+                return priority < other.priority;
+            return sequence > other.sequence;
+        }
+    };
+    // A heap with the session to start next at the top
+    std::vector<QueuedSessionStart> m_session_start_queue;
+    uint64_t m_next_session_start_sequence = 0;
+
+    // Protects the reconnect pacing state below
+    std::mutex m_reconnect_mutex;
+    // The timers for the batches still pending from the last call to
+    // reconnect(), which are cancelled when a new call supersedes them
+    std::vector<util::TimerQueue::Token> m_reconnect_batches;
+    size_t m_reconnect_batch_size = 0;
+    std::chrono::milliseconds m_reconnect_batch_interval{0};
+    std::chrono::milliseconds m_reconnect_max_jitter{0};
+    uint64_t m_reconnect_generation = 0;
+
+    // Protects the connection tracking state below
+    mutable std::mutex m_connection_mutex;
+    // 0 unless automatic multiplexing is enabled
+    size_t m_auto_multiplex_threshold = 0;
+    struct ServerConnections {
+        size_t session_count = 0;
+        // The number of sessions using each multiplex identity, which each
+        // get a separate connection when multiplexing is enabled
+        std::unordered_map<std::string, size_t> sessions_per_identity;
+    };
+    std::unordered_map<std::string, ServerConnections> m_server_connections;
+
+    // Runs timeouts and other delayed work. Declared last so that it's
+    // destroyed, and its thread joined, before anything it uses.
+    util::TimerQueue m_timers;
 };
 
 } // namespace realm
@@ -32,6 +32,8 @@
 
 #include <realm/query_expression.hpp>
 
+#include <algorithm>
+
 using namespace realm;
 using namespace std::chrono;
 
@@ -83,6 +85,33 @@ int64_t ns_since_unix_epoch(const system_clock::time_point& point)
     return duration_cast<nanoseconds>(point - epoch_point).count();
 }
 
+// The management and permission Realms which have been opened on this thread,
+// by path. Only weak references are held, so the cache never keeps a Realm
+// open by itself: a Realm is reused while an earlier operation which is still
+// waiting for the server, or the Results from get_permissions(), is keeping
+// it alive, and is closed as usual once nothing is using it any more.
+struct CachedPermissionRealm {
+    std::string path;
+    std::weak_ptr<Realm> realm;
+};
+
+// Realms are confined to the thread they're opened on, so each thread gets
+// its own cache
+std::weak_ptr<Realm>& cached_realm_for(std::string const& path)
+{
+    static thread_local std::vector<CachedPermissionRealm> cache;
+
+    cache.erase(std::remove_if(cache.begin(), cache.end(), [&](auto const& entry) {
+        return entry.realm.expired();
+    }), cache.end());
+
+    auto it = std::find_if(cache.begin(), cache.end(), [&](auto const& entry) { return entry.path == path; });
+    if (it != cache.end())
+        return it->realm;
+    cache.push_back({path, {}});
+    return cache.back().realm;
+}
+
 } // anonymous namespace
 
 // MARK: - Permission
@@ -298,9 +327,12 @@ void Permissions::perform_async_operation(const std::string& object_type,
 
 SharedRealm Permissions::management_realm(std::shared_ptr<SyncUser> user, const ConfigMaker& make_config)
 {
-    // FIXME: maybe we should cache the management Realm on the user, so we don't need to open it every time.
     const auto realm_url = util::format("realm%1/~/__management", user->server_url().substr(4));
     Realm::Config config = make_config(user, std::move(realm_url));
+    auto& cached = cached_realm_for(config.path);
+    if (auto realm = cached.lock())
+        return realm;
+
     config.sync_config->stop_policy = SyncSessionStopPolicy::Immediately;
     config.schema = Schema{
         {"PermissionChange", {
@@ -344,14 +376,18 @@ SharedRealm Permissions::management_realm(std::shared_ptr<SyncUser> user, const
     config.schema_version = 0;
     auto shared_realm = Realm::get_shared_realm(std::move(config));
     user->register_management_session(shared_realm->config().path);
+    cached = shared_realm;
     return shared_realm;
 }
 
 SharedRealm Permissions::permission_realm(std::shared_ptr<SyncUser> user, const ConfigMaker& make_config)
 {
-    // FIXME: maybe we should cache the permission Realm on the user, so we don't need to open it every time.
     const auto realm_url = util::format("realm%1/~/__permission", user->server_url().substr(4));
     Realm::Config config = make_config(user, std::move(realm_url));
+    auto& cached = cached_realm_for(config.path);
+    if (auto realm = cached.lock())
+        return realm;
+
     config.sync_config->stop_policy = SyncSessionStopPolicy::Immediately;
     config.schema = Schema{
         {"Permission", {
@@ -366,5 +402,6 @@ SharedRealm Permissions::permission_realm(std::shared_ptr<SyncUser> user, const
     config.schema_version = 0;
     auto shared_realm = Realm::get_shared_realm(std::move(config));
     user->register_permission_session(shared_realm->config().path);
+    cached = shared_realm;
     return shared_realm;
 }
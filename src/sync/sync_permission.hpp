@@ -120,6 +120,9 @@ public:
     using PermissionOfferCallback = std::function<void(util::Optional<std::string>, std::exception_ptr)>;
 
     // Asynchronously retrieve a `Results` containing the permissions for the provided user.
+    // The callback is always called asynchronously. While an earlier call's Results or a
+    // pending operation is keeping the permission or management Realm open, later calls on
+    // the same thread reuse it rather than opening the Realm and waiting for it to sync again.
     static void get_permissions(std::shared_ptr<SyncUser>, PermissionResultsCallback, const ConfigMaker&);
 
     // Callback used to monitor success or errors when changing permissions
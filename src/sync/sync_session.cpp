@@ -27,6 +27,9 @@
 #include <realm/sync/client.hpp>
 #include <realm/sync/protocol.hpp>
 
+#include <tuple>
+#include <utility>
+
 using namespace realm;
 using namespace realm::_impl;
 using namespace realm::_impl::sync_session_states;
@@ -153,10 +156,8 @@ struct sync_session_states::WaitingForAccessToken : public SyncSession::State {
             session.m_session->override_server(session.m_server_override->address, session.m_server_override->port);
 
         // Register all the pending wait-for-completion blocks.
-        for (auto& package : session.m_completion_wait_packages) {
-            (*session.m_session.*package.waiter)(std::move(package.callback));
-        }
-        session.m_completion_wait_packages.clear();
+        session.request_completion(session.m_upload_waiters);
+        session.request_completion(session.m_download_waiters);
 
         // Handle any deferred commit notification.
         if (session.m_deferred_commit_notification) {
@@ -183,10 +184,15 @@ struct sync_session_states::WaitingForAccessToken : public SyncSession::State {
 
     void handle_reconnect(std::unique_lock<std::mutex>& lock, SyncSession& session) const override
     {
+        // A session waiting for a starting slot hasn't asked for a token yet,
+        // and will do so once it gets one
+        if (session.m_start_queued)
+            return;
+
         // Ask the binding to retry getting the token for this session.
         std::shared_ptr<SyncSession> session_ptr = session.shared_from_this();
         lock.unlock();
-        session.m_config.bind_session_handler(session_ptr->m_realm_path, session_ptr->m_config, session_ptr);
+        session_ptr->request_access_token();
     }
 
     void nonsync_transact_notify(std::unique_lock<std::mutex>&,
@@ -216,7 +222,9 @@ struct sync_session_states::WaitingForAccessToken : public SyncSession::State {
                              std::function<void(std::error_code)> callback,
                              SessionWaiterPointer waiter) const override
     {
-        session.m_completion_wait_packages.push_back({ waiter, std::move(callback) });
+        // Queued until the session is bound
+        auto& waiters = session.completion_waiters(waiter);
+        waiters.groups[waiters.next_request_id].push_back(std::move(callback));
         return true;
     }
 
@@ -244,7 +252,7 @@ struct sync_session_states::Active : public SyncSession::State {
         session.advance_state(lock, waiting_for_access_token);
         std::shared_ptr<SyncSession> session_ptr = session.shared_from_this();
         lock.unlock();
-        session.m_config.bind_session_handler(session_ptr->m_realm_path, session_ptr->m_config, session_ptr);
+        session_ptr->request_access_token();
         return false;
     }
 
@@ -281,7 +289,9 @@ struct sync_session_states::Active : public SyncSession::State {
                              SessionWaiterPointer waiter) const override
     {
         REALM_ASSERT(session.m_session);
-        (*session.m_session.*waiter)(std::move(callback));
+        auto& waiters = session.completion_waiters(waiter);
+        waiters.groups[waiters.next_request_id].push_back(std::move(callback));
+        session.request_completion(waiters);
         return true;
     }
 
@@ -349,7 +359,9 @@ struct sync_session_states::Dying : public SyncSession::State {
                              SessionWaiterPointer waiter) const override
     {
         REALM_ASSERT(session.m_session);
-        (*session.m_session.*waiter)(std::move(callback));
+        auto& waiters = session.completion_waiters(waiter);
+        waiters.groups[waiters.next_request_id].push_back(std::move(callback));
+        session.request_completion(waiters);
         return true;
     }
 
@@ -364,11 +376,16 @@ struct sync_session_states::Dying : public SyncSession::State {
 struct sync_session_states::Inactive : public SyncSession::State {
     void enter_state(std::unique_lock<std::mutex>& lock, SyncSession& session) const override
     {
-        auto completion_wait_packages = std::move(session.m_completion_wait_packages);
-        session.m_completion_wait_packages.clear();
-        session.m_session = nullptr;
+        auto completion_waiters = session.take_completion_waiters();
+        session.destroy_sync_session();
+        session.m_resetting_in_place = false;
+        auto start_slot = std::exchange(session.m_start_slot, 0);
+        session.m_start_queued = false;
         session.unregister(lock); // releases lock
 
+        if (start_slot)
+            SyncManager::shared().release_start_slot(start_slot);
+
         // Send notifications after releasing the lock to prevent deadlocks in the callback.
 
         // Manually set the disconnected state. Sync would also do this, but since the underlying SyncSession object
@@ -381,8 +398,8 @@ struct sync_session_states::Inactive : public SyncSession::State {
         }
 
         // Inform any queued-up completion handlers that they were cancelled.
-        for (auto& package : completion_wait_packages)
-            package.callback(util::error::operation_aborted);
+        for (auto& callback : completion_waiters)
+            callback(util::error::operation_aborted);
     }
 
     bool revive_if_needed(std::unique_lock<std::mutex>& lock, SyncSession& session) const override
@@ -395,7 +412,9 @@ struct sync_session_states::Inactive : public SyncSession::State {
                              std::function<void(std::error_code)> callback,
                              SessionWaiterPointer waiter) const override
     {
-        session.m_completion_wait_packages.push_back({ waiter, std::move(callback) });
+        // Queued until the session is bound
+        auto& waiters = session.completion_waiters(waiter);
+        waiters.groups[waiters.next_request_id].push_back(std::move(callback));
         return true;
     }
 
@@ -424,6 +443,9 @@ SyncSession::SyncSession(SyncClient& client, std::string realm_path, SyncConfig
 , m_realm_path(std::move(realm_path))
 , m_client(client)
 {
+    m_upload_waiters.waiter = &sync::Session::async_wait_for_upload_completion;
+    m_download_waiters.waiter = &sync::Session::async_wait_for_download_completion;
+
     // Sync history validation ensures that the history within the Realm file is in a format that can be used
     // by the version of realm-sync that we're using. Validation is enabled by default when the binding manually
     // opens a sync session (via `SyncManager::get_session`), but is disabled when the sync session is opened
@@ -474,6 +496,38 @@ void SyncSession::update_error_and_mark_file_for_deletion(SyncError& error, Shou
     });
 }
 
+bool SyncSession::reset_in_place()
+{
+    if (m_config.client_reset_mode != SyncClientResetMode::ResetInPlace)
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_state_mutex);
+    // If the reset itself results in another client reset error, fall back to
+    // discarding the file rather than trying again indefinitely
+    if (m_resetting_in_place || m_force_client_reset || m_state != &State::active)
+        return false;
+
+    // The next sync session is created with a client reset config, and is
+    // bound once we have a new token
+    m_resetting_in_place = true;
+    destroy_sync_session();
+    // The pending completion handlers are carried over to the new session
+    m_upload_waiters.outstanding_request_id = 0;
+    m_download_waiters.outstanding_request_id = 0;
+    advance_state(lock, State::waiting_for_access_token);
+    lock.unlock();
+    request_access_token();
+    return true;
+}
+
+void SyncSession::destroy_sync_session()
+{
+    if (!m_session)
+        return;
+    m_session = nullptr;
+    SyncManager::shared().close_server_connection(m_connection_server, m_connection_identity);
+}
+
 // This method should only be called from within the error handler callback registered upon the underlying `m_session`.
 void SyncSession::handle_error(SyncError error)
 {
@@ -547,13 +601,18 @@ void SyncSession::handle_error(SyncError error)
                 update_error_and_mark_file_for_deletion(error, ShouldBackup::no);
                 break;
             }
-            case ProtocolError::bad_client_file:
             case ProtocolError::bad_client_file_ident:
-            case ProtocolError::bad_origin_file_ident:
             case ProtocolError::bad_server_file_ident:
             case ProtocolError::bad_server_version:
-            case ProtocolError::client_file_blacklisted:
             case ProtocolError::diverging_histories:
+                if (reset_in_place())
+                    return;
+                next_state = NextStateAfterError::inactive;
+                update_error_and_mark_file_for_deletion(error, ShouldBackup::yes);
+                break;
+            case ProtocolError::bad_client_file:
+            case ProtocolError::bad_origin_file_ident:
+            case ProtocolError::client_file_blacklisted:
             case ProtocolError::server_file_deleted:
             case ProtocolError::user_blacklisted:
                 next_state = NextStateAfterError::inactive;
@@ -623,15 +682,76 @@ void SyncSession::handle_error(SyncError error)
 
 void SyncSession::cancel_pending_waits(std::unique_lock<std::mutex>& lock)
 {
-    auto packages = std::move(m_completion_wait_packages);
+    auto callbacks = take_completion_waiters();
     lock.unlock();
 
     // Inform any queued-up completion handlers that they were cancelled.
-    for (auto& package : packages) {
-        package.callback(util::error::operation_aborted);
+    for (auto& callback : callbacks) {
+        callback(util::error::operation_aborted);
     }
 }
 
+SyncSession::CompletionWaiters& SyncSession::completion_waiters(SessionWaiterPointer waiter)
+{
+    return waiter == m_upload_waiters.waiter ? m_upload_waiters : m_download_waiters;
+}
+
+void SyncSession::request_completion(CompletionWaiters& waiters)
+{
+    REALM_ASSERT(m_session);
+    if (waiters.outstanding_request_id || waiters.groups.empty())
+        return;
+
+    uint64_t request_id = waiters.next_request_id++;
+    waiters.outstanding_request_id = request_id;
+    std::weak_ptr<SyncSession> weak_session = shared_from_this();
+    (*m_session.*waiters.waiter)([weak_session, &waiters, request_id](std::error_code error) {
+        if (auto session = weak_session.lock())
+            session->handle_completion(waiters, request_id, error);
+    });
+}
+
+void SyncSession::handle_completion(CompletionWaiters& waiters, uint64_t request_id, std::error_code error)
+{
+    std::vector<std::function<void(std::error_code)>> callbacks;
+    {
+        std::unique_lock<std::mutex> lock(m_state_mutex);
+        // The handlers for a request which was abandoned by cancelling them
+        // or by replacing the underlying session have been dealt with already
+        if (waiters.outstanding_request_id != request_id)
+            return;
+        waiters.outstanding_request_id = 0;
+
+        // Everything added before the request was made is complete
+        auto end = waiters.groups.upper_bound(request_id);
+        for (auto it = waiters.groups.begin(); it != end; ++it) {
+            for (auto& callback : it->second)
+                callbacks.push_back(std::move(callback));
+        }
+        waiters.groups.erase(waiters.groups.begin(), end);
+
+        if (m_session)
+            request_completion(waiters);
+    }
+
+    for (auto& callback : callbacks)
+        callback(error);
+}
+
+std::vector<std::function<void(std::error_code)>> SyncSession::take_completion_waiters()
+{
+    std::vector<std::function<void(std::error_code)>> callbacks;
+    for (auto waiters : {&m_upload_waiters, &m_download_waiters}) {
+        for (auto& group : waiters->groups) {
+            for (auto& callback : group.second)
+                callbacks.push_back(std::move(callback));
+        }
+        waiters->groups.clear();
+        waiters->outstanding_request_id = 0;
+    }
+    return callbacks;
+}
+
 void SyncSession::handle_progress_update(uint64_t downloaded, uint64_t downloadable,
                                          uint64_t uploaded, uint64_t uploadable,
                                          uint64_t download_version, uint64_t snapshot_version)
@@ -650,7 +770,10 @@ void SyncSession::create_sync_session()
     session_config.verify_servers_ssl_certificate = m_config.client_validate_ssl;
     session_config.ssl_trust_certificate_path = m_config.ssl_trust_certificate_path;
     session_config.ssl_verify_callback = m_config.ssl_verify_callback;
-    session_config.multiplex_ident = m_multiplex_identity;
+    m_connection_server = m_config.server_url();
+    m_connection_identity = SyncManager::shared().open_server_connection(m_connection_server, m_realm_path,
+                                                                         m_multiplex_identity);
+    session_config.multiplex_ident = m_connection_identity;
 
     if (m_config.authorization_header_name) {
         session_config.authorization_header_name = *m_config.authorization_header_name;
@@ -661,7 +784,7 @@ void SyncSession::create_sync_session()
         session_config.url_prefix = *m_config.url_prefix;
     }
 
-    if (m_force_client_reset) {
+    if (m_force_client_reset || m_resetting_in_place) {
         std::string metadata_dir = SyncManager::shared().m_file_manager->get_state_directory();
         util::try_make_dir(metadata_dir);
         
@@ -705,6 +828,11 @@ void SyncSession::create_sync_session()
         // nothing useful we can do with them.
         if (auto self = weak_self.lock()) {
             ConnectionState last_state = self->connection_state();
+            if (state == sync::Session::ConnectionState::connected) {
+                if (self->m_has_connected)
+                    ++self->m_reconnect_count;
+                self->m_has_connected = true;
+            }
             self->m_connection_state = state;
             ConnectionState new_state = self->connection_state();
             self->m_connection_change_notifier.invoke_callbacks(last_state, new_state);
@@ -738,14 +866,42 @@ void SyncSession::nonsync_transact_notify(sync::version_type version)
 
 void SyncSession::revive_if_needed()
 {
-    util::Optional<std::function<SyncBindSessionHandler>&> handler;
+    bool needs_token = false;
+    {
+        std::unique_lock<std::mutex> lock(m_state_mutex);
+        if (m_state->revive_if_needed(lock, *this)) {
+            if (auto slot = SyncManager::shared().try_start_session(shared_from_this(), m_config.start_priority)) {
+                m_start_slot = slot;
+                needs_token = true;
+            }
+            else {
+                m_start_queued = true;
+            }
+        }
+    }
+    if (needs_token)
+        request_access_token();
+}
+
+bool SyncSession::start_queued(uint64_t slot)
+{
     {
         std::unique_lock<std::mutex> lock(m_state_mutex);
-        if (m_state->revive_if_needed(lock, *this))
-            handler = m_config.bind_session_handler;
+        if (!m_start_queued || m_state != &State::waiting_for_access_token)
+            return false;
+        m_start_queued = false;
+        m_start_slot = slot;
     }
-    if (handler)
-        handler.value()(m_realm_path, m_config, shared_from_this());
+    request_access_token();
+    return true;
+}
+
+void SyncSession::request_access_token()
+{
+    auto session = shared_from_this();
+    if (m_config.user && m_config.user->request_access_token(session))
+        return;
+    m_config.bind_session_handler(m_realm_path, m_config, session);
 }
 
 void SyncSession::handle_reconnect()
@@ -788,9 +944,15 @@ bool SyncSession::wait_for_download_completion(std::function<void(std::error_cod
 }
 
 uint64_t SyncSession::register_progress_notifier(std::function<SyncProgressNotifierCallback> notifier,
-                                                 NotifierType direction, bool is_streaming)
+                                                 NotifierType direction, bool is_streaming,
+                                                 ProgressThrottle throttle)
+{
+    return m_progress_notifier.register_callback(std::move(notifier), direction, is_streaming, throttle);
+}
+
+SyncSession::TransferEstimate SyncSession::transfer_estimate(NotifierType direction) const
 {
-    return m_progress_notifier.register_callback(std::move(notifier), direction, is_streaming);
+    return m_progress_notifier.estimate(direction);
 }
 
 void SyncSession::unregister_progress_notifier(uint64_t token)
@@ -816,6 +978,14 @@ void SyncSession::refresh_access_token(std::string access_token, util::Optional<
         return;
     }
     m_state->refresh_access_token(lock, *this, std::move(access_token), server_url);
+
+    // Being bound finishes starting the session. If it instead became
+    // inactive then the slot has already been released.
+    if (lock.owns_lock() && m_start_slot && m_state != &State::waiting_for_access_token) {
+        auto slot = std::exchange(m_start_slot, 0);
+        lock.unlock();
+        SyncManager::shared().release_start_slot(slot);
+    }
 }
 
 void SyncSession::override_server(std::string address, int port)
@@ -937,7 +1107,7 @@ void SyncSession::did_drop_external_reference()
 }
 
 uint64_t SyncProgressNotifier::register_callback(std::function<SyncProgressNotifierCallback> notifier,
-                                                 NotifierType direction, bool is_streaming)
+                                                 NotifierType direction, bool is_streaming, Throttle throttle)
 {
     std::function<void()> invocation;
     uint64_t token_value = 0;
@@ -945,7 +1115,7 @@ uint64_t SyncProgressNotifier::register_callback(std::function<SyncProgressNotif
         std::lock_guard<std::mutex> lock(m_mutex);
         token_value = m_progress_notifier_token++;
         NotifierPackage package{std::move(notifier), util::none, m_local_transaction_version,
-            is_streaming, direction == NotifierType::download};
+            is_streaming, direction == NotifierType::download, throttle};
         if (!m_current_progress) {
             // Simply register the package, since we have no data yet.
             m_packages.emplace(token_value, std::move(package));
@@ -956,7 +1126,8 @@ uint64_t SyncProgressNotifier::register_callback(std::function<SyncProgressNotif
         if (skip_registration) {
             token_value = 0;
         } else {
-            m_packages.emplace(token_value, std::move(package));
+            auto& registered = m_packages.emplace(token_value, std::move(package)).first->second;
+            schedule_trailing(token_value, registered);
         }
     }
     invocation();
@@ -969,9 +1140,12 @@ void SyncProgressNotifier::unregister_callback(uint64_t token)
     m_packages.erase(token);
 }
 
+constexpr std::chrono::seconds SyncProgressNotifier::rate_window;
+
 void SyncProgressNotifier::update(uint64_t downloaded, uint64_t downloadable,
                                   uint64_t uploaded, uint64_t uploadable,
-                                  uint64_t download_version, uint64_t snapshot_version)
+                                  uint64_t download_version, uint64_t snapshot_version,
+                                  std::chrono::steady_clock::time_point now)
 {
     // Ignore progress messages from before we first receive a DOWNLOAD message
     if (download_version == 0)
@@ -982,10 +1156,23 @@ void SyncProgressNotifier::update(uint64_t downloaded, uint64_t downloadable,
         std::lock_guard<std::mutex> lock(m_mutex);
         m_current_progress = Progress{uploadable, downloadable, uploaded, downloaded, snapshot_version};
 
+        // The byte counts only go backwards if the session was reset, at
+        // which point the old samples no longer mean anything
+        if (!m_samples.empty() && (uploaded < m_samples.back().uploaded || downloaded < m_samples.back().downloaded))
+            m_samples.clear();
+        m_samples.push_back({now, uploaded, downloaded});
+        while (m_samples.size() > 2 && m_samples[1].time <= now - rate_window)
+            m_samples.pop_front();
+
         for (auto it = m_packages.begin(); it != m_packages.end(); ) {
             bool should_delete = false;
             invocations.emplace_back(it->second.create_invocation(*m_current_progress, should_delete));
-            it = should_delete ? m_packages.erase(it) : std::next(it);
+            if (should_delete) {
+                it = m_packages.erase(it);
+                continue;
+            }
+            schedule_trailing(it->first, it->second);
+            ++it;
         }
     }
     // Run the notifiers only after we've released the lock.
@@ -993,6 +1180,73 @@ void SyncProgressNotifier::update(uint64_t downloaded, uint64_t downloadable,
         invocation();
 }
 
+SyncProgressNotifier::TransferEstimate SyncProgressNotifier::estimate(NotifierType direction) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool is_download = direction == NotifierType::download;
+    TransferEstimate estimate{0, 0, 0, util::none};
+    if (m_current_progress) {
+        estimate.transferred = is_download ? m_current_progress->downloaded : m_current_progress->uploaded;
+        estimate.transferrable = is_download ? m_current_progress->downloadable : m_current_progress->uploadable;
+    }
+
+    if (m_samples.size() > 1) {
+        auto& first = m_samples.front();
+        auto& last = m_samples.back();
+        uint64_t bytes = is_download ? last.downloaded - first.downloaded : last.uploaded - first.uploaded;
+        std::chrono::duration<double> elapsed = last.time - first.time;
+        if (elapsed.count() > 0)
+            estimate.bytes_per_second = bytes / elapsed.count();
+    }
+
+    if (estimate.transferred >= estimate.transferrable)
+        estimate.remaining = std::chrono::steady_clock::duration::zero();
+    else if (estimate.bytes_per_second > 0) {
+        std::chrono::duration<double> remaining((estimate.transferrable - estimate.transferred) / estimate.bytes_per_second);
+        estimate.remaining = std::chrono::duration_cast<std::chrono::steady_clock::duration>(remaining);
+    }
+    return estimate;
+}
+
+void SyncProgressNotifier::schedule_trailing(uint64_t token, NotifierPackage& package)
+{
+    if (!package.trailing || package.trailing_scheduled)
+        return;
+    package.trailing_scheduled = true;
+    m_timers.schedule(package.last_delivery + package.throttle.min_interval,
+                      [this, token] { deliver_trailing(token); });
+}
+
+void SyncProgressNotifier::deliver_trailing(uint64_t token)
+{
+    std::function<void()> invocation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_packages.find(token);
+        if (it == m_packages.end())
+            return;
+        auto& package = it->second;
+        package.trailing_scheduled = false;
+        if (!package.trailing)
+            return;
+        // Something was delivered after this was scheduled, so the interval
+        // now runs from then
+        if (std::chrono::steady_clock::now() < package.last_delivery + package.throttle.min_interval) {
+            schedule_trailing(token, package);
+            return;
+        }
+
+        uint64_t transferred, transferrable;
+        std::tie(transferred, transferrable) = *package.trailing;
+        package.trailing = util::none;
+        package.last_transferred = transferred;
+        package.last_transferrable = transferrable;
+        package.last_delivery = std::chrono::steady_clock::now();
+        invocation = [=, notifier=package.notifier] { notifier(transferred, transferrable); };
+    }
+    invocation();
+}
+
 void SyncProgressNotifier::set_local_version(uint64_t snapshot_version)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -1026,9 +1280,39 @@ std::function<void()> SyncProgressNotifier::NotifierPackage::create_invocation(P
     // A notifier is expired if at least as many bytes have been transferred
     // as were originally considered transferrable.
     is_expired = !is_streaming && transferred >= transferrable;
+    if (!should_deliver(transferred, transferrable, transferred >= transferrable))
+        return []{};
     return [=, notifier=notifier] { notifier(transferred, transferrable); };
 }
 
+bool SyncProgressNotifier::NotifierPackage::should_deliver(uint64_t transferred, uint64_t transferrable,
+                                                           bool is_complete)
+{
+    if (throttle.min_interval == std::chrono::steady_clock::duration::zero() && throttle.min_bytes == 0)
+        return true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (last_transferred) {
+        bool changed = transferred != *last_transferred || transferrable != last_transferrable;
+        // Completing the transfer is always reported, but only once
+        if (!is_complete || !changed) {
+            if (now - last_delivery < throttle.min_interval) {
+                if (changed)
+                    trailing = std::make_pair(transferred, transferrable);
+                return false;
+            }
+            if (transferred >= *last_transferred && transferred - *last_transferred < throttle.min_bytes)
+                return false;
+        }
+    }
+
+    trailing = util::none;
+    last_transferred = transferred;
+    last_transferrable = transferrable;
+    last_delivery = now;
+    return true;
+}
+
 uint64_t SyncSession::ConnectionChangeNotifier::add_callback(std::function<ConnectionStateCallback> callback)
 {
     std::lock_guard<std::mutex> lock(m_callback_mutex);
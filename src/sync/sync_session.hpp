@@ -21,10 +21,15 @@
 
 #include "feature_checks.hpp"
 #include "sync/sync_config.hpp"
+#include "util/timer_queue.hpp"
 
 #include <realm/util/optional.hpp>
 #include <realm/version_id.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <unordered_map>
 
@@ -60,13 +65,43 @@ public:
         upload, download
     };
 
+    // Limits on how often a callback is called, for when the binding can't
+    // keep up with every update from sync. Updates which arrive before all of
+    // the limits have been reached since the callback was last called are
+    // skipped, except that the first update and the one which completes the
+    // transfer are always delivered. If an update was skipped because of
+    // `min_interval` and no later one is delivered, the most recent skipped
+    // update is delivered from a background thread once `min_interval` has
+    // passed since the last call, so a pause in the transfer can't hold it
+    // back indefinitely.
+    struct Throttle {
+        std::chrono::steady_clock::duration min_interval = std::chrono::steady_clock::duration::zero();
+        uint64_t min_bytes = 0;
+    };
+
     uint64_t register_callback(std::function<SyncProgressNotifierCallback>,
-                               NotifierType direction, bool is_streaming);
+                               NotifierType direction, bool is_streaming, Throttle throttle = {});
     void unregister_callback(uint64_t);
 
     void set_local_version(uint64_t);
     void update(uint64_t downloaded, uint64_t downloadable,
-                uint64_t uploaded, uint64_t uploadable, uint64_t, uint64_t);
+                uint64_t uploaded, uint64_t uploadable, uint64_t, uint64_t,
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    // The current transfer rate in one direction, measured over the updates
+    // from the last `rate_window`, and the time remaining at that rate.
+    struct TransferEstimate {
+        uint64_t transferred;
+        uint64_t transferrable;
+        // Zero if there haven't been enough updates to measure the rate yet,
+        // or if nothing has been transferred recently
+        double bytes_per_second;
+        // None if the rate is zero and there's still data to transfer
+        util::Optional<std::chrono::steady_clock::duration> remaining;
+    };
+    TransferEstimate estimate(NotifierType direction) const;
+
+    static constexpr std::chrono::seconds rate_window{10};
 
 private:
     mutable std::mutex m_mutex;
@@ -88,10 +123,28 @@ private:
         uint64_t snapshot_version;
         bool is_streaming;
         bool is_download;
+        Throttle throttle;
+
+        // The values passed to the notifier the last time it was called
+        util::Optional<uint64_t> last_transferred;
+        uint64_t last_transferrable = 0;
+        std::chrono::steady_clock::time_point last_delivery;
+
+        // The most recent update skipped because of the minimum interval,
+        // which is delivered by deliver_trailing() if nothing newer is
+        util::Optional<std::pair<uint64_t, uint64_t>> trailing;
+        bool trailing_scheduled = false;
 
         std::function<void()> create_invocation(const Progress&, bool&);
+        bool should_deliver(uint64_t transferred, uint64_t transferrable, bool is_complete);
     };
 
+    // Schedule the trailing delivery for the package with the given token if
+    // it needs one
+    // precondition: m_mutex is locked
+    void schedule_trailing(uint64_t token, NotifierPackage& package);
+    void deliver_trailing(uint64_t token);
+
     // A counter used as a token to identify progress notifier callbacks registered on this session.
     uint64_t m_progress_notifier_token = 1;
     // Version of the last locally-created transaction that we're expecting to be uploaded.
@@ -106,6 +159,19 @@ private:
     util::Optional<Progress> m_current_progress;
 
     std::unordered_map<uint64_t, NotifierPackage> m_packages;
+
+    // Recent updates, oldest first, for estimate(). Trimmed to those from the
+    // last rate_window plus the one before them.
+    struct Sample {
+        std::chrono::steady_clock::time_point time;
+        uint64_t uploaded;
+        uint64_t downloaded;
+    };
+    std::deque<Sample> m_samples;
+
+    // Runs the trailing deliveries for throttled notifiers. Declared last so
+    // that it's destroyed, and its thread joined, before everything it uses.
+    util::TimerQueue m_timers;
 };
 
 } // namespace _impl
@@ -167,7 +233,17 @@ public:
     //
     // Note that bindings should dispatch the callback onto a separate thread or queue
     // in order to avoid blocking the sync client.
-    uint64_t register_progress_notifier(std::function<SyncProgressNotifierCallback>, NotifierType, bool is_streaming);
+    //
+    // `throttle` limits how often the notifier is called during a transfer; see
+    // `_impl::SyncProgressNotifier::Throttle`.
+    using ProgressThrottle = _impl::SyncProgressNotifier::Throttle;
+    uint64_t register_progress_notifier(std::function<SyncProgressNotifierCallback>, NotifierType, bool is_streaming,
+                                        ProgressThrottle throttle = {});
+
+    // Get the current upload or download rate and an estimate of the time
+    // until the transfer completes, calculated from recent progress updates.
+    using TransferEstimate = _impl::SyncProgressNotifier::TransferEstimate;
+    TransferEstimate transfer_estimate(NotifierType direction) const;
 
     // Unregister a previously registered notifier. If the token is invalid,
     // this method does nothing.
@@ -185,7 +261,8 @@ public:
     // Specifically:
     // If the sync session is currently `Dying`, ask it to stay alive instead.
     // If the sync session is currently `WaitingForAccessToken`, cancel any deferred close.
-    // If the sync session is currently `Inactive`, recreate it.
+    // If the sync session is currently `Inactive`, recreate it. If SyncManager is limiting how many sessions
+    // can start at once, this may wait in `WaitingForAccessToken` for a slot before asking for a token.
     // Otherwise, a no-op.
     void revive_if_needed();
 
@@ -333,6 +410,12 @@ private:
     void cancel_pending_waits(std::unique_lock<std::mutex>&);
     enum class ShouldBackup { yes, no };
     void update_error_and_mark_file_for_deletion(SyncError&, ShouldBackup);
+    // Restart the session with an in-place client reset if the config asks
+    // for one and one isn't already in progress. Returns false if the error
+    // should be handled by discarding the local file instead.
+    bool reset_in_place();
+    // Destroy the underlying sync session, if any
+    void destroy_sync_session();
     std::string get_recovery_file_path();
     void handle_progress_update(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
 
@@ -344,6 +427,14 @@ private:
     void advance_state(std::unique_lock<std::mutex>& lock, const State&);
 
     void create_sync_session();
+    // Ask the binding for a token for a session which was queued by
+    // revive_if_needed() waiting for a starting slot, which now holds `slot`.
+    // Returns false if the session no longer needs to be started.
+    bool start_queued(uint64_t slot);
+    // Ask for an access token for this session, from the user's access token
+    // request handler if one has been set and from the binding's bind session
+    // handler otherwise. Must be called without m_state_mutex held.
+    void request_access_token();
     void unregister(std::unique_lock<std::mutex>& lock);
     void did_drop_external_reference();
 
@@ -361,16 +452,37 @@ private:
 
     SyncConfig m_config;
     bool m_force_client_reset;
+    // Set while an in-place client reset requested by reset_in_place() is in
+    // progress, until the session next becomes inactive
+    bool m_resetting_in_place = false;
 
     std::string m_realm_path;
     _impl::SyncClient& m_client;
 
-    // For storing wait-for-completion requests if the session isn't yet ready to handle them.
-    struct CompletionWaitPackage {
+    // The wait-for-completion handlers for one direction, grouped by the id of
+    // the wait request to the underlying session which will complete them. At
+    // most one request is outstanding at a time, and handlers added while it's
+    // waiting are completed by the next one, so each completion of the
+    // underlying session only has to look at the groups it covers, and the
+    // handlers are held here rather than in the session while it isn't bound.
+    struct CompletionWaiters {
         void(sync::Session::*waiter)(std::function<void(std::error_code)>);
-        std::function<void(std::error_code)> callback;
+        std::map<uint64_t, std::vector<std::function<void(std::error_code)>>> groups;
+        uint64_t next_request_id = 1;
+        // The id of the request in progress, or 0 if there isn't one
+        uint64_t outstanding_request_id = 0;
     };
-    std::vector<CompletionWaitPackage> m_completion_wait_packages;
+    CompletionWaiters m_upload_waiters;
+    CompletionWaiters m_download_waiters;
+
+    CompletionWaiters& completion_waiters(void(sync::Session::*)(std::function<void(std::error_code)>));
+    // Ask the underlying session to complete the pending handlers if there are
+    // any and no request is outstanding. Must be called with the state lock held.
+    void request_completion(CompletionWaiters&);
+    void handle_completion(CompletionWaiters&, uint64_t request_id, std::error_code);
+    // Take all of the pending handlers and forget any outstanding requests, so
+    // that they can be cancelled. Must be called with the state lock held.
+    std::vector<std::function<void(std::error_code)>> take_completion_waiters();
 
     struct ServerOverride {
         std::string address;
@@ -392,11 +504,26 @@ private:
     util::Optional<int_fast64_t> m_deferred_commit_notification;
     bool m_deferred_close = false;
 
+    // The SyncManager starting slot this session holds, or 0, and whether it's
+    // queued waiting for one (see SyncManager::set_max_starting_sessions()).
+    // The slot may have already been released by timing out.
+    uint64_t m_start_slot = 0;
+    bool m_start_queued = false;
+
     // The fully-resolved URL of this Realm, including the server and the path.
     util::Optional<std::string> m_server_url;
 
     std::string m_multiplex_identity;
 
+    // The server and multiplex identity of the current sync session's connection,
+    // as registered with SyncManager::open_server_connection()
+    std::string m_connection_server;
+    std::string m_connection_identity;
+    // How many times the sync session has connected after already having been
+    // connected. Only updated on the sync client's thread.
+    bool m_has_connected = false;
+    std::atomic<uint64_t> m_reconnect_count{0};
+
     _impl::SyncProgressNotifier m_progress_notifier;
     ConnectionChangeNotifier m_connection_change_notifier;
 
@@ -19,14 +19,20 @@
 #include "sync/sync_user.hpp"
 
 #include "sync/impl/sync_metadata.hpp"
+#include "sync/sync_config.hpp"
 #include "sync/sync_manager.hpp"
 #include "sync/sync_session.hpp"
 
+#include <algorithm>
+
 namespace realm {
 
 SyncUserContextFactory SyncUser::s_binding_context_factory;
 std::mutex SyncUser::s_binding_context_factory_mutex;
 
+std::function<SyncAccessTokenRequestHandler> SyncUser::s_access_token_request_handler;
+std::mutex SyncUser::s_access_token_request_handler_mutex;
+
 SyncUser::SyncUser(std::string refresh_token,
                    std::string identity,
                    util::Optional<std::string> server_url,
@@ -63,21 +69,37 @@ SyncUser::SyncUser(std::string refresh_token,
 
 std::vector<std::shared_ptr<SyncSession>> SyncUser::all_sessions()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
     std::vector<std::shared_ptr<SyncSession>> sessions;
-    if (m_state == State::Error) {
+    auto snapshot = m_session_snapshot.load();
+    if (!snapshot)
         return sessions;
+    sessions.reserve(snapshot->size());
+    for (auto& weak_session : *snapshot) {
+        if (auto session = weak_session.lock())
+            sessions.emplace_back(std::move(session));
+    }
+    return sessions;
+}
+
+void SyncUser::update_session_snapshot()
+{
+    if (m_state == State::Error || m_sessions.empty()) {
+        m_session_snapshot.exchange(nullptr);
+        return;
     }
+
+    auto snapshot = std::make_shared<std::vector<std::weak_ptr<SyncSession>>>();
+    snapshot->reserve(m_sessions.size());
     for (auto it = m_sessions.begin(); it != m_sessions.end();) {
-        if (auto ptr_to_session = it->second.lock()) {
-            sessions.emplace_back(std::move(ptr_to_session));
-            it++;
+        if (it->second.expired()) {
+            // This session is bad, destroy it.
+            it = m_sessions.erase(it);
             continue;
         }
-        // This session is bad, destroy it.
-        it = m_sessions.erase(it);
+        snapshot->push_back(it->second);
+        ++it;
     }
-    return sessions;
+    m_session_snapshot.exchange(std::move(snapshot));
 }
 
 std::shared_ptr<SyncSession> SyncUser::session_for_on_disk_path(const std::string& path)
@@ -94,6 +116,7 @@ std::shared_ptr<SyncSession> SyncUser::session_for_on_disk_path(const std::strin
     if (!locked) {
         // Remove the session from the map, because it has fatally errored out or the entry is invalid.
         m_sessions.erase(it);
+        update_session_snapshot();
     }
     return locked;
 }
@@ -126,6 +149,7 @@ void SyncUser::update_refresh_token(std::string token)
                     }
                 }
                 m_waiting_sessions.clear();
+                update_session_snapshot();
                 break;
             }
         }
@@ -165,6 +189,12 @@ void SyncUser::log_out()
         }
     }
     m_sessions.clear();
+    update_session_snapshot();
+    {
+        // Tokens fetched for the old login shouldn't be given to anyone
+        std::lock_guard<std::mutex> token_lock(m_access_token_request_mutex);
+        m_access_token_requests.clear();
+    }
     // Deactivate the sessions for the management and admin Realms.
     if (auto session = m_management_session.lock())
         session->log_out();
@@ -196,6 +226,7 @@ void SyncUser::invalidate()
 {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_state = State::Error;
+    update_session_snapshot();
 }
 
 std::string SyncUser::refresh_token() const
@@ -218,6 +249,7 @@ void SyncUser::register_session(std::shared_ptr<SyncSession> session)
         case State::Active:
             // Immediately ask the session to come online.
             m_sessions[path] = session;
+            update_session_snapshot();
             lock.unlock();
             session->revive_if_needed();
             break;
@@ -235,6 +267,68 @@ void SyncUser::set_binding_context_factory(SyncUserContextFactory factory)
     s_binding_context_factory = std::move(factory);
 }
 
+void SyncUser::set_access_token_request_handler(std::function<SyncAccessTokenRequestHandler> handler)
+{
+    std::lock_guard<std::mutex> lock(s_access_token_request_handler_mutex);
+    s_access_token_request_handler = std::move(handler);
+}
+
+bool SyncUser::request_access_token(std::shared_ptr<SyncSession> const& session)
+{
+    std::function<SyncAccessTokenRequestHandler> handler;
+    {
+        std::lock_guard<std::mutex> lock(s_access_token_request_handler_mutex);
+        if (!s_access_token_request_handler)
+            return false;
+        handler = s_access_token_request_handler;
+    }
+
+    auto server_url = session->config().server_url();
+    {
+        std::lock_guard<std::mutex> lock(m_access_token_request_mutex);
+        auto it = m_access_token_requests.find(server_url);
+        if (it != m_access_token_requests.end()) {
+            // Piggyback on the request which is already in flight
+            auto& waiting = it->second;
+            bool already_waiting = std::any_of(waiting.begin(), waiting.end(), [&](auto const& weak_session) {
+                return weak_session.lock() == session;
+            });
+            if (!already_waiting)
+                waiting.push_back(session);
+            return true;
+        }
+        m_access_token_requests[server_url].push_back(session);
+    }
+    handler(session->config().user, server_url);
+    return true;
+}
+
+void SyncUser::complete_access_token_request(std::string const& server_url, std::string access_token)
+{
+    std::vector<std::weak_ptr<SyncSession>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(m_access_token_request_mutex);
+        auto it = m_access_token_requests.find(server_url);
+        if (it == m_access_token_requests.end())
+            return;
+        waiting = std::move(it->second);
+        m_access_token_requests.erase(it);
+    }
+
+    // Sessions are bound without holding the lock so that ones which need
+    // another token (e.g. because the token was rejected) can start a new request
+    for (auto& weak_session : waiting) {
+        if (auto session = weak_session.lock())
+            session->refresh_access_token(access_token, session->config().realm_url());
+    }
+}
+
+void SyncUser::fail_access_token_request(std::string const& server_url)
+{
+    std::lock_guard<std::mutex> lock(m_access_token_request_mutex);
+    m_access_token_requests.erase(server_url);
+}
+
 void SyncUser::register_management_session(const std::string& path)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -19,6 +19,7 @@
 #ifndef REALM_OS_SYNC_USER_HPP
 #define REALM_OS_SYNC_USER_HPP
 
+#include <functional>
 #include <string>
 #include <memory>
 #include <unordered_map>
@@ -42,6 +43,12 @@ public:
 
 using SyncUserContextFactory = std::function<std::shared_ptr<SyncUserContext>()>;
 
+class SyncUser;
+// Fetch a single access token for `user` which is valid for all of the user's
+// Realms on the server at `server_url` (scheme, host and port), and pass it
+// to `SyncUser::complete_access_token_request()`.
+using SyncAccessTokenRequestHandler = void(std::shared_ptr<SyncUser> user, std::string const& server_url);
+
 // A struct that uniquely identifies a user. Consists of ROS identity and auth server URL.
 struct SyncUserIdentifier {
     std::string user_id;
@@ -77,8 +84,24 @@ public:
              TokenType token_type=TokenType::Normal);
 
     // Return a list of all sessions belonging to this user.
+    // This reads a snapshot of the sessions, so it neither waits for nor
+    // delays sessions being registered or the user logging in or out.
     std::vector<std::shared_ptr<SyncSession>> all_sessions();
 
+    // Call `fn` with each session belonging to this user, as all_sessions()
+    // does but without building a vector of them.
+    template<typename Fn>
+    void for_each_session(Fn&& fn) const
+    {
+        auto sessions = m_session_snapshot.load();
+        if (!sessions)
+            return;
+        for (auto& weak_session : *sessions) {
+            if (auto session = weak_session.lock())
+                fn(session);
+        }
+    }
+
     // Return a session for a given on disk path.
     // In most cases, bindings shouldn't expose this to consumers, since the on-disk
     // path for a synced Realm is an opaque implementation detail. This API is retained
@@ -141,6 +164,29 @@ public:
     // Optionally set a context factory. If so, must be set before any sessions are created.
     static void set_binding_context_factory(SyncUserContextFactory factory);
 
+    // Optionally set a handler which fetches access tokens for all of a user's
+    // sessions on a server at once. If set, sessions which need an access
+    // token ask their user for one rather than calling their config's
+    // `bind_session_handler`, and the user coalesces the requests: the
+    // handler is called once for each user and server with no request already
+    // in flight, and every session which asks for a token for that server
+    // before the request is completed is given the token it is completed with.
+    static void set_access_token_request_handler(std::function<SyncAccessTokenRequestHandler> handler);
+
+    // Give the access token fetched for `server_url` to every session waiting
+    // for one, and end the request so that the next session which needs a
+    // token starts a new one.
+    void complete_access_token_request(std::string const& server_url, std::string access_token);
+    // End the request for `server_url` without a token. The waiting sessions
+    // remain waiting for an access token, and will ask for one again when
+    // they are next revived or reconnected.
+    void fail_access_token_request(std::string const& server_url);
+
+    // Ask for an access token for `session` via the access token request
+    // handler. Returns false if no handler is set.
+    // Note that this is called by the SyncSession, and should not be directly called.
+    bool request_access_token(std::shared_ptr<SyncSession> const& session);
+
     // Internal APIs. Do not call.
     void register_management_session(const std::string&);
     void register_permission_session(const std::string&);
@@ -149,6 +195,9 @@ private:
     static SyncUserContextFactory s_binding_context_factory;
     static std::mutex s_binding_context_factory_mutex;
 
+    static std::function<SyncAccessTokenRequestHandler> s_access_token_request_handler;
+    static std::mutex s_access_token_request_handler_mutex;
+
     State m_state;
 
     util::AtomicSharedPtr<SyncUserContext> m_binding_context;
@@ -185,6 +234,19 @@ private:
 
     // Waiting sessions are those that should be asked to connect once this user is logged in.
     std::unordered_map<std::string, std::weak_ptr<SyncSession>> m_waiting_sessions;
+
+    // An immutable copy of the live entries in m_sessions, which is replaced
+    // whenever m_sessions is changed so that readers never take m_mutex. Null
+    // if there are none or the user is in the error state.
+    util::AtomicSharedPtr<const std::vector<std::weak_ptr<SyncSession>>> m_session_snapshot;
+    // Rebuild m_session_snapshot. Must be called with m_mutex held.
+    void update_session_snapshot();
+
+    // Protects m_access_token_requests
+    std::mutex m_access_token_request_mutex;
+    // The sessions waiting on the in-flight access token request for each
+    // server URL. An entry exists only while a request is in flight.
+    std::unordered_map<std::string, std::vector<std::weak_ptr<SyncSession>>> m_access_token_requests;
 };
 
 }
@@ -26,6 +26,8 @@
 
 #include <realm/util/scope_exit.hpp>
 
+#include <algorithm>
+
 using namespace realm;
 
 ThreadSafeReferenceBase::ThreadSafeReferenceBase(SharedRealm source_realm) : m_source_realm(std::move(source_realm))
@@ -104,6 +106,65 @@ Object ThreadSafeReference<Object>::import_into_realm(SharedRealm realm) && {
     });
 }
 
+static std::shared_ptr<Realm> const& source_realm_for(std::vector<Object> const& objects)
+{
+    if (objects.empty())
+        throw std::invalid_argument("Cannot obtain a thread safe reference to an empty batch of objects.");
+    auto& realm = objects.front().realm();
+    for (auto& object : objects) {
+        if (object.realm() != realm)
+            throw MismatchedRealmException("Cannot obtain a thread safe reference to objects from different Realms.");
+    }
+    return realm;
+}
+
+ThreadSafeReference<std::vector<Object>>::ThreadSafeReference(std::vector<Object> const& objects)
+: ThreadSafeReferenceBase(source_realm_for(objects))
+{
+    auto& shared_group = get_source_shared_group();
+    m_rows.reserve(objects.size());
+    for (auto& object : objects) {
+        auto& name = object.get_object_schema().name;
+        auto it = std::find_if(m_types.begin(), m_types.end(), [&](auto& type) { return type.name == name; });
+        if (it == m_types.end())
+            it = m_types.insert(m_types.end(), ObjectType{name, nullptr});
+
+        auto row = object.row();
+        if (!row.is_attached()) {
+            m_rows.emplace_back(it - m_types.begin(), npos);
+            continue;
+        }
+        if (!it->table)
+            it->table = shared_group.export_table_for_handover(TableRef(row.get_table()));
+        m_rows.emplace_back(it - m_types.begin(), row.get_index());
+    }
+}
+
+std::vector<Object> ThreadSafeReference<std::vector<Object>>::import_into_realm(SharedRealm realm) && {
+    return invalidate_after_import<std::vector<Object>>(*realm, [&](SharedGroup& shared_group) {
+        std::vector<TableRef> tables;
+        std::vector<ObjectSchema const*> object_schemas;
+        tables.reserve(m_types.size());
+        object_schemas.reserve(m_types.size());
+        for (auto& type : m_types) {
+            tables.push_back(type.table ? shared_group.import_table_from_handover(std::move(type.table)) : TableRef());
+            auto object_schema = realm->schema().find(type.name);
+            REALM_ASSERT_DEBUG(object_schema != realm->schema().end());
+            object_schemas.push_back(&*object_schema);
+        }
+
+        std::vector<Object> objects;
+        objects.reserve(m_rows.size());
+        for (auto& row : m_rows) {
+            if (row.second == npos)
+                objects.emplace_back(realm, *object_schemas[row.first], RowExpr());
+            else
+                objects.emplace_back(realm, *object_schemas[row.first], tables[row.first]->get(row.second));
+        }
+        return objects;
+    });
+}
+
 ThreadSafeReference<Results>::ThreadSafeReference(Results const& results)
 : ThreadSafeReferenceBase(results.get_realm())
 , m_query(get_source_shared_group().export_for_handover(results.get_query(), ConstSourcePayload::Copy))
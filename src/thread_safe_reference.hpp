@@ -22,6 +22,9 @@
 
 #include <realm/group_shared.hpp>
 
+#include <string>
+#include <vector>
+
 namespace realm {
 class LinkView;
 class List;
@@ -95,6 +98,32 @@ class ThreadSafeReference<Object>: public ThreadSafeReferenceBase {
     Object import_into_realm(std::shared_ptr<Realm> realm) &&;
 };
 
+// A batch of Objects handed over together, which pins a single version and
+// exports each of their tables once rather than exporting every row
+// separately. The Objects may be of different types, and Objects which have
+// been deleted are imported as invalid Objects.
+template<>
+class ThreadSafeReference<std::vector<Object>>: public ThreadSafeReferenceBase {
+    friend class Realm;
+
+    struct ObjectType {
+        std::string name;
+        // Null if the only Objects of this type in the batch were invalid
+        std::unique_ptr<SharedGroup::Handover<Table>> table;
+    };
+    std::vector<ObjectType> m_types;
+    // The index in m_types and the row index of each Object, with npos as the
+    // row index for invalid Objects
+    std::vector<std::pair<size_t, size_t>> m_rows;
+
+    // Precondition: The associated Realm is for the current thread and is not in a write transaction;.
+    // Throws if the batch is empty or the Objects don't all belong to the same Realm.
+    ThreadSafeReference(std::vector<Object> const& value);
+
+    // Precondition: Realm and handover are on same version.
+    std::vector<Object> import_into_realm(std::shared_ptr<Realm> realm) &&;
+};
+
 template<>
 class ThreadSafeReference<Results>: public ThreadSafeReferenceBase {
     friend class Realm;
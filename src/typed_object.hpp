@@ -0,0 +1,544 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_TYPED_OBJECT_HPP
+#define REALM_OS_TYPED_OBJECT_HPP
+
+#include "feature_checks.hpp"
+#include "object.hpp"
+#include "object_schema.hpp"
+#include "object_store.hpp"
+#include "property.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/table.hpp>
+#include <realm/timestamp.hpp>
+#include <realm/util/format.hpp>
+#include <realm/util/optional.hpp>
+
+#if REALM_ENABLE_SYNC
+#include <realm/sync/object.hpp>
+#endif // REALM_ENABLE_SYNC
+
+#include <array>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Accessors for objects described by a C++ struct, for C++ code which would
+// otherwise have to use Object with a CppContext. The struct's properties are
+// listed by specializing ObjectModel, and each member is mapped to a column
+// once when a TypedTable is created, so reading or writing a property neither
+// boxes the value nor switches on the property's type at runtime:
+//
+//     struct Person {
+//         std::string name;
+//         int64_t age;
+//         util::Optional<std::string> nickname;
+//     };
+//
+//     namespace realm {
+//     template<> struct ObjectModel<Person> {
+//         static StringData object_type() { return "person"; }
+//         static constexpr auto properties()
+//         {
+//             return std::make_tuple(typed_property("name", &Person::name),
+//                                    typed_property("age", &Person::age),
+//                                    typed_property("nickname", &Person::nickname));
+//         }
+//     };
+//     }
+//
+//     TypedTable<Person> people(realm);
+//     auto person = people.create(Person{"Alice", 30, util::none});
+//     int64_t age = person.get<REALM_MEMBER(&Person::age)>();
+//     person.set<REALM_MEMBER(&Person::age)>(31);
+//
+// Members may be bool, int64_t, float, double, std::string or Timestamp, or
+// util::Optional of any of these for nullable properties. Links, lists and
+// linking objects properties need to be accessed through Object.
+
+// Expands to the template arguments naming a member for TypedObject::get()
+// and set(), as C++14 can't deduce the type of a non-type template parameter
+#define REALM_MEMBER(member) decltype(member), member
+
+namespace realm {
+// Specialized for each model struct to name its object type and properties
+template<typename Model>
+struct ObjectModel;
+
+// A property stored in a member of a model struct
+template<typename Model, typename T>
+struct TypedProperty {
+    const char* name;
+    T Model::* member;
+};
+
+template<typename Model, typename T>
+constexpr TypedProperty<Model, T> typed_property(const char* name, T Model::* member)
+{
+    return {name, member};
+}
+
+// How to read and write a member of type T, and the property type it maps to
+template<typename T>
+struct TypedPropertyTraits;
+
+template<typename T>
+struct TypedScalarTraits {
+    static T get(Table const& table, size_t col, size_t row) { return table.get<T>(col, row); }
+    static void set(Table& table, size_t col, size_t row, T const& value) { table.set(col, row, value); }
+};
+
+template<>
+struct TypedPropertyTraits<bool> : TypedScalarTraits<bool> {
+    static constexpr PropertyType property_type = PropertyType::Bool;
+};
+
+template<>
+struct TypedPropertyTraits<int64_t> : TypedScalarTraits<int64_t> {
+    static constexpr PropertyType property_type = PropertyType::Int;
+};
+
+template<>
+struct TypedPropertyTraits<float> : TypedScalarTraits<float> {
+    static constexpr PropertyType property_type = PropertyType::Float;
+};
+
+template<>
+struct TypedPropertyTraits<double> : TypedScalarTraits<double> {
+    static constexpr PropertyType property_type = PropertyType::Double;
+};
+
+template<>
+struct TypedPropertyTraits<Timestamp> : TypedScalarTraits<Timestamp> {
+    static constexpr PropertyType property_type = PropertyType::Date;
+};
+
+template<>
+struct TypedPropertyTraits<std::string> {
+    static constexpr PropertyType property_type = PropertyType::String;
+    static std::string get(Table const& table, size_t col, size_t row)
+    {
+        return std::string(table.get_string(col, row));
+    }
+    static void set(Table& table, size_t col, size_t row, std::string const& value)
+    {
+        table.set_string(col, row, value);
+    }
+};
+
+template<typename T>
+struct TypedPropertyTraits<util::Optional<T>> {
+    static constexpr PropertyType property_type = TypedPropertyTraits<T>::property_type | PropertyType::Nullable;
+    static util::Optional<T> get(Table const& table, size_t col, size_t row)
+    {
+        if (table.is_null(col, row))
+            return util::none;
+        return TypedPropertyTraits<T>::get(table, col, row);
+    }
+    static void set(Table& table, size_t col, size_t row, util::Optional<T> const& value)
+    {
+        if (value)
+            TypedPropertyTraits<T>::set(table, col, row, *value);
+        else
+            table.set_null(col, row);
+    }
+};
+
+namespace _impl {
+template<typename>
+struct MemberType;
+template<typename Model, typename T>
+struct MemberType<T Model::*> {
+    using type = T;
+};
+
+template<typename Model, typename T, typename U>
+constexpr bool is_same_member(T Model::*, U Model::*)
+{
+    return false;
+}
+template<typename Model, typename T>
+constexpr bool is_same_member(T Model::* a, T Model::* b)
+{
+    return a == b;
+}
+
+// The index in `properties` of the property stored in `member`, or the
+// number of properties if there isn't one
+template<size_t I, typename Properties, typename Member>
+constexpr std::enable_if_t<(I == std::tuple_size<Properties>::value), size_t>
+index_of_member(Properties const&, Member)
+{
+    return I;
+}
+template<size_t I, typename Properties, typename Member>
+constexpr std::enable_if_t<(I < std::tuple_size<Properties>::value), size_t>
+index_of_member(Properties const& properties, Member member)
+{
+    return is_same_member(std::get<I>(properties).member, member) ? I
+         : index_of_member<I + 1>(properties, member);
+}
+
+template<typename Properties, typename Func, size_t... I>
+void for_each_property(Properties const& properties, Func&& fn, std::index_sequence<I...>)
+{
+    using expand = int[];
+    (void)expand{0, (fn(std::integral_constant<size_t, I>(), std::get<I>(properties)), 0)...};
+}
+
+// Only integers and strings can be primary keys, so these are only ever
+// called for members of those types
+inline size_t find_primary_key(Table const& table, size_t col, int64_t value)
+{
+    return table.find_first_int(col, value);
+}
+inline size_t find_primary_key(Table const& table, size_t col, util::Optional<int64_t> value)
+{
+    return value ? table.find_first_int(col, *value) : table.find_first_null(col);
+}
+inline size_t find_primary_key(Table const& table, size_t col, std::string const& value)
+{
+    return table.find_first_string(col, value);
+}
+inline size_t find_primary_key(Table const& table, size_t col, util::Optional<std::string> const& value)
+{
+    return value ? table.find_first_string(col, *value) : table.find_first_null(col);
+}
+// Arguments to get_for_primary_key() which aren't exactly one of the types
+// above, such as an `int` or a string literal, are converted rather than
+// falling through to the overload for members which can't be primary keys
+template<typename T>
+using IsIntegerKey = std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value>;
+template<typename T>
+using IsStringKey = std::integral_constant<bool, !IsIntegerKey<T>::value && std::is_convertible<T const&, StringData>::value>;
+
+template<typename T>
+std::enable_if_t<IsIntegerKey<T>::value, size_t> find_primary_key(Table const& table, size_t col, T const& value)
+{
+    return table.find_first_int(col, static_cast<int64_t>(value));
+}
+template<typename T>
+std::enable_if_t<IsStringKey<T>::value, size_t> find_primary_key(Table const& table, size_t col, T const& value)
+{
+    return table.find_first_string(col, StringData(value));
+}
+template<typename T>
+std::enable_if_t<!IsIntegerKey<T>::value && !IsStringKey<T>::value, size_t>
+find_primary_key(Table const&, size_t, T const&)
+{
+    REALM_UNREACHABLE();
+}
+
+inline size_t create_with_primary_key(Group& group, Table& table, size_t col, util::Optional<int64_t> value)
+{
+#if REALM_ENABLE_SYNC
+    return sync::create_object_with_primary_key(group, table, value);
+#else
+    static_cast<void>(group);
+    size_t row = table.add_empty_row();
+    if (value)
+        table.set_unique(col, row, *value);
+    else
+        table.set_null_unique(col, row);
+    return row;
+#endif // REALM_ENABLE_SYNC
+}
+inline size_t create_with_primary_key(Group& group, Table& table, size_t col, int64_t value)
+{
+    return create_with_primary_key(group, table, col, util::Optional<int64_t>(value));
+}
+inline size_t create_with_primary_key(Group& group, Table& table, size_t col, StringData value)
+{
+#if REALM_ENABLE_SYNC
+    static_cast<void>(col);
+    return sync::create_object_with_primary_key(group, table, value);
+#else
+    static_cast<void>(group);
+    size_t row = table.add_empty_row();
+    table.set_unique(col, row, value);
+    return row;
+#endif // REALM_ENABLE_SYNC
+}
+inline size_t create_with_primary_key(Group& group, Table& table, size_t col, std::string const& value)
+{
+    return create_with_primary_key(group, table, col, StringData(value));
+}
+inline size_t create_with_primary_key(Group& group, Table& table, size_t col, util::Optional<std::string> const& value)
+{
+    return create_with_primary_key(group, table, col, value ? StringData(*value) : StringData());
+}
+template<typename T>
+size_t create_with_primary_key(Group&, Table&, size_t, T const&)
+{
+    REALM_UNREACHABLE();
+}
+
+inline std::string print_primary_key(int64_t value)
+{
+    return std::to_string(value);
+}
+inline std::string print_primary_key(util::Optional<int64_t> value)
+{
+    return value ? std::to_string(*value) : "null";
+}
+inline std::string print_primary_key(std::string const& value)
+{
+    return value;
+}
+inline std::string print_primary_key(util::Optional<std::string> const& value)
+{
+    return value ? *value : "null";
+}
+template<typename T>
+std::string print_primary_key(T const&)
+{
+    REALM_UNREACHABLE();
+}
+} // namespace _impl
+
+template<typename Model>
+class TypedObject;
+
+// The table for a model type in a Realm, with the column for each of the
+// model's properties. Throws when created if the Realm's schema doesn't have
+// a matching property for each one.
+template<typename Model>
+class TypedTable {
+    using Properties = decltype(ObjectModel<Model>::properties());
+    static constexpr size_t property_count = std::tuple_size<Properties>::value;
+
+public:
+    explicit TypedTable(SharedRealm realm);
+
+    SharedRealm const& realm() const noexcept { return m_realm; }
+    ObjectSchema const& object_schema() const noexcept { return *m_object_schema; }
+    ConstTableRef table() const noexcept { return m_table; }
+    size_t size() const { return m_table->size(); }
+
+    // Get the object at the given row index
+    TypedObject<Model> get(size_t row_ndx) const;
+
+    // Create a new object from `value`. For types with a primary key, an
+    // existing object with the same primary key is updated if `update` is
+    // set, and otherwise an exception is thrown.
+    TypedObject<Model> create(Model const& value, bool update = false) const;
+
+    // Get the object with the given primary key, which is invalid if there isn't one
+    template<typename T>
+    TypedObject<Model> get_for_primary_key(T const& primary_key) const;
+
+private:
+    friend class TypedObject<Model>;
+
+    SharedRealm m_realm;
+    ObjectSchema const* m_object_schema;
+    TableRef m_table;
+    std::array<size_t, property_count> m_columns;
+    size_t m_primary_key_index = npos;
+
+    void write(size_t row_ndx, Model const& value, bool skip_primary) const;
+};
+
+// An accessor for an object of a model type. Must not outlive the TypedTable
+// it was obtained from.
+template<typename Model>
+class TypedObject {
+    using Properties = typename TypedTable<Model>::Properties;
+
+public:
+    TypedObject(TypedTable<Model> const& table, RowExpr row) : m_table(&table), m_row(row) { }
+
+    bool is_valid() const { return m_row.is_attached(); }
+    Row const& row() const noexcept { return m_row; }
+
+    // Read or write the property stored in the given member
+    template<typename Member, Member member>
+    typename _impl::MemberType<Member>::type get() const;
+    template<typename Member, Member member>
+    void set(typename _impl::MemberType<Member>::type const& value);
+
+    // Read all of the object's properties
+    Model get() const;
+    // Write all of the object's properties other than the primary key
+    void set(Model const& value);
+
+private:
+    TypedTable<Model> const* m_table;
+    Row m_row;
+
+    template<typename Member, Member member>
+    static constexpr size_t index_of()
+    {
+        constexpr size_t index = _impl::index_of_member<0>(ObjectModel<Model>::properties(), member);
+        static_assert(index < std::tuple_size<Properties>::value, "Member is not a property of the model");
+        return index;
+    }
+
+    void verify_attached() const;
+};
+
+template<typename Model>
+TypedTable<Model>::TypedTable(SharedRealm realm)
+: m_realm(std::move(realm))
+{
+    StringData object_type = ObjectModel<Model>::object_type();
+    auto it = m_realm->schema().find(object_type);
+    if (it == m_realm->schema().end())
+        throw std::logic_error(util::format("Object type '%1' not found in schema.", object_type));
+    m_object_schema = &*it;
+    m_table = ObjectStore::table_for_object_type(m_realm->read_group(), object_type);
+
+    auto fn = [&](auto index, auto const& typed_prop) {
+        using T = typename _impl::MemberType<decltype(typed_prop.member)>::type;
+        auto prop = m_object_schema->property_for_name(typed_prop.name);
+        if (!prop)
+            throw InvalidPropertyException(m_object_schema->name, typed_prop.name);
+        if (to_underlying(prop->type) != to_underlying(TypedPropertyTraits<T>::property_type))
+            throw std::logic_error(util::format("Property '%1.%2' of type '%3' does not match the type of its member.",
+                                                m_object_schema->name, prop->name, prop->type_string()));
+        m_columns[index] = prop->table_column;
+        if (prop->is_primary)
+            m_primary_key_index = index;
+    };
+    _impl::for_each_property(ObjectModel<Model>::properties(), fn, std::make_index_sequence<property_count>());
+}
+
+template<typename Model>
+TypedObject<Model> TypedTable<Model>::get(size_t row_ndx) const
+{
+    m_realm->verify_thread();
+    return TypedObject<Model>(*this, m_table->get(row_ndx));
+}
+
+template<typename Model>
+template<typename T>
+TypedObject<Model> TypedTable<Model>::get_for_primary_key(T const& primary_key) const
+{
+    m_realm->verify_thread();
+    if (m_primary_key_index == npos)
+        throw MissingPrimaryKeyException(m_object_schema->name);
+    size_t row_ndx = _impl::find_primary_key(*m_table, m_columns[m_primary_key_index], primary_key);
+    return TypedObject<Model>(*this, row_ndx == npos ? RowExpr() : m_table->get(row_ndx));
+}
+
+template<typename Model>
+TypedObject<Model> TypedTable<Model>::create(Model const& value, bool update) const
+{
+    m_realm->verify_in_write();
+
+    if (m_primary_key_index == npos) {
+#if REALM_ENABLE_SYNC
+        size_t row_ndx = sync::create_object(m_realm->read_group(), *m_table);
+#else
+        size_t row_ndx = m_table->add_empty_row();
+#endif // REALM_ENABLE_SYNC
+        write(row_ndx, value, false);
+        return TypedObject<Model>(*this, m_table->get(row_ndx));
+    }
+
+    size_t row_ndx = npos;
+    auto fn = [&](auto index, auto const& typed_prop) {
+        if (index != m_primary_key_index)
+            return;
+        auto& primary_key = value.*typed_prop.member;
+        size_t col = m_columns[index];
+        row_ndx = _impl::find_primary_key(*m_table, col, primary_key);
+        if (row_ndx == npos)
+            row_ndx = _impl::create_with_primary_key(m_realm->read_group(), *m_table, col, primary_key);
+        else if (!update)
+            throw std::logic_error(util::format("Attempting to create an object of type '%1' with an existing primary key value '%2'.",
+                                                m_object_schema->name, _impl::print_primary_key(primary_key)));
+    };
+    _impl::for_each_property(ObjectModel<Model>::properties(), fn, std::make_index_sequence<property_count>());
+    write(row_ndx, value, true);
+    return TypedObject<Model>(*this, m_table->get(row_ndx));
+}
+
+template<typename Model>
+void TypedTable<Model>::write(size_t row_ndx, Model const& value, bool skip_primary) const
+{
+    auto fn = [&](auto index, auto const& typed_prop) {
+        using T = typename _impl::MemberType<decltype(typed_prop.member)>::type;
+        if (skip_primary && index == m_primary_key_index)
+            return;
+        TypedPropertyTraits<T>::set(*m_table, m_columns[index], row_ndx, value.*typed_prop.member);
+    };
+    _impl::for_each_property(ObjectModel<Model>::properties(), fn, std::make_index_sequence<property_count>());
+}
+
+template<typename Model>
+void TypedObject<Model>::verify_attached() const
+{
+    m_table->m_realm->verify_thread();
+    if (!m_row.is_attached())
+        throw InvalidatedObjectException(m_table->m_object_schema->name);
+}
+
+template<typename Model>
+template<typename Member, Member member>
+typename _impl::MemberType<Member>::type TypedObject<Model>::get() const
+{
+    using T = typename _impl::MemberType<Member>::type;
+    constexpr size_t index = index_of<Member, member>();
+    verify_attached();
+    return TypedPropertyTraits<T>::get(*m_row.get_table(), m_table->m_columns[index], m_row.get_index());
+}
+
+template<typename Model>
+template<typename Member, Member member>
+void TypedObject<Model>::set(typename _impl::MemberType<Member>::type const& value)
+{
+    using T = typename _impl::MemberType<Member>::type;
+    constexpr size_t index = index_of<Member, member>();
+    verify_attached();
+    auto& realm = *m_table->m_realm;
+    realm.verify_in_write();
+    // As with Object, primary keys can only be changed in migrations
+    if (index == m_table->m_primary_key_index && !realm.is_in_migration())
+        throw ModifyPrimaryKeyException(m_table->m_object_schema->name, std::get<index>(ObjectModel<Model>::properties()).name);
+    TypedPropertyTraits<T>::set(*m_row.get_table(), m_table->m_columns[index], m_row.get_index(), value);
+}
+
+template<typename Model>
+Model TypedObject<Model>::get() const
+{
+    verify_attached();
+    Model value;
+    auto fn = [&](auto index, auto const& typed_prop) {
+        using T = typename _impl::MemberType<decltype(typed_prop.member)>::type;
+        value.*typed_prop.member = TypedPropertyTraits<T>::get(*m_row.get_table(), m_table->m_columns[index], m_row.get_index());
+    };
+    _impl::for_each_property(ObjectModel<Model>::properties(), fn,
+                             std::make_index_sequence<std::tuple_size<Properties>::value>());
+    return value;
+}
+
+template<typename Model>
+void TypedObject<Model>::set(Model const& value)
+{
+    verify_attached();
+    m_table->m_realm->verify_in_write();
+    m_table->write(m_row.get_index(), value, true);
+}
+} // namespace realm
+
+#endif // REALM_OS_TYPED_OBJECT_HPP
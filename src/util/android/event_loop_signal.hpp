@@ -17,6 +17,7 @@
 ////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
@@ -74,7 +75,8 @@ public:
     {
         if (m_looper) {
             init();
-            notify_fd(m_message_pipe.write);
+            if (!m_pending.exchange(true))
+                notify_fd(m_message_pipe.write);
         }
     }
 
@@ -86,6 +88,9 @@ private:
     std::weak_ptr<EventLoopSignal> m_weak;
     // Flag to avoid checking the weak_ptr.
     bool inited = false;
+    // Set by notify() until the callback is next called, so that any further
+    // notifications before then don't write to the pipe again.
+    std::atomic<bool> m_pending{false};
 
     // We cannot unregister in the looper callback since it may not be called at all (eg. IntentService).
     // And we have to ensure the looper callback has a valid this pointer to use.
@@ -162,6 +167,10 @@ private:
                 // ALOOPER_EVENT_INPUT will be triggered.
                 std::vector<uint8_t> buff(1024);
                 read(fd, buff.data(), buff.size());
+                // Cleared after emptying the pipe and before calling the
+                // callback, so that a notify() from here on writes to the pipe
+                // again and is not missed.
+                shared->m_pending = false;
                 // By holding a shared_ptr, this object won't be destroyed in the m_callback.
                 shared->m_callback();
             }
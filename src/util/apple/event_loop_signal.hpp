@@ -26,15 +26,14 @@ class EventLoopSignal {
 public:
     EventLoopSignal(Callback&& callback)
     {
-        struct RefCountedRunloopCallback {
-            Callback callback;
-            std::atomic<size_t> ref_count;
-        };
-
         CFRunLoopSourceContext ctx{};
-        ctx.info = new RefCountedRunloopCallback{std::move(callback), {0}};
+        auto info = new RefCountedRunloopCallback{std::move(callback), {0}, {false}};
+        m_pending = &info->pending;
+        ctx.info = info;
         ctx.perform = [](void* info) {
-            static_cast<RefCountedRunloopCallback*>(info)->callback();
+            auto& data = *static_cast<RefCountedRunloopCallback*>(info);
+            data.pending = false;
+            data.callback();
         };
         ctx.retain = [](const void* info) {
             static_cast<RefCountedRunloopCallback*>(const_cast<void*>(info))->ref_count.fetch_add(1, std::memory_order_relaxed);
@@ -67,6 +66,8 @@ public:
 
     void notify()
     {
+        if (m_pending->exchange(true))
+            return;
         CFRunLoopSourceSignal(m_signal);
         // Signalling the source makes it run the next time the runloop gets
         // to it, but doesn't make the runloop start if it's currently idle
@@ -75,8 +76,18 @@ public:
     }
 
 private:
+    struct RefCountedRunloopCallback {
+        Callback callback;
+        std::atomic<size_t> ref_count;
+        // Set by notify() until the callback is next called, so that any
+        // further notifications before then don't signal the source again
+        std::atomic<bool> pending;
+    };
+
     CFRunLoopRef m_runloop;
     CFRunLoopSourceRef m_signal;
+    // Owned by the source's info, which lives at least as long as m_signal
+    std::atomic<bool>* m_pending;
 };
 } // namespace util
 } // namespace realm
@@ -19,70 +19,167 @@
 #ifndef REALM_ATOMIC_SHARED_PTR_HPP
 #define REALM_ATOMIC_SHARED_PTR_HPP
 
+#include <realm/util/assert.hpp>
+
 #include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <type_traits>
 
 namespace realm {
 namespace _impl {
-
-// Check if std::atomic_load has an overload taking a std::shared_ptr, and set
-// HasAtomicPtrOps to either true_type or false_type
-
-template<typename... Ts> struct make_void { typedef void type; };
-template<typename... Ts> using void_t = typename make_void<Ts...>::type;
-
-template<typename, typename = void_t<>>
-struct HasAtomicPtrOps : std::false_type { };
-
-template<class T>
-struct HasAtomicPtrOps<T, void_t<decltype(std::atomic_load(std::declval<T*>()))>> : std::true_type { };
+// The lock-free implementation packs a pointer into the low 48 bits and a
+// reference count into the top 16 bits of a single 64-bit word, so it can
+// only be used where 64-bit atomics are themselves lock-free and on
+// architectures whose user-space addresses are known to fit in 48 bits.
+// Everywhere else falls back to the mutex-based implementation.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64)
+constexpr bool pointers_fit_in_48_bits = true;
+#else
+constexpr bool pointers_fit_in_48_bits = sizeof(void*) <= 4;
+#endif
+using CanUseSplitRefCount = std::integral_constant<bool, ATOMIC_LLONG_LOCK_FREE == 2 && pointers_fit_in_48_bits>;
 } // namespace _impl
 
 namespace util {
 // A wrapper for std::shared_ptr that enables sharing a shared_ptr instance
 // (and not just a thing *pointed to* by a shared_ptr) between threads. Is
-// lock-free iff the underlying shared_ptr implementation supports atomic
-// operations. Currently the only implemented operation other than copy/move
-// construction/assignment is exchange().
-template<typename T, bool = _impl::HasAtomicPtrOps<std::shared_ptr<T>>::value>
+// lock-free wherever 64-bit atomics are, and falls back to guarding the
+// shared_ptr with a mutex elsewhere. Currently the only implemented operations
+// other than copy/move construction/assignment are load() and exchange().
+template<typename T, bool = _impl::CanUseSplitRefCount::value>
 class AtomicSharedPtr;
 
+// The lock-free implementation uses a split reference count. The shared_ptr
+// lives in a heap-allocated node, and the atomic word holds both a pointer to
+// the node and a count of the loads which are currently reading from it.
+// load() bumps that count with a CAS to pin the node before copying the
+// shared_ptr out of it, and then gives the reference back, either by
+// decrementing the count in the word if it still points at the same node or
+// by decrementing the node's own count if the node has been swapped out in
+// the meantime. Whoever swaps a node out transfers the outstanding loads from
+// the word to the node's count, and whoever brings the node's count to zero
+// deletes it. Nodes are never reinstalled once swapped out and can't be
+// freed while any load still references them, so there's no ABA problem.
 template<typename T>
 class AtomicSharedPtr<T, true> {
 public:
     AtomicSharedPtr() = default;
-    AtomicSharedPtr(std::shared_ptr<T> ptr) : m_ptr(std::move(ptr)) { }
+    AtomicSharedPtr(std::shared_ptr<T> ptr) : m_head(make_head(std::move(ptr))) { }
 
-    AtomicSharedPtr(AtomicSharedPtr const& ptr) : m_ptr(std::atomic_load(&ptr.m_ptr)) { }
-    AtomicSharedPtr(AtomicSharedPtr&& ptr) : m_ptr(std::atomic_exchange(&ptr.m_ptr, {})) { }
+    AtomicSharedPtr(AtomicSharedPtr const& ptr) : m_head(make_head(ptr.load())) { }
+    AtomicSharedPtr(AtomicSharedPtr&& ptr) : m_head(ptr.m_head.exchange(0, std::memory_order_acq_rel)) { }
+
+    ~AtomicSharedPtr()
+    {
+        release(m_head.load(std::memory_order_acquire));
+    }
 
     AtomicSharedPtr& operator=(AtomicSharedPtr const& ptr)
     {
         if (&ptr != this) {
-            std::atomic_store(&m_ptr, std::atomic_load(&ptr.m_ptr));
+            exchange(ptr.load());
         }
         return *this;
     }
 
     AtomicSharedPtr& operator=(AtomicSharedPtr&& ptr)
     {
-        std::atomic_store(&m_ptr, std::atomic_exchange(&ptr.m_ptr, {}));
+        if (&ptr != this) {
+            auto head = ptr.m_head.exchange(0, std::memory_order_acq_rel);
+            release(m_head.exchange(head, std::memory_order_acq_rel));
+        }
         return *this;
     }
 
     std::shared_ptr<T> exchange(std::shared_ptr<T> ptr)
     {
-        return std::atomic_exchange(&m_ptr, std::move(ptr));
+        auto old_head = m_head.exchange(make_head(std::move(ptr)), std::memory_order_acq_rel);
+        // The word's own reference keeps the node alive until release()
+        std::shared_ptr<T> ret;
+        if (auto node = get_node(old_head))
+            ret = node->value;
+        release(old_head);
+        return ret;
     }
 
     std::shared_ptr<T> load() const noexcept
     {
-        return std::atomic_load(&m_ptr);
+        auto head = m_head.load(std::memory_order_relaxed);
+        while (head && !m_head.compare_exchange_weak(head, head + s_count_one,
+                                                     std::memory_order_acquire, std::memory_order_relaxed)) {
+        }
+        auto node = get_node(head);
+        if (!node)
+            return nullptr;
+
+        std::shared_ptr<T> ret = node->value;
+
+        // Hand our reference back to the word if it still points at our node,
+        // and to the node itself if it has since been swapped out
+        head += s_count_one;
+        while (get_node(head) == node) {
+            if (m_head.compare_exchange_weak(head, head - s_count_one,
+                                             std::memory_order_release, std::memory_order_relaxed))
+                return ret;
+        }
+        if (node->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete node;
+        return ret;
     }
 
 private:
-    std::shared_ptr<T> m_ptr = nullptr;
+    struct Node {
+        Node(std::shared_ptr<T> value) : value(std::move(value)) { }
+
+        std::shared_ptr<T> value;
+        // Goes negative while the node is installed, as loads which finish
+        // after it was swapped out give their references back here
+        std::atomic<std::int64_t> count{0};
+    };
+
+    // The top 16 bits hold the count and the bottom 48 the pointer (see
+    // CanUseSplitRefCount for where that's enough). Each load() only holds a
+    // reference for as long as it takes to copy the shared_ptr, so 16 bits is
+    // plenty for the number of concurrent loads.
+    static constexpr int s_count_shift = 48;
+    static constexpr std::uint64_t s_count_one = std::uint64_t(1) << s_count_shift;
+    static constexpr std::uint64_t s_pointer_mask = s_count_one - 1;
+
+    // Zero for null, otherwise the node with a count of one for the word's
+    // own reference
+    mutable std::atomic<std::uint64_t> m_head{0};
+
+    static Node* get_node(std::uint64_t head) noexcept
+    {
+        return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(head & s_pointer_mask));
+    }
+
+    static std::uint64_t make_head(std::shared_ptr<T> ptr)
+    {
+        if (!ptr)
+            return 0;
+        auto node = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(new Node(std::move(ptr))));
+        // Checked in release builds too, as a pointer which doesn't fit would
+        // be silently corrupted by the first load()
+        REALM_ASSERT_RELEASE((node & ~s_pointer_mask) == 0);
+        return node | s_count_one;
+    }
+
+    // Drop the word's reference to a node which has been swapped out
+    static void release(std::uint64_t head) noexcept
+    {
+        auto node = get_node(head);
+        if (!node)
+            return;
+        // The word's count is one for its own reference plus one for each
+        // load() which pinned the node and will give its reference back to
+        // the node's count
+        auto outstanding = static_cast<std::int64_t>(head >> s_count_shift) - 1;
+        if (node->count.fetch_add(outstanding, std::memory_order_acq_rel) + outstanding == 0)
+            delete node;
+    }
 };
 
 template<typename T>
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_COPY_ON_WRITE_HPP
+#define REALM_OS_UTIL_COPY_ON_WRITE_HPP
+
+#include <realm/util/assert.hpp>
+
+#include <memory>
+
+namespace realm {
+namespace util {
+// A value which is shared between copies of the CopyOnWrite until one of them
+// is modified, at which point the one being modified makes its own copy of
+// the value. Only const access is available without going through mutate().
+//
+// Copies may be used from a single thread only, as the check for whether the
+// value is shared is not synchronized with copies being made or destroyed.
+template<typename T>
+class CopyOnWrite {
+public:
+    CopyOnWrite() = default;
+    CopyOnWrite(T&& value) : m_value(std::make_shared<T>(std::move(value))) { }
+
+    CopyOnWrite& operator=(T&& value)
+    {
+        if (m_value && m_value.use_count() == 1)
+            *m_value = std::move(value);
+        else
+            m_value = std::make_shared<T>(std::move(value));
+        return *this;
+    }
+
+    T const& operator*() const noexcept
+    {
+        REALM_ASSERT_DEBUG(m_value);
+        return *m_value;
+    }
+    T const* operator->() const noexcept { return &**this; }
+
+    // Get a modifiable reference to the value, copying it first if it's
+    // shared with any other CopyOnWrite
+    T& mutate()
+    {
+        if (!m_value)
+            m_value = std::make_shared<T>();
+        else if (m_value.use_count() > 1)
+            m_value = std::make_shared<T>(*m_value);
+        return *m_value;
+    }
+
+    // Is the value shared with some other CopyOnWrite?
+    bool is_shared() const noexcept { return m_value && m_value.use_count() > 1; }
+
+private:
+    std::shared_ptr<T> m_value;
+};
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_COPY_ON_WRITE_HPP
@@ -21,8 +21,12 @@
 
 #include "util/event_loop_signal.hpp"
 
-#include <mutex>
-#include <queue>
+#include <realm/util/scope_exit.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
 #include <tuple>
 
 namespace realm {
@@ -43,11 +47,22 @@ namespace util {
 template <class F>
 class EventLoopDispatcher;
 
+// Wraps a function so that calling it from any thread invokes the wrapped
+// function on the thread which created the dispatcher, via that thread's
+// event loop. Invocations made while the target thread is busy are all run in
+// a single wakeup of the event loop, in the order they were made.
 template <typename... Args>
 class EventLoopDispatcher<void(Args...)> {
     using Tuple = std::tuple<typename std::remove_reference<Args>::type...>;
 private:
     struct Callback;
+    using SignalPtr = std::shared_ptr<EventLoopSignal<Callback>>;
+
+    // A pending invocation, linked into State::m_pending
+    struct Invocation {
+        Tuple args;
+        Invocation* next;
+    };
 
     struct State {
     public:
@@ -56,28 +71,62 @@ private:
         {
         }
 
+        ~State()
+        {
+            delete_invocations(m_pending.exchange(nullptr));
+            delete m_keep_alive.exchange(nullptr);
+        }
+
         const std::function<void(Args...)> m_func;
-        std::queue<Tuple> m_invocations;
-        std::mutex m_mutex;
-        std::shared_ptr<EventLoopSignal<Callback>> m_signal;
+        // Pending invocations, most recent first. Pushed to by any number of
+        // threads and taken as a whole by the target thread.
+        std::atomic<Invocation*> m_pending{nullptr};
+        // Set by whichever producer signals the target thread, and cleared by
+        // the target thread before it takes the pending invocations, so that
+        // only one signal is outstanding at a time
+        std::atomic<bool> m_signalled{false};
+        // Keeps the signal alive while it's outstanding even if the dispatcher
+        // is destroyed. Set by the producer which set m_signalled and taken by
+        // the target thread before clearing it.
+        std::atomic<SignalPtr*> m_keep_alive{nullptr};
     };
     const std::shared_ptr<State> m_state;
 
+    static void delete_invocations(Invocation* invocation) noexcept
+    {
+        while (invocation) {
+            auto next = invocation->next;
+            delete invocation;
+            invocation = next;
+        }
+    }
+
     struct Callback {
         void operator()()
         {
-            std::unique_lock<std::mutex> lock(m_state->m_mutex);
-            while (!m_state->m_invocations.empty()) {
-                auto& tuple = m_state->m_invocations.front();
-                _apply_polyfill::apply(tuple, m_state->m_func);
-                m_state->m_invocations.pop();
+            std::unique_ptr<SignalPtr> keep_alive(m_state->m_keep_alive.exchange(nullptr));
+            m_state->m_signalled = false;
+
+            // Reverse the list to run the invocations in the order they were made
+            Invocation* invocations = nullptr;
+            for (auto invocation = m_state->m_pending.exchange(nullptr); invocation; ) {
+                auto next = invocation->next;
+                invocation->next = invocations;
+                invocations = invocation;
+                invocation = next;
+            }
+
+            auto cleanup = util::make_scope_exit([&]() noexcept { delete_invocations(invocations); });
+            while (invocations) {
+                std::unique_ptr<Invocation> invocation(invocations);
+                invocations = invocation->next;
+                _apply_polyfill::apply(std::move(invocation->args), m_state->m_func);
             }
-            m_state->m_signal.reset();
         }
 
         std::shared_ptr<State> m_state;
     };
-    const std::shared_ptr<EventLoopSignal<Callback>> m_signal;
+    const SignalPtr m_signal;
     const std::thread::id m_thread = std::this_thread::get_id();
 
 public:
@@ -96,12 +145,14 @@ public:
             return;
         }
 
-        {
-            std::unique_lock<std::mutex> lock(m_state->m_mutex);
-            m_state->m_signal = m_signal;
-            m_state->m_invocations.push(std::make_tuple(args...));
+        auto invocation = new Invocation{std::make_tuple(args...), m_state->m_pending.load()};
+        while (!m_state->m_pending.compare_exchange_weak(invocation->next, invocation))
+            ;
+
+        if (!m_state->m_signalled.exchange(true)) {
+            delete m_state->m_keep_alive.exchange(new SignalPtr(m_signal));
+            m_signal->notify();
         }
-        m_signal->notify();
     }
 };
 } // namespace util
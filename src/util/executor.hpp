@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_EXECUTOR_HPP
+#define REALM_OS_UTIL_EXECUTOR_HPP
+
+#include <functional>
+
+namespace realm {
+namespace util {
+
+// Something which can run tasks posted from other threads, such as a thread
+// pool or an asio io_context. Setting one as Realm::Config::notification_executor
+// makes the Realm's notifications be delivered by posting tasks to it rather
+// than by signalling the opening thread's event loop.
+//
+// The tasks posted for a Realm must not run concurrently with each other or
+// with any other use of that Realm, e.g. by running them on a strand.
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    // Schedule `task` to be run on the executor. Can be called from any thread.
+    virtual void post(std::function<void()> task) = 0;
+
+    // Check if the calling thread is currently running on the executor, and
+    // so is allowed to use Realms which are bound to it.
+    virtual bool is_current() const { return true; }
+};
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_EXECUTOR_HPP
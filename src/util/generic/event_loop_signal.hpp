@@ -16,6 +16,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <atomic>
 #include <utility>
 #include <functional>
 #include <memory>
@@ -41,11 +42,20 @@ namespace util {
 
         void notify()
         {
-            m_eventloop->post(m_callback);
+            if (m_pending->exchange(true))
+                return;
+            m_eventloop->post([pending = m_pending, callback = m_callback]() mutable {
+                *pending = false;
+                callback();
+            });
         }
     private:
         Callback m_callback;
         std::unique_ptr<GenericEventLoop> m_eventloop;
+        // Set by notify() until the posted callback runs, so that any further
+        // notifications before then don't post it again. Shared with the posted
+        // function as it may run after this signal has been destroyed.
+        std::shared_ptr<std::atomic<bool>> m_pending = std::make_shared<std::atomic<bool>>(false);
     };
 
 } // namespace util
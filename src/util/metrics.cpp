@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#include "util/metrics.hpp"
+
+namespace realm {
+namespace util {
+
+constexpr size_t MetricHistogram::bucket_count;
+
+HistogramSnapshot MetricHistogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    snapshot.buckets.reserve(bucket_count);
+    for (auto& bucket : m_buckets) {
+        snapshot.buckets.push_back(bucket.load(std::memory_order_relaxed));
+        snapshot.count += snapshot.buckets.back();
+    }
+    snapshot.sum = m_sum.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::string PrometheusWriter::label(const char* name, std::string const& value)
+{
+    std::string label = name;
+    label += "=\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\': label += "\\\\"; break;
+            case '"':  label += "\\\""; break;
+            case '\n': label += "\\n"; break;
+            default:   label += c; break;
+        }
+    }
+    label += '"';
+    return label;
+}
+
+std::string const& PrometheusWriter::text() const
+{
+    m_text.clear();
+    for (auto& family : m_families)
+        m_text += family;
+    return m_text;
+}
+
+std::string& PrometheusWriter::family(std::string const& name, const char* help, const char* type)
+{
+    auto it = m_family_index.find(name);
+    if (it != m_family_index.end())
+        return m_families[it->second];
+
+    m_family_index.emplace(name, m_families.size());
+    m_families.push_back("# HELP " + name + " " + help + "\n# TYPE " + name + " " + type + "\n");
+    return m_families.back();
+}
+
+void PrometheusWriter::sample(std::string& out, std::string const& name, std::string const& labels, uint64_t value)
+{
+    out += name;
+    if (!labels.empty())
+        out += "{" + labels + "}";
+    out += " " + std::to_string(value) + "\n";
+}
+
+void PrometheusWriter::counter(std::string const& name, const char* help, uint64_t value, std::string const& labels)
+{
+    sample(family(name, help, "counter"), name, labels, value);
+}
+
+void PrometheusWriter::gauge(std::string const& name, const char* help, uint64_t value, std::string const& labels)
+{
+    sample(family(name, help, "gauge"), name, labels, value);
+}
+
+void PrometheusWriter::histogram(std::string const& name, const char* help, HistogramSnapshot const& histogram,
+                                 std::string const& labels)
+{
+    auto& out = family(name, help, "histogram");
+    std::string separator = labels.empty() ? "" : ",";
+    uint64_t cumulative = 0;
+    // Prometheus buckets are cumulative, and the last one is reported as +Inf
+    for (size_t i = 0; i + 1 < histogram.buckets.size(); ++i) {
+        cumulative += histogram.buckets[i];
+        sample(out, name + "_bucket", labels + separator + "le=\"" + std::to_string(HistogramSnapshot::upper_bound(i)) + "\"",
+               cumulative);
+    }
+    sample(out, name + "_bucket", labels + separator + "le=\"+Inf\"", histogram.count);
+    sample(out, name + "_sum", labels, histogram.sum);
+    sample(out, name + "_count", labels, histogram.count);
+}
+
+} // namespace util
+} // namespace realm
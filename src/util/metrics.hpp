@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef REALM_OS_UTIL_METRICS_HPP
+#define REALM_OS_UTIL_METRICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace realm {
+namespace util {
+
+// A count of events which can be incremented from any thread. Only relaxed
+// atomic operations are used, as the values are only read as a snapshot for
+// reporting and don't order anything else.
+class MetricCounter {
+public:
+    void add(uint64_t count = 1) noexcept { m_value.fetch_add(count, std::memory_order_relaxed); }
+    uint64_t get() const noexcept { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value{0};
+};
+
+// The samples recorded by a MetricHistogram at some point in time. Bucket `i`
+// counts the samples which were at most upper_bound(i), and weren't counted
+// by an earlier bucket. The last bucket has no upper bound.
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    static uint64_t upper_bound(size_t bucket) noexcept { return uint64_t(1) << bucket; }
+};
+
+// A distribution of values with power of two bucket boundaries, so recording
+// a sample is a couple of relaxed atomic increments with no locking.
+class MetricHistogram {
+public:
+    static constexpr size_t bucket_count = 32;
+
+    void record(uint64_t value) noexcept
+    {
+        size_t bucket = 0;
+        while (bucket + 1 < bucket_count && HistogramSnapshot::upper_bound(bucket) < value)
+            ++bucket;
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Samples recorded while taking the snapshot may or may not be included
+    HistogramSnapshot snapshot() const;
+
+private:
+    std::atomic<uint64_t> m_buckets[bucket_count] = {};
+    std::atomic<uint64_t> m_sum{0};
+};
+
+// Builds metrics in the Prometheus text exposition format, for serving from
+// an app's own metrics endpoint. Several sources can be written to the same
+// writer, with labels such as the Realm path to tell them apart. The samples
+// for each metric are grouped together under a single help and type, in the
+// order the metrics were first written, as the format requires.
+class PrometheusWriter {
+public:
+    void counter(std::string const& name, const char* help, uint64_t value, std::string const& labels = {});
+    void gauge(std::string const& name, const char* help, uint64_t value, std::string const& labels = {});
+    void histogram(std::string const& name, const char* help, HistogramSnapshot const& histogram,
+                   std::string const& labels = {});
+
+    std::string const& text() const;
+
+    // Format a label for passing to the above functions, escaping the value
+    static std::string label(const char* name, std::string const& value);
+
+private:
+    // Each metric's help and type followed by all of its samples so far
+    std::vector<std::string> m_families;
+    std::unordered_map<std::string, size_t> m_family_index;
+    mutable std::string m_text;
+
+    std::string& family(std::string const& name, const char* help, const char* type);
+    static void sample(std::string& out, std::string const& name, std::string const& labels, uint64_t value);
+};
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_METRICS_HPP
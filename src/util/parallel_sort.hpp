@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_PARALLEL_SORT_HPP
+#define REALM_OS_UTIL_PARALLEL_SORT_HPP
+
+#include "util/thread_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace realm {
+namespace util {
+
+// Sort `values` with `less` using the threads of `pool`, producing the same
+// result as std::stable_sort(). The values are split into one run per thread
+// which are each stable sorted, and then adjacent runs are merged pairwise
+// until there's only one left. Merging favors the earlier run for equivalent
+// elements, so the relative order of equivalent elements is preserved.
+//
+// `less` is called concurrently from multiple threads.
+template<typename T, typename Compare>
+void parallel_stable_sort(std::vector<T>& values, Compare const& less, ThreadPool& pool)
+{
+    size_t run_count = std::min(pool.size() + 1, values.size() / 2);
+    if (run_count < 2) {
+        std::stable_sort(values.begin(), values.end(), less);
+        return;
+    }
+
+    // bounds[i] is the start of run i, and the last element is the end of the last run
+    std::vector<size_t> bounds(run_count + 1);
+    for (size_t i = 0; i <= run_count; ++i)
+        bounds[i] = values.size() * i / run_count;
+
+    auto begin = values.begin();
+    std::vector<std::function<void()>> jobs;
+    jobs.reserve(run_count);
+    for (size_t i = 0; i < run_count; ++i) {
+        jobs.push_back([&, i] {
+            std::stable_sort(begin + bounds[i], begin + bounds[i + 1], less);
+        });
+    }
+    pool.run_all(std::move(jobs));
+
+    while (bounds.size() > 2) {
+        size_t runs = bounds.size() - 1;
+        std::vector<size_t> next_bounds;
+        next_bounds.reserve(runs / 2 + 2);
+        jobs.clear();
+        for (size_t i = 0; i + 1 < runs; i += 2) {
+            // Each merge covers a separate range of the vector, so all of the
+            // merges for a round can run at once
+            jobs.push_back([&, i] {
+                std::inplace_merge(begin + bounds[i], begin + bounds[i + 1], begin + bounds[i + 2], less);
+            });
+            next_bounds.push_back(bounds[i]);
+        }
+        if (runs % 2)
+            next_bounds.push_back(bounds[runs - 1]);
+        next_bounds.push_back(bounds.back());
+        pool.run_all(std::move(jobs));
+        bounds = std::move(next_bounds);
+    }
+}
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_PARALLEL_SORT_HPP
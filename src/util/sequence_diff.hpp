@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_SEQUENCE_DIFF_HPP
+#define REALM_OS_UTIL_SEQUENCE_DIFF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace realm {
+namespace util {
+
+// Find a longest common subsequence of two sequences of the given sizes, where
+// `equal(i, j)` reports if element `i` of the old sequence is the same as
+// element `j` of the new one. Returns the (old, new) index pairs of the common
+// elements in ascending order; everything else is an insertion or deletion.
+//
+// The common prefix and suffix are matched directly and only the remainder is
+// diffed using Myers' O((N+M)D) algorithm. If more than `max_edits` insertions
+// and deletions would be needed in the remainder it is given up on, and only
+// the prefix and suffix are returned, as finding the shortest edit script
+// between two very different sequences isn't worth the time it takes.
+template<typename Equal>
+std::vector<std::pair<size_t, size_t>> common_subsequence(size_t old_size, size_t new_size,
+                                                          Equal&& equal, size_t max_edits = 1000)
+{
+    std::vector<std::pair<size_t, size_t>> matches;
+
+    size_t prefix = 0;
+    while (prefix < old_size && prefix < new_size && equal(prefix, prefix)) {
+        matches.emplace_back(prefix, prefix);
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < old_size - prefix && suffix < new_size - prefix
+           && equal(old_size - suffix - 1, new_size - suffix - 1))
+        ++suffix;
+
+    auto add_suffix = [&] {
+        for (size_t i = suffix; i > 0; --i)
+            matches.emplace_back(old_size - i, new_size - i);
+    };
+
+    // Myers' algorithm over the part between the prefix and suffix, with x
+    // indexing the old elements and y the new ones. v[k] holds the furthest x
+    // reached on diagonal k = x - y, and trace[d] holds v[-d-1...d+1] from
+    // before step d, which is what's needed to walk the path back afterwards.
+    using Index = std::ptrdiff_t;
+    const Index n = old_size - prefix - suffix;
+    const Index m = new_size - prefix - suffix;
+    const Index limit = std::min<Index>(n + m, max_edits);
+    std::vector<Index> v(2 * limit + 3);
+    const Index offset = limit + 1;
+    std::vector<std::vector<Index>> trace;
+
+    bool found = n == 0 && m == 0;
+    for (Index d = 0; !found && d <= limit; ++d) {
+        trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+        for (Index k = -d; k <= d; k += 2) {
+            Index x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                x = v[offset + k + 1];
+            else
+                x = v[offset + k - 1] + 1;
+            Index y = x - k;
+            while (x < n && y < m && equal(prefix + x, prefix + y)) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found) {
+        add_suffix();
+        return matches;
+    }
+
+    std::vector<std::pair<size_t, size_t>> middle;
+    Index x = n, y = m;
+    for (Index d = trace.size() - 1; d >= 0; --d) {
+        auto& prev = trace[d];
+        // prev[0] is v[-d-1]
+        auto get = [&](Index k) { return prev[k + d + 1]; };
+        Index k = x - y;
+        Index prev_k = (k == -d || (k != d && get(k - 1) < get(k + 1))) ? k + 1 : k - 1;
+        Index prev_x = get(prev_k);
+        Index prev_y = prev_x - prev_k;
+        while (x > prev_x && y > prev_y) {
+            --x;
+            --y;
+            middle.emplace_back(prefix + x, prefix + y);
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+
+    matches.insert(matches.end(), middle.rbegin(), middle.rend());
+    add_suffix();
+    return matches;
+}
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_SEQUENCE_DIFF_HPP
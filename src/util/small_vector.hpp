@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_SMALL_VECTOR_HPP
+#define REALM_OS_UTIL_SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace realm {
+namespace util {
+// A vector which stores up to N elements inline before falling back to a heap
+// allocation. Only the subset of the std::vector interface needed by its
+// users is implemented. Unlike std::vector, moving a SmallVector which is using
+// its inline storage invalidates pointers to its elements.
+template<typename T, size_t N>
+class SmallVector {
+    static_assert(N > 0, "SmallVector must have inline capacity");
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = T&;
+    using const_reference = T const&;
+    using iterator = T*;
+    using const_iterator = T const*;
+
+    SmallVector() noexcept = default;
+    SmallVector(std::initializer_list<T> values) { assign(values.begin(), values.end()); }
+    SmallVector(SmallVector const& other) { assign(other.begin(), other.end()); }
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) { take(other); }
+    ~SmallVector() { clear(); deallocate(); }
+
+    SmallVector& operator=(SmallVector const& other)
+    {
+        if (this != &other)
+            assign(other.begin(), other.end());
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if (this != &other) {
+            clear();
+            deallocate();
+            take(other);
+        }
+        return *this;
+    }
+
+    iterator begin() noexcept { return m_data; }
+    iterator end() noexcept { return m_data + m_size; }
+    const_iterator begin() const noexcept { return m_data; }
+    const_iterator end() const noexcept { return m_data + m_size; }
+    const_iterator cbegin() const noexcept { return m_data; }
+    const_iterator cend() const noexcept { return m_data + m_size; }
+
+    size_t size() const noexcept { return m_size; }
+    size_t capacity() const noexcept { return m_capacity; }
+    // The number of bytes allocated outside of the inline storage
+    size_t heap_size() const noexcept { return is_inline() ? 0 : m_capacity * sizeof(T); }
+    bool empty() const noexcept { return m_size == 0; }
+
+    T& operator[](size_t ndx) noexcept { return m_data[ndx]; }
+    T const& operator[](size_t ndx) const noexcept { return m_data[ndx]; }
+    T& front() noexcept { return m_data[0]; }
+    T const& front() const noexcept { return m_data[0]; }
+    T& back() noexcept { return m_data[m_size - 1]; }
+    T const& back() const noexcept { return m_data[m_size - 1]; }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity > m_capacity)
+            reallocate(capacity);
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (m_size < m_capacity) {
+            new (m_data + m_size) T(std::forward<Args>(args)...);
+        }
+        else {
+            // Construct the new element before moving the existing ones so
+            // that the arguments can refer to an existing element
+            size_t capacity = m_capacity * 2;
+            T* data = allocate(capacity);
+            try {
+                new (data + m_size) T(std::forward<Args>(args)...);
+            }
+            catch (...) {
+                ::operator delete(data);
+                throw;
+            }
+            move_to(data, capacity);
+        }
+        ++m_size;
+        return back();
+    }
+
+    void push_back(T value) { emplace_back(std::move(value)); }
+
+    void pop_back() noexcept
+    {
+        m_data[--m_size].~T();
+    }
+
+    iterator insert(const_iterator pos, T value)
+    {
+        size_t offset = pos - m_data;
+        emplace_back(std::move(value));
+        std::rotate(m_data + offset, m_data + m_size - 1, m_data + m_size);
+        return m_data + offset;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        size_t offset = pos - m_data;
+        std::move(m_data + offset + 1, m_data + m_size, m_data + offset);
+        pop_back();
+        return m_data + offset;
+    }
+
+    template<typename InputIterator>
+    void assign(InputIterator first, InputIterator last)
+    {
+        clear();
+        for (; first != last; ++first)
+            emplace_back(*first);
+    }
+
+    void resize(size_t size)
+    {
+        reserve(size);
+        while (m_size > size)
+            pop_back();
+        while (m_size < size)
+            emplace_back();
+    }
+
+    void clear() noexcept
+    {
+        while (m_size > 0)
+            pop_back();
+    }
+
+    // Release any unused heap capacity, moving back to the inline storage if
+    // the elements fit in it
+    void shrink_to_fit()
+    {
+        if (is_inline() || m_size == m_capacity)
+            return;
+        if (m_size <= N)
+            move_to(inline_data(), N);
+        else
+            reallocate(m_size);
+    }
+
+private:
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    Storage m_inline[N];
+    T* m_data = inline_data();
+    size_t m_size = 0;
+    size_t m_capacity = N;
+
+    T* inline_data() noexcept { return reinterpret_cast<T*>(&m_inline[0]); }
+    bool is_inline() const noexcept { return m_data == reinterpret_cast<T const*>(&m_inline[0]); }
+
+    static T* allocate(size_t capacity)
+    {
+        return static_cast<T*>(::operator new(capacity * sizeof(T)));
+    }
+
+    void reallocate(size_t capacity)
+    {
+        move_to(allocate(capacity), capacity);
+    }
+
+    // Move the existing elements to `data` and make it the current storage
+    void move_to(T* data, size_t capacity)
+    {
+        for (size_t i = 0; i < m_size; ++i) {
+            new (data + i) T(std::move(m_data[i]));
+            m_data[i].~T();
+        }
+        deallocate();
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void deallocate() noexcept
+    {
+        if (!is_inline())
+            ::operator delete(m_data);
+        m_data = inline_data();
+        m_capacity = N;
+    }
+
+    // Take the contents of `other`; `this` must be empty and using its inline
+    // storage
+    void take(SmallVector& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if (other.is_inline()) {
+            for (size_t i = 0; i < other.m_size; ++i)
+                new (m_data + i) T(std::move(other.m_data[i]));
+            m_size = other.m_size;
+            other.clear();
+            return;
+        }
+
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        other.m_data = other.inline_data();
+        other.m_size = 0;
+        other.m_capacity = N;
+    }
+};
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_SMALL_VECTOR_HPP
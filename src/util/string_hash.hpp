@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_STRING_HASH_HPP
+#define REALM_OS_UTIL_STRING_HASH_HPP
+
+#include <realm/string_data.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace realm {
+namespace util {
+
+// A 64-bit FNV-1a hash of the string's contents, for indexing objects by name
+// without having to copy the name into a std::string to look it up
+inline size_t string_hash(StringData str) noexcept
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < str.size(); ++i) {
+        hash ^= static_cast<unsigned char>(str.data()[i]);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_STRING_HASH_HPP
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "util/thread_pool.hpp"
+
+#include <realm/util/assert.hpp>
+
+using namespace realm;
+using namespace realm::util;
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    m_threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        m_threads.emplace_back([this] {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_work_cv.wait(lock, [&] { return m_stopping || m_next_job < m_jobs.size(); });
+                if (m_stopping)
+                    return;
+                run_jobs(lock);
+            }
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void ThreadPool::run_jobs(std::unique_lock<std::mutex>& lock)
+{
+    while (m_next_job < m_jobs.size()) {
+        auto job = std::move(m_jobs[m_next_job++]);
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            job();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        // Destroy the job before reacquiring the lock as it may own things
+        // which are expensive to destroy
+        job = nullptr;
+        lock.lock();
+
+        if (error && !m_error)
+            m_error = error;
+        if (--m_remaining == 0)
+            m_done_cv.notify_all();
+    }
+}
+
+void ThreadPool::run_all(std::vector<std::function<void()>> jobs)
+{
+    if (jobs.empty())
+        return;
+
+    // No point in waking up another thread if there's only one job
+    if (jobs.size() == 1 || m_threads.empty()) {
+        std::exception_ptr error;
+        for (auto& job : jobs) {
+            try {
+                job();
+            }
+            catch (...) {
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    REALM_ASSERT(m_remaining == 0);
+    m_jobs = std::move(jobs);
+    m_next_job = 0;
+    m_remaining = m_jobs.size();
+    m_error = nullptr;
+    m_work_cv.notify_all();
+
+    run_jobs(lock);
+    m_done_cv.wait(lock, [&] { return m_remaining == 0; });
+
+    m_jobs.clear();
+    m_next_job = 0;
+    if (auto error = std::move(m_error)) {
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
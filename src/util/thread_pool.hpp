@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_THREAD_POOL_HPP
+#define REALM_OS_UTIL_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace realm {
+namespace util {
+
+// A fixed-size pool of threads for running batches of independent jobs.
+//
+// The pool does not have a persistent queue: run_all() hands out the jobs in
+// a single batch to the pool threads plus the calling thread, and returns once
+// all of them have completed. Only one batch can be run at a time.
+class ThreadPool {
+public:
+    // Create a pool with `thread_count` background threads. A pool with zero
+    // threads is valid and simply runs everything on the calling thread.
+    explicit ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    // The number of background threads in the pool. Batches are run with up
+    // to size() + 1 jobs in parallel, as the calling thread also runs jobs.
+    size_t size() const noexcept { return m_threads.size(); }
+
+    // Run each of the given jobs and block until all of them have completed.
+    // If any of the jobs throw, the remaining jobs are still run and then the
+    // first exception thrown is rethrown on the calling thread.
+    void run_all(std::vector<std::function<void()>> jobs);
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+
+    std::vector<std::function<void()>> m_jobs;
+    size_t m_next_job = 0;
+    size_t m_remaining = 0;
+    std::exception_ptr m_error;
+    bool m_stopping = false;
+
+    std::vector<std::thread> m_threads;
+
+    // Run jobs from the current batch until there are none left to claim
+    // precondition: m_mutex is locked by `lock`
+    void run_jobs(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_THREAD_POOL_HPP
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "util/timer_queue.hpp"
+
+using namespace realm;
+using namespace realm::util;
+
+TimerQueue::TimerQueue()
+: m_state(std::make_shared<State>())
+{
+}
+
+TimerQueue::~TimerQueue()
+{
+    State::Timers timers;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stopping = true;
+        timers.swap(m_state->timers);
+        m_state->times.clear();
+    }
+    m_state->cv.notify_all();
+    if (!m_thread.joinable())
+        return;
+    if (m_thread.get_id() == std::this_thread::get_id())
+        m_thread.detach();
+    else
+        m_thread.join();
+}
+
+TimerQueue::Token TimerQueue::schedule(Clock::time_point time, std::function<void()> function)
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto token = m_state->next_token++;
+    bool earliest = m_state->timers.empty() || time < m_state->timers.begin()->first.first;
+    m_state->timers.emplace(std::make_pair(time, token), std::move(function));
+    m_state->times.emplace(token, time);
+    if (!m_thread.joinable())
+        m_thread = std::thread([state = m_state] { run(*state); });
+    else if (earliest)
+        m_state->cv.notify_one();
+    return token;
+}
+
+bool TimerQueue::cancel(Token token)
+{
+    // The function is destroyed without the lock held as it may own things
+    // which use the queue when destroyed
+    std::function<void()> function;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto it = m_state->times.find(token);
+    if (it == m_state->times.end())
+        return false;
+    auto timer = m_state->timers.find({it->second, token});
+    function = std::move(timer->second);
+    m_state->timers.erase(timer);
+    m_state->times.erase(it);
+    return true;
+}
+
+void TimerQueue::cancel_all()
+{
+    State::Timers timers;
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    timers.swap(m_state->timers);
+    m_state->times.clear();
+}
+
+void TimerQueue::run(State& state)
+{
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (!state.stopping) {
+        if (state.timers.empty()) {
+            state.cv.wait(lock);
+            continue;
+        }
+        auto next = state.timers.begin();
+        auto time = next->first.first;
+        if (Clock::now() < time) {
+            state.cv.wait_until(lock, time);
+            continue;
+        }
+
+        auto function = std::move(next->second);
+        state.times.erase(next->first.second);
+        state.timers.erase(next);
+        lock.unlock();
+        function();
+        function = nullptr;
+        lock.lock();
+    }
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef REALM_OS_UTIL_TIMER_QUEUE_HPP
+#define REALM_OS_UTIL_TIMER_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace realm {
+namespace util {
+
+// Runs functions at scheduled times on a single background thread which the
+// queue owns. The thread is started when the first function is scheduled,
+// and the destructor discards anything still pending and joins it, so a
+// function scheduled by an object which owns the queue can't outlive it.
+//
+// Functions are run one at a time without the queue's lock held, so they can
+// schedule or cancel other functions. They must not throw.
+class TimerQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Token = uint64_t;
+
+    TimerQueue();
+    ~TimerQueue();
+
+    TimerQueue(TimerQueue const&) = delete;
+    TimerQueue& operator=(TimerQueue const&) = delete;
+
+    // Run `function` once `time` has passed. The returned token is never 0.
+    Token schedule(Clock::time_point time, std::function<void()> function);
+    Token schedule_after(Clock::duration delay, std::function<void()> function)
+    {
+        return schedule(Clock::now() + delay, std::move(function));
+    }
+
+    // Discard a pending function. Returns false if it has already started
+    // running (which this does not wait for) or was already cancelled.
+    bool cancel(Token token);
+
+    // Discard all of the pending functions
+    void cancel_all();
+
+private:
+    // Everything the thread uses, kept alive by the thread so that a function
+    // can destroy the queue which is running it
+    struct State {
+        using Timers = std::map<std::pair<Clock::time_point, Token>, std::function<void()>>;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        // Ordered by time and then by token, so that functions scheduled for
+        // the same time run in the order they were scheduled
+        Timers timers;
+        std::unordered_map<Token, Clock::time_point> times;
+        Token next_token = 1;
+        bool stopping = false;
+    };
+    std::shared_ptr<State> m_state;
+    std::thread m_thread;
+
+    static void run(State& state);
+};
+
+} // namespace util
+} // namespace realm
+
+#endif // REALM_OS_UTIL_TIMER_QUEUE_HPP
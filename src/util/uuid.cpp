@@ -21,8 +21,8 @@
 #include <algorithm>
 #include <array>
 #include <functional>
+#include <mutex>
 #include <random>
-#include <stdio.h>
 
 namespace {
 
@@ -52,28 +52,83 @@ T create_and_seed_engine()
 namespace realm {
 namespace util {
 
-std::string uuid_string()
+void generate_uuids(UUIDBytes* out, size_t count)
 {
     static auto engine = create_and_seed_engine<std::mt19937>();
+    static std::mutex mutex;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < count; ++i) {
+        auto& uuid = out[i];
+        // Each call to the engine produces 32 random bits, and so four bytes
+        for (size_t j = 0; j < uuid.size(); j += 4) {
+            uint32_t bits = engine();
+            uuid[j] = uint8_t(bits);
+            uuid[j + 1] = uint8_t(bits >> 8);
+            uuid[j + 2] = uint8_t(bits >> 16);
+            uuid[j + 3] = uint8_t(bits >> 24);
+        }
+
+        // Version 4 UUID.
+        uuid[6] = (uuid[6] & 0x0f) | 0x40;
+        // IETF variant.
+        uuid[8] = (uuid[8] & 0x3f) | 0x80;
+    }
+}
+
+UUIDBytes uuid_bytes()
+{
+    UUIDBytes uuid;
+    generate_uuids(&uuid, 1);
+    return uuid;
+}
+
+void format_uuid(UUIDBytes const& uuid, char* out) noexcept
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < uuid.size(); ++i) {
+        // Dashes go before the 4th, 6th, 8th and 10th bytes
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+            *out++ = '-';
+        *out++ = digits[uuid[i] >> 4];
+        *out++ = digits[uuid[i] & 0xf];
+    }
+}
 
-    std::array<uint8_t, 16> uuid_bytes;
-    std::uniform_int_distribution<unsigned int> distribution(0, std::numeric_limits<uint8_t>::max());
-    std::generate(begin(uuid_bytes), end(uuid_bytes), [&] { return distribution(engine); });
+std::string uuid_string()
+{
+    std::string str(uuid_string_length, '\0');
+    format_uuid(uuid_bytes(), &str[0]);
+    return str;
+}
 
-    // Version 4 UUID.
-    uuid_bytes[6] = (uuid_bytes[6] & 0x0f) | 0x40;
-    // IETF variant.
-    uuid_bytes[8] = (uuid_bytes[8] & 0x3f) | 0x80;
+void generate_uuid_strings(char* out, size_t count)
+{
+    // Generate in fixed-size chunks so that large batches don't need a
+    // second buffer of the whole size
+    constexpr size_t chunk_size = 64;
+    std::array<UUIDBytes, chunk_size> uuids;
+    while (count > 0) {
+        size_t n = std::min(count, chunk_size);
+        generate_uuids(uuids.data(), n);
+        for (size_t i = 0; i < n; ++i, out += uuid_string_length)
+            format_uuid(uuids[i], out);
+        count -= n;
+    }
+}
 
-    std::array<char, 37> uuid_formatted;
-    snprintf(uuid_formatted.data(), uuid_formatted.size(),
-             "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-             uuid_bytes[0], uuid_bytes[1], uuid_bytes[2], uuid_bytes[3],
-             uuid_bytes[4], uuid_bytes[5], uuid_bytes[6], uuid_bytes[7],
-             uuid_bytes[8], uuid_bytes[9], uuid_bytes[10], uuid_bytes[11],
-             uuid_bytes[12], uuid_bytes[13], uuid_bytes[14], uuid_bytes[15]);
+std::vector<std::string> uuid_strings(size_t count)
+{
+    std::vector<UUIDBytes> uuids(count);
+    generate_uuids(uuids.data(), count);
 
-    return std::string(uuid_formatted.data(), uuid_formatted.size() - 1);
+    std::vector<std::string> strings;
+    strings.reserve(count);
+    for (auto& uuid : uuids) {
+        strings.emplace_back(uuid_string_length, '\0');
+        format_uuid(uuid, &strings.back()[0]);
+    }
+    return strings;
 }
 
 } // namespace util
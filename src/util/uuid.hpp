@@ -19,14 +19,43 @@
 #ifndef REALM_OS_UTIL_UUID_HPP
 #define REALM_OS_UTIL_UUID_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace realm {
 namespace util {
 
+// The 16 bytes of a UUID, in the order they're formatted
+using UUIDBytes = std::array<uint8_t, 16>;
+
+// The length of a formatted UUID, excluding any null terminator
+constexpr size_t uuid_string_length = 36;
+
 // Generate a random UUID and return its formatted string representation.
 std::string uuid_string();
 
+// Generate a random UUID without formatting it.
+UUIDBytes uuid_bytes();
+
+// Fill `out` with `count` random UUIDs. The random source is only locked once
+// for the whole batch, so this is much cheaper than calling uuid_bytes()
+// `count` times when generating IDs for many new objects at once.
+void generate_uuids(UUIDBytes* out, size_t count);
+
+// Write the formatted form of `uuid` to `out`, which must have room for
+// uuid_string_length chars. No null terminator is written.
+void format_uuid(UUIDBytes const& uuid, char* out) noexcept;
+
+// Generate `count` random UUIDs and write their formatted forms back to back to
+// `out`, which must have room for `count * uuid_string_length` chars.
+void generate_uuid_strings(char* out, size_t count);
+
+// Generate `count` random UUIDs and return their formatted forms.
+std::vector<std::string> uuid_strings(size_t count);
+
 } // namespace util
 } // namespace realm
 
@@ -27,11 +27,14 @@ public:
     struct Data {
         Callback callback;
         std::atomic<bool> close_requested;
+        // Set by notify() until the callback is next called, so that any
+        // further notifications before then don't send another wakeup
+        std::atomic<bool> pending;
     };
 
     EventLoopSignal(Callback&& callback)
     {
-        m_handle->data = new Data { std::move(callback), {false} };
+        m_handle->data = new Data { std::move(callback), {false}, {false} };
 
         // This assumes that only one thread matters: the main thread (default loop).
         uv_async_init(uv_default_loop(), m_handle, [](uv_async_t* handle) {
@@ -42,6 +45,7 @@ public:
                     delete reinterpret_cast<uv_async_t*>(handle);
                 });
             } else {
+                data.pending = false;
                 data.callback();
             }
         });
@@ -60,7 +64,8 @@ public:
 
     void notify()
     {
-        uv_async_send(m_handle);
+        if (!static_cast<Data*>(m_handle->data)->pending.exchange(true))
+            uv_async_send(m_handle);
     }
 
 private:
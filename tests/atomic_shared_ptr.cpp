@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "util/templated_test_case.hpp"
+
+#include "util/atomic_shared_ptr.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace realm;
+
+namespace {
+template<typename T>
+using LockFreeSharedPtr = util::AtomicSharedPtr<T, true>;
+template<typename T>
+using MutexSharedPtr = util::AtomicSharedPtr<T, false>;
+
+struct Counted {
+    static std::atomic<int> live;
+    int value;
+    Counted(int value) : value(value) { ++live; }
+    ~Counted() { --live; }
+};
+std::atomic<int> Counted::live{0};
+
+// Time how long it takes for each reader to perform `loads` loads while
+// another thread continually replaces the pointer
+template<typename Ptr>
+long long time_concurrent_loads(size_t reader_count, size_t loads)
+{
+    Ptr ptr(std::make_shared<Counted>(0));
+    std::atomic<size_t> finished_readers{0};
+    std::vector<std::thread> readers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < reader_count; ++i) {
+        readers.emplace_back([&] {
+            for (size_t j = 0; j < loads; ++j)
+                ptr.load();
+            ++finished_readers;
+        });
+    }
+    for (int i = 0; finished_readers < reader_count; ++i)
+        ptr.exchange(std::make_shared<Counted>(i));
+    for (auto& thread : readers)
+        thread.join();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+} // anonymous namespace
+
+TEMPLATE_TEST_CASE("AtomicSharedPtr", LockFreeSharedPtr<Counted>, MutexSharedPtr<Counted>) {
+    REQUIRE(Counted::live == 0);
+
+    SECTION("default-constructed instances are null") {
+        TestType ptr;
+        REQUIRE_FALSE(ptr.load());
+    }
+
+    SECTION("load() returns the stored pointer") {
+        auto value = std::make_shared<Counted>(5);
+        TestType ptr(value);
+        REQUIRE(ptr.load() == value);
+        REQUIRE(ptr.load() == value);
+        REQUIRE(value.use_count() == 2);
+    }
+
+    SECTION("exchange() returns the previous pointer and releases it once dropped") {
+        TestType ptr(std::make_shared<Counted>(1));
+        auto old = ptr.exchange(std::make_shared<Counted>(2));
+        REQUIRE(old->value == 1);
+        REQUIRE(ptr.load()->value == 2);
+        REQUIRE(Counted::live == 2);
+        old.reset();
+        REQUIRE(Counted::live == 1);
+        REQUIRE(ptr.exchange(nullptr));
+        REQUIRE(Counted::live == 0);
+        REQUIRE_FALSE(ptr.load());
+    }
+
+    SECTION("copying shares the pointer and moving transfers it") {
+        TestType ptr(std::make_shared<Counted>(1));
+        TestType copy(ptr);
+        REQUIRE(copy.load() == ptr.load());
+
+        TestType moved(std::move(copy));
+        REQUIRE(moved.load() == ptr.load());
+        REQUIRE_FALSE(copy.load());
+
+        copy = moved;
+        REQUIRE(copy.load() == ptr.load());
+        moved = std::move(copy);
+        REQUIRE_FALSE(copy.load());
+        REQUIRE(moved.load() == ptr.load());
+        REQUIRE(Counted::live == 1);
+    }
+
+    SECTION("destruction releases the pointer") {
+        {
+            TestType ptr(std::make_shared<Counted>(1));
+            ptr.load();
+        }
+        REQUIRE(Counted::live == 0);
+    }
+
+    SECTION("concurrent loads and exchanges neither lose nor leak values") {
+        {
+            TestType ptr(std::make_shared<Counted>(0));
+            std::atomic<bool> done{false};
+            std::atomic<bool> saw_invalid{false};
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 4; ++i) {
+                threads.emplace_back([&] {
+                    while (!done) {
+                        auto value = ptr.load();
+                        if (!value || value->value < 0)
+                            saw_invalid = true;
+                    }
+                });
+            }
+            for (int i = 0; i < 2; ++i) {
+                threads.emplace_back([&] {
+                    for (int j = 0; j < 10000; ++j)
+                        ptr.exchange(std::make_shared<Counted>(j));
+                });
+            }
+            threads[4].join();
+            threads[5].join();
+            done = true;
+            for (int i = 0; i < 4; ++i)
+                threads[i].join();
+            REQUIRE_FALSE(saw_invalid);
+            REQUIRE(Counted::live == 1);
+        }
+        REQUIRE(Counted::live == 0);
+    }
+}
+
+// Not run by default; run with `tests "[benchmark]"` to compare the two
+// implementations under read-heavy contention
+TEST_CASE("AtomicSharedPtr: lock-free vs mutex", "[.][benchmark]") {
+    const size_t readers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    const size_t loads = 1000000;
+    auto lock_free = time_concurrent_loads<LockFreeSharedPtr<Counted>>(readers, loads);
+    auto mutex = time_concurrent_loads<MutexSharedPtr<Counted>>(readers, loads);
+    std::cout << "AtomicSharedPtr with " << readers << " readers doing " << loads << " loads each: "
+              << "lock-free " << lock_free << "us, mutex " << mutex << "us\n";
+    REQUIRE(Counted::live == 0);
+}
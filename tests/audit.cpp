@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "util/test_file.hpp"
+
+#include "audit.hpp"
+#include "property.hpp"
+#include "results.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+
+#include <realm/group.hpp>
+#include <realm/table.hpp>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace realm;
+
+namespace {
+struct RecordingAudit : AuditInterface {
+    std::mutex mutex;
+    std::vector<AuditReadRecord> reads;
+    size_t batches = 0;
+    size_t queries = 0;
+    size_t writes = 0;
+
+    void record_query(VersionID, TableView const&) override { ++queries; }
+    void record_read(VersionID, RowExpr) override { }
+    void record_write(VersionID, VersionID) override { ++writes; }
+
+    void record_reads(AuditReadRecord const* records, size_t count) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reads.insert(reads.end(), records, records + count);
+        ++batches;
+    }
+};
+}
+
+TEST_CASE("BufferedAuditInterface") {
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"other", {
+            {"value", PropertyType::Int},
+        }},
+    };
+    auto r = Realm::get_shared_realm(config);
+    auto table = r->read_group().get_table("class_object");
+    auto other = r->read_group().get_table("class_other");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    other->add_empty_row(10);
+    r->commit_transaction();
+    auto version = r->read_transaction_version();
+
+    auto target = std::make_shared<RecordingAudit>();
+
+    SECTION("passes reads to the wrapped interface as compact records") {
+        BufferedAuditInterface audit(target, std::chrono::hours(1));
+        audit.record_read(version, table->get(3));
+        audit.record_read(version, other->get(5));
+        audit.flush();
+
+        REQUIRE(target->reads.size() == 2);
+        REQUIRE(target->reads[0].version == version);
+        REQUIRE(target->reads[0].table == table->get_index_in_group());
+        REQUIRE(target->reads[0].row == 3);
+        REQUIRE(target->reads[1].table == other->get_index_in_group());
+        REQUIRE(target->reads[1].row == 5);
+    }
+
+    SECTION("flushes by itself after the flush interval") {
+        BufferedAuditInterface audit(target, std::chrono::milliseconds(1));
+        audit.record_read(version, table->get(0));
+        for (int i = 0; i < 1000; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(target->mutex);
+                if (!target->reads.empty())
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(target->mutex);
+        REQUIRE(target->reads.size() == 1);
+    }
+
+    SECTION("does not lose reads when a buffer fills up") {
+        BufferedAuditInterface audit(target, std::chrono::hours(1), 8);
+        for (size_t i = 0; i < 1000; ++i)
+            audit.record_read(version, table->get(i % 10));
+        audit.flush();
+        REQUIRE(target->reads.size() == 1000);
+        REQUIRE(target->batches > 1);
+        for (size_t i = 0; i < 1000; ++i)
+            REQUIRE(target->reads[i].row == i % 10);
+    }
+
+    SECTION("collects reads from each thread") {
+        {
+            BufferedAuditInterface audit(target, std::chrono::milliseconds(1), 16);
+            // Rows are read on this thread, then recorded on the others
+            std::vector<RowExpr> rows;
+            for (size_t i = 0; i < 10; ++i)
+                rows.push_back(table->get(i));
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 4; ++i) {
+                threads.emplace_back([&] {
+                    for (size_t j = 0; j < 1000; ++j)
+                        audit.record_read(version, rows[j % rows.size()]);
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+        }
+        // Destroying the interface drains everything still buffered
+        REQUIRE(target->reads.size() == 4000);
+    }
+
+    SECTION("passes on writes immediately") {
+        BufferedAuditInterface audit(target, std::chrono::hours(1));
+        audit.record_write(version, version);
+        REQUIRE(target->writes == 1);
+    }
+}
+
+TEST_CASE("AuditPolicy") {
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"other", {
+            {"value", PropertyType::Int},
+        }},
+    };
+    auto audit = std::make_shared<RecordingAudit>();
+    config.audit_factory = [&] { return audit; };
+
+    auto query_count = [](SharedRealm const& r, TableRef const& table, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+            Results(r, table->where()).evaluate_query_if_needed();
+    };
+
+    SECTION("records everything by default") {
+        auto r = Realm::get_shared_realm(config);
+        auto table = r->read_group().get_table("class_object");
+        query_count(r, table, 5);
+        REQUIRE(audit->queries == 5);
+        for (size_t i = 0; i < 5; ++i)
+            REQUIRE(r->audit_context(AuditEvent::Read, table.get()) == audit.get());
+    }
+
+    SECTION("sample intervals record one in every N events starting with the first") {
+        config.audit_policy.query_sample_interval = 3;
+        config.audit_policy.write_sample_interval = 2;
+        auto r = Realm::get_shared_realm(config);
+        auto table = r->read_group().get_table("class_object");
+
+        query_count(r, table, 7);
+        REQUIRE(audit->queries == 3);
+
+        for (size_t i = 0; i < 5; ++i) {
+            r->begin_transaction();
+            table->add_empty_row();
+            r->commit_transaction();
+        }
+        REQUIRE(audit->writes == 3);
+    }
+
+    SECTION("a sample interval of zero disables that kind of event") {
+        config.audit_policy.read_sample_interval = 0;
+        auto r = Realm::get_shared_realm(config);
+        auto table = r->read_group().get_table("class_object");
+        REQUIRE_FALSE(r->audit_context(AuditEvent::Read, table.get()));
+        REQUIRE(r->audit_context(AuditEvent::Query, table.get()) == audit.get());
+    }
+
+    SECTION("object types limit reads and queries but not writes") {
+        config.audit_policy.object_types = {"other"};
+        auto r = Realm::get_shared_realm(config);
+        auto table = r->read_group().get_table("class_object");
+        auto other = r->read_group().get_table("class_other");
+
+        query_count(r, table, 2);
+        REQUIRE(audit->queries == 0);
+        query_count(r, other, 2);
+        REQUIRE(audit->queries == 2);
+        REQUIRE_FALSE(r->audit_context(AuditEvent::Read, table.get()));
+        REQUIRE(r->audit_context(AuditEvent::Read, other.get()) == audit.get());
+
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        REQUIRE(audit->writes == 1);
+    }
+
+    SECTION("events outside the object types do not count towards sampling") {
+        config.audit_policy.object_types = {"other"};
+        config.audit_policy.query_sample_interval = 2;
+        auto r = Realm::get_shared_realm(config);
+        auto table = r->read_group().get_table("class_object");
+        auto other = r->read_group().get_table("class_other");
+
+        query_count(r, other, 1);
+        query_count(r, table, 3);
+        query_count(r, other, 2);
+        REQUIRE(audit->queries == 2);
+    }
+}
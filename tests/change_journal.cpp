@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "util/index_helpers.hpp"
+#include "util/test_file.hpp"
+
+#include "impl/change_journal.hpp"
+#include "property.hpp"
+#include "results.hpp"
+#include "schema.hpp"
+
+#include <realm/table.hpp>
+#include <realm/util/file.hpp>
+
+#include <unistd.h>
+
+using namespace realm;
+using namespace realm::_impl;
+
+namespace {
+ChangeJournal::Summary tables(std::initializer_list<size_t> table_indices)
+{
+    ChangeJournal::Summary summary;
+    for (auto ndx : table_indices)
+        summary.add_table(ndx);
+    return summary;
+}
+} // anonymous namespace
+
+TEST_CASE("ChangeJournal") {
+    TestFile config;
+    // The journal is stamped with the identity of the Realm file
+    util::File(config.path, util::File::mode_Write);
+    auto journal = ChangeJournal::open(config.path);
+    REQUIRE(journal);
+    auto cleanup = [&] { unlink((config.path + ".journal").c_str()); };
+
+    SECTION("unpublished versions are never unchanged") {
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({})));
+        journal->publish(2, tables({1}));
+        REQUIRE_FALSE(journal->unchanged(1, 3, tables({0})));
+    }
+
+    SECTION("commits to other tables are unchanged") {
+        journal->publish(2, tables({1}));
+        journal->publish(3, tables({2, 3}));
+        REQUIRE(journal->unchanged(1, 3, tables({0})));
+        REQUIRE(journal->unchanged(1, 3, tables({0, 4, 100})));
+        REQUIRE_FALSE(journal->unchanged(1, 3, tables({3})));
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({1})));
+        REQUIRE(journal->unchanged(2, 3, tables({1})));
+    }
+
+    SECTION("empty ranges are not unchanged") {
+        journal->publish(2, tables({1}));
+        REQUIRE_FALSE(journal->unchanged(2, 2, tables({0})));
+        REQUIRE_FALSE(journal->unchanged(3, 2, tables({0})));
+    }
+
+    SECTION("schema changes are never unchanged") {
+        auto summary = tables({});
+        summary.schema_changed = true;
+        journal->publish(2, summary);
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({0})));
+    }
+
+    SECTION("tables beyond the bitmap are treated as everything") {
+        size_t past_end = ChangeJournal::table_words * 64;
+        journal->publish(2, tables({past_end}));
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({0})));
+        journal->publish(3, tables({0}));
+        REQUIRE_FALSE(journal->unchanged(2, 3, tables({past_end + 1})));
+    }
+
+    SECTION("overwritten versions are forgotten") {
+        journal->publish(2, tables({1}));
+        journal->publish(2 + ChangeJournal::slot_count, tables({1}));
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({0})));
+        REQUIRE(journal->unchanged(1 + ChangeJournal::slot_count, 2 + ChangeJournal::slot_count, tables({0})));
+    }
+
+    SECTION("ranges longer than the journal are not unchanged") {
+        for (uint_fast64_t v = 2; v < 3 + ChangeJournal::slot_count; ++v)
+            journal->publish(v, tables({1}));
+        REQUIRE(journal->unchanged(2, 2 + ChangeJournal::slot_count, tables({0})));
+        REQUIRE_FALSE(journal->unchanged(1, 2 + ChangeJournal::slot_count, tables({0})));
+    }
+
+    SECTION("is shared by every instance for a file") {
+        auto other = ChangeJournal::open(config.path);
+        REQUIRE(other);
+        journal->publish(2, tables({1}));
+        REQUIRE(other->unchanged(1, 2, tables({0})));
+        REQUIRE_FALSE(other->unchanged(1, 2, tables({1})));
+    }
+
+    SECTION("is cleared when opened for a different file at the same path") {
+        journal->publish(2, tables({1}));
+        // Create the new file before removing the old one so that it can't
+        // reuse the old one's inode
+        util::File(config.path + ".new", util::File::mode_Write);
+        util::File::move(config.path + ".new", config.path);
+
+        auto other = ChangeJournal::open(config.path);
+        REQUIRE(other);
+        REQUIRE_FALSE(other->unchanged(1, 2, tables({0})));
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({0})));
+    }
+
+    SECTION("is cleared by reset()") {
+        journal->publish(2, tables({1}));
+        journal->reset(config.path);
+        REQUIRE_FALSE(journal->unchanged(1, 2, tables({0})));
+    }
+
+    SECTION("isn't opened for a Realm file which doesn't exist") {
+        REQUIRE_FALSE(ChangeJournal::open(config.path + ".missing"));
+    }
+
+    cleanup();
+}
+
+TEST_CASE("ChangeJournal: commits") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.use_change_journal = true;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"other", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    auto r = Realm::get_shared_realm(config);
+    auto table = r->read_group().get_table("class_object");
+    auto other = r->read_group().get_table("class_other");
+    auto journal = ChangeJournal::open(config.path);
+    REQUIRE(journal);
+
+    auto version = [&] {
+        return r->read_transaction_version().version;
+    };
+    auto commit = [&](TableRef const& target) {
+        auto before = version();
+        r->begin_transaction();
+        target->add_empty_row();
+        r->commit_transaction();
+        return before;
+    };
+
+    SECTION("publishes the tables modified") {
+        auto before = commit(other);
+        REQUIRE(journal->unchanged(before, version(), tables({table->get_index_in_group()})));
+        REQUIRE_FALSE(journal->unchanged(before, version(), tables({other->get_index_in_group()})));
+    }
+
+    SECTION("does not publish bulk loads") {
+        auto before = version();
+        r->begin_transaction(Realm::BulkLoad{true});
+        other->add_empty_row();
+        r->commit_transaction();
+        REQUIRE_FALSE(journal->unchanged(before, version(), tables({table->get_index_in_group()})));
+    }
+
+    SECTION("notifiers skip unrelated commits but see related ones") {
+        Results results(r, table->where());
+        int calls = 0;
+        CollectionChangeSet change;
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+            ++calls;
+        });
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+
+        commit(other);
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+
+        commit(table);
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.insertions, 0);
+    }
+
+    unlink((config.path + ".journal").c_str());
+}
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "collection_change_encoding.hpp"
+
+#include "util/index_helpers.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+using namespace realm;
+
+TEST_CASE("collection change encoding: round trip") {
+    SECTION("empty change set") {
+        auto encoded = encode_change_set({});
+        REQUIRE(encoded.size() == 7);
+
+        CollectionChangeSetReader reader(encoded);
+        REQUIRE(reader.deletions().empty());
+        REQUIRE(reader.insertions().empty());
+        REQUIRE(reader.modifications().empty());
+        REQUIRE(reader.modifications_new().empty());
+        REQUIRE(reader.moves().empty());
+        REQUIRE(reader.columns().empty());
+        REQUIRE(reader.read().empty());
+    }
+
+    SECTION("all fields") {
+        CollectionChangeSet changes;
+        changes.deletions = {0, 1, 2, 10};
+        changes.insertions = {5, 300, 301, 100000};
+        changes.modifications = {3};
+        changes.modifications_new = {4, 7};
+        changes.moves = {{1, 5}, {200, 300}};
+        changes.columns.resize(3);
+        changes.columns[0] = {1, 2};
+        changes.columns[2] = {500};
+
+        auto result = CollectionChangeSetReader(encode_change_set(changes)).read();
+        REQUIRE_INDICES(result.deletions, 0, 1, 2, 10);
+        REQUIRE_INDICES(result.insertions, 5, 300, 301, 100000);
+        REQUIRE_INDICES(result.modifications, 3);
+        REQUIRE_INDICES(result.modifications_new, 4, 7);
+        REQUIRE_MOVES(result, {1, 5}, {200, 300});
+        REQUIRE(result.columns.size() == 3);
+        REQUIRE_COLUMN_INDICES(result.columns, 0, 1, 2);
+        REQUIRE(result.columns[1].empty());
+        REQUIRE_COLUMN_INDICES(result.columns, 2, 500);
+    }
+
+    SECTION("large indices") {
+        size_t max = std::numeric_limits<size_t>::max() - 1;
+        CollectionChangeSet changes;
+        changes.insertions.add(max);
+        changes.moves = {{max, 0}};
+
+        auto result = CollectionChangeSetReader(encode_change_set(changes)).read();
+        REQUIRE_INDICES(result.insertions, max);
+        REQUIRE_MOVES(result, {max, 0});
+    }
+
+    SECTION("dense ranges are encoded by length") {
+        CollectionChangeSet changes;
+        changes.insertions.set(100000);
+        REQUIRE(encode_change_set(changes).size() < 12);
+    }
+}
+
+TEST_CASE("collection change encoding: reader") {
+    CollectionChangeSet changes;
+    changes.deletions = {1, 2, 3, 8, 9};
+    changes.moves = {{3, 4}, {6, 2}};
+    changes.columns.resize(2);
+    changes.columns[1] = {0, 5};
+    auto encoded = encode_change_set(changes);
+    CollectionChangeSetReader reader(encoded);
+
+    SECTION("iterates over ranges without decoding the whole change set") {
+        REQUIRE(reader.deletions().size() == 2);
+        auto it = reader.deletions().begin();
+        REQUIRE(*it == std::make_pair(size_t(1), size_t(4)));
+        ++it;
+        REQUIRE(*it == std::make_pair(size_t(8), size_t(10)));
+        ++it;
+        REQUIRE(it == reader.deletions().end());
+    }
+
+    SECTION("iterates over moves") {
+        std::vector<CollectionChangeSet::Move> moves(reader.moves().begin(), reader.moves().end());
+        REQUIRE(moves == changes.moves);
+    }
+
+    SECTION("reads individual columns") {
+        REQUIRE(reader.columns().size() == 2);
+        REQUIRE(reader.columns()[0].empty());
+        auto column = reader.columns()[1].to_index_set();
+        REQUIRE_INDICES(column, 0, 5);
+    }
+}
+
+TEST_CASE("collection change encoding: invalid data") {
+    CollectionChangeSet changes;
+    changes.deletions = {1, 2, 3, 8, 9};
+    changes.moves = {{3, 4}};
+    changes.columns.resize(1);
+    changes.columns[0] = {400};
+    auto encoded = encode_change_set(changes);
+
+    SECTION("rejects empty data") {
+        REQUIRE_THROWS_AS(CollectionChangeSetReader(encoded.data(), 0), std::invalid_argument);
+    }
+
+    SECTION("rejects unknown versions") {
+        encoded[0] = 2;
+        REQUIRE_THROWS_AS(CollectionChangeSetReader{encoded}, std::invalid_argument);
+    }
+
+    SECTION("rejects truncated data") {
+        for (size_t i = 1; i < encoded.size(); ++i)
+            REQUIRE_THROWS_AS(CollectionChangeSetReader(encoded.data(), i), std::invalid_argument);
+    }
+
+    SECTION("rejects trailing data") {
+        encoded += '\0';
+        REQUIRE_THROWS_AS(CollectionChangeSetReader{encoded}, std::invalid_argument);
+    }
+
+    SECTION("rejects overflowing values") {
+        std::string bad(1, char(CollectionChangeSetReader::current_version));
+        bad += '\x01';
+        bad.append(10, '\xff');
+        bad += '\x01';
+        REQUIRE_THROWS_AS(CollectionChangeSetReader{bad}, std::invalid_argument);
+    }
+
+    SECTION("rejects empty ranges") {
+        std::string bad(1, char(CollectionChangeSetReader::current_version));
+        bad += std::string("\x01\x05\x00\x00\x00\x00\x00\x00", 8);
+        REQUIRE_THROWS_AS(CollectionChangeSetReader{bad}, std::invalid_argument);
+    }
+}
@@ -22,6 +22,7 @@
 
 #include "util/index_helpers.hpp"
 
+#include <algorithm>
 #include <limits>
 
 using namespace realm;
@@ -704,6 +705,32 @@ TEST_CASE("collection_change: calculate() sorted") {
         REQUIRE_INDICES(c.modifications, 0);
     }
 
+    SECTION("reports a minimal diff for reorderings of large results") {
+        std::vector<size_t> old_rows(5000);
+        for (size_t i = 0; i < old_rows.size(); ++i)
+            old_rows[i] = i;
+
+        // Move the first row to the end
+        auto new_rows = old_rows;
+        std::rotate(new_rows.begin(), new_rows.begin() + 1, new_rows.end());
+        c = _impl::CollectionChangeBuilder::calculate(old_rows, new_rows, none_modified);
+        REQUIRE_INDICES(c.deletions, 0);
+        REQUIRE_INDICES(c.insertions, 4999);
+
+        // Swap two rows in the middle
+        new_rows = old_rows;
+        std::swap(new_rows[1000], new_rows[3000]);
+        c = _impl::CollectionChangeBuilder::calculate(old_rows, new_rows, none_modified);
+        REQUIRE_INDICES(c.deletions, 1000, 3000);
+        REQUIRE_INDICES(c.insertions, 1000, 3000);
+
+        // Reverse everything
+        new_rows.assign(old_rows.rbegin(), old_rows.rend());
+        c = _impl::CollectionChangeBuilder::calculate(old_rows, new_rows, none_modified);
+        REQUIRE(c.deletions.count() == 4999);
+        REQUIRE(c.insertions.count() == 4999);
+    }
+
     SECTION("reports inserts/deletes for simple reorderings") {
         auto calc = [&](std::vector<size_t> old_rows, std::vector<size_t> new_rows) {
             return _impl::CollectionChangeBuilder::calculate(old_rows, new_rows, none_modified);
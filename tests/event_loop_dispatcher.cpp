@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "util/event_loop.hpp"
+
+#include "util/event_loop_dispatcher.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace realm;
+
+TEST_CASE("EventLoopDispatcher") {
+    if (!util::EventLoop::has_implementation())
+        return;
+
+    std::vector<std::pair<int, int>> calls;
+    std::vector<std::thread::id> threads;
+    util::EventLoopDispatcher<void(int, int)> dispatcher([&](int producer, int value) {
+        calls.emplace_back(producer, value);
+        threads.push_back(std::this_thread::get_id());
+    });
+
+    SECTION("invokes the function directly on the thread which created it") {
+        dispatcher(0, 1);
+        REQUIRE(calls.size() == 1);
+    }
+
+    SECTION("invokes the function on the creating thread in the order each thread called it") {
+        const int producers = 4;
+        const int calls_per_producer = 1000;
+        std::vector<std::thread> producer_threads;
+        for (int i = 0; i < producers; ++i) {
+            producer_threads.emplace_back([=]() mutable {
+                for (int j = 0; j < calls_per_producer; ++j)
+                    dispatcher(i, j);
+            });
+        }
+        util::EventLoop::main().run_until([&] { return calls.size() == size_t(producers * calls_per_producer); });
+        for (auto& thread : producer_threads)
+            thread.join();
+
+        for (auto id : threads)
+            REQUIRE(id == std::this_thread::get_id());
+        std::vector<int> next(producers);
+        for (auto& call : calls) {
+            REQUIRE(call.second == next[call.first]);
+            ++next[call.first];
+        }
+    }
+
+    SECTION("pending invocations are still run after the dispatcher is destroyed") {
+        {
+            util::EventLoopDispatcher<void(int, int)> temporary(dispatcher.func());
+            std::thread([&] {
+                temporary(0, 1);
+                temporary(0, 2);
+            }).join();
+        }
+        util::EventLoop::main().run_until([&] { return calls.size() == 2; });
+        REQUIRE(calls[1].second == 2);
+    }
+}
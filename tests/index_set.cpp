@@ -44,6 +44,15 @@ TEST_CASE("index_set: contains()") {
         REQUIRE(set.contains(2));
         REQUIRE(set.contains(5));
     }
+
+    SECTION("finds indexes in later chunks") {
+        realm::IndexSet set;
+        for (size_t i = 0; i < 50; ++i)
+            set.add(i * 2);
+        for (size_t i = 0; i < 100; ++i)
+            REQUIRE(set.contains(i) == (i % 2 == 0));
+        REQUIRE_FALSE(set.contains(100));
+    }
 }
 
 TEST_CASE("index_set: count()") {
@@ -149,6 +158,54 @@ TEST_CASE("index_set: add()") {
         set.add(set2);
         REQUIRE(set.count() == 30);
     }
+
+    SECTION("combines overlapping and adjacent ranges from another set") {
+        set = {0, 1, 2, 6, 7, 10};
+        realm::IndexSet set2 = {2, 3, 4, 5, 8, 12, 13};
+
+        set.add(set2);
+        REQUIRE_INDICES(set, 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 13);
+        REQUIRE(std::distance(set.begin(), set.end()) == 3);
+    }
+
+    SECTION("adds a small set to a large one") {
+        for (size_t i = 0; i < 100; ++i)
+            set.add(i * 2);
+        set.add(realm::IndexSet{1, 201});
+        REQUIRE(set.count() == 102);
+        REQUIRE(set.contains(1));
+        REQUIRE(set.contains(201));
+        REQUIRE_FALSE(set.contains(3));
+    }
+}
+
+TEST_CASE("index_set: add_range()") {
+    realm::IndexSet set;
+
+    SECTION("appends ranges after the end of the set") {
+        set.add_range(1, 3);
+        set.add_range(5, 6);
+        REQUIRE_INDICES(set, 1, 2, 5);
+    }
+
+    SECTION("extends the last range when adjacent") {
+        set = {1, 2};
+        set.add_range(3, 5);
+        REQUIRE_INDICES(set, 1, 2, 3, 4);
+        REQUIRE(std::distance(set.begin(), set.end()) == 1);
+    }
+
+    SECTION("merges ranges which overlap existing ones") {
+        set = {0, 5, 10};
+        set.add_range(3, 7);
+        REQUIRE_INDICES(set, 0, 3, 4, 5, 6, 10);
+    }
+
+    SECTION("does nothing for empty ranges") {
+        set = {5};
+        set.add_range(2, 2);
+        REQUIRE_INDICES(set, 5);
+    }
 }
 
 TEST_CASE("index_set: add_shifted()") {
@@ -584,6 +641,16 @@ TEST_CASE("index_set: shift()") {
         REQUIRE(set.shift(3) == 7);
         REQUIRE(set.shift(4) == 8);
     }
+
+    SECTION("skips complete chunks before the index") {
+        set = {1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23};
+        REQUIRE(set.shift(0) == 0);
+        REQUIRE(set.shift(1) == 2);
+        REQUIRE(set.shift(8) == 16);
+        REQUIRE(set.shift(11) == 22);
+        REQUIRE(set.shift(12) == 24);
+        REQUIRE(set.shift(20) == 32);
+    }
 }
 
 TEST_CASE("index_set: unshift()") {
@@ -608,3 +675,48 @@ TEST_CASE("index_set: clear()") {
         REQUIRE(set.empty());
     }
 }
+
+TEST_CASE("index_set: copy and move") {
+    realm::IndexSet small = {1, 3};
+    realm::IndexSet large;
+    for (size_t i = 0; i < 50; ++i)
+        large.add(i * 2);
+
+    SECTION("copying preserves the indices of small and large sets") {
+        realm::IndexSet small_copy = small;
+        realm::IndexSet large_copy = large;
+        REQUIRE_INDICES(small_copy, 1, 3);
+        REQUIRE(large_copy.count() == 50);
+        REQUIRE(large_copy.contains(98));
+        large_copy.verify();
+    }
+
+    SECTION("moving preserves the indices of small and large sets") {
+        realm::IndexSet small_moved = std::move(small);
+        realm::IndexSet large_moved = std::move(large);
+        REQUIRE_INDICES(small_moved, 1, 3);
+        REQUIRE(large_moved.count() == 50);
+        REQUIRE(large_moved.contains(98));
+        large_moved.verify();
+    }
+
+    SECTION("a small set can grow after being moved") {
+        realm::IndexSet moved = std::move(small);
+        for (size_t i = 5; i < 40; i += 2)
+            moved.add(i);
+        REQUIRE(moved.count() == 20);
+        moved.verify();
+    }
+}
+
+TEST_CASE("index_set: heap_size()") {
+    realm::IndexSet set;
+    REQUIRE(set.heap_size() == 0);
+
+    set = {1, 3};
+    REQUIRE(set.heap_size() == 0);
+
+    for (size_t i = 5; i < 100; i += 2)
+        set.add(i);
+    REQUIRE(set.heap_size() > 0);
+}
@@ -204,6 +204,26 @@ TEST_CASE("list") {
             REQUIRE_INDICES(change.deletions, 5, 10);
         }
 
+        SECTION("modifications are reported at the current positions of the target rows") {
+            auto token = require_change();
+            write([&] { target->set_int(0, 3, 10); });
+            REQUIRE_INDICES(change.modifications, 3);
+
+            write([&] { lst.set(7, 3); });
+            REQUIRE_INDICES(change.modifications, 7);
+            write([&] { target->set_int(0, 3, 11); });
+            REQUIRE_INDICES(change.modifications, 3, 7);
+
+            write([&] { lst.move(3, 0); });
+            write([&] { target->set_int(0, 3, 12); });
+            REQUIRE_INDICES(change.modifications, 0, 7);
+
+            // Moves row 9 to index 1 in the target table
+            write([&] { target->move_last_over(1); });
+            write([&] { target->set_int(0, 1, 13); });
+            REQUIRE_INDICES(change.modifications, 8);
+        }
+
         SECTION("clearing the target table sends a change notification") {
             auto token = require_change();
             write([&] { target->clear(); });
@@ -933,4 +953,155 @@ TEST_CASE("list") {
         REQUIRE(obj.is_valid());
         REQUIRE(obj.row().get_index() == 1);
     }
+
+    SECTION("insert_range()") {
+        List list(r, lv);
+        r->begin_transaction();
+
+        std::vector<RowExpr> rows{target->get(7), target->get(8)};
+        list.insert_range(1, rows.data(), rows.data() + rows.size());
+        REQUIRE(list.size() == 12);
+        REQUIRE(list.get(0).get_index() == 0);
+        REQUIRE(list.get(1).get_index() == 7);
+        REQUIRE(list.get(2).get_index() == 8);
+        REQUIRE(list.get(3).get_index() == 1);
+
+        std::vector<size_t> indices{2, 3};
+        list.add_all(indices.data(), indices.data() + indices.size());
+        REQUIRE(list.size() == 14);
+        REQUIRE(list.get(13).get_index() == 3);
+
+        SECTION("inserts nothing if any object is invalid") {
+            std::vector<RowExpr> mixed{target->get(1), other_target->get(1)};
+            REQUIRE_THROWS(list.insert_range(0, mixed.data(), mixed.data() + mixed.size()));
+            REQUIRE(list.size() == 14);
+        }
+
+        SECTION("throws for an invalid index") {
+            REQUIRE_THROWS(list.insert_range(15, rows.data(), rows.data() + rows.size()));
+            REQUIRE(list.size() == 14);
+        }
+
+        r->cancel_transaction();
+    }
+
+    SECTION("remove_range()") {
+        List list(r, lv);
+        r->begin_transaction();
+
+        list.remove_range(2, 5);
+        REQUIRE(list.size() == 7);
+        REQUIRE(list.get(1).get_index() == 1);
+        REQUIRE(list.get(2).get_index() == 5);
+
+        list.remove_range(3, 3);
+        REQUIRE(list.size() == 7);
+
+        REQUIRE_THROWS(list.remove_range(5, 8));
+        REQUIRE_THROWS(list.remove_range(4, 3));
+        REQUIRE(list.size() == 7);
+
+        list.remove_range(0, 7);
+        REQUIRE(list.size() == 0);
+
+        r->cancel_transaction();
+    }
+
+    SECTION("add_all(Results)") {
+        List list(r, lv);
+        r->begin_transaction();
+
+        Results results(r, target->where().greater(0, 6));
+        list.add_all(results);
+        REQUIRE(list.size() == 13);
+        REQUIRE(list.get(10).get_index() == 7);
+        REQUIRE(list.get(12).get_index() == 9);
+
+        // Adding the list to itself reads all of the values first
+        auto self = list.as_results();
+        list.add_all(self);
+        REQUIRE(list.size() == 26);
+
+        Results other(r, other_target->where());
+        REQUIRE_THROWS(list.add_all(other));
+        REQUIRE(list.size() == 26);
+
+        r->cancel_transaction();
+    }
+
+    SECTION("aggregates") {
+        List list(r, lv);
+        REQUIRE(list.sum(0).get_int() == 45);
+        REQUIRE(list.max(0)->get_int() == 9);
+
+        // Repeated calls reuse the values gathered from the LinkView, but
+        // must still see changes to both the list and the target rows
+        r->begin_transaction();
+        list.remove(9);
+        REQUIRE(list.sum(0).get_int() == 36);
+        REQUIRE(list.max(0)->get_int() == 8);
+        target->set_int(0, 0, 20);
+        REQUIRE(list.sum(0).get_int() == 56);
+        REQUIRE(list.max(0)->get_int() == 20);
+        list.add(target->get(9));
+        REQUIRE(list.sum(0).get_int() == 65);
+        r->cancel_transaction();
+
+        REQUIRE(list.sum(0).get_int() == 45);
+        REQUIRE(*list.average(0) == 4.5);
+        REQUIRE(list.min(0)->get_int() == 0);
+    }
+
+    SECTION("assign(Context) with update_only_diff") {
+        List list(r, lv);
+        CppContext ctx(r, &list.get_object_schema());
+        CollectionChangeSet change;
+        auto token = list.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            change = c;
+        });
+        advance_and_notify(*r);
+
+        auto assign = [&](std::vector<size_t> rows) {
+            AnyVector values;
+            for (auto row : rows)
+                values.push_back(util::Any(target->get(row)));
+            r->begin_transaction();
+            list.assign(ctx, util::Any(values), false, true);
+            r->commit_transaction();
+            advance_and_notify(*r);
+
+            REQUIRE(list.size() == rows.size());
+            for (size_t i = 0; i < rows.size(); ++i)
+                REQUIRE(list.get(i).get_index() == rows[i]);
+        };
+
+        SECTION("inserting at the front only inserts") {
+            assign({5, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+            REQUIRE_INDICES(change.insertions, 0);
+            REQUIRE(change.deletions.empty());
+            REQUIRE(change.modifications.empty());
+        }
+
+        SECTION("removing from the middle and appending") {
+            assign({0, 1, 2, 4, 5, 6, 7, 8, 9, 1});
+            REQUIRE_INDICES(change.deletions, 3);
+            REQUIRE_INDICES(change.insertions, 9);
+        }
+
+        SECTION("replacing a value sets it in place") {
+            assign({0, 1, 2, 3, 7, 5, 6, 7, 8, 9});
+            REQUIRE_INDICES(change.modifications, 4);
+            REQUIRE(change.insertions.empty());
+            REQUIRE(change.deletions.empty());
+        }
+
+        SECTION("assigning the same values does nothing") {
+            assign({0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+            REQUIRE(change.empty());
+        }
+
+        SECTION("reversing the list") {
+            assign({9, 8, 7, 6, 5, 4, 3, 2, 1, 0});
+        }
+    }
 }
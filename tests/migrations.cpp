@@ -453,6 +453,31 @@ TEST_CASE("migration: Automatic") {
             REQUIRE_THROWS(realm->update_schema(schema, 2, nullptr));
         }
 
+        SECTION("add pk to existing table with null and empty string keys") {
+            Schema schema = {
+                {"object", {
+                    {"value", PropertyType::String|PropertyType::Nullable},
+                }},
+            };
+            auto realm = Realm::get_shared_realm(config);
+            realm->update_schema(schema, 1);
+
+            auto table = ObjectStore::table_for_object_type(realm->read_group(), "object");
+            realm->begin_transaction();
+            table->add_empty_row(2);
+            table->set_string(0, 1, "");
+            realm->commit_transaction();
+
+            auto pk_schema = set_primary_key(schema, "object", "value");
+            REQUIRE_NOTHROW(realm->update_schema(pk_schema, 2, nullptr));
+
+            realm->begin_transaction();
+            table->set_string(0, 1, null());
+            realm->commit_transaction();
+            REQUIRE_THROWS_AS(realm->update_schema(pk_schema, 3, [](SharedRealm, SharedRealm, Schema&) { }),
+                              DuplicatePrimaryKeyValueException);
+        }
+
         SECTION("throwing an exception from migration function rolls back all changes") {
             Schema schema1 = {
                 {"object", {
@@ -518,6 +543,41 @@ TEST_CASE("migration: Automatic") {
                 REQUIRE(table->get_int(0, i) == i);
         }
 
+        SECTION("progress is reported while converting properties to nullable") {
+            std::vector<std::pair<uint64_t, uint64_t>> reported;
+            config.migration_progress = [&](uint64_t completed, uint64_t total) {
+                reported.emplace_back(completed, total);
+            };
+            Schema schema = {
+                {"object", {
+                    {"value", PropertyType::Int},
+                }},
+            };
+            auto realm = Realm::get_shared_realm(config);
+            realm->update_schema(schema, 1);
+            reported.clear();
+
+            const size_t count = 25000;
+            realm->begin_transaction();
+            auto table = ObjectStore::table_for_object_type(realm->read_group(), "object");
+            table->add_empty_row(count);
+            for (size_t i = 0; i < count; ++i)
+                table->set_int(0, i, i);
+            realm->commit_transaction();
+
+            realm->update_schema(set_optional(schema, "object", "value", true), 2);
+            REQUIRE(reported.size() > 3);
+            uint64_t total = reported.back().second;
+            REQUIRE(total > count);
+            REQUIRE(reported.back().first == total);
+            for (size_t i = 1; i < reported.size(); ++i) {
+                REQUIRE(reported[i].second == total);
+                REQUIRE(reported[i].first > reported[i - 1].first);
+            }
+            for (size_t i = 0; i < count; ++i)
+                REQUIRE(table->get_int(0, i) == int64_t(i));
+        }
+
         SECTION("values for nullable properties are discarded when converitng to required") {
             Schema schema = {
                 {"object", {
@@ -1135,6 +1195,41 @@ TEST_CASE("migration: Automatic") {
             schema = set_indexed(schema, "object", "value", true);
             SUCCESSFUL_RENAME(schema, schema2, {"object", "value", "new"});
         }
+
+        SECTION("batched renames across several types") {
+            schema = add_property(schema, "object", {"value 2", PropertyType::Int});
+            schema = add_table(schema, {"object 2", {
+                {"value", PropertyType::Int},
+            }});
+            auto schema2 = rename_value(schema);
+            schema2.find("object")->property_for_name("value 2")->name = "new 2";
+            schema2.find("object 2")->property_for_name("value")->name = "new";
+            schema2 = set_optional(schema2, "object 2", "new", true);
+
+            init(schema);
+            REQUIRE_NOTHROW(realm->update_schema(schema2, 2, [](SharedRealm, SharedRealm realm, Schema& schema) {
+                ObjectStore::rename_properties(realm->read_group(), schema, {
+                    {"object", "value", "a"},
+                    {"object 2", "value", "new"},
+                    {"object", "value 2", "new 2"},
+                    {"object", "a", "new"},
+                });
+            }));
+            REQUIRE(realm->schema() == schema2);
+            VERIFY_SCHEMA(*realm);
+            REQUIRE(ObjectStore::table_for_object_type(realm->read_group(), "object")->get_int(0, 0) == 10);
+        }
+
+        SECTION("batched renames report the first invalid rename") {
+            auto schema2 = rename_value(schema);
+            init(schema);
+            REQUIRE_THROWS_WITH(realm->update_schema(schema2, 2, [](SharedRealm, SharedRealm realm, Schema& schema) {
+                ObjectStore::rename_properties(realm->read_group(), schema, {
+                    {"object", "value", "new"},
+                    {"object", "value", "other"},
+                });
+            }), "Cannot rename property 'object.value' because it does not exist.");
+        }
     }
 }
 
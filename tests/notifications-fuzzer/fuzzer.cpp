@@ -30,6 +30,11 @@
 #include <realm/group_shared.hpp>
 #include <realm/link_view.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <sys/types.h>
@@ -237,15 +242,55 @@ static void test(Realm::Config const& config, SharedRealm& r, SharedRealm& r2, s
     }
 }
 
+// Time spent in each part of the notification pipeline, collected from the
+// notification trace while replaying
+struct ReplayTime {
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds run_notifiers{0};
+    std::chrono::nanoseconds notifier_runs{0};
+    std::chrono::nanoseconds callbacks{0};
+};
+static ReplayTime s_replay_time;
+
+static void record_replay_span(NotificationSpan const& span)
+{
+    switch (span.phase) {
+        case NotificationSpan::Phase::RunNotifiers:
+            s_replay_time.run_notifiers += span.duration;
+            break;
+        case NotificationSpan::Phase::NotifierRun:
+            s_replay_time.notifier_runs += span.duration;
+            break;
+        case NotificationSpan::Phase::Callbacks:
+            s_replay_time.callbacks += span.duration;
+            break;
+        default:
+            break;
+    }
+}
+
 int main(int argc, char** argv) {
     std::ios_base::sync_with_stdio(false);
     realm::disable_sync_to_disk();
 
+    // With `--replay N file...`, each input file is run N times and the
+    // average time per run spent in run_async_notifiers(), in the notifiers
+    // calculating changes, and in calling the callbacks is reported for each
+    // file, so that the corpus can be used to spot performance regressions
+    size_t replay_count = 0;
+    int first_file = 1;
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        replay_count = std::max(1, atoi(argv[2]));
+        first_file = 3;
+    }
+
     Realm::Config config;
     config.path = "fuzzer.realm";
     config.cache = false;
     config.in_memory = true;
     config.automatic_change_notifications = false;
+    if (replay_count)
+        config.notification_trace = record_replay_span;
 
     Schema schema{
         {"object", "", {
@@ -277,6 +322,36 @@ int main(int argc, char** argv) {
         coordinator.on_change();
     };
 
+    if (replay_count) {
+        auto us_per_run = [&](std::chrono::nanoseconds time) {
+            return std::chrono::duration<double, std::micro>(time).count() / replay_count;
+        };
+        printf("%-24s %12s %16s %16s %12s\n", "file", "total (us)", "run_notifiers", "change calc", "callbacks");
+
+        std::string buffer;
+        for (int i = first_file; i < argc; ++i) {
+            int fd = open(argv[i], O_RDONLY);
+            if (fd < 0)
+                abort();
+            read_all(buffer, fd);
+            close(fd);
+
+            // Warm up with one untimed run
+            test_on(buffer);
+            s_replay_time = {};
+            for (size_t j = 0; j < replay_count; ++j) {
+                auto start = std::chrono::steady_clock::now();
+                test_on(buffer);
+                s_replay_time.total += std::chrono::steady_clock::now() - start;
+            }
+            printf("%-24s %12.1f %16.1f %16.1f %12.1f\n", argv[i], us_per_run(s_replay_time.total),
+                   us_per_run(s_replay_time.run_notifiers), us_per_run(s_replay_time.notifier_runs),
+                   us_per_run(s_replay_time.callbacks));
+        }
+        unlink(config.path.c_str());
+        return 0;
+    }
+
     if (argc > 1) {
         std::string buffer;
         for (int i = 1; i < argc; ++i) {
@@ -27,6 +27,7 @@
 #include "object_accessor.hpp"
 #include "property.hpp"
 #include "schema.hpp"
+#include "typed_object.hpp"
 
 #include "impl/realm_coordinator.hpp"
 #include "impl/object_accessor_impl.hpp"
@@ -288,6 +289,48 @@ TEST_CASE("object") {
             REQUIRE_INDICES(change.deletions, 0);
         }
 
+        SECTION("observing many objects from the same table") {
+            std::vector<Object> objects;
+            std::vector<CollectionChangeSet> changes(10);
+            std::vector<int> calls(10);
+            std::vector<NotificationToken> tokens;
+            for (size_t i = 0; i < 10; ++i) {
+                objects.emplace_back(r, *r->schema().find("table"), table->get(i));
+                tokens.push_back(objects.back().add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr) {
+                    changes[i] = c;
+                    ++calls[i];
+                }));
+            }
+            advance_and_notify(*r);
+            for (size_t i = 0; i < 10; ++i)
+                REQUIRE(calls[i] == 1);
+
+            write([&] { table->set_int(1, 3, 10); });
+            for (size_t i = 0; i < 10; ++i)
+                REQUIRE(calls[i] == (i == 3 ? 2 : 1));
+            REQUIRE_INDICES(changes[3].modifications, 0);
+            REQUIRE(changes[3].columns.size() == 2);
+            REQUIRE(changes[3].columns[0].empty());
+            REQUIRE_INDICES(changes[3].columns[1], 0);
+
+            // Row 9 is moved into row 5's place, which isn't a change to it
+            write([&] { table->move_last_over(5); });
+            REQUIRE(calls[5] == 2);
+            REQUIRE_INDICES(changes[5].deletions, 0);
+            REQUIRE(calls[9] == 1);
+
+            write([&] { table->set_int(0, 5, 20); });
+            REQUIRE(calls[5] == 2);
+            REQUIRE(calls[9] == 2);
+            REQUIRE_INDICES(changes[9].modifications, 0);
+
+            // Removing a callback doesn't affect the others sharing its notifier
+            tokens[9] = NotificationToken();
+            write([&] { table->set_int(0, 5, 30); table->set_int(0, 0, 30); });
+            REQUIRE(calls[9] == 2);
+            REQUIRE(calls[0] == 2);
+        }
+
         SECTION("observing deleted object throws") {
             write([&] {
                 row.move_last_over();
@@ -844,6 +887,280 @@ TEST_CASE("object") {
         REQUIRE(obj.row().get_string(0) == "value");
     }
 
+    SECTION("create_bulk") {
+        auto create_bulk = [&](StringData type, std::vector<util::Any> values, bool update) {
+            r->begin_transaction();
+            std::vector<size_t> rows;
+            try {
+                rows = Object::create_bulk(d, r, *r->schema().find(type), values, update);
+            }
+            catch (...) {
+                r->cancel_transaction();
+                throw;
+            }
+            r->commit_transaction();
+            return rows;
+        };
+
+        SECTION("without a primary key") {
+            auto table = r->read_group().get_table("class_table");
+            auto rows = create_bulk("table", {
+                AnyDict{{"value 1", INT64_C(1)}, {"value 2", INT64_C(2)}},
+                AnyDict{{"value 1", INT64_C(3)}, {"value 2", INT64_C(4)}},
+            }, false);
+            REQUIRE(rows == std::vector<size_t>{0, 1});
+            REQUIRE(table->size() == 2);
+            REQUIRE(table->get_int(0, 1) == 3);
+            REQUIRE(table->get_int(1, 1) == 4);
+        }
+
+        SECTION("creates new objects and updates existing ones") {
+            create_company(AnyDict{{"name", "a"s}, {"age", INT64_C(1)}}, false);
+            auto table = r->read_group().get_table("class_person");
+
+            auto rows = create_bulk("person", {
+                AnyDict{{"name", "b"s}, {"age", INT64_C(2)}, {"assistant", AnyDict{{"name", "a"s}}}},
+                AnyDict{{"name", "a"s}, {"age", INT64_C(3)}},
+                AnyDict{{"name", "c"s}, {"age", INT64_C(4)}, {"scores", AnyVec{INT64_C(5), INT64_C(6)}}},
+            }, true);
+            REQUIRE(table->size() == 3);
+            REQUIRE(rows[1] == 0);
+            REQUIRE(table->get_string(0, rows[0]) == "b");
+            REQUIRE(table->get_int(1, rows[0]) == 2);
+            REQUIRE(table->get_link(3, rows[0]) == 0);
+            REQUIRE(table->get_int(1, 0) == 3);
+            REQUIRE(table->get_string(0, rows[2]) == "c");
+            List scores(r, *table, table->get_column_index("scores"), rows[2]);
+            REQUIRE(scores.size() == 2);
+        }
+
+        SECTION("repeated primary keys update the object created earlier in the batch") {
+            auto table = r->read_group().get_table("class_person");
+            auto rows = create_bulk("person", {
+                AnyDict{{"name", "a"s}, {"age", INT64_C(1)}},
+                AnyDict{{"name", "a"s}, {"team", AnyVec{AnyDict{{"name", "b"s}, {"age", INT64_C(2)}}}}},
+            }, true);
+            REQUIRE(table->size() == 2);
+            REQUIRE(rows[0] == rows[1]);
+            REQUIRE(table->get_int(1, rows[0]) == 1);
+            REQUIRE(table->get_linklist(4, rows[0])->size() == 1);
+        }
+
+        SECTION("nested objects of the same type are applied in the order of the values") {
+            auto table = r->read_group().get_table("class_person");
+            auto rows = create_bulk("person", {
+                AnyDict{{"name", "b"s}, {"age", INT64_C(1)}, {"assistant", AnyDict{{"name", "c"s}, {"age", INT64_C(9)}}}},
+                AnyDict{{"name", "c"s}, {"age", INT64_C(4)}},
+            }, true);
+            REQUIRE(table->size() == 2);
+            REQUIRE(table->get_link(3, rows[0]) == rows[1]);
+            REQUIRE(table->get_string(0, rows[1]) == "c");
+            REQUIRE(table->get_int(1, rows[1]) == 4);
+        }
+
+        SECTION("nullable primary keys") {
+            auto table = r->read_group().get_table("class_nullable int pk");
+            auto rows = create_bulk("nullable int pk", {
+                AnyDict{{"pk", INT64_C(1)}},
+                AnyDict{{"pk", util::Any()}},
+                AnyDict{{"pk", INT64_C(2)}},
+            }, false);
+            REQUIRE(table->size() == 3);
+            REQUIRE(table->is_null(0, rows[1]));
+            REQUIRE(table->get_int(0, rows[2]) == 2);
+        }
+
+        SECTION("throws for duplicate primary keys if update is not specified") {
+            create_company(AnyDict{{"name", "a"s}, {"age", INT64_C(1)}}, false);
+            REQUIRE_THROWS(create_bulk("person", {
+                AnyDict{{"name", "a"s}, {"age", INT64_C(1)}},
+            }, false));
+            REQUIRE_THROWS(create_bulk("person", {
+                AnyDict{{"name", "b"s}, {"age", INT64_C(1)}},
+                AnyDict{{"name", "b"s}, {"age", INT64_C(1)}},
+            }, false));
+        }
+
+        SECTION("throws for missing values") {
+            REQUIRE_THROWS_AS(create_bulk("person", {AnyDict{{"name", "a"s}}}, false),
+                              MissingPropertyValueException);
+        }
+    }
+
+    SECTION("cached primary key lookups") {
+        auto cached_config = config;
+        cached_config.cache = false;
+        cached_config.cache_primary_key_lookups = true;
+        auto cached_realm = Realm::get_shared_realm(cached_config);
+        auto& person_schema = *cached_realm->schema().find("person");
+        auto table = cached_realm->read_group().get_table("class_person");
+
+        cached_realm->begin_transaction();
+        auto a = Object::create(d, cached_realm, person_schema, util::Any(AnyDict{{"name", "a"s}, {"age", INT64_C(1)}}));
+        auto b = Object::create(d, cached_realm, person_schema, util::Any(AnyDict{{"name", "b"s}, {"age", INT64_C(2)}}));
+
+        SECTION("finds objects created earlier in the transaction") {
+            auto obj = Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("a"s));
+            REQUIRE(obj.row().get_index() == a.row().get_index());
+            obj = Object::create(d, cached_realm, person_schema, util::Any(AnyDict{{"name", "b"s}, {"age", INT64_C(3)}}), true);
+            REQUIRE(obj.row().get_index() == b.row().get_index());
+            REQUIRE(table->size() == 2);
+            REQUIRE(table->get_int(1, b.row().get_index()) == 3);
+            REQUIRE_FALSE(Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("c"s)).is_valid());
+            Object::create(d, cached_realm, person_schema, util::Any(AnyDict{{"name", "c"s}, {"age", INT64_C(4)}}));
+            REQUIRE(Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("c"s)).is_valid());
+        }
+
+        SECTION("is not used after other changes to the table") {
+            table->move_last_over(a.row().get_index());
+            auto obj = Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("b"s));
+            REQUIRE(obj.row().get_index() == 0);
+            REQUIRE_FALSE(Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("a"s)).is_valid());
+            obj = Object::create(d, cached_realm, person_schema, util::Any(AnyDict{{"name", "a"s}, {"age", INT64_C(5)}}));
+            REQUIRE(table->size() == 2);
+        }
+
+        SECTION("is discarded at the end of the transaction") {
+            cached_realm->cancel_transaction();
+            cached_realm->begin_transaction();
+            REQUIRE_FALSE(Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("a"s)).is_valid());
+        }
+
+        SECTION("is used by create_bulk") {
+            auto rows = Object::create_bulk(d, cached_realm, person_schema, std::vector<util::Any>{
+                AnyDict{{"name", "a"s}, {"age", INT64_C(6)}},
+                AnyDict{{"name", "d"s}, {"age", INT64_C(7)}},
+            }, true);
+            REQUIRE(rows[0] == a.row().get_index());
+            REQUIRE(table->get_int(1, rows[0]) == 6);
+            auto obj = Object::get_for_primary_key(d, cached_realm, person_schema, util::Any("d"s));
+            REQUIRE(obj.row().get_index() == rows[1]);
+        }
+        cached_realm->cancel_transaction();
+    }
+
+    SECTION("set_property_values()") {
+        auto obj = create_company(AnyDict{{"name", "a"s}, {"age", INT64_C(1)}}, false);
+        r->begin_transaction();
+
+        obj.set_property_values(d, std::vector<std::pair<StringData, util::Any>>{
+            {"age", INT64_C(2)},
+            {"scores", AnyVec{INT64_C(3), INT64_C(4)}},
+        }, false);
+        REQUIRE(obj.row().get_int(1) == 2);
+        List scores(r, *obj.row().get_table(), 2, obj.row().get_index());
+        REQUIRE(scores.size() == 2);
+
+        SECTION("does nothing if any property is invalid") {
+            REQUIRE_THROWS_AS(obj.set_property_values(d, std::vector<std::pair<StringData, util::Any>>{
+                {"age", INT64_C(5)},
+                {"missing", INT64_C(6)},
+            }, false), InvalidPropertyException);
+            REQUIRE(obj.row().get_int(1) == 2);
+
+            REQUIRE_THROWS_AS(obj.set_property_values(d, std::vector<std::pair<StringData, util::Any>>{
+                {"age", INT64_C(5)},
+                {"name", "b"s},
+            }, false), ModifyPrimaryKeyException);
+            REQUIRE(obj.row().get_int(1) == 2);
+        }
+        r->cancel_transaction();
+    }
+
+    SECTION("reading strings and data as views") {
+        r->begin_transaction();
+        auto& table = *r->read_group().get_table("class_all types");
+        table.add_empty_row();
+        Object obj(r, *r->schema().find("all types"), table[0]);
+        obj.set_property_value(d, "string", util::Any("abc"s), false);
+        obj.set_property_value(d, "data", util::Any("def"s), false);
+
+        CppContext views(r, nullptr, true);
+        auto string = obj.get_property_value<util::Any>(views, "string");
+        auto data = obj.get_property_value<util::Any>(views, "data");
+        REQUIRE(any_cast<StringData>(string) == "abc");
+        REQUIRE(any_cast<StringData>(string).data() == table.get_string(5, 0).data());
+        REQUIRE(any_cast<BinaryData>(data) == BinaryData("def", 3));
+
+        // Views are accepted when setting values too
+        obj.set_property_value(views, "string", util::Any(StringData("ghi")), false);
+        REQUIRE(table.get_string(5, 0) == "ghi");
+        obj.set_property_value(views, "data", util::Any(BinaryData("jkl", 3)), false);
+        REQUIRE(table.get_binary(6, 0) == BinaryData("jkl", 3));
+        r->cancel_transaction();
+    }
+
+    SECTION("key path filtered notifications") {
+        auto obj = create_company(AnyDict{
+            {"name", "a"s},
+            {"age", INT64_C(1)},
+            {"assistant", AnyDict{{"name", "b"s}, {"age", INT64_C(2)}}},
+        }, false);
+        auto& table = *obj.row().get_table();
+        size_t assistant = table.find_first_string(0, "b");
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        int calls = 0;
+        CollectionChangeSet change;
+        auto observe = [&](std::vector<std::string> const& key_paths) {
+            auto token = obj.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+                change = c;
+                ++calls;
+            }, key_paths);
+            advance_and_notify(*r);
+            calls = 0;
+            return token;
+        };
+
+        SECTION("only modifications to the observed columns are reported") {
+            auto token = observe({"age"});
+            write([&] { table.set_int(1, obj.row().get_index(), 5); });
+            REQUIRE(calls == 1);
+            REQUIRE_INDICES(change.modifications, 0);
+            REQUIRE_INDICES(change.columns[1], 0);
+
+            write([&] { List(r, table, 2, obj.row().get_index()).add(INT64_C(1)); });
+            REQUIRE(calls == 1);
+        }
+
+        SECTION("modifications to linked objects are reported for key paths through links") {
+            auto token = observe({"assistant.age"});
+            write([&] { table.set_int(1, assistant, 5); });
+            REQUIRE(calls == 1);
+            REQUIRE_INDICES(change.modifications, 0);
+
+            write([&] { table.set_string(0, assistant, "c"); });
+            REQUIRE(calls == 1);
+        }
+
+        SECTION("deletions are always reported") {
+            auto token = observe({"age"});
+            write([&] { table.move_last_over(obj.row().get_index()); });
+            REQUIRE(calls == 1);
+            REQUIRE_INDICES(change.deletions, 0);
+        }
+
+        SECTION("an unfiltered callback on the same object sees all modifications") {
+            auto token = observe({"age"});
+            auto token2 = obj.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
+            write([&] { List(r, table, 2, obj.row().get_index()).add(INT64_C(1)); });
+            REQUIRE(calls == 1);
+        }
+
+        SECTION("invalid key paths throw") {
+            auto noop = [](CollectionChangeSet, std::exception_ptr) { };
+            REQUIRE_THROWS_AS(obj.add_notification_callback(noop, {"missing"}), InvalidPropertyException);
+            REQUIRE_THROWS_AS(obj.add_notification_callback(noop, {"age.value"}), std::logic_error);
+            REQUIRE_THROWS_AS(obj.add_notification_callback(noop, {"assistant.missing"}), InvalidPropertyException);
+        }
+    }
+
     SECTION("getters and setters") {
         r->begin_transaction();
 
@@ -919,6 +1236,38 @@ TEST_CASE("object") {
         REQUIRE(any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array")).size() == 1);
     }
 
+    SECTION("list properties read repeatedly reflect changes") {
+        auto obj = create(AnyDict{
+            {"pk", INT64_C(1)},
+            {"bool", true},
+            {"int", INT64_C(5)},
+            {"float", 2.2f},
+            {"double", 3.3},
+            {"string", "hello"s},
+            {"data", "olleh"s},
+            {"date", Timestamp(10, 20)},
+            {"object array", AnyVec{AnyDict{{"value", INT64_C(20)}}}},
+        }, false);
+
+        auto list = any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array"));
+        REQUIRE(list.size() == 1);
+        REQUIRE(list == any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array")));
+
+        r->begin_transaction();
+        list.add(d, AnyDict{{"value", INT64_C(30)}});
+        REQUIRE(any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array")).size() == 2);
+        r->commit_transaction();
+        REQUIRE(any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array")).size() == 2);
+
+        // Changes made by another Realm instance are seen once this one advances
+        auto r2 = Realm::get_shared_realm(config);
+        r2->begin_transaction();
+        r2->read_group().get_table("class_all types")->get_linklist(obj.get_object_schema().property_for_name("object array")->table_column, obj.row().get_index())->clear();
+        r2->commit_transaction();
+        r->refresh();
+        REQUIRE(any_cast<List&&>(obj.get_property_value<util::Any>(d, "object array")).size() == 0);
+    }
+
 #if REALM_ENABLE_SYNC
     if (!util::EventLoop::has_implementation())
         return;
@@ -973,3 +1322,153 @@ TEST_CASE("object") {
     }
 #endif
 }
+
+namespace {
+struct TypedPerson {
+    std::string name;
+    int64_t age;
+    util::Optional<std::string> nickname;
+    double score;
+};
+
+struct TypedPoint {
+    int64_t x;
+    util::Optional<int64_t> y;
+    Timestamp created;
+};
+
+// Has a required int for a nullable property
+struct MismatchedPoint {
+    int64_t x;
+};
+}
+
+namespace realm {
+template<> struct ObjectModel<TypedPerson> {
+    static StringData object_type() { return "person"; }
+    static constexpr auto properties()
+    {
+        return std::make_tuple(typed_property("name", &TypedPerson::name),
+                               typed_property("age", &TypedPerson::age),
+                               typed_property("nickname", &TypedPerson::nickname),
+                               typed_property("score", &TypedPerson::score));
+    }
+};
+
+template<> struct ObjectModel<TypedPoint> {
+    static StringData object_type() { return "point"; }
+    static constexpr auto properties()
+    {
+        return std::make_tuple(typed_property("x", &TypedPoint::x),
+                               typed_property("y", &TypedPoint::y),
+                               typed_property("created", &TypedPoint::created));
+    }
+};
+
+template<> struct ObjectModel<MismatchedPoint> {
+    static StringData object_type() { return "mismatched point"; }
+    static constexpr auto properties()
+    {
+        return std::make_tuple(typed_property("x", &MismatchedPoint::x));
+    }
+};
+}
+
+TEST_CASE("typed object") {
+    using namespace std::string_literals;
+
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"person", {
+            {"name", PropertyType::String, Property::IsPrimary{true}},
+            {"age", PropertyType::Int},
+            {"nickname", PropertyType::String|PropertyType::Nullable},
+            {"score", PropertyType::Double},
+            {"friends", PropertyType::Array|PropertyType::Object, "person"},
+        }},
+        {"point", {
+            {"x", PropertyType::Int},
+            {"y", PropertyType::Int|PropertyType::Nullable},
+            {"created", PropertyType::Date},
+        }},
+        {"mismatched point", {
+            {"x", PropertyType::Int|PropertyType::Nullable},
+        }},
+    };
+    auto r = Realm::get_shared_realm(config);
+    TypedTable<TypedPerson> people(r);
+    TypedTable<TypedPoint> points(r);
+
+    SECTION("create() writes every member") {
+        r->begin_transaction();
+        people.create(TypedPerson{"a", 10, util::none, 1.5});
+        auto point = points.create(TypedPoint{1, 2, Timestamp(3, 4)});
+        r->commit_transaction();
+
+        auto table = r->read_group().get_table("class_person");
+        REQUIRE(table->size() == 1);
+        REQUIRE(table->get_string(0, 0) == "a");
+        REQUIRE(table->get_int(1, 0) == 10);
+        REQUIRE(table->is_null(2, 0));
+        REQUIRE(table->get_double(3, 0) == 1.5);
+
+        auto value = point.get();
+        REQUIRE(value.x == 1);
+        REQUIRE(value.y == 2);
+        REQUIRE(value.created == Timestamp(3, 4));
+    }
+
+    SECTION("get() and set() for a single member") {
+        r->begin_transaction();
+        auto person = people.create(TypedPerson{"a", 10, util::none, 1.5});
+        person.set<REALM_MEMBER(&TypedPerson::age)>(11);
+        person.set<REALM_MEMBER(&TypedPerson::nickname)>("b"s);
+        auto age = person.get<REALM_MEMBER(&TypedPerson::age)>();
+        auto nickname = person.get<REALM_MEMBER(&TypedPerson::nickname)>();
+        REQUIRE(age == 11);
+        REQUIRE(nickname == "b"s);
+
+        person.set<REALM_MEMBER(&TypedPerson::nickname)>(util::none);
+        nickname = person.get<REALM_MEMBER(&TypedPerson::nickname)>();
+        REQUIRE_FALSE(nickname);
+        auto name = person.get<REALM_MEMBER(&TypedPerson::name)>();
+        REQUIRE(name == "a");
+        r->commit_transaction();
+
+        auto set_age = [&] { person.set<REALM_MEMBER(&TypedPerson::age)>(12); };
+        REQUIRE_THROWS(set_age());
+    }
+
+    SECTION("primary keys") {
+        r->begin_transaction();
+        people.create(TypedPerson{"a", 10, util::none, 1.5});
+        REQUIRE_THROWS(people.create(TypedPerson{"a", 11, util::none, 1.5}));
+        auto person = people.create(TypedPerson{"a", 12, "b"s, 2.5}, true);
+        REQUIRE(people.size() == 1);
+        REQUIRE(person.get().age == 12);
+        auto set_name = [&] { person.set<REALM_MEMBER(&TypedPerson::name)>("c"); };
+        REQUIRE_THROWS_AS(set_name(), ModifyPrimaryKeyException);
+
+        auto score = people.get_for_primary_key("a"s).get<REALM_MEMBER(&TypedPerson::score)>();
+        REQUIRE(score == 2.5);
+        REQUIRE_FALSE(people.get_for_primary_key("b"s).is_valid());
+        REQUIRE(people.get_for_primary_key("a").is_valid());
+        REQUIRE_THROWS_AS(points.get_for_primary_key(INT64_C(1)), MissingPrimaryKeyException);
+        r->cancel_transaction();
+    }
+
+    SECTION("accessing a deleted object throws") {
+        r->begin_transaction();
+        auto point = points.create(TypedPoint{1, util::none, Timestamp(0, 0)});
+        point.row().get_table()->move_last_over(point.row().get_index());
+        REQUIRE_FALSE(point.is_valid());
+        auto get_x = [&] { return point.get<REALM_MEMBER(&TypedPoint::x)>(); };
+        REQUIRE_THROWS_AS(get_x(), InvalidatedObjectException);
+        r->cancel_transaction();
+    }
+
+    SECTION("rejects models which don't match the schema") {
+        REQUIRE_THROWS(TypedTable<MismatchedPoint>(r));
+    }
+}
@@ -485,6 +485,20 @@ TEMPLATE_TEST_CASE("primitive list", ::Int, ::Bool, ::Float, ::Double, ::String,
         REQUIRE_THROWS(results.get(ctx, values.size()));
     }
 
+    SECTION("read_into()") {
+        std::unique_ptr<T[]> out(new T[values.size() + 1]);
+        REQUIRE(list.read_into(out.get(), values.size() + 1) == values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            CAPTURE(i);
+            REQUIRE(out[i] == values[i]);
+        }
+
+        REQUIRE(list.read_into(out.get(), 1, values.size() - 1) == 1);
+        REQUIRE(out[0] == values.back());
+        REQUIRE(list.read_into(out.get(), 1, values.size()) == 0);
+        REQUIRE_THROWS(list.read_into(out.get(), 1, values.size() + 1));
+    }
+
     SECTION("first()") {
         REQUIRE(*results.first<T>() == values.front());
         REQUIRE(any_cast<Boxed>(*results.first(ctx)) == Boxed(values.front()));
@@ -750,6 +764,43 @@ TEMPLATE_TEST_CASE("primitive list", ::Int, ::Bool, ::Float, ::Double, ::String,
             REQUIRE(rchange.deletions.count() == values.size());
         }
 
+        SECTION("value diffing") {
+            CollectionChangeSet diff_change;
+            auto token = list.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+                change = c;
+            });
+            auto diff_token = list.add_value_diff_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+                diff_change = c;
+            });
+            advance_and_notify(*r);
+
+            auto refill = [&](size_t skip) {
+                r->begin_transaction();
+                list.remove_all();
+                for (size_t i = skip; i < values.size(); ++i)
+                    list.add(static_cast<T>(values[i]));
+                r->commit_transaction();
+                advance_and_notify(*r);
+            };
+
+            refill(1);
+            REQUIRE(change.deletions.count() == values.size());
+            REQUIRE(change.insertions.count() == values.size() - 1);
+            REQUIRE_INDICES(diff_change.deletions, 0);
+            REQUIRE(diff_change.insertions.empty());
+
+            refill(0);
+            REQUIRE(diff_change.deletions.empty());
+            REQUIRE_INDICES(diff_change.insertions, 0);
+
+            diff_change = {};
+            r->begin_transaction();
+            list.set(0, static_cast<T>(values[0]));
+            r->commit_transaction();
+            advance_and_notify(*r);
+            REQUIRE(diff_change.empty());
+        }
+
         SECTION("delete containing row") {
             size_t calls = 0;
             auto token = list.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
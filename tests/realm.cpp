@@ -19,6 +19,8 @@
 #include "catch.hpp"
 
 #include "util/event_loop.hpp"
+#include "util/executor.hpp"
+#include "util/index_helpers.hpp"
 #include "util/test_file.hpp"
 #include "util/templated_test_case.hpp"
 #include "util/test_utils.hpp"
@@ -27,14 +29,22 @@
 #include "object_schema.hpp"
 #include "object_store.hpp"
 #include "property.hpp"
+#include "realm_pool.hpp"
 #include "results.hpp"
 #include "schema.hpp"
+#include "thread_safe_reference.hpp"
 
 #include "impl/realm_coordinator.hpp"
 
 #include <realm/group.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
 namespace realm {
 class TestHelper {
 public:
@@ -142,6 +152,12 @@ TEST_CASE("SharedRealm: get_shared_realm()") {
             REQUIRE_THROWS(Realm::get_shared_realm(config));
         }
 
+        SECTION("single-process mode") {
+            auto realm = Realm::get_shared_realm(config);
+            config.single_process = true;
+            REQUIRE_THROWS(Realm::get_shared_realm(config));
+        }
+
         SECTION("schema") {
             auto realm = Realm::get_shared_realm(config);
             config.schema = Schema{
@@ -436,6 +452,31 @@ TEST_CASE("SharedRealm: get_shared_realm()") {
         }).join();
     }
 
+    SECTION("should cache a new instance for an execution context after the previous one is closed") {
+        config.execution_context = 1;
+        auto realm1 = Realm::get_shared_realm(config);
+        config.execution_context = 2;
+        auto realm2 = Realm::get_shared_realm(config);
+
+        config.execution_context = 1;
+        realm1->close();
+        auto realm3 = Realm::get_shared_realm(config);
+        REQUIRE(realm3 != realm1);
+        REQUIRE(Realm::get_shared_realm(config) == realm3);
+
+        config.execution_context = 2;
+        REQUIRE(Realm::get_shared_realm(config) == realm2);
+    }
+
+    SECTION("should not return an uncached instance from the cache") {
+        config.cache = false;
+        auto realm1 = Realm::get_shared_realm(config);
+        config.cache = true;
+        auto realm2 = Realm::get_shared_realm(config);
+        REQUIRE(realm1 != realm2);
+        REQUIRE(Realm::get_shared_realm(config) == realm2);
+    }
+
     SECTION("should not modify the schema when fetching from the cache") {
         auto realm = Realm::get_shared_realm(config);
         auto object_schema = &*realm->schema().find("object");
@@ -585,6 +626,21 @@ TEST_CASE("SharedRealm: notifications") {
         REQUIRE(change_count == 1);
     }
 
+    SECTION("remote notifications are sent asynchronously in single-process mode") {
+        realm.reset();
+        config.single_process = true;
+        realm = Realm::get_shared_realm(config);
+        realm->m_binding_context.reset(new Context{&change_count});
+        realm->m_binding_context->realm = realm;
+
+        auto r2 = Realm::get_shared_realm(config);
+        r2->begin_transaction();
+        r2->commit_transaction();
+        REQUIRE(change_count == 0);
+        util::EventLoop::main().run_until([&]{ return change_count > 0; });
+        REQUIRE(change_count == 1);
+    }
+
     SECTION("refresh() from within changes_available() refreshes") {
         struct Context : BindingContext {
             Realm& realm;
@@ -672,6 +728,314 @@ TEST_CASE("SharedRealm: notifications") {
     }
 }
 
+TEST_CASE("SharedRealm: notification executor") {
+    struct QueueExecutor : util::Executor {
+        std::vector<std::function<void()>> tasks;
+        bool current = true;
+
+        void post(std::function<void()> task) override
+        {
+            tasks.push_back(std::move(task));
+        }
+
+        bool is_current() const override
+        {
+            return current;
+        }
+
+        void run()
+        {
+            auto pending = std::move(tasks);
+            tasks.clear();
+            for (auto& task : pending)
+                task();
+        }
+    };
+
+    auto executor = std::make_shared<QueueExecutor>();
+
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+    config.notification_executor = executor;
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = realm->read_group().get_table("class_object");
+    Results results(realm, *table);
+
+    int notification_calls = 0;
+    auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++notification_calls;
+    });
+    coordinator->on_change();
+    executor->run();
+    REQUIRE(notification_calls == 1);
+
+    SECTION("remote changes are delivered through the executor") {
+        auto r2 = Realm::get_shared_realm(config);
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->add_empty_row();
+        r2->commit_transaction();
+
+        coordinator->on_change();
+        REQUIRE(executor->tasks.size() == 1);
+        REQUIRE(notification_calls == 1);
+
+        executor->run();
+        REQUIRE(notification_calls == 2);
+        REQUIRE(results.size() == 1);
+    }
+
+    SECTION("wakeups are coalesced until the posted task runs") {
+        auto r2 = Realm::get_shared_realm(config);
+        for (int i = 0; i < 2; ++i) {
+            r2->begin_transaction();
+            r2->read_group().get_table("class_object")->add_empty_row();
+            r2->commit_transaction();
+            coordinator->on_change();
+        }
+        REQUIRE(executor->tasks.size() == 1);
+
+        executor->run();
+        REQUIRE(notification_calls == 2);
+        REQUIRE(results.size() == 2);
+    }
+
+    SECTION("using the Realm from outside the executor throws") {
+        executor->current = false;
+        REQUIRE_THROWS_AS(realm->verify_thread(), IncorrectThreadException);
+        executor->current = true;
+        REQUIRE_NOTHROW(realm->verify_thread());
+    }
+}
+
+namespace {
+// Tasks are posted from background threads, so this has to be thread-safe
+struct BlockingExecutor : util::Executor {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::function<void()>> tasks;
+
+    void post(std::function<void()> task) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        cv.notify_all();
+    }
+
+    // Wait for a task to be posted and then run it
+    void run_one()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return !tasks.empty(); });
+        auto task = std::move(tasks.front());
+        tasks.erase(tasks.begin());
+        lock.unlock();
+        task();
+    }
+};
+} // anonymous namespace
+
+TEST_CASE("SharedRealm: async_write") {
+    auto executor = std::make_shared<BlockingExecutor>();
+
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+    config.notification_executor = executor;
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+
+    SECTION("performs the write off-thread and delivers the completion through the executor") {
+        auto thread_id = std::this_thread::get_id();
+        bool write_on_other_thread = false;
+        bool completed = false;
+        realm->async_write([&](Realm& r) {
+            write_on_other_thread = std::this_thread::get_id() != thread_id;
+            r.read_group().get_table("class_object")->add_empty_row();
+        }, [&](std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            completed = true;
+        });
+        REQUIRE_FALSE(completed);
+
+        executor->run_one();
+        REQUIRE(completed);
+        REQUIRE(write_on_other_thread);
+        // The Realm is refreshed before the completion is called
+        REQUIRE(table->size() == 1);
+    }
+
+    SECTION("writes are performed in order") {
+        std::vector<int> completions;
+        for (int i = 0; i < 3; ++i) {
+            realm->async_write([=](Realm& r) {
+                auto table = r.read_group().get_table("class_object");
+                table->set_int(0, table->add_empty_row(), i);
+            }, [&, i](std::exception_ptr) {
+                completions.push_back(i);
+            });
+        }
+        for (int i = 0; i < 3; ++i)
+            executor->run_one();
+        REQUIRE((completions == std::vector<int>{0, 1, 2}));
+        REQUIRE(table->size() == 3);
+        for (size_t i = 0; i < 3; ++i)
+            REQUIRE(table->get_int(0, i) == int64_t(i));
+    }
+
+    SECTION("an exception thrown by the write cancels it and is reported") {
+        std::exception_ptr error;
+        realm->async_write([](Realm& r) {
+            r.read_group().get_table("class_object")->add_empty_row();
+            throw std::runtime_error("failed");
+        }, [&](std::exception_ptr err) {
+            error = err;
+        });
+
+        executor->run_one();
+        REQUIRE(error);
+        REQUIRE_THROWS_WITH(std::rethrow_exception(error), "failed");
+        REQUIRE(table->size() == 0);
+    }
+
+    SECTION("grouped writes waiting at the same time share a commit") {
+        // Hold up the async write thread so that the grouped writes are all
+        // waiting when it gets to them
+        auto version = realm->read_transaction_version().version;
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        realm->async_write([=](Realm&) { released.wait(); }, [](std::exception_ptr) { });
+
+        std::vector<std::exception_ptr> errors(3);
+        for (int i = 0; i < 3; ++i) {
+            realm->async_write([=](Realm& r) {
+                r.read_group().get_table("class_object")->add_empty_row();
+                if (i == 1)
+                    throw std::runtime_error("failed");
+            }, [&, i](std::exception_ptr err) {
+                errors[i] = err;
+            }, true);
+        }
+        release.set_value();
+
+        for (int i = 0; i < 4; ++i)
+            executor->run_one();
+        REQUIRE_FALSE(errors[0]);
+        REQUIRE(errors[1]);
+        REQUIRE_FALSE(errors[2]);
+        // The failed write was rolled back and the other two were redone in
+        // a single transaction after the one for the first write
+        REQUIRE(table->size() == 2);
+        REQUIRE(realm->read_transaction_version().version == version + 2);
+    }
+
+    SECTION("read-only Realms throw") {
+        realm.reset();
+        config.schema_mode = SchemaMode::ReadOnly;
+        auto read_only = Realm::get_shared_realm(config);
+        REQUIRE_THROWS_AS(read_only->async_write([](Realm&) { }, [](std::exception_ptr) { }),
+                          InvalidTransactionException);
+    }
+}
+
+TEST_CASE("SharedRealm: async_open") {
+    auto executor = std::make_shared<BlockingExecutor>();
+
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 1;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+    config.notification_executor = executor;
+
+    SECTION("initializes the file in the background and opens the Realm on the calling thread") {
+        auto thread_id = std::this_thread::get_id();
+        bool initialized_on_other_thread = false;
+        config.initialization_function = [&](SharedRealm) {
+            initialized_on_other_thread = std::this_thread::get_id() != thread_id;
+        };
+
+        SharedRealm opened;
+        Realm::async_open(config, [&](SharedRealm realm, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            opened = realm;
+        });
+        REQUIRE_FALSE(opened);
+
+        executor->run_one();
+        REQUIRE(opened);
+        REQUIRE(initialized_on_other_thread);
+        REQUIRE(opened->schema() == *config.schema);
+        REQUIRE(opened->schema_version() == 1);
+
+        // The Realm is usable from this thread
+        opened->begin_transaction();
+        opened->read_group().get_table("class_object")->add_empty_row();
+        opened->commit_transaction();
+    }
+
+    SECTION("warms up the listed types and ignores ones which don't exist") {
+        config.warm_up_object_types = {"object", "missing"};
+        bool called = false;
+        Realm::async_open(config, [&](SharedRealm realm, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            REQUIRE(realm);
+            called = true;
+        });
+        executor->run_one();
+        REQUIRE(called);
+    }
+
+    SECTION("synchronous opens which list types to warm up don't wait for it") {
+        config.warm_up_object_types = {"object", "missing"};
+        config.notification_executor = nullptr;
+        auto realm = Realm::get_shared_realm(config);
+        realm->begin_transaction();
+        realm->read_group().get_table("class_object")->add_empty_row();
+        realm->commit_transaction();
+        REQUIRE(realm->read_group().get_table("class_object")->size() == 1);
+
+        auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+        REQUIRE(coordinator->wait_for_warm_up());
+    }
+
+    SECTION("reports errors from the background open") {
+        config.schema_version = 2;
+        Realm::get_shared_realm(config);
+
+        config.schema_version = 1;
+        bool called = false;
+        Realm::async_open(config, [&](SharedRealm realm, std::exception_ptr err) {
+            REQUIRE_FALSE(realm);
+            REQUIRE(err);
+            REQUIRE_THROWS(std::rethrow_exception(err));
+            called = true;
+        });
+        executor->run_one();
+        REQUIRE(called);
+    }
+}
+
 TEST_CASE("SharedRealm: schema updating from external changes") {
     TestFile config;
     config.cache = false;
@@ -754,6 +1118,110 @@ TEST_CASE("SharedRealm: schema updating from external changes") {
     }
 }
 
+TEST_CASE("SharedRealm: refresh with change summary") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+        {"other", {
+            {"value", PropertyType::Int}
+        }},
+    };
+
+    auto r1 = Realm::get_shared_realm(config);
+    auto r2 = Realm::get_shared_realm(config);
+    auto table = r2->read_group().get_table("class_object");
+    auto other = r2->read_group().get_table("class_other");
+    r1->read_group();
+
+    r2->begin_transaction();
+    table->add_empty_row(3);
+    other->add_empty_row();
+    r2->commit_transaction();
+
+    Realm::ChangeSummary summary;
+    REQUIRE(r1->refresh(summary));
+    REQUIRE(summary.to_version == r2->read_transaction_version());
+
+    SECTION("reports the changed object types and the versions advanced over") {
+        auto before = r1->read_transaction_version();
+        r2->begin_transaction();
+        table->set_int(0, 1, 5);
+        table->move_last_over(2);
+        table->add_empty_row();
+        r2->commit_transaction();
+
+        REQUIRE(r1->refresh(summary));
+        REQUIRE(summary.from_version == before);
+        REQUIRE(summary.to_version == r2->read_transaction_version());
+        REQUIRE_FALSE(summary.schema_changed);
+        REQUIRE(summary.object_types.size() == 1);
+        auto& changes = summary.object_types[0];
+        REQUIRE(changes.object_type == "object");
+        REQUIRE(changes.insertions == 1);
+        REQUIRE(changes.deletions == 1);
+        REQUIRE(changes.modifications == 1);
+    }
+
+    SECTION("combines multiple commits") {
+        r2->begin_transaction();
+        table->add_empty_row();
+        r2->commit_transaction();
+        r2->begin_transaction();
+        other->add_empty_row();
+        r2->commit_transaction();
+
+        REQUIRE(r1->refresh(summary));
+        REQUIRE(summary.object_types.size() == 2);
+        REQUIRE(summary.object_types[0].object_type == "object");
+        REQUIRE(summary.object_types[0].insertions == 1);
+        REQUIRE(summary.object_types[1].object_type == "other");
+        REQUIRE(summary.object_types[1].insertions == 1);
+    }
+
+    SECTION("is empty when there are no new versions") {
+        auto version = r1->read_transaction_version();
+        REQUIRE_FALSE(r1->refresh(summary));
+        REQUIRE(summary.from_version == version);
+        REQUIRE(summary.to_version == version);
+        REQUIRE(summary.object_types.empty());
+    }
+
+    SECTION("reports schema changes") {
+        r2->begin_transaction();
+        other->add_column(type_String, "new col");
+        r2->commit_transaction();
+
+        REQUIRE(r1->refresh(summary));
+        REQUIRE(summary.schema_changed);
+    }
+
+    SECTION("reports the same changes when KVO observers are registered") {
+        struct Context : BindingContext {
+            std::vector<ObserverState> observers;
+            std::vector<ObserverState> get_observed_rows() override { return observers; }
+            void did_change(std::vector<ObserverState> const&, std::vector<void*> const&, bool) override { }
+        };
+        auto context = new Context;
+        context->observers.push_back({table->get_index_in_group(), 0, nullptr});
+        r1->m_binding_context.reset(context);
+        r1->m_binding_context->realm = r1;
+
+        r2->begin_transaction();
+        table->set_int(0, 0, 1);
+        other->add_empty_row();
+        r2->commit_transaction();
+
+        REQUIRE(r1->refresh(summary));
+        REQUIRE(summary.object_types.size() == 2);
+        REQUIRE(summary.object_types[0].modifications == 1);
+        REQUIRE(summary.object_types[1].insertions == 1);
+    }
+}
+
 TEST_CASE("SharedRealm: closed realm") {
     TestFile config;
     config.schema_version = 1;
@@ -825,6 +1293,46 @@ TEST_CASE("ShareRealm: in-memory mode from buffer") {
     }
 }
 
+TEST_CASE("SharedRealm: streaming write_copy()") {
+    TestFile config;
+    config.schema_version = 1;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::String}
+        }},
+    };
+    auto realm = Realm::get_shared_realm(config);
+    realm->begin_transaction();
+    auto table = realm->read_group().get_table("class_object");
+    table->add_empty_row(1000);
+    for (size_t i = 0; i < 1000; ++i)
+        table->set_string(0, i, util::format("value %1", i));
+    realm->commit_transaction();
+
+    SECTION("writes a readable copy in bounded chunks") {
+        std::string copy;
+        size_t largest_chunk = 0;
+        realm->write_copy([&](const char* data, size_t size) {
+            largest_chunk = std::max(largest_chunk, size);
+            copy.append(data, size);
+        }, 256);
+        REQUIRE(largest_chunk <= 256);
+
+        Realm::Config config2;
+        config2.in_memory = true;
+        config2.schema_mode = SchemaMode::Immutable;
+        config2.realm_data = BinaryData(copy.data(), copy.size());
+        auto realm2 = Realm::get_shared_realm(config2);
+        REQUIRE(realm2->read_group().get_table("class_object")->size() == 1000);
+    }
+
+    SECTION("propagates exceptions thrown by the sink") {
+        REQUIRE_THROWS_WITH(realm->write_copy([](const char*, size_t) {
+            throw std::runtime_error("upload failed");
+        }), "upload failed");
+    }
+}
+
 TEST_CASE("ShareRealm: realm closed in did_change callback") {
     TestFile config;
     config.schema_version = 1;
@@ -901,39 +1409,541 @@ TEST_CASE("ShareRealm: realm closed in did_change callback") {
     shared_realm = nullptr;
 }
 
-TEST_CASE("RealmCoordinator: schema cache") {
-    TestFile config;
-    auto coordinator = _impl::RealmCoordinator::get_coordinator(config.path);
+TEST_CASE("RealmCoordinator: coordinator lookup") {
+    TestFile config1;
+    TestFile config2;
 
-    Schema cache_schema;
-    uint64_t cache_sv = -1, cache_tv = -1;
+    auto coordinator1 = _impl::RealmCoordinator::get_coordinator(config1.path);
+    auto coordinator2 = _impl::RealmCoordinator::get_coordinator(config2.path);
+    REQUIRE(coordinator1 != coordinator2);
+    REQUIRE(_impl::RealmCoordinator::get_coordinator(config1.path) == coordinator1);
+    REQUIRE(_impl::RealmCoordinator::get_existing_coordinator(config1.path) == coordinator1);
+    REQUIRE(_impl::RealmCoordinator::get_existing_coordinator(config2.path) == coordinator2);
 
-    Schema schema{
+    SECTION("releasing a coordinator removes only that path") {
+        coordinator1.reset();
+        REQUIRE_FALSE(_impl::RealmCoordinator::get_existing_coordinator(config1.path));
+        REQUIRE(_impl::RealmCoordinator::get_existing_coordinator(config2.path) == coordinator2);
+    }
+
+    SECTION("a new coordinator is created after the old one is released") {
+        coordinator1.reset();
+        auto coordinator3 = _impl::RealmCoordinator::get_coordinator(config1.path);
+        REQUIRE(_impl::RealmCoordinator::get_existing_coordinator(config1.path) == coordinator3);
+    }
+
+    SECTION("concurrent lookups of the same path return the same coordinator") {
+        TestFile config3;
+        std::vector<std::shared_ptr<_impl::RealmCoordinator>> results(8);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&, i] {
+                results[i] = _impl::RealmCoordinator::get_coordinator(config3.path);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (auto& coordinator : results)
+            REQUIRE(coordinator == results[0]);
+    }
+}
+
+TEST_CASE("RealmCoordinator: pinned versions") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
         {"object", {
             {"value", PropertyType::Int}
         }},
     };
-    Schema schema2{
-        {"object", {
-            {"value", PropertyType::Int},
-        }},
-        {"object 2", {
-            {"value", PropertyType::Int},
-        }},
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto write = [&] {
+        auto r2 = Realm::get_shared_realm(config);
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->add_empty_row();
+        r2->commit_transaction();
     };
+    using Holder = _impl::RealmCoordinator::PinnedVersion::Holder;
 
-    SECTION("valid initial schema sets cache") {
-        coordinator->cache_schema(schema, 5, 10);
-        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
-        REQUIRE(cache_schema == schema);
-        REQUIRE(cache_sv == 5);
-        REQUIRE(cache_tv == 10);
+    SECTION("frozen Realms are reported until they're released") {
+        REQUIRE(coordinator->get_pinned_versions().empty());
+        auto frozen = realm->freeze();
+        auto pins = coordinator->get_pinned_versions();
+        REQUIRE(pins.size() == 1);
+        REQUIRE(pins[0].holder == Holder::FrozenRealm);
+        REQUIRE(pins[0].version == frozen->read_transaction_version());
+
+        frozen = nullptr;
+        REQUIRE(coordinator->get_pinned_versions().empty());
     }
 
-    SECTION("cache can be updated with newer schema") {
-        coordinator->cache_schema(schema, 5, 10);
-        coordinator->cache_schema(schema2, 6, 11);
-        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
+    SECTION("notifiers are reported once they've run") {
+        Results results(realm, *realm->read_group().get_table("class_object"));
+        auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+        auto pins = coordinator->get_pinned_versions();
+        REQUIRE(pins.size() == 1);
+        REQUIRE(pins[0].holder == Holder::NewNotifiers);
+
+        coordinator->on_change();
+        pins = coordinator->get_pinned_versions();
+        REQUIRE(pins.size() == 1);
+        REQUIRE(pins[0].holder == Holder::Notifiers);
+        REQUIRE(pins[0].version == realm->read_transaction_version());
+    }
+
+    SECTION("held read transactions keep versions alive") {
+        realm->read_group();
+        auto initial = realm->get_number_of_versions();
+        for (int i = 0; i < 5; ++i)
+            write();
+        REQUIRE(realm->get_number_of_versions() >= initial + 5);
+
+        realm->refresh();
+        write();
+        REQUIRE(realm->get_number_of_versions() < initial + 5);
+    }
+
+    SECTION("the alarm is called when too many versions are alive") {
+        Results results(realm, *realm->read_group().get_table("class_object"));
+        auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+        coordinator->on_change();
+
+        uint64_t reported_versions = 0;
+        coordinator->set_pinned_version_alarm(3, [&](uint64_t live_versions, auto const&) {
+            reported_versions = live_versions;
+        });
+        write();
+        coordinator->on_change();
+        REQUIRE(reported_versions == 0);
+
+        // `realm` is still reading the version from before these writes
+        for (int i = 0; i < 4; ++i)
+            write();
+        coordinator->on_change();
+        REQUIRE(reported_versions > 3);
+    }
+}
+
+TEST_CASE("RealmCoordinator: memory stats") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = realm->read_group().get_table("class_object");
+    realm->begin_transaction();
+    table->add_empty_row(100);
+    realm->commit_transaction();
+
+    auto stats = coordinator->memory_stats();
+    REQUIRE(stats.notifiers.empty());
+    REQUIRE(stats.realms.empty());
+    REQUIRE(stats.open_realms == 1);
+    REQUIRE(stats.cached_schemas > 0);
+    REQUIRE(stats.cached_schema_bytes > 0);
+
+    Results results(realm, *table);
+    auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+    coordinator->on_change();
+
+    stats = coordinator->memory_stats();
+    REQUIRE(stats.notifiers.size() == 1);
+    REQUIRE(stats.notifiers[0].realm == realm.get());
+    REQUIRE(stats.notifiers[0].callbacks == 1);
+    REQUIRE(stats.notifiers[0].retained_bytes >= 100 * sizeof(size_t));
+    REQUIRE(stats.realms.size() == 1);
+    REQUIRE(stats.realms[0].realm == realm.get());
+    REQUIRE(stats.realms[0].notifiers == 1);
+    REQUIRE(stats.realms[0].notifier_bytes >= stats.notifiers[0].retained_bytes);
+}
+
+TEST_CASE("RealmCoordinator: observe_table_changes()") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"other", PropertyType::Int},
+        }},
+        {"unobserved", {
+            {"value", PropertyType::Int}
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = realm->read_group().get_table("class_object");
+    auto unobserved = realm->read_group().get_table("class_unobserved");
+
+    size_t calls = 0;
+    _impl::TableChangeInfoNotifier::Changes last;
+    std::vector<CollectionChangeSet> last_changes;
+    auto token = _impl::RealmCoordinator::observe_table_changes(realm, {table->get_index_in_group()},
+                                                                [&](auto const& changes) {
+        ++calls;
+        last.version = changes.version;
+        last.changes_unknown = changes.changes_unknown;
+        last.tables = changes.tables;
+        last_changes.clear();
+        for (auto& table : changes.tables)
+            last_changes.push_back(*table.changes);
+    });
+
+    realm->begin_transaction();
+    table->add_empty_row(3);
+    realm->commit_transaction();
+    coordinator->on_change();
+    REQUIRE(calls == 1);
+    REQUIRE_FALSE(last.changes_unknown);
+    REQUIRE(last.version == realm->read_transaction_version());
+    REQUIRE(last.tables.size() == 1);
+    REQUIRE(last.tables[0].table_ndx == table->get_index_in_group());
+    REQUIRE(last_changes[0].insertions.count() == 3);
+
+    realm->begin_transaction();
+    table->set_int(1, 2, 5);
+    realm->commit_transaction();
+    coordinator->on_change();
+    REQUIRE(calls == 2);
+    REQUIRE(last_changes[0].insertions.empty());
+    REQUIRE(last_changes[0].modifications.count() == 1);
+    REQUIRE(last_changes[0].modifications.contains(2));
+    REQUIRE(last_changes[0].columns.size() > 1);
+    REQUIRE(last_changes[0].columns[1].contains(2));
+
+    // Commits which don't touch the observed tables aren't reported
+    realm->begin_transaction();
+    unobserved->add_empty_row();
+    realm->commit_transaction();
+    coordinator->on_change();
+    REQUIRE(calls == 2);
+
+    token = {};
+    realm->begin_transaction();
+    table->add_empty_row();
+    realm->commit_transaction();
+    coordinator->on_change();
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("RealmCoordinator: metrics") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = realm->read_group().get_table("class_object");
+    auto initial = coordinator->metrics();
+
+    Results results(realm, *table);
+    auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+    coordinator->on_change();
+    realm->notify();
+
+    realm->begin_transaction();
+    table->add_empty_row(10);
+    realm->commit_transaction();
+    coordinator->on_change();
+    realm->notify();
+
+    auto metrics = coordinator->metrics();
+    REQUIRE(metrics.commits == initial.commits + 1);
+    REQUIRE(metrics.notifier_passes == initial.notifier_passes + 2);
+    REQUIRE(metrics.notifier_runs == initial.notifier_runs + 2);
+    REQUIRE(metrics.notifier_run_microseconds.count == metrics.notifier_runs);
+    REQUIRE(metrics.handovers >= initial.handovers + 2);
+    // Only the second pass had notifiers which had already run
+    REQUIRE(metrics.changed_rows.count == initial.changed_rows.count + 1);
+
+    auto r2 = Realm::get_shared_realm(config);
+    REQUIRE(coordinator->metrics().schema_cache_hits > metrics.schema_cache_hits);
+
+    auto ref = ThreadSafeReference<Results>(results);
+    r2->resolve_thread_safe_reference(std::move(ref));
+    REQUIRE(coordinator->metrics().thread_safe_reference_imports == metrics.thread_safe_reference_imports + 1);
+
+    SECTION("can be written in the Prometheus format") {
+        util::PrometheusWriter writer;
+        metrics = coordinator->metrics();
+        metrics.write_prometheus(writer, "a\"b");
+        metrics.write_prometheus(writer, "c");
+        auto& text = writer.text();
+        auto commits = std::to_string(metrics.commits);
+        REQUIRE(text.find("realm_commits_total{path=\"a\\\"b\"} " + commits + "\n") != std::string::npos);
+        REQUIRE(text.find("realm_commits_total{path=\"c\"} " + commits + "\n") != std::string::npos);
+        REQUIRE(text.find("realm_notifier_run_microseconds_bucket{path=\"c\",le=\"+Inf\"}") != std::string::npos);
+        // Help is only written once for each metric
+        auto help = text.find("# HELP realm_commits_total");
+        REQUIRE(help != std::string::npos);
+        REQUIRE(text.find("# HELP realm_commits_total", help + 1) == std::string::npos);
+        // and the samples for both paths follow it before the next metric
+        auto next_help = text.find("# HELP", help + 1);
+        REQUIRE(text.find("realm_commits_total{path=\"c\"}") < next_help);
+    }
+}
+
+TEST_CASE("RealmPool") {
+    TestFile config;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+    auto writer = Realm::get_shared_realm(config);
+    auto pool = RealmPool::make(config, 2);
+
+    SECTION("reuses returned instances") {
+        Realm* first;
+        {
+            auto realm = pool->get_realm();
+            first = realm.get();
+            REQUIRE(realm != writer);
+            REQUIRE(pool->idle_count() == 0);
+        }
+        REQUIRE(pool->idle_count() == 1);
+        auto realm = pool->get_realm();
+        REQUIRE(realm.get() == first);
+        REQUIRE(pool->idle_count() == 0);
+    }
+
+    SECTION("opens new instances while all of them are checked out") {
+        auto r1 = pool->get_realm();
+        auto r2 = pool->get_realm();
+        auto r3 = pool->get_realm();
+        REQUIRE(r1 != r2);
+        REQUIRE(r2 != r3);
+        r1 = nullptr;
+        r2 = nullptr;
+        r3 = nullptr;
+        // Only max_idle of them are kept
+        REQUIRE(pool->idle_count() == 2);
+        pool->clear();
+        REQUIRE(pool->idle_count() == 0);
+    }
+
+    SECTION("idle instances don't hold a read transaction") {
+        Realm* pooled;
+        {
+            auto realm = pool->get_realm();
+            pooled = realm.get();
+            REQUIRE(realm->is_in_read_transaction());
+        }
+        REQUIRE_FALSE(pooled->is_in_read_transaction());
+    }
+
+    SECTION("checked out instances are at the latest version") {
+        pool->get_realm();
+        REQUIRE(pool->idle_count() == 1);
+
+        writer->begin_transaction();
+        writer->read_group().get_table("class_object")->add_empty_row();
+        writer->commit_transaction();
+
+        auto realm = pool->get_realm();
+        REQUIRE(realm->read_group().get_table("class_object")->size() == 1);
+    }
+
+    SECTION("checked out instances aren't advanced by commits from other Realms") {
+        auto realm = pool->get_realm();
+        REQUIRE_FALSE(realm->auto_refresh());
+        auto table = realm->read_group().get_table("class_object");
+
+        writer->begin_transaction();
+        writer->read_group().get_table("class_object")->add_empty_row();
+        writer->commit_transaction();
+        advance_and_notify(*writer);
+        realm->notify();
+
+        REQUIRE(realm->is_in_read_transaction());
+        REQUIRE(table->size() == 0);
+
+        realm = nullptr;
+        realm = pool->get_realm();
+        REQUIRE(realm->read_group().get_table("class_object")->size() == 1);
+    }
+
+    SECTION("can be used from other threads") {
+        pool->get_realm();
+        bool threw = false;
+        std::thread([&] {
+            try {
+                auto realm = pool->get_realm();
+                realm->read_group().get_table("class_object")->size();
+            }
+            catch (...) {
+                threw = true;
+            }
+        }).join();
+        REQUIRE_FALSE(threw);
+        REQUIRE(pool->idle_count() == 1);
+    }
+
+    SECTION("write transactions are cancelled on release") {
+        {
+            auto realm = pool->get_realm();
+            realm->begin_transaction();
+            realm->read_group().get_table("class_object")->add_empty_row();
+        }
+        REQUIRE(pool->idle_count() == 1);
+        writer->refresh();
+        REQUIRE(writer->read_group().get_table("class_object")->size() == 0);
+    }
+
+    SECTION("instances still in use by accessors aren't returned") {
+        Results results;
+        {
+            auto realm = pool->get_realm();
+            results = Results(realm->shared_from_this(), *realm->read_group().get_table("class_object"));
+        }
+        REQUIRE(pool->idle_count() == 0);
+    }
+
+    SECTION("instances returned after the pool is destroyed are closed") {
+        auto realm = pool->get_realm();
+        std::weak_ptr<Realm> weak = realm->shared_from_this();
+        pool = nullptr;
+        realm = nullptr;
+        REQUIRE(weak.expired());
+    }
+}
+
+TEST_CASE("RealmCoordinator: memory pressure") {
+    TestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema_version = 0;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = realm->read_group().get_table("class_object");
+    realm->begin_transaction();
+    table->add_empty_row(100);
+    realm->commit_transaction();
+
+    Results results(realm, *table);
+    size_t notification_count = 0;
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+        change = c;
+        ++notification_count;
+    });
+    coordinator->on_change();
+    realm->notify();
+    REQUIRE(notification_count == 1);
+
+    SECTION("moderate pressure keeps the latest cached schema") {
+        coordinator->on_memory_pressure(_impl::RealmCoordinator::MemoryPressure::Moderate);
+        REQUIRE(coordinator->memory_stats().cached_schemas == 1);
+    }
+
+    SECTION("critical pressure clears the schema cache") {
+        coordinator->on_memory_pressure(_impl::RealmCoordinator::MemoryPressure::Critical);
+        REQUIRE(coordinator->memory_stats().cached_schemas == 0);
+    }
+
+    SECTION("notifiers still report changes after critical pressure") {
+        realm->begin_transaction();
+        table->add_empty_row();
+        realm->commit_transaction();
+        coordinator->on_change();
+
+        coordinator->on_memory_pressure(_impl::RealmCoordinator::MemoryPressure::Critical);
+        REQUIRE(coordinator->memory_stats().notifiers[0].handover_bytes == 0);
+        realm->notify();
+        REQUIRE(notification_count == 2);
+        REQUIRE_INDICES(change.insertions, 100);
+        REQUIRE(results.size() == 101);
+
+        realm->begin_transaction();
+        table->set_int(0, 5, 1);
+        realm->commit_transaction();
+        coordinator->on_change();
+        realm->notify();
+        REQUIRE(notification_count == 3);
+        REQUIRE_INDICES(change.modifications, 5);
+    }
+
+    SECTION("new notifiers can be added after releasing idle data") {
+        token = {};
+        coordinator->on_change();
+        coordinator->on_memory_pressure(_impl::RealmCoordinator::MemoryPressure::Moderate);
+
+        size_t new_count = 0;
+        auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+            ++new_count;
+        });
+        coordinator->on_change();
+        realm->notify();
+        REQUIRE(new_count == 1);
+
+        realm->begin_transaction();
+        table->add_empty_row();
+        realm->commit_transaction();
+        coordinator->on_change();
+        realm->notify();
+        REQUIRE(new_count == 2);
+    }
+}
+
+TEST_CASE("RealmCoordinator: schema cache") {
+    TestFile config;
+    auto coordinator = _impl::RealmCoordinator::get_coordinator(config.path);
+
+    Schema cache_schema;
+    uint64_t cache_sv = -1, cache_tv = -1;
+
+    Schema schema{
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    };
+    Schema schema2{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"object 2", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    SECTION("valid initial schema sets cache") {
+        coordinator->cache_schema(schema, 5, 10);
+        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
+        REQUIRE(cache_schema == schema);
+        REQUIRE(cache_sv == 5);
+        REQUIRE(cache_tv == 10);
+    }
+
+    SECTION("cache can be updated with newer schema") {
+        coordinator->cache_schema(schema, 5, 10);
+        coordinator->cache_schema(schema2, 6, 11);
+        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
         REQUIRE(cache_schema == schema2);
         REQUIRE(cache_sv == 6);
         REQUIRE(cache_tv == 11);
@@ -997,6 +2007,52 @@ TEST_CASE("RealmCoordinator: schema cache") {
         coordinator->advance_schema_cache(3, 15);
         REQUIRE_FALSE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
     }
+
+    SECTION("older schemas can be looked up by transaction version") {
+        std::shared_ptr<const Schema> found;
+        coordinator->cache_schema(schema, 5, 10);
+        coordinator->advance_schema_cache(10, 12);
+        coordinator->cache_schema(schema2, 6, 13);
+
+        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
+        REQUIRE(cache_schema == schema2);
+        REQUIRE(cache_tv == 13);
+
+        REQUIRE(coordinator->get_cached_schema(11, found, cache_sv));
+        REQUIRE(*found == schema);
+        REQUIRE(cache_sv == 5);
+        REQUIRE(coordinator->get_cached_schema(13, found, cache_sv));
+        REQUIRE(*found == schema2);
+        REQUIRE(cache_sv == 6);
+        REQUIRE_FALSE(coordinator->get_cached_schema(9, found, cache_sv));
+        REQUIRE_FALSE(coordinator->get_cached_schema(14, found, cache_sv));
+    }
+
+    SECTION("schema for an older transaction fills in the gap before the latest") {
+        std::shared_ptr<const Schema> found;
+        coordinator->cache_schema(schema2, 6, 20);
+        coordinator->cache_schema(schema, 5, 10);
+
+        REQUIRE(coordinator->get_cached_schema(cache_schema, cache_sv, cache_tv));
+        REQUIRE(cache_schema == schema2);
+        REQUIRE(coordinator->get_schema_version() == 6);
+        REQUIRE(coordinator->get_cached_schema(10, found, cache_sv));
+        REQUIRE(*found == schema);
+    }
+
+    SECTION("least recently used schema is discarded when the cache is full") {
+        std::shared_ptr<const Schema> found;
+        const uint64_t count = _impl::RealmCoordinator::MaxCachedSchemas;
+        for (uint64_t i = 0; i < count; ++i)
+            coordinator->cache_schema(i % 2 ? schema2 : schema, i + 1, (i + 1) * 10);
+        REQUIRE(coordinator->get_cached_schema(10, found, cache_sv));
+
+        coordinator->cache_schema(schema, count + 1, (count + 1) * 10);
+        REQUIRE(coordinator->get_cached_schema(10, found, cache_sv));
+        REQUIRE_FALSE(coordinator->get_cached_schema(20, found, cache_sv));
+        for (uint64_t i = 3; i <= count + 1; ++i)
+            REQUIRE(coordinator->get_cached_schema(i * 10, found, cache_sv));
+    }
 }
 
 TEST_CASE("SharedRealm: coordinator schema cache") {
@@ -1228,6 +2284,303 @@ TEST_CASE("SharedRealm: coordinator schema cache") {
     }
 }
 
+TEST_CASE("SharedRealm: persisted schema hash") {
+    TestFile config;
+    config.cache = false;
+    config.schema_version = 1;
+    config.schema = Schema{
+        {"object", {
+            {"pk", PropertyType::Int, Property::IsPrimary{true}},
+            {"value", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+        }},
+        {"target", {
+            {"value", PropertyType::Int},
+        }, {
+            {"origins", PropertyType::LinkingObjects|PropertyType::Array, "object", "link"},
+        }},
+    };
+    auto hash = ObjectStore::schema_hash(*config.schema);
+
+    SECTION("is recorded when the schema is created") {
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE(ObjectStore::schema_hash_matches(realm->read_group(), hash));
+    }
+
+    SECTION("lets a reopened Realm use the config's schema") {
+        Realm::get_shared_realm(config);
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE(realm->schema() == *config.schema);
+
+        auto table = ObjectStore::table_for_object_type(realm->read_group(), "object");
+        auto& object_schema = *realm->schema().find("object");
+        for (auto& prop : object_schema.persisted_properties)
+            REQUIRE(prop.table_column == table->get_column_index(prop.name));
+    }
+
+    SECTION("is updated by later schema changes") {
+        Realm::get_shared_realm(config);
+        auto config2 = config;
+        config2.schema_version = 2;
+        config2.schema = Schema{
+            {"object", {
+                {"pk", PropertyType::Int, Property::IsPrimary{true}},
+                {"value", PropertyType::Int},
+                {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+            }},
+            {"target", {
+                {"value", PropertyType::Int},
+                {"value 2", PropertyType::String},
+            }},
+        };
+        auto realm = Realm::get_shared_realm(config2);
+        REQUIRE_FALSE(ObjectStore::schema_hash_matches(realm->read_group(), hash));
+        REQUIRE(ObjectStore::schema_hash_matches(realm->read_group(), ObjectStore::schema_hash(*config2.schema)));
+    }
+
+    SECTION("is not recorded when the file has types which aren't in the schema") {
+        auto config2 = config;
+        config2.schema = Schema{
+            {"other", {
+                {"value", PropertyType::Int},
+            }},
+        };
+        Realm::get_shared_realm(config2);
+
+        config.schema_mode = SchemaMode::Additive;
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE_FALSE(ObjectStore::schema_hash_matches(realm->read_group(), hash));
+    }
+
+    SECTION("stops matching when columns are changed without updating it") {
+        {
+            auto realm = Realm::get_shared_realm(config);
+            realm->begin_transaction();
+            auto table = ObjectStore::table_for_object_type(realm->read_group(), "target");
+            table->rename_column(table->get_column_index("value"), "renamed");
+            realm->commit_transaction();
+            REQUIRE_FALSE(ObjectStore::schema_hash_matches(realm->read_group(), hash));
+        }
+
+        // Falls back to reading the schema, and so notices the missing property
+        REQUIRE_THROWS_AS(Realm::get_shared_realm(config), SchemaMismatchException);
+    }
+}
+
+TEST_CASE("SharedRealm: open trace") {
+    TestFile config;
+    config.schema_version = 1;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    };
+    std::vector<Realm::OpenPhase> phases;
+    config.open_trace = [&](Realm::OpenPhase phase, std::chrono::nanoseconds duration) {
+        REQUIRE(duration.count() >= 0);
+        phases.push_back(phase);
+    };
+    auto reported = [&](Realm::OpenPhase phase) {
+        return std::count(phases.begin(), phases.end(), phase);
+    };
+
+    SECTION("reports each phase of creating a file") {
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE(phases.front() == Realm::OpenPhase::CoordinatorLookup);
+        REQUIRE(reported(Realm::OpenPhase::FileOpen) == 1);
+        REQUIRE(reported(Realm::OpenPhase::SchemaRead) == 1);
+        REQUIRE(reported(Realm::OpenPhase::SchemaCompare) == 1);
+        REQUIRE(reported(Realm::OpenPhase::Migration) == 1);
+        REQUIRE(reported(Realm::OpenPhase::NotifierSetup) == 1);
+        REQUIRE(reported(Realm::OpenPhase::SyncSessionCreation) == 0);
+    }
+
+    SECTION("does not report a migration when the schema is unchanged") {
+        config.cache = false;
+        Realm::get_shared_realm(config);
+        phases.clear();
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE(reported(Realm::OpenPhase::SchemaCompare) == 1);
+        REQUIRE(reported(Realm::OpenPhase::Migration) == 0);
+    }
+
+    SECTION("reports opening the old Realm for a migration separately") {
+        config.cache = false;
+        Realm::get_shared_realm(config);
+        phases.clear();
+
+        config.schema_version = 2;
+        bool migration_called = false;
+        config.migration_function = [&](SharedRealm, SharedRealm, Schema&) {
+            migration_called = true;
+        };
+        auto realm = Realm::get_shared_realm(config);
+        REQUIRE(migration_called);
+        REQUIRE(reported(Realm::OpenPhase::MigrationOldRealmOpen) == 1);
+        REQUIRE(reported(Realm::OpenPhase::Migration) == 1);
+        REQUIRE(reported(Realm::OpenPhase::FileOpen) == 1);
+        REQUIRE(reported(Realm::OpenPhase::SchemaRead) == 1);
+        auto old_realm_open = std::find(phases.begin(), phases.end(), Realm::OpenPhase::MigrationOldRealmOpen);
+        auto migration = std::find(phases.begin(), phases.end(), Realm::OpenPhase::Migration);
+        REQUIRE(old_realm_open < migration);
+    }
+
+    SECTION("only reports the coordinator lookup for cached Realms") {
+        auto realm = Realm::get_shared_realm(config);
+        phases.clear();
+        auto realm2 = Realm::get_shared_realm(config);
+        REQUIRE(phases == std::vector<Realm::OpenPhase>{Realm::OpenPhase::CoordinatorLookup});
+    }
+}
+
+TEST_CASE("SharedRealm: notification trace") {
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    // Spans are reported on the notifier thread too
+    std::mutex mutex;
+    std::vector<NotificationSpan> spans;
+    config.notification_trace = [&](NotificationSpan const& span) {
+        std::lock_guard<std::mutex> lock(mutex);
+        spans.push_back(span);
+    };
+    auto reported = [&](NotificationSpan::Phase phase) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::count_if(spans.begin(), spans.end(), [&](auto& span) { return span.phase == phase; });
+    };
+
+    auto r = Realm::get_shared_realm(config);
+    auto table = r->read_group().get_table("class_object");
+    Results results(r, *table);
+    int calls = 0;
+    auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+        ++calls;
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+
+    SECTION("reports each step from a commit to the callbacks") {
+        spans.clear();
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+
+        REQUIRE(reported(NotificationSpan::Phase::Commit) == 1);
+        REQUIRE(reported(NotificationSpan::Phase::OnChange) == 1);
+        REQUIRE(reported(NotificationSpan::Phase::RunNotifiers) == 1);
+        REQUIRE(reported(NotificationSpan::Phase::NotifierRun) >= 1);
+        REQUIRE(reported(NotificationSpan::Phase::PrepareHandover) >= 1);
+        REQUIRE(reported(NotificationSpan::Phase::SignalRealms) >= 1);
+        REQUIRE(reported(NotificationSpan::Phase::DeliverNotifications) >= 1);
+        REQUIRE(reported(NotificationSpan::Phase::Callbacks) == 1);
+
+        auto find = [&](NotificationSpan::Phase phase) {
+            return *std::find_if(spans.begin(), spans.end(), [&](auto& span) { return span.phase == phase; });
+        };
+        auto commit = find(NotificationSpan::Phase::Commit);
+        auto run = find(NotificationSpan::Phase::NotifierRun);
+        auto callbacks = find(NotificationSpan::Phase::Callbacks);
+        REQUIRE(commit.version == r->read_transaction_version().version);
+        REQUIRE(callbacks.version == commit.version);
+        REQUIRE(run.notifier_type == std::string("ResultsNotifier"));
+        REQUIRE(run.notifier == callbacks.notifier);
+        REQUIRE(commit.notifier_type == nullptr);
+        REQUIRE(commit.start <= run.start);
+        REQUIRE(run.start <= callbacks.start);
+    }
+
+    SECTION("ChromeTraceRecorder writes an event for each span") {
+        ChromeTraceRecorder recorder;
+        for (auto& span : spans)
+            recorder.record(span);
+        spans.clear();
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        for (auto& span : spans)
+            recorder.record(span);
+
+        auto json = recorder.to_json();
+        REQUIRE(recorder.size() > spans.size());
+        REQUIRE(json.find("\"traceEvents\":[") != std::string::npos);
+        REQUIRE(json.find("\"name\":\"Commit\"") != std::string::npos);
+        REQUIRE(json.find("\"notifier_type\":\"ResultsNotifier\"") != std::string::npos);
+        // The spans for the commit's version are linked by a flow
+        REQUIRE(json.find("\"ph\":\"s\"") != std::string::npos);
+        REQUIRE(json.find("\"ph\":\"f\"") != std::string::npos);
+
+        recorder.clear();
+        REQUIRE(recorder.size() == 0);
+        REQUIRE(recorder.to_json() == "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}");
+    }
+}
+
+TEST_CASE("SharedRealm: schema instances") {
+    TestFile config;
+    config.cache = false;
+    config.schema_version = 1;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"object 2", {
+            {"value", PropertyType::Int},
+        }},
+    };
+    auto r1 = Realm::get_shared_realm(config);
+
+    SECTION("Realms opened without a schema get the cached schema") {
+        config.schema = util::none;
+        auto r2 = Realm::get_shared_realm(config);
+        REQUIRE(r2->schema() == r1->schema());
+    }
+
+    SECTION("set_schema_subset() does not modify other Realms' schemas") {
+        config.schema = util::none;
+        auto r2 = Realm::get_shared_realm(config);
+        auto r3 = Realm::get_shared_realm(config);
+        r2->set_schema_subset(Schema{{"object", {{"value", PropertyType::Int}}}});
+        REQUIRE(r2->schema().size() == 1);
+        REQUIRE(r3->schema().size() == 2);
+        REQUIRE(r1->schema().size() == 2);
+    }
+
+    SECTION("column changes made by another Realm update each Realm's own schema in place") {
+        auto r2 = Realm::get_shared_realm(config);
+        REQUIRE(&r1->schema() != &r2->schema());
+        auto& object_schema = *r1->schema().find("object");
+
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->insert_column(0, type_String, "new col");
+        r2->commit_transaction();
+        REQUIRE(r2->schema().find("object")->persisted_properties[0].table_column == 1);
+        REQUIRE(object_schema.persisted_properties[0].table_column == 0);
+
+        r1->refresh();
+        REQUIRE(&object_schema == &*r1->schema().find("object"));
+        REQUIRE(object_schema.persisted_properties[0].table_column == 1);
+    }
+
+    SECTION("Realms with different schemas keep them") {
+        config.schema = Schema{
+            {"object", {
+                {"value", PropertyType::Int},
+            }},
+        };
+        auto r2 = Realm::get_shared_realm(config);
+        REQUIRE(r2->schema().size() == 1);
+        REQUIRE(r1->schema().size() == 2);
+    }
+}
+
 TEST_CASE("SharedRealm: dynamic schema mode doesn't invalidate object schema pointers when schema hasn't changed") {
     TestFile config;
     config.cache = false;
@@ -1421,6 +2774,35 @@ TEST_CASE("SharedRealm: compact on launch") {
         r->close();
     }
 
+    SECTION("compact_if_needed() reclaims space from an open Realm") {
+        r = Realm::get_shared_realm(config);
+        REQUIRE(num_opens == 2);
+        size_t size_before = size_t(File(config.path).get_size());
+
+        REQUIRE_FALSE(r->compact_if_needed([](uint64_t, uint64_t) { return false; }));
+        REQUIRE(size_t(File(config.path).get_size()) == size_before);
+
+        auto reclaimed = r->compact_if_needed([](uint64_t total_bytes, uint64_t used_bytes) {
+            return total_bytes > used_bytes;
+        });
+        REQUIRE(reclaimed);
+        REQUIRE(*reclaimed > 0);
+        REQUIRE(size_t(File(config.path).get_size()) < size_before);
+        REQUIRE(r->read_group().get_table("class_object")->size() == count);
+        r->close();
+    }
+
+    SECTION("compact_if_needed() does not compact if the Realm is open elsewhere") {
+        r = Realm::get_shared_realm(config);
+        REQUIRE(num_opens == 2);
+        auto config2 = config;
+        config2.should_compact_on_launch_function = nullptr;
+        auto r2 = Realm::get_shared_realm(config2);
+        REQUIRE_FALSE(r->compact_if_needed([](uint64_t, uint64_t) { return true; }));
+        r->close();
+        r2->close();
+    }
+
     SECTION("compact function does not get invoked if realm is open on another thread") {
         // Confirm expected sizes before and after opening the Realm
         size_t size_before = size_t(File(config.path).get_size());
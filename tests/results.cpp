@@ -25,18 +25,23 @@
 
 #include "impl/object_accessor_impl.hpp"
 #include "impl/realm_coordinator.hpp"
+#include "binding_callback_thread_observer.hpp"
 #include "binding_context.hpp"
 #include "object_schema.hpp"
 #include "property.hpp"
 #include "results.hpp"
+#include "results_window.hpp"
 #include "schema.hpp"
+#include "util/thread_pool.hpp"
 
 #include <realm/group_shared.hpp>
 #include <realm/link_view.hpp>
 #include <realm/query_engine.hpp>
 #include <realm/query_expression.hpp>
+#include <realm/util/scope_exit.hpp>
 
 #if REALM_ENABLE_SYNC
+#include "predicate_cache.hpp"
 #include "sync/sync_manager.hpp"
 #include "sync/sync_session.hpp"
 #endif
@@ -295,6 +300,66 @@ TEST_CASE("notifications: async delivery") {
         REQUIRE(notification_calls == 1);
     }
 
+    SECTION("paused callbacks are not called until they are resumed") {
+        token.pause();
+        make_remote_change();
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 1);
+        REQUIRE(results.size() == 5);
+
+        make_local_change();
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 1);
+
+        token.resume();
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 2);
+
+        make_remote_change();
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 3);
+    }
+
+    SECTION("resumed callbacks are called with no changes and then see later changes") {
+        CollectionChangeSet change;
+        int calls = 0;
+        auto token2 = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            change = c;
+            ++calls;
+        });
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+
+        token2.pause();
+        r->begin_transaction();
+        table->set_int(0, 5, 3);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+        REQUIRE(notification_calls == 2);
+
+        token2.resume();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE(change.empty());
+        REQUIRE(notification_calls == 2);
+
+        r->begin_transaction();
+        table->set_int(0, 6, 1);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 3);
+        REQUIRE_INDICES(change.insertions, 5);
+        REQUIRE(notification_calls == 3);
+    }
+
+    SECTION("pausing and resuming a callback without any changes calls it with no changes") {
+        token.pause();
+        token.resume();
+        advance_and_notify(*r);
+        REQUIRE(notification_calls == 2);
+    }
+
     SECTION("notifications are delivered on the next cycle when a new callback is added from within a callback") {
         NotificationToken token2, token3;
         bool called = false;
@@ -745,12 +810,13 @@ TEST_CASE("notifications: async delivery") {
     }
 }
 
-TEST_CASE("notifications: skip") {
+TEST_CASE("notifications: multiple notifier threads") {
     _impl::RealmCoordinator::assert_no_open_realms();
 
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
+    config.notifier_thread_count = 3;
 
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
@@ -765,470 +831,407 @@ TEST_CASE("notifications: skip") {
     r->begin_transaction();
     table->add_empty_row(10);
     for (int i = 0; i < 10; ++i)
-        table->set_int(0, i, i * 2);
+        table->set_int(0, i, i);
     r->commit_transaction();
 
-    Results results(r, table->where());
-
-    auto add_callback = [](Results& results, int& calls, CollectionChangeSet& changes) {
-        return results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+    const int notifier_count = 8;
+    std::vector<Results> results;
+    std::vector<NotificationToken> tokens;
+    std::vector<CollectionChangeSet> changes(notifier_count);
+    std::vector<int> calls(notifier_count);
+    results.reserve(notifier_count);
+    for (int i = 0; i < notifier_count; ++i) {
+        results.push_back(Results(r, table->where().greater_equal(0, i)));
+        tokens.push_back(results.back().add_notification_callback([&, i](CollectionChangeSet c, std::exception_ptr err) {
             REQUIRE_FALSE(err);
-            ++calls;
-            changes = std::move(c);
-        });
-    };
+            ++calls[i];
+            changes[i] = std::move(c);
+        }));
+    }
 
-    auto make_local_change = [&](auto& token) {
+    advance_and_notify(*r);
+    for (int i = 0; i < notifier_count; ++i) {
+        REQUIRE(calls[i] == 1);
+        REQUIRE(results[i].size() == size_t(10 - i));
+    }
+
+    SECTION("each notifier reports its own changes") {
         r->begin_transaction();
-        table->add_empty_row();
-        token.suppress_next();
+        table->set_int(0, 9, 0);
         r->commit_transaction();
-    };
-
-    auto make_remote_change = [&] {
-        auto r2 = coordinator->get_realm();
-        r2->begin_transaction();
-        r2->read_group().get_table("class_object")->add_empty_row();
-        r2->commit_transaction();
-    };
-
-    int calls1 = 0;
-    CollectionChangeSet changes1;
-    auto token1 = add_callback(results, calls1, changes1);
-
-    SECTION("no notification is sent when only callback is skipped") {
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-
-        make_local_change(token1);
         advance_and_notify(*r);
 
-        REQUIRE(calls1 == 1);
-        REQUIRE(changes1.empty());
+        REQUIRE(calls[0] == 2);
+        REQUIRE_INDICES(changes[0].modifications, 9);
+        for (int i = 1; i < notifier_count; ++i) {
+            REQUIRE(calls[i] == 2);
+            REQUIRE_INDICES(changes[i].deletions, 9 - i);
+            REQUIRE(results[i].size() == size_t(9 - i));
+        }
     }
 
-    SECTION("unskipped tokens for the same Results are still delivered") {
-        int calls2 = 0;
-        CollectionChangeSet changes2;
-        auto token2 = add_callback(results, calls2, changes2);
-
+    SECTION("notifiers added later are delivered alongside existing ones") {
+        Results later(r, table->where().less(0, 5));
+        int later_calls = 0;
+        CollectionChangeSet later_changes;
+        auto token = later.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++later_calls;
+            later_changes = std::move(c);
+        });
         advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-        REQUIRE(calls2 == 1);
+        REQUIRE(later_calls == 1);
 
-        make_local_change(token1);
+        r->begin_transaction();
+        table->set_int(0, table->add_empty_row(), 1);
+        r->commit_transaction();
         advance_and_notify(*r);
 
-        REQUIRE(calls1 == 1);
-        REQUIRE(changes1.empty());
-        REQUIRE(calls2 == 2);
-        REQUIRE_INDICES(changes2.insertions, 10);
+        REQUIRE(later_calls == 2);
+        REQUIRE_INDICES(later_changes.insertions, 5);
+        REQUIRE(calls[0] == 2);
+        REQUIRE_INDICES(changes[0].insertions, 10);
+        REQUIRE(calls[1] == 2);
+        REQUIRE_INDICES(changes[1].insertions, 9);
+        REQUIRE(calls[2] == 1);
     }
+}
 
-    SECTION("unskipped tokens for different Results are still delivered") {
-        Results results2(r, table->where());
-        int calls2 = 0;
-        CollectionChangeSet changes2;
-        auto token2 = add_callback(results2, calls2, changes2);
+TEST_CASE("notifications: notifier priority") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-        REQUIRE(calls2 == 1);
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-        make_local_change(token1);
-        advance_and_notify(*r);
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
 
-        REQUIRE(calls1 == 1);
-        REQUIRE(changes1.empty());
-        REQUIRE(calls2 == 2);
-        REQUIRE_INDICES(changes2.insertions, 10);
-    }
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
 
-    SECTION("additional commits which occur before calculation are merged in") {
-        int calls2 = 0;
-        CollectionChangeSet changes2;
-        auto token2 = add_callback(results, calls2, changes2);
+    Results interactive(r, table->where().greater(0, 5));
+    Results background(r, table->where().less(0, 5));
+    CollectionChangeSet interactive_change, background_change;
+    int interactive_calls = 0, background_calls = 0;
+    auto token1 = interactive.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        interactive_change = std::move(c);
+        ++interactive_calls;
+    });
+    auto token2 = background.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        background_change = std::move(c);
+        ++background_calls;
+    }, NotificationPriority::Background);
 
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-        REQUIRE(calls2 == 1);
+    advance_and_notify(*r);
+    REQUIRE(interactive_calls == 1);
+    REQUIRE(background_calls == 1);
+    REQUIRE(interactive.size() == 4);
+    REQUIRE(background.size() == 5);
 
-        make_local_change(token1);
-        make_remote_change();
+    SECTION("background notifiers deliver their changes") {
+        r->begin_transaction();
+        table->set_int(0, 1, 20);
+        r->commit_transaction();
         advance_and_notify(*r);
 
-        REQUIRE(calls1 == 2);
-        REQUIRE_INDICES(changes1.insertions, 11);
-        REQUIRE(calls2 == 2);
-        REQUIRE_INDICES(changes2.insertions, 10, 11);
+        REQUIRE(interactive_calls == 2);
+        REQUIRE_INDICES(interactive_change.insertions, 0);
+        REQUIRE(background_calls == 2);
+        REQUIRE_INDICES(background_change.deletions, 1);
     }
 
-    SECTION("additional commits which occur before delivery are merged in") {
-        int calls2 = 0;
-        CollectionChangeSet changes2;
-        auto token2 = add_callback(results, calls2, changes2);
-
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-        REQUIRE(calls2 == 1);
-
-        make_local_change(token1);
-        coordinator->on_change();
-        make_remote_change();
+    SECTION("background notifiers report modifications") {
+        // Modifications are only known from the change info, which the
+        // background notifier reads after the interactive ones are handed over
+        r->begin_transaction();
+        table->set_int(0, 2, 3);
+        r->commit_transaction();
         advance_and_notify(*r);
 
-        REQUIRE(calls1 == 2);
-        REQUIRE_INDICES(changes1.insertions, 11);
-        REQUIRE(calls2 == 2);
-        REQUIRE_INDICES(changes2.insertions, 10, 11);
-    }
-
-    SECTION("skipping must be done from within a write transaction") {
-        REQUIRE_THROWS(token1.suppress_next());
+        REQUIRE(interactive_calls == 1);
+        REQUIRE(background_calls == 2);
+        REQUIRE_INDICES(background_change.modifications, 2);
+        REQUIRE(background_change.insertions.empty());
+        REQUIRE(background_change.deletions.empty());
     }
 
-    SECTION("skipping must be done from the Realm's thread") {
-        advance_and_notify(*r);
+    SECTION("background notifiers are delivered at the same version as the interactive ones") {
         r->begin_transaction();
-        std::thread([&] {
-            REQUIRE_THROWS(token1.suppress_next());
-        }).join();
-        r->cancel_transaction();
-    }
-
-    SECTION("new notifiers do not interfere with skipping") {
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-
-        CollectionChangeSet changes;
-
-        // new notifier at a version before the skipped one
-        auto r2 = coordinator->get_realm();
-        Results results2(r2, r2->read_group().get_table("class_object")->where());
-        int calls2 = 0;
-        auto token2 = add_callback(results2, calls2, changes);
-
-        make_local_change(token1);
-
-        // new notifier at the skipped version
-        auto r3 = coordinator->get_realm();
-        Results results3(r3, r3->read_group().get_table("class_object")->where());
-        int calls3 = 0;
-        auto token3 = add_callback(results3, calls3, changes);
-
-        make_remote_change();
-
-        // new notifier at version after the skipped one
-        auto r4 = coordinator->get_realm();
-        Results results4(r4, r4->read_group().get_table("class_object")->where());
-        int calls4 = 0;
-        auto token4 = add_callback(results4, calls4, changes);
+        table->set_int(0, 1, 20);
+        r->commit_transaction();
 
+        auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
         coordinator->on_change();
-        r->notify();
-        r2->notify();
-        r3->notify();
-        r4->notify();
-
-        REQUIRE(calls1 == 2);
-        REQUIRE(calls2 == 1);
-        REQUIRE(calls3 == 1);
-        REQUIRE(calls4 == 1);
+        r->refresh();
+        REQUIRE(interactive_calls == 2);
+        REQUIRE(background_calls == 2);
+        REQUIRE(interactive.size() == 5);
+        REQUIRE(background.size() == 4);
     }
 
-    SECTION("skipping only effects the current transaction even if no notification would occur anyway") {
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-
-        // would not produce a notification even if it wasn't skipped because no changes were made
-        r->begin_transaction();
-        token1.suppress_next();
-        r->commit_transaction();
+    SECTION("adding an interactive callback to a background notifier makes it interactive") {
+        CollectionChangeSet change;
+        auto token3 = background.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            change = std::move(c);
+        });
         advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
 
-        // should now produce a notification
         r->begin_transaction();
-        table->add_empty_row();
+        table->set_int(0, 0, 20);
         r->commit_transaction();
         advance_and_notify(*r);
-        REQUIRE(calls1 == 2);
-    }
-
-    SECTION("removing skipped notifier before it gets the chance to run") {
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 1);
-
-        // Set the skip version
-        make_local_change(token1);
-        // Advance the file to a version after the skip version
-        make_remote_change();
-        REQUIRE(calls1 == 1);
-
-        // Remove the skipped notifier and add an entirely new notifier, so that
-        // notifications need to run but the skip logic shouldn't be used
-        token1 = {};
-        results = {};
-        Results results2(r, table->where());
-        auto token2 = add_callback(results2, calls1, changes1);
-
-        advance_and_notify(*r);
-        REQUIRE(calls1 == 2);
+        REQUIRE(background_calls == 2);
+        REQUIRE_INDICES(change.deletions, 0);
     }
 }
 
-#if REALM_PLATFORM_APPLE
-TEST_CASE("notifications: async error handling") {
+TEST_CASE("notifications: delivery budget") {
     _impl::RealmCoordinator::assert_no_open_realms();
 
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
+    config.notification_delivery_budget = std::chrono::milliseconds(1);
 
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
-            {"value", PropertyType::Int},
+            {"value", PropertyType::Int}
         }},
     });
 
-    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
-    Results results(r, *r->read_group().get_table("class_object"));
-
-    auto r2 = Realm::get_shared_realm(config);
-
-    class OpenFileLimiter {
-    public:
-        OpenFileLimiter()
-        {
-            // Set the max open files to zero so that opening new files will fail
-            getrlimit(RLIMIT_NOFILE, &m_old);
-            rlimit rl = m_old;
-            rl.rlim_cur = 0;
-            setrlimit(RLIMIT_NOFILE, &rl);
-        }
-
-        ~OpenFileLimiter()
-        {
-            setrlimit(RLIMIT_NOFILE, &m_old);
-        }
-
-    private:
-        rlimit m_old;
-    };
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    r->commit_transaction();
 
-    SECTION("error when opening the advancer SG") {
-        OpenFileLimiter limiter;
+    Results results1(r, table->where().less(0, 5));
+    Results results2(r, table->where().greater(0, 5));
+    int calls1 = 0, calls2 = 0;
+    size_t size1 = 0, size2 = 0;
+    auto token1 = results1.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+        ++calls1;
+        size1 = results1.size();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
+    auto token2 = results2.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+        ++calls2;
+        size2 = results2.size();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
 
-        bool called = false;
-        auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-            REQUIRE(err);
-            REQUIRE_FALSE(called);
-            called = true;
-        });
-        REQUIRE(!called);
+    // Each callback exceeds the budget, so only one of them is called per wakeup
+    advance_and_notify(*r);
+    REQUIRE(calls1 + calls2 == 1);
+    r->notify();
+    REQUIRE(calls1 == 1);
+    REQUIRE(calls2 == 1);
 
-        SECTION("error is delivered on notify() without changes") {
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->notify();
-            REQUIRE(called);
-        }
+    SECTION("the Realm is not advanced until the deferred callbacks are called") {
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls1 + calls2 == 3);
+        auto version = r->read_transaction_version();
 
-        SECTION("error is delivered on notify() with changes") {
-            r2->begin_transaction(); r2->commit_transaction();
-            REQUIRE(!called);
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->notify();
-            REQUIRE(called);
-        }
+        auto r2 = Realm::get_shared_realm(config);
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->set_int(0, 1, 10);
+        r2->commit_transaction();
+        _impl::RealmCoordinator::get_existing_coordinator(config.path)->on_change();
 
-        SECTION("error is delivered on refresh() without changes") {
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->refresh();
-            REQUIRE(called);
-        }
+        r->notify();
+        REQUIRE(calls1 == 2);
+        REQUIRE(calls2 == 2);
+        REQUIRE(r->read_transaction_version() == version);
+        REQUIRE(size1 == 9);
+        REQUIRE(size2 == 1);
 
-        SECTION("error is delivered on refresh() with changes") {
-            r2->begin_transaction(); r2->commit_transaction();
-            REQUIRE(!called);
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->refresh();
-            REQUIRE(called);
-        }
+        r->notify();
+        REQUIRE(calls1 + calls2 == 5);
+        REQUIRE(r->read_transaction_version() != version);
+    }
 
-        SECTION("error is delivered on begin_transaction() without changes") {
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->begin_transaction();
-            REQUIRE(called);
-            r->cancel_transaction();
-        }
+    SECTION("refresh() calls all of the deferred callbacks") {
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls1 + calls2 == 3);
+        r->refresh();
+        REQUIRE(calls1 == 2);
+        REQUIRE(calls2 == 2);
+    }
+}
 
-        SECTION("error is delivered on begin_transaction() with changes") {
-            r2->begin_transaction(); r2->commit_transaction();
-            REQUIRE(!called);
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->begin_transaction();
-            REQUIRE(called);
-            r->cancel_transaction();
-        }
+TEST_CASE("notifications: notifier wait limit") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-        SECTION("adding another callback sends the error to only the newly added one") {
-            advance_and_notify(*r);
-            REQUIRE(called);
+    InMemoryTestFile config;
+    config.cache = false;
+    // With no background worker nothing runs the notifiers while the Realm
+    // is waiting for them, so only the limit lets it stop waiting
+    config.automatic_change_notifications = false;
+    config.notifier_wait_limit = std::chrono::milliseconds(10);
 
-            bool called2 = false;
-            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                REQUIRE(err);
-                REQUIRE_FALSE(called2);
-                called2 = true;
-            });
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+    auto table = r->read_group().get_table("class_object");
 
-            advance_and_notify(*r);
-            REQUIRE(called2);
-        }
+    Results results(r, table->where());
+    int calls = 0;
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        change = c;
+        ++calls;
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-        SECTION("destroying a token from before the error does not remove newly added callbacks") {
-            advance_and_notify(*r);
+    auto r2 = Realm::get_shared_realm(config);
+    auto write = [&] {
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->add_empty_row();
+        r2->commit_transaction();
+    };
 
-            bool called = false;
-            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                REQUIRE(err);
-                REQUIRE_FALSE(called);
-                called = true;
-            });
-            token = {};
+    SECTION("begin_transaction() stops waiting and the changes are delivered later") {
+        write();
+        r->begin_transaction();
+        REQUIRE(calls == 1);
+        REQUIRE(table->size() == 1);
+        r->cancel_transaction();
 
-            advance_and_notify(*r);
-            REQUIRE(called);
-        }
+        write();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.insertions, 0, 1);
+        REQUIRE(results.size() == 2);
+    }
 
-        SECTION("adding another callback from within an error callback defers delivery") {
-            NotificationToken token2;
-            token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
-                token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                    REQUIRE(err);
-                    REQUIRE_FALSE(called);
-                    called = true;
-                });
-            });
-            advance_and_notify(*r);
-            REQUIRE(!called);
-            advance_and_notify(*r);
-            REQUIRE(called);
-        }
+    SECTION("refresh() stops waiting and the changes are delivered later") {
+        write();
+        REQUIRE(r->refresh());
+        REQUIRE(calls == 1);
+        REQUIRE(table->size() == 1);
 
-        SECTION("adding a callback to a different collection from within the error callback defers delivery") {
-            auto results2 = results;
-            NotificationToken token2;
-            token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
-                token2 = results2.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                    REQUIRE(err);
-                    REQUIRE_FALSE(called);
-                    called = true;
-                });
-            });
-            advance_and_notify(*r);
-            REQUIRE(!called);
-            advance_and_notify(*r);
-            REQUIRE(called);
-        }
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(change.insertions, 0);
     }
+}
 
-    SECTION("error when opening the executor SG") {
-        SECTION("error is delivered asynchronously") {
-            bool called = false;
-            auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                REQUIRE(err);
-                called = true;
-            });
-            OpenFileLimiter limiter;
+TEST_CASE("notifications: notifier interval") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-            REQUIRE(!called);
-            coordinator->on_change();
-            REQUIRE(!called);
-            r->notify();
-            REQUIRE(called);
-        }
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.notifier_interval = std::chrono::milliseconds(50);
 
-        SECTION("adding another callback only sends the error to the new one") {
-            bool called = false;
-            auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                REQUIRE(err);
-                REQUIRE_FALSE(called);
-                called = true;
-            });
-            OpenFileLimiter limiter;
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
 
-            advance_and_notify(*r);
+    auto table = r->read_group().get_table("class_object");
 
-            bool called2 = false;
-            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-                REQUIRE(err);
-                REQUIRE_FALSE(called2);
-                called2 = true;
-            });
+    Results results(r, table->where());
+    int calls = 0;
+    CollectionChangeSet change;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        change = std::move(c);
+        ++calls;
+    });
+    auto start = std::chrono::steady_clock::now();
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-            advance_and_notify(*r);
+    r->begin_transaction();
+    table->add_empty_row();
+    r->commit_transaction();
+    r->begin_transaction();
+    table->add_empty_row();
+    r->commit_transaction();
+    advance_and_notify(*r);
+    REQUIRE(std::chrono::steady_clock::now() - start >= config.notifier_interval);
 
-            REQUIRE(called2);
-        }
-    }
+    // Both commits are reported in a single notification
+    REQUIRE(calls == 2);
+    REQUIRE_INDICES(change.insertions, 0, 1);
 }
-#endif
 
-#if REALM_ENABLE_SYNC
-TEST_CASE("notifications: sync") {
+TEST_CASE("notifications: thread observer loop iterations") {
     _impl::RealmCoordinator::assert_no_open_realms();
 
-    SyncServer server(false);
-    SyncTestFile config(server);
+    struct Observer : BindingCallbackThreadObserver {
+        std::vector<LoopIterationStats> iterations;
+
+        void did_create_thread() override { }
+        void will_destroy_thread() override { }
+        void handle_error(std::exception const&) override { }
+        void did_run_loop_iteration(LoopIterationStats const& stats) override
+        {
+            iterations.push_back(stats);
+        }
+    } observer;
+    g_binding_callback_thread_observer = &observer;
+    auto reset_observer = util::make_scope_exit([&]() noexcept { g_binding_callback_thread_observer = nullptr; });
+
+    InMemoryTestFile config;
     config.cache = false;
-    config.schema = Schema{
+    config.automatic_change_notifications = false;
+    config.notifier_interval = std::chrono::milliseconds(100);
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
         {"object", {
-            {"value", PropertyType::Int},
+            {"value", PropertyType::Int}
         }},
-    };
-
-    SECTION("sync progress commits do not distrupt notifications") {
-        auto r = Realm::get_shared_realm(config);
-        auto wait_realm = Realm::get_shared_realm(config);
-
-        Results results(r, *r->read_group().get_table("class_object"));
-        Results wait_results(wait_realm, *wait_realm->read_group().get_table("class_object"));
-        auto token1 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
-        auto token2 = wait_results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
-
-        // Add an object to the Realm so that notifications are needed
-        {
-            auto write_realm = Realm::get_shared_realm(config);
-            write_realm->begin_transaction();
-            sync::create_object(write_realm->read_group(), *write_realm->read_group().get_table("class_object"));
-            write_realm->commit_transaction();
-        }
+    });
+    auto table = r->read_group().get_table("class_object");
 
-        // Wait for the notifications to become ready for the new version
-        wait_realm->refresh();
+    Results results(r, table->where());
+    Results results2(r, table->where().greater(0, 0));
+    auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+    auto token2 = results2.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { });
+    advance_and_notify(*r);
 
-        // Start the server and wait for the Realm to be uploaded so that sync
-        // makes some writes to the Realm and bumps the version
-        server.start();
-        wait_for_upload(*r);
+    r->begin_transaction();
+    table->add_empty_row();
+    r->commit_transaction();
+    advance_and_notify(*r);
 
-        // Make sure that the notifications still get delivered rather than
-        // waiting forever due to that we don't get a commit notification from
-        // the commits sync makes to store the upload progress
-        r->refresh();
+    REQUIRE(observer.iterations.size() == 2);
+    for (auto& stats : observer.iterations) {
+        REQUIRE(stats.queue_depth == 2);
+        REQUIRE(stats.longest_handler <= stats.busy_time);
+        // Sleeping for the notifier interval isn't included
+        REQUIRE(stats.busy_time < config.notifier_interval);
     }
 }
-#endif
 
-TEST_CASE("notifications: results") {
+TEST_CASE("notifications: shared notifiers") {
     _impl::RealmCoordinator::assert_no_open_realms();
 
     InMemoryTestFile config;
@@ -1238,1098 +1241,819 @@ TEST_CASE("notifications: results") {
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
-            {"value", PropertyType::Int},
-            {"link", PropertyType::Object|PropertyType::Nullable, "linked to object"}
-        }},
-        {"other object", {
             {"value", PropertyType::Int}
         }},
-        {"linking object", {
-            {"link", PropertyType::Object|PropertyType::Nullable, "object"}
-        }},
-        {"linked to object", {
-            {"value", PropertyType::Int}
-        }}
     });
 
-    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
     auto table = r->read_group().get_table("class_object");
 
     r->begin_transaction();
-    r->read_group().get_table("class_linked to object")->add_empty_row(10);
     table->add_empty_row(10);
-    for (int i = 0; i < 10; ++i) {
-        table->set_int(0, i, i * 2);
-        table->set_link(1, i, i);
-    }
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
     r->commit_transaction();
 
-    auto r2 = coordinator->get_realm();
-    auto r2_table = r2->read_group().get_table("class_object");
-
-    Results results(r, table->where().greater(0, 0).less(0, 10));
+    auto make_results = [&] {
+        return Results(r, table->where().greater(0, 4)).sort({*table, {{0}}, {false}});
+    };
 
-    SECTION("unsorted notifications") {
-        int notification_calls = 0;
-        CollectionChangeSet change;
-        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
-            REQUIRE_FALSE(err);
-            change = c;
-            ++notification_calls;
-        });
+    Results results1 = make_results();
+    Results results2 = make_results();
+    int calls1 = 0, calls2 = 0;
+    CollectionChangeSet changes1, changes2;
+    auto token1 = results1.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls1;
+        changes1 = std::move(c);
+    });
+    auto token2 = results2.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls2;
+        changes2 = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls1 == 1);
+    REQUIRE(calls2 == 1);
 
+    SECTION("changes are delivered to each of the Results") {
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
         advance_and_notify(*r);
 
-        auto write = [&](auto&& f) {
-            r->begin_transaction();
-            f();
-            r->commit_transaction();
-            advance_and_notify(*r);
-        };
+        REQUIRE(calls1 == 2);
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes1.insertions, 0);
+        REQUIRE_INDICES(changes2.insertions, 0);
+        REQUIRE(results1.size() == 6);
+        REQUIRE(results2.size() == 6);
+        REQUIRE(results1.get(0).get_int(0) == 10);
+        REQUIRE(results2.get(0).get_int(0) == 10);
+    }
 
-        SECTION("modifications to unrelated tables do not send notifications") {
-            write([&] {
-                r->read_group().get_table("class_other object")->add_empty_row();
-            });
-            REQUIRE(notification_calls == 1);
+    SECTION("destroying one Results does not stop updates to the other") {
+        {
+            Results results3 = make_results();
+            results3.size();
         }
+        results1 = Results();
 
-        SECTION("irrelevant modifications to linked tables do not send notifications") {
-            write([&] {
-                r->read_group().get_table("class_linked to object")->add_empty_row();
-            });
-            REQUIRE(notification_calls == 1);
-        }
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("irrelevant modifications to linking tables do not send notifications") {
-            write([&] {
-                r->read_group().get_table("class_linking object")->add_empty_row();
-            });
-            REQUIRE(notification_calls == 1);
-        }
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes2.insertions, 0);
+        REQUIRE(results2.size() == 6);
+    }
 
-        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
-            write([&] {
-                table->set_int(0, 6, 13);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+    SECTION("moved Results continue to be updated") {
+        Results moved = std::move(results1);
 
-        SECTION("deleting non-matching rows does not send a notification") {
-            write([&] {
-                table->move_last_over(0);
-                table->move_last_over(6);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("swapping adjacent matching and non-matching rows does not send notifications") {
-            write([&] {
-                table->swap_rows(0, 1);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+        REQUIRE(calls1 == 2);
+        REQUIRE(calls2 == 2);
+        REQUIRE(moved.size() == 6);
+        REQUIRE(results2.size() == 6);
+    }
 
-        SECTION("swapping non-adjacent matching and non-matching rows send a single insert/delete pair") {
-            write([&] {
-                table->swap_rows(0, 2);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-            REQUIRE_INDICES(change.insertions, 0);
-        }
+    SECTION("snapshotting one Results does not stop updates to the other") {
+        auto snapshot = results1.snapshot();
 
-        SECTION("swapping matching rows sends insert/delete pairs") {
-            write([&] {
-                table->swap_rows(1, 4);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 0, 3);
-            REQUIRE_INDICES(change.insertions, 0, 3);
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-            write([&] {
-                table->swap_rows(1, 2);
-                table->swap_rows(2, 3);
-                table->swap_rows(3, 4);
-            });
-            REQUIRE(notification_calls == 3);
-            REQUIRE_INDICES(change.deletions, 1, 2, 3);
-            REQUIRE_INDICES(change.insertions, 0, 1, 2);
-        }
+        REQUIRE(snapshot.size() == 5);
+        REQUIRE(calls2 == 2);
+        REQUIRE(results2.size() == 6);
+    }
 
-        SECTION("swap does not inhibit move collapsing after removals") {
-            write([&] {
-                table->swap_rows(2, 3);
-                table->set_int(0, 3, 100);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-            REQUIRE(change.insertions.empty());
-        }
+    SECTION("Results with different orderings are not shared") {
+        Results ascending = Results(r, table->where().greater(0, 4)).sort({*table, {{0}}, {true}});
+        CollectionChangeSet ascending_changes;
+        auto token3 = ascending.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            ascending_changes = std::move(c);
+        });
+        advance_and_notify(*r);
 
-        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
-            write([&] {
-                table->set_int(0, 1, 3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.modifications, 0);
-            REQUIRE_INDICES(change.modifications_new, 0);
-        }
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("modifying a matching row to no longer match marks that row as deleted") {
-            write([&] {
-                table->set_int(0, 2, 0);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-        }
+        REQUIRE_INDICES(changes1.insertions, 0);
+        REQUIRE_INDICES(ascending_changes.insertions, 5);
+        REQUIRE(ascending.get(5).get_int(0) == 10);
+    }
+}
 
-        SECTION("modifying a non-matching row to match marks that row as inserted, but not modified") {
-            write([&] {
-                table->set_int(0, 7, 3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.insertions, 4);
-            REQUIRE(change.modifications.empty());
-            REQUIRE(change.modifications_new.empty());
-        }
+TEST_CASE("notifications: reopened Results") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-        SECTION("deleting a matching row marks that row as deleted") {
-            write([&] {
-                table->move_last_over(3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 2);
-        }
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-        SECTION("moving a matching row via deletion marks that row as moved") {
-            write([&] {
-                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
-                table->move_last_over(0);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_MOVES(change, {3, 0});
-        }
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
 
-        SECTION("moving a matching row via subsumption marks that row as modified") {
-            write([&] {
-                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
-                table->move_last_over(0);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_MOVES(change, {3, 0});
-        }
+    auto table = r->read_group().get_table("class_object");
 
-        SECTION("modifications from multiple transactions are collapsed") {
-            r2->begin_transaction();
-            r2_table->set_int(0, 0, 6);
-            r2->commit_transaction();
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
 
-            coordinator->on_change();
+    auto make_results = [&] {
+        return Results(r, table->where().greater(0, 4)).sort({*table, {{0}}, {false}});
+    };
 
-            r2->begin_transaction();
-            r2_table->set_int(0, 1, 0);
-            r2->commit_transaction();
+    {
+        Results results = make_results();
+        auto token = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {});
+        advance_and_notify(*r);
+        REQUIRE(results.size() == 5);
+    }
 
-            REQUIRE(notification_calls == 1);
-            coordinator->on_change();
-            r->notify();
-            REQUIRE(notification_calls == 2);
-        }
-
-        SECTION("inserting a row then modifying it in a second transaction does not report it as modified") {
-            r2->begin_transaction();
-            size_t ndx = r2_table->add_empty_row();
-            r2_table->set_int(0, ndx, 6);
-            r2->commit_transaction();
+    Results results = make_results();
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto add_callback = [&] {
+        return results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++calls;
+            changes = std::move(c);
+        });
+    };
 
-            coordinator->on_change();
+    SECTION("start from the previous notifier's rows") {
+        REQUIRE(results.size() == 5);
+        auto token = add_callback();
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+        REQUIRE(changes.empty());
+        REQUIRE(results.size() == 5);
 
-            r2->begin_transaction();
-            r2_table->set_int(0, ndx, 7);
-            r2->commit_transaction();
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-            advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.insertions, 0);
+        REQUIRE(results.size() == 6);
+        REQUIRE(results.get(0).get_int(0) == 10);
+    }
 
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.insertions, 4);
-            REQUIRE(change.modifications.empty());
-            REQUIRE(change.modifications_new.empty());
-        }
+    SECTION("rows changed before the first run are recalculated") {
+        auto token = add_callback();
+        r->begin_transaction();
+        table->set_int(0, 9, 0);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("modification indices are pre-insert/delete") {
-            r->begin_transaction();
-            table->set_int(0, 2, 0);
-            table->set_int(0, 3, 6);
-            r->commit_transaction();
-            advance_and_notify(*r);
+        REQUIRE(calls == 1);
+        REQUIRE(changes.empty());
+        REQUIRE(results.size() == 4);
+        REQUIRE(results.get(0).get_int(0) == 8);
 
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-            REQUIRE_INDICES(change.modifications, 2);
-            REQUIRE_INDICES(change.modifications_new, 1);
-        }
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("notifications are not delivered when collapsing transactions results in no net change") {
-            r2->begin_transaction();
-            size_t ndx = r2_table->add_empty_row();
-            r2_table->set_int(0, ndx, 5);
-            r2->commit_transaction();
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.insertions, 0);
+        REQUIRE(results.size() == 5);
+    }
+}
 
-            coordinator->on_change();
+TEST_CASE("notifications: changes to columns not used by the query") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-            r2->begin_transaction();
-            r2_table->move_last_over(ndx);
-            r2->commit_transaction();
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-            REQUIRE(notification_calls == 1);
-            coordinator->on_change();
-            r->notify();
-            REQUIRE(notification_calls == 1);
-        }
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+            {"counter", PropertyType::Int},
+        }},
+    });
 
-        SECTION("inserting a non-matching row at the beginning does not produce a notification") {
-            write([&] {
-                table->insert_empty_row(1);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+    auto table = r->read_group().get_table("class_object");
 
-        SECTION("inserting a matching row at the beginning marks just it as inserted") {
-            write([&] {
-                table->insert_empty_row(0);
-                table->set_int(0, 0, 5);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.insertions, 0);
-        }
-    }
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
 
-    SECTION("before/after change callback") {
-        struct Callback {
-            size_t before_calls = 0;
-            size_t after_calls = 0;
-            CollectionChangeSet before_change;
-            CollectionChangeSet after_change;
-            std::function<void(void)> on_before = []{};
-            std::function<void(void)> on_after = []{};
+    Results results = Results(r, table->where().greater(0, 4)).sort({*table, {{0}}, {false}});
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-            void before(CollectionChangeSet c) {
-                before_change = c;
-                ++before_calls;
-                on_before();
-            }
-            void after(CollectionChangeSet c) {
-                after_change = c;
-                ++after_calls;
-                on_after();
-            }
-            void error(std::exception_ptr) {
-                FAIL("error() should not be called");
-            }
-        } callback;
-        auto token = results.add_notification_callback(&callback);
+    auto write = [&](auto&& fn) {
+        r->begin_transaction();
+        fn();
+        r->commit_transaction();
         advance_and_notify(*r);
+    };
 
-        SECTION("only after() is called for initial results") {
-            REQUIRE(callback.before_calls == 0);
-            REQUIRE(callback.after_calls == 1);
-            REQUIRE(callback.after_change.empty());
-        }
-
-        auto write = [&](auto&& func) {
-            r2->begin_transaction();
-            func(*r2_table);
-            r2->commit_transaction();
-            advance_and_notify(*r);
-        };
+    SECTION("modifying an unused column reports only modifications") {
+        write([&] {
+            table->set_int(1, 9, 1);
+            table->set_int(1, 0, 1);
+        });
+        REQUIRE(calls == 2);
+        REQUIRE(changes.insertions.empty());
+        REQUIRE(changes.deletions.empty());
+        REQUIRE_INDICES(changes.modifications, 0);
+        REQUIRE(results.size() == 5);
+        REQUIRE(results.get(0).get_int(0) == 9);
+        REQUIRE(results.get(0).get_int(1) == 1);
+    }
 
-        SECTION("both are called after a write") {
-            write([&](auto&& t) {
-                t.set_int(0, t.add_empty_row(), 5);
-            });
-            REQUIRE(callback.before_calls == 1);
-            REQUIRE(callback.after_calls == 2);
-            REQUIRE_INDICES(callback.before_change.insertions, 4);
-            REQUIRE_INDICES(callback.after_change.insertions, 4);
+    SECTION("the Results stays usable after repeated unused column changes") {
+        for (int i = 0; i < 3; ++i) {
+            write([&] { table->set_int(1, 5, i + 1); });
+            REQUIRE_INDICES(changes.modifications, 4);
+            REQUIRE(results.size() == 5);
+            REQUIRE(results.get(4).get_int(1) == i + 1);
         }
+        REQUIRE(calls == 4);
+    }
 
-        SECTION("deleted objects are usable in before()") {
-            callback.on_before = [&] {
-                REQUIRE(results.size() == 4);
-                REQUIRE_INDICES(callback.before_change.deletions, 0);
-                REQUIRE(results.get(0).is_attached());
-                REQUIRE(results.get(0).get_int(0) == 2);
-            };
-            write([&](auto&& t) {
-                t.move_last_over(results.get(0).get_index());
-            });
-            REQUIRE(callback.before_calls == 1);
-            REQUIRE(callback.after_calls == 2);
-        }
+    SECTION("modifying an unused column then a used one reruns the query") {
+        write([&] { table->set_int(1, 9, 1); });
+        write([&] { table->set_int(0, 0, 10); });
+        REQUIRE(calls == 3);
+        REQUIRE_INDICES(changes.insertions, 0);
+        REQUIRE(results.size() == 6);
+        REQUIRE(results.get(0).get_int(0) == 10);
+    }
 
-        SECTION("inserted objects are usable in after()") {
-            callback.on_after = [&] {
-                REQUIRE(results.size() == 5);
-                REQUIRE_INDICES(callback.after_change.insertions, 4);
-                REQUIRE(results.last()->get_int(0) == 5);
-            };
-            write([&](auto&& t) {
-                t.set_int(0, t.add_empty_row(), 5);
-            });
-            REQUIRE(callback.before_calls == 1);
-            REQUIRE(callback.after_calls == 2);
-        }
+    SECTION("local writes to used columns are visible before the notifier runs") {
+        write([&] { table->set_int(1, 9, 1); });
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        REQUIRE(results.size() == 6);
+        REQUIRE(results.get(0).get_int(0) == 10);
+        r->cancel_transaction();
     }
+}
 
-    SECTION("sorted notifications") {
-        // Sort in descending order
-        results = results.sort({*table, {{0}}, {false}});
+TEST_CASE("notifications: bulk load") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-        int notification_calls = 0;
-        CollectionChangeSet change;
-        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
-            REQUIRE_FALSE(err);
-            change = c;
-            ++notification_calls;
-        });
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-        advance_and_notify(*r);
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
 
-        auto write = [&](auto&& f) {
-            r->begin_transaction();
-            f();
-            r->commit_transaction();
-            advance_and_notify(*r);
-        };
+    auto table = r->read_group().get_table("class_object");
 
-        SECTION("swapping rows does not send notifications") {
-            write([&] {
-                table->swap_rows(2, 3);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+    r->begin_transaction();
+    table->add_empty_row(5);
+    r->commit_transaction();
 
-        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
-            write([&] {
-                table->set_int(0, 6, 13);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+    Results results(r, *table);
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-        SECTION("deleting non-matching rows does not send a notification") {
-            write([&] {
-                table->move_last_over(0);
-                table->move_last_over(6);
-            });
-            REQUIRE(notification_calls == 1);
-        }
+    SECTION("reports everything as replaced") {
+        r->begin_transaction(Realm::BulkLoad{true});
+        table->add_empty_row(3);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
-            write([&] {
-                table->set_int(0, 1, 3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.modifications, 3);
-            REQUIRE_INDICES(change.modifications_new, 3);
-        }
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.deletions, 0, 1, 2, 3, 4);
+        REQUIRE_INDICES(changes.insertions, 0, 1, 2, 3, 4, 5, 6, 7);
+        REQUIRE(results.size() == 8);
+    }
 
-        SECTION("swapping leaves modified rows marked as modified") {
-            write([&] {
-                table->set_int(0, 1, 3);
-                table->swap_rows(1, 2);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.modifications, 3);
-            REQUIRE_INDICES(change.modifications_new, 3);
+    SECTION("later writes report fine-grained changes again") {
+        r->begin_transaction(Realm::BulkLoad{true});
+        table->add_empty_row(3);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-            write([&] {
-                table->swap_rows(3, 1);
-                table->set_int(0, 1, 7);
-            });
-            REQUIRE(notification_calls == 3);
-            REQUIRE_INDICES(change.modifications, 1);
-            REQUIRE_INDICES(change.modifications_new, 1);
-        }
-
-        SECTION("modifying a matching row to no longer match marks that row as deleted") {
-            write([&] {
-                table->set_int(0, 2, 0);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 2);
-        }
-
-        SECTION("modifying a non-matching row to match marks that row as inserted") {
-            write([&] {
-                table->set_int(0, 7, 3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.insertions, 3);
-        }
-
-        SECTION("deleting a matching row marks that row as deleted") {
-            write([&] {
-                table->move_last_over(3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-        }
-
-        SECTION("moving a matching row via deletion does not send a notification") {
-            write([&] {
-                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
-                table->move_last_over(0);
-            });
-            REQUIRE(notification_calls == 1);
-        }
-
-        SECTION("modifying a matching row to change its position sends insert+delete") {
-            write([&] {
-                table->set_int(0, 2, 9);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 2);
-            REQUIRE_INDICES(change.insertions, 0);
-        }
-
-        SECTION("modifications from multiple transactions are collapsed") {
-            r2->begin_transaction();
-            r2_table->set_int(0, 0, 5);
-            r2->commit_transaction();
-
-            r2->begin_transaction();
-            r2_table->set_int(0, 1, 0);
-            r2->commit_transaction();
-
-            REQUIRE(notification_calls == 1);
-            advance_and_notify(*r);
-            REQUIRE(notification_calls == 2);
-        }
-
-        SECTION("moving a matching row by deleting all other rows") {
-            r->begin_transaction();
-            table->clear();
-            table->add_empty_row(2);
-            table->set_int(0, 0, 15);
-            table->set_int(0, 1, 5);
-            r->commit_transaction();
-            advance_and_notify(*r);
-
-            write([&] {
-                table->move_last_over(0);
-                table->add_empty_row();
-                table->set_int(0, 1, 3);
-            });
+        r->begin_transaction();
+        table->set_int(0, 2, 1);
+        r->commit_transaction();
+        advance_and_notify(*r);
 
-            REQUIRE(notification_calls == 3);
-            REQUIRE(change.deletions.empty());
-            REQUIRE_INDICES(change.insertions, 1);
-        }
+        REQUIRE(calls == 3);
+        REQUIRE(changes.insertions.empty());
+        REQUIRE(changes.deletions.empty());
+        REQUIRE_INDICES(changes.modifications, 2);
     }
 
-    SECTION("distinct notifications") {
-        results = results.distinct(SortDescriptor(*table, {{0}}));
-
-        int notification_calls = 0;
-        CollectionChangeSet change;
-        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
-            REQUIRE_FALSE(err);
-            change = c;
-            ++notification_calls;
-        });
+    SECTION("cancelling a bulk-load write doesn't affect the next one") {
+        r->begin_transaction(Realm::BulkLoad{true});
+        r->cancel_transaction();
 
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
         advance_and_notify(*r);
 
-        auto write = [&](auto&& f) {
-            r->begin_transaction();
-            f();
-            r->commit_transaction();
-            advance_and_notify(*r);
-        };
-
-        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
-            write([&] {
-                table->set_int(0, 6, 13);
-            });
-            REQUIRE(notification_calls == 1);
-        }
-
-        SECTION("deleting non-matching rows does not send a notification") {
-            write([&] {
-                table->move_last_over(0);
-                table->move_last_over(6);
-            });
-            REQUIRE(notification_calls == 1);
-        }
-
-        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
-            write([&] {
-                table->set_int(0, 1, 3);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.modifications, 0);
-            REQUIRE_INDICES(change.modifications_new, 0);
-        }
-
-        SECTION("modifying a non-matching row which is after the distinct results in the table to be a same value \
-                in the distinct results doesn't send notification.") {
-            write([&] {
-                table->set_int(0, 6, 2);
-            });
-            REQUIRE(notification_calls == 1);
-        }
-
-        SECTION("modifying a non-matching row which is before the distinct results in the table to be a same value \
-                in the distinct results send insert + delete.") {
-            write([&] {
-                table->set_int(0, 0, 2);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 0);
-            REQUIRE_INDICES(change.insertions, 0);
-        }
-
-        SECTION("modifying a matching row to duplicated value in distinct results marks that row as deleted") {
-            write([&] {
-                table->set_int(0, 2, 2);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.deletions, 1);
-        }
-
-        SECTION("modifying a non-matching row to match and different value marks that row as inserted") {
-            write([&] {
-                table->set_int(0, 0, 1);
-            });
-            REQUIRE(notification_calls == 2);
-            REQUIRE_INDICES(change.insertions, 0);
-        }
+        REQUIRE(changes.deletions.empty());
+        REQUIRE_INDICES(changes.insertions, 5);
     }
 
-    SECTION("schema changes") {
-        CollectionChangeSet change;
-        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
-            REQUIRE_FALSE(err);
-            change = c;
-        });
-        advance_and_notify(*r);
-
-        auto write = [&](auto&& f) {
-            r->begin_transaction();
-            f();
-            r->commit_transaction();
-            advance_and_notify(*r);
-        };
-
-        SECTION("insert table before observed table") {
-            write([&] {
-                size_t row = table->add_empty_row();
-                table->set_int(0, row, 5);
-                r->read_group().insert_table(0, "new table");
-                table->insert_empty_row(0);
-                table->set_int(0, 0, 5);
-            });
-            REQUIRE_INDICES(change.insertions, 0, 5);
-        }
-
-        auto linked_table = table->get_link_target(1);
-        SECTION("insert new column before link column") {
-            write([&] {
-                linked_table->set_int(0, 1, 5);
-                table->insert_column(0, type_Int, "new col");
-                linked_table->set_int(0, 2, 5);
-            });
-            REQUIRE_INDICES(change.modifications, 0, 1);
-        }
-
-        SECTION("insert table before link target") {
-            write([&] {
-                linked_table->set_int(0, 1, 5);
-                r->read_group().insert_table(0, "new table");
-                linked_table->set_int(0, 2, 5);
-            });
-            REQUIRE_INDICES(change.modifications, 0, 1);
-        }
+    SECTION("schema changes are rejected") {
+        r->begin_transaction(Realm::BulkLoad{true});
+        REQUIRE_THROWS_AS(r->update_schema({
+            {"object", {
+                {"value", PropertyType::Int},
+            }},
+            {"other", {
+                {"value", PropertyType::Int},
+            }},
+        }, 0, nullptr, nullptr, true), InvalidTransactionException);
+        r->cancel_transaction();
+        REQUIRE_FALSE(r->read_group().has_table("class_other"));
     }
 }
 
-TEST_CASE("results: notifications after move") {
+TEST_CASE("notifications: untracked object types") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
+    config.untracked_object_types = {"log"};
 
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
             {"value", PropertyType::Int},
+            {"entry", PropertyType::Object|PropertyType::Nullable, "log"},
+        }},
+        {"log", {
+            {"value", PropertyType::Int},
         }},
     });
 
     auto table = r->read_group().get_table("class_object");
-    auto results = std::make_unique<Results>(r, *table);
-
-    int notification_calls = 0;
-    auto token = results->add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-        REQUIRE_FALSE(err);
-        ++notification_calls;
-    });
+    auto log = r->read_group().get_table("class_log");
 
-    advance_and_notify(*r);
+    r->begin_transaction();
+    table->add_empty_row();
+    log->add_empty_row();
+    table->set_link(1, 0, 0);
+    r->commit_transaction();
 
-    auto write = [&](auto&& f) {
+    auto write = [&](auto&& fn) {
         r->begin_transaction();
-        f();
+        fn();
         r->commit_transaction();
         advance_and_notify(*r);
     };
 
-    SECTION("notifications continue to work after Results is moved (move-constructor)") {
-        Results r(std::move(*results));
-        results.reset();
+    Results results(r, *table);
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-        write([&] {
-            table->set_int(0, table->add_empty_row(), 1);
-        });
-        REQUIRE(notification_calls == 2);
+    SECTION("modifying a linked untracked object does not send a notification") {
+        write([&] { log->set_int(0, 0, 1); });
+        REQUIRE(calls == 1);
     }
 
-    SECTION("notifications continue to work after Results is moved (move-assignment)") {
-        Results r;
-        r = std::move(*results);
-        results.reset();
+    SECTION("modifying the object itself still sends a notification") {
+        write([&] { table->set_int(0, 0, 1); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 0);
+    }
 
-        write([&] {
-            table->set_int(0, table->add_empty_row(), 1);
+    SECTION("untracked objects can still be observed directly") {
+        Results log_results(r, *log);
+        CollectionChangeSet log_changes;
+        auto log_token = log_results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr) {
+            log_changes = std::move(c);
         });
-        REQUIRE(notification_calls == 2);
+        advance_and_notify(*r);
+
+        write([&] { log->set_int(0, 0, 1); });
+        REQUIRE_INDICES(log_changes.modifications, 0);
+    }
+
+    SECTION("opening the file with different untracked types throws") {
+        auto config2 = config;
+        config2.untracked_object_types = {};
+        REQUIRE_THROWS_AS(Realm::get_shared_realm(config2), MismatchedConfigException);
     }
 }
 
-TEST_CASE("results: notifier with no callbacks") {
+TEST_CASE("notifications: key path filtering") {
     _impl::RealmCoordinator::assert_no_open_realms();
 
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
 
-    auto coordinator = _impl::RealmCoordinator::get_coordinator(config.path);
-    auto r = coordinator->get_realm(std::move(config));
+    auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
             {"value", PropertyType::Int},
+            {"counter", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "linked"},
+        }},
+        {"linked", {
+            {"value", PropertyType::Int},
+            {"other", PropertyType::Int},
         }},
     });
 
     auto table = r->read_group().get_table("class_object");
-    Results results(r, table->where());
-    results.last(); // force evaluation and creation of TableView
-
-    SECTION("refresh() does not block due to implicit notifier") {
-        // Create and then immediately remove a callback because
-        // `automatic_change_notifications = false` makes Results not implicitly
-        // create a notifier
-        results.add_notification_callback([](CollectionChangeSet const&, std::exception_ptr) {});
-
-        auto r2 = coordinator->get_realm();
-        r2->begin_transaction();
-        r2->read_group().get_table("class_object")->add_empty_row();
-        r2->commit_transaction();
+    auto linked = r->read_group().get_table("class_linked");
 
-        r->refresh(); // would deadlock if there was a callback
+    r->begin_transaction();
+    table->add_empty_row(10);
+    linked->add_empty_row(10);
+    for (int i = 0; i < 10; ++i) {
+        table->set_int(0, i, i);
+        table->set_link(2, i, i);
     }
+    r->commit_transaction();
 
-    SECTION("refresh() does not attempt to deliver stale results") {
-        results.add_notification_callback([](CollectionChangeSet const&, std::exception_ptr) {});
+    Results results(r, table);
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto observe = [&](std::vector<std::string> const& key_paths) {
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++calls;
+            changes = std::move(c);
+        }, key_paths);
+        advance_and_notify(*r);
+        return token;
+    };
 
-        // Create version 1
+    auto write = [&](auto&& fn) {
         r->begin_transaction();
-        table->add_empty_row();
+        fn();
         r->commit_transaction();
+        advance_and_notify(*r);
+    };
 
-        r->begin_transaction();
-        // Run async query for version 1
-        coordinator->on_change();
-        // Create version 2 without ever letting 1 be delivered
-        table->add_empty_row();
-        r->commit_transaction();
+    SECTION("modifications to columns which aren't observed are not reported") {
+        auto token = observe({"counter"});
+        write([&] { table->set_int(0, 3, 10); });
+        REQUIRE(calls == 1);
 
-        // Give it a chance to deliver the async query results (and fail, becuse
-        // they're for version 1 and the realm is at 2)
-        r->refresh();
+        write([&] { table->set_int(1, 3, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 3);
     }
 
-    SECTION("should not pin the source version even after the Realm has been closed") {
-        auto r2 = coordinator->get_realm();
-        REQUIRE(r != r2);
-        r->close();
+    SECTION("insertions and deletions are reported regardless of the filter") {
+        auto token = observe({"counter"});
+        write([&] { table->move_last_over(5); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.deletions, 5, 9);
+        REQUIRE_INDICES(changes.insertions, 5);
+    }
 
-        auto& shared_group = TestHelper::get_shared_group(r2);
-        // There's always at least 2 live versions because the previous version
-        // isn't clean up until the *next* commit
-        REQUIRE(shared_group.get_number_of_versions() == 2);
+    SECTION("key paths through links observe only the named column of the target") {
+        auto token = observe({"link.value"});
+        write([&] { linked->set_int(1, 2, 1); });
+        REQUIRE(calls == 1);
 
-        auto table = r2->read_group().get_table("class_object");
+        write([&] { linked->set_int(0, 2, 1); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 2);
 
-        r2->begin_transaction();
-        table->add_empty_row();
-        r2->commit_transaction();
-        r2->begin_transaction();
-        table->add_empty_row();
-        r2->commit_transaction();
+        // Changing the link itself is a modification to the origin's column
+        write([&] { table->set_link(2, 4, 0); });
+        REQUIRE(calls == 3);
+        REQUIRE_INDICES(changes.modifications, 4);
+    }
 
-        // Would now be 3 if the closed Realm is still pinning the version it was at
-        REQUIRE(shared_group.get_number_of_versions() == 2);
+    SECTION("filtered callbacks see the union of the filters on the notifier") {
+        auto token = observe({"counter"});
+        auto token2 = results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) { }, {"value"});
+        advance_and_notify(*r);
+        write([&] { table->set_int(0, 3, 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 3);
+    }
+
+    SECTION("invalid key paths throw") {
+        auto noop = [](CollectionChangeSet, std::exception_ptr) { };
+        REQUIRE_THROWS(results.add_notification_callback(noop, {"missing"}));
+        REQUIRE_THROWS(results.add_notification_callback(noop, {"value.value"}));
     }
 }
 
-TEST_CASE("results: error messages") {
+TEST_CASE("notifications: changed rows which don't affect the results") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
     InMemoryTestFile config;
-    config.schema = Schema{
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
         {"object", {
-            {"value", PropertyType::String},
+            {"value", PropertyType::Int},
         }},
-    };
+    });
 
-    auto r = Realm::get_shared_realm(config);
     auto table = r->read_group().get_table("class_object");
-    Results results(r, *table);
 
     r->begin_transaction();
-    table->add_empty_row();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
     r->commit_transaction();
 
-    SECTION("out of bounds access") {
-        REQUIRE_THROWS_WITH(results.get(5), "Requested index 5 greater than max 0");
+    Results results(r, table->where().greater(0, 4));
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+
+    auto write = [&](auto&& fn) {
+        r->begin_transaction();
+        fn();
+        r->commit_transaction();
+        advance_and_notify(*r);
+    };
+
+    SECTION("inserting non-matching rows") {
+        write([&] { table->set_int(0, table->add_empty_row(), 1); });
+        REQUIRE(calls == 1);
+        REQUIRE(results.size() == 5);
     }
 
-    SECTION("unsupported aggregate operation") {
-        REQUIRE_THROWS_WITH(results.sum(0), "Cannot sum property 'value': operation not supported for 'string' properties");
+    SECTION("inserting matching rows") {
+        write([&] { table->set_int(0, table->add_empty_row(), 10); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.insertions, 5);
+        REQUIRE(results.size() == 6);
+    }
+
+    SECTION("modifying matching rows so that they still match") {
+        write([&] { table->set_int(0, 6, 20); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 1);
+        REQUIRE(changes.insertions.empty());
+        REQUIRE(changes.deletions.empty());
+        REQUIRE(results.get(1).get_int(0) == 20);
+    }
+
+    SECTION("modifying rows so that they stop matching") {
+        write([&] { table->set_int(0, 6, 0); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.deletions, 1);
+        REQUIRE(results.size() == 4);
+    }
+
+    SECTION("deleting non-matching rows which don't move matching rows") {
+        write([&] {
+            table->set_int(0, table->add_empty_row(), 1);
+        });
+        write([&] { table->move_last_over(0); });
+        REQUIRE(calls == 1);
+        REQUIRE(results.size() == 5);
+    }
+
+    SECTION("deleting non-matching rows which move matching rows") {
+        write([&] { table->move_last_over(0); });
+        REQUIRE(calls == 2);
+        REQUIRE(results.size() == 5);
+        REQUIRE(results.get(0).get_int(0) == 9);
     }
 }
 
-TEST_CASE("results: snapshots") {
+TEST_CASE("notifications: sorted and limited results") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
-    config.schema = Schema{
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
         {"object", {
-            {"value", PropertyType::Int},
-            {"array", PropertyType::Array|PropertyType::Object, "linked to object"}
+            {"score", PropertyType::Int},
         }},
-        {"linked to object", {
-            {"value", PropertyType::Int}
-        }}
-    };
+    });
 
-    auto r = Realm::get_shared_realm(config);
+    auto table = r->read_group().get_table("class_object");
 
-    auto write = [&](auto&& f) {
+    r->begin_transaction();
+    table->add_empty_row(20);
+    for (int i = 0; i < 20; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
+
+    Results results = Results(r, table->where()).sort({{"score", false}}).limit(5);
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+    REQUIRE(results.size() == 5);
+
+    auto write = [&](auto&& fn) {
         r->begin_transaction();
-        f();
+        fn();
         r->commit_transaction();
         advance_and_notify(*r);
     };
 
-    SECTION("snapshot of empty Results") {
-        Results results;
-        auto snapshot = results.snapshot();
-        REQUIRE(snapshot.size() == 0);
+    SECTION("modifying rows which stay outside the limit") {
+        write([&] { table->set_int(0, 3, 10); });
+        REQUIRE(calls == 1);
+        REQUIRE(results.size() == 5);
+        REQUIRE(results.get(4).get_int(0) == 15);
     }
 
-    SECTION("snapshot of Results based on Table") {
-        auto table = r->read_group().get_table("class_object");
-        Results results(r, *table);
-
-        {
-            // A newly-added row should not appear in the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 0);
-            write([=]{
-                table->add_empty_row();
-            });
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 0);
-        }
-
-        {
-            // Removing a row present in the snapshot should not affect the size of the snapshot,
-            // but will result in the snapshot returning a detached row accessor.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 1);
-            write([=]{
-                table->move_last_over(0);
-            });
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
+    SECTION("inserting rows which sort after the limit") {
+        write([&] { table->set_int(0, table->add_empty_row(), 5); });
+        REQUIRE(calls == 1);
+        REQUIRE(results.get(4).get_int(0) == 15);
+    }
 
-            // Adding a row at the same index that was formerly present in the snapshot shouldn't
-            // affect the state of the snapshot.
-            write([=]{
-                table->add_empty_row();
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-        }
+    SECTION("modifying a row so that it moves inside the limit") {
+        write([&] { table->set_int(0, 3, 100); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.insertions, 0);
+        REQUIRE_INDICES(changes.deletions, 4);
+        REQUIRE(results.get(0).get_int(0) == 100);
     }
 
-    SECTION("snapshot of Results based on LinkView") {
-        auto object = r->read_group().get_table("class_object");
-        auto linked_to = r->read_group().get_table("class_linked to object");
+    SECTION("inserting a row which ties with the last row") {
+        // Ties force a rerun, which finds the new row sorting after the
+        // existing one and so leaves the window unchanged
+        write([&] { table->set_int(0, table->add_empty_row(), 15); });
+        REQUIRE(calls == 1);
+        REQUIRE(results.size() == 5);
+        REQUIRE(results.get(3).get_int(0) == 16);
+        REQUIRE(results.get(4).get_int(0) == 15);
+    }
 
-        write([=]{
-            object->add_empty_row();
-        });
+    SECTION("modifying a row inside the limit") {
+        write([&] { table->set_int(0, 19, 0); });
+        REQUIRE(calls == 2);
+        REQUIRE(results.get(0).get_int(0) == 18);
+        REQUIRE(results.get(4).get_int(0) == 14);
+    }
+}
 
-        LinkViewRef lv = object->get_linklist(1, 0);
-        Results results(r, lv);
+TEST_CASE("notifications: sorted through links") {
+    _impl::RealmCoordinator::assert_no_open_realms();
 
-        {
-            // A newly-added row should not appear in the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 0);
-            write([=]{
-                lv->add(linked_to->add_empty_row());
-            });
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 0);
-        }
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-        {
-            // Removing a row from the link list should not affect the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 1);
-            write([=]{
-                lv->remove(0);
-            });
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(snapshot.get(0).is_attached());
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "target"},
+        }},
+        {"target", {
+            {"score", PropertyType::Int},
+        }},
+    });
 
-            // Removing a row present in the snapshot from its table should result in the snapshot
-            // returning a detached row accessor.
-            write([=]{
-                linked_to->remove(0);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
+    auto table = r->read_group().get_table("class_object");
+    auto target = r->read_group().get_table("class_target");
 
-            // Adding a new row to the link list shouldn't affect the state of the snapshot.
-            write([=]{
-                lv->add(linked_to->add_empty_row());
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-        }
+    r->begin_transaction();
+    table->add_empty_row(5);
+    target->add_empty_row(5);
+    for (int i = 0; i < 5; ++i) {
+        table->set_int(0, i, i);
+        target->set_int(0, i, 100 - i * 10);
+        table->set_link(1, i, i);
     }
+    r->commit_transaction();
 
-    SECTION("snapshot of Results based on Query") {
-        auto table = r->read_group().get_table("class_object");
-        Query q = table->column<Int>(0) > 0;
-        Results results(r, std::move(q));
+    Results results = Results(r, table->where().greater(0, 0)).sort({{"link.score", true}});
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++calls;
+        changes = std::move(c);
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
 
-        {
-            // A newly-added row should not appear in the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 0);
-            write([=]{
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 0);
-        }
-
-        {
-            // Updating a row to no longer match the query criteria should not affect the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 1);
-            write([=]{
-                table->set_int(0, 0, 0);
-            });
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(snapshot.get(0).is_attached());
-
-            // Removing a row present in the snapshot from its table should result in the snapshot
-            // returning a detached row accessor.
-            write([=]{
-                table->remove(0);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-
-            // Adding a new row that matches the query criteria shouldn't affect the state of the snapshot.
-            write([=]{
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-        }
-    }
-
-    SECTION("snapshot of Results based on TableView from query") {
-        auto table = r->read_group().get_table("class_object");
-        Query q = table->column<Int>(0) > 0;
-        Results results(r, q.find_all());
-
-        {
-            // A newly-added row should not appear in the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 0);
-            write([=]{
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 0);
-        }
-
-        {
-            // Updating a row to no longer match the query criteria should not affect the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 1);
-            write([=]{
-                table->set_int(0, 0, 0);
-            });
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(snapshot.get(0).is_attached());
+    auto write = [&](auto&& fn) {
+        r->begin_transaction();
+        fn();
+        r->commit_transaction();
+        advance_and_notify(*r);
+    };
+    auto values = [&] {
+        std::vector<int64_t> values;
+        for (size_t i = 0; i < results.size(); ++i)
+            values.push_back(results.get(i).get_int(0));
+        return values;
+    };
+    REQUIRE((values() == std::vector<int64_t>{4, 3, 2, 1}));
 
-            // Removing a row present in the snapshot from its table should result in the snapshot
-            // returning a detached row accessor.
-            write([=]{
-                table->remove(0);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
+    SECTION("modifying linked objects without changing the order") {
+        write([&] { target->set_int(0, 2, 75); });
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 2);
+        REQUIRE((values() == std::vector<int64_t>{4, 3, 2, 1}));
 
-            // Adding a new row that matches the query criteria shouldn't affect the state of the snapshot.
-            write([=]{
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-        }
+        write([&] { target->set_int(0, 2, 85); });
+        REQUIRE(calls == 3);
+        REQUIRE((values() == std::vector<int64_t>{4, 3, 2, 1}));
     }
 
-    SECTION("snapshot of Results based on TableView from backlinks") {
-        auto object = r->read_group().get_table("class_object");
-        auto linked_to = r->read_group().get_table("class_linked to object");
-
-        write([=]{
-            linked_to->add_empty_row();
-        });
-
-        TableView backlinks = linked_to->get_backlink_view(0, object.get(), 1);
-        Results results(r, std::move(backlinks));
-
-        auto lv = object->get_linklist(1, object->add_empty_row());
-
-        {
-            // A newly-added row should not appear in the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 0);
-            write([=]{
-                lv->add(0);
-            });
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 0);
-        }
-
-        {
-            // Removing the link should not affect the snapshot.
-            auto snapshot = results.snapshot();
-            REQUIRE(results.size() == 1);
-            REQUIRE(snapshot.size() == 1);
-            write([=]{
-                lv->remove(0);
-            });
-            REQUIRE(results.size() == 0);
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(snapshot.get(0).is_attached());
-
-            // Removing a row present in the snapshot from its table should result in the snapshot
-            // returning a detached row accessor.
-            write([=]{
-                object->remove(0);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
+    SECTION("modifying linked objects so that the order changes") {
+        write([&] { target->set_int(0, 1, 0); });
+        REQUIRE(calls == 2);
+        REQUIRE((values() == std::vector<int64_t>{1, 4, 3, 2}));
 
-            // Adding a new link shouldn't affect the state of the snapshot.
-            write([=]{
-                object->add_empty_row();
-                auto lv = object->get_linklist(1, object->add_empty_row());
-                lv->add(0);
-            });
-            REQUIRE(snapshot.size() == 1);
-            REQUIRE(!snapshot.get(0).is_attached());
-        }
+        write([&] { target->set_int(0, 1, 200); });
+        REQUIRE(calls == 3);
+        REQUIRE((values() == std::vector<int64_t>{4, 3, 2, 1}));
     }
 
-    SECTION("snapshot of Results with notification callback registered") {
-        auto table = r->read_group().get_table("class_object");
-        Query q = table->column<Int>(0) > 0;
-        Results results(r, q.find_all());
-
-        auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
-            REQUIRE_FALSE(err);
-        });
-        advance_and_notify(*r);
-
-        SECTION("snapshot of lvalue") {
-            auto snapshot = results.snapshot();
-            write([=] {
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(snapshot.size() == 0);
-        }
-
-        SECTION("snapshot of rvalue") {
-            auto snapshot = std::move(results).snapshot();
-            write([=] {
-                table->set_int(0, table->add_empty_row(), 1);
-            });
-            REQUIRE(snapshot.size() == 0);
-        }
+    SECTION("changing links so that the order changes") {
+        write([&] { table->set_link(1, 4, 1); });
+        REQUIRE(calls == 2);
+        REQUIRE((values() == std::vector<int64_t>{3, 2, 1, 4}));
     }
 
-    SECTION("adding notification callback to snapshot throws") {
-        auto table = r->read_group().get_table("class_object");
-        Query q = table->column<Int>(0) > 0;
-        Results results(r, q.find_all());
-        auto snapshot = results.snapshot();
-        CHECK_THROWS(snapshot.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {}));
+    SECTION("nullifying links sorts them last when ascending") {
+        write([&] { target->move_last_over(3); });
+        REQUIRE(calls == 2);
+        REQUIRE((values() == std::vector<int64_t>{4, 2, 1, 3}));
     }
 
-    SECTION("accessors should return none for detached row") {
-        auto table = r->read_group().get_table("class_object");
-        write([=] {
-            table->add_empty_row();
-        });
-        Results results(r, *table);
-        auto snapshot = results.snapshot();
-        write([=] {;
-            table->clear();
-        });
-
-        REQUIRE_FALSE(snapshot.get(0).is_attached());
-        REQUIRE_FALSE(snapshot.first()->is_attached());
-        REQUIRE_FALSE(snapshot.last()->is_attached());
+    SECTION("modifying unused linked objects") {
+        write([&] { target->set_int(0, 0, 0); });
+        REQUIRE(calls == 1);
+        REQUIRE((values() == std::vector<int64_t>{4, 3, 2, 1}));
     }
 }
 
-TEST_CASE("results: distinct") {
-    const int N = 10;
+TEST_CASE("notifications: skip") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
@@ -2337,64 +2061,2219 @@ TEST_CASE("results: distinct") {
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
-            {"num1", PropertyType::Int},
-            {"string", PropertyType::String},
-            {"num2", PropertyType::Int},
-            {"num3", PropertyType::Int}
+            {"value", PropertyType::Int}
         }},
     });
 
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
     auto table = r->read_group().get_table("class_object");
 
     r->begin_transaction();
-    table->add_empty_row(N);
-    for (int i = 0; i < N; ++i) {
-        table->set_int(0, i, i % 3);
-        table->set_string(1, i, util::format("Foo_%1", i % 3).c_str());
-        table->set_int(2, i, N - i);
-        table->set_int(3, i, i % 2);
-    }
-    // table:
-    //   0, Foo_0, 10,  0
-    //   1, Foo_1,  9,  1
-    //   2, Foo_2,  8,  0
-    //   0, Foo_0,  7,  1
-    //   1, Foo_1,  6,  0
-    //   2, Foo_2,  5,  1
-    //   0, Foo_0,  4,  0
-    //   1, Foo_1,  3,  1
-    //   2, Foo_2,  2,  0
-    //   0, Foo_0,  1,  1
-
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i * 2);
     r->commit_transaction();
-    Results results(r, table->where());
 
-    SECTION("Single integer property") {
-        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        // unique:
-        //  0, Foo_0, 10
-        //  1, Foo_1,  9
-        //  2, Foo_2,  8
-        REQUIRE(unique.size() == 3);
-        REQUIRE(unique.get(0).get_int(2) == 10);
-        REQUIRE(unique.get(1).get_int(2) == 9);
-        REQUIRE(unique.get(2).get_int(2) == 8);
-    }
+    Results results(r, table->where());
 
-    SECTION("Single integer via apply_ordering") {
-        DescriptorOrdering ordering;
-        ordering.append_sort(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        ordering.append_distinct(DistinctDescriptor(results.get_tableview().get_parent(), {{0}}));
-        Results unique = results.apply_ordering(std::move(ordering));
-        // unique:
-        //  0, Foo_0, 10
-        //  1, Foo_1,  9
-        //  2, Foo_2,  8
-        REQUIRE(unique.size() == 3);
-        REQUIRE(unique.get(0).get_int(2) == 10);
-        REQUIRE(unique.get(1).get_int(2) == 9);
-        REQUIRE(unique.get(2).get_int(2) == 8);
-    }
+    auto add_callback = [](Results& results, int& calls, CollectionChangeSet& changes) {
+        return results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            ++calls;
+            changes = std::move(c);
+        });
+    };
+
+    auto make_local_change = [&](auto& token) {
+        r->begin_transaction();
+        table->add_empty_row();
+        token.suppress_next();
+        r->commit_transaction();
+    };
+
+    auto make_remote_change = [&] {
+        auto r2 = coordinator->get_realm();
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->add_empty_row();
+        r2->commit_transaction();
+    };
+
+    int calls1 = 0;
+    CollectionChangeSet changes1;
+    auto token1 = add_callback(results, calls1, changes1);
+
+    SECTION("no notification is sent when only callback is skipped") {
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+
+        make_local_change(token1);
+        advance_and_notify(*r);
+
+        REQUIRE(calls1 == 1);
+        REQUIRE(changes1.empty());
+    }
+
+    SECTION("unskipped tokens for the same Results are still delivered") {
+        int calls2 = 0;
+        CollectionChangeSet changes2;
+        auto token2 = add_callback(results, calls2, changes2);
+
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+        REQUIRE(calls2 == 1);
+
+        make_local_change(token1);
+        advance_and_notify(*r);
+
+        REQUIRE(calls1 == 1);
+        REQUIRE(changes1.empty());
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes2.insertions, 10);
+    }
+
+    SECTION("unskipped tokens for different Results are still delivered") {
+        Results results2(r, table->where());
+        int calls2 = 0;
+        CollectionChangeSet changes2;
+        auto token2 = add_callback(results2, calls2, changes2);
+
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+        REQUIRE(calls2 == 1);
+
+        make_local_change(token1);
+        advance_and_notify(*r);
+
+        REQUIRE(calls1 == 1);
+        REQUIRE(changes1.empty());
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes2.insertions, 10);
+    }
+
+    SECTION("additional commits which occur before calculation are merged in") {
+        int calls2 = 0;
+        CollectionChangeSet changes2;
+        auto token2 = add_callback(results, calls2, changes2);
+
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+        REQUIRE(calls2 == 1);
+
+        make_local_change(token1);
+        make_remote_change();
+        advance_and_notify(*r);
+
+        REQUIRE(calls1 == 2);
+        REQUIRE_INDICES(changes1.insertions, 11);
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes2.insertions, 10, 11);
+    }
+
+    SECTION("additional commits which occur before delivery are merged in") {
+        int calls2 = 0;
+        CollectionChangeSet changes2;
+        auto token2 = add_callback(results, calls2, changes2);
+
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+        REQUIRE(calls2 == 1);
+
+        make_local_change(token1);
+        coordinator->on_change();
+        make_remote_change();
+        advance_and_notify(*r);
+
+        REQUIRE(calls1 == 2);
+        REQUIRE_INDICES(changes1.insertions, 11);
+        REQUIRE(calls2 == 2);
+        REQUIRE_INDICES(changes2.insertions, 10, 11);
+    }
+
+    SECTION("skipping must be done from within a write transaction") {
+        REQUIRE_THROWS(token1.suppress_next());
+    }
+
+    SECTION("skipping must be done from the Realm's thread") {
+        advance_and_notify(*r);
+        r->begin_transaction();
+        std::thread([&] {
+            REQUIRE_THROWS(token1.suppress_next());
+        }).join();
+        r->cancel_transaction();
+    }
+
+    SECTION("new notifiers do not interfere with skipping") {
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+
+        CollectionChangeSet changes;
+
+        // new notifier at a version before the skipped one
+        auto r2 = coordinator->get_realm();
+        Results results2(r2, r2->read_group().get_table("class_object")->where());
+        int calls2 = 0;
+        auto token2 = add_callback(results2, calls2, changes);
+
+        make_local_change(token1);
+
+        // new notifier at the skipped version
+        auto r3 = coordinator->get_realm();
+        Results results3(r3, r3->read_group().get_table("class_object")->where());
+        int calls3 = 0;
+        auto token3 = add_callback(results3, calls3, changes);
+
+        make_remote_change();
+
+        // new notifier at version after the skipped one
+        auto r4 = coordinator->get_realm();
+        Results results4(r4, r4->read_group().get_table("class_object")->where());
+        int calls4 = 0;
+        auto token4 = add_callback(results4, calls4, changes);
+
+        coordinator->on_change();
+        r->notify();
+        r2->notify();
+        r3->notify();
+        r4->notify();
+
+        REQUIRE(calls1 == 2);
+        REQUIRE(calls2 == 1);
+        REQUIRE(calls3 == 1);
+        REQUIRE(calls4 == 1);
+    }
+
+    SECTION("skipping only effects the current transaction even if no notification would occur anyway") {
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+
+        // would not produce a notification even if it wasn't skipped because no changes were made
+        r->begin_transaction();
+        token1.suppress_next();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+
+        // should now produce a notification
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 2);
+    }
+
+    SECTION("removing skipped notifier before it gets the chance to run") {
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 1);
+
+        // Set the skip version
+        make_local_change(token1);
+        // Advance the file to a version after the skip version
+        make_remote_change();
+        REQUIRE(calls1 == 1);
+
+        // Remove the skipped notifier and add an entirely new notifier, so that
+        // notifications need to run but the skip logic shouldn't be used
+        token1 = {};
+        results = {};
+        Results results2(r, table->where());
+        auto token2 = add_callback(results2, calls1, changes1);
+
+        advance_and_notify(*r);
+        REQUIRE(calls1 == 2);
+    }
+}
+
+TEST_CASE("notifications: shared change sets") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int}
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    Results results(r, table->where());
+
+    CollectionChangeSet const* delivered1 = nullptr;
+    CollectionChangeSet const* delivered2 = nullptr;
+    CollectionChangeSet changes1, changes2;
+    auto token1 = results.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr) {
+        delivered1 = &c;
+        changes1 = c;
+    });
+    auto token2 = results.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr) {
+        delivered2 = &c;
+        changes2 = c;
+    });
+    advance_and_notify(*r);
+
+    SECTION("callbacks which saw the same changes are given the same object") {
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+
+        REQUIRE(delivered1);
+        REQUIRE(delivered1 == delivered2);
+        REQUIRE_INDICES(changes1.insertions, 0);
+        REQUIRE_INDICES(changes2.insertions, 0);
+    }
+
+    SECTION("skipping one callback does not change what the other sees") {
+        r->begin_transaction();
+        table->add_empty_row();
+        token1.suppress_next();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(changes1.empty());
+        REQUIRE_INDICES(changes2.insertions, 0);
+
+        // Both callbacks are back in sync after the delivery
+        delivered1 = delivered2 = nullptr;
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(delivered1);
+        REQUIRE(delivered1 == delivered2);
+        REQUIRE_INDICES(changes1.insertions, 1);
+        REQUIRE_INDICES(changes2.insertions, 1);
+    }
+}
+
+TEST_CASE("notifications: aggregates") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+            {"optional", PropertyType::Double|PropertyType::Nullable},
+            {"date", PropertyType::Date},
+            {"string", PropertyType::String},
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i) {
+        table->set_int(0, i, i);
+        if (i % 2)
+            table->set_double(1, i, i);
+        table->set_timestamp(2, i, Timestamp(i, 0));
+    }
+    r->commit_transaction();
+
+    Results results(r, table->where().greater(0, 1));
+
+    // Check each aggregate against the same aggregate calculated synchronously
+    std::vector<std::pair<Results::AggregateKind, size_t>> aggregates = {
+        {Results::AggregateKind::Count, 0},
+        {Results::AggregateKind::Sum, 0},
+        {Results::AggregateKind::Min, 0},
+        {Results::AggregateKind::Max, 0},
+        {Results::AggregateKind::Average, 0},
+        {Results::AggregateKind::Sum, 1},
+        {Results::AggregateKind::Min, 1},
+        {Results::AggregateKind::Max, 1},
+        {Results::AggregateKind::Average, 1},
+        {Results::AggregateKind::Min, 2},
+        {Results::AggregateKind::Max, 2},
+    };
+    std::vector<util::Optional<Mixed>> values(aggregates.size());
+    std::vector<NotificationToken> tokens;
+    for (size_t i = 0; i < aggregates.size(); ++i) {
+        tokens.push_back(results.observe_aggregate(aggregates[i].second, aggregates[i].first,
+                                                   [&values, i](util::Optional<Mixed> value, std::exception_ptr) {
+            values[i] = value;
+        }));
+    }
+
+    auto require_values = [&] {
+        // `results` returns the observed values once they've been delivered,
+        // so compare against a Results which has to compute them itself
+        Results fresh(r, table->where().greater(0, 1));
+        auto expected = [&](Results::AggregateKind kind, size_t column) -> util::Optional<Mixed> {
+            switch (kind) {
+                case Results::AggregateKind::Count: return Mixed(int64_t(fresh.size()));
+                case Results::AggregateKind::Sum: return fresh.sum(column);
+                case Results::AggregateKind::Min: return fresh.min(column);
+                case Results::AggregateKind::Max: return fresh.max(column);
+                case Results::AggregateKind::Average:
+                    if (auto average = fresh.average(column))
+                        return Mixed(*average);
+                    return util::none;
+            }
+            return util::none;
+        };
+        for (size_t i = 0; i < aggregates.size(); ++i) {
+            INFO("aggregate " << i);
+            auto value = expected(aggregates[i].first, aggregates[i].second);
+            REQUIRE(bool(values[i]) == bool(value));
+            if (!value)
+                continue;
+            REQUIRE(values[i]->get_type() == value->get_type());
+            switch (value->get_type()) {
+                case type_Int: REQUIRE(values[i]->get_int() == value->get_int()); break;
+                case type_Double: REQUIRE(values[i]->get_double() == Approx(value->get_double())); break;
+                case type_Timestamp: REQUIRE(values[i]->get_timestamp() == value->get_timestamp()); break;
+                default: FAIL("unexpected type");
+            }
+        }
+    };
+
+    advance_and_notify(*r);
+
+    SECTION("initial values") {
+        require_values();
+    }
+
+    SECTION("insertions") {
+        r->begin_transaction();
+        size_t row = table->add_empty_row(2);
+        table->set_int(0, row, 20);
+        table->set_double(1, row, -5);
+        table->set_timestamp(2, row, Timestamp(20, 0));
+        table->set_int(0, row + 1, -3);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        require_values();
+    }
+
+    SECTION("deleting the min and max") {
+        r->begin_transaction();
+        table->move_last_over(9);
+        table->move_last_over(2);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        require_values();
+    }
+
+    SECTION("modifications") {
+        r->begin_transaction();
+        table->set_int(0, 5, 100);
+        table->set_null(1, 3);
+        table->set_double(1, 4, 0.5);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        require_values();
+    }
+
+    SECTION("modifications which change whether rows match") {
+        r->begin_transaction();
+        table->set_int(0, 0, 50);
+        table->set_int(0, 7, 0);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        require_values();
+    }
+
+    SECTION("removing every row") {
+        r->begin_transaction();
+        table->clear();
+        r->commit_transaction();
+        advance_and_notify(*r);
+        require_values();
+    }
+
+    SECTION("aggregates added after the query has run") {
+        util::Optional<Mixed> sum;
+        auto token = results.observe_aggregate(0, Results::AggregateKind::Sum, [&](util::Optional<Mixed> value, std::exception_ptr) {
+            sum = value;
+        });
+        advance_and_notify(*r);
+        REQUIRE(sum);
+        REQUIRE(sum->get_int() == Results(r, table->where().greater(0, 1)).sum(0)->get_int());
+    }
+
+    SECTION("synchronous aggregates use the delivered values for the current version") {
+        REQUIRE(results.sum(0)->get_int() == 44);
+        REQUIRE(results.size() == 8);
+
+        // Not yet delivered for the new version, so computed synchronously
+        r->begin_transaction();
+        table->set_int(0, 9, 19);
+        REQUIRE(results.sum(0)->get_int() == 54);
+        r->commit_transaction();
+        REQUIRE(results.sum(0)->get_int() == 54);
+        REQUIRE(results.max(0)->get_int() == 19);
+
+        advance_and_notify(*r);
+        REQUIRE(results.sum(0)->get_int() == 54);
+        REQUIRE(results.max(0)->get_int() == 19);
+        REQUIRE(*results.average(0) == Approx(54.0 / 8));
+        REQUIRE(results.size() == 8);
+    }
+
+    SECTION("unsupported column types") {
+        REQUIRE_THROWS_AS(results.observe_aggregate(3, Results::AggregateKind::Sum, nullptr),
+                          Results::UnsupportedColumnTypeException);
+        REQUIRE_THROWS_AS(results.observe_aggregate(2, Results::AggregateKind::Average, nullptr),
+                          Results::UnsupportedColumnTypeException);
+        REQUIRE_THROWS_AS(results.observe_aggregate(10, Results::AggregateKind::Max, nullptr),
+                          Results::OutOfBoundsIndexException);
+    }
+}
+
+TEST_CASE("notifications: count-only aggregates") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
+
+    Results results(r, table->where().greater(0, 4));
+    int calls = 0;
+    int64_t count = -1;
+    auto token = results.observe_aggregate(0, Results::AggregateKind::Count, [&](util::Optional<Mixed> value, std::exception_ptr) {
+        ++calls;
+        count = value->get_int();
+    });
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+    REQUIRE(count == 5);
+
+    SECTION("does not deliver a TableView") {
+        REQUIRE(results.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("is notified when the count changes") {
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE(count == 6);
+        REQUIRE(results.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("is not notified when rows change without changing the count") {
+        r->begin_transaction();
+        table->set_int(0, 9, 20);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+    }
+
+    SECTION("switches back to running the query when another callback is added") {
+        CollectionChangeSet changes;
+        auto token2 = results.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr) {
+            changes = c;
+        });
+        advance_and_notify(*r);
+        REQUIRE(count == 5);
+
+        r->begin_transaction();
+        table->set_int(0, 0, 10);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(count == 6);
+        REQUIRE_INDICES(changes.insertions, 0);
+        REQUIRE(changes.deletions.empty());
+    }
+}
+
+TEST_CASE("notifications: results window") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(100);
+    for (int i = 0; i < 100; ++i)
+        table->set_int(0, i, i);
+    r->commit_transaction();
+
+    Results results(r, table->where().greater_equal(0, 0));
+    ResultsWindow window(results, 10, 5, 5);
+    int calls = 0;
+    CollectionChangeSet changes;
+    auto token = window.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        changes = c;
+        ++calls;
+    });
+
+    auto window_values = [&] {
+        std::vector<int64_t> values;
+        for (size_t i = 0; i < window.size(); ++i)
+            values.push_back(window.get(i).get_int(0));
+        return values;
+    };
+
+    REQUIRE(window.size() == 0);
+    advance_and_notify(*r);
+    REQUIRE(calls == 1);
+    REQUIRE(window.offset() == 10);
+    REQUIRE(window_values() == (std::vector<int64_t>{10, 11, 12, 13, 14}));
+
+    SECTION("does not create a TableView for the source Results") {
+        REQUIRE(results.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("reports modifications relative to the window") {
+        r->begin_transaction();
+        table->set_int(0, 12, 12);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.modifications, 2);
+        REQUIRE(changes.insertions.empty());
+        REQUIRE(changes.deletions.empty());
+    }
+
+    SECTION("is not notified for changes outside the window") {
+        r->begin_transaction();
+        table->set_int(0, 50, 50);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 1);
+    }
+
+    SECTION("rows shifting into and out of the window") {
+        r->begin_transaction();
+        table->remove(0);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.deletions, 0);
+        REQUIRE_INDICES(changes.insertions, 4);
+        REQUIRE(window_values() == (std::vector<int64_t>{11, 12, 13, 14, 15}));
+    }
+
+    SECTION("moving the window reports the rows entering and leaving it") {
+        window.move(12, 5);
+        REQUIRE(window.offset() == 10);
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE(window.offset() == 12);
+        REQUIRE_INDICES(changes.deletions, 0, 1);
+        REQUIRE_INDICES(changes.insertions, 3, 4);
+        REQUIRE(window_values() == (std::vector<int64_t>{12, 13, 14, 15, 16}));
+    }
+
+    SECTION("moving the window outside of the fetched rows") {
+        window.move(80, 3);
+        advance_and_notify(*r);
+        REQUIRE(calls == 2);
+        REQUIRE_INDICES(changes.deletions, 0, 1, 2, 3, 4);
+        REQUIRE_INDICES(changes.insertions, 0, 1, 2);
+        REQUIRE(window_values() == (std::vector<int64_t>{80, 81, 82}));
+    }
+
+    SECTION("window past the end of the results") {
+        window.move(98, 5);
+        advance_and_notify(*r);
+        REQUIRE(window.size() == 2);
+        REQUIRE(window_values() == (std::vector<int64_t>{98, 99}));
+
+        r->begin_transaction();
+        table->add_empty_row();
+        table->set_int(0, 100, 100);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE_INDICES(changes.insertions, 2);
+        REQUIRE(window_values() == (std::vector<int64_t>{98, 99, 100}));
+    }
+
+    SECTION("sorted results") {
+        ResultsWindow sorted(results.sort({*table, {{0}}, {false}}), 0, 3, 2);
+        CollectionChangeSet sorted_changes;
+        auto token2 = sorted.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr) {
+            sorted_changes = c;
+        });
+        advance_and_notify(*r);
+        REQUIRE(sorted.size() == 3);
+        REQUIRE(sorted.get(0).get_int(0) == 99);
+
+        r->begin_transaction();
+        table->set_int(0, 0, 1000);
+        r->commit_transaction();
+        advance_and_notify(*r);
+        REQUIRE_INDICES(sorted_changes.insertions, 0);
+        REQUIRE_INDICES(sorted_changes.deletions, 2);
+        REQUIRE(sorted.get(0).get_int(0) == 1000);
+        REQUIRE(sorted.get(2).get_int(0) == 98);
+    }
+
+    SECTION("appending rows to sorted results") {
+        ResultsWindow sorted(results.sort({*table, {{0}}, {true}}), 97, 5, 2);
+        CollectionChangeSet sorted_changes;
+        auto token2 = sorted.add_notification_callback([&](CollectionChangeSet const& c, std::exception_ptr) {
+            sorted_changes = c;
+        });
+        advance_and_notify(*r);
+        auto sorted_values = [&] {
+            std::vector<int64_t> values;
+            for (size_t i = 0; i < sorted.size(); ++i)
+                values.push_back(sorted.get(i).get_int(0));
+            return values;
+        };
+        REQUIRE(sorted_values() == (std::vector<int64_t>{97, 98, 99}));
+
+        auto append = [&](int64_t value) {
+            r->begin_transaction();
+            table->set_int(0, table->add_empty_row(), value);
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        append(150);
+        REQUIRE_INDICES(sorted_changes.insertions, 3);
+        REQUIRE(sorted_values() == (std::vector<int64_t>{97, 98, 99, 150}));
+
+        append(99);
+        REQUIRE_INDICES(sorted_changes.insertions, 3);
+        REQUIRE(sorted_values() == (std::vector<int64_t>{97, 98, 99, 99, 150}));
+        REQUIRE(sorted.get(3).get_index() == 101);
+
+        append(50);
+        REQUIRE(sorted_values() == (std::vector<int64_t>{96, 97, 98, 99, 99}));
+    }
+
+    SECTION("accessing rows outside the window throws") {
+        REQUIRE_THROWS_AS(window.get(5), Results::OutOfBoundsIndexException);
+    }
+}
+
+#if REALM_PLATFORM_APPLE
+TEST_CASE("notifications: async error handling") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    Results results(r, *r->read_group().get_table("class_object"));
+
+    auto r2 = Realm::get_shared_realm(config);
+
+    class OpenFileLimiter {
+    public:
+        OpenFileLimiter()
+        {
+            // Set the max open files to zero so that opening new files will fail
+            getrlimit(RLIMIT_NOFILE, &m_old);
+            rlimit rl = m_old;
+            rl.rlim_cur = 0;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+
+        ~OpenFileLimiter()
+        {
+            setrlimit(RLIMIT_NOFILE, &m_old);
+        }
+
+    private:
+        rlimit m_old;
+    };
+
+    SECTION("error when opening the advancer SG") {
+        OpenFileLimiter limiter;
+
+        bool called = false;
+        auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+            REQUIRE(err);
+            REQUIRE_FALSE(called);
+            called = true;
+        });
+        REQUIRE(!called);
+
+        SECTION("error is delivered on notify() without changes") {
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->notify();
+            REQUIRE(called);
+        }
+
+        SECTION("error is delivered on notify() with changes") {
+            r2->begin_transaction(); r2->commit_transaction();
+            REQUIRE(!called);
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->notify();
+            REQUIRE(called);
+        }
+
+        SECTION("error is delivered on refresh() without changes") {
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->refresh();
+            REQUIRE(called);
+        }
+
+        SECTION("error is delivered on refresh() with changes") {
+            r2->begin_transaction(); r2->commit_transaction();
+            REQUIRE(!called);
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->refresh();
+            REQUIRE(called);
+        }
+
+        SECTION("error is delivered on begin_transaction() without changes") {
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->begin_transaction();
+            REQUIRE(called);
+            r->cancel_transaction();
+        }
+
+        SECTION("error is delivered on begin_transaction() with changes") {
+            r2->begin_transaction(); r2->commit_transaction();
+            REQUIRE(!called);
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->begin_transaction();
+            REQUIRE(called);
+            r->cancel_transaction();
+        }
+
+        SECTION("adding another callback sends the error to only the newly added one") {
+            advance_and_notify(*r);
+            REQUIRE(called);
+
+            bool called2 = false;
+            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                REQUIRE(err);
+                REQUIRE_FALSE(called2);
+                called2 = true;
+            });
+
+            advance_and_notify(*r);
+            REQUIRE(called2);
+        }
+
+        SECTION("destroying a token from before the error does not remove newly added callbacks") {
+            advance_and_notify(*r);
+
+            bool called = false;
+            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                REQUIRE(err);
+                REQUIRE_FALSE(called);
+                called = true;
+            });
+            token = {};
+
+            advance_and_notify(*r);
+            REQUIRE(called);
+        }
+
+        SECTION("adding another callback from within an error callback defers delivery") {
+            NotificationToken token2;
+            token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+                token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                    REQUIRE(err);
+                    REQUIRE_FALSE(called);
+                    called = true;
+                });
+            });
+            advance_and_notify(*r);
+            REQUIRE(!called);
+            advance_and_notify(*r);
+            REQUIRE(called);
+        }
+
+        SECTION("adding a callback to a different collection from within the error callback defers delivery") {
+            auto results2 = results;
+            NotificationToken token2;
+            token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) {
+                token2 = results2.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                    REQUIRE(err);
+                    REQUIRE_FALSE(called);
+                    called = true;
+                });
+            });
+            advance_and_notify(*r);
+            REQUIRE(!called);
+            advance_and_notify(*r);
+            REQUIRE(called);
+        }
+    }
+
+    SECTION("error when opening the executor SG") {
+        SECTION("error is delivered asynchronously") {
+            bool called = false;
+            auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                REQUIRE(err);
+                called = true;
+            });
+            OpenFileLimiter limiter;
+
+            REQUIRE(!called);
+            coordinator->on_change();
+            REQUIRE(!called);
+            r->notify();
+            REQUIRE(called);
+        }
+
+        SECTION("adding another callback only sends the error to the new one") {
+            bool called = false;
+            auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                REQUIRE(err);
+                REQUIRE_FALSE(called);
+                called = true;
+            });
+            OpenFileLimiter limiter;
+
+            advance_and_notify(*r);
+
+            bool called2 = false;
+            auto token2 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+                REQUIRE(err);
+                REQUIRE_FALSE(called2);
+                called2 = true;
+            });
+
+            advance_and_notify(*r);
+
+            REQUIRE(called2);
+        }
+    }
+}
+#endif
+
+#if REALM_ENABLE_SYNC
+TEST_CASE("notifications: sync") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    SyncServer server(false);
+    SyncTestFile config(server);
+    config.cache = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    SECTION("sync progress commits do not distrupt notifications") {
+        auto r = Realm::get_shared_realm(config);
+        auto wait_realm = Realm::get_shared_realm(config);
+
+        Results results(r, *r->read_group().get_table("class_object"));
+        Results wait_results(wait_realm, *wait_realm->read_group().get_table("class_object"));
+        auto token1 = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
+        auto token2 = wait_results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr) { });
+
+        // Add an object to the Realm so that notifications are needed
+        {
+            auto write_realm = Realm::get_shared_realm(config);
+            write_realm->begin_transaction();
+            sync::create_object(write_realm->read_group(), *write_realm->read_group().get_table("class_object"));
+            write_realm->commit_transaction();
+        }
+
+        // Wait for the notifications to become ready for the new version
+        wait_realm->refresh();
+
+        // Start the server and wait for the Realm to be uploaded so that sync
+        // makes some writes to the Realm and bumps the version
+        server.start();
+        wait_for_upload(*r);
+
+        // Make sure that the notifications still get delivered rather than
+        // waiting forever due to that we don't get a commit notification from
+        // the commits sync makes to store the upload progress
+        r->refresh();
+    }
+}
+#endif
+
+TEST_CASE("notifications: results") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "linked to object"}
+        }},
+        {"other object", {
+            {"value", PropertyType::Int}
+        }},
+        {"linking object", {
+            {"link", PropertyType::Object|PropertyType::Nullable, "object"}
+        }},
+        {"linked to object", {
+            {"value", PropertyType::Int}
+        }}
+    });
+
+    auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(config.path);
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    r->read_group().get_table("class_linked to object")->add_empty_row(10);
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i) {
+        table->set_int(0, i, i * 2);
+        table->set_link(1, i, i);
+    }
+    r->commit_transaction();
+
+    auto r2 = coordinator->get_realm();
+    auto r2_table = r2->read_group().get_table("class_object");
+
+    Results results(r, table->where().greater(0, 0).less(0, 10));
+
+    SECTION("unsorted notifications") {
+        int notification_calls = 0;
+        CollectionChangeSet change;
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+            ++notification_calls;
+        });
+
+        advance_and_notify(*r);
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        SECTION("modifications to unrelated tables do not send notifications") {
+            write([&] {
+                r->read_group().get_table("class_other object")->add_empty_row();
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("irrelevant modifications to linked tables do not send notifications") {
+            write([&] {
+                r->read_group().get_table("class_linked to object")->add_empty_row();
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifications to linked objects are reported by each notifier which observes them") {
+            Results results2(r, table->where().greater(0, 2));
+            CollectionChangeSet change2;
+            auto token2 = results2.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+                REQUIRE_FALSE(err);
+                change2 = c;
+            });
+            advance_and_notify(*r);
+
+            write([&] {
+                r->read_group().get_table("class_linked to object")->set_int(0, 2, 1);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.modifications, 1);
+            REQUIRE_INDICES(change2.modifications, 0);
+        }
+
+        SECTION("irrelevant modifications to linking tables do not send notifications") {
+            write([&] {
+                r->read_group().get_table("class_linking object")->add_empty_row();
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
+            write([&] {
+                table->set_int(0, 6, 13);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("deleting non-matching rows does not send a notification") {
+            write([&] {
+                table->move_last_over(0);
+                table->move_last_over(6);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("swapping adjacent matching and non-matching rows does not send notifications") {
+            write([&] {
+                table->swap_rows(0, 1);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("swapping non-adjacent matching and non-matching rows send a single insert/delete pair") {
+            write([&] {
+                table->swap_rows(0, 2);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+            REQUIRE_INDICES(change.insertions, 0);
+        }
+
+        SECTION("swapping matching rows sends insert/delete pairs") {
+            write([&] {
+                table->swap_rows(1, 4);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 0, 3);
+            REQUIRE_INDICES(change.insertions, 0, 3);
+
+            write([&] {
+                table->swap_rows(1, 2);
+                table->swap_rows(2, 3);
+                table->swap_rows(3, 4);
+            });
+            REQUIRE(notification_calls == 3);
+            REQUIRE_INDICES(change.deletions, 1, 2, 3);
+            REQUIRE_INDICES(change.insertions, 0, 1, 2);
+        }
+
+        SECTION("swap does not inhibit move collapsing after removals") {
+            write([&] {
+                table->swap_rows(2, 3);
+                table->set_int(0, 3, 100);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+            REQUIRE(change.insertions.empty());
+        }
+
+        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
+            write([&] {
+                table->set_int(0, 1, 3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.modifications, 0);
+            REQUIRE_INDICES(change.modifications_new, 0);
+        }
+
+        SECTION("modifying a matching row to no longer match marks that row as deleted") {
+            write([&] {
+                table->set_int(0, 2, 0);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+        }
+
+        SECTION("modifying a non-matching row to match marks that row as inserted, but not modified") {
+            write([&] {
+                table->set_int(0, 7, 3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 4);
+            REQUIRE(change.modifications.empty());
+            REQUIRE(change.modifications_new.empty());
+        }
+
+        SECTION("deleting a matching row marks that row as deleted") {
+            write([&] {
+                table->move_last_over(3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 2);
+        }
+
+        SECTION("clearing the table marks all rows as deleted and new matching rows as inserted") {
+            write([&] {
+                table->clear();
+                table->add_empty_row(3);
+                table->set_int(0, 0, 4);
+                table->set_int(0, 1, 20);
+                table->set_int(0, 2, 6);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 0, 1, 2, 3);
+            REQUIRE_INDICES(change.insertions, 0, 1);
+            REQUIRE(change.modifications.empty());
+        }
+
+        SECTION("clearing Results which contain every row of the table clears the table") {
+            write([&] {
+                Results(r, table->where()).clear();
+                REQUIRE(table->size() == 0);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 0, 1, 2, 3);
+            REQUIRE(change.insertions.empty());
+        }
+
+        SECTION("clearing Results which contain some rows of the table only removes those rows") {
+            write([&] {
+                Results(r, table->where().less(0, 6)).clear();
+                REQUIRE(table->size() == 7);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 0, 1);
+        }
+
+        SECTION("moving a matching row via deletion marks that row as moved") {
+            write([&] {
+                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
+                table->move_last_over(0);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_MOVES(change, {3, 0});
+        }
+
+        SECTION("moving a matching row via subsumption marks that row as modified") {
+            write([&] {
+                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
+                table->move_last_over(0);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_MOVES(change, {3, 0});
+        }
+
+        SECTION("modifications from multiple transactions are collapsed") {
+            r2->begin_transaction();
+            r2_table->set_int(0, 0, 6);
+            r2->commit_transaction();
+
+            coordinator->on_change();
+
+            r2->begin_transaction();
+            r2_table->set_int(0, 1, 0);
+            r2->commit_transaction();
+
+            REQUIRE(notification_calls == 1);
+            coordinator->on_change();
+            r->notify();
+            REQUIRE(notification_calls == 2);
+        }
+
+        SECTION("inserting a row then modifying it in a second transaction does not report it as modified") {
+            r2->begin_transaction();
+            size_t ndx = r2_table->add_empty_row();
+            r2_table->set_int(0, ndx, 6);
+            r2->commit_transaction();
+
+            coordinator->on_change();
+
+            r2->begin_transaction();
+            r2_table->set_int(0, ndx, 7);
+            r2->commit_transaction();
+
+            advance_and_notify(*r);
+
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 4);
+            REQUIRE(change.modifications.empty());
+            REQUIRE(change.modifications_new.empty());
+        }
+
+        SECTION("modification indices are pre-insert/delete") {
+            r->begin_transaction();
+            table->set_int(0, 2, 0);
+            table->set_int(0, 3, 6);
+            r->commit_transaction();
+            advance_and_notify(*r);
+
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+            REQUIRE_INDICES(change.modifications, 2);
+            REQUIRE_INDICES(change.modifications_new, 1);
+        }
+
+        SECTION("notifications are not delivered when collapsing transactions results in no net change") {
+            r2->begin_transaction();
+            size_t ndx = r2_table->add_empty_row();
+            r2_table->set_int(0, ndx, 5);
+            r2->commit_transaction();
+
+            coordinator->on_change();
+
+            r2->begin_transaction();
+            r2_table->move_last_over(ndx);
+            r2->commit_transaction();
+
+            REQUIRE(notification_calls == 1);
+            coordinator->on_change();
+            r->notify();
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("inserting a non-matching row at the beginning does not produce a notification") {
+            write([&] {
+                table->insert_empty_row(1);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("inserting a matching row at the beginning marks just it as inserted") {
+            write([&] {
+                table->insert_empty_row(0);
+                table->set_int(0, 0, 5);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 0);
+        }
+    }
+
+    SECTION("before/after change callback") {
+        struct Callback {
+            size_t before_calls = 0;
+            size_t after_calls = 0;
+            CollectionChangeSet before_change;
+            CollectionChangeSet after_change;
+            std::function<void(void)> on_before = []{};
+            std::function<void(void)> on_after = []{};
+
+            void before(CollectionChangeSet c) {
+                before_change = c;
+                ++before_calls;
+                on_before();
+            }
+            void after(CollectionChangeSet c) {
+                after_change = c;
+                ++after_calls;
+                on_after();
+            }
+            void error(std::exception_ptr) {
+                FAIL("error() should not be called");
+            }
+        } callback;
+        auto token = results.add_notification_callback(&callback);
+        advance_and_notify(*r);
+
+        SECTION("only after() is called for initial results") {
+            REQUIRE(callback.before_calls == 0);
+            REQUIRE(callback.after_calls == 1);
+            REQUIRE(callback.after_change.empty());
+        }
+
+        auto write = [&](auto&& func) {
+            r2->begin_transaction();
+            func(*r2_table);
+            r2->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        SECTION("both are called after a write") {
+            write([&](auto&& t) {
+                t.set_int(0, t.add_empty_row(), 5);
+            });
+            REQUIRE(callback.before_calls == 1);
+            REQUIRE(callback.after_calls == 2);
+            REQUIRE_INDICES(callback.before_change.insertions, 4);
+            REQUIRE_INDICES(callback.after_change.insertions, 4);
+        }
+
+        SECTION("deleted objects are usable in before()") {
+            callback.on_before = [&] {
+                REQUIRE(results.size() == 4);
+                REQUIRE_INDICES(callback.before_change.deletions, 0);
+                REQUIRE(results.get(0).is_attached());
+                REQUIRE(results.get(0).get_int(0) == 2);
+            };
+            write([&](auto&& t) {
+                t.move_last_over(results.get(0).get_index());
+            });
+            REQUIRE(callback.before_calls == 1);
+            REQUIRE(callback.after_calls == 2);
+        }
+
+        SECTION("inserted objects are usable in after()") {
+            callback.on_after = [&] {
+                REQUIRE(results.size() == 5);
+                REQUIRE_INDICES(callback.after_change.insertions, 4);
+                REQUIRE(results.last()->get_int(0) == 5);
+            };
+            write([&](auto&& t) {
+                t.set_int(0, t.add_empty_row(), 5);
+            });
+            REQUIRE(callback.before_calls == 1);
+            REQUIRE(callback.after_calls == 2);
+        }
+    }
+
+    SECTION("sorted notifications") {
+        // Sort in descending order
+        results = results.sort({*table, {{0}}, {false}});
+
+        int notification_calls = 0;
+        CollectionChangeSet change;
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+            ++notification_calls;
+        });
+
+        advance_and_notify(*r);
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        SECTION("swapping rows does not send notifications") {
+            write([&] {
+                table->swap_rows(2, 3);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
+            write([&] {
+                table->set_int(0, 6, 13);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("deleting non-matching rows does not send a notification") {
+            write([&] {
+                table->move_last_over(0);
+                table->move_last_over(6);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
+            write([&] {
+                table->set_int(0, 1, 3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.modifications, 3);
+            REQUIRE_INDICES(change.modifications_new, 3);
+        }
+
+        SECTION("swapping leaves modified rows marked as modified") {
+            write([&] {
+                table->set_int(0, 1, 3);
+                table->swap_rows(1, 2);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.modifications, 3);
+            REQUIRE_INDICES(change.modifications_new, 3);
+
+            write([&] {
+                table->swap_rows(3, 1);
+                table->set_int(0, 1, 7);
+            });
+            REQUIRE(notification_calls == 3);
+            REQUIRE_INDICES(change.modifications, 1);
+            REQUIRE_INDICES(change.modifications_new, 1);
+        }
+
+        SECTION("modifying a matching row to no longer match marks that row as deleted") {
+            write([&] {
+                table->set_int(0, 2, 0);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 2);
+        }
+
+        SECTION("modifying a non-matching row to match marks that row as inserted") {
+            write([&] {
+                table->set_int(0, 7, 3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 3);
+        }
+
+        SECTION("deleting a matching row marks that row as deleted") {
+            write([&] {
+                table->move_last_over(3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+        }
+
+        SECTION("moving a matching row via deletion does not send a notification") {
+            write([&] {
+                table->where().greater_equal(0, 10).find_all().clear(RemoveMode::unordered);
+                table->move_last_over(0);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifying a matching row to change its position sends insert+delete") {
+            write([&] {
+                table->set_int(0, 2, 9);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 2);
+            REQUIRE_INDICES(change.insertions, 0);
+        }
+
+        SECTION("modifications from multiple transactions are collapsed") {
+            r2->begin_transaction();
+            r2_table->set_int(0, 0, 5);
+            r2->commit_transaction();
+
+            r2->begin_transaction();
+            r2_table->set_int(0, 1, 0);
+            r2->commit_transaction();
+
+            REQUIRE(notification_calls == 1);
+            advance_and_notify(*r);
+            REQUIRE(notification_calls == 2);
+        }
+
+        SECTION("moving a matching row by deleting all other rows") {
+            r->begin_transaction();
+            table->clear();
+            table->add_empty_row(2);
+            table->set_int(0, 0, 15);
+            table->set_int(0, 1, 5);
+            r->commit_transaction();
+            advance_and_notify(*r);
+
+            write([&] {
+                table->move_last_over(0);
+                table->add_empty_row();
+                table->set_int(0, 1, 3);
+            });
+
+            REQUIRE(notification_calls == 3);
+            REQUIRE(change.deletions.empty());
+            REQUIRE_INDICES(change.insertions, 1);
+        }
+    }
+
+    SECTION("distinct notifications") {
+        results = results.distinct(SortDescriptor(*table, {{0}}));
+
+        int notification_calls = 0;
+        CollectionChangeSet change;
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+            ++notification_calls;
+        });
+
+        advance_and_notify(*r);
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        SECTION("modifications that leave a non-matching row non-matching do not send notifications") {
+            write([&] {
+                table->set_int(0, 6, 13);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("deleting non-matching rows does not send a notification") {
+            write([&] {
+                table->move_last_over(0);
+                table->move_last_over(6);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifying a matching row and leaving it matching marks that row as modified") {
+            write([&] {
+                table->set_int(0, 1, 3);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.modifications, 0);
+            REQUIRE_INDICES(change.modifications_new, 0);
+        }
+
+        SECTION("modifying a non-matching row which is after the distinct results in the table to be a same value \
+                in the distinct results doesn't send notification.") {
+            write([&] {
+                table->set_int(0, 6, 2);
+            });
+            REQUIRE(notification_calls == 1);
+        }
+
+        SECTION("modifying a non-matching row which is before the distinct results in the table to be a same value \
+                in the distinct results send insert + delete.") {
+            write([&] {
+                table->set_int(0, 0, 2);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 0);
+            REQUIRE_INDICES(change.insertions, 0);
+        }
+
+        SECTION("modifying a matching row to duplicated value in distinct results marks that row as deleted") {
+            write([&] {
+                table->set_int(0, 2, 2);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.deletions, 1);
+        }
+
+        SECTION("modifying a non-matching row to match and different value marks that row as inserted") {
+            write([&] {
+                table->set_int(0, 0, 1);
+            });
+            REQUIRE(notification_calls == 2);
+            REQUIRE_INDICES(change.insertions, 0);
+        }
+    }
+
+    SECTION("schema changes") {
+        CollectionChangeSet change;
+        auto token = results.add_notification_callback([&](CollectionChangeSet c, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+            change = c;
+        });
+        advance_and_notify(*r);
+
+        auto write = [&](auto&& f) {
+            r->begin_transaction();
+            f();
+            r->commit_transaction();
+            advance_and_notify(*r);
+        };
+
+        SECTION("insert table before observed table") {
+            write([&] {
+                size_t row = table->add_empty_row();
+                table->set_int(0, row, 5);
+                r->read_group().insert_table(0, "new table");
+                table->insert_empty_row(0);
+                table->set_int(0, 0, 5);
+            });
+            REQUIRE_INDICES(change.insertions, 0, 5);
+        }
+
+        auto linked_table = table->get_link_target(1);
+        SECTION("insert new column before link column") {
+            write([&] {
+                linked_table->set_int(0, 1, 5);
+                table->insert_column(0, type_Int, "new col");
+                linked_table->set_int(0, 2, 5);
+            });
+            REQUIRE_INDICES(change.modifications, 0, 1);
+        }
+
+        SECTION("insert table before link target") {
+            write([&] {
+                linked_table->set_int(0, 1, 5);
+                r->read_group().insert_table(0, "new table");
+                linked_table->set_int(0, 2, 5);
+            });
+            REQUIRE_INDICES(change.modifications, 0, 1);
+        }
+    }
+}
+
+TEST_CASE("results: notifications after move") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    auto results = std::make_unique<Results>(r, *table);
+
+    int notification_calls = 0;
+    auto token = results->add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+        REQUIRE_FALSE(err);
+        ++notification_calls;
+    });
+
+    advance_and_notify(*r);
+
+    auto write = [&](auto&& f) {
+        r->begin_transaction();
+        f();
+        r->commit_transaction();
+        advance_and_notify(*r);
+    };
+
+    SECTION("notifications continue to work after Results is moved (move-constructor)") {
+        Results r(std::move(*results));
+        results.reset();
+
+        write([&] {
+            table->set_int(0, table->add_empty_row(), 1);
+        });
+        REQUIRE(notification_calls == 2);
+    }
+
+    SECTION("notifications continue to work after Results is moved (move-assignment)") {
+        Results r;
+        r = std::move(*results);
+        results.reset();
+
+        write([&] {
+            table->set_int(0, table->add_empty_row(), 1);
+        });
+        REQUIRE(notification_calls == 2);
+    }
+}
+
+TEST_CASE("results: notifier with no callbacks") {
+    _impl::RealmCoordinator::assert_no_open_realms();
+
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto coordinator = _impl::RealmCoordinator::get_coordinator(config.path);
+    auto r = coordinator->get_realm(std::move(config));
+    r->update_schema({
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+    Results results(r, table->where());
+    results.last(); // force evaluation and creation of TableView
+
+    SECTION("refresh() does not block due to implicit notifier") {
+        // Create and then immediately remove a callback because
+        // `automatic_change_notifications = false` makes Results not implicitly
+        // create a notifier
+        results.add_notification_callback([](CollectionChangeSet const&, std::exception_ptr) {});
+
+        auto r2 = coordinator->get_realm();
+        r2->begin_transaction();
+        r2->read_group().get_table("class_object")->add_empty_row();
+        r2->commit_transaction();
+
+        r->refresh(); // would deadlock if there was a callback
+    }
+
+    SECTION("refresh() does not attempt to deliver stale results") {
+        results.add_notification_callback([](CollectionChangeSet const&, std::exception_ptr) {});
+
+        // Create version 1
+        r->begin_transaction();
+        table->add_empty_row();
+        r->commit_transaction();
+
+        r->begin_transaction();
+        // Run async query for version 1
+        coordinator->on_change();
+        // Create version 2 without ever letting 1 be delivered
+        table->add_empty_row();
+        r->commit_transaction();
+
+        // Give it a chance to deliver the async query results (and fail, becuse
+        // they're for version 1 and the realm is at 2)
+        r->refresh();
+    }
+
+    SECTION("should not pin the source version even after the Realm has been closed") {
+        auto r2 = coordinator->get_realm();
+        REQUIRE(r != r2);
+        r->close();
+
+        auto& shared_group = TestHelper::get_shared_group(r2);
+        // There's always at least 2 live versions because the previous version
+        // isn't clean up until the *next* commit
+        REQUIRE(shared_group.get_number_of_versions() == 2);
+
+        auto table = r2->read_group().get_table("class_object");
+
+        r2->begin_transaction();
+        table->add_empty_row();
+        r2->commit_transaction();
+        r2->begin_transaction();
+        table->add_empty_row();
+        r2->commit_transaction();
+
+        // Would now be 3 if the closed Realm is still pinning the version it was at
+        REQUIRE(shared_group.get_number_of_versions() == 2);
+    }
+}
+
+TEST_CASE("results: error messages") {
+    InMemoryTestFile config;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::String},
+        }},
+    };
+
+    auto r = Realm::get_shared_realm(config);
+    auto table = r->read_group().get_table("class_object");
+    Results results(r, *table);
+
+    r->begin_transaction();
+    table->add_empty_row();
+    r->commit_transaction();
+
+    SECTION("out of bounds access") {
+        REQUIRE_THROWS_WITH(results.get(5), "Requested index 5 greater than max 0");
+    }
+
+    SECTION("unsupported aggregate operation") {
+        REQUIRE_THROWS_WITH(results.sum(0), "Cannot sum property 'value': operation not supported for 'string' properties");
+    }
+}
+
+TEST_CASE("results: snapshots") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"array", PropertyType::Array|PropertyType::Object, "linked to object"}
+        }},
+        {"linked to object", {
+            {"value", PropertyType::Int}
+        }}
+    };
+
+    auto r = Realm::get_shared_realm(config);
+
+    auto write = [&](auto&& f) {
+        r->begin_transaction();
+        f();
+        r->commit_transaction();
+        advance_and_notify(*r);
+    };
+
+    SECTION("snapshot of empty Results") {
+        Results results;
+        auto snapshot = results.snapshot();
+        REQUIRE(snapshot.size() == 0);
+    }
+
+    SECTION("snapshot of Results based on Table") {
+        auto table = r->read_group().get_table("class_object");
+        Results results(r, *table);
+
+        {
+            // A newly-added row should not appear in the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 0);
+            write([=]{
+                table->add_empty_row();
+            });
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        {
+            // Removing a row present in the snapshot should not affect the size of the snapshot,
+            // but will result in the snapshot returning a detached row accessor.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 1);
+            write([=]{
+                table->move_last_over(0);
+            });
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+
+            // Adding a row at the same index that was formerly present in the snapshot shouldn't
+            // affect the state of the snapshot.
+            write([=]{
+                table->add_empty_row();
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+        }
+    }
+
+    SECTION("snapshot of Results based on LinkView") {
+        auto object = r->read_group().get_table("class_object");
+        auto linked_to = r->read_group().get_table("class_linked to object");
+
+        write([=]{
+            object->add_empty_row();
+        });
+
+        LinkViewRef lv = object->get_linklist(1, 0);
+        Results results(r, lv);
+
+        {
+            // A newly-added row should not appear in the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 0);
+            write([=]{
+                lv->add(linked_to->add_empty_row());
+            });
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        {
+            // Removing a row from the link list should not affect the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 1);
+            write([=]{
+                lv->remove(0);
+            });
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(snapshot.get(0).is_attached());
+
+            // Removing a row present in the snapshot from its table should result in the snapshot
+            // returning a detached row accessor.
+            write([=]{
+                linked_to->remove(0);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+
+            // Adding a new row to the link list shouldn't affect the state of the snapshot.
+            write([=]{
+                lv->add(linked_to->add_empty_row());
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+        }
+    }
+
+    SECTION("snapshot of Results based on Query") {
+        auto table = r->read_group().get_table("class_object");
+        Query q = table->column<Int>(0) > 0;
+        Results results(r, std::move(q));
+
+        {
+            // A newly-added row should not appear in the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 0);
+            write([=]{
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        {
+            // Updating a row to no longer match the query criteria should not affect the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 1);
+            write([=]{
+                table->set_int(0, 0, 0);
+            });
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(snapshot.get(0).is_attached());
+
+            // Removing a row present in the snapshot from its table should result in the snapshot
+            // returning a detached row accessor.
+            write([=]{
+                table->remove(0);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+
+            // Adding a new row that matches the query criteria shouldn't affect the state of the snapshot.
+            write([=]{
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+        }
+    }
+
+    SECTION("snapshots sharing rows with their source are unaffected by it being rerun") {
+        auto table = r->read_group().get_table("class_object");
+        write([=] {
+            table->add_empty_row(4);
+            for (size_t i = 0; i < 4; ++i)
+                table->set_int(0, i, i + 1);
+        });
+
+        Results results(r, table->column<Int>(0) > 1);
+        REQUIRE(results.size() == 3);
+        auto snapshot = results.snapshot();
+        auto snapshot2 = results.snapshot();
+        Results copy = results;
+
+        write([=] {
+            table->set_int(0, 0, 5);
+            table->set_int(0, 3, 0);
+        });
+        REQUIRE(results.size() == 3);
+        REQUIRE(copy.size() == 3);
+        REQUIRE(results.get(0).get_index() == 0);
+        REQUIRE(snapshot.size() == 3);
+        REQUIRE(snapshot.get(2).get_index() == 3);
+
+        write([&] {
+            results.clear();
+        });
+        REQUIRE(results.size() == 0);
+        REQUIRE(copy.size() == 0);
+        REQUIRE(snapshot.size() == 3);
+        REQUIRE(snapshot2.size() == 3);
+        REQUIRE(!snapshot.get(0).is_attached());
+        REQUIRE(snapshot.get(2).is_attached());
+    }
+
+    SECTION("snapshot of Results based on TableView from query") {
+        auto table = r->read_group().get_table("class_object");
+        Query q = table->column<Int>(0) > 0;
+        Results results(r, q.find_all());
+
+        {
+            // A newly-added row should not appear in the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 0);
+            write([=]{
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        {
+            // Updating a row to no longer match the query criteria should not affect the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 1);
+            write([=]{
+                table->set_int(0, 0, 0);
+            });
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(snapshot.get(0).is_attached());
+
+            // Removing a row present in the snapshot from its table should result in the snapshot
+            // returning a detached row accessor.
+            write([=]{
+                table->remove(0);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+
+            // Adding a new row that matches the query criteria shouldn't affect the state of the snapshot.
+            write([=]{
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+        }
+    }
+
+    SECTION("snapshot of Results based on TableView from backlinks") {
+        auto object = r->read_group().get_table("class_object");
+        auto linked_to = r->read_group().get_table("class_linked to object");
+
+        write([=]{
+            linked_to->add_empty_row();
+        });
+
+        TableView backlinks = linked_to->get_backlink_view(0, object.get(), 1);
+        Results results(r, std::move(backlinks));
+
+        auto lv = object->get_linklist(1, object->add_empty_row());
+
+        {
+            // A newly-added row should not appear in the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 0);
+            write([=]{
+                lv->add(0);
+            });
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        {
+            // Removing the link should not affect the snapshot.
+            auto snapshot = results.snapshot();
+            REQUIRE(results.size() == 1);
+            REQUIRE(snapshot.size() == 1);
+            write([=]{
+                lv->remove(0);
+            });
+            REQUIRE(results.size() == 0);
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(snapshot.get(0).is_attached());
+
+            // Removing a row present in the snapshot from its table should result in the snapshot
+            // returning a detached row accessor.
+            write([=]{
+                object->remove(0);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+
+            // Adding a new link shouldn't affect the state of the snapshot.
+            write([=]{
+                object->add_empty_row();
+                auto lv = object->get_linklist(1, object->add_empty_row());
+                lv->add(0);
+            });
+            REQUIRE(snapshot.size() == 1);
+            REQUIRE(!snapshot.get(0).is_attached());
+        }
+    }
+
+    SECTION("snapshot of Results with notification callback registered") {
+        auto table = r->read_group().get_table("class_object");
+        Query q = table->column<Int>(0) > 0;
+        Results results(r, q.find_all());
+
+        auto token = results.add_notification_callback([&](CollectionChangeSet, std::exception_ptr err) {
+            REQUIRE_FALSE(err);
+        });
+        advance_and_notify(*r);
+
+        SECTION("snapshot of lvalue") {
+            auto snapshot = results.snapshot();
+            write([=] {
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(snapshot.size() == 0);
+        }
+
+        SECTION("snapshot of rvalue") {
+            auto snapshot = std::move(results).snapshot();
+            write([=] {
+                table->set_int(0, table->add_empty_row(), 1);
+            });
+            REQUIRE(snapshot.size() == 0);
+        }
+    }
+
+    SECTION("adding notification callback to snapshot throws") {
+        auto table = r->read_group().get_table("class_object");
+        Query q = table->column<Int>(0) > 0;
+        Results results(r, q.find_all());
+        auto snapshot = results.snapshot();
+        CHECK_THROWS(snapshot.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {}));
+    }
+
+    SECTION("accessors should return none for detached row") {
+        auto table = r->read_group().get_table("class_object");
+        write([=] {
+            table->add_empty_row();
+        });
+        Results results(r, *table);
+        auto snapshot = results.snapshot();
+        write([=] {;
+            table->clear();
+        });
+
+        REQUIRE_FALSE(snapshot.get(0).is_attached());
+        REQUIRE_FALSE(snapshot.first()->is_attached());
+        REQUIRE_FALSE(snapshot.last()->is_attached());
+    }
+}
+
+TEST_CASE("results: distinct") {
+    const int N = 10;
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"num1", PropertyType::Int},
+            {"string", PropertyType::String},
+            {"num2", PropertyType::Int},
+            {"num3", PropertyType::Int}
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+
+    r->begin_transaction();
+    table->add_empty_row(N);
+    for (int i = 0; i < N; ++i) {
+        table->set_int(0, i, i % 3);
+        table->set_string(1, i, util::format("Foo_%1", i % 3).c_str());
+        table->set_int(2, i, N - i);
+        table->set_int(3, i, i % 2);
+    }
+    // table:
+    //   0, Foo_0, 10,  0
+    //   1, Foo_1,  9,  1
+    //   2, Foo_2,  8,  0
+    //   0, Foo_0,  7,  1
+    //   1, Foo_1,  6,  0
+    //   2, Foo_2,  5,  1
+    //   0, Foo_0,  4,  0
+    //   1, Foo_1,  3,  1
+    //   2, Foo_2,  2,  0
+    //   0, Foo_0,  1,  1
+
+    r->commit_transaction();
+    Results results(r, table->where());
+
+    SECTION("Single integer property") {
+        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        // unique:
+        //  0, Foo_0, 10
+        //  1, Foo_1,  9
+        //  2, Foo_2,  8
+        REQUIRE(unique.size() == 3);
+        REQUIRE(unique.get(0).get_int(2) == 10);
+        REQUIRE(unique.get(1).get_int(2) == 9);
+        REQUIRE(unique.get(2).get_int(2) == 8);
+    }
+
+    SECTION("Single integer via apply_ordering") {
+        DescriptorOrdering ordering;
+        ordering.append_sort(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        ordering.append_distinct(DistinctDescriptor(results.get_tableview().get_parent(), {{0}}));
+        Results unique = results.apply_ordering(std::move(ordering));
+        // unique:
+        //  0, Foo_0, 10
+        //  1, Foo_1,  9
+        //  2, Foo_2,  8
+        REQUIRE(unique.size() == 3);
+        REQUIRE(unique.get(0).get_int(2) == 10);
+        REQUIRE(unique.get(1).get_int(2) == 9);
+        REQUIRE(unique.get(2).get_int(2) == 8);
+    }
 
     SECTION("Single string property") {
         Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{1}}));
@@ -2408,286 +4287,676 @@ TEST_CASE("results: distinct") {
         REQUIRE(unique.get(2).get_int(2) == 8);
     }
 
-    SECTION("Two integer properties combined") {
-        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}, {2}}));
-        // unique is the same as the table
-        REQUIRE(unique.size() == N);
-        for (int i = 0; i < N; ++i) {
-            REQUIRE(unique.get(i).get_string(1) == StringData(util::format("Foo_%1", i % 3).c_str()));
+    SECTION("Two integer properties combined") {
+        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}, {2}}));
+        // unique is the same as the table
+        REQUIRE(unique.size() == N);
+        for (int i = 0; i < N; ++i) {
+            REQUIRE(unique.get(i).get_string(1) == StringData(util::format("Foo_%1", i % 3).c_str()));
+        }
+    }
+
+    SECTION("String and integer combined") {
+        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{2}, {1}}));
+        // unique is the same as the table
+        REQUIRE(unique.size() == N);
+        for (int i = 0; i < N; ++i) {
+            REQUIRE(unique.get(i).get_string(1) == StringData(util::format("Foo_%1", i % 3).c_str()));
+        }
+    }
+
+    // This section and next section demonstrate that sort().distinct() != distinct().sort()
+    SECTION("Order after sort and distinct") {
+        Results reverse = results.sort(SortDescriptor(results.get_tableview().get_parent(), {{2}}, {true}));
+        // reverse:
+        //   0, Foo_0,  1
+        //  ...
+        //   0, Foo_0, 10
+        REQUIRE(reverse.first()->get_int(2) == 1);
+        REQUIRE(reverse.last()->get_int(2) == 10);
+
+        // distinct() will be applied to the table, after sorting
+        Results unique = reverse.distinct(SortDescriptor(reverse.get_tableview().get_parent(), {{0}}));
+        // unique:
+        //  0, Foo_0,  1
+        //  2, Foo_2,  2
+        //  1, Foo_1,  3
+        REQUIRE(unique.size() == 3);
+        REQUIRE(unique.get(0).get_int(2) == 1);
+        REQUIRE(unique.get(1).get_int(2) == 2);
+        REQUIRE(unique.get(2).get_int(2) == 3);
+    }
+
+    SECTION("Order after distinct and sort") {
+        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        // unique:
+        //  0, Foo_0, 10
+        //  1, Foo_1,  9
+        //  2, Foo_2,  8
+        REQUIRE(unique.size() == 3);
+        REQUIRE(unique.first()->get_int(2) == 10);
+        REQUIRE(unique.last()->get_int(2) == 8);
+
+        // sort() is only applied to unique
+        Results reverse = unique.sort(SortDescriptor(unique.get_tableview().get_parent(), {{2}}, {true}));
+        // reversed:
+        //  2, Foo_2,  8
+        //  1, Foo_1,  9
+        //  0, Foo_0, 10
+        REQUIRE(reverse.size() == 3);
+        REQUIRE(reverse.get(0).get_int(2) == 8);
+        REQUIRE(reverse.get(1).get_int(2) == 9);
+        REQUIRE(reverse.get(2).get_int(2) == 10);
+    }
+
+    SECTION("Chaining distinct") {
+        Results first = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        REQUIRE(first.size() == 3);
+
+        // distinct() will not discard the previous applied distinct() calls
+        Results second = first.distinct(SortDescriptor(first.get_tableview().get_parent(), {{3}}));
+        REQUIRE(second.size() == 2);
+    }
+
+    SECTION("Chaining sort") {
+        using cols_0_3 = std::pair<size_t, size_t>;
+        Results first = results.sort(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        Results second = first.sort(SortDescriptor(first.get_tableview().get_parent(), {{3}}));
+
+        REQUIRE(second.size() == 10);
+        // results are ordered first by the last sorted column
+        // if any duplicates exist in that column, they are resolved by sorting the
+        // previously sorted column. Eg. sort(a).sort(b) == sort(b, a)
+        std::vector<cols_0_3> results
+            = {{0, 0}, {0, 0}, {1, 0}, {2, 0}, {2, 0}, {0, 1}, {0, 1}, {1, 1}, {1, 1}, {2, 1}};
+        for (size_t i = 0; i < results.size(); ++i) {
+            REQUIRE(second.get(i).get_int(0) == results[i].first);
+            REQUIRE(second.get(i).get_int(3) == results[i].second);
+        }
+    }
+
+    SECTION("Distinct is carried over to new queries") {
+        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
+        // unique:
+        //  0, Foo_0, 10
+        //  1, Foo_1,  9
+        //  2, Foo_2,  8
+        REQUIRE(unique.size() == 3);
+
+        Results filtered = unique.filter(Query(table->where().less(0, 2)));
+        // filtered:
+        //  0, Foo_0, 10
+        //  1, Foo_1,  9
+        REQUIRE(filtered.size() == 2);
+        REQUIRE(filtered.get(0).get_int(2) == 10);
+        REQUIRE(filtered.get(1).get_int(2) == 9);
+    }
+
+    SECTION("Distinct will not forget previous query") {
+        Results filtered = results.filter(Query(table->where().greater(2, 5)));
+        // filtered:
+        //   0, Foo_0, 10
+        //   1, Foo_1,  9
+        //   2, Foo_2,  8
+        //   0, Foo_0,  7
+        //   1, Foo_1,  6
+        REQUIRE(filtered.size() == 5);
+
+        Results unique = filtered.distinct(SortDescriptor(filtered.get_tableview().get_parent(), {{0}}));
+        // unique:
+        //   0, Foo_0, 10
+        //   1, Foo_1,  9
+        //   2, Foo_2,  8
+        REQUIRE(unique.size() == 3);
+        REQUIRE(unique.get(0).get_int(2) == 10);
+        REQUIRE(unique.get(1).get_int(2) == 9);
+        REQUIRE(unique.get(2).get_int(2) == 8);
+
+        Results further_filtered = unique.filter(Query(table->where().equal(2, 9)));
+        // further_filtered:
+        //   1, Foo_1,  9
+        REQUIRE(further_filtered.size() == 1);
+        REQUIRE(further_filtered.get(0).get_int(2) == 9);
+    }
+}
+
+TEST_CASE("results: sort") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"bool", PropertyType::Bool},
+            {"data prop", PropertyType::Data},
+            {"link", PropertyType::Object|PropertyType::Nullable, "object 2"},
+            {"array", PropertyType::Object|PropertyType::Array, "object 2"},
+        }},
+        {"object 2", {
+            {"value", PropertyType::Int},
+            {"link", PropertyType::Object|PropertyType::Nullable, "object"},
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+    auto table2 = realm->read_group().get_table("class_object 2");
+    Results r(realm, *table);
+
+    SECTION("invalid keypaths") {
+        SECTION("empty property name") {
+            REQUIRE_THROWS_WITH(r.sort({{"", true}}), "Cannot sort on key path '': missing property name.");
+            REQUIRE_THROWS_WITH(r.sort({{".", true}}), "Cannot sort on key path '.': missing property name.");
+            REQUIRE_THROWS_WITH(r.sort({{"link.", true}}), "Cannot sort on key path 'link.': missing property name.");
+            REQUIRE_THROWS_WITH(r.sort({{".value", true}}), "Cannot sort on key path '.value': missing property name.");
+            REQUIRE_THROWS_WITH(r.sort({{"link..value", true}}), "Cannot sort on key path 'link..value': missing property name.");
+        }
+        SECTION("bad property name") {
+            REQUIRE_THROWS_WITH(r.sort({{"not a property", true}}),
+                                "Cannot sort on key path 'not a property': property 'object.not a property' does not exist.");
+            REQUIRE_THROWS_WITH(r.sort({{"link.not a property", true}}),
+                                "Cannot sort on key path 'link.not a property': property 'object 2.not a property' does not exist.");
+        }
+        SECTION("subscript primitive") {
+            REQUIRE_THROWS_WITH(r.sort({{"value.link", true}}),
+                                "Cannot sort on key path 'value.link': property 'object.value' of type 'int' may only be the final property in the key path.");
+        }
+        SECTION("end in link") {
+            REQUIRE_THROWS_WITH(r.sort({{"link", true}}),
+                                "Cannot sort on key path 'link': property 'object.link' of type 'object' cannot be the final property in the key path.");
+            REQUIRE_THROWS_WITH(r.sort({{"link.link", true}}),
+                                "Cannot sort on key path 'link.link': property 'object 2.link' of type 'object' cannot be the final property in the key path.");
+        }
+        SECTION("sort involving bad property types") {
+            REQUIRE_THROWS_WITH(r.sort({{"array", true}}),
+                                "Cannot sort on key path 'array': property 'object.array' is of unsupported type 'array'.");
+            REQUIRE_THROWS_WITH(r.sort({{"array.value", true}}),
+                                "Cannot sort on key path 'array.value': property 'object.array' is of unsupported type 'array'.");
+            REQUIRE_THROWS_WITH(r.sort({{"link.link.array.value", true}}),
+                                "Cannot sort on key path 'link.link.array.value': property 'object.array' is of unsupported type 'array'.");
+            REQUIRE_THROWS_WITH(r.sort({{"data prop", true}}),
+                                "Cannot sort on key path 'data prop': property 'object.data prop' is of unsupported type 'data'.");
+        }
+    }
+
+    realm->begin_transaction();
+    table->add_empty_row(4);
+    table2->add_empty_row(4);
+    for (int i = 0; i < 4; ++i) {
+        table->set_int(0, i, (i + 2) % 4);
+        table->set_bool(1, i, i % 2);
+        table->set_link(3, i, 3 - i);
+
+        table2->set_int(0, i, (i + 1) % 4);
+        table2->set_link(1, i, i);
+    }
+    realm->commit_transaction();
+    /*
+     | index | value | bool | link.value | link.link.value |
+     |-------|-------|------|------------|-----------------|
+     | 0     | 2     | 0    | 0          | 1               |
+     | 1     | 3     | 1    | 3          | 0               |
+     | 2     | 0     | 0    | 2          | 3               |
+     | 3     | 1     | 1    | 1          | 2               |
+     */
+
+    #define REQUIRE_ORDER(sort, ...) do { \
+        std::vector<size_t> expected = {__VA_ARGS__}; \
+        auto results = sort; \
+        REQUIRE(results.size() == expected.size()); \
+        for (size_t i = 0; i < expected.size(); ++i) \
+            REQUIRE(results.get(i).get_index() == expected[i]); \
+    } while (0)
+
+    SECTION("sort on single property") {
+        REQUIRE_ORDER((r.sort({{"value", true}})),
+                      2, 3, 0, 1);
+        REQUIRE_ORDER((r.sort({{"value", false}})),
+                      1, 0, 3, 2);
+    }
+
+    SECTION("sort on two properties") {
+        REQUIRE_ORDER((r.sort({{"bool", true}, {"value", true}})),
+                      2, 0, 3, 1);
+        REQUIRE_ORDER((r.sort({{"bool", false}, {"value", true}})),
+                      3, 1, 2, 0);
+        REQUIRE_ORDER((r.sort({{"bool", true}, {"value", false}})),
+                      0, 2, 1, 3);
+        REQUIRE_ORDER((r.sort({{"bool", false}, {"value", false}})),
+                      1, 3, 0, 2);
+    }
+    SECTION("sort over link") {
+        REQUIRE_ORDER((r.sort({{"link.value", true}})),
+                      0, 3, 2, 1);
+        REQUIRE_ORDER((r.sort({{"link.value", false}})),
+                      1, 2, 3, 0);
+    }
+    SECTION("sort over two links") {
+        REQUIRE_ORDER((r.sort({{"link.link.value", true}})),
+                      1, 0, 3, 2);
+        REQUIRE_ORDER((r.sort({{"link.link.value", false}})),
+                      2, 3, 0, 1);
+    }
+    SECTION("key paths are resolved again after the column indices change") {
+        REQUIRE_ORDER((r.sort({{"value", true}})),
+                      2, 3, 0, 1);
+
+        auto realm2 = Realm::get_shared_realm(config);
+        realm2->begin_transaction();
+        realm2->read_group().get_table("class_object")->insert_column(0, type_Int, "new column");
+        realm2->commit_transaction();
+        realm->refresh();
+
+        REQUIRE_ORDER((r.sort({{"value", true}})),
+                      2, 3, 0, 1);
+        REQUIRE_ORDER((r.distinct({"bool"})),
+                      0, 1);
+    }
+}
+
+struct ResultsFromTable {
+    static Results call(std::shared_ptr<Realm> r, Table* table) {
+        return Results(std::move(r), *table);
+    }
+};
+struct ResultsFromQuery {
+    static Results call(std::shared_ptr<Realm> r, Table* table) {
+        return Results(std::move(r), table->where());
+    }
+};
+struct ResultsFromTableView {
+    static Results call(std::shared_ptr<Realm> r, Table* table) {
+        return Results(std::move(r), table->where().find_all());
+    }
+};
+struct ResultsFromLinkView {
+    static Results call(std::shared_ptr<Realm> r, Table* table) {
+        r->begin_transaction();
+        auto link_table = r->read_group().get_table("class_linking_object");
+        link_table->add_empty_row(1);
+        auto link_view = link_table->get_linklist(0, 0);
+        for (size_t i = 0; i < table->size(); ++i)
+            link_view->add(i);
+        r->commit_transaction();
+        return Results(r, link_view);
+    }
+};
+
+TEMPLATE_TEST_CASE("results: aggregate", ResultsFromTable, ResultsFromQuery, ResultsFromTableView, ResultsFromLinkView) {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"int", PropertyType::Int|PropertyType::Nullable},
+            {"float", PropertyType::Float|PropertyType::Nullable},
+            {"double", PropertyType::Double|PropertyType::Nullable},
+            {"date", PropertyType::Date|PropertyType::Nullable},
+        }},
+        {"linking_object", {
+            {"link", PropertyType::Array|PropertyType::Object, "object"}
+        }},
+    });
+
+    auto table = r->read_group().get_table("class_object");
+
+    SECTION("one row with null values") {
+        r->begin_transaction();
+        table->add_empty_row(3);
+
+        table->set_int(0, 1, 0);
+        table->set_float(1, 1, 0.f);
+        table->set_double(2, 1, 0.0);
+        table->set_timestamp(3, 1, Timestamp(0, 0));
+
+        table->set_int(0, 2, 2);
+        table->set_float(1, 2, 2.f);
+        table->set_double(2, 2, 2.0);
+        table->set_timestamp(3, 2, Timestamp(2, 0));
+        // table:
+        //  null, null, null,  null,
+        //  0,    0,    0,    (0, 0)
+        //  2,    2,    2,    (2, 0)
+        r->commit_transaction();
+
+        Results results = TestType::call(r, table.get());
+
+        SECTION("max") {
+            REQUIRE(results.max(0)->get_int() == 2);
+            REQUIRE(results.max(1)->get_float() == 2.f);
+            REQUIRE(results.max(2)->get_double() == 2.0);
+            REQUIRE(results.max(3)->get_timestamp() == Timestamp(2, 0));
+        }
+
+        SECTION("min") {
+            REQUIRE(results.min(0)->get_int() == 0);
+            REQUIRE(results.min(1)->get_float() == 0.f);
+            REQUIRE(results.min(2)->get_double() == 0.0);
+            REQUIRE(results.min(3)->get_timestamp() == Timestamp(0, 0));
+        }
+
+        SECTION("average") {
+            REQUIRE(results.average(0) == 1.0);
+            REQUIRE(results.average(1) == 1.0);
+            REQUIRE(results.average(2) == 1.0);
+            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
+        }
+
+        SECTION("sum") {
+            REQUIRE(results.sum(0)->get_int() == 2);
+            REQUIRE(results.sum(1)->get_double() == 2.0);
+            REQUIRE(results.sum(2)->get_double() == 2.0);
+            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
         }
     }
 
-    SECTION("String and integer combined") {
-        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{2}, {1}}));
-        // unique is the same as the table
-        REQUIRE(unique.size() == N);
-        for (int i = 0; i < N; ++i) {
-            REQUIRE(unique.get(i).get_string(1) == StringData(util::format("Foo_%1", i % 3).c_str()));
+    SECTION("rows with all null values") {
+        r->begin_transaction();
+        table->add_empty_row(3);
+        // table:
+        //  null, null, null,  null,  null
+        //  null, null, null,  null,  null
+        //  null, null, null,  null,  null
+        r->commit_transaction();
+
+        Results results = TestType::call(r, table.get());
+
+        SECTION("max") {
+            REQUIRE(!results.max(0));
+            REQUIRE(!results.max(1));
+            REQUIRE(!results.max(2));
+            REQUIRE(!results.max(3));
+        }
+
+        SECTION("min") {
+            REQUIRE(!results.min(0));
+            REQUIRE(!results.min(1));
+            REQUIRE(!results.min(2));
+            REQUIRE(!results.min(3));
+        }
+
+        SECTION("average") {
+            REQUIRE(!results.average(0));
+            REQUIRE(!results.average(1));
+            REQUIRE(!results.average(2));
+            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
+        }
+
+        SECTION("sum") {
+            REQUIRE(results.sum(0)->get_int() == 0);
+            REQUIRE(results.sum(1)->get_double() == 0.0);
+            REQUIRE(results.sum(2)->get_double() == 0.0);
+            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
         }
     }
 
-    // This section and next section demonstrate that sort().distinct() != distinct().sort()
-    SECTION("Order after sort and distinct") {
-        Results reverse = results.sort(SortDescriptor(results.get_tableview().get_parent(), {{2}}, {true}));
-        // reverse:
-        //   0, Foo_0,  1
-        //  ...
-        //   0, Foo_0, 10
-        REQUIRE(reverse.first()->get_int(2) == 1);
-        REQUIRE(reverse.last()->get_int(2) == 10);
+    SECTION("empty") {
+        Results results = TestType::call(r, table.get());
+
+        SECTION("max") {
+            REQUIRE(!results.max(0));
+            REQUIRE(!results.max(1));
+            REQUIRE(!results.max(2));
+            REQUIRE(!results.max(3));
+        }
+
+        SECTION("min") {
+            REQUIRE(!results.min(0));
+            REQUIRE(!results.min(1));
+            REQUIRE(!results.min(2));
+            REQUIRE(!results.min(3));
+        }
+
+        SECTION("average") {
+            REQUIRE(!results.average(0));
+            REQUIRE(!results.average(1));
+            REQUIRE(!results.average(2));
+            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
+        }
 
-        // distinct() will be applied to the table, after sorting
-        Results unique = reverse.distinct(SortDescriptor(reverse.get_tableview().get_parent(), {{0}}));
-        // unique:
-        //  0, Foo_0,  1
-        //  2, Foo_2,  2
-        //  1, Foo_1,  3
-        REQUIRE(unique.size() == 3);
-        REQUIRE(unique.get(0).get_int(2) == 1);
-        REQUIRE(unique.get(1).get_int(2) == 2);
-        REQUIRE(unique.get(2).get_int(2) == 3);
+        SECTION("sum") {
+            REQUIRE(results.sum(0)->get_int() == 0);
+            REQUIRE(results.sum(1)->get_double() == 0.0);
+            REQUIRE(results.sum(2)->get_double() == 0.0);
+            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
+        }
     }
+}
 
-    SECTION("Order after distinct and sort") {
-        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        // unique:
-        //  0, Foo_0, 10
-        //  1, Foo_1,  9
-        //  2, Foo_2,  8
-        REQUIRE(unique.size() == 3);
-        REQUIRE(unique.first()->get_int(2) == 10);
-        REQUIRE(unique.last()->get_int(2) == 8);
+TEST_CASE("results: get_sorted_row_indices") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.schema = Schema{
+        {"object", {
+            {"int", PropertyType::Int},
+            {"optional int", PropertyType::Int|PropertyType::Nullable},
+            {"bool", PropertyType::Bool},
+            {"double", PropertyType::Double|PropertyType::Nullable},
+            {"date", PropertyType::Date},
+            {"string", PropertyType::String},
+            {"link", PropertyType::Object|PropertyType::Nullable, "object"},
+        }},
+    };
 
-        // sort() is only applied to unique
-        Results reverse = unique.sort(SortDescriptor(unique.get_tableview().get_parent(), {{2}}, {true}));
-        // reversed:
-        //  2, Foo_2,  8
-        //  1, Foo_1,  9
-        //  0, Foo_0, 10
-        REQUIRE(reverse.size() == 3);
-        REQUIRE(reverse.get(0).get_int(2) == 8);
-        REQUIRE(reverse.get(1).get_int(2) == 9);
-        REQUIRE(reverse.get(2).get_int(2) == 10);
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+    realm->begin_transaction();
+    table->add_empty_row(1000);
+    for (int i = 0; i < 1000; ++i) {
+        table->set_int(0, i, i % 7);
+        if (i % 3)
+            table->set_int(1, i, (i * 13) % 5);
+        table->set_bool(2, i, i % 2);
+        if (i % 5)
+            table->set_double(3, i, (i % 11) / 2.0);
+        table->set_timestamp(4, i, Timestamp(i % 13, i % 3));
+        table->set_string(5, i, util::format("%1", i % 17));
+        table->set_link(6, i, (i * 7) % 1000);
     }
+    realm->commit_transaction();
 
-    SECTION("Chaining distinct") {
-        Results first = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        REQUIRE(first.size() == 3);
+    util::ThreadPool pool(3);
+    Results r(realm, table->where().greater(0, 0));
 
-        // distinct() will not discard the previous applied distinct() calls
-        Results second = first.distinct(SortDescriptor(first.get_tableview().get_parent(), {{3}}));
-        REQUIRE(second.size() == 2);
-    }
+    auto require_same_order = [&](std::vector<std::pair<std::string, bool>> keypaths) {
+        auto sorted = r.sort(keypaths);
+        std::vector<size_t> expected(sorted.size());
+        sorted.get_row_indices(0, expected.size(), expected.data());
+        REQUIRE(r.get_sorted_row_indices(keypaths, pool, 0) == expected);
+        REQUIRE(r.get_sorted_row_indices(keypaths, pool) == expected);
+    };
 
-    SECTION("Chaining sort") {
-        using cols_0_3 = std::pair<size_t, size_t>;
-        Results first = results.sort(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        Results second = first.sort(SortDescriptor(first.get_tableview().get_parent(), {{3}}));
+    SECTION("single column") {
+        require_same_order({{"int", true}});
+        require_same_order({{"int", false}});
+        require_same_order({{"bool", true}});
+        require_same_order({{"date", false}});
+    }
 
-        REQUIRE(second.size() == 10);
-        // results are ordered first by the last sorted column
-        // if any duplicates exist in that column, they are resolved by sorting the
-        // previously sorted column. Eg. sort(a).sort(b) == sort(b, a)
-        std::vector<cols_0_3> results
-            = {{0, 0}, {0, 0}, {1, 0}, {2, 0}, {2, 0}, {0, 1}, {0, 1}, {1, 1}, {1, 1}, {2, 1}};
-        for (size_t i = 0; i < results.size(); ++i) {
-            REQUIRE(second.get(i).get_int(0) == results[i].first);
-            REQUIRE(second.get(i).get_int(3) == results[i].second);
-        }
+    SECTION("nullable columns") {
+        require_same_order({{"optional int", true}});
+        require_same_order({{"optional int", false}});
+        require_same_order({{"double", true}});
+        require_same_order({{"double", false}});
     }
 
-    SECTION("Distinct is carried over to new queries") {
-        Results unique = results.distinct(SortDescriptor(results.get_tableview().get_parent(), {{0}}));
-        // unique:
-        //  0, Foo_0, 10
-        //  1, Foo_1,  9
-        //  2, Foo_2,  8
-        REQUIRE(unique.size() == 3);
+    SECTION("multiple columns") {
+        require_same_order({{"int", true}, {"bool", false}});
+        require_same_order({{"optional int", false}, {"date", true}, {"double", true}});
+    }
 
-        Results filtered = unique.filter(Query(table->where().less(0, 2)));
-        // filtered:
-        //  0, Foo_0, 10
-        //  1, Foo_1,  9
-        REQUIRE(filtered.size() == 2);
-        REQUIRE(filtered.get(0).get_int(2) == 10);
-        REQUIRE(filtered.get(1).get_int(2) == 9);
+    SECTION("applied after an existing sort") {
+        r = r.sort({{"date", false}});
+        require_same_order({{"int", true}});
     }
 
-    SECTION("Distinct will not forget previous query") {
-        Results filtered = results.filter(Query(table->where().greater(2, 5)));
-        // filtered:
-        //   0, Foo_0, 10
-        //   1, Foo_1,  9
-        //   2, Foo_2,  8
-        //   0, Foo_0,  7
-        //   1, Foo_1,  6
-        REQUIRE(filtered.size() == 5);
+    SECTION("keypaths which are sorted by core") {
+        require_same_order({{"string", true}});
+        require_same_order({{"link.int", false}, {"int", true}});
+    }
 
-        Results unique = filtered.distinct(SortDescriptor(filtered.get_tableview().get_parent(), {{0}}));
-        // unique:
-        //   0, Foo_0, 10
-        //   1, Foo_1,  9
-        //   2, Foo_2,  8
-        REQUIRE(unique.size() == 3);
-        REQUIRE(unique.get(0).get_int(2) == 10);
-        REQUIRE(unique.get(1).get_int(2) == 9);
-        REQUIRE(unique.get(2).get_int(2) == 8);
+    SECTION("floating point columns containing NaN") {
+        realm->begin_transaction();
+        table->set_double(3, 10, std::numeric_limits<double>::quiet_NaN());
+        realm->commit_transaction();
+        require_same_order({{"double", true}});
+    }
 
-        Results further_filtered = unique.filter(Query(table->where().equal(2, 9)));
-        // further_filtered:
-        //   1, Foo_1,  9
-        REQUIRE(further_filtered.size() == 1);
-        REQUIRE(further_filtered.get(0).get_int(2) == 9);
+    SECTION("invalid keypaths") {
+        REQUIRE_THROWS_WITH(r.get_sorted_row_indices({{"not a property", true}}, pool, 0),
+                            "Cannot sort on key path 'not a property': property 'object.not a property' does not exist.");
     }
 }
 
-TEST_CASE("results: sort") {
+TEST_CASE("results: get_distinct_row_indices") {
     InMemoryTestFile config;
     config.cache = false;
     config.schema = Schema{
         {"object", {
-            {"value", PropertyType::Int},
+            {"int", PropertyType::Int},
+            {"optional int", PropertyType::Int|PropertyType::Nullable},
             {"bool", PropertyType::Bool},
-            {"data prop", PropertyType::Data},
-            {"link", PropertyType::Object|PropertyType::Nullable, "object 2"},
-            {"array", PropertyType::Object|PropertyType::Array, "object 2"},
+            {"string", PropertyType::String|PropertyType::Nullable},
+            {"double", PropertyType::Double},
+            {"link", PropertyType::Object|PropertyType::Nullable, "target"},
         }},
-        {"object 2", {
+        {"target", {
             {"value", PropertyType::Int},
-            {"link", PropertyType::Object|PropertyType::Nullable, "object"},
+            {"next", PropertyType::Object|PropertyType::Nullable, "target"},
         }},
     };
 
     auto realm = Realm::get_shared_realm(config);
     auto table = realm->read_group().get_table("class_object");
-    auto table2 = realm->read_group().get_table("class_object 2");
-    Results r(realm, *table);
-
-    SECTION("invalid keypaths") {
-        SECTION("empty property name") {
-            REQUIRE_THROWS_WITH(r.sort({{"", true}}), "Cannot sort on key path '': missing property name.");
-            REQUIRE_THROWS_WITH(r.sort({{".", true}}), "Cannot sort on key path '.': missing property name.");
-            REQUIRE_THROWS_WITH(r.sort({{"link.", true}}), "Cannot sort on key path 'link.': missing property name.");
-            REQUIRE_THROWS_WITH(r.sort({{".value", true}}), "Cannot sort on key path '.value': missing property name.");
-            REQUIRE_THROWS_WITH(r.sort({{"link..value", true}}), "Cannot sort on key path 'link..value': missing property name.");
-        }
-        SECTION("bad property name") {
-            REQUIRE_THROWS_WITH(r.sort({{"not a property", true}}),
-                                "Cannot sort on key path 'not a property': property 'object.not a property' does not exist.");
-            REQUIRE_THROWS_WITH(r.sort({{"link.not a property", true}}),
-                                "Cannot sort on key path 'link.not a property': property 'object 2.not a property' does not exist.");
-        }
-        SECTION("subscript primitive") {
-            REQUIRE_THROWS_WITH(r.sort({{"value.link", true}}),
-                                "Cannot sort on key path 'value.link': property 'object.value' of type 'int' may only be the final property in the key path.");
-        }
-        SECTION("end in link") {
-            REQUIRE_THROWS_WITH(r.sort({{"link", true}}),
-                                "Cannot sort on key path 'link': property 'object.link' of type 'object' cannot be the final property in the key path.");
-            REQUIRE_THROWS_WITH(r.sort({{"link.link", true}}),
-                                "Cannot sort on key path 'link.link': property 'object 2.link' of type 'object' cannot be the final property in the key path.");
-        }
-        SECTION("sort involving bad property types") {
-            REQUIRE_THROWS_WITH(r.sort({{"array", true}}),
-                                "Cannot sort on key path 'array': property 'object.array' is of unsupported type 'array'.");
-            REQUIRE_THROWS_WITH(r.sort({{"array.value", true}}),
-                                "Cannot sort on key path 'array.value': property 'object.array' is of unsupported type 'array'.");
-            REQUIRE_THROWS_WITH(r.sort({{"link.link.array.value", true}}),
-                                "Cannot sort on key path 'link.link.array.value': property 'object.array' is of unsupported type 'array'.");
-            REQUIRE_THROWS_WITH(r.sort({{"data prop", true}}),
-                                "Cannot sort on key path 'data prop': property 'object.data prop' is of unsupported type 'data'.");
-        }
-    }
-
+    auto target = realm->read_group().get_table("class_target");
     realm->begin_transaction();
-    table->add_empty_row(4);
-    table2->add_empty_row(4);
-    for (int i = 0; i < 4; ++i) {
-        table->set_int(0, i, (i + 2) % 4);
-        table->set_bool(1, i, i % 2);
-        table->set_link(3, i, 3 - i);
-
-        table2->set_int(0, i, (i + 1) % 4);
-        table2->set_link(1, i, i);
+    target->add_empty_row(20);
+    for (int i = 0; i < 20; ++i) {
+        target->set_int(0, i, i % 4);
+        if (i % 3)
+            target->set_link(1, i, (i + 1) % 20);
+    }
+    table->add_empty_row(1000);
+    for (int i = 0; i < 1000; ++i) {
+        table->set_int(0, i, i % 7);
+        if (i % 3)
+            table->set_int(1, i, (i * 13) % 5);
+        table->set_bool(2, i, i % 2);
+        if (i % 4)
+            table->set_string(3, i, util::format("%1", i % 17));
+        else if (i % 8)
+            table->set_string(3, i, "");
+        table->set_double(4, i, i % 3);
+        if (i % 9)
+            table->set_link(5, i, (i * 7) % 20);
     }
     realm->commit_transaction();
-    /*
-     | index | value | bool | link.value | link.link.value |
-     |-------|-------|------|------------|-----------------|
-     | 0     | 2     | 0    | 0          | 1               |
-     | 1     | 3     | 1    | 3          | 0               |
-     | 2     | 0     | 0    | 2          | 3               |
-     | 3     | 1     | 1    | 1          | 2               |
-     */
 
-    #define REQUIRE_ORDER(sort, ...) do { \
-        std::vector<size_t> expected = {__VA_ARGS__}; \
-        auto results = sort; \
-        REQUIRE(results.size() == expected.size()); \
-        for (size_t i = 0; i < expected.size(); ++i) \
-            REQUIRE(results.get(i).get_index() == expected[i]); \
-    } while (0)
+    Results r(realm, table->where().greater(0, 0));
 
-    SECTION("sort on single property") {
-        REQUIRE_ORDER((r.sort({{"value", true}})),
-                      2, 3, 0, 1);
-        REQUIRE_ORDER((r.sort({{"value", false}})),
-                      1, 0, 3, 2);
+    auto require_same_rows = [&](std::vector<std::string> keypaths) {
+        auto unique = r.distinct(keypaths);
+        std::vector<size_t> expected(unique.size());
+        unique.get_row_indices(0, expected.size(), expected.data());
+        REQUIRE(r.get_distinct_row_indices(keypaths) == expected);
+    };
+
+    SECTION("single column") {
+        require_same_rows({"int"});
+        require_same_rows({"bool"});
+        require_same_rows({"string"});
+        require_same_rows({"link"});
     }
 
-    SECTION("sort on two properties") {
-        REQUIRE_ORDER((r.sort({{"bool", true}, {"value", true}})),
-                      2, 0, 3, 1);
-        REQUIRE_ORDER((r.sort({{"bool", false}, {"value", true}})),
-                      3, 1, 2, 0);
-        REQUIRE_ORDER((r.sort({{"bool", true}, {"value", false}})),
-                      0, 2, 1, 3);
-        REQUIRE_ORDER((r.sort({{"bool", false}, {"value", false}})),
-                      1, 3, 0, 2);
+    SECTION("nullable columns") {
+        require_same_rows({"optional int"});
+        require_same_rows({"string"});
     }
-    SECTION("sort over link") {
-        REQUIRE_ORDER((r.sort({{"link.value", true}})),
-                      0, 3, 2, 1);
-        REQUIRE_ORDER((r.sort({{"link.value", false}})),
-                      1, 2, 3, 0);
+
+    SECTION("multiple columns") {
+        require_same_rows({"int", "bool"});
+        require_same_rows({"optional int", "string", "link"});
     }
-    SECTION("sort over two links") {
-        REQUIRE_ORDER((r.sort({{"link.link.value", true}})),
-                      1, 0, 3, 2);
-        REQUIRE_ORDER((r.sort({{"link.link.value", false}})),
-                      2, 3, 0, 1);
+
+    SECTION("keypaths through links") {
+        require_same_rows({"link.value"});
+        require_same_rows({"link.next.value", "bool"});
+        require_same_rows({"link.next"});
     }
-}
 
-struct ResultsFromTable {
-    static Results call(std::shared_ptr<Realm> r, Table* table) {
-        return Results(std::move(r), *table);
+    SECTION("applied after a sort") {
+        r = r.sort({{"string", false}});
+        require_same_rows({"int"});
+        require_same_rows({"link.value", "optional int"});
     }
-};
-struct ResultsFromQuery {
-    static Results call(std::shared_ptr<Realm> r, Table* table) {
-        return Results(std::move(r), table->where());
+
+    SECTION("keypaths which are handled by core") {
+        require_same_rows({"double"});
+        require_same_rows({"int", "double"});
     }
-};
-struct ResultsFromTableView {
-    static Results call(std::shared_ptr<Realm> r, Table* table) {
-        return Results(std::move(r), table->where().find_all());
+
+    SECTION("invalid keypaths") {
+        REQUIRE_THROWS(r.get_distinct_row_indices({"not a property"}));
+    }
+}
+
+#if REALM_ENABLE_SYNC
+// realm-parser is only linked into the tests in sync builds
+TEST_CASE("results: filter with a query string") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+    realm->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    realm->commit_transaction();
+
+    Results r(realm, *table);
+    auto& cache = _impl::PredicateCache::get(*realm);
+    REQUIRE(&cache == &_impl::PredicateCache::get(*realm));
+
+    SECTION("repeated filters reuse the parsed string") {
+        query_builder::NoArguments no_args;
+        REQUIRE(filter_with_predicate(r, "value > 6 SORT(value DESC)", no_args).size() == 3);
+        REQUIRE(filter_with_predicate(r, "value > 6 SORT(value DESC)", no_args).first()->get_int(0) == 9);
+        REQUIRE(filter_with_predicate(r, "value < 2", no_args).size() == 2);
+        REQUIRE(cache.size() == 2);
     }
-};
-struct ResultsFromLinkView {
-    static Results call(std::shared_ptr<Realm> r, Table* table) {
-        r->begin_transaction();
-        auto link_table = r->read_group().get_table("class_linking_object");
-        link_table->add_empty_row(1);
-        auto link_view = link_table->get_linklist(0, 0);
-        for (size_t i = 0; i < table->size(); ++i)
-            link_view->add(i);
-        r->commit_transaction();
-        return Results(r, link_view);
+
+    SECTION("least recently used strings are evicted") {
+        query_builder::NoArguments no_args;
+        cache.set_capacity(2);
+        filter_with_predicate(r, "value > 1", no_args);
+        filter_with_predicate(r, "value > 2", no_args);
+        filter_with_predicate(r, "value > 1", no_args);
+        filter_with_predicate(r, "value > 3", no_args);
+        REQUIRE(cache.size() == 2);
+        REQUIRE_FALSE(cache.contains("value > 2"));
+        REQUIRE(cache.contains("value > 1"));
+        REQUIRE(cache.contains("value > 3"));
+        REQUIRE(filter_with_predicate(r, "value > 1", no_args).size() == 8);
+        REQUIRE(filter_with_predicate(r, "value > 3", no_args).size() == 6);
+        REQUIRE(cache.size() == 2);
     }
-};
 
-TEMPLATE_TEST_CASE("results: aggregate", ResultsFromTable, ResultsFromQuery, ResultsFromTableView, ResultsFromLinkView) {
+    SECTION("invalid strings are not cached") {
+        query_builder::NoArguments no_args;
+        REQUIRE_THROWS(filter_with_predicate(r, "value >", no_args));
+        REQUIRE(cache.size() == 0);
+    }
+}
+#endif
+
+TEMPLATE_TEST_CASE("results: get_range", ResultsFromTable, ResultsFromQuery, ResultsFromTableView, ResultsFromLinkView) {
     InMemoryTestFile config;
     config.cache = false;
     config.automatic_change_notifications = false;
@@ -2695,10 +4964,7 @@ TEMPLATE_TEST_CASE("results: aggregate", ResultsFromTable, ResultsFromQuery, Res
     auto r = Realm::get_shared_realm(config);
     r->update_schema({
         {"object", {
-            {"int", PropertyType::Int|PropertyType::Nullable},
-            {"float", PropertyType::Float|PropertyType::Nullable},
-            {"double", PropertyType::Double|PropertyType::Nullable},
-            {"date", PropertyType::Date|PropertyType::Nullable},
+            {"value", PropertyType::Int},
         }},
         {"linking_object", {
             {"link", PropertyType::Array|PropertyType::Object, "object"}
@@ -2706,127 +4972,119 @@ TEMPLATE_TEST_CASE("results: aggregate", ResultsFromTable, ResultsFromQuery, Res
     });
 
     auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (int i = 0; i < 10; ++i)
+        table->set_int(0, i, i * 2);
+    r->commit_transaction();
 
-    SECTION("one row with null values") {
-        r->begin_transaction();
-        table->add_empty_row(3);
-
-        table->set_int(0, 1, 0);
-        table->set_float(1, 1, 0.f);
-        table->set_double(2, 1, 0.0);
-        table->set_timestamp(3, 1, Timestamp(0, 0));
-
-        table->set_int(0, 2, 2);
-        table->set_float(1, 2, 2.f);
-        table->set_double(2, 2, 2.0);
-        table->set_timestamp(3, 2, Timestamp(2, 0));
-        // table:
-        //  null, null, null,  null,
-        //  0,    0,    0,    (0, 0)
-        //  2,    2,    2,    (2, 0)
-        r->commit_transaction();
-
-        Results results = TestType::call(r, table.get());
-
-        SECTION("max") {
-            REQUIRE(results.max(0)->get_int() == 2);
-            REQUIRE(results.max(1)->get_float() == 2.f);
-            REQUIRE(results.max(2)->get_double() == 2.0);
-            REQUIRE(results.max(3)->get_timestamp() == Timestamp(2, 0));
-        }
+    Results results = TestType::call(r, table.get());
 
-        SECTION("min") {
-            REQUIRE(results.min(0)->get_int() == 0);
-            REQUIRE(results.min(1)->get_float() == 0.f);
-            REQUIRE(results.min(2)->get_double() == 0.0);
-            REQUIRE(results.min(3)->get_timestamp() == Timestamp(0, 0));
-        }
+    SECTION("reads the requested rows") {
+        RowExpr rows[4];
+        REQUIRE(results.get_range(3, 4, rows) == 4);
+        for (size_t i = 0; i < 4; ++i)
+            REQUIRE(rows[i].get_int(0) == int64_t(i + 3) * 2);
+    }
 
-        SECTION("average") {
-            REQUIRE(results.average(0) == 1.0);
-            REQUIRE(results.average(1) == 1.0);
-            REQUIRE(results.average(2) == 1.0);
-            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
-        }
+    SECTION("stops at the end of the results") {
+        size_t rows[8];
+        REQUIRE(results.get_row_indices(6, 8, rows) == 4);
+        REQUIRE(rows[0] == 6);
+        REQUIRE(rows[3] == 9);
+        REQUIRE(results.get_row_indices(10, 8, rows) == 0);
+        REQUIRE(results.get_row_indices(20, 8, rows) == 0);
+    }
 
-        SECTION("sum") {
-            REQUIRE(results.sum(0)->get_int() == 2);
-            REQUIRE(results.sum(1)->get_double() == 2.0);
-            REQUIRE(results.sum(2)->get_double() == 2.0);
-            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
-        }
+    SECTION("matches get()") {
+        size_t rows[10];
+        REQUIRE(results.get_row_indices(0, 10, rows) == 10);
+        for (size_t i = 0; i < 10; ++i)
+            REQUIRE(rows[i] == results.get(i).get_index());
     }
 
-    SECTION("rows with all null values") {
+    SECTION("reports deleted rows in snapshots as detached") {
+        auto snapshot = results.snapshot();
         r->begin_transaction();
-        table->add_empty_row(3);
-        // table:
-        //  null, null, null,  null,  null
-        //  null, null, null,  null,  null
-        //  null, null, null,  null,  null
+        table->move_last_over(9);
         r->commit_transaction();
 
-        Results results = TestType::call(r, table.get());
-
-        SECTION("max") {
-            REQUIRE(!results.max(0));
-            REQUIRE(!results.max(1));
-            REQUIRE(!results.max(2));
-            REQUIRE(!results.max(3));
-        }
+        size_t indices[10];
+        REQUIRE(snapshot.get_row_indices(0, 10, indices) == 10);
+        REQUIRE(indices[9] == npos);
+        RowExpr rows[10];
+        REQUIRE(snapshot.get_range(0, 10, rows) == 10);
+        REQUIRE(rows[0].is_attached());
+        REQUIRE_FALSE(rows[9].is_attached());
+    }
+}
 
-        SECTION("min") {
-            REQUIRE(!results.min(0));
-            REQUIRE(!results.min(1));
-            REQUIRE(!results.min(2));
-            REQUIRE(!results.min(3));
-        }
+TEMPLATE_TEST_CASE("results: export_column", ResultsFromTable, ResultsFromQuery, ResultsFromTableView, ResultsFromLinkView) {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
 
-        SECTION("average") {
-            REQUIRE(!results.average(0));
-            REQUIRE(!results.average(1));
-            REQUIRE(!results.average(2));
-            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
-        }
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"object", {
+            {"int", PropertyType::Int},
+            {"optional int", PropertyType::Int|PropertyType::Nullable},
+            {"double", PropertyType::Double},
+            {"date", PropertyType::Date},
+        }},
+        {"linking_object", {
+            {"link", PropertyType::Array|PropertyType::Object, "object"}
+        }},
+    });
 
-        SECTION("sum") {
-            REQUIRE(results.sum(0)->get_int() == 0);
-            REQUIRE(results.sum(1)->get_double() == 0.0);
-            REQUIRE(results.sum(2)->get_double() == 0.0);
-            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
-        }
+    auto table = r->read_group().get_table("class_object");
+    r->begin_transaction();
+    table->add_empty_row(4);
+    for (int i = 0; i < 4; ++i) {
+        table->set_int(0, i, i + 1);
+        if (i % 2)
+            table->set_int(1, i, i * 10);
+        table->set_double(2, i, i * 1.5);
+        table->set_timestamp(3, i, Timestamp(i, 0));
     }
+    r->commit_transaction();
 
-    SECTION("empty") {
-        Results results = TestType::call(r, table.get());
+    Results results = TestType::call(r, table.get());
 
-        SECTION("max") {
-            REQUIRE(!results.max(0));
-            REQUIRE(!results.max(1));
-            REQUIRE(!results.max(2));
-            REQUIRE(!results.max(3));
-        }
+    SECTION("copies each type of column") {
+        int64_t ints[4];
+        REQUIRE(results.export_column(0, ints, 4) == 4);
+        REQUIRE(ints[0] == 1);
+        REQUIRE(ints[3] == 4);
 
-        SECTION("min") {
-            REQUIRE(!results.min(0));
-            REQUIRE(!results.min(1));
-            REQUIRE(!results.min(2));
-            REQUIRE(!results.min(3));
-        }
+        util::Optional<int64_t> optional_ints[4];
+        REQUIRE(results.export_column(1, optional_ints, 4) == 4);
+        REQUIRE(!optional_ints[0]);
+        REQUIRE(optional_ints[1] == 10);
+        REQUIRE(!optional_ints[2]);
+        REQUIRE(optional_ints[3] == 30);
 
-        SECTION("average") {
-            REQUIRE(!results.average(0));
-            REQUIRE(!results.average(1));
-            REQUIRE(!results.average(2));
-            REQUIRE_THROWS_AS(results.average(3), Results::UnsupportedColumnTypeException);
-        }
+        double doubles[4];
+        REQUIRE(results.export_column(2, doubles, 4) == 4);
+        REQUIRE(doubles[2] == 3.0);
 
-        SECTION("sum") {
-            REQUIRE(results.sum(0)->get_int() == 0);
-            REQUIRE(results.sum(1)->get_double() == 0.0);
-            REQUIRE(results.sum(2)->get_double() == 0.0);
-            REQUIRE_THROWS_AS(results.sum(3), Results::UnsupportedColumnTypeException);
-        }
+        Timestamp dates[4];
+        REQUIRE(results.export_column(3, dates, 4) == 4);
+        REQUIRE(dates[3] == Timestamp(3, 0));
+    }
+
+    SECTION("stops at the end of the results") {
+        int64_t ints[8];
+        REQUIRE(results.export_column(0, ints, 8) == 4);
+        REQUIRE(results.export_column(0, ints, 2) == 2);
+    }
+
+    SECTION("rejects mismatched types") {
+        double doubles[4];
+        REQUIRE_THROWS_AS(results.export_column(0, doubles, 4), Results::UnsupportedColumnTypeException);
+        int64_t ints[4];
+        REQUIRE_THROWS_AS(results.export_column(1, ints, 4), Results::UnsupportedColumnTypeException);
+        REQUIRE_THROWS_AS(results.export_column(10, ints, 4), Results::OutOfBoundsIndexException);
     }
 }
 
@@ -3115,3 +5373,190 @@ TEST_CASE("results: limit", "[limit]") {
         REQUIRE_THROWS_AS(limited.filter(table->where()), Results::UnimplementedOperationException);
     }
 }
+
+TEST_CASE("results: first and last of sorted results") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+            {"optional", PropertyType::Int|PropertyType::Nullable},
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+
+    realm->begin_transaction();
+    table->add_empty_row(8);
+    for (int i = 0; i < 8; ++i) {
+        table->set_int(0, i, (i + 2) % 4);
+        table->set_int(1, i, i);
+    }
+    table->set_null(1, 3);
+    realm->commit_transaction();
+    Results r(realm, *table);
+
+    SECTION("ascending") {
+        auto sorted = r.sort({{"value", true}});
+        REQUIRE(sorted.first()->get_index() == 2);
+        REQUIRE(sorted.last()->get_index() == 5);
+        REQUIRE(sorted.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("descending") {
+        auto sorted = r.sort({{"value", false}});
+        REQUIRE(sorted.first()->get_index() == 1);
+        REQUIRE(sorted.last()->get_index() == 6);
+        REQUIRE(sorted.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("multiple columns") {
+        auto sorted = r.sort({{"value", true}, {"optional", false}});
+        REQUIRE(sorted.first()->get_index() == 6);
+        REQUIRE(sorted.last()->get_index() == 1);
+    }
+
+    SECTION("filtered") {
+        auto sorted = r.filter(table->where().greater(0, 1)).sort({{"value", true}});
+        REQUIRE(sorted.first()->get_index() == 0);
+        REQUIRE(sorted.last()->get_index() == 5);
+    }
+
+    SECTION("no matches") {
+        auto sorted = r.filter(table->where().greater(0, 10)).sort({{"value", true}});
+        REQUIRE_FALSE(sorted.first());
+        REQUIRE_FALSE(sorted.last());
+    }
+
+    SECTION("null values are sorted by the full query") {
+        auto sorted = r.sort({{"optional", true}});
+        REQUIRE(sorted.first()->get_index() == 3);
+        REQUIRE(sorted.last()->get_index() == 7);
+    }
+
+    SECTION("is found again after a write") {
+        auto sorted = r.sort({{"value", true}});
+        REQUIRE(sorted.first()->get_index() == 2);
+        REQUIRE(sorted.first()->get_index() == 2);
+
+        realm->begin_transaction();
+        table->set_int(0, 4, -1);
+        REQUIRE(sorted.first()->get_index() == 4);
+        realm->commit_transaction();
+        REQUIRE(sorted.first()->get_index() == 4);
+        REQUIRE(sorted.get_mode() == Results::Mode::Query);
+    }
+
+    SECTION("matches the sorted TableView") {
+        auto sorted = r.sort({{"value", false}, {"optional", true}});
+        auto first = sorted.first()->get_index();
+        auto last = sorted.last()->get_index();
+        REQUIRE(sorted.get(0).get_index() == first);
+        REQUIRE(sorted.get(sorted.size() - 1).get_index() == last);
+    }
+}
+
+TEST_CASE("results: index_of in large sorted results") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+
+    const size_t count = 2000;
+    realm->begin_transaction();
+    table->add_empty_row(count);
+    for (size_t i = 0; i < count; ++i)
+        table->set_int(0, i, int64_t(count - i));
+    realm->commit_transaction();
+
+    Results sorted = Results(realm, *table).sort({{"value", true}});
+
+    SECTION("repeated lookups") {
+        for (size_t i = 0; i < count; i += 7)
+            REQUIRE(sorted.index_of(table->get(i)) == count - i - 1);
+    }
+
+    SECTION("lookups after rows change") {
+        REQUIRE(sorted.index_of(table->get(10)) == count - 11);
+        REQUIRE(sorted.index_of(table->get(20)) == count - 21);
+
+        realm->begin_transaction();
+        table->set_int(0, 20, 0);
+        table->move_last_over(5);
+        realm->commit_transaction();
+
+        REQUIRE(sorted.index_of(table->get(20)) == 0);
+        REQUIRE(sorted.index_of(table->get(5)) == 1);
+        REQUIRE(sorted.index_of(table->get(10)) == count - 11);
+    }
+
+    SECTION("copies") {
+        REQUIRE(sorted.index_of(table->get(1)) == count - 2);
+        REQUIRE(sorted.index_of(table->get(2)) == count - 3);
+        Results copy = sorted;
+        REQUIRE(copy.index_of(table->get(3)) == count - 4);
+    }
+}
+
+TEST_CASE("results: size of filtered link list results") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"object", {
+            {"value", PropertyType::Int},
+        }},
+        {"origin", {
+            {"array", PropertyType::Array|PropertyType::Object, "object"},
+        }},
+    };
+
+    auto realm = Realm::get_shared_realm(config);
+    auto table = realm->read_group().get_table("class_object");
+    auto origin = realm->read_group().get_table("class_origin");
+
+    realm->begin_transaction();
+    table->add_empty_row(10);
+    origin->add_empty_row();
+    auto lv = origin->get_linklist(0, 0);
+    for (int i = 0; i < 10; ++i) {
+        table->set_int(0, i, i);
+        lv->add(i);
+    }
+    realm->commit_transaction();
+
+    Results r(realm, lv, table->where(lv).greater(0, 4));
+    REQUIRE(r.size() == 5);
+    REQUIRE(r.size() == 5);
+    REQUIRE(r.get_mode() == Results::Mode::Query);
+
+    SECTION("reflects changes made in a write transaction") {
+        realm->begin_transaction();
+        lv->remove(9);
+        REQUIRE(r.size() == 4);
+        table->set_int(0, 0, 10);
+        REQUIRE(r.size() == 5);
+        realm->cancel_transaction();
+        REQUIRE(r.size() == 5);
+    }
+
+    SECTION("reflects changes made by other Realms after refreshing") {
+        auto realm2 = Realm::get_shared_realm(config);
+        realm2->begin_transaction();
+        realm2->read_group().get_table("class_origin")->get_linklist(0, 0)->clear();
+        realm2->commit_transaction();
+
+        REQUIRE(r.size() == 5);
+        realm->refresh();
+        REQUIRE(r.size() == 0);
+    }
+}
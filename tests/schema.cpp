@@ -112,6 +112,30 @@ TEST_CASE("ObjectSchema") {
         REQUIRE(schema.find("object")->property_for_public_name("other_value")->name == "other_value");
     }
 
+    SECTION("looking up properties after modifying them") {
+        ObjectSchema os("object", {
+            {"a", PropertyType::Int},
+            {"b", PropertyType::Int},
+        }, {
+            {"c", PropertyType::LinkingObjects | PropertyType::Array, "object", "a"},
+        });
+        REQUIRE(os.property_for_name("b") == &os.persisted_properties[1]);
+        REQUIRE(os.property_for_name("c") == &os.computed_properties[0]);
+
+        os.persisted_properties[1].name = "d";
+        os.persisted_properties.push_back({"b", PropertyType::String});
+        os.persisted_properties.insert(os.persisted_properties.begin(), Property{"e", PropertyType::Int});
+        REQUIRE(os.property_for_name("b")->type == PropertyType::String);
+        REQUIRE(os.property_for_name("d") == &os.persisted_properties[2]);
+        REQUIRE(os.property_for_name("e") == &os.persisted_properties[0]);
+        REQUIRE(os.property_for_name("c") == &os.computed_properties[0]);
+
+        os.rebuild_property_index();
+        REQUIRE(os.property_for_name("a") == &os.persisted_properties[1]);
+        REQUIRE(os.property_for_public_name("d") == &os.persisted_properties[2]);
+        REQUIRE(os.property_for_name("f") == nullptr);
+    }
+
     SECTION("from a Group") {
         Group g;
         TableRef pk = g.add_table("pk");
@@ -649,6 +673,26 @@ TEST_CASE("Schema") {
         }
     }
 
+    SECTION("find()") {
+        std::vector<ObjectSchema> types;
+        for (int i = 0; i < 20; ++i)
+            types.push_back({util::format("object %1", 19 - i), {{"value", PropertyType::Int}}});
+        Schema schema(std::move(types));
+
+        for (int i = 0; i < 20; ++i) {
+            auto name = util::format("object %1", i);
+            auto it = schema.find(name);
+            REQUIRE(it != schema.end());
+            REQUIRE(it->name == name);
+        }
+        REQUIRE(schema.find("object") == schema.end());
+        REQUIRE(schema.find("object 20") == schema.end());
+
+        Schema copy = schema;
+        REQUIRE(copy.find("object 5")->name == "object 5");
+        REQUIRE(&*copy.find("object 5") != &*schema.find("object 5"));
+    }
+
     SECTION("compare()") {
         using namespace schema_change;
         using vec = std::vector<SchemaChange>;
@@ -827,5 +871,33 @@ TEST_CASE("Schema") {
                 &schema1.find("object")->persisted_properties[0],
                 &schema2.find("object")->persisted_properties[0]})});
         }
+
+        SECTION("no changes for identical schemas") {
+            Schema schema1 = {
+                {"object", {
+                    {"pk", PropertyType::Int, Property::IsPrimary{true}},
+                    {"value", PropertyType::String, Property::IsPrimary{false}, Property::IsIndexed{true}},
+                    {"link", PropertyType::Object|PropertyType::Nullable, "object"},
+                }}
+            };
+            Schema schema2 = schema1;
+            REQUIRE(schema1.find("object")->fingerprint() == schema2.find("object")->fingerprint());
+            REQUIRE(schema1.compare(schema2).empty());
+        }
+
+        SECTION("properties modified without rebuilding the property index are still compared") {
+            Schema schema1 = {
+                {"object", {
+                    {"value", PropertyType::Int},
+                }}
+            };
+            Schema schema2 = schema1;
+            schema2.find("object")->persisted_properties[0].type = PropertyType::Double;
+            REQUIRE(schema1.find("object")->fingerprint() == schema2.find("object")->fingerprint());
+            REQUIRE(schema1.compare(schema2) == vec{(ChangePropertyType{
+                &*schema1.find("object"),
+                &schema1.find("object")->persisted_properties[0],
+                &schema2.find("object")->persisted_properties[0]})});
+        }
     }
 }
@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2018 Realm Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "object.hpp"
+#include "object_schema.hpp"
+#include "property.hpp"
+#include "schema.hpp"
+#include "shared_realm.hpp"
+#include "impl/object_accessor_impl.hpp"
+#include "server/adapter.hpp"
+#include "sync/sync_config.hpp"
+#include "sync/sync_manager.hpp"
+
+#include "util/event_loop.hpp"
+#include "util/test_file.hpp"
+#include "util/test_utils.hpp"
+
+#include <realm/util/file.hpp>
+
+#include <json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace realm;
+using namespace std::string_literals;
+
+namespace {
+using AnyDict = std::map<std::string, util::Any>;
+using AnyVec = std::vector<util::Any>;
+
+Schema adapter_test_schema()
+{
+    return Schema{
+        {"object", {
+            {"pk", PropertyType::Int, Property::IsPrimary{true}},
+            {"bool", PropertyType::Bool},
+            {"int", PropertyType::Int},
+            {"float", PropertyType::Float},
+            {"double", PropertyType::Double},
+            {"string", PropertyType::String|PropertyType::Nullable},
+            {"data", PropertyType::Data|PropertyType::Nullable},
+            {"date", PropertyType::Date|PropertyType::Nullable},
+            {"link", PropertyType::Object|PropertyType::Nullable, "object"},
+            {"list", PropertyType::Array|PropertyType::Object, "object"},
+        }},
+    };
+}
+
+void create_objects(Realm::Config const& config, std::vector<AnyDict> objects)
+{
+    auto realm = Realm::get_shared_realm(config);
+    CppContext ctx(realm);
+    realm->begin_transaction();
+    for (auto& object : objects)
+        Object::create(ctx, realm, "object", util::Any(std::move(object)), true);
+    realm->commit_transaction();
+    wait_for_upload(*realm);
+}
+
+// Add the Realm at `path` to the admin Realm so that Adapters pick it up
+void add_to_admin_realm(SyncServer& server, std::string const& path)
+{
+    SyncTestFile admin_config(server, "__admin");
+    admin_config.schema = Schema{
+        {"RealmFile", {
+            {"path", PropertyType::String, Property::IsPrimary{true}},
+        }},
+    };
+    auto realm = Realm::get_shared_realm(admin_config);
+    CppContext ctx(realm);
+    realm->begin_transaction();
+    Object::create(ctx, realm, "RealmFile", util::Any(AnyDict{{"path", path}}), true);
+    realm->commit_transaction();
+    wait_for_upload(*realm);
+}
+
+// Decode the cooked changeset in `buffer`, which is empty for a changeset
+// with no instructions
+nlohmann::json decode(util::AppendBuffer<char> const& buffer, Adapter::OutputFormat format)
+{
+    if (buffer.size() == 0)
+        return nlohmann::json::array();
+    if (format == Adapter::OutputFormat::Json)
+        return nlohmann::json::parse(buffer.data(), buffer.data() + buffer.size());
+    return nlohmann::json::from_msgpack(std::vector<uint8_t>(buffer.data(), buffer.data() + buffer.size()));
+}
+
+// The instructions from every cooked changeset for the Realm which hasn't
+// been consumed yet, in order
+nlohmann::json read_all(Adapter& adapter, std::string const& path, Adapter::OutputFormat format)
+{
+    auto instructions = nlohmann::json::array();
+    util::AppendBuffer<char> buffer;
+    while (adapter.current(path, buffer)) {
+        for (auto& instruction : decode(buffer, format))
+            instructions.push_back(std::move(instruction));
+        adapter.advance(path);
+    }
+    return instructions;
+}
+
+// An Adapter for the Realm at `path` which has finished downloading it
+struct TestAdapter {
+    std::atomic<bool> changed{false};
+    Adapter adapter;
+
+    TestAdapter(SyncServer& server, SyncConfig const& sync_config, std::string const& path,
+                Adapter::OutputFormat format)
+    : adapter([this](std::string) { changed = true; }, std::regex(path), util::make_temp_dir(),
+              template_config(server, sync_config), format)
+    {
+        EventLoop::main().run_until([&] { return changed.load(); });
+        auto realm = Realm::get_shared_realm(adapter.get_config(path));
+        wait_for_download(*realm);
+    }
+
+    static SyncConfig template_config(SyncServer& server, SyncConfig const& sync_config)
+    {
+        SyncConfig config = sync_config;
+        config.reference_realm_url = server.base_url();
+        return config;
+    }
+};
+} // anonymous namespace
+
+TEST_CASE("Adapter: output formats", "[sync][adapter]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+
+    SyncServer server;
+    SyncTestFile config(server, "data");
+    config.schema = adapter_test_schema();
+    add_to_admin_realm(server, "/data");
+
+    SECTION("the JSON and MessagePack output contain the same instructions") {
+        create_objects(config, {
+            AnyDict{{"pk", INT64_C(1)}, {"bool", true}, {"int", INT64_C(-5)}, {"float", 1.5f},
+                    {"double", 2.25}, {"string", "a \"quoted\"\nstring"s}, {"date", Timestamp(10, 0)},
+                    {"list", AnyVec{}}},
+            AnyDict{{"pk", INT64_C(2)}, {"bool", false}, {"int", INT64_C(100000)}, {"float", -0.5f},
+                    {"double", 1e100}, {"string", util::Any()}, {"date", util::Any()},
+                    {"link", AnyDict{{"pk", INT64_C(1)}}}, {"list", AnyVec{AnyDict{{"pk", INT64_C(1)}}}}},
+        });
+
+        TestAdapter json(server, *config.sync_config, "/data", Adapter::OutputFormat::Json);
+        TestAdapter msgpack(server, *config.sync_config, "/data", Adapter::OutputFormat::MessagePack);
+
+        auto json_instructions = read_all(json.adapter, "/data", Adapter::OutputFormat::Json);
+        auto msgpack_instructions = read_all(msgpack.adapter, "/data", Adapter::OutputFormat::MessagePack);
+        REQUIRE(json_instructions.size() > 0);
+        REQUIRE(json_instructions == msgpack_instructions);
+    }
+
+    SECTION("the JSON output is formatted the same way as the json library") {
+        create_objects(config, {
+            AnyDict{{"pk", INT64_C(1)}, {"bool", true}, {"int", INT64_C(7)}, {"float", 0.1f},
+                    {"double", 0.1}, {"string", "tab\tand \\ and \x01"s}, {"date", Timestamp(-10, 0)},
+                    {"list", AnyVec{}}},
+        });
+
+        TestAdapter json(server, *config.sync_config, "/data", Adapter::OutputFormat::Json);
+        util::AppendBuffer<char> buffer;
+        size_t changesets = 0;
+        while (json.adapter.current("/data", buffer)) {
+            std::string text(buffer.data(), buffer.size());
+            if (!text.empty())
+                REQUIRE(nlohmann::json::parse(text).dump() == text);
+            json.adapter.advance("/data");
+            ++changesets;
+        }
+        REQUIRE(changesets > 0);
+    }
+
+    SECTION("binary data is base64 encoded in JSON and raw in MessagePack") {
+        create_objects(config, {
+            AnyDict{{"pk", INT64_C(1)}, {"bool", true}, {"int", INT64_C(0)}, {"float", 0.f}, {"double", 0.0},
+                    {"data", "\x01\x02\x03"s}},
+        });
+
+        TestAdapter json(server, *config.sync_config, "/data", Adapter::OutputFormat::Json);
+        TestAdapter msgpack(server, *config.sync_config, "/data", Adapter::OutputFormat::MessagePack);
+
+        util::AppendBuffer<char> buffer;
+        std::string json_text, msgpack_bytes;
+        while (json.adapter.current("/data", buffer)) {
+            json_text.append(buffer.data(), buffer.size());
+            json.adapter.advance("/data");
+        }
+        while (msgpack.adapter.current("/data", buffer)) {
+            msgpack_bytes.append(buffer.data(), buffer.size());
+            msgpack.adapter.advance("/data");
+        }
+        REQUIRE(json_text.find("\"data\":[\"data64\",\"AQID\"]") != std::string::npos);
+        // "data" followed by a bin 8 header for three bytes and the bytes
+        REQUIRE(msgpack_bytes.find("\xa4" "data" "\xc4\x03\x01\x02\x03"s) != std::string::npos);
+    }
+}
+
+TEST_CASE("Adapter: batching", "[sync][adapter]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+
+    SyncServer server;
+    SyncTestFile config(server, "data");
+    config.schema = adapter_test_schema();
+    add_to_admin_realm(server, "/data");
+
+    // Each call is a separate changeset, and the second one overwrites the
+    // first one's value for "int"
+    create_objects(config, {
+        AnyDict{{"pk", INT64_C(1)}, {"bool", true}, {"int", INT64_C(1)}, {"float", 1.f}, {"double", 1.0}},
+    });
+    create_objects(config, {
+        AnyDict{{"pk", INT64_C(1)}, {"int", INT64_C(2)}},
+    });
+
+    // The values set for "int" in a batch of instructions
+    auto int_values = [](nlohmann::json const& instructions) {
+        std::vector<int64_t> values;
+        for (auto& instruction : instructions) {
+            if (instruction["type"] != "SET")
+                continue;
+            auto set_values = instruction.find("values");
+            if (set_values == instruction.end() || !set_values->is_object())
+                continue;
+            auto it = set_values->find("int");
+            if (it != set_values->end())
+                values.push_back(it->get<int64_t>());
+        }
+        return values;
+    };
+
+    auto test_batching = [&](Adapter::OutputFormat format) {
+        TestAdapter test_adapter(server, *config.sync_config, "/data", format);
+        auto& adapter = test_adapter.adapter;
+        adapter.set_batching(std::chrono::milliseconds(0), 1024 * 1024);
+
+        SECTION("merges every pending changeset and drops overwritten values") {
+            util::AppendBuffer<char> buffer;
+            REQUIRE(adapter.current("/data", buffer));
+            REQUIRE(int_values(decode(buffer, format)) == std::vector<int64_t>{2});
+
+            adapter.advance("/data");
+            REQUIRE_FALSE(adapter.current("/data", buffer));
+        }
+
+        SECTION("writes the batch into the caller's buffer") {
+            util::AppendBuffer<char> buffer;
+            buffer.reserve(1024 * 1024);
+            const char* storage = buffer.data();
+            REQUIRE(adapter.current("/data", buffer));
+            REQUIRE(buffer.data() == storage);
+            REQUIRE(int_values(decode(buffer, format)) == std::vector<int64_t>{2});
+        }
+    };
+
+    SECTION("JSON") {
+        test_batching(Adapter::OutputFormat::Json);
+    }
+
+    SECTION("MessagePack") {
+        test_batching(Adapter::OutputFormat::MessagePack);
+    }
+
+    SECTION("the JSON and MessagePack batches contain the same instructions") {
+        TestAdapter json(server, *config.sync_config, "/data", Adapter::OutputFormat::Json);
+        TestAdapter msgpack(server, *config.sync_config, "/data", Adapter::OutputFormat::MessagePack);
+        json.adapter.set_batching(std::chrono::milliseconds(0), 1024 * 1024);
+        msgpack.adapter.set_batching(std::chrono::milliseconds(0), 1024 * 1024);
+
+        util::AppendBuffer<char> json_buffer, msgpack_buffer;
+        REQUIRE(json.adapter.current("/data", json_buffer));
+        REQUIRE(msgpack.adapter.current("/data", msgpack_buffer));
+        REQUIRE(decode(json_buffer, Adapter::OutputFormat::Json)
+                == decode(msgpack_buffer, Adapter::OutputFormat::MessagePack));
+    }
+}
@@ -19,6 +19,7 @@
 #include "sync_test_utils.hpp"
 
 #include "object_schema.hpp"
+#include "object_store.hpp"
 #include "property.hpp"
 #include "schema.hpp"
 
@@ -28,6 +29,9 @@
 #include <realm/util/file.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <chrono>
+#include <thread>
+
 using namespace realm;
 using namespace realm::util;
 using File = realm::util::File;
@@ -516,3 +520,120 @@ TEST_CASE("sync_metadata: encryption", "[sync]") {
         CHECK(user_metadata_2->is_valid());
     }
 }
+
+TEST_CASE("sync_metadata: write-behind", "[sync]") {
+    reset_test_directory(base_path);
+    const std::string auth_server_url = "https://realm.example.org";
+    const std::string sample_token = "this_is_a_user_token";
+    const auto original_name = tmp_dir() + "foobar/test6";
+
+    // Read the metadata Realm directly, as any manager would share the
+    // cache of the manager under test
+    auto open_metadata_realm = [&] {
+        Realm::Config config;
+        config.path = metadata_path;
+        config.cache = false;
+        config.automatic_change_notifications = false;
+        return Realm::get_shared_realm(std::move(config));
+    };
+    auto is_persisted = [&](const std::string& identity) {
+        auto realm = open_metadata_realm();
+        TableRef table = ObjectStore::table_for_object_type(realm->read_group(), "UserMetadata");
+        size_t row = table->find_first_string(table->get_column_index("identity"), identity);
+        return row != not_found && table->get_string(table->get_column_index("user_token"), row) == sample_token;
+    };
+    auto persisted_action_count = [&] {
+        auto realm = open_metadata_realm();
+        return ObjectStore::table_for_object_type(realm->read_group(), "FileActionMetadata")->size();
+    };
+
+    SECTION("changes are written immediately by default") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.get_or_make_user_metadata("testcase6a", auth_server_url)->set_user_token(sample_token);
+        REQUIRE(is_persisted("testcase6a"));
+    }
+
+    SECTION("changes are held until an explicit flush") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.set_flush_interval(std::chrono::hours(1));
+        auto first = manager.get_or_make_user_metadata("testcase6b1", auth_server_url);
+        auto second = manager.get_or_make_user_metadata("testcase6b2", auth_server_url);
+        first->set_user_token(sample_token);
+        second->set_user_token(sample_token);
+        manager.make_file_action_metadata(original_name, "realm://realm.example.com/1", "asdf",
+                                          SyncAction::DeleteRealm);
+
+        // Reads are served from the cache
+        REQUIRE(manager.get_or_make_user_metadata("testcase6b1", auth_server_url, false)->user_token() == sample_token);
+        REQUIRE(manager.all_unmarked_users().size() == 2);
+        REQUIRE(manager.get_file_action_metadata(original_name));
+
+        REQUIRE_FALSE(is_persisted("testcase6b1"));
+        REQUIRE_FALSE(is_persisted("testcase6b2"));
+
+        REQUIRE(persisted_action_count() == 0);
+
+        manager.flush();
+        REQUIRE(is_persisted("testcase6b1"));
+        REQUIRE(is_persisted("testcase6b2"));
+        REQUIRE(persisted_action_count() == 1);
+
+        // Removals are batched too
+        second->remove();
+        manager.get_file_action_metadata(original_name)->remove();
+        REQUIRE(is_persisted("testcase6b2"));
+        manager.flush();
+        REQUIRE_FALSE(is_persisted("testcase6b2"));
+        REQUIRE(is_persisted("testcase6b1"));
+        REQUIRE(persisted_action_count() == 0);
+    }
+
+    SECTION("managers for the same file share pending changes") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.set_flush_interval(std::chrono::hours(1));
+        manager.get_or_make_user_metadata("testcase6g", auth_server_url)->set_user_token(sample_token);
+        SyncMetadataManager other(metadata_path, false);
+        auto metadata = other.get_or_make_user_metadata("testcase6g", auth_server_url, false);
+        REQUIRE(metadata);
+        REQUIRE(metadata->user_token() == sample_token);
+        REQUIRE_FALSE(is_persisted("testcase6g"));
+    }
+
+    SECTION("a user removed and recreated within one batch is persisted") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.get_or_make_user_metadata("testcase6c", auth_server_url)->set_user_token("old_token");
+        manager.set_flush_interval(std::chrono::hours(1));
+        manager.get_or_make_user_metadata("testcase6c", auth_server_url)->remove();
+        manager.get_or_make_user_metadata("testcase6c", auth_server_url)->set_user_token(sample_token);
+        manager.flush();
+        REQUIRE(is_persisted("testcase6c"));
+    }
+
+    SECTION("pending changes are written when the manager is destroyed") {
+        {
+            SyncMetadataManager manager(metadata_path, false);
+            manager.set_flush_interval(std::chrono::hours(1));
+            manager.get_or_make_user_metadata("testcase6d", auth_server_url)->set_user_token(sample_token);
+        }
+        REQUIRE(is_persisted("testcase6d"));
+    }
+
+    SECTION("pending changes are written when the flush interval is cleared") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.set_flush_interval(std::chrono::hours(1));
+        manager.get_or_make_user_metadata("testcase6e", auth_server_url)->set_user_token(sample_token);
+        REQUIRE_FALSE(is_persisted("testcase6e"));
+        manager.set_flush_interval(std::chrono::milliseconds(0));
+        REQUIRE(is_persisted("testcase6e"));
+    }
+
+    SECTION("pending changes are written in the background after the flush interval") {
+        SyncMetadataManager manager(metadata_path, false);
+        manager.set_flush_interval(std::chrono::milliseconds(10));
+        manager.get_or_make_user_metadata("testcase6f", auth_server_url)->set_user_token(sample_token);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!is_persisted("testcase6f") && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        REQUIRE(is_persisted("testcase6f"));
+    }
+}
@@ -34,6 +34,7 @@
 #include "sync/sync_config.hpp"
 #include "sync/sync_manager.hpp"
 #include "sync/sync_session.hpp"
+#include "sync/impl/work_queue.hpp"
 
 #include "util/event_loop.hpp"
 #include "util/test_file.hpp"
@@ -42,6 +43,14 @@
 #include <realm/parser/parser.hpp>
 #include <realm/parser/query_builder.hpp>
 #include <realm/util/optional.hpp>
+#include <realm/util/scope_exit.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace realm;
 using namespace std::string_literals;
@@ -878,6 +887,169 @@ TEST_CASE("Query-based Sync", "[sync]") {
             REQUIRE(results.size() == ((i % 2 == 0) ? 3 : 0));
         }
     }
+
+    SECTION("named subscriptions can be resubscribed to with a semantically identical query") {
+        auto first = subscribe_and_wait("number > 1 OR string = \"sync\"", partial_config, "object_a", "named"s,
+                                        [](Results, std::exception_ptr error) { REQUIRE(!error); });
+        auto second = subscribe_and_wait("(string = \"sync\" OR number > 1) OR number > 1", partial_config, "object_a", "named"s,
+                                         [](Results, std::exception_ptr error) { REQUIRE(!error); });
+        REQUIRE(first.result_set_object()->row().get_index() == second.result_set_object()->row().get_index());
+
+        // A query which actually differs is still reported as a conflict
+        subscribe_and_wait("number > 1 AND string = \"sync\"", partial_config, "object_a", "named"s,
+                           [](Results, std::exception_ptr error) {
+            REQUIRE(error);
+            REQUIRE_THROWS_AS(std::rethrow_exception(error), partial_sync::ExistingSubscriptionException);
+        });
+    }
+
+    SECTION("unnamed subscriptions keep the default name of the query as written") {
+        auto first = subscribe_and_wait("number > 1 AND string = \"sync\"", partial_config, "object_a", util::none,
+                                        [](Results, std::exception_ptr error) { REQUIRE(!error); });
+        auto second = subscribe_and_wait("string = \"sync\" AND number > 1", partial_config, "object_a", util::none,
+                                         [](Results, std::exception_ptr error) { REQUIRE(!error); });
+        REQUIRE(first.result_set_object()->row().get_index() != second.result_set_object()->row().get_index());
+    }
+
+    SECTION("expired subscriptions created asynchronously are removed by a later registration") {
+        _impl::set_expired_subscription_sweep_interval(std::chrono::milliseconds(0));
+        auto reset_interval = util::make_scope_exit([]() noexcept {
+            _impl::set_expired_subscription_sweep_interval(std::chrono::seconds(30));
+        });
+
+        subscribe_and_wait("number > 1", partial_config, "object_a", "expiring"s, util::Optional<int64_t>(0), false,
+                           [](Results, std::exception_ptr error) { REQUIRE(!error); });
+        subscribe_and_wait("number > 2", partial_config, "object_a", "kept"s,
+                           [](Results, std::exception_ptr error) { REQUIRE(!error); });
+
+        auto realm = Realm::get_shared_realm(partial_config);
+        auto table = ObjectStore::table_for_object_type(realm->read_group(), partial_sync::result_sets_type_name);
+        size_t name_col = table->get_column_index(partial_sync::property_name);
+        EventLoop::main().run_until([&] {
+            realm->refresh();
+            return table->find_first_string(name_col, "expiring") == npos;
+        });
+        REQUIRE(table->find_first_string(name_col, "kept") != npos);
+    }
+
+    SECTION("re-creating a complete subscription reports it as complete immediately") {
+        subscribe_and_wait("number > 1", partial_config, "object_a", "cached"s, [](Results results, std::exception_ptr error) {
+            REQUIRE(!error);
+            REQUIRE(results.size() == 2);
+        });
+
+        auto results = results_for_query("number > 1", partial_config, "object_a");
+        auto subscription = partial_sync::subscribe(results, {"cached"s, util::Optional<int64_t>(60000), true});
+        REQUIRE(subscription.state() == partial_sync::SubscriptionState::Complete);
+        REQUIRE(results.size() == 2);
+
+        // The write and the server's revalidation still happen, without any change in state
+        bool saw_other_state = false;
+        auto token = subscription.add_notification_callback([&] {
+            saw_other_state = saw_other_state || subscription.state() != partial_sync::SubscriptionState::Complete;
+        });
+        ObjectSchema object_schema(results.get_realm()->read_group(), partial_sync::result_sets_type_name);
+        size_t time_to_live_col = object_schema.property_for_name(partial_sync::property_time_to_live)->table_column;
+        EventLoop::main().run_until([&] {
+            auto object = subscription.result_set_object();
+            return object && !object->row().is_null(time_to_live_col);
+        });
+        REQUIRE_FALSE(saw_other_state);
+    }
+
+    SECTION("re-creating a subscription with a different query waits for the server") {
+        subscribe_and_wait("number > 1", partial_config, "object_a", "cached"s, [](Results, std::exception_ptr error) {
+            REQUIRE(!error);
+        });
+
+        auto results = results_for_query("number > 2", partial_config, "object_a");
+        auto subscription = partial_sync::subscribe(results, {"cached"s, none, true});
+        REQUIRE(subscription.state() == partial_sync::SubscriptionState::Creating);
+    }
+
+    SECTION("subscribe_all creates all of the subscriptions together") {
+        auto realm = Realm::get_shared_realm(partial_config);
+        std::vector<std::pair<Results, partial_sync::SubscriptionOptions>> batch;
+        batch.emplace_back(results_for_query("number > 1", partial_config, "object_a"), partial_sync::SubscriptionOptions{"a"s});
+        batch.emplace_back(results_for_query("string = \"meela\"", partial_config, "object_b"), partial_sync::SubscriptionOptions{"b"s});
+        batch.emplace_back(results_for_query("number = 1", partial_config, "object_a"), partial_sync::SubscriptionOptions{});
+        auto subscriptions = partial_sync::subscribe_all(std::move(batch));
+        REQUIRE(subscriptions.size() == 3);
+
+        std::vector<partial_sync::SubscriptionNotificationToken> tokens;
+        auto all_complete = [&] {
+            return std::all_of(subscriptions.begin(), subscriptions.end(), [](auto& subscription) {
+                return subscription.state() == partial_sync::SubscriptionState::Complete;
+            });
+        };
+        for (auto& subscription : subscriptions)
+            tokens.push_back(subscription.add_notification_callback([] { }));
+        EventLoop::main().run_until(all_complete);
+
+        auto table_a = ObjectStore::table_for_object_type(realm->read_group(), "object_a");
+        auto table_b = ObjectStore::table_for_object_type(realm->read_group(), "object_b");
+        REQUIRE(table_a->size() == 3);
+        REQUIRE(table_b->size() == 3);
+    }
+
+    SECTION("subscribe_all reports errors only to the subscriptions which failed") {
+        subscribe_and_wait("number > 1", partial_config, "object_a", "existing"s, [](Results, std::exception_ptr error) {
+            REQUIRE(!error);
+        });
+
+        std::vector<std::pair<Results, partial_sync::SubscriptionOptions>> batch;
+        batch.emplace_back(results_for_query("number = 1", partial_config, "object_a"), partial_sync::SubscriptionOptions{"existing"s});
+        batch.emplace_back(results_for_query("number = 1", partial_config, "object_a"), partial_sync::SubscriptionOptions{"new"s});
+        auto subscriptions = partial_sync::subscribe_all(std::move(batch));
+
+        std::vector<partial_sync::SubscriptionNotificationToken> tokens;
+        for (auto& subscription : subscriptions)
+            tokens.push_back(subscription.add_notification_callback([] { }));
+        EventLoop::main().run_until([&] {
+            return subscriptions[0].state() == partial_sync::SubscriptionState::Error
+                && subscriptions[1].state() == partial_sync::SubscriptionState::Complete;
+        });
+        REQUIRE(subscriptions[0].error());
+        REQUIRE(!subscriptions[1].error());
+    }
+
+    SECTION("callbacks are only called for changes to their own subscription") {
+        auto first = partial_sync::subscribe(results_for_query("number > 1", partial_config, "object_a"), {"first"s});
+        size_t first_calls = 0;
+        auto first_token = first.add_notification_callback([&] { ++first_calls; });
+        EventLoop::main().run_until([&] { return first.state() == partial_sync::SubscriptionState::Complete; });
+        size_t calls_when_complete = first_calls;
+
+        subscribe_and_wait("number = 1", partial_config, "object_a", "second"s, [](Results results, std::exception_ptr error) {
+            REQUIRE(!error);
+            REQUIRE(results.size() == 1);
+        });
+        REQUIRE(first_calls == calls_when_complete);
+        REQUIRE(first.state() == partial_sync::SubscriptionState::Complete);
+    }
+
+    SECTION("the slot of a destroyed subscription is reused without its state") {
+        auto first = partial_sync::subscribe(results_for_query("number > 1", partial_config, "object_a"), {"first"s});
+        EventLoop::main().run_until([&] { return first.state() == partial_sync::SubscriptionState::Complete; });
+
+        // Fails due to reusing the name with a different query, but is
+        // destroyed before that's reported
+        partial_sync::subscribe(results_for_query("number = 1", partial_config, "object_a"), {"first"s});
+
+        auto reused = partial_sync::subscribe(results_for_query("number = 1", partial_config, "object_a"), {"reused"s});
+        auto token = reused.add_notification_callback([] { });
+        EventLoop::main().run_until([&] {
+            return reused.state() == partial_sync::SubscriptionState::Complete
+                || reused.state() == partial_sync::SubscriptionState::Error;
+        });
+        REQUIRE(reused.state() == partial_sync::SubscriptionState::Complete);
+        REQUIRE(!reused.error());
+        REQUIRE(first.state() == partial_sync::SubscriptionState::Complete);
+    }
+
+    SECTION("subscribe_all with no subscriptions does nothing") {
+        REQUIRE(partial_sync::subscribe_all({}).empty());
+    }
 }
 
 TEST_CASE("Query-based Sync link behaviour", "[sync]") {
@@ -964,6 +1136,26 @@ TEST_CASE("Query-based Sync link behaviour", "[sync]") {
                                    {{1, 10, "alpha", 1}, {2, 2, "bravo", 1}, {3, 8, "delta", 3}}, {}, c_objects));
         });
     }
+    SECTION("cached backlink mapping and include descriptors") {
+        auto realm = Realm::get_shared_realm(config);
+        const ObjectSchema os_c = *realm->schema().find("link_target");
+        REQUIRE(&backlink_mapping_for(*realm) == &backlink_mapping_for(*realm));
+
+        partial_sync::SubscriptionOptions options;
+        std::vector<StringData> keypaths = { "parents" };
+        auto include = include_for_keypaths(keypaths, *realm, os_c);
+        auto table_c = ObjectStore::table_for_object_type(realm->read_group(), "link_target");
+        REQUIRE(include_for_keypaths(keypaths, *realm, os_c).get_description(table_c)
+                == include.get_description(table_c));
+        options.inclusions = std::move(include);
+        auto subscription = subscribe_and_wait("TRUEPREDICATE", partial_config, "link_target", options, [&c_objects](Results results, std::exception_ptr) {
+            REQUIRE(verify_results(results.get_realm(),
+                                   {{1, 10, "alpha", 1}, {2, 2, "bravo", 1}, {3, 8, "delta", 3}}, {}, c_objects));
+        });
+
+        REQUIRE_THROWS_WITH(include_for_keypaths({"id"}, *realm, os_c),
+                            "Property 'id' is not a link in object of type 'link_target' in 'INCLUDE' clause");
+    }
     SECTION("inclusion generation for unaliased link targets are not found and will throw") {
         auto realm = Realm::get_shared_realm(config);
         const ObjectSchema os_a = *realm->schema().find("object_a");
@@ -1242,4 +1434,119 @@ TEST_CASE("Creating/Updating subscriptions synchronously", "[sync]") {
         CHECK(subscriptions.size() == 6);
         CHECK(subscriptions.get(5).get_string(name_ndx) == "[object_b] number > 0");
     }
+
+    SECTION("Waiting for a subscription returns its row once it is complete") {
+        auto user_query = results_for_query("number > 0", partial_config, "object_a");
+        auto sub = partial_sync::subscribe_blocking(user_query, {"wait"s}, std::chrono::seconds(30));
+        CHECK(sub.get_string(name_ndx) == "wait");
+        CHECK(sub.get_int(3) == static_cast<int64_t>(partial_sync::SubscriptionState::Complete));
+        CHECK(subscriptions.size() == 6);
+    }
+
+    SECTION("Waiting for a subscription inside a write transaction throws") {
+        realm->begin_transaction();
+        auto user_query = results_for_query("number > 0", partial_config, "object_a");
+        CHECK_THROWS(partial_sync::subscribe_blocking(user_query, {"wait"s}, std::chrono::seconds(30)));
+        realm->cancel_transaction();
+    }
+
+    SECTION("Waiting for a subscription gives up after the timeout") {
+        server.stop();
+        auto user_query = results_for_query("number > 0", partial_config, "object_a");
+        CHECK_THROWS_AS(partial_sync::subscribe_blocking(user_query, {"wait"s}, std::chrono::milliseconds(100)),
+                        partial_sync::SubscriptionTimeoutException);
+
+        // The subscription is left in place to be processed later
+        CHECK(subscriptions.size() == 6);
+        CHECK(subscriptions.get(5).get_string(name_ndx) == "wait");
+    }
+}
+
+TEST_CASE("Query-based Sync work queue", "[sync]") {
+    using WorkQueue = _impl::partial_sync::WorkQueue;
+    using Priority = WorkQueue::Priority;
+
+    std::mutex mutex;
+    std::vector<std::string> ran;
+    auto record = [&](std::string name) {
+        return [&, name] {
+            std::lock_guard<std::mutex> lock(mutex);
+            ran.push_back(name);
+        };
+    };
+
+    // Occupies a worker thread until `release` is fulfilled
+    std::promise<void> release;
+    auto blocker = [future = release.get_future().share()] { future.wait(); };
+
+    SECTION("runs work with the same key in the order it was queued regardless of priority") {
+        WorkQueue queue(4, 100);
+        std::vector<std::string> expected;
+        for (int i = 0; i < 20; ++i) {
+            expected.push_back(std::to_string(i));
+            queue.enqueue("a", i % 2 ? Priority::Interactive : Priority::Background, record(expected.back()));
+        }
+        queue.wait_for("a");
+        REQUIRE(ran == expected);
+    }
+
+    SECTION("runs higher priority work for other keys first") {
+        WorkQueue queue(1, 100);
+        queue.enqueue("blocker", Priority::Background, blocker);
+        queue.enqueue("a", Priority::Background, record("background"));
+        queue.enqueue("b", Priority::Interactive, record("interactive"));
+        release.set_value();
+        queue.wait_for("a");
+        queue.wait_for("b");
+        REQUIRE((ran == std::vector<std::string>{"interactive", "background"}));
+    }
+
+    SECTION("runs work for different keys in parallel") {
+        WorkQueue queue(2, 100);
+        queue.enqueue("blocker", Priority::Background, blocker);
+        queue.enqueue("a", Priority::Background, record("a"));
+        // Would never return if "a" had to wait for the blocker
+        queue.wait_for("a");
+        release.set_value();
+        REQUIRE((ran == std::vector<std::string>{"a"}));
+    }
+
+    SECTION("blocks enqueuing when the queue is full") {
+        WorkQueue queue(1, 2);
+        queue.enqueue("blocker", Priority::Background, blocker);
+        queue.enqueue("a", Priority::Background, record("1"));
+        queue.enqueue("a", Priority::Background, record("2"));
+
+        std::atomic<bool> enqueued(false);
+        std::thread thread([&] {
+            queue.enqueue("a", Priority::Background, record("3"));
+            enqueued = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK_FALSE(enqueued);
+
+        release.set_value();
+        thread.join();
+        CHECK(enqueued);
+        queue.wait_for("a");
+        REQUIRE((ran == std::vector<std::string>{"1", "2", "3"}));
+    }
+
+    SECTION("reports only work which hasn't started as queued") {
+        WorkQueue queue(1, 100);
+        REQUIRE_FALSE(queue.has_queued("a"));
+
+        std::promise<void> started;
+        queue.enqueue("a", Priority::Background, [&, blocker] { started.set_value(); blocker(); });
+        started.get_future().wait();
+        REQUIRE_FALSE(queue.has_queued("a"));
+
+        queue.enqueue("a", Priority::Background, record("a"));
+        REQUIRE(queue.has_queued("a"));
+        REQUIRE_FALSE(queue.has_queued("b"));
+
+        release.set_value();
+        queue.wait_for("a");
+        REQUIRE_FALSE(queue.has_queued("a"));
+    }
 }
@@ -18,6 +18,7 @@
 
 #include "object.hpp"
 #include "impl/object_accessor_impl.hpp"
+#include "impl/realm_coordinator.hpp"
 #include "object_schema.hpp"
 #include "object_store.hpp"
 #include "property.hpp"
@@ -376,3 +377,56 @@ TEST_CASE("Object-level Permissions") {
         }
     }
 }
+
+TEST_CASE("Permissions: reusing open Realms", "[sync]") {
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+
+    // The server is never started, so nothing which waits for it completes
+    SyncServer server{StartImmediately{false}};
+    SyncTestFile base_config{server, "default"};
+    auto user = base_config.sync_config->user;
+
+    std::vector<std::string> urls;
+    std::string path_suffix;
+    auto make_config = [&](std::shared_ptr<SyncUser> user, std::string url) {
+        urls.push_back(url);
+        Realm::Config config = base_config;
+        config.path = base_config.path + (url.find("__management") != std::string::npos ? ".management" : ".permission") + path_suffix;
+        config.sync_config = std::make_shared<SyncConfig>(*base_config.sync_config);
+        config.sync_config->user = std::move(user);
+        config.sync_config->realm_url = std::move(url);
+        config.schema = util::none;
+        return config;
+    };
+    auto open_realms = [&](std::string const& path) -> size_t {
+        auto coordinator = _impl::RealmCoordinator::get_existing_coordinator(path);
+        return coordinator ? coordinator->memory_stats().open_realms : 0;
+    };
+    Permission permission{"/~/default", AccessLevel::Read, Permission::Condition(std::string("other"))};
+
+    SECTION("get_permissions() never calls the callback synchronously") {
+        bool called = false;
+        Permissions::get_permissions(user, [&](Results, std::exception_ptr) { called = true; }, make_config);
+        Permissions::get_permissions(user, [&](Results, std::exception_ptr) { called = true; }, make_config);
+        REQUIRE_FALSE(called);
+        REQUIRE(open_realms(base_config.path + ".permission") == 1);
+    }
+
+    SECTION("operations waiting for the server share the management Realm") {
+        Permissions::set_permission(user, permission, [](std::exception_ptr) { }, make_config);
+        Permissions::set_permission(user, permission, [](std::exception_ptr) { }, make_config);
+        REQUIRE(urls.size() == 2);
+        REQUIRE(open_realms(base_config.path + ".management") == 1);
+    }
+
+    SECTION("Realms are cached by the path of the config") {
+        Permissions::set_permission(user, permission, [](std::exception_ptr) { }, make_config);
+        path_suffix = ".other";
+        Permissions::set_permission(user, permission, [](std::exception_ptr) { }, make_config);
+        REQUIRE(open_realms(base_config.path + ".management") == 1);
+        REQUIRE(open_realms(base_config.path + ".management.other") == 1);
+    }
+
+    // The pending operations keep their Realms open
+    _impl::RealmCoordinator::clear_all_caches();
+}
@@ -22,6 +22,11 @@
 
 #include <realm/util/scope_exit.hpp>
 
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 using namespace realm;
 
 TEST_CASE("progress notification", "[sync]") {
@@ -573,3 +578,160 @@ TEST_CASE("progress notification", "[sync]") {
         }
     }
 }
+
+TEST_CASE("progress notification throttling", "[sync]") {
+    using NotifierType = SyncSession::NotifierType;
+    _impl::SyncProgressNotifier progress;
+
+    std::vector<std::pair<uint64_t, uint64_t>> calls;
+    auto callback = [&](uint64_t transferred, uint64_t transferrable) {
+        calls.emplace_back(transferred, transferrable);
+    };
+    auto update = [&](uint64_t downloaded, uint64_t downloadable) {
+        progress.update(downloaded, downloadable, 0, 0, 1, 1);
+    };
+
+    SECTION("updates smaller than the minimum byte delta are skipped") {
+        _impl::SyncProgressNotifier::Throttle throttle;
+        throttle.min_bytes = 100;
+        progress.register_callback(callback, NotifierType::download, true, throttle);
+
+        update(10, 1000);
+        update(50, 1000);
+        update(150, 1000);
+        update(200, 1000);
+        REQUIRE(calls.size() == 2);
+        REQUIRE(calls[0].first == 10);
+        REQUIRE(calls[1].first == 150);
+
+        SECTION("the completing update is always delivered") {
+            update(1000, 1000);
+            REQUIRE(calls.size() == 3);
+            REQUIRE(calls[2].first == 1000);
+
+            // but only once
+            update(1000, 1000);
+            REQUIRE(calls.size() == 3);
+        }
+    }
+
+    SECTION("updates within the minimum interval are skipped") {
+        _impl::SyncProgressNotifier::Throttle throttle;
+        throttle.min_interval = std::chrono::hours(1);
+
+        SECTION("for streaming notifiers") {
+            progress.register_callback(callback, NotifierType::download, true, throttle);
+            update(10, 1000);
+            update(500, 1000);
+            update(999, 1000);
+            REQUIRE(calls.size() == 1);
+            update(1000, 1000);
+            REQUIRE(calls.size() == 2);
+            REQUIRE(calls[1].first == 1000);
+        }
+
+        SECTION("for non-streaming notifiers") {
+            update(10, 1000);
+            progress.register_callback(callback, NotifierType::download, false, throttle);
+            REQUIRE(calls.size() == 1);
+            update(500, 1000);
+            REQUIRE(calls.size() == 1);
+            update(1200, 1500);
+            REQUIRE(calls.size() == 2);
+            REQUIRE(calls[1].first == 1200);
+            REQUIRE(calls[1].second == 1000);
+
+            // The notifier expired after completing
+            update(1500, 1500);
+            REQUIRE(calls.size() == 2);
+        }
+    }
+
+    SECTION("the last skipped update is delivered once the minimum interval has passed") {
+        _impl::SyncProgressNotifier::Throttle throttle;
+        throttle.min_interval = std::chrono::milliseconds(20);
+
+        // The trailing call is made from the notifier's timer thread
+        std::mutex mutex;
+        std::vector<std::pair<uint64_t, uint64_t>> locked_calls;
+        auto calls_made = [&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            return locked_calls;
+        };
+        progress.register_callback([&](uint64_t transferred, uint64_t transferrable) {
+            std::lock_guard<std::mutex> lock(mutex);
+            locked_calls.emplace_back(transferred, transferrable);
+        }, NotifierType::download, true, throttle);
+
+        update(10, 1000);
+        update(300, 1000);
+        update(500, 1000);
+        REQUIRE(calls_made().size() == 1);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (calls_made().size() < 2 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto made = calls_made();
+        REQUIRE(made.size() == 2);
+        REQUIRE(made[1].first == 500);
+
+        // Nothing was skipped since, so there's no further trailing call
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(calls_made().size() == 2);
+    }
+
+    SECTION("unthrottled notifiers are called for every update") {
+        progress.register_callback(callback, NotifierType::download, true);
+        update(10, 1000);
+        update(10, 1000);
+        update(11, 1000);
+        REQUIRE(calls.size() == 3);
+    }
+}
+
+TEST_CASE("progress notification transfer estimates", "[sync]") {
+    using NotifierType = SyncSession::NotifierType;
+    _impl::SyncProgressNotifier progress;
+    auto start = std::chrono::steady_clock::now();
+    auto at = [&](int seconds) { return start + std::chrono::seconds(seconds); };
+
+    SECTION("no rate is known before there are two updates") {
+        auto estimate = progress.estimate(NotifierType::download);
+        REQUIRE(estimate.bytes_per_second == 0);
+
+        progress.update(100, 1000, 0, 0, 1, 1, at(0));
+        estimate = progress.estimate(NotifierType::download);
+        REQUIRE(estimate.transferred == 100);
+        REQUIRE(estimate.transferrable == 1000);
+        REQUIRE(estimate.bytes_per_second == 0);
+        REQUIRE_FALSE(estimate.remaining);
+    }
+
+    SECTION("rate and time remaining are calculated from recent updates") {
+        progress.update(100, 1000, 0, 50, 1, 1, at(0));
+        progress.update(200, 1000, 0, 50, 1, 1, at(1));
+        progress.update(300, 1000, 50, 50, 1, 1, at(2));
+
+        auto estimate = progress.estimate(NotifierType::download);
+        REQUIRE(estimate.bytes_per_second == Approx(100));
+        REQUIRE(estimate.remaining);
+        REQUIRE(*estimate.remaining == std::chrono::seconds(7));
+
+        estimate = progress.estimate(NotifierType::upload);
+        REQUIRE(estimate.bytes_per_second == Approx(25));
+        REQUIRE(estimate.remaining);
+        REQUIRE(*estimate.remaining == std::chrono::steady_clock::duration::zero());
+    }
+
+    SECTION("updates older than the rate window are discarded") {
+        progress.update(0, 10000, 0, 0, 1, 1, at(0));
+        progress.update(5000, 10000, 0, 0, 1, 1, at(1));
+        progress.update(5100, 10000, 0, 0, 1, 1, at(21));
+        progress.update(5200, 10000, 0, 0, 1, 1, at(22));
+
+        // Only the updates at 21 and 22 seconds and the last one before the
+        // window are used
+        auto estimate = progress.estimate(NotifierType::download);
+        REQUIRE(estimate.bytes_per_second < 100);
+    }
+}
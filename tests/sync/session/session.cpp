@@ -33,9 +33,12 @@
 #include <realm/util/time.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <unistd.h>
 
 using namespace realm;
@@ -76,6 +79,12 @@ TEST_CASE("SyncSession: management by SyncUser", "[sync]") {
         auto s2 = user->session_for_on_disk_path(path_2);
         REQUIRE(s2);
         CHECK(s2->config().realm_url() == realm_base_url + "/test1a-2");
+
+        std::vector<std::shared_ptr<SyncSession>> visited;
+        user->for_each_session([&](auto const& session) { visited.push_back(session); });
+        REQUIRE(visited.size() == 2);
+        CHECK(std::find(visited.begin(), visited.end(), s1) != visited.end());
+        CHECK(std::find(visited.begin(), visited.end(), s2) != visited.end());
     }
 
     SECTION("a SyncUser properly unbinds its sessions upon logging out") {
@@ -93,6 +102,9 @@ TEST_CASE("SyncSession: management by SyncUser", "[sync]") {
         // The sessions should log themselves out.
         EventLoop::main().run_until([&] { return sessions_are_inactive(*session1, *session2); });
         CHECK(user->all_sessions().size() == 0);
+        size_t visited = 0;
+        user->for_each_session([&](auto const&) { ++visited; });
+        CHECK(visited == 0);
     }
 
     SECTION("a SyncUser defers binding new sessions until it is logged in") {
@@ -311,6 +323,277 @@ TEST_CASE("SyncSession: close() API", "[sync]") {
     }
 }
 
+TEST_CASE("SyncSession: start scheduling", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    auto cleanup = util::make_scope_exit([=]() noexcept { SyncManager::shared().reset_for_testing(); });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+    auto user = SyncManager::shared().get_user({"user-start-scheduling", dummy_auth_url}, "not_a_real_token");
+    SyncManager::shared().set_max_starting_sessions(1);
+
+    std::vector<std::string> started;
+    auto make_session = [&](std::string const& path, int priority) {
+        SyncTestFile config({user, server.base_url() + path}, SyncSessionStopPolicy::Immediately,
+                            [&](auto const& path, auto const&, auto) { started.push_back(path); },
+                            [](auto, auto) { });
+        config.sync_config->start_priority = priority;
+        auto realm = Realm::get_shared_realm(config);
+        return SyncManager::shared().get_session(config.path, *config.sync_config);
+    };
+
+    auto session1 = make_session("/start-scheduling-1", 0);
+    auto session2 = make_session("/start-scheduling-2", 0);
+    auto session3 = make_session("/start-scheduling-3", 5);
+    REQUIRE(started.size() == 1);
+    REQUIRE(started[0] == session1->path());
+    REQUIRE(session2->state() == PublicState::WaitingForAccessToken);
+    REQUIRE(session3->state() == PublicState::WaitingForAccessToken);
+
+    SECTION("binding a session starts the highest priority queued session") {
+        session1->refresh_access_token(s_test_token, server.base_url() + "/start-scheduling-1");
+        REQUIRE(started.size() == 2);
+        REQUIRE(started[1] == session3->path());
+
+        session3->refresh_access_token(s_test_token, server.base_url() + "/start-scheduling-3");
+        REQUIRE(started.size() == 3);
+        REQUIRE(started[2] == session2->path());
+    }
+
+    SECTION("closing a starting session releases its slot") {
+        session1->close();
+        REQUIRE(sessions_are_inactive(*session1));
+        REQUIRE(started.size() == 2);
+        REQUIRE(started[1] == session3->path());
+    }
+
+    SECTION("closed queued sessions are not started") {
+        session3->close();
+        REQUIRE(sessions_are_inactive(*session3));
+        session1->close();
+        REQUIRE(started.size() == 2);
+        REQUIRE(started[1] == session2->path());
+    }
+
+    SECTION("raising the limit starts queued sessions") {
+        SyncManager::shared().set_max_starting_sessions(0);
+        REQUIRE(started.size() == 3);
+    }
+}
+
+TEST_CASE("SyncSession: start scheduling timeout", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    auto cleanup = util::make_scope_exit([=]() noexcept { SyncManager::shared().reset_for_testing(); });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+    auto user = SyncManager::shared().get_user({"user-start-timeout", dummy_auth_url}, "not_a_real_token");
+    SyncManager::shared().set_max_starting_sessions(1, std::chrono::milliseconds(10));
+
+    // Queued sessions are started from the timer's thread
+    std::mutex mutex;
+    std::vector<std::string> started;
+    auto started_count = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return started.size();
+    };
+    auto make_session = [&](std::string const& path) {
+        SyncTestFile config({user, server.base_url() + path}, SyncSessionStopPolicy::Immediately,
+                            [&](auto const& path, auto const&, auto) {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                started.push_back(path);
+                            },
+                            [](auto, auto) { });
+        auto realm = Realm::get_shared_realm(config);
+        return SyncManager::shared().get_session(config.path, *config.sync_config);
+    };
+
+    auto session1 = make_session("/start-timeout-1");
+    auto session2 = make_session("/start-timeout-2");
+
+    // session1 never gets a token, so its slot is released by the timeout
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (started_count() < 2 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE(started_count() == 2);
+    REQUIRE(started[1] == session2->path());
+    REQUIRE(session1->state() == PublicState::WaitingForAccessToken);
+}
+
+TEST_CASE("SyncSession: batched access token requests", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    auto cleanup = util::make_scope_exit([=]() noexcept {
+        SyncUser::set_access_token_request_handler(nullptr);
+        SyncManager::shared().reset_for_testing();
+    });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+    auto user = SyncManager::shared().get_user({"user-batched-tokens", dummy_auth_url}, "not_a_real_token");
+
+    std::vector<std::string> requests;
+    SyncUser::set_access_token_request_handler([&](auto request_user, std::string const& server_url) {
+        REQUIRE(request_user == user);
+        requests.push_back(server_url);
+    });
+
+    size_t bind_handler_calls = 0;
+    auto make_session = [&](std::string const& path) {
+        SyncTestFile config({user, server.base_url() + path}, SyncSessionStopPolicy::Immediately,
+                            [&](auto const&, auto const&, auto) { ++bind_handler_calls; },
+                            [](auto, auto) { });
+        auto realm = Realm::get_shared_realm(config);
+        return SyncManager::shared().get_session(config.path, *config.sync_config);
+    };
+
+    auto session1 = make_session("/batched-tokens-1");
+    auto session2 = make_session("/batched-tokens-2");
+    auto session3 = make_session("/batched-tokens-3");
+
+    SECTION("sessions on the same server share a single request") {
+        REQUIRE(requests.size() == 1);
+        REQUIRE(requests[0] == server.base_url());
+        REQUIRE(bind_handler_calls == 0);
+    }
+
+    SECTION("completing the request binds every waiting session") {
+        user->complete_access_token_request(requests[0], s_test_token);
+        EventLoop::main().run_until([&] { return sessions_are_active(*session1, *session2, *session3); });
+        REQUIRE(requests.size() == 1);
+    }
+
+    SECTION("sessions which ask again join the request in flight") {
+        SyncManager::shared().reconnect();
+        REQUIRE(requests.size() == 1);
+    }
+
+    SECTION("a new request is made once the previous one has finished") {
+        user->fail_access_token_request(requests[0]);
+        REQUIRE(session1->state() == PublicState::WaitingForAccessToken);
+        SyncManager::shared().reconnect();
+        REQUIRE(requests.size() == 2);
+
+        user->complete_access_token_request(requests[1], s_test_token);
+        EventLoop::main().run_until([&] { return sessions_are_active(*session1, *session2, *session3); });
+    }
+}
+
+TEST_CASE("SyncSession: reconnect pacing", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    auto cleanup = util::make_scope_exit([=]() noexcept { SyncManager::shared().reset_for_testing(); });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+    auto user = SyncManager::shared().get_user({"user-reconnect-pacing", dummy_auth_url}, "not_a_real_token");
+
+    // Bind handlers for later batches are called on a background thread
+    std::mutex mutex;
+    std::vector<std::string> token_requests;
+    auto request_count = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return token_requests.size();
+    };
+    auto make_session = [&](std::string const& path, int priority) {
+        SyncTestFile config({user, server.base_url() + path}, SyncSessionStopPolicy::Immediately,
+                            [&](auto const& path, auto const&, auto) {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                token_requests.push_back(path);
+                            },
+                            [](auto, auto) { });
+        config.sync_config->start_priority = priority;
+        auto realm = Realm::get_shared_realm(config);
+        return SyncManager::shared().get_session(config.path, *config.sync_config);
+    };
+
+    auto session1 = make_session("/reconnect-pacing-1", 0);
+    auto session2 = make_session("/reconnect-pacing-2", 0);
+    auto session3 = make_session("/reconnect-pacing-3", 5);
+    REQUIRE(request_count() == 3);
+    token_requests.clear();
+
+    SECTION("reconnects every session immediately by default") {
+        SyncManager::shared().reconnect();
+        REQUIRE(request_count() == 3);
+    }
+
+    SECTION("reconnects the first batch immediately and the rest later") {
+        SyncManager::shared().set_reconnect_pacing(1, std::chrono::milliseconds(20), std::chrono::milliseconds(10));
+        SyncManager::shared().reconnect();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(token_requests.size() == 1);
+            REQUIRE(token_requests[0] == session3->path());
+        }
+
+        EventLoop::main().run_until([&] { return request_count() == 3; });
+        std::lock_guard<std::mutex> lock(mutex);
+        REQUIRE(token_requests[1] == session1->path());
+        REQUIRE(token_requests[2] == session2->path());
+    }
+
+    SECTION("a new reconnect supersedes pending batches") {
+        SyncManager::shared().set_reconnect_pacing(1, std::chrono::milliseconds(50));
+        SyncManager::shared().reconnect();
+        SyncManager::shared().reconnect();
+        REQUIRE(request_count() == 2);
+
+        EventLoop::main().run_until([&] { return request_count() == 4; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        REQUIRE(request_count() == 4);
+    }
+}
+
+TEST_CASE("SyncManager: connection statistics", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    auto cleanup = util::make_scope_exit([=]() noexcept { SyncManager::shared().reset_for_testing(); });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoEncryption);
+    SyncManager::shared().enable_automatic_session_multiplexing(2);
+    auto user = SyncManager::shared().get_user({"user-connection-stats", dummy_auth_url}, "not_a_real_token");
+
+    REQUIRE(SyncManager::shared().connection_stats().empty());
+
+    auto make_session = [&](std::string const& path) {
+        return sync_session(server, user, path,
+                            [](const auto&, const auto&) { return s_test_token; },
+                            [](auto, auto) { },
+                            SyncSessionStopPolicy::Immediately);
+    };
+    auto session1 = make_session("/connection-stats-1");
+    auto session2 = make_session("/connection-stats-2");
+    auto session3 = make_session("/connection-stats-3");
+    EventLoop::main().run_until([&] { return sessions_are_active(*session1, *session2, *session3); });
+
+    SECTION("sessions over the threshold share a connection") {
+        auto stats = SyncManager::shared().connection_stats();
+        REQUIRE(stats.size() == 1);
+        REQUIRE(stats[0].server_url == server.base_url());
+        REQUIRE(stats[0].session_count == 3);
+        REQUIRE(stats[0].connection_count == 2);
+        REQUIRE(stats[0].reconnect_count == 0);
+    }
+
+    SECTION("inactive sessions are no longer counted") {
+        session3->close();
+        EventLoop::main().run_until([&] { return sessions_are_inactive(*session3); });
+        auto stats = SyncManager::shared().connection_stats();
+        REQUIRE(stats.size() == 1);
+        REQUIRE(stats[0].session_count == 2);
+        REQUIRE(stats[0].connection_count == 2);
+
+        session1->close();
+        session2->close();
+        EventLoop::main().run_until([&] { return sessions_are_inactive(*session1, *session2); });
+        REQUIRE(SyncManager::shared().connection_stats().empty());
+    }
+}
+
 TEST_CASE("SyncSession: update_configuration()", "[sync]") {
     SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoMetadata);
 
@@ -431,6 +714,32 @@ TEST_CASE("sync: error handling", "[sync]") {
             CHECK(idx != std::string::npos);
         }
     }
+
+    SECTION("Resets in place when configured to") {
+        util::Optional<SyncError> final_error;
+        error_handler = [&](auto, SyncError error) {
+            final_error = std::move(error);
+        };
+        auto config = session->config();
+        config.client_reset_mode = SyncClientResetMode::ResetInPlace;
+        session->update_configuration(std::move(config));
+        EventLoop::main().run_until([&] { return sessions_are_active(*session); });
+
+        auto code = std::error_code{static_cast<int>(ProtocolError::diverging_histories),
+                                    realm::sync::protocol_error_category()};
+        SyncSession::OnlyForTesting::handle_error(*session, {code, "Something bad happened", false});
+        CHECK_FALSE(final_error);
+        REQUIRE(session->state() != SyncSession::PublicState::Inactive);
+        EventLoop::main().run_until([&] { return sessions_are_active(*session); });
+
+        SECTION("and falls back to discarding the file if the reset fails") {
+            SyncSession::OnlyForTesting::handle_error(*session, {code, "Something bad happened", false});
+            REQUIRE(session->state() == SyncSession::PublicState::Inactive);
+            REQUIRE(final_error);
+            CHECK(final_error->is_client_reset_requested());
+            CHECK(final_error->user_info[SyncError::c_original_file_path_key] == on_disk_path);
+        }
+    }
 }
 
 struct AdminTokenUser {
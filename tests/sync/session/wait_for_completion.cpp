@@ -227,3 +227,63 @@ TEST_CASE("SyncSession: wait_for_upload_completion() API", "[sync]") {
         REQUIRE(handler_called == true);
     }
 }
+
+TEST_CASE("SyncManager: waiting for completion of multiple sessions", "[sync]") {
+    if (!EventLoop::has_implementation())
+        return;
+
+    const std::string dummy_auth_url = "https://realm.example.org";
+
+    auto cleanup = util::make_scope_exit([=]() noexcept { SyncManager::shared().reset_for_testing(); });
+    SyncServer server;
+    SyncManager::shared().configure(tmp_dir(), SyncManager::MetadataMode::NoMetadata);
+    auto user = SyncManager::shared().get_user({ "user-wait-for-sessions", dummy_auth_url }, "not_a_real_token");
+
+    std::atomic<bool> handler_called(false);
+    std::vector<SyncManager::SessionCompletion> results;
+    auto handler = [&](std::vector<SyncManager::SessionCompletion> r) {
+        results = std::move(r);
+        handler_called = true;
+    };
+
+    SECTION("calls the callback immediately for no sessions") {
+        SyncManager::shared().wait_for_upload_completion({}, std::chrono::milliseconds(0), handler);
+        REQUIRE(handler_called);
+        REQUIRE(results.empty());
+    }
+
+    SECTION("reports each session once they have all completed") {
+        auto session1 = sync_session(server, user, "/wait-for-sessions-1",
+                                     [](const auto&, const auto&) { return s_test_token; },
+                                     [](auto, auto) { });
+        auto session2 = sync_session(server, user, "/wait-for-sessions-2",
+                                     [](const auto&, const auto&) { return s_test_token; },
+                                     [](auto, auto) { });
+        EventLoop::main().run_until([&] { return sessions_are_active(*session1, *session2); });
+
+        SyncManager::shared().wait_for_download_completion({session1, session2}, std::chrono::milliseconds(0), handler);
+        EventLoop::main().run_until([&] { return handler_called == true; });
+        REQUIRE(results.size() == 2);
+        REQUIRE(results[0].session == session1);
+        REQUIRE(results[1].session == session2);
+        REQUIRE(!results[0].error);
+        REQUIRE(!results[1].error);
+    }
+
+    SECTION("reports sessions which did not complete in time as timed out") {
+        auto session1 = sync_session(server, user, "/wait-for-sessions-3",
+                                     [](const auto&, const auto&) { return s_test_token; },
+                                     [](auto, auto) { });
+        // Never given a token, so it never completes
+        auto session2 = sync_session_with_bind_handler(server, user, "/wait-for-sessions-4",
+                                                       [](auto, auto, auto) { },
+                                                       [](auto, auto) { });
+        EventLoop::main().run_until([&] { return sessions_are_active(*session1); });
+
+        SyncManager::shared().wait_for_download_completion({session1, session2}, std::chrono::milliseconds(500), handler);
+        EventLoop::main().run_until([&] { return handler_called == true; });
+        REQUIRE(results.size() == 2);
+        REQUIRE(!results[0].error);
+        REQUIRE(results[1].error == std::errc::timed_out);
+    }
+}
@@ -27,6 +27,8 @@
 #include <realm/util/logger.hpp>
 #include <realm/util/scope_exit.hpp>
 
+#include <atomic>
+
 using namespace realm;
 using namespace realm::util;
 using File = realm::util::File;
@@ -375,6 +377,50 @@ TEST_CASE("sync_manager: file actions", "[sync]") {
             REQUIRE_REALM_EXISTS(realm_path_2);
             REQUIRE_REALM_EXISTS(realm_path_3);
         }
+
+        SECTION("should run in the background if requested") {
+            create_dummy_realm(realm_path_1);
+            create_dummy_realm(realm_path_2);
+            create_dummy_realm(realm_path_3);
+            SyncManager::shared().configure(base_path, SyncManager::MetadataMode::NoEncryption, "", none, false, true);
+            SyncManager::shared().wait_for_file_actions();
+            CHECK(manager.all_pending_actions().size() == 0);
+            REQUIRE_REALM_DOES_NOT_EXIST(realm_path_1);
+            REQUIRE_REALM_DOES_NOT_EXIST(realm_path_2);
+            REQUIRE_REALM_DOES_NOT_EXIST(realm_path_3);
+        }
+    }
+
+    SECTION("should run asynchronously when manually driven") {
+        SyncManager::shared().configure(base_path, SyncManager::MetadataMode::NoEncryption);
+        // The completions are run on a background thread, and waiting for
+        // the file actions synchronizes with them.
+        std::atomic<int> completions(0);
+        bool ran_action = false, ran_missing_action = true;
+        std::exception_ptr action_error, missing_action_error;
+
+        create_dummy_realm(realm_path_4);
+        manager.make_file_action_metadata(realm_path_4, realm_url, "user4", Action::DeleteRealm);
+        SyncManager::shared().run_file_actions_async(realm_path_4, [&](bool ran, std::exception_ptr error) {
+            ran_action = ran;
+            action_error = error;
+            ++completions;
+        });
+        // There's no file action for this path.
+        SyncManager::shared().run_file_actions_async(realm_path_1, [&](bool ran, std::exception_ptr error) {
+            ran_missing_action = ran;
+            missing_action_error = error;
+            ++completions;
+        });
+
+        SyncManager::shared().wait_for_file_actions();
+        REQUIRE(completions == 2);
+        CHECK(ran_action);
+        CHECK(!action_error);
+        CHECK(!ran_missing_action);
+        CHECK(!missing_action_error);
+        REQUIRE_REALM_DOES_NOT_EXIST(realm_path_4);
+        CHECK(manager.all_pending_actions().size() == 0);
     }
 
     SECTION("Action::BackUpThenDeleteRealm") {
@@ -597,6 +597,42 @@ TEST_CASE("thread safe reference") {
             REQUIRE(list.get(0).get_int(0) == 6);
             REQUIRE(results.size() == 0);
         }
+
+        SECTION("batch of objects") {
+            r->begin_transaction();
+            std::vector<Object> objects;
+            for (int64_t i = 0; i < 10; ++i)
+                objects.push_back(create_object(r, "int object", {{"value", i}}));
+            objects.push_back(create_object(r, "string object", {{"value", "a"s}}));
+            objects.push_back(objects[3]);
+            r->commit_transaction();
+
+            auto ref = r->obtain_thread_safe_reference(objects);
+            std::thread([ref = std::move(ref), config]() mutable {
+                SharedRealm r = Realm::get_shared_realm(config);
+                std::vector<Object> objects = r->resolve_thread_safe_reference(std::move(ref));
+                REQUIRE(objects.size() == 12);
+                for (int64_t i = 0; i < 10; ++i) {
+                    REQUIRE(objects[i].get_object_schema().name == "int object");
+                    REQUIRE(objects[i].row().get_int(0) == i);
+                }
+                REQUIRE(objects[10].get_object_schema().name == "string object");
+                REQUIRE(objects[10].row().get_string(0) == "a");
+                REQUIRE(objects[11].row().get_index() == objects[3].row().get_index());
+
+                r->begin_transaction();
+                objects[11].row().set_int(0, 30);
+                r->commit_transaction();
+            }).join();
+
+            REQUIRE(objects[3].row().get_int(0) == 3);
+            r->refresh();
+            REQUIRE(objects[3].row().get_int(0) == 30);
+        }
+
+        SECTION("empty batch of objects") {
+            REQUIRE_THROWS_AS(r->obtain_thread_safe_reference(std::vector<Object>()), std::invalid_argument);
+        }
     }
 
     SECTION("resolve at version where handed over thing has been deleted") {
@@ -628,6 +664,19 @@ TEST_CASE("thread safe reference") {
             REQUIRE(!delete_and_resolve(list).is_valid());
         }
 
+        SECTION("batch of objects") {
+            r->begin_transaction();
+            auto other = create_object(r, "int object", {{"value", INT64_C(8)}});
+            obj = create_object(r, "int object", {{"value", INT64_C(7)}});
+            r->commit_transaction();
+
+            auto objects = delete_and_resolve(std::vector<Object>{obj, other});
+            REQUIRE(objects.size() == 2);
+            REQUIRE(!objects[0].is_valid());
+            REQUIRE(objects[1].is_valid());
+            REQUIRE(objects[1].row().get_int(0) == 8);
+        }
+
         SECTION("int list") {
             r->begin_transaction();
             obj = create_object(r, "int array", {{"value", AnyVector{INT64_C(1)}}});
@@ -689,3 +738,126 @@ TEST_CASE("thread safe reference") {
         REQUIRE_THROWS(r->resolve_thread_safe_reference(std::move(ref)));
     }
 }
+
+TEST_CASE("frozen accessors") {
+    InMemoryTestFile config;
+    config.cache = false;
+    config.automatic_change_notifications = false;
+    config.schema = Schema{
+        {"int object", {
+            {"value", PropertyType::Int},
+        }},
+        {"int array object", {
+            {"value", PropertyType::Array|PropertyType::Object, "int object"}
+        }},
+    };
+    SharedRealm r = Realm::get_shared_realm(config);
+
+    auto table = get_table(*r, "int object");
+    auto array_table = get_table(*r, "int array object");
+    r->begin_transaction();
+    table->add_empty_row(10);
+    for (size_t i = 0; i < 10; ++i)
+        table->set_int(0, i, i);
+    array_table->add_empty_row();
+    auto lv = array_table->get_linklist(0, 0);
+    for (size_t i = 0; i < 5; ++i)
+        lv->add(i);
+    r->commit_transaction();
+
+    Results results(r, table->where().greater(0, 4));
+    Object object(r, *r->schema().find("int object"), table->get(3));
+    List list(r, lv);
+
+    SECTION("all frozen accessors for a version share a frozen Realm") {
+        auto frozen_results = r->freeze(results);
+        auto frozen_object = r->freeze(object);
+        auto frozen_list = r->freeze(list);
+
+        auto frozen = frozen_results.get_realm();
+        REQUIRE(frozen->is_frozen());
+        REQUIRE(frozen != r);
+        REQUIRE(frozen == r->freeze());
+        REQUIRE(frozen_object.realm() == frozen);
+        REQUIRE(frozen_list.get_realm() == frozen);
+        REQUIRE(frozen->freeze() == frozen);
+        REQUIRE(frozen->read_transaction_version() == r->read_transaction_version());
+    }
+
+    SECTION("frozen accessors are not changed by later writes") {
+        auto frozen_results = r->freeze(results);
+        auto frozen_object = r->freeze(object);
+        auto frozen_list = r->freeze(list);
+        auto frozen = frozen_results.get_realm();
+
+        r->begin_transaction();
+        table->set_int(0, 3, 100);
+        table->set_int(0, 5, 0);
+        table->move_last_over(9);
+        lv->remove(0);
+        r->commit_transaction();
+
+        REQUIRE(results.size() == 4);
+        REQUIRE(object.row().get_int(0) == 100);
+        REQUIRE(list.size() == 4);
+
+        REQUIRE_FALSE(frozen->refresh());
+        REQUIRE(frozen_results.size() == 5);
+        REQUIRE(frozen_results.get(4).get_int(0) == 9);
+        REQUIRE(frozen_object.row().get_int(0) == 3);
+        REQUIRE(frozen_list.size() == 5);
+        REQUIRE(frozen_list.get(0).get_int(0) == 0);
+
+        auto newer_results = r->freeze(results);
+        REQUIRE(newer_results.get_realm() != frozen);
+        REQUIRE(newer_results.size() == 4);
+    }
+
+    SECTION("frozen accessors can be read from multiple threads at once") {
+        auto frozen_results = r->freeze(results);
+        auto frozen_list = r->freeze(list);
+
+        std::vector<int64_t> sums(4);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < sums.size(); ++i) {
+            threads.emplace_back([&, i, frozen_results, frozen_list]() mutable {
+                int64_t sum = 0;
+                for (size_t j = 0; j < frozen_results.size(); ++j)
+                    sum += frozen_results.get(j).get_int(0);
+                for (size_t j = 0; j < frozen_list.size(); ++j)
+                    sum += frozen_list.get(j).get_int(0);
+                sums[i] = sum;
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        for (auto sum : sums)
+            REQUIRE(sum == 5 + 6 + 7 + 8 + 9 + 0 + 1 + 2 + 3 + 4);
+    }
+
+    SECTION("frozen Realms are read-only") {
+        auto frozen = r->freeze();
+        REQUIRE_THROWS_AS(frozen->begin_transaction(), InvalidTransactionException);
+        REQUIRE_FALSE(frozen->is_in_transaction());
+    }
+
+    SECTION("cannot observe frozen accessors") {
+        auto frozen_results = r->freeze(results);
+        auto frozen_object = r->freeze(object);
+        auto frozen_list = r->freeze(list);
+        REQUIRE_THROWS_AS(frozen_results.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {}),
+                          InvalidTransactionException);
+        REQUIRE_THROWS_AS(frozen_object.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {}),
+                          InvalidTransactionException);
+        REQUIRE_THROWS_AS(frozen_list.add_notification_callback([](CollectionChangeSet, std::exception_ptr) {}),
+                          InvalidTransactionException);
+    }
+
+    SECTION("cannot freeze during a write transaction") {
+        r->begin_transaction();
+        REQUIRE_THROWS_AS(r->freeze(), InvalidTransactionException);
+        REQUIRE_THROWS_AS(r->freeze(results), InvalidTransactionException);
+        r->cancel_transaction();
+    }
+}
@@ -1944,6 +1944,21 @@ TEST_CASE("Transaction log parsing: changeset calcuation") {
             REQUIRE(changes.array_change(0, 2) == (ArrayChange{Kind::Insert, {2, 5}}));
         }
 
+        SECTION("array: changes to multiple observed arrays are tracked separately when the rows move") {
+            Row r2 = origin->get(1);
+            auto changes = observe({r, r2}, [&] {
+                lv->add(0);
+                lv2->add(0);
+                origin->swap_rows(0, 1);
+                lv->add(0);
+                lv2->add(0);
+                origin->insert_empty_row(0);
+                lv2->add(0);
+            });
+            REQUIRE(changes.array_change(0, 2) == (ArrayChange{Kind::Insert, {10, 11}}));
+            REQUIRE(changes.array_change(1, 2) == (ArrayChange{Kind::Insert, {1, 2, 3}}));
+        }
+
         // ----------------------------------------------------------------------
 
 
@@ -2445,3 +2460,206 @@ TEST_CASE("DeepChangeChecker") {
         REQUIRE(checker(0));
     }
 }
+
+TEST_CASE("TableBitset") {
+    _impl::TableBitset bits;
+
+    SECTION("reports out-of-range bits as unset") {
+        REQUIRE_FALSE(bits[0]);
+        REQUIRE_FALSE(bits[100]);
+        REQUIRE_FALSE(bits.any());
+    }
+
+    SECTION("set() grows the set as needed") {
+        bits.set(70);
+        REQUIRE(bits.size() == 71);
+        REQUIRE(bits[70]);
+        REQUIRE_FALSE(bits[69]);
+        REQUIRE(bits.any());
+    }
+
+    SECTION("shrinking clears the removed bits") {
+        bits.set(3);
+        bits.resize(2);
+        REQUIRE_FALSE(bits.any());
+        bits.resize(10);
+        REQUIRE_FALSE(bits[3]);
+    }
+
+    SECTION("insert() shifts the later bits") {
+        bits = std::vector<bool>{true, false, true};
+        bits.insert(1);
+        REQUIRE(bits.size() == 4);
+        REQUIRE(bits[0]);
+        REQUIRE_FALSE(bits[1]);
+        REQUIRE_FALSE(bits[2]);
+        REQUIRE(bits[3]);
+
+        bits.insert(4);
+        REQUIRE(bits.size() == 4);
+    }
+
+    SECTION("move() shifts the bits in between") {
+        bits = std::vector<bool>{true, false, false, true};
+        bits.move(0, 2);
+        REQUIRE_FALSE(bits[0]);
+        REQUIRE_FALSE(bits[1]);
+        REQUIRE(bits[2]);
+        REQUIRE(bits[3]);
+
+        bits.move(3, 0);
+        REQUIRE(bits[0]);
+        REQUIRE_FALSE(bits[1]);
+        REQUIRE_FALSE(bits[2]);
+        REQUIRE(bits[3]);
+    }
+}
+
+TEST_CASE("TableChanges") {
+    _impl::TableChanges tables;
+    tables.get(5).insert(1);
+    tables.get(2).modify(3);
+
+    SECTION("only stores the tables which have been requested") {
+        REQUIRE(tables.size() == 6);
+        REQUIRE(tables.find(2));
+        REQUIRE(tables.find(5));
+        REQUIRE_FALSE(tables.find(0));
+        REQUIRE(tables[0].empty());
+        REQUIRE_INDICES(tables[2].modifications, 3);
+        REQUIRE_INDICES(tables[5].insertions, 1);
+    }
+
+    SECTION("get() does not invalidate existing entries") {
+        auto& changes = tables.get(5);
+        for (size_t i = 6; i < 100; ++i)
+            tables.get(i);
+        tables.get(0);
+        REQUIRE(&changes == &tables.get(5));
+    }
+
+    SECTION("insert_table() shifts later tables") {
+        tables.insert_table(3);
+        REQUIRE_FALSE(tables.find(5));
+        REQUIRE_INDICES(tables[2].modifications, 3);
+        REQUIRE_INDICES(tables[6].insertions, 1);
+    }
+
+    SECTION("move_table() updates the table indices") {
+        tables.move_table(5, 0);
+        REQUIRE_INDICES(tables[0].insertions, 1);
+        REQUIRE_INDICES(tables[3].modifications, 3);
+        REQUIRE(tables.size() == 4);
+    }
+
+    SECTION("merge() combines the changes for each table") {
+        _impl::TableChanges other;
+        other.get(2).modify(4);
+        other.get(7).insert(0);
+        tables.merge(other);
+        REQUIRE_INDICES(tables[2].modifications, 3, 4);
+        REQUIRE_INDICES(tables[5].insertions, 1);
+        REQUIRE_INDICES(tables[7].insertions, 0);
+    }
+
+    SECTION("copies do not share changes with the original") {
+        _impl::TableChanges copy = tables;
+        copy.get(2).modify(4);
+        copy.get(8).insert(0);
+        REQUIRE_INDICES(copy[2].modifications, 3, 4);
+        REQUIRE_INDICES(tables[2].modifications, 3);
+        REQUIRE_FALSE(tables.find(8));
+    }
+
+    SECTION("moving does not invalidate existing entries") {
+        auto changes = tables.find(5);
+        _impl::TableChanges moved = std::move(tables);
+        REQUIRE(moved.find(5) == changes);
+        moved.get(9).insert(2);
+        REQUIRE_INDICES(moved[9].insertions, 2);
+    }
+}
+
+TEST_CASE("ChangesetCache") {
+    InMemoryTestFile config;
+    config.automatic_change_notifications = false;
+    auto r = Realm::get_shared_realm(config);
+    r->update_schema({
+        {"table", {
+            {"value", PropertyType::Int}
+        }},
+        {"table 2", {
+            {"value", PropertyType::Int}
+        }},
+    });
+    auto& table = *r->read_group().get_table("class_table");
+    auto& table2 = *r->read_group().get_table("class_table 2");
+    size_t table_ndx = table.get_index_in_group();
+    size_t table2_ndx = table2.get_index_in_group();
+
+    auto history1 = make_in_realm_history(config.path);
+    SharedGroup sg1(*history1, config.options());
+    auto history2 = make_in_realm_history(config.path);
+    SharedGroup sg2(*history2, config.options());
+    sg1.begin_read();
+    sg2.begin_read(sg1.get_version_of_current_transaction());
+
+    r->begin_transaction();
+    table.add_empty_row(5);
+    table2.add_empty_row(3);
+    r->commit_transaction();
+
+    _impl::transaction::ChangesetCache cache;
+    auto make_info = [](std::vector<bool> tables_needed, std::vector<bool> moves_needed) {
+        _impl::TransactionChangeInfo info{};
+        info.table_modifications_needed = tables_needed;
+        info.table_moves_needed = moves_needed;
+        return info;
+    };
+
+    std::vector<bool> both(std::max(table_ndx, table2_ndx) + 1);
+    both[table_ndx] = both[table2_ndx] = true;
+    auto info1 = make_info(both, both);
+    cache.advance(sg1, info1);
+    auto version = sg1.get_version_of_current_transaction();
+    REQUIRE_INDICES(info1.tables[table_ndx].insertions, 0, 1, 2, 3, 4);
+    REQUIRE_INDICES(info1.tables[table2_ndx].insertions, 0, 1, 2);
+
+    SECTION("reports the same changes for a subset of the tables") {
+        std::vector<bool> one(table_ndx + 1);
+        one[table_ndx] = true;
+        auto info2 = make_info(one, one);
+        cache.advance(sg2, info2, version);
+        REQUIRE(sg2.get_version_of_current_transaction() == version);
+        REQUIRE_INDICES(info2.tables[table_ndx].insertions, 0, 1, 2, 3, 4);
+        REQUIRE_FALSE(info2.tables.find(table2_ndx));
+    }
+
+    SECTION("calculates the changes again if different move tracking is needed") {
+        auto info2 = make_info(both, {});
+        cache.advance(sg2, info2, version);
+        REQUIRE(sg2.get_version_of_current_transaction() == version);
+        REQUIRE_INDICES(info2.tables[table_ndx].insertions, 0, 1, 2, 3, 4);
+        REQUIRE_INDICES(info2.tables[table2_ndx].insertions, 0, 1, 2);
+    }
+
+    SECTION("calculates the changes again for tables which were not tracked") {
+        std::vector<bool> one(table_ndx + 1);
+        one[table_ndx] = true;
+        r->begin_transaction();
+        table.set_int(0, 0, 1);
+        table2.set_int(0, 0, 1);
+        r->commit_transaction();
+
+        auto info2 = make_info(one, one);
+        cache.advance(sg1, info2);
+        REQUIRE_FALSE(info2.tables.find(table2_ndx));
+
+        sg2.end_read();
+        sg2.begin_read(version);
+        auto info3 = make_info(both, both);
+        cache.advance(sg2, info3, sg1.get_version_of_current_transaction());
+        REQUIRE_INDICES(info3.tables[table_ndx].modifications, 0);
+        REQUIRE_INDICES(info3.tables[table2_ndx].modifications, 0);
+    }
+}
@@ -22,6 +22,9 @@
 
 #include <algorithm>
 #include <cctype>
+#include <set>
+#include <string>
+#include <vector>
 
 using namespace realm;
 
@@ -48,3 +51,55 @@ TEST_CASE("uuid") {
     CHECK(uuid[23] == '-');
     CHECK(std::all_of(&uuid[24], &uuid[36], isxdigit));
 }
+
+TEST_CASE("uuid: formatting") {
+    util::UUIDBytes uuid = {{0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                             0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff}};
+    std::string str(util::uuid_string_length, '\0');
+    util::format_uuid(uuid, &str[0]);
+    CHECK(str == "00112233-4455-6677-8899-aabbccddeeff");
+}
+
+TEST_CASE("uuid: batches") {
+    auto check_version_and_variant = [](std::string const& uuid) {
+        INFO("uuid: " << uuid);
+        CHECK(uuid.size() == 36);
+        CHECK(uuid[14] == '4');
+        CHECK((uuid[19] == '8' || uuid[19] == '9' || uuid[19] == 'a' || uuid[19] == 'b'));
+    };
+
+    SECTION("generate_uuids() produces distinct version 4 UUIDs") {
+        std::vector<util::UUIDBytes> uuids(1000);
+        util::generate_uuids(uuids.data(), uuids.size());
+        for (auto& uuid : uuids) {
+            CHECK((uuid[6] & 0xf0) == 0x40);
+            CHECK((uuid[8] & 0xc0) == 0x80);
+        }
+        std::sort(uuids.begin(), uuids.end());
+        CHECK(std::adjacent_find(uuids.begin(), uuids.end()) == uuids.end());
+    }
+
+    SECTION("generate_uuid_strings() fills the buffer with formatted UUIDs") {
+        // More than one internal chunk, and not a multiple of it
+        const size_t count = 150;
+        std::string buffer(count * util::uuid_string_length + 1, 'x');
+        util::generate_uuid_strings(&buffer[0], count);
+        CHECK(buffer.back() == 'x');
+
+        std::set<std::string> seen;
+        for (size_t i = 0; i < count; ++i) {
+            auto uuid = buffer.substr(i * util::uuid_string_length, util::uuid_string_length);
+            check_version_and_variant(uuid);
+            seen.insert(uuid);
+        }
+        CHECK(seen.size() == count);
+    }
+
+    SECTION("uuid_strings() returns formatted UUIDs") {
+        auto uuids = util::uuid_strings(100);
+        REQUIRE(uuids.size() == 100);
+        for (auto& uuid : uuids)
+            check_version_and_variant(uuid);
+        CHECK(std::set<std::string>(uuids.begin(), uuids.end()).size() == 100);
+    }
+}